@@ -938,26 +938,133 @@ public:
 	/// assign a FakeIP from its own locally-controlled namespace.
 	virtual ISteamNetworkingFakeUDPPort *CreateFakeUDPPort( int idxFakeServerPort ) = 0;
 
+	/// Fetch the internal state of the SNP sender for a batch of connections.
+	/// This is intended for diagnostics and tuning, e.g. a server that wants
+	/// to periodically sample all of its connections.  See
+	/// SteamNetConnectionSNPStatus_t.
+	///
+	/// Like GetConnectionRealTimeStatus, this does not take the global lock.
+	/// Each connection is locked only while its entry is being filled in.
+	///
+	/// pOutStatus must point to an array of nConnections entries.  An entry
+	/// is filled in for each handle, in order.  If a handle is invalid, the
+	/// m_eResult field of its entry is set to k_EResultNoConnection.
+	///
+	/// Returns the number of entries that were successfully filled in.
+	virtual int GetConnectionSNPStatus( const HSteamNetConnection *pConnections, int nConnections, SteamNetConnectionSNPStatus_t *pOutStatus ) = 0;
+
+	/// Fetch delivery receipts for unreliable messages sent on the connection
+	/// with k_nSteamNetworkingSend_DeliveryReceipt.  See SteamNetworkingDeliveryReceipt_t.
+	///
+	/// Receipts are returned roughly in the order that we learned the outcome,
+	/// which is not necessarily the order the messages were sent.  Each message
+	/// gets exactly one receipt, unless the connection is closed first.  If you
+	/// don't fetch them, only the most recent few thousand are kept.
+	///
+	/// Returns the number of receipts returned, which will be at most nMaxReceipts,
+	/// or -1 if the connection handle is invalid.
+	virtual int ReceiveDeliveryReceiptsOnConnection( HSteamNetConnection hConn, SteamNetworkingDeliveryReceipt_t *pOutReceipts, int nMaxReceipts ) = 0;
+
+	/// Give lanes a latency target, and schedule them "earliest deadline first".
+	///
+	/// Priorities and weights (see ConfigureConnectionLanes) can't express a
+	/// constraint like "voice must go out within 20ms, bulk data can wait".
+	/// When a message is queued on a lane with a latency target, its deadline
+	/// is the current time plus the target.  Whenever we have room to send,
+	/// lanes with a latency target go first, in order of the deadline of the
+	/// next message.  Lanes without a latency target (value 0) share the
+	/// remaining bandwidth using their priorities and weights as usual.
+	///
+	/// - nNumLanes must match the number of lanes currently configured.
+	///   Call ConfigureConnectionLanes first if you need more than one lane.
+	/// - Latency targets are in milliseconds, 0 - 10000.  0 means no deadline.
+	/// - Messages on a lane with a latency target are not held for the Nagle timer.
+	/// - A deadline doesn't make more bandwidth available.  If the lanes with
+	///   latency targets need more than the send rate, the other lanes starve
+	///   and messages will miss their deadline.  A message misses its deadline
+	///   if it hasn't been completely put on the wire by then.  See
+	///   SteamNetConnectionSNPStatus_t::m_nLaneDeadlineMisses.
+	///
+	/// Return value:
+	/// - k_EResultNoConnection - bad hConn
+	/// - k_EResultInvalidParam - Wrong number of lanes, or bad latency target
+	/// - k_EResultInvalidState - Connection is already dead, etc
+	virtual EResult ConfigureConnectionLaneDeadlines( HSteamNetConnection hConn, int nNumLanes, const int *pLaneLatencyTargetsMS ) = 0;
+
+	/// Get a handle that you can wait on alongside your own sockets (e.g. using
+	/// epoll or WaitForMultipleObjects), instead of polling ReceiveMessagesOnPollGroup
+	/// on a timer.  See SteamNetworkingWakeHandle.
+	///
+	/// The handle is signaled (becomes readable) when a message is added to the
+	/// poll group's queue and the queue was empty.  It is *not* signaled once per
+	/// message.  So each time you wake up, do these steps, in this order:
+	///
+	/// 1. Reset the handle.  On POSIX, read from the file descriptor (it is
+	///    non-blocking) and discard what you read.  The Windows event is
+	///    auto-reset, so returning from the wait already reset it.
+	/// 2. Call ReceiveMessagesOnPollGroup until it returns 0.
+	/// 3. Wait again.
+	///
+	/// If you reset the handle after draining the queue instead, a message that
+	/// arrives in between won't wake you up, and will sit in the queue until
+	/// something else does.
+	///
+	/// The handle is created on the first call, and belongs to the poll group.  Don't
+	/// close it; it is closed when the poll group is destroyed.  If messages are
+	/// already queued when it is created, it is signaled immediately.
+	///
+	/// Returns k_SteamNetworkingWakeHandle_Invalid if the poll group handle is bad, or
+	/// the platform doesn't support it.
+	virtual SteamNetworkingWakeHandle GetPollGroupWakeHandle( HSteamNetPollGroup hPollGroup ) = 0;
+
+	/// Same as GetPollGroupWakeHandle, but for a single connection.  The handle is
+	/// signaled when a message is added to the empty receive queue of the connection.
+	/// (Drain it with ReceiveMessagesOnConnection.)  It is closed when the connection
+	/// handle is freed.
+	virtual SteamNetworkingWakeHandle GetConnectionWakeHandle( HSteamNetConnection hConn ) = 0;
+
+	/// Get a handle that is signaled when a callback is queued and no other callbacks
+	/// were pending, so you know when you need to call RunCallbacks.  The same rules
+	/// as GetPollGroupWakeHandle apply.  Each time you wake up, first reset the handle,
+	/// then call RunCallbacks (which dispatches all pending callbacks), then wait again.
+	/// The handle is closed when the interface is destroyed.
+	virtual SteamNetworkingWakeHandle GetCallbacksWakeHandle() = 0;
+
+	/// Same as SendMessages, but with extra per-message options for unreliable
+	/// messages on connections.  They are ignored for reliable messages.  Each
+	/// array is optional.  If present, it has an entry for each message, and
+	/// 0 means "not used".
+	///
+	/// - pUsecExpiry - local timestamp (see ISteamNetworkingUtils::GetLocalTimestamp)
+	///   after which the message is stale.  If we haven't started putting it on
+	///   the wire by then, it is discarded.
+	/// - pCoalesceKeys - sending a message with a nonzero key discards any message
+	///   queued earlier on the same lane with the same key that we haven't started
+	///   sending yet.  Use this for state updates where only the latest one matters.
+	///
+	/// Discarded messages are counted in SteamNetConnectionRealTimeLaneStatus_t.
+	virtual void SendMessagesWithOptions( int nMessages, SteamNetworkingMessage_t **pMessages, const SteamNetworkingMicroseconds *pUsecExpiry, const int64 *pCoalesceKeys, int64 *pOutMessageNumberOrResult, bool bDeleteFailedMessages ) = 0;
+
 protected:
 	~ISteamNetworkingSockets(); // Silence some warnings
 };
-#define STEAMNETWORKINGSOCKETS_INTERFACE_VERSION "SteamNetworkingSockets012"
+#define STEAMNETWORKINGSOCKETS_INTERFACE_VERSION "SteamNetworkingSockets013"
 
 // Global accessors
 
 // Using standalone lib
 #ifdef STEAMNETWORKINGSOCKETS_STANDALONELIB
 
-	static_assert( STEAMNETWORKINGSOCKETS_INTERFACE_VERSION[24] == '2', "Version mismatch" );
-	STEAMNETWORKINGSOCKETS_INTERFACE ISteamNetworkingSockets *SteamNetworkingSockets_LibV12();
-	inline ISteamNetworkingSockets *SteamNetworkingSockets_Lib() { return SteamNetworkingSockets_LibV12(); }
+	static_assert( STEAMNETWORKINGSOCKETS_INTERFACE_VERSION[24] == '3', "Version mismatch" );
+	STEAMNETWORKINGSOCKETS_INTERFACE ISteamNetworkingSockets *SteamNetworkingSockets_LibV13();
+	inline ISteamNetworkingSockets *SteamNetworkingSockets_Lib() { return SteamNetworkingSockets_LibV13(); }
 
-	STEAMNETWORKINGSOCKETS_INTERFACE ISteamNetworkingSockets *SteamGameServerNetworkingSockets_LibV12();
-	inline ISteamNetworkingSockets *SteamGameServerNetworkingSockets_Lib() { return SteamGameServerNetworkingSockets_LibV12(); }
+	STEAMNETWORKINGSOCKETS_INTERFACE ISteamNetworkingSockets *SteamGameServerNetworkingSockets_LibV13();
+	inline ISteamNetworkingSockets *SteamGameServerNetworkingSockets_Lib() { return SteamGameServerNetworkingSockets_LibV13(); }
 
 	#ifndef STEAMNETWORKINGSOCKETS_STEAMAPI
-		inline ISteamNetworkingSockets *SteamNetworkingSockets() { return SteamNetworkingSockets_LibV12(); }
-		inline ISteamNetworkingSockets *SteamGameServerNetworkingSockets() { return SteamGameServerNetworkingSockets_LibV12(); }
+		inline ISteamNetworkingSockets *SteamNetworkingSockets() { return SteamNetworkingSockets_LibV13(); }
+		inline ISteamNetworkingSockets *SteamGameServerNetworkingSockets() { return SteamGameServerNetworkingSockets_LibV13(); }
 	#endif
 #endif
 
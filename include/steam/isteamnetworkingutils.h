@@ -348,6 +348,38 @@ public:
 	virtual void SteamNetworkingIdentity_ToString( const SteamNetworkingIdentity &identity, char *buf, size_t cbBuf ) = 0;
 	virtual bool SteamNetworkingIdentity_ParseString( SteamNetworkingIdentity *pIdentity, const char *pszStr ) = 0;
 
+	//
+	// Performance metrics
+	//
+
+	/// Fetch a snapshot of library-wide performance counters and latency
+	/// histograms.  Metrics are only collected while k_ESteamNetworkingConfig_PerfMetrics
+	/// is enabled.  This is cheap (it does not take the global lock), and is
+	/// intended to be called periodically, e.g. by a monitoring system.
+	/// The struct is always filled in with whatever has been collected so
+	/// far; the return value indicates whether collection is currently enabled.
+	virtual bool GetPerfMetrics( SteamNetworkingPerfMetrics_t *pMetrics ) = 0;
+
+	//
+	// Message compression
+	//
+
+	/// Register a pre-shared dictionary for compressing messages.  Dictionaries
+	/// are usually trained offline on typical messages, and shipped with the
+	/// app, and can make a huge difference when compressing small messages.
+	///
+	/// Dictionaries are identified by an ID that you choose, which must be
+	/// positive.  When a connection is created, we tell the peer which
+	/// dictionaries we have (the IDs, and a hash of the contents), and if the
+	/// peer has set k_ESteamNetworkingConfig_CompressionDictionary to one of
+	/// them, they will use it to compress messages they send to us.  The
+	/// dictionaries must be registered before creating the connection.
+	/// Changing or removing a dictionary does not affect existing connections.
+	///
+	/// Only the last 64KB of the dictionary are used.  Pass NULL to remove a dictionary.
+	/// Returns false if the ID is invalid.
+	virtual bool SetCompressionDictionary( int nDictionaryID, const void *pData, int cbData ) = 0;
+
 protected:
 	~ISteamNetworkingUtils(); // Silence some warnings
 };
@@ -84,6 +84,13 @@ const HSteamListenSocket k_HSteamListenSocket_Invalid = 0;
 typedef uint32 HSteamNetPollGroup;
 const HSteamNetPollGroup k_HSteamNetPollGroup_Invalid = 0;
 
+/// A handle that an application can wait on in its own event loop, to find
+/// out when there is something to receive.  On Linux, this is an eventfd.
+/// On other POSIX platforms, it's the read end of a pipe.  On Windows, it's
+/// the HANDLE of an auto-reset event.  See ISteamNetworkingSockets::GetPollGroupWakeHandle
+typedef intp SteamNetworkingWakeHandle;
+const SteamNetworkingWakeHandle k_SteamNetworkingWakeHandle_Invalid = -1;
+
 /// Max length of diagnostic error message
 const int k_cchMaxSteamNetworkingErrMsg = 1024;
 
@@ -830,8 +837,344 @@ struct SteamNetConnectionRealTimeLaneStatus_t
 	/// how any data currently queued will be sent out.
 	SteamNetworkingMicroseconds m_usecQueueTime;
 
+	/// Lifetime count of unreliable messages on this lane that were discarded
+	/// before being sent, because they passed their expiry time, or were
+	/// replaced by a newer message with the same coalescing key.  See
+	/// ISteamNetworkingSockets::SendMessagesWithOptions
+	int64 m_nUnreliableExpired;
+	int64 m_nUnreliableCoalesced;
+
+	// Internal stuff, room to change API easily
+	uint32 reserved[6];
+};
+
+/// Internal state of the SNP sender for a connection.  This is intended for
+/// diagnosing and tuning throughput and latency problems, and exposes more
+/// implementation detail than SteamNetConnectionRealTimeStatus_t.  The meaning
+/// of some fields may change as the transport evolves.
+///
+/// SNP does not use a congestion window.  Packets are paced by a token
+/// bucket that refills at the current send rate, so the fields below describe
+/// the rate decision and how often we are waiting on it.
+///
+/// See ISteamNetworkingSockets::GetConnectionSNPStatus
+struct SteamNetConnectionSNPStatus_t
+{
+	enum { k_nMaxLanes = 8 };
+
+	/// The connection this entry describes
+	HSteamNetConnection m_hConn;
+
+	/// k_EResultOK if the rest of the struct is valid, or
+	/// k_EResultNoConnection if the handle is invalid.
+	EResult m_eResult;
+
+	/// High level state of the connection
+	ESteamNetworkingConnectionState m_eState;
+
+	/// Send rate currently in use, and the limits it is clamped to.
+	/// (See k_ESteamNetworkingConfig_SendRateMin and k_ESteamNetworkingConfig_SendRateMax.)
+	int m_nSendRateBytesPerSecond;
+	int m_nSendRateMin;
+	int m_nSendRateMax;
+
+	/// Current level of the token bucket, in bytes.  A negative value means we
+	/// have sent ahead of the send rate and must wait before sending again.
+	float m_flTokenBucket;
+
+	/// Smoothed ping, and the mean deviation of individual ping samples from
+	/// the smoothed value, similar to RTTVAR in RFC 6298.  -1 if we don't
+	/// have any ping samples yet.
+	int m_nSmoothedPingMS;
+	int m_nPingMeanDevMS;
+
+	/// Number of packets we have sent that have not been acked, or timed out
+	int m_nPacketsInFlight;
+
+	/// Buffered data.  See SteamNetConnectionRealTimeStatus_t
+	int m_cbPendingUnreliable;
+	int m_cbPendingReliable;
+	int m_cbSentUnackedReliable;
+
+	/// Number of configured lanes.  Only the first k_nMaxLanes have an
+	/// entry in m_usecLaneQueueTime
+	int m_nLanes;
+
+	/// How long until the token bucket allows us to send another packet.
+	/// Zero if we could send right now.
+	SteamNetworkingMicroseconds m_usecTimeUntilNextSend;
+
+	/// Lifetime counts of reliable segments put on the wire.  Every segment is
+	/// counted once in m_nReliableSegmentsSent, and again in
+	/// m_nReliableSegmentsRetransmitted each time it is retransmitted.
+	/// To get a retransmit rate, sample these periodically and compare the deltas.
+	int64 m_nReliableSegmentsSent;
+	int64 m_nReliableSegmentsRetransmitted;
+	int64 m_cbReliableRetransmitted;
+
+	/// Lifetime counts of packets we decided were lost, by how we found out:
+	/// the peer told us it didn't get them, a packet sent later was acked
+	/// and they were still missing after a reordering window, or they
+	/// timed out.  m_nTailLossProbes counts the times the last packet(s) of
+	/// a burst went unacked and we retransmitted early instead of waiting
+	/// for the timeout.
+	int64 m_nPacketsLostNack;
+	int64 m_nPacketsLostRACK;
+	int64 m_nPacketsLostTimeout;
+	int64 m_nTailLossProbes;
+
+	/// Forward error correction for unreliable messages.  (See
+	/// k_ESteamNetworkingConfig_UnreliableFECLanes.)  Parity frames we have sent,
+	/// and messages we have rebuilt from the parity sent by the peer.
+	int64 m_nFECParityFramesSent;
+	int64 m_nFECMessagesRecovered;
+
+	/// Total time, while connected, that we were application limited (had
+	/// nothing at all queued to send) vs rate limited (had data queued but
+	/// were waiting on the token bucket).  Time spent in neither state is
+	/// time we were actively sending, or holding data for the Nagle timer.
+	SteamNetworkingMicroseconds m_usecAppLimited;
+	SteamNetworkingMicroseconds m_usecRateLimited;
+
+	/// Ack delay reported by the peer, on the most recent ack we used to
+	/// measure ping, and the highest value seen.  -1 if none yet.
+	SteamNetworkingMicroseconds m_usecPeerAckDelayLast;
+	SteamNetworkingMicroseconds m_usecPeerAckDelayMax;
+
+	/// Ack frequency the peer asked us to use.  We will hold an ack for
+	/// reliable data for at most m_usecAckMaxDelay, and ack right away once
+	/// we have received m_nAckThreshold packets with reliable data (0 if
+	/// there is no limit).  The peer bases these on the RTT and its send rate.
+	SteamNetworkingMicroseconds m_usecAckMaxDelay;
+	int m_nAckThreshold;
+
+	/// Packets we sent that carried acks but no message data
+	int64 m_nAckOnlyPacketsSent;
+
+	/// Lifetime count of data packets we have sent, and the total size of
+	/// the SNP payload in those packets (before encryption, and not including
+	/// any transport headers or inline stats).  Useful to measure the per-packet
+	/// overhead, for example of k_ESteamNetworkingConfig_CompactEncoding.
+	int64 m_nDataPacketsSent;
+	int64 m_cbDataPayloadSent;
+
+	/// Estimated queueing delay for each lane.  See
+	/// SteamNetConnectionRealTimeLaneStatus_t::m_usecQueueTime
+	SteamNetworkingMicroseconds m_usecLaneQueueTime[ k_nMaxLanes ];
+
+	/// Lifetime totals for message compression on each lane.  (See
+	/// k_ESteamNetworkingConfig_CompressionLanes.)  Size of the messages we
+	/// sent before and after compression, so the ratio is
+	/// m_cbLaneCompressedOut / m_cbLaneCompressedIn.  And the time we have
+	/// spent compressing messages we sent and decompressing messages we received.
+	int64 m_cbLaneCompressedIn[ k_nMaxLanes ];
+	int64 m_cbLaneCompressedOut[ k_nMaxLanes ];
+	SteamNetworkingMicroseconds m_usecLaneCompressTime[ k_nMaxLanes ];
+	SteamNetworkingMicroseconds m_usecLaneDecompressTime[ k_nMaxLanes ];
+
+	/// Lifetime count of messages on each lane that we finished putting on the
+	/// wire while the lane had a latency target, and how many of them missed
+	/// their deadline.  See ISteamNetworkingSockets::ConfigureConnectionLaneDeadlines
+	int64 m_nLaneDeadlineMessages[ k_nMaxLanes ];
+	int64 m_nLaneDeadlineMisses[ k_nMaxLanes ];
+
 	// Internal stuff, room to change API easily
-	uint32 reserved[10];
+	uint32 reserved[4];
+};
+
+/// Outcome of an unreliable message that was sent with k_nSteamNetworkingSend_DeliveryReceipt.
+///
+/// A message is only reported as delivered if every packet that carried it
+/// was acked by the peer, so you can rely on that.  The reverse is not
+/// true: a message reported as not delivered might have arrived anyway,
+/// for example if a packet we decided was lost was actually just delayed,
+/// or the peer rebuilt it using forward error correction.  Messages that
+/// were discarded before we put them on the wire (see
+/// ISteamNetworkingSockets::SendMessagesWithOptions) are also reported as
+/// not delivered.
+///
+/// See ISteamNetworkingSockets::ReceiveDeliveryReceiptsOnConnection
+struct SteamNetworkingDeliveryReceipt_t
+{
+	/// Message number that was assigned when the message was sent
+	int64 m_nMessageNumber;
+
+	/// Lane the message was sent on
+	int m_idxLane;
+
+	/// True if the peer acked every packet containing the message
+	bool m_bDelivered;
+};
+
+/// Distribution of a set of samples, using buckets that are linear within
+/// each power of two, similar to HdrHistogram.  Values 0...3 each have their
+/// own bucket.  Above that, each power of two is divided into 4 equal-width
+/// buckets, so any value reconstructed from the histogram is within 25% of
+/// the true value.  Values of 2^32 or larger are counted in the last bucket.
+///
+/// See ISteamNetworkingUtils::GetPerfMetrics
+struct SteamNetworkingHistogram_t
+{
+	enum { k_nSubBucketBits = 2 };
+	enum { k_nSubBuckets = 1 << k_nSubBucketBits };
+	enum { k_nBuckets = ( 32 - k_nSubBucketBits + 1 ) * k_nSubBuckets };
+
+	/// Total number of samples
+	int64 m_nCount;
+
+	/// Sum of all samples.  (m_nSum / m_nCount is the mean)
+	int64 m_nSum;
+
+	/// Largest sample
+	int64 m_nMax;
+
+	/// Number of samples in each bucket
+	int64 m_arBuckets[ k_nBuckets ];
+
+	/// Return the bucket that a value is counted in
+	static inline int BucketForValue( int64 nValue )
+	{
+		if ( nValue < k_nSubBuckets )
+			return nValue < 0 ? 0 : (int)nValue;
+		if ( nValue > (int64)0xffffffffu )
+			return k_nBuckets-1;
+		int nMSB = k_nSubBucketBits;
+		while ( ( nValue >> ( nMSB+1 ) ) != 0 )
+			++nMSB;
+		int nShift = nMSB - k_nSubBucketBits;
+		return ( nShift + 1 ) * k_nSubBuckets + (int)( ( nValue >> nShift ) & ( k_nSubBuckets-1 ) );
+	}
+
+	/// Return the smallest value that is counted in the specified bucket.
+	/// (The largest value is one less than the lower bound of the next bucket.)
+	static inline int64 BucketLowerBound( int iBucket )
+	{
+		if ( iBucket < k_nSubBuckets )
+			return iBucket;
+		int nShift = iBucket / k_nSubBuckets - 1;
+		return (int64)( k_nSubBuckets + iBucket % k_nSubBuckets ) << nShift;
+	}
+
+	/// Estimate a percentile, 0...100.  Returns the upper bound of the bucket
+	/// containing the requested sample (clamped to m_nMax), or 0 if the
+	/// histogram is empty.
+	inline int64 Percentile( float flPercentile ) const
+	{
+		if ( m_nCount <= 0 )
+			return 0;
+		int64 nTarget = (int64)( m_nCount * (double)flPercentile / 100.0 + .5 );
+		if ( nTarget < 1 ) nTarget = 1;
+		int64 nSeen = 0;
+		for ( int i = 0 ; i < k_nBuckets-1 ; ++i )
+		{
+			nSeen += m_arBuckets[i];
+			if ( nSeen >= nTarget )
+			{
+				int64 nUpper = BucketLowerBound( i+1 ) - 1;
+				return nUpper < m_nMax ? nUpper : m_nMax;
+			}
+		}
+		return m_nMax;
+	}
+};
+
+/// Snapshot of library-wide performance counters and histograms.  All values
+/// are cumulative since the library was initialized (they are never reset),
+/// and are only collected while k_ESteamNetworkingConfig_PerfMetrics is
+/// enabled.  To get rates, take the difference between two snapshots.
+///
+/// See ISteamNetworkingUtils::GetPerfMetrics
+struct SteamNetworkingPerfMetrics_t
+{
+	/// Local timestamp when the snapshot was taken
+	SteamNetworkingMicroseconds m_usecTimestamp;
+
+	/// Number of threads that have recorded any metrics.
+	int m_nThreads;
+	int _reservePad1;
+
+	//
+	// Counters
+	//
+
+	/// Packets and bytes received from our UDP sockets
+	int64 m_nRecvPackets;
+	int64 m_cbRecv;
+
+	/// Bytes sent on our UDP sockets, and calls to send that failed
+	int64 m_cbSent;
+	int64 m_nSendFailures;
+
+	/// Packets we could not decrypt
+	int64 m_nDecryptFailures;
+
+	/// Allocator activity.  These are only collected if the library was
+	/// built with STEAMNETWORKINGSOCKETS_ENABLE_MEM_OVERRIDE.  Bytes allocated
+	/// includes the new size passed to realloc.
+	int64 m_nAllocCalls;
+	int64 m_nReallocCalls;
+	int64 m_nFreeCalls;
+	int64 m_cbAllocated;
+
+	/// Ephemeral key exchange keys for new connections that were taken from
+	/// the pre-generated pool, or had to be generated on the spot because the
+	/// pool was empty.  See k_ESteamNetworkingConfig_KeyExchangeKeyPoolSize
+	int64 m_nKeyExchangeKeyPoolHits;
+	int64 m_nKeyExchangeKeyPoolMisses;
+
+	/// Handshakes that resumed an earlier session using a ticket (counted on
+	/// both ends), and tickets the server would not accept, so the client
+	/// had to do the full handshake.  See k_ESteamNetworkingConfig_IP_SessionResumption
+	int64 m_nSessionsResumed;
+	int64 m_nSessionResumptionsRejected;
+
+	/// CA-signed certs presented by peers that we had already verified and
+	/// could skip the signature check, or had to verify from scratch
+	int64 m_nCertCacheHits;
+	int64 m_nCertCacheMisses;
+
+	/// Handshake admission control on direct UDP listen sockets.  Packets
+	/// that were discarded before parsing because they were obviously junk,
+	/// packets dropped because the sender's address prefix exceeded
+	/// k_ESteamNetworkingConfig_IP_HandshakeRatePerPrefix, and connect requests
+	/// that were queued because of k_ESteamNetworkingConfig_IP_HandshakeCPUBudget,
+	/// or were dropped from (or never made it into) that queue.
+	int64 m_nHandshakeFiltered;
+	int64 m_nHandshakeRateLimited;
+	int64 m_nConnectRequestsDeferred;
+	int64 m_nConnectRequestsDropped;
+
+	// Room to add counters without changing the struct size
+	int64 reserved[6];
+
+	//
+	// Histograms.  Times are in microseconds.
+	//
+
+	/// Time spent in each recvfrom / recvmsg call, including calls that
+	/// found no data
+	SteamNetworkingHistogram_t m_histRecvFromUsec;
+
+	/// Time spent in each sendto / sendmsg call
+	SteamNetworkingHistogram_t m_histSendToUsec;
+
+	/// Time spent waiting for the global lock, and how long it was held
+	/// once acquired.  Only the outermost (non-recursive) acquisition is
+	/// counted.  When a thread retries a timed lock attempt, each successful
+	/// attempt only counts the time spent in that attempt.
+	SteamNetworkingHistogram_t m_histGlobalLockWaitUsec;
+	SteamNetworkingHistogram_t m_histGlobalLockHoldUsec;
+
+	/// How late each scheduled periodic task ran, relative to the time
+	/// it asked to be woken up
+	SteamNetworkingHistogram_t m_histThinkerLatenessUsec;
+
+	/// Number of packets received each time the service thread woke up
+	SteamNetworkingHistogram_t m_histPacketsPerPollWakeup;
+
+	/// Time spent encrypting and decrypting each packet
+	SteamNetworkingHistogram_t m_histEncryptUsec;
+	SteamNetworkingHistogram_t m_histDecryptUsec;
 };
 
 #pragma pack( pop )
@@ -1061,6 +1404,17 @@ const int k_nSteamNetworkingSend_UseCurrentThread = 16;
 // know when an underlying connection fails, and so you may not need this notification.
 const int k_nSteamNetworkingSend_AutoRestartBrokenSession = 32;
 
+// Ask for a delivery receipt for an unreliable message.  SNP remembers which
+// packets carried the message, and once they have all been acked, or once
+// any one of them is believed lost, a SteamNetworkingDeliveryReceipt_t is
+// queued that you can fetch with ISteamNetworkingSockets::ReceiveDeliveryReceiptsOnConnection.
+// This is intended for schemes such as delta compression, where the sender
+// wants to know which snapshots the peer definitely has.
+//
+// This flag is ignored for reliable messages, including unreliable messages
+// that are too big and get sent reliably.
+const int k_nSteamNetworkingSend_DeliveryReceipt = 64;
+
 //
 // Ping location / measurement
 //
@@ -1247,6 +1601,47 @@ enum ESteamNetworkingConfigValue
 	/// Default is 5000us (5ms).
 	k_ESteamNetworkingConfig_NagleTime = 12,
 
+	/// [connection int32] Bitmask of lanes (bit N = lane N, lanes 0-31 only)
+	/// on which to send forward error correction data for unreliable messages.
+	/// Small unreliable messages (up to 512 bytes) that fit in a single packet
+	/// are grouped, and after each group we send an XOR parity frame, which
+	/// the receiver can use to rebuild any one message in the group that was
+	/// lost.  The group size is adjusted based on the packet loss reported by
+	/// the peer, from 16 messages when loss is low down to 2 when it is high,
+	/// so this costs between 1/16 and 1/2 extra bandwidth on the protected lanes.
+	/// Default is 0 (off).  Ignored if the peer is running an older version.
+	k_ESteamNetworkingConfig_UnreliableFECLanes = 69,
+
+	/// [connection int32] Bitmask of lanes (bit N = lane N, lanes 0-31 only)
+	/// on which to compress outgoing messages.  Each message is compressed
+	/// on its own (using the LZ4 block format), so this works for unreliable
+	/// as well as reliable messages.  Messages that don't get any smaller are
+	/// sent as is, with one extra byte of overhead.  Small messages usually
+	/// need a dictionary to compress well, see k_ESteamNetworkingConfig_CompressionDictionary.
+	///
+	/// This is agreed during the handshake, so it must be set before the
+	/// connection is created.  Default is 0 (off).  Ignored if the peer is
+	/// running an older version.
+	k_ESteamNetworkingConfig_CompressionLanes = 70,
+
+	/// [connection int32] ID of the dictionary used to compress outgoing
+	/// messages on the lanes selected by k_ESteamNetworkingConfig_CompressionLanes.
+	/// See ISteamNetworkingUtils::SetCompressionDictionary.  The peer must have
+	/// registered a dictionary with the same ID and contents, or we will not
+	/// compress at all.  0 (the default) means compress without a dictionary.
+	k_ESteamNetworkingConfig_CompressionDictionary = 71,
+
+	/// [connection int32] If nonzero, use a more compact encoding for the
+	/// data in outgoing packets, which is designed for streams of small
+	/// unreliable messages, such as input sent at a fixed tick rate.  Small
+	/// unreliable messages that fit in the packet are sent with a one byte
+	/// header that can also select the lane, message numbers are abbreviated
+	/// when we know the peer has seen a recent message, and acks use a
+	/// shorter encoding for the delay and for runs of received packets.
+	/// This can save several bytes per packet.  Default is 0 (off).  Ignored
+	/// if the peer is running an older version.
+	k_ESteamNetworkingConfig_CompactEncoding = 72,
+
 	/// [connection int32] Don't automatically fail IP connections that don't have
 	/// strong auth.  On clients, this means we will attempt the connection even if
 	/// we don't know our identity or can't get a cert.  On the server, it means that
@@ -1266,6 +1661,34 @@ enum ESteamNetworkingConfigValue
 	/// (more permissive) will be used.
 	k_ESteamNetworkingConfig_IPLocalHost_AllowWithoutAuth = 52,
 
+	/// [connection int32] Session resumption for direct IP connections, in
+	/// seconds.  On the server, this is the lifetime of the resumption tickets
+	/// we hand out in the connect reply.  On the client, nonzero means that if
+	/// we have an unexpired ticket from an earlier connection to the same
+	/// server, we will present it instead of doing the full handshake.  This
+	/// saves a round trip and skips cert checks and key exchange on the server.
+	/// Tickets are bound to the client's IP address and are only valid in the
+	/// server process that issued them.  Default is 0 (disabled).
+	k_ESteamNetworkingConfig_IP_SessionResumption = 65,
+
+	/// [connection int32] Maximum rate (packets per second) of handshake
+	/// packets we will process on a direct IP listen socket from any one
+	/// address prefix (/24 for IPv4, /64 for IPv6) that we don't have a
+	/// connection with.  Short bursts of up to twice this are allowed.
+	/// Excess packets are dropped before we even parse them.  Many clients
+	/// can share a prefix (e.g. behind carrier grade NAT), so only set this
+	/// if you know your players.  0 disables the limit.  Default is 0.
+	k_ESteamNetworkingConfig_IP_HandshakeRatePerPrefix = 66,
+
+	/// [connection int32] Microseconds per second of processing time a
+	/// direct IP listen socket will spend on connect requests (checking
+	/// certs, setting up the connection, etc).  Requests beyond that (after
+	/// the cheap challenge checks) are queued, and served as budget becomes
+	/// available, giving priority to address prefixes that are not sending
+	/// us much traffic.  0 means no limit.  Default is 250000 (a quarter of
+	/// one core).
+	k_ESteamNetworkingConfig_IP_HandshakeCPUBudget = 67,
+
 	/// [connection int32] Do not send UDP packets with a payload of
 	/// larger than N bytes.  If you set this, k_ESteamNetworkingConfig_MTU_DataSize
 	/// is automatically adjusted
@@ -1286,6 +1709,18 @@ enum ESteamNetworkingConfigValue
 	/// the peer to also modify their value in order for encryption to be disabled.)
 	k_ESteamNetworkingConfig_Unencrypted = 34,
 
+	/// [connection int32] Which cipher to prefer, when encryption is used.
+	/// 0: Automatic (the default).  Prefer AES-256-GCM if this CPU has AES
+	///    instructions, otherwise prefer ChaCha20-Poly1305
+	/// 1: Prefer AES-256-GCM
+	/// 2: Prefer ChaCha20-Poly1305
+	///
+	/// Both ends must use the same cipher.  If either end prefers
+	/// ChaCha20-Poly1305, it will be used, since it is reasonably cheap
+	/// everywhere, while AES without hardware support is expensive.  (Peers
+	/// running older versions of this library only support AES-256-GCM.)
+	k_ESteamNetworkingConfig_CipherPreference = 68,
+
 	/// [connection int32] Set this to 1 on outbound connections and listen sockets,
 	/// to enable "symmetric connect mode", which is useful in the following
 	/// common peer-to-peer use case:
@@ -1702,6 +2137,55 @@ enum ESteamNetworkingConfigValue
 	k_ESteamNetworkingConfig_LogLevel_P2PRendezvous = 17, // [connection int32] P2P rendezvous messages
 	k_ESteamNetworkingConfig_LogLevel_SDRRelayPings = 18, // [global int32] Ping relays
 
+	/// [global int32] Number of records in the queue used to deliver spew
+	/// asynchronously.  0 (the default) means spew is written to the log
+	/// file and passed to your debug output function synchronously, on the
+	/// thread that generated it.  If nonzero, formatted spew is placed into
+	/// a lock-free ring buffer of this many records (rounded up to a power of
+	/// two), and a background thread writes it out in batches.  This means
+	/// your debug output function will be invoked from that background
+	/// thread.  If the queue fills up, messages are discarded and a count of
+	/// the dropped messages is reported when there is room again.  The size
+	/// is applied when the queue is first used; later changes only take effect
+	/// after the library is shut down and re-initialized.
+	k_ESteamNetworkingConfig_SpewAsyncQueueSize = 61,
+
+//
+// Performance metrics
+//
+	/// [global int32] If nonzero, collect library-wide performance counters
+	/// and latency histograms (socket call times, global lock wait and hold
+	/// times, etc), which can be fetched using ISteamNetworkingUtils::GetPerfMetrics.
+	/// The overhead is a few timer reads per packet.  Default is 0 (off).
+	k_ESteamNetworkingConfig_PerfMetrics = 62,
+
+//
+// Threading
+//
+	/// [global int32] Number of worker threads to use for the expensive parts
+	/// of the crypto handshake on incoming connections: checking signatures,
+	/// generating and signing our key exchange key, and key derivation.
+	/// 0 (the default) means this work is done inline, on whatever thread
+	/// holds the global lock.  When nonzero, a connection stays in the
+	/// connecting state while its crypto is in flight, and the rest of the
+	/// handshake resumes on the service thread when the work is done.  This
+	/// currently only applies to connections received on listen sockets
+	/// created with CreateListenSocketIP.  Raising the value adds threads;
+	/// lowering it does not take effect until the library is shut down.
+	/// Either way, the signature checks for a burst of connect requests on
+	/// those listen sockets are done together, after the sockets are drained.
+	k_ESteamNetworkingConfig_HandshakeWorkerThreads = 63,
+
+	/// [global int32] Number of ephemeral key exchange keypairs to keep
+	/// generated ahead of time.  Every connection needs a new one, and each
+	/// one is only ever used once.  Whenever one is taken from the pool, the
+	/// pool is topped back up to this size in the background, so accepting a
+	/// connection doesn't have to wait for the key generation.  The pool is
+	/// only used once a listen socket has been created.  (Before then, keys
+	/// are generated as needed, so a client making a few outbound connections
+	/// doesn't generate keys it won't use.)  0 disables the pool.  Default is 8.
+	k_ESteamNetworkingConfig_KeyExchangeKeyPoolSize = 64,
+
 //
 // Experimental values.  These are subject to be deleted or change at any time,
 // do not set them, except as a result of an explicit and advanced user opt-in,
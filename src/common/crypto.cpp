@@ -2,6 +2,15 @@
 
 #include "crypto.h"
 
+#if defined( _MSC_VER ) && ( defined( _M_IX86 ) || defined( _M_X64 ) )
+	#include <intrin.h>
+#elif defined( __i386__ ) || defined( __x86_64__ )
+	#include <cpuid.h>
+#elif defined( __linux__ ) && ( defined( __aarch64__ ) || defined( __arm__ ) )
+	#include <sys/auxv.h>
+	#include <asm/hwcap.h>
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // SipHash, used for challenge generation
@@ -98,6 +107,44 @@ uint64_t CCrypto::SipHash( const void *data, size_t inlen, const CCrypto::SipHas
   return b;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// CPU feature detection
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static bool DetectHardwareAES()
+{
+#if defined( _MSC_VER ) && ( defined( _M_IX86 ) || defined( _M_X64 ) )
+	int regs[4];
+	__cpuid( regs, 1 );
+	return ( regs[2] & ( 1<<25 ) ) != 0;
+#elif defined( __i386__ ) || defined( __x86_64__ )
+	unsigned int eax, ebx, ecx, edx;
+	if ( !__get_cpuid( 1, &eax, &ebx, &ecx, &edx ) )
+		return false;
+	return ( ecx & bit_AES ) != 0;
+#elif defined( __linux__ ) && defined( __aarch64__ )
+	return ( getauxval( AT_HWCAP ) & HWCAP_AES ) != 0;
+#elif defined( __linux__ ) && defined( __arm__ ) && defined( HWCAP2_AES )
+	return ( getauxval( AT_HWCAP2 ) & HWCAP2_AES ) != 0;
+#elif defined( __APPLE__ ) && defined( __aarch64__ )
+	// All Apple ARM64 chips have the crypto extensions
+	return true;
+#elif defined( _M_ARM64 )
+	// In practice, all Windows on ARM devices have the crypto extensions
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool CCrypto::HasHardwareAES()
+{
+	static const bool s_bHasHardwareAES = DetectHardwareAES();
+	return s_bHasHardwareAES;
+}
+
 #ifdef DBGFLAG_VALIDATE
 //-----------------------------------------------------------------------------
 // Purpose: validates memory structures
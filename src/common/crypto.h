@@ -29,6 +29,11 @@ public:
 protected:
 	void *m_ctx;
 
+	// Backend-specific alternate implementation (such as a hardware-specific
+	// fast path), used instead of m_ctx when the backend has one that handles
+	// these parameters.
+	void *m_pAccel = nullptr;
+
 	uint32 m_cbIV, m_cbTag;
 };
 
@@ -37,7 +42,8 @@ struct ISymmetricEncryptContext
 {
 	virtual ~ISymmetricEncryptContext() {}
 
-	// Encrypt data and append auth tag
+	// Encrypt data and append auth tag.  The output may be the same buffer
+	// as the input, to encrypt in place.
 	virtual bool Encrypt(
 		const void *pPlaintextData, size_t cbPlaintextData,
 		const void *pIV,
@@ -51,7 +57,9 @@ struct ISymmetricDecryptContext
 {
 	virtual ~ISymmetricDecryptContext() {}
 
-	// Decrypt data and check auth tag, which is assumed to be at the end
+	// Decrypt data and check auth tag, which is assumed to be at the end.
+	// The output may be the same buffer as the input, to decrypt in place.
+	// If the tag doesn't match, the contents of the output buffer are undefined.
 	virtual bool Decrypt(
 		const void *pEncryptedDataAndTag, size_t cbEncryptedDataAndTag,
 		const void *pIV,
@@ -110,6 +118,57 @@ public:
 	) override;
 };
 
+/// Base class for ChaCha20-Poly1305 (RFC 8439) encryption and decryption.
+/// This is a good choice on CPUs without AES instructions, where
+/// AES-GCM is slow.  Key is 256 bits, IV is 96 bits, and tag is 128 bits.
+class ChaCha20_Poly1305_CipherContext : public SymmetricCryptContextBase
+{
+public:
+
+	// Initialize context with the specified private key, IV size, and tag size
+	bool InitCipher( const void *pKey, size_t cbKey, size_t cbIV, size_t cbTag, bool bEncrypt );
+};
+
+/// Encryption context for ChaCha20-Poly1305
+class ChaCha20_Poly1305_EncryptContext final : public ChaCha20_Poly1305_CipherContext, public ISymmetricEncryptContext
+{
+public:
+
+	// Initialize context with the specified private key, IV size, and tag size
+	inline bool Init( const void *pKey, size_t cbKey, size_t cbIV, size_t cbTag )
+	{
+		return InitCipher( pKey, cbKey, cbIV, cbTag, true );
+	}
+
+	// Implements ISymmetricEncryptContext
+	virtual bool Encrypt(
+		const void *pPlaintextData, size_t cbPlaintextData,
+		const void *pIV,
+		void *pEncryptedDataAndTag, uint32 *pcbEncryptedDataAndTag,
+		const void *pAdditionalAuthenticationData, size_t cbAuthenticationData // Optional additional authentication data.  Not encrypted, but will be included in the tag, so it can be authenticated.
+	) override;
+};
+
+/// Decryption context for ChaCha20-Poly1305
+class ChaCha20_Poly1305_DecryptContext final : public ChaCha20_Poly1305_CipherContext, public ISymmetricDecryptContext
+{
+public:
+
+	// Initialize context with the specified private key, IV size, and tag size
+	inline bool Init( const void *pKey, size_t cbKey, size_t cbIV, size_t cbTag )
+	{
+		return InitCipher( pKey, cbKey, cbIV, cbTag, false );
+	}
+
+	// Implements ISymmetricDecryptContext
+	virtual bool Decrypt(
+		const void *pEncryptedDataAndTag, size_t cbEncryptedDataAndTag,
+		const void *pIV,
+		void *pPlaintextData, uint32 *pcbPlaintextData,
+		const void *pAdditionalAuthenticationData, size_t cbAuthenticationData // Optional additional authentication data.  Not encrypted, but will be included in the tag, so it can be authenticated.
+	) override;
+};
+
 namespace CCrypto
 {
 	void Init();
@@ -134,6 +193,15 @@ namespace CCrypto
 		size_t cbTag // Last N bytes in your buffer are assumed to be a tag, and will be checked
 	);
 
+	/// Return true if this CPU has instructions for AES.  If not, AES-GCM
+	/// will be slow, and ChaCha20-Poly1305 should be preferred.
+	bool HasHardwareAES();
+
+	/// Enable or disable any hardware-specific AES-GCM fast path.  Returns
+	/// true if the current backend has one and this CPU supports it.  Only
+	/// affects contexts initialized afterwards.  (For tests and benchmarks.)
+	bool SetAESGCMFastPathEnabled( bool bEnabled );
+
 	bool HexEncode( const void *pubData, const uint32 cubData, char *pchEncodedData, uint32 cchEncodedData );
 	bool HexDecode( const char *pchData, void *pubDecodedData, uint32 *pcubDecodedData );
 
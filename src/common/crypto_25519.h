@@ -146,6 +146,19 @@ public:
 	bool VerifySignature( const void *pData, size_t cbData, const CryptoSignature_t &signature ) const;
 };
 
+//-----------------------------------------------------------------------------
+// Purpose: One entry in a batch of signatures to be checked by
+//			CCrypto::VerifySignatureBatch
+//-----------------------------------------------------------------------------
+struct SignatureToVerify_t
+{
+	const void *m_pData;
+	size_t m_cbData;
+	const CECSigningPublicKey *m_pPublicKey;
+	const CryptoSignature_t *m_pSignature;
+	bool m_bValid; // Output
+};
+
 #ifdef VALVE_CRYPTO_ENABLE_25519
 
 namespace CCrypto
@@ -173,6 +186,20 @@ namespace CCrypto
 	// Legacy compatibility - use the key methods
 	inline void GenerateSignature( const void *pData, size_t cbData, const CECSigningPrivateKey &privateKey, CryptoSignature_t *pSignatureOut ) { privateKey.GenerateSignature( pData, cbData, pSignatureOut ); }
 	inline bool VerifySignature( const void *pData, size_t cbData, const CECSigningPublicKey &publicKey, const CryptoSignature_t &signature ) { return publicKey.VerifySignature( pData, cbData, signature ); }
+
+	// Check a batch of signatures, setting m_bValid for each one.  Returns true if
+	// they are all valid.  Only the ed25519-donna implementation (the BCrypt build)
+	// has a real batch check, which is considerably faster than checking them one
+	// at a time.  OpenSSL (the default) and libsodium have no batch primitive, so
+	// they just loop, and batching gains nothing.
+	bool VerifySignatureBatch( SignatureToVerify_t *pSignatures, int nSignatures );
+
+	// True if VerifySignatureBatch is actually faster than checking one at a time
+	#ifdef VALVE_CRYPTO_25519_DONNA
+		constexpr bool k_bHasFastSignatureBatchVerify = true;
+	#else
+		constexpr bool k_bHasFastSignatureBatchVerify = false;
+	#endif
 };
 
 #endif // #ifdef VALVE_CRYPTO_ENABLE_25519
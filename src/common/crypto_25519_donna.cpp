@@ -27,6 +27,7 @@ void curved25519_scalarmult_basepoint_sse2( curved25519_key pk, const curved2551
 void ed25519_publickey_sse2( const ed25519_secret_key sk, ed25519_public_key pk );
 int ed25519_sign_open_sse2( const unsigned char *m, size_t mlen, const ed25519_public_key pk, const ed25519_signature RS );
 void ed25519_sign_sse2( const unsigned char *m, size_t mlen, const ed25519_secret_key sk, const ed25519_public_key pk, ed25519_signature RS );
+int ed25519_sign_open_batch_sse2( const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid );
 
 #ifdef OSX // We can assume SSE2 for all Intel macs running 32-bit code
 #define CHOOSE_25519_IMPL( func ) func##_sse2
@@ -181,6 +182,72 @@ bool CECSigningPublicKey::VerifySignature( const void *pData, size_t cbData, con
 	return ret;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Random number source used by ed25519_sign_open_batch to pick the
+//			scalars for the combined check.  (Both the plain and SSE2 versions
+//			use this one.)
+//-----------------------------------------------------------------------------
+extern "C" void ed25519_randombytes_unsafe( void *p, size_t len )
+{
+	CCrypto::GenerateRandomBlock( p, (int)len );
+}
+
+bool CCrypto::VerifySignatureBatch( SignatureToVerify_t *pSignatures, int nSignatures )
+{
+	// Same as the max batch size used internally by ed25519-donna
+	const int k_nMaxChunk = 64;
+
+	bool bAllValid = true;
+	while ( nSignatures > 0 )
+	{
+		SignatureToVerify_t *pChunk[ k_nMaxChunk ];
+		uint8 bufPublicKey[ k_nMaxChunk ][ 32 ];
+		const unsigned char *m[ k_nMaxChunk ];
+		size_t mlen[ k_nMaxChunk ];
+		const unsigned char *pk[ k_nMaxChunk ];
+		const unsigned char *RS[ k_nMaxChunk ];
+		int valid[ k_nMaxChunk ];
+
+		int n = 0;
+		while ( nSignatures > 0 && n < k_nMaxChunk )
+		{
+			SignatureToVerify_t &sig = *pSignatures;
+			++pSignatures;
+			--nSignatures;
+
+			if ( !sig.m_pPublicKey->IsValid() )
+			{
+				AssertMsg( false, "Key not initialized, cannot verify signature" );
+				sig.m_bValid = false;
+				bAllValid = false;
+				continue;
+			}
+
+			sig.m_pPublicKey->GetRawData( bufPublicKey[n] );
+			pChunk[n] = &sig;
+			m[n] = (const unsigned char *)sig.m_pData;
+			mlen[n] = sig.m_cbData;
+			pk[n] = bufPublicKey[n];
+			RS[n] = *sig.m_pSignature;
+			++n;
+		}
+		if ( n == 0 )
+			continue;
+
+		// If the combined check fails, this falls back to checking each
+		// signature individually, so valid[] is always accurate.
+		CHOOSE_25519_IMPL( ed25519_sign_open_batch )( m, mlen, pk, RS, (size_t)n, valid );
+		for ( int i = 0 ; i < n ; ++i )
+		{
+			pChunk[i]->m_bValid = ( valid[i] != 0 );
+			if ( !pChunk[i]->m_bValid )
+				bAllValid = false;
+		}
+	}
+
+	return bAllValid;
+}
+
 bool CEC25519KeyBase::SetRawData( const void *pData, size_t cbData )
 {
 	if ( cbData != 32 )
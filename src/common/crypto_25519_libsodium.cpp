@@ -108,6 +108,20 @@ bool CECSigningPublicKey::VerifySignature( const void *pData, size_t cbData, con
 	return crypto_sign_ed25519_verify_detached( signature, static_cast<const unsigned char*>( pData ), cbData, CCryptoKeyBase_RawBuffer::GetRawDataPtr() ) == 0;
 }
 
+bool CCrypto::VerifySignatureBatch( SignatureToVerify_t *pSignatures, int nSignatures )
+{
+	// No batch verification available, just check them one by one
+	bool bAllValid = true;
+	for ( int i = 0 ; i < nSignatures ; ++i )
+	{
+		SignatureToVerify_t &sig = pSignatures[i];
+		sig.m_bValid = sig.m_pPublicKey->VerifySignature( sig.m_pData, sig.m_cbData, *sig.m_pSignature );
+		if ( !sig.m_bValid )
+			bAllValid = false;
+	}
+	return bAllValid;
+}
+
 bool CEC25519PrivateKeyBase::CachePublicKey()
 {
 	// Need to convert the private key into a public key here
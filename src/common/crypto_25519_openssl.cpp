@@ -193,6 +193,20 @@ bool CECSigningPublicKey::VerifySignature( const void *pData, size_t cbData, con
 	return r == 1;
 }
 
+bool CCrypto::VerifySignatureBatch( SignatureToVerify_t *pSignatures, int nSignatures )
+{
+	// No batch verification available, just check them one by one
+	bool bAllValid = true;
+	for ( int i = 0 ; i < nSignatures ; ++i )
+	{
+		SignatureToVerify_t &sig = pSignatures[i];
+		sig.m_bValid = sig.m_pPublicKey->VerifySignature( sig.m_pData, sig.m_cbData, *sig.m_pSignature );
+		if ( !sig.m_bValid )
+			bAllValid = false;
+	}
+	return bAllValid;
+}
+
 bool CEC25519PrivateKeyBase::CachePublicKey()
 {
 	EVP_PKEY *pkey = (EVP_PKEY*)m_evp_pkey;
@@ -3,6 +3,8 @@
 
 #ifdef VALVE_CRYPTO_BCRYPT
 
+#include "crypto_chacha20poly1305.h"
+
 #include <tier0/vprof.h>
 #include <tier1/utlmemory.h>
 
@@ -124,6 +126,13 @@ void SymmetricCryptContextBase::Wipe()
 {
 	delete (BCryptContext *)m_ctx;
 	m_ctx = NULL;
+	if ( m_pAccel )
+	{
+		// ChaCha20-Poly1305 key
+		SecureZeroMemory( m_pAccel, k_cbChaCha20Poly1305Key );
+		delete [] (uint8 *)m_pAccel;
+		m_pAccel = nullptr;
+	}
 	m_cbIV = 0;
 	m_cbTag = 0;
 }
@@ -230,6 +239,80 @@ bool AES_GCM_DecryptContext::Decrypt(
 	return NT_SUCCESS(status);
 }
 
+// BCrypt doesn't have ChaCha20-Poly1305, so use the portable implementation.
+// We just need to hold on to the key.
+bool ChaCha20_Poly1305_CipherContext::InitCipher( const void *pKey, size_t cbKey, size_t cbIV, size_t cbTag, bool bEncrypt )
+{
+	Wipe();
+	if ( cbKey != k_cbChaCha20Poly1305Key || cbIV != k_cbChaCha20Poly1305Nonce || cbTag != k_cbChaCha20Poly1305Tag )
+	{
+		AssertMsg( false, "Invalid ChaCha20-Poly1305 parameters" );
+		return false;
+	}
+
+	uint8 *pKeyCopy = new uint8[ k_cbChaCha20Poly1305Key ];
+	memcpy( pKeyCopy, pKey, k_cbChaCha20Poly1305Key );
+	m_pAccel = pKeyCopy;
+	m_cbIV = (uint32)cbIV;
+	m_cbTag = (uint32)cbTag;
+	return true;
+}
+
+bool ChaCha20_Poly1305_EncryptContext::Encrypt(
+		const void *pPlaintextData, size_t cbPlaintextData,
+		const void *pIV,
+		void *pEncryptedDataAndTag, uint32 *pcbEncryptedDataAndTag,
+		const void *pAdditionalAuthenticationData, size_t cbAuthenticationData
+		)
+{
+	if ( !m_pAccel || cbPlaintextData + k_cbChaCha20Poly1305Tag > *pcbEncryptedDataAndTag )
+	{
+		AssertMsg( m_pAccel, "Not initialized!" );
+		*pcbEncryptedDataAndTag = 0;
+		return false;
+	}
+
+	ChaCha20Poly1305_Encrypt( (const uint8 *)m_pAccel, (const uint8 *)pIV,
+		pPlaintextData, cbPlaintextData,
+		pAdditionalAuthenticationData, cbAuthenticationData,
+		pEncryptedDataAndTag );
+	*pcbEncryptedDataAndTag = uint32( cbPlaintextData + k_cbChaCha20Poly1305Tag );
+	return true;
+}
+
+bool ChaCha20_Poly1305_DecryptContext::Decrypt(
+		const void *pEncryptedDataAndTag, size_t cbEncryptedDataAndTag,
+		const void *pIV,
+		void *pPlaintextData, uint32 *pcbPlaintextData,
+		const void *pAdditionalAuthenticationData, size_t cbAuthenticationData
+		)
+{
+	if ( !m_pAccel || cbEncryptedDataAndTag < k_cbChaCha20Poly1305Tag || cbEncryptedDataAndTag - k_cbChaCha20Poly1305Tag > *pcbPlaintextData )
+	{
+		*pcbPlaintextData = 0;
+		return false;
+	}
+
+	size_t cbCiphertext = cbEncryptedDataAndTag - k_cbChaCha20Poly1305Tag;
+	*pcbPlaintextData = 0;
+	if ( !ChaCha20Poly1305_Decrypt( (const uint8 *)m_pAccel, (const uint8 *)pIV,
+		pEncryptedDataAndTag, cbCiphertext,
+		(const uint8 *)pEncryptedDataAndTag + cbCiphertext,
+		pAdditionalAuthenticationData, cbAuthenticationData,
+		pPlaintextData ) )
+	{
+		return false;
+	}
+	*pcbPlaintextData = (uint32)cbCiphertext;
+	return true;
+}
+
+bool CCrypto::SetAESGCMFastPathEnabled( bool bEnabled )
+{
+	// BCrypt picks its own implementation
+	return false;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Generate a SHA256 hash
 // Input:	pchInput -			Plaintext string of item to hash (null terminated)
@@ -0,0 +1,389 @@
+//========= Copyright Valve LLC, All rights reserved. ========================
+//
+// Purpose: Portable ChaCha20-Poly1305 AEAD (RFC 8439)
+//
+// Poly1305 uses 26-bit limbs (the "donna-32" approach), which only needs
+// 32x32->64 multiplies and so is reasonable everywhere.  The ChaCha20 block
+// function keeps each row of the state in a vector register and works on
+// columns and then diagonals, which maps directly onto SSE2 and NEON.
+//
+//=============================================================================
+
+#include "crypto_chacha20poly1305.h"
+#include <tier0/dbg.h>
+#include <string.h>
+
+#include "tier0/memdbgoff.h"
+#if defined( _M_X64 ) || defined( __x86_64__ ) || defined( __SSE2__ ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+	#include <emmintrin.h>
+	#define CHACHA20_SSE2
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ ) || defined( _M_ARM64 )
+	#include <arm_neon.h>
+	#define CHACHA20_NEON
+#endif
+#include "tier0/memdbgon.h"
+
+static inline uint32 Load32LE( const uint8 *p )
+{
+	return (uint32)p[0] | ( (uint32)p[1] << 8 ) | ( (uint32)p[2] << 16 ) | ( (uint32)p[3] << 24 );
+}
+
+static inline void Store32LE( uint8 *p, uint32 x )
+{
+	p[0] = (uint8)x;
+	p[1] = (uint8)( x >> 8 );
+	p[2] = (uint8)( x >> 16 );
+	p[3] = (uint8)( x >> 24 );
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// ChaCha20
+//
+/////////////////////////////////////////////////////////////////////////////
+
+static void ChaCha20_InitState( uint32 state[16], const uint8 *pKey, const uint8 *pNonce )
+{
+	// "expand 32-byte k"
+	state[0] = 0x61707865;
+	state[1] = 0x3320646e;
+	state[2] = 0x79622d32;
+	state[3] = 0x6b206574;
+	for ( int i = 0 ; i < 8 ; ++i )
+		state[4+i] = Load32LE( pKey + i*4 );
+	state[12] = 0; // block counter
+	for ( int i = 0 ; i < 3 ; ++i )
+		state[13+i] = Load32LE( pNonce + i*4 );
+}
+
+// Generate one 64-byte block of keystream for the current counter
+static void ChaCha20_Block( const uint32 state[16], uint8 out[64] )
+{
+#if defined( CHACHA20_SSE2 )
+
+	#define ROTL_SSE2( x, n ) _mm_or_si128( _mm_slli_epi32( x, n ), _mm_srli_epi32( x, 32-n ) )
+	const __m128i a0 = _mm_loadu_si128( (const __m128i *)&state[0] );
+	const __m128i b0 = _mm_loadu_si128( (const __m128i *)&state[4] );
+	const __m128i c0 = _mm_loadu_si128( (const __m128i *)&state[8] );
+	const __m128i d0 = _mm_loadu_si128( (const __m128i *)&state[12] );
+	__m128i a = a0, b = b0, c = c0, d = d0;
+	for ( int i = 0 ; i < 10 ; ++i )
+	{
+		// Column round
+		a = _mm_add_epi32( a, b ); d = _mm_xor_si128( d, a ); d = ROTL_SSE2( d, 16 );
+		c = _mm_add_epi32( c, d ); b = _mm_xor_si128( b, c ); b = ROTL_SSE2( b, 12 );
+		a = _mm_add_epi32( a, b ); d = _mm_xor_si128( d, a ); d = ROTL_SSE2( d, 8 );
+		c = _mm_add_epi32( c, d ); b = _mm_xor_si128( b, c ); b = ROTL_SSE2( b, 7 );
+
+		// Rotate rows so the diagonals line up as columns
+		b = _mm_shuffle_epi32( b, 0x39 );
+		c = _mm_shuffle_epi32( c, 0x4e );
+		d = _mm_shuffle_epi32( d, 0x93 );
+
+		// Diagonal round
+		a = _mm_add_epi32( a, b ); d = _mm_xor_si128( d, a ); d = ROTL_SSE2( d, 16 );
+		c = _mm_add_epi32( c, d ); b = _mm_xor_si128( b, c ); b = ROTL_SSE2( b, 12 );
+		a = _mm_add_epi32( a, b ); d = _mm_xor_si128( d, a ); d = ROTL_SSE2( d, 8 );
+		c = _mm_add_epi32( c, d ); b = _mm_xor_si128( b, c ); b = ROTL_SSE2( b, 7 );
+
+		// And back
+		b = _mm_shuffle_epi32( b, 0x93 );
+		c = _mm_shuffle_epi32( c, 0x4e );
+		d = _mm_shuffle_epi32( d, 0x39 );
+	}
+	#undef ROTL_SSE2
+	_mm_storeu_si128( (__m128i *)( out ), _mm_add_epi32( a, a0 ) );
+	_mm_storeu_si128( (__m128i *)( out + 16 ), _mm_add_epi32( b, b0 ) );
+	_mm_storeu_si128( (__m128i *)( out + 32 ), _mm_add_epi32( c, c0 ) );
+	_mm_storeu_si128( (__m128i *)( out + 48 ), _mm_add_epi32( d, d0 ) );
+
+#elif defined( CHACHA20_NEON )
+
+	#define ROTL_NEON( x, n ) vsriq_n_u32( vshlq_n_u32( x, n ), x, 32-n )
+	const uint32x4_t a0 = vld1q_u32( &state[0] );
+	const uint32x4_t b0 = vld1q_u32( &state[4] );
+	const uint32x4_t c0 = vld1q_u32( &state[8] );
+	const uint32x4_t d0 = vld1q_u32( &state[12] );
+	uint32x4_t a = a0, b = b0, c = c0, d = d0;
+	for ( int i = 0 ; i < 10 ; ++i )
+	{
+		a = vaddq_u32( a, b ); d = veorq_u32( d, a ); d = vreinterpretq_u32_u16( vrev32q_u16( vreinterpretq_u16_u32( d ) ) );
+		c = vaddq_u32( c, d ); b = veorq_u32( b, c ); b = ROTL_NEON( b, 12 );
+		a = vaddq_u32( a, b ); d = veorq_u32( d, a ); d = ROTL_NEON( d, 8 );
+		c = vaddq_u32( c, d ); b = veorq_u32( b, c ); b = ROTL_NEON( b, 7 );
+
+		b = vextq_u32( b, b, 1 );
+		c = vextq_u32( c, c, 2 );
+		d = vextq_u32( d, d, 3 );
+
+		a = vaddq_u32( a, b ); d = veorq_u32( d, a ); d = vreinterpretq_u32_u16( vrev32q_u16( vreinterpretq_u16_u32( d ) ) );
+		c = vaddq_u32( c, d ); b = veorq_u32( b, c ); b = ROTL_NEON( b, 12 );
+		a = vaddq_u32( a, b ); d = veorq_u32( d, a ); d = ROTL_NEON( d, 8 );
+		c = vaddq_u32( c, d ); b = veorq_u32( b, c ); b = ROTL_NEON( b, 7 );
+
+		b = vextq_u32( b, b, 3 );
+		c = vextq_u32( c, c, 2 );
+		d = vextq_u32( d, d, 1 );
+	}
+	#undef ROTL_NEON
+	vst1q_u8( out, vreinterpretq_u8_u32( vaddq_u32( a, a0 ) ) );
+	vst1q_u8( out + 16, vreinterpretq_u8_u32( vaddq_u32( b, b0 ) ) );
+	vst1q_u8( out + 32, vreinterpretq_u8_u32( vaddq_u32( c, c0 ) ) );
+	vst1q_u8( out + 48, vreinterpretq_u8_u32( vaddq_u32( d, d0 ) ) );
+
+#else
+
+	#define ROTL32( x, n ) ( ( (x) << (n) ) | ( (x) >> ( 32-(n) ) ) )
+	#define QUARTERROUND( a, b, c, d ) \
+		x[a] += x[b]; x[d] ^= x[a]; x[d] = ROTL32( x[d], 16 ); \
+		x[c] += x[d]; x[b] ^= x[c]; x[b] = ROTL32( x[b], 12 ); \
+		x[a] += x[b]; x[d] ^= x[a]; x[d] = ROTL32( x[d], 8 ); \
+		x[c] += x[d]; x[b] ^= x[c]; x[b] = ROTL32( x[b], 7 );
+	uint32 x[16];
+	memcpy( x, state, sizeof(x) );
+	for ( int i = 0 ; i < 10 ; ++i )
+	{
+		QUARTERROUND( 0, 4,  8, 12 )
+		QUARTERROUND( 1, 5,  9, 13 )
+		QUARTERROUND( 2, 6, 10, 14 )
+		QUARTERROUND( 3, 7, 11, 15 )
+		QUARTERROUND( 0, 5, 10, 15 )
+		QUARTERROUND( 1, 6, 11, 12 )
+		QUARTERROUND( 2, 7,  8, 13 )
+		QUARTERROUND( 3, 4,  9, 14 )
+	}
+	#undef QUARTERROUND
+	#undef ROTL32
+	for ( int i = 0 ; i < 16 ; ++i )
+		Store32LE( out + i*4, x[i] + state[i] );
+	SecureZeroMemory( x, sizeof(x) );
+
+#endif
+}
+
+// XOR the input with the keystream, starting at block counter 1
+static void ChaCha20_Xor( uint32 state[16], const uint8 *pIn, uint8 *pOut, size_t cb )
+{
+	uint8 keystream[64];
+	state[12] = 1;
+	while ( cb > 0 )
+	{
+		ChaCha20_Block( state, keystream );
+		++state[12];
+		size_t n = cb < 64 ? cb : 64;
+		for ( size_t i = 0 ; i < n ; ++i )
+			pOut[i] = pIn[i] ^ keystream[i];
+		pIn += n;
+		pOut += n;
+		cb -= n;
+	}
+	SecureZeroMemory( keystream, sizeof(keystream) );
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// Poly1305
+//
+/////////////////////////////////////////////////////////////////////////////
+
+struct Poly1305State
+{
+	uint32 r[5];
+	uint32 h[5];
+	uint32 pad[4];
+};
+
+static void Poly1305_Init( Poly1305State &st, const uint8 key[32] )
+{
+	// r &= 0xffffffc0ffffffc0ffffffc0fffffff
+	st.r[0] = ( Load32LE( key +  0 )      ) & 0x3ffffff;
+	st.r[1] = ( Load32LE( key +  3 ) >> 2 ) & 0x3ffff03;
+	st.r[2] = ( Load32LE( key +  6 ) >> 4 ) & 0x3ffc0ff;
+	st.r[3] = ( Load32LE( key +  9 ) >> 6 ) & 0x3f03fff;
+	st.r[4] = ( Load32LE( key + 12 ) >> 8 ) & 0x00fffff;
+
+	memset( st.h, 0, sizeof(st.h) );
+
+	for ( int i = 0 ; i < 4 ; ++i )
+		st.pad[i] = Load32LE( key + 16 + i*4 );
+}
+
+// Absorb full 16-byte blocks.  The AEAD construction zero-pads everything
+// to a multiple of 16, so we never need the final partial block handling
+static void Poly1305_Blocks( Poly1305State &st, const uint8 *m, size_t cb )
+{
+	const uint32 hibit = 1 << 24;
+	const uint32 r0 = st.r[0], r1 = st.r[1], r2 = st.r[2], r3 = st.r[3], r4 = st.r[4];
+	const uint32 s1 = r1*5, s2 = r2*5, s3 = r3*5, s4 = r4*5;
+	uint32 h0 = st.h[0], h1 = st.h[1], h2 = st.h[2], h3 = st.h[3], h4 = st.h[4];
+
+	Assert( cb % 16 == 0 );
+	while ( cb >= 16 )
+	{
+		// h += m[i]
+		h0 += ( Load32LE( m +  0 )      ) & 0x3ffffff;
+		h1 += ( Load32LE( m +  3 ) >> 2 ) & 0x3ffffff;
+		h2 += ( Load32LE( m +  6 ) >> 4 ) & 0x3ffffff;
+		h3 += ( Load32LE( m +  9 ) >> 6 ) & 0x3ffffff;
+		h4 += ( Load32LE( m + 12 ) >> 8 ) | hibit;
+
+		// h *= r
+		uint64 d0 = (uint64)h0*r0 + (uint64)h1*s4 + (uint64)h2*s3 + (uint64)h3*s2 + (uint64)h4*s1;
+		uint64 d1 = (uint64)h0*r1 + (uint64)h1*r0 + (uint64)h2*s4 + (uint64)h3*s3 + (uint64)h4*s2;
+		uint64 d2 = (uint64)h0*r2 + (uint64)h1*r1 + (uint64)h2*r0 + (uint64)h3*s4 + (uint64)h4*s3;
+		uint64 d3 = (uint64)h0*r3 + (uint64)h1*r2 + (uint64)h2*r1 + (uint64)h3*r0 + (uint64)h4*s4;
+		uint64 d4 = (uint64)h0*r4 + (uint64)h1*r3 + (uint64)h2*r2 + (uint64)h3*r1 + (uint64)h4*r0;
+
+		// (partial) h %= p
+		uint32 c;
+		c = (uint32)( d0 >> 26 ); h0 = (uint32)d0 & 0x3ffffff;
+		d1 += c; c = (uint32)( d1 >> 26 ); h1 = (uint32)d1 & 0x3ffffff;
+		d2 += c; c = (uint32)( d2 >> 26 ); h2 = (uint32)d2 & 0x3ffffff;
+		d3 += c; c = (uint32)( d3 >> 26 ); h3 = (uint32)d3 & 0x3ffffff;
+		d4 += c; c = (uint32)( d4 >> 26 ); h4 = (uint32)d4 & 0x3ffffff;
+		h0 += c*5; c = h0 >> 26; h0 &= 0x3ffffff;
+		h1 += c;
+
+		m += 16;
+		cb -= 16;
+	}
+
+	st.h[0] = h0; st.h[1] = h1; st.h[2] = h2; st.h[3] = h3; st.h[4] = h4;
+}
+
+// Absorb data, zero-padded to a multiple of 16 bytes
+static void Poly1305_BlocksPadded( Poly1305State &st, const uint8 *m, size_t cb )
+{
+	size_t cbFull = cb & ~(size_t)15;
+	Poly1305_Blocks( st, m, cbFull );
+	if ( cb > cbFull )
+	{
+		uint8 block[16];
+		memset( block, 0, sizeof(block) );
+		memcpy( block, m + cbFull, cb - cbFull );
+		Poly1305_Blocks( st, block, 16 );
+	}
+}
+
+static void Poly1305_Finish( Poly1305State &st, uint8 mac[16] )
+{
+	uint32 h0 = st.h[0], h1 = st.h[1], h2 = st.h[2], h3 = st.h[3], h4 = st.h[4];
+
+	// Fully carry h
+	uint32 c;
+	c = h1 >> 26; h1 &= 0x3ffffff;
+	h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+	h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+	h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+	h0 += c*5; c = h0 >> 26; h0 &= 0x3ffffff;
+	h1 += c;
+
+	// Compute h + -p
+	uint32 g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+	uint32 g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+	uint32 g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+	uint32 g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+	uint32 g4 = h4 + c - ( 1 << 26 );
+
+	// Select h if h < p, or h + -p if h >= p.  (Constant time)
+	uint32 mask = ( g4 >> 31 ) - 1;
+	g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+	mask = ~mask;
+	h0 = ( h0 & mask ) | g0;
+	h1 = ( h1 & mask ) | g1;
+	h2 = ( h2 & mask ) | g2;
+	h3 = ( h3 & mask ) | g3;
+	h4 = ( h4 & mask ) | g4;
+
+	// h = h % 2^128
+	h0 = ( ( h0       ) | ( h1 << 26 ) );
+	h1 = ( ( h1 >>  6 ) | ( h2 << 20 ) );
+	h2 = ( ( h2 >> 12 ) | ( h3 << 14 ) );
+	h3 = ( ( h3 >> 18 ) | ( h4 <<  8 ) );
+
+	// mac = ( h + pad ) % 2^128
+	uint64 f;
+	f = (uint64)h0 + st.pad[0]            ; h0 = (uint32)f;
+	f = (uint64)h1 + st.pad[1] + ( f >> 32 ); h1 = (uint32)f;
+	f = (uint64)h2 + st.pad[2] + ( f >> 32 ); h2 = (uint32)f;
+	f = (uint64)h3 + st.pad[3] + ( f >> 32 ); h3 = (uint32)f;
+
+	Store32LE( mac +  0, h0 );
+	Store32LE( mac +  4, h1 );
+	Store32LE( mac +  8, h2 );
+	Store32LE( mac + 12, h3 );
+
+	SecureZeroMemory( &st, sizeof(st) );
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// AEAD construction
+//
+/////////////////////////////////////////////////////////////////////////////
+
+static void ComputeTag( uint32 state[16], const uint8 *pAAD, size_t cbAAD, const uint8 *pCiphertext, size_t cbCiphertext, uint8 tag[16] )
+{
+	// One-time Poly1305 key is the first 32 bytes of keystream block 0
+	uint8 block0[64];
+	state[12] = 0;
+	ChaCha20_Block( state, block0 );
+
+	Poly1305State poly;
+	Poly1305_Init( poly, block0 );
+	SecureZeroMemory( block0, sizeof(block0) );
+
+	Poly1305_BlocksPadded( poly, pAAD, cbAAD );
+	Poly1305_BlocksPadded( poly, pCiphertext, cbCiphertext );
+
+	uint8 lengths[16];
+	Store32LE( lengths +  0, (uint32)cbAAD );
+	Store32LE( lengths +  4, (uint32)( (uint64)cbAAD >> 32 ) );
+	Store32LE( lengths +  8, (uint32)cbCiphertext );
+	Store32LE( lengths + 12, (uint32)( (uint64)cbCiphertext >> 32 ) );
+	Poly1305_Blocks( poly, lengths, 16 );
+
+	Poly1305_Finish( poly, tag );
+}
+
+void ChaCha20Poly1305_Encrypt(
+	const uint8 *pKey, const uint8 *pNonce,
+	const void *pPlaintext, size_t cbPlaintext,
+	const void *pAAD, size_t cbAAD,
+	void *pCiphertextAndTag )
+{
+	uint32 state[16];
+	ChaCha20_InitState( state, pKey, pNonce );
+
+	uint8 *pOut = (uint8 *)pCiphertextAndTag;
+	ChaCha20_Xor( state, (const uint8 *)pPlaintext, pOut, cbPlaintext );
+	ComputeTag( state, (const uint8 *)pAAD, cbAAD, pOut, cbPlaintext, pOut + cbPlaintext );
+
+	SecureZeroMemory( state, sizeof(state) );
+}
+
+bool ChaCha20Poly1305_Decrypt(
+	const uint8 *pKey, const uint8 *pNonce,
+	const void *pCiphertext, size_t cbCiphertext,
+	const void *pTag,
+	const void *pAAD, size_t cbAAD,
+	void *pPlaintext )
+{
+	uint32 state[16];
+	ChaCha20_InitState( state, pKey, pNonce );
+
+	uint8 tag[16];
+	ComputeTag( state, (const uint8 *)pAAD, cbAAD, (const uint8 *)pCiphertext, cbCiphertext, tag );
+
+	// Constant time comparison
+	const uint8 *pExpectedTag = (const uint8 *)pTag;
+	uint8 diff = 0;
+	for ( int i = 0 ; i < 16 ; ++i )
+		diff |= tag[i] ^ pExpectedTag[i];
+	bool bOK = ( diff == 0 );
+	if ( bOK )
+		ChaCha20_Xor( state, (const uint8 *)pCiphertext, (uint8 *)pPlaintext, cbCiphertext );
+
+	SecureZeroMemory( state, sizeof(state) );
+	return bOK;
+}
@@ -0,0 +1,36 @@
+//========= Copyright Valve LLC, All rights reserved. ========================
+//
+// Purpose: Portable ChaCha20-Poly1305 AEAD (RFC 8439).  This is used by
+// crypto backends that don't provide their own implementation.  The ChaCha20
+// block function is vectorized with SSE2 or NEON where available.
+//
+//=============================================================================
+
+#ifndef CRYPTO_CHACHA20POLY1305_H
+#define CRYPTO_CHACHA20POLY1305_H
+#pragma once
+
+#include <tier0/platform.h>
+
+const size_t k_cbChaCha20Poly1305Key = 32;
+const size_t k_cbChaCha20Poly1305Nonce = 12;
+const size_t k_cbChaCha20Poly1305Tag = 16;
+
+/// Encrypt the plaintext and write the 16-byte tag immediately after the
+/// ciphertext.  Input and output may be the same buffer.
+extern void ChaCha20Poly1305_Encrypt(
+	const uint8 *pKey, const uint8 *pNonce,
+	const void *pPlaintext, size_t cbPlaintext,
+	const void *pAAD, size_t cbAAD,
+	void *pCiphertextAndTag );
+
+/// Check the tag, and if it's valid, decrypt.  The tag is checked before
+/// anything is written to pPlaintext.  Input and output may be the same buffer.
+extern bool ChaCha20Poly1305_Decrypt(
+	const uint8 *pKey, const uint8 *pNonce,
+	const void *pCiphertext, size_t cbCiphertext,
+	const void *pTag,
+	const void *pAAD, size_t cbAAD,
+	void *pPlaintext );
+
+#endif // CRYPTO_CHACHA20POLY1305_H
@@ -6,6 +6,7 @@
 #include "tier0/memdbgoff.h"
 #include <sodium/core.h>
 #include <sodium/crypto_aead_aes256gcm.h>
+#include <sodium/crypto_aead_chacha20poly1305.h>
 #include <sodium/crypto_auth_hmacsha256.h>
 #include <sodium/crypto_hash_sha256.h>
 #include <sodium/randombytes.h>
@@ -143,6 +144,94 @@ void CCrypto::Init()
 	}
 }
 
+bool ChaCha20_Poly1305_CipherContext::InitCipher( const void *pKey, size_t cbKey, size_t cbIV, size_t cbTag, bool bEncrypt )
+{
+	if ( cbKey != crypto_aead_chacha20poly1305_ietf_KEYBYTES || cbIV != crypto_aead_chacha20poly1305_ietf_NPUBBYTES || cbTag != crypto_aead_chacha20poly1305_ietf_ABYTES )
+	{
+		AssertMsg( false, "Invalid ChaCha20-Poly1305 parameters" );
+		return false;
+	}
+
+	Wipe();
+
+	// There is no precomputation, just keep a copy of the key in secure memory
+	m_ctx = sodium_malloc( crypto_aead_chacha20poly1305_ietf_KEYBYTES );
+	if ( !m_ctx )
+		return false;
+	memcpy( m_ctx, pKey, crypto_aead_chacha20poly1305_ietf_KEYBYTES );
+
+	m_cbIV = cbIV;
+	m_cbTag = cbTag;
+	return true;
+}
+
+bool ChaCha20_Poly1305_EncryptContext::Encrypt(
+		const void *pPlaintextData, size_t cbPlaintextData,
+		const void *pIV,
+		void *pEncryptedDataAndTag, uint32 *pcbEncryptedDataAndTag,
+		const void *pAdditionalAuthenticationData, size_t cbAuthenticationData
+		)
+{
+	// Make sure caller's buffer is big enough to hold the result.
+	if ( cbPlaintextData + crypto_aead_chacha20poly1305_ietf_ABYTES > *pcbEncryptedDataAndTag )
+	{
+		*pcbEncryptedDataAndTag = 0;
+		return false;
+	}
+
+	unsigned long long cbEncryptedDataAndTag_longlong;
+	if ( crypto_aead_chacha20poly1305_ietf_encrypt(
+			static_cast<unsigned char*>( pEncryptedDataAndTag ), &cbEncryptedDataAndTag_longlong,
+			static_cast<const unsigned char*>( pPlaintextData ), cbPlaintextData,
+			static_cast<const unsigned char*>( pAdditionalAuthenticationData ), cbAuthenticationData,
+			nullptr,
+			static_cast<const unsigned char*>( pIV ),
+			static_cast<const unsigned char*>( m_ctx )
+			) != 0
+	) {
+		AssertMsg( false, "crypto_aead_chacha20poly1305_ietf_encrypt failed" );
+		*pcbEncryptedDataAndTag = 0;
+		return false;
+	}
+
+	*pcbEncryptedDataAndTag = cbEncryptedDataAndTag_longlong;
+	return true;
+}
+
+bool ChaCha20_Poly1305_DecryptContext::Decrypt(
+		const void *pEncryptedDataAndTag, size_t cbEncryptedDataAndTag,
+		const void *pIV,
+		void *pPlaintextData, uint32 *pcbPlaintextData,
+		const void *pAdditionalAuthenticationData, size_t cbAuthenticationData
+		)
+{
+	// Make sure caller's buffer is big enough to hold the result
+	if ( cbEncryptedDataAndTag > *pcbPlaintextData + crypto_aead_chacha20poly1305_ietf_ABYTES )
+	{
+		*pcbPlaintextData = 0;
+		return false;
+	}
+
+	unsigned long long cbPlaintextData_longlong = 0;
+	const int nDecryptResult = crypto_aead_chacha20poly1305_ietf_decrypt(
+			static_cast<unsigned char*>( pPlaintextData ), &cbPlaintextData_longlong,
+			nullptr,
+			static_cast<const unsigned char*>( pEncryptedDataAndTag ), cbEncryptedDataAndTag,
+			static_cast<const unsigned char*>( pAdditionalAuthenticationData ), cbAuthenticationData,
+			static_cast<const unsigned char*>( pIV ), static_cast<const unsigned char*>( m_ctx )
+			);
+
+	*pcbPlaintextData = cbPlaintextData_longlong;
+
+	return nDecryptResult == 0;
+}
+
+bool CCrypto::SetAESGCMFastPathEnabled( bool bEnabled )
+{
+	// libsodium already uses AES-NI, and has no slow path
+	return false;
+}
+
 void CCrypto::GenerateRandomBlock( void *pubDest, int cubDest )
 {
 	VPROF_BUDGET( "CCrypto::GenerateRandomBlock", VPROF_BUDGETGROUP_ENCRYPTION );
@@ -0,0 +1,455 @@
+//========= Copyright Valve LLC, All rights reserved. ========================
+//
+// Purpose: AES-GCM using AES-NI and PCLMULQDQ.
+//
+// GHASH uses the bit-reflected multiplication described in the Intel white
+// paper "Intel Carry-Less Multiplication Instruction and its Usage for
+// Computing the GCM Mode" (Gueron & Kounavis).  We precompute H^1..H^4 when
+// the key is set, so that blocks can be hashed four at a time, with a single
+// reduction per four blocks.  Counter mode encryption is also done four
+// blocks at a time, to keep the AES pipeline full.
+//
+// This is tuned for small packets.  We do not attempt to stitch together
+// the CTR and GHASH passes, or to use wider (VAES / AVX-512) instructions.
+//
+//=============================================================================
+
+#include "crypto_symmetric_aesni.h"
+
+#ifdef VALVE_CRYPTO_AESNI_GCM
+
+#include <tier0/dbg.h>
+#include <string.h>
+
+#include "tier0/memdbgoff.h"
+#ifdef _MSC_VER
+	#include <intrin.h>
+#else
+	#include <cpuid.h>
+#endif
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <smmintrin.h>
+#include <wmmintrin.h>
+#include "tier0/memdbgon.h"
+
+// Allow the intrinsics to be used in specific functions, without needing
+// to compile the whole file (or project) with -maes, etc.  The caller must
+// check AESNI_GCM_BSupported before calling any of these.
+#if defined( __GNUC__ ) || defined( __clang__ )
+	#define AESNI_TARGET __attribute__(( target( "sse2,ssse3,sse4.1,aes,pclmul" ) ))
+#else
+	#define AESNI_TARGET
+#endif
+
+struct AESNI_GCM_Key
+{
+	/// AES round keys.  AES-128 uses 11, AES-256 uses 15
+	__m128i m_rk[15];
+
+	/// Byte-reflected powers of the hash key.  m_H[i] = H^(i+1)
+	__m128i m_H[4];
+
+	/// Number of AES rounds.  10 or 14
+	int m_nRounds;
+};
+
+static bool CheckCPUSupport()
+{
+	uint32 ecx;
+	#ifdef _MSC_VER
+		int regs[4];
+		__cpuid( regs, 1 );
+		ecx = (uint32)regs[2];
+	#else
+		unsigned int eax, ebx, ecx_, edx;
+		if ( !__get_cpuid( 1, &eax, &ebx, &ecx_, &edx ) )
+			return false;
+		ecx = ecx_;
+	#endif
+
+	const uint32 k_nPCLMULQDQ = 1<<1;
+	const uint32 k_nSSSE3 = 1<<9;
+	const uint32 k_nSSE41 = 1<<19;
+	const uint32 k_nAES = 1<<25;
+	const uint32 k_nNeeded = k_nPCLMULQDQ | k_nSSSE3 | k_nSSE41 | k_nAES;
+	return ( ecx & k_nNeeded ) == k_nNeeded;
+}
+
+bool AESNI_GCM_BSupported()
+{
+	static const bool s_bSupported = CheckCPUSupport();
+	return s_bSupported;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// AES
+//
+/////////////////////////////////////////////////////////////////////////////
+
+// Return key ^ (key<<32) ^ (key<<64) ^ (key<<96).  This is the "running
+// XOR" of the previous round key's words used by the key schedule
+static AESNI_TARGET inline __m128i KeyScheduleXorShifted( __m128i key )
+{
+	key = _mm_xor_si128( key, _mm_slli_si128( key, 4 ) );
+	key = _mm_xor_si128( key, _mm_slli_si128( key, 4 ) );
+	return _mm_xor_si128( key, _mm_slli_si128( key, 4 ) );
+}
+
+// aeskeygenassist needs an immediate operand, so these have to be macros
+#define AES128_EXPAND( i, rcon ) \
+	rk[i] = _mm_xor_si128( KeyScheduleXorShifted( rk[i-1] ), _mm_shuffle_epi32( _mm_aeskeygenassist_si128( rk[i-1], rcon ), 0xff ) )
+#define AES256_EXPAND_EVEN( i, rcon ) \
+	rk[i] = _mm_xor_si128( KeyScheduleXorShifted( rk[i-2] ), _mm_shuffle_epi32( _mm_aeskeygenassist_si128( rk[i-1], rcon ), 0xff ) )
+#define AES256_EXPAND_ODD( i ) \
+	rk[i] = _mm_xor_si128( KeyScheduleXorShifted( rk[i-2] ), _mm_shuffle_epi32( _mm_aeskeygenassist_si128( rk[i-1], 0 ), 0xaa ) )
+
+static AESNI_TARGET void AES128_ExpandKey( const uint8 *pKey, __m128i *rk )
+{
+	rk[0] = _mm_loadu_si128( (const __m128i *)pKey );
+	AES128_EXPAND( 1, 0x01 );
+	AES128_EXPAND( 2, 0x02 );
+	AES128_EXPAND( 3, 0x04 );
+	AES128_EXPAND( 4, 0x08 );
+	AES128_EXPAND( 5, 0x10 );
+	AES128_EXPAND( 6, 0x20 );
+	AES128_EXPAND( 7, 0x40 );
+	AES128_EXPAND( 8, 0x80 );
+	AES128_EXPAND( 9, 0x1b );
+	AES128_EXPAND( 10, 0x36 );
+}
+
+static AESNI_TARGET void AES256_ExpandKey( const uint8 *pKey, __m128i *rk )
+{
+	rk[0] = _mm_loadu_si128( (const __m128i *)pKey );
+	rk[1] = _mm_loadu_si128( (const __m128i *)( pKey + 16 ) );
+	AES256_EXPAND_EVEN( 2, 0x01 );
+	AES256_EXPAND_ODD( 3 );
+	AES256_EXPAND_EVEN( 4, 0x02 );
+	AES256_EXPAND_ODD( 5 );
+	AES256_EXPAND_EVEN( 6, 0x04 );
+	AES256_EXPAND_ODD( 7 );
+	AES256_EXPAND_EVEN( 8, 0x08 );
+	AES256_EXPAND_ODD( 9 );
+	AES256_EXPAND_EVEN( 10, 0x10 );
+	AES256_EXPAND_ODD( 11 );
+	AES256_EXPAND_EVEN( 12, 0x20 );
+	AES256_EXPAND_ODD( 13 );
+	AES256_EXPAND_EVEN( 14, 0x40 );
+}
+
+#undef AES128_EXPAND
+#undef AES256_EXPAND_EVEN
+#undef AES256_EXPAND_ODD
+
+static AESNI_TARGET inline __m128i AES_EncryptBlock( const AESNI_GCM_Key *pKey, __m128i x )
+{
+	x = _mm_xor_si128( x, pKey->m_rk[0] );
+	for ( int r = 1 ; r < pKey->m_nRounds ; ++r )
+		x = _mm_aesenc_si128( x, pKey->m_rk[r] );
+	return _mm_aesenclast_si128( x, pKey->m_rk[ pKey->m_nRounds ] );
+}
+
+// Encrypt four independent blocks.  Interleaving them hides the latency
+// of each aesenc
+static AESNI_TARGET inline void AES_EncryptBlocks4( const AESNI_GCM_Key *pKey, __m128i &x0, __m128i &x1, __m128i &x2, __m128i &x3 )
+{
+	__m128i rk = pKey->m_rk[0];
+	x0 = _mm_xor_si128( x0, rk );
+	x1 = _mm_xor_si128( x1, rk );
+	x2 = _mm_xor_si128( x2, rk );
+	x3 = _mm_xor_si128( x3, rk );
+	for ( int r = 1 ; r < pKey->m_nRounds ; ++r )
+	{
+		rk = pKey->m_rk[r];
+		x0 = _mm_aesenc_si128( x0, rk );
+		x1 = _mm_aesenc_si128( x1, rk );
+		x2 = _mm_aesenc_si128( x2, rk );
+		x3 = _mm_aesenc_si128( x3, rk );
+	}
+	rk = pKey->m_rk[ pKey->m_nRounds ];
+	x0 = _mm_aesenclast_si128( x0, rk );
+	x1 = _mm_aesenclast_si128( x1, rk );
+	x2 = _mm_aesenclast_si128( x2, rk );
+	x3 = _mm_aesenclast_si128( x3, rk );
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// GHASH
+//
+/////////////////////////////////////////////////////////////////////////////
+
+static AESNI_TARGET inline __m128i ByteReflect( __m128i x )
+{
+	return _mm_shuffle_epi8( x, _mm_set_epi8( 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 ) );
+}
+
+// Carryless multiply a*b, accumulating the unreduced 256-bit product.
+// The middle terms are kept separate and folded in by GHASH_Reduce.
+static AESNI_TARGET inline void GHASH_MulAcc( __m128i a, __m128i b, __m128i &lo, __m128i &mid, __m128i &hi )
+{
+	lo = _mm_xor_si128( lo, _mm_clmulepi64_si128( a, b, 0x00 ) );
+	hi = _mm_xor_si128( hi, _mm_clmulepi64_si128( a, b, 0x11 ) );
+	mid = _mm_xor_si128( mid, _mm_clmulepi64_si128( a, b, 0x10 ) );
+	mid = _mm_xor_si128( mid, _mm_clmulepi64_si128( a, b, 0x01 ) );
+}
+
+// Fold in the middle term, shift the 256-bit product left by one bit
+// (to account for the bit-reflected representation), and reduce modulo
+// x^128 + x^7 + x^2 + x + 1.  Because this is linear, we can accumulate
+// several products and reduce them all at once.
+static AESNI_TARGET inline __m128i GHASH_Reduce( __m128i lo, __m128i mid, __m128i hi )
+{
+	lo = _mm_xor_si128( lo, _mm_slli_si128( mid, 8 ) );
+	hi = _mm_xor_si128( hi, _mm_srli_si128( mid, 8 ) );
+
+	// Shift left by one
+	__m128i t7 = _mm_srli_epi32( lo, 31 );
+	__m128i t8 = _mm_srli_epi32( hi, 31 );
+	lo = _mm_slli_epi32( lo, 1 );
+	hi = _mm_slli_epi32( hi, 1 );
+	__m128i t9 = _mm_srli_si128( t7, 12 );
+	t8 = _mm_slli_si128( t8, 4 );
+	t7 = _mm_slli_si128( t7, 4 );
+	lo = _mm_or_si128( lo, t7 );
+	hi = _mm_or_si128( hi, t8 );
+	hi = _mm_or_si128( hi, t9 );
+
+	// First phase of the reduction
+	t7 = _mm_slli_epi32( lo, 31 );
+	t8 = _mm_slli_epi32( lo, 30 );
+	t9 = _mm_slli_epi32( lo, 25 );
+	t7 = _mm_xor_si128( t7, t8 );
+	t7 = _mm_xor_si128( t7, t9 );
+	t8 = _mm_srli_si128( t7, 4 );
+	t7 = _mm_slli_si128( t7, 12 );
+	lo = _mm_xor_si128( lo, t7 );
+
+	// Second phase
+	__m128i t2 = _mm_srli_epi32( lo, 1 );
+	__m128i t4 = _mm_srli_epi32( lo, 2 );
+	__m128i t5 = _mm_srli_epi32( lo, 7 );
+	t2 = _mm_xor_si128( t2, t4 );
+	t2 = _mm_xor_si128( t2, t5 );
+	t2 = _mm_xor_si128( t2, t8 );
+	lo = _mm_xor_si128( lo, t2 );
+	return _mm_xor_si128( hi, lo );
+}
+
+static AESNI_TARGET inline __m128i GHASH_Mul( __m128i a, __m128i b )
+{
+	__m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+	GHASH_MulAcc( a, b, lo, mid, hi );
+	return GHASH_Reduce( lo, mid, hi );
+}
+
+// Absorb a buffer into the hash state.  The final partial block, if any, is
+// zero padded, as GCM requires for both the AAD and the ciphertext.
+static AESNI_TARGET __m128i GHASH_Update( const AESNI_GCM_Key *pKey, __m128i X, const uint8 *p, size_t cb )
+{
+	while ( cb >= 64 )
+	{
+		__m128i b0 = _mm_xor_si128( X, ByteReflect( _mm_loadu_si128( (const __m128i *)p ) ) );
+		__m128i b1 = ByteReflect( _mm_loadu_si128( (const __m128i *)( p + 16 ) ) );
+		__m128i b2 = ByteReflect( _mm_loadu_si128( (const __m128i *)( p + 32 ) ) );
+		__m128i b3 = ByteReflect( _mm_loadu_si128( (const __m128i *)( p + 48 ) ) );
+
+		// X' = (X^B0)*H^4 + B1*H^3 + B2*H^2 + B3*H
+		__m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+		GHASH_MulAcc( b0, pKey->m_H[3], lo, mid, hi );
+		GHASH_MulAcc( b1, pKey->m_H[2], lo, mid, hi );
+		GHASH_MulAcc( b2, pKey->m_H[1], lo, mid, hi );
+		GHASH_MulAcc( b3, pKey->m_H[0], lo, mid, hi );
+		X = GHASH_Reduce( lo, mid, hi );
+
+		p += 64;
+		cb -= 64;
+	}
+	while ( cb >= 16 )
+	{
+		X = GHASH_Mul( _mm_xor_si128( X, ByteReflect( _mm_loadu_si128( (const __m128i *)p ) ) ), pKey->m_H[0] );
+		p += 16;
+		cb -= 16;
+	}
+	if ( cb > 0 )
+	{
+		uint8 block[16];
+		memset( block, 0, sizeof(block) );
+		memcpy( block, p, cb );
+		X = GHASH_Mul( _mm_xor_si128( X, ByteReflect( _mm_loadu_si128( (const __m128i *)block ) ) ), pKey->m_H[0] );
+	}
+	return X;
+}
+
+// Hash the AAD and ciphertext, and return the tag (before truncation)
+static AESNI_TARGET __m128i GCM_ComputeTag( const AESNI_GCM_Key *pKey, __m128i J0,
+	const uint8 *pAAD, size_t cbAAD, const uint8 *pCiphertext, size_t cbCiphertext )
+{
+	__m128i X = _mm_setzero_si128();
+	X = GHASH_Update( pKey, X, pAAD, cbAAD );
+	X = GHASH_Update( pKey, X, pCiphertext, cbCiphertext );
+
+	// Final block is the big endian bit lengths of the AAD and ciphertext.
+	// Byte-reflected, that's just the two 64-bit values, AAD in the high half.
+	__m128i lengths = _mm_set_epi64x( (long long)( (uint64)cbAAD * 8 ), (long long)( (uint64)cbCiphertext * 8 ) );
+	X = GHASH_Mul( _mm_xor_si128( X, lengths ), pKey->m_H[0] );
+
+	return _mm_xor_si128( ByteReflect( X ), AES_EncryptBlock( pKey, J0 ) );
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// CTR
+//
+/////////////////////////////////////////////////////////////////////////////
+
+// Make counter block IV || counter, where the counter is big endian
+static AESNI_TARGET inline __m128i MakeCounterBlock( __m128i ivBlock, uint32 nCounter )
+{
+	return _mm_insert_epi32( ivBlock, (int)BigDWord( nCounter ), 3 );
+}
+
+static AESNI_TARGET void GCM_CTR( const AESNI_GCM_Key *pKey, __m128i ivBlock, const uint8 *pIn, uint8 *pOut, size_t cb )
+{
+	// Counter 1 is used for the tag.  Data starts at 2
+	uint32 nCounter = 2;
+	while ( cb >= 64 )
+	{
+		__m128i k0 = MakeCounterBlock( ivBlock, nCounter );
+		__m128i k1 = MakeCounterBlock( ivBlock, nCounter+1 );
+		__m128i k2 = MakeCounterBlock( ivBlock, nCounter+2 );
+		__m128i k3 = MakeCounterBlock( ivBlock, nCounter+3 );
+		AES_EncryptBlocks4( pKey, k0, k1, k2, k3 );
+		_mm_storeu_si128( (__m128i *)pOut, _mm_xor_si128( k0, _mm_loadu_si128( (const __m128i *)pIn ) ) );
+		_mm_storeu_si128( (__m128i *)( pOut + 16 ), _mm_xor_si128( k1, _mm_loadu_si128( (const __m128i *)( pIn + 16 ) ) ) );
+		_mm_storeu_si128( (__m128i *)( pOut + 32 ), _mm_xor_si128( k2, _mm_loadu_si128( (const __m128i *)( pIn + 32 ) ) ) );
+		_mm_storeu_si128( (__m128i *)( pOut + 48 ), _mm_xor_si128( k3, _mm_loadu_si128( (const __m128i *)( pIn + 48 ) ) ) );
+		nCounter += 4;
+		pIn += 64;
+		pOut += 64;
+		cb -= 64;
+	}
+	while ( cb >= 16 )
+	{
+		__m128i k = AES_EncryptBlock( pKey, MakeCounterBlock( ivBlock, nCounter ) );
+		_mm_storeu_si128( (__m128i *)pOut, _mm_xor_si128( k, _mm_loadu_si128( (const __m128i *)pIn ) ) );
+		++nCounter;
+		pIn += 16;
+		pOut += 16;
+		cb -= 16;
+	}
+	if ( cb > 0 )
+	{
+		uint8 keystream[16];
+		_mm_storeu_si128( (__m128i *)keystream, AES_EncryptBlock( pKey, MakeCounterBlock( ivBlock, nCounter ) ) );
+		for ( size_t i = 0 ; i < cb ; ++i )
+			pOut[i] = pIn[i] ^ keystream[i];
+		SecureZeroMemory( keystream, sizeof(keystream) );
+	}
+}
+
+static AESNI_TARGET inline __m128i LoadIVBlock( const void *pIV )
+{
+	uint8 block[16];
+	memcpy( block, pIV, k_cbAESNI_GCM_IV );
+	memset( block + k_cbAESNI_GCM_IV, 0, sizeof(block) - k_cbAESNI_GCM_IV );
+	return _mm_loadu_si128( (const __m128i *)block );
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// Public interface
+//
+/////////////////////////////////////////////////////////////////////////////
+
+static AESNI_TARGET void InitKey( AESNI_GCM_Key *pKey, const uint8 *pKeyData, size_t cbKey )
+{
+	if ( cbKey == 128/8 )
+	{
+		pKey->m_nRounds = 10;
+		AES128_ExpandKey( pKeyData, pKey->m_rk );
+	}
+	else
+	{
+		Assert( cbKey == 256/8 );
+		pKey->m_nRounds = 14;
+		AES256_ExpandKey( pKeyData, pKey->m_rk );
+	}
+
+	// H = E(K, 0^128).  Precompute the powers we use
+	// for the 4-way aggregated hash.
+	__m128i H = ByteReflect( AES_EncryptBlock( pKey, _mm_setzero_si128() ) );
+	pKey->m_H[0] = H;
+	pKey->m_H[1] = GHASH_Mul( pKey->m_H[0], H );
+	pKey->m_H[2] = GHASH_Mul( pKey->m_H[1], H );
+	pKey->m_H[3] = GHASH_Mul( pKey->m_H[2], H );
+}
+
+AESNI_GCM_Key *AESNI_GCM_CreateKey( const void *pKey, size_t cbKey )
+{
+	if ( cbKey != 128/8 && cbKey != 256/8 )
+		return nullptr;
+	if ( !AESNI_GCM_BSupported() )
+		return nullptr;
+
+	// Make sure we get 16-byte alignment, even on 32-bit platforms
+	AESNI_GCM_Key *pResult = (AESNI_GCM_Key *)_mm_malloc( sizeof(AESNI_GCM_Key), 16 );
+	if ( !pResult )
+		return nullptr;
+	InitKey( pResult, (const uint8 *)pKey, cbKey );
+	return pResult;
+}
+
+void AESNI_GCM_DestroyKey( AESNI_GCM_Key *pKey )
+{
+	if ( !pKey )
+		return;
+	SecureZeroMemory( pKey, sizeof(*pKey) );
+	_mm_free( pKey );
+}
+
+AESNI_TARGET void AESNI_GCM_Encrypt(
+	const AESNI_GCM_Key *pKey, const void *pIV,
+	const void *pPlaintext, size_t cbPlaintext,
+	const void *pAAD, size_t cbAAD,
+	void *pCiphertextAndTag, size_t cbTag )
+{
+	Assert( cbTag <= 16 );
+	__m128i ivBlock = LoadIVBlock( pIV );
+	uint8 *pOut = (uint8 *)pCiphertextAndTag;
+
+	GCM_CTR( pKey, ivBlock, (const uint8 *)pPlaintext, pOut, cbPlaintext );
+
+	uint8 tag[16];
+	_mm_storeu_si128( (__m128i *)tag, GCM_ComputeTag( pKey, MakeCounterBlock( ivBlock, 1 ), (const uint8 *)pAAD, cbAAD, pOut, cbPlaintext ) );
+	memcpy( pOut + cbPlaintext, tag, cbTag );
+}
+
+AESNI_TARGET bool AESNI_GCM_Decrypt(
+	const AESNI_GCM_Key *pKey, const void *pIV,
+	const void *pCiphertext, size_t cbCiphertext,
+	const void *pTag, size_t cbTag,
+	const void *pAAD, size_t cbAAD,
+	void *pPlaintext )
+{
+	Assert( cbTag <= 16 );
+	__m128i ivBlock = LoadIVBlock( pIV );
+
+	uint8 tag[16];
+	_mm_storeu_si128( (__m128i *)tag, GCM_ComputeTag( pKey, MakeCounterBlock( ivBlock, 1 ), (const uint8 *)pAAD, cbAAD, (const uint8 *)pCiphertext, cbCiphertext ) );
+
+	// Constant time comparison
+	const uint8 *pExpectedTag = (const uint8 *)pTag;
+	uint8 diff = 0;
+	for ( size_t i = 0 ; i < cbTag ; ++i )
+		diff |= tag[i] ^ pExpectedTag[i];
+	if ( diff != 0 )
+		return false;
+
+	GCM_CTR( pKey, ivBlock, (const uint8 *)pCiphertext, (uint8 *)pPlaintext, cbCiphertext );
+	return true;
+}
+
+#endif // #ifdef VALVE_CRYPTO_AESNI_GCM
@@ -0,0 +1,60 @@
+//========= Copyright Valve LLC, All rights reserved. ========================
+//
+// Purpose: Specialized AES-GCM implementation using the AES-NI and PCLMULQDQ
+// instructions.  This is used by the OpenSSL backend as a fast path for the
+// common case (96-bit IV, 128 or 256-bit key), where the per-call overhead
+// of the EVP interface dominates the cost of encrypting a small packet.
+//
+//=============================================================================
+
+#ifndef CRYPTO_SYMMETRIC_AESNI_H
+#define CRYPTO_SYMMETRIC_AESNI_H
+#pragma once
+
+#include <tier0/platform.h>
+
+#if defined( _M_IX86 ) || defined( _M_X64 ) || defined( __i386__ ) || defined( __x86_64__ )
+	#define VALVE_CRYPTO_AESNI_GCM
+#endif
+
+#ifdef VALVE_CRYPTO_AESNI_GCM
+
+/// Expanded key schedule and precomputed GHASH multiplier table.
+/// Opaque; always allocated through AESNI_GCM_CreateKey
+struct AESNI_GCM_Key;
+
+/// Only IV size this implementation handles.  Other IV sizes need to use
+/// the general purpose implementation.
+const size_t k_cbAESNI_GCM_IV = 12;
+
+/// Return true if the CPU supports all of the instructions we need.
+/// (Checked with CPUID once, and cached.)
+extern bool AESNI_GCM_BSupported();
+
+/// Expand the key and precompute the GHASH table.  Returns nullptr if the CPU
+/// doesn't support the fast path, or the key size is not one we handle.
+extern AESNI_GCM_Key *AESNI_GCM_CreateKey( const void *pKey, size_t cbKey );
+
+/// Wipe and free a key created by AESNI_GCM_CreateKey
+extern void AESNI_GCM_DestroyKey( AESNI_GCM_Key *pKey );
+
+/// Encrypt the plaintext and write cbTag bytes of tag immediately after the ciphertext.
+/// pIV must point to k_cbAESNI_GCM_IV bytes.  Input and output may be the same buffer.
+extern void AESNI_GCM_Encrypt(
+	const AESNI_GCM_Key *pKey, const void *pIV,
+	const void *pPlaintext, size_t cbPlaintext,
+	const void *pAAD, size_t cbAAD,
+	void *pCiphertextAndTag, size_t cbTag );
+
+/// Check the tag and decrypt.  The tag is checked before anything is written
+/// to pPlaintext, so on failure the output buffer is untouched.
+extern bool AESNI_GCM_Decrypt(
+	const AESNI_GCM_Key *pKey, const void *pIV,
+	const void *pCiphertext, size_t cbCiphertext,
+	const void *pTag, size_t cbTag,
+	const void *pAAD, size_t cbAAD,
+	void *pPlaintext );
+
+#endif // #ifdef VALVE_CRYPTO_AESNI_GCM
+
+#endif // CRYPTO_SYMMETRIC_AESNI_H
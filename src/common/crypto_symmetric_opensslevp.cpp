@@ -2,6 +2,7 @@
 
 #include <tier0/dbg.h>
 #include "crypto.h"
+#include "crypto_symmetric_aesni.h"
 
 #include "tier0/memdbgoff.h"
 #include <openssl/evp.h>
@@ -9,6 +10,20 @@
 
 extern void OneTimeCryptoInitOpenSSL();
 
+#ifdef VALVE_CRYPTO_AESNI_GCM
+static bool s_bAESGCMFastPathEnabled = true;
+#endif
+
+bool CCrypto::SetAESGCMFastPathEnabled( bool bEnabled )
+{
+	#ifdef VALVE_CRYPTO_AESNI_GCM
+		s_bAESGCMFastPathEnabled = bEnabled;
+		return AESNI_GCM_BSupported();
+	#else
+		return false;
+	#endif
+}
+
 SymmetricCryptContextBase::SymmetricCryptContextBase()
 {
 	m_ctx = nullptr;
@@ -29,13 +44,28 @@ void SymmetricCryptContextBase::Wipe()
 		#endif
 		m_ctx = nullptr;
 	}
+	#ifdef VALVE_CRYPTO_AESNI_GCM
+		if ( m_pAccel )
+		{
+			AESNI_GCM_DestroyKey( (AESNI_GCM_Key *)m_pAccel );
+			m_pAccel = nullptr;
+		}
+	#endif
 	m_cbIV = 0;
 	m_cbTag = 0;
 }
 
-bool AES_GCM_CipherContext::InitCipher( const void *pKey, size_t cbKey, size_t cbIV, size_t cbTag, bool bEncrypt )
+// Older versions of OpenSSL only have the GCM-specific names for these
+#ifndef EVP_CTRL_AEAD_SET_IVLEN
+	#define EVP_CTRL_AEAD_SET_IVLEN EVP_CTRL_GCM_SET_IVLEN
+	#define EVP_CTRL_AEAD_GET_TAG EVP_CTRL_GCM_GET_TAG
+	#define EVP_CTRL_AEAD_SET_TAG EVP_CTRL_GCM_SET_TAG
+#endif
+
+// Reuse the existing EVP context, or allocate a new one
+static EVP_CIPHER_CTX *ResetOrAllocEVPContext( void *&pCtx )
 {
-	EVP_CIPHER_CTX *ctx = (EVP_CIPHER_CTX*)m_ctx;
+	EVP_CIPHER_CTX *ctx = (EVP_CIPHER_CTX*)pCtx;
 	if ( ctx )
 	{
 		#if OPENSSL_VERSION_NUMBER < 0x10100000
@@ -50,59 +80,43 @@ bool AES_GCM_CipherContext::InitCipher( const void *pKey, size_t cbKey, size_t c
 		#if OPENSSL_VERSION_NUMBER < 0x10100000
 			ctx = new EVP_CIPHER_CTX;
 			if ( !ctx )
-				return false;
+				return nullptr;
 			EVP_CIPHER_CTX_init( ctx );
 		#else
 			ctx = EVP_CIPHER_CTX_new();
 			if ( !ctx )
-				return false;
+				return nullptr;
 		#endif
-		m_ctx = ctx;
-	}
-
-	// Select the cipher based on the size of the key
-	const EVP_CIPHER *cipher = nullptr;
-	switch ( cbKey )
-	{
-		case 128/8: cipher = EVP_aes_128_gcm(); break;
-		case 192/8: cipher = EVP_aes_192_gcm(); break;
-		case 256/8: cipher = EVP_aes_256_gcm(); break;
-	}
-	if ( cipher == nullptr )
-	{
-		AssertMsg( false, "Invalid AES-GCM key size" );
-		Wipe();
-		return false;
+		pCtx = ctx;
 	}
+	return ctx;
+}
 
+// Set the cipher and key, and set IV length.  Used for both
+// AES-GCM and ChaCha20-Poly1305
+static bool InitEVPAEADCipher( EVP_CIPHER_CTX *ctx, const EVP_CIPHER *cipher, const void *pKey, size_t cbIV, bool bEncrypt )
+{
 	// Setup for encryption setting the key
 	if ( EVP_CipherInit_ex( ctx, cipher, nullptr, (const uint8*)pKey, nullptr, bEncrypt ? 1 : 0 ) != 1 )
-	{
-		Wipe();
 		return false;
-	}
 
 	// Set IV length
-	if ( EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_GCM_SET_IVLEN, (int)cbIV, NULL) != 1 )
+	if ( EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_AEAD_SET_IVLEN, (int)cbIV, NULL) != 1 )
 	{
 		AssertMsg( false, "Bad IV size" );
-		Wipe();
 		return false;
 	}
 
-	// Remember parameters
-	m_cbIV = (uint32)cbIV;
-	m_cbTag = (uint32)cbTag;
 	return true;
 }
 
-bool AES_GCM_EncryptContext::Encrypt(
+static bool EVPAEADEncrypt(
+	EVP_CIPHER_CTX *ctx, uint32 cbTag,
 	const void *pPlaintextData, size_t cbPlaintextData,
 	const void *pIV,
 	void *pEncryptedDataAndTag, uint32 *pcbEncryptedDataAndTag,
-	const void *pAdditionalAuthenticationData, size_t cbAuthenticationData // Optional additional authentication data.  Not encrypted, but will be included in the tag, so it can be authenticated.
+	const void *pAdditionalAuthenticationData, size_t cbAuthenticationData
 ) {
-	EVP_CIPHER_CTX *ctx = (EVP_CIPHER_CTX*)m_ctx;
 	if ( !ctx )
 	{
 		AssertMsg( false, "Not initialized!" );
@@ -110,9 +124,9 @@ bool AES_GCM_EncryptContext::Encrypt(
 		return false;
 	}
 
-	// Calculate size of encrypted data.  Note that GCM does not use padding.
+	// Calculate size of encrypted data.  Note that AEAD ciphers do not use padding.
 	uint32 cbEncryptedWithoutTag = (uint32)cbPlaintextData;
-	uint32 cbEncryptedTotal = cbEncryptedWithoutTag + m_cbTag;
+	uint32 cbEncryptedTotal = cbEncryptedWithoutTag + cbTag;
 
 	// Make sure their buffer is big enough
 	if ( cbEncryptedTotal > *pcbEncryptedDataAndTag )
@@ -154,7 +168,7 @@ bool AES_GCM_EncryptContext::Encrypt(
 	VerifyFatal( (uint8 *)pEncryptedDataAndTag + cbEncryptedWithoutTag == pOut );
 
 	// Append the tag
-	if ( EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_GCM_GET_TAG, (int)m_cbTag, pOut ) != 1 )
+	if ( EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_AEAD_GET_TAG, (int)cbTag, pOut ) != 1 )
 	{
 		AssertMsg( false, "Bad tag size" );
 		return false;
@@ -167,14 +181,13 @@ bool AES_GCM_EncryptContext::Encrypt(
 	return true;
 }
 
-bool AES_GCM_DecryptContext::Decrypt(
+static bool EVPAEADDecrypt(
+	EVP_CIPHER_CTX *ctx, uint32 cbTag,
 	const void *pEncryptedDataAndTag, size_t cbEncryptedDataAndTag,
 	const void *pIV,
 	void *pPlaintextData, uint32 *pcbPlaintextData,
 	const void *pAdditionalAuthenticationData, size_t cbAuthenticationData
 ) {
-
-	EVP_CIPHER_CTX *ctx = (EVP_CIPHER_CTX*)m_ctx;
 	if ( !ctx )
 	{
 		AssertMsg( false, "Not initialized!" );
@@ -183,15 +196,15 @@ bool AES_GCM_DecryptContext::Decrypt(
 	}
 
 	// Make sure buffer and tag sizes aren't totally bogus
-	if ( m_cbTag > cbEncryptedDataAndTag )
+	if ( cbTag > cbEncryptedDataAndTag )
 	{
 		AssertMsg( false, "Encrypted size doesn't make sense for tag size" );
 		*pcbPlaintextData = 0;
 		return false;
 	}
-	uint32 cbEncryptedDataWithoutTag = uint32( cbEncryptedDataAndTag - m_cbTag );
+	uint32 cbEncryptedDataWithoutTag = uint32( cbEncryptedDataAndTag - cbTag );
 
-	// Make sure their buffer is big enough.  Remember that in GCM mode,
+	// Make sure their buffer is big enough.  Remember that in GCM and ChaCha20-Poly1305,
 	// there is no padding, so if this fails, we indeed would have overflowed
 	if ( cbEncryptedDataWithoutTag > *pcbPlaintextData )
 	{
@@ -236,7 +249,7 @@ bool AES_GCM_DecryptContext::Decrypt(
 	pIn += cbEncryptedDataWithoutTag;
 
 	// Set expected tag value
-	if( EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_GCM_SET_TAG, (int)m_cbTag, const_cast<uint8*>( pIn ) ) != 1)
+	if( EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_AEAD_SET_TAG, (int)cbTag, const_cast<uint8*>( pIn ) ) != 1)
 	{
 		AssertMsg( false, "Bad tag size" );
 		return false;
@@ -255,6 +268,174 @@ bool AES_GCM_DecryptContext::Decrypt(
 	return true;
 }
 
+bool AES_GCM_CipherContext::InitCipher( const void *pKey, size_t cbKey, size_t cbIV, size_t cbTag, bool bEncrypt )
+{
+	#ifdef VALVE_CRYPTO_AESNI_GCM
+		// Use the specialized implementation for the common case, if the CPU supports it.
+		// The EVP interface has a surprising amount of per-call overhead, which is
+		// significant for packet-sized buffers.
+		if ( s_bAESGCMFastPathEnabled && cbIV == k_cbAESNI_GCM_IV && cbTag <= 16 )
+		{
+			AESNI_GCM_Key *pAccel = AESNI_GCM_CreateKey( pKey, cbKey );
+			if ( pAccel )
+			{
+				Wipe();
+				m_pAccel = pAccel;
+				m_cbIV = (uint32)cbIV;
+				m_cbTag = (uint32)cbTag;
+				return true;
+			}
+		}
+		if ( m_pAccel )
+		{
+			AESNI_GCM_DestroyKey( (AESNI_GCM_Key *)m_pAccel );
+			m_pAccel = nullptr;
+		}
+	#endif
+
+	EVP_CIPHER_CTX *ctx = ResetOrAllocEVPContext( m_ctx );
+	if ( !ctx )
+		return false;
+
+	// Select the cipher based on the size of the key
+	const EVP_CIPHER *cipher = nullptr;
+	switch ( cbKey )
+	{
+		case 128/8: cipher = EVP_aes_128_gcm(); break;
+		case 192/8: cipher = EVP_aes_192_gcm(); break;
+		case 256/8: cipher = EVP_aes_256_gcm(); break;
+	}
+	if ( cipher == nullptr )
+	{
+		AssertMsg( false, "Invalid AES-GCM key size" );
+		Wipe();
+		return false;
+	}
+
+	if ( !InitEVPAEADCipher( ctx, cipher, pKey, cbIV, bEncrypt ) )
+	{
+		Wipe();
+		return false;
+	}
+
+	// Remember parameters
+	m_cbIV = (uint32)cbIV;
+	m_cbTag = (uint32)cbTag;
+	return true;
+}
+
+bool AES_GCM_EncryptContext::Encrypt(
+	const void *pPlaintextData, size_t cbPlaintextData,
+	const void *pIV,
+	void *pEncryptedDataAndTag, uint32 *pcbEncryptedDataAndTag,
+	const void *pAdditionalAuthenticationData, size_t cbAuthenticationData // Optional additional authentication data.  Not encrypted, but will be included in the tag, so it can be authenticated.
+) {
+	#ifdef VALVE_CRYPTO_AESNI_GCM
+		if ( m_pAccel )
+		{
+			uint32 cbEncryptedTotal = (uint32)cbPlaintextData + m_cbTag;
+			if ( cbEncryptedTotal > *pcbEncryptedDataAndTag )
+			{
+				AssertMsg( false, "Buffer isn't big enough to hold padded+encrypted data and tag" );
+				return false;
+			}
+			Assert( cbAuthenticationData == 0 || pAdditionalAuthenticationData );
+			AESNI_GCM_Encrypt( (const AESNI_GCM_Key *)m_pAccel, pIV,
+				pPlaintextData, cbPlaintextData,
+				pAdditionalAuthenticationData, pAdditionalAuthenticationData ? cbAuthenticationData : 0,
+				pEncryptedDataAndTag, m_cbTag );
+			*pcbEncryptedDataAndTag = cbEncryptedTotal;
+			return true;
+		}
+	#endif
+
+	return EVPAEADEncrypt( (EVP_CIPHER_CTX*)m_ctx, m_cbTag, pPlaintextData, cbPlaintextData, pIV, pEncryptedDataAndTag, pcbEncryptedDataAndTag, pAdditionalAuthenticationData, cbAuthenticationData );
+}
+
+bool AES_GCM_DecryptContext::Decrypt(
+	const void *pEncryptedDataAndTag, size_t cbEncryptedDataAndTag,
+	const void *pIV,
+	void *pPlaintextData, uint32 *pcbPlaintextData,
+	const void *pAdditionalAuthenticationData, size_t cbAuthenticationData
+) {
+
+	#ifdef VALVE_CRYPTO_AESNI_GCM
+		if ( m_pAccel )
+		{
+			if ( m_cbTag > cbEncryptedDataAndTag )
+			{
+				AssertMsg( false, "Encrypted size doesn't make sense for tag size" );
+				*pcbPlaintextData = 0;
+				return false;
+			}
+			uint32 cbEncryptedDataWithoutTag = uint32( cbEncryptedDataAndTag - m_cbTag );
+			if ( cbEncryptedDataWithoutTag > *pcbPlaintextData )
+			{
+				AssertMsg( false, "Buffer might not be big enough to hold decrypted data" );
+				*pcbPlaintextData = 0;
+				return false;
+			}
+			*pcbPlaintextData = 0;
+			Assert( cbAuthenticationData == 0 || pAdditionalAuthenticationData );
+			const uint8 *pIn = (const uint8 *)pEncryptedDataAndTag;
+			if ( !AESNI_GCM_Decrypt( (const AESNI_GCM_Key *)m_pAccel, pIV,
+				pIn, cbEncryptedDataWithoutTag,
+				pIn + cbEncryptedDataWithoutTag, m_cbTag,
+				pAdditionalAuthenticationData, pAdditionalAuthenticationData ? cbAuthenticationData : 0,
+				pPlaintextData ) )
+			{
+				return false; // data has been tamped with
+			}
+			*pcbPlaintextData = cbEncryptedDataWithoutTag;
+			return true;
+		}
+	#endif
+
+	return EVPAEADDecrypt( (EVP_CIPHER_CTX*)m_ctx, m_cbTag, pEncryptedDataAndTag, cbEncryptedDataAndTag, pIV, pPlaintextData, pcbPlaintextData, pAdditionalAuthenticationData, cbAuthenticationData );
+}
+
+bool ChaCha20_Poly1305_CipherContext::InitCipher( const void *pKey, size_t cbKey, size_t cbIV, size_t cbTag, bool bEncrypt )
+{
+	if ( cbKey != 256/8 || cbIV != 96/8 || cbTag != 128/8 )
+	{
+		AssertMsg( false, "Invalid ChaCha20-Poly1305 parameters" );
+		Wipe();
+		return false;
+	}
+
+	EVP_CIPHER_CTX *ctx = ResetOrAllocEVPContext( m_ctx );
+	if ( !ctx )
+		return false;
+
+	if ( !InitEVPAEADCipher( ctx, EVP_chacha20_poly1305(), pKey, cbIV, bEncrypt ) )
+	{
+		Wipe();
+		return false;
+	}
+
+	// Remember parameters
+	m_cbIV = (uint32)cbIV;
+	m_cbTag = (uint32)cbTag;
+	return true;
+}
+
+bool ChaCha20_Poly1305_EncryptContext::Encrypt(
+	const void *pPlaintextData, size_t cbPlaintextData,
+	const void *pIV,
+	void *pEncryptedDataAndTag, uint32 *pcbEncryptedDataAndTag,
+	const void *pAdditionalAuthenticationData, size_t cbAuthenticationData
+) {
+	return EVPAEADEncrypt( (EVP_CIPHER_CTX*)m_ctx, m_cbTag, pPlaintextData, cbPlaintextData, pIV, pEncryptedDataAndTag, pcbEncryptedDataAndTag, pAdditionalAuthenticationData, cbAuthenticationData );
+}
+
+bool ChaCha20_Poly1305_DecryptContext::Decrypt(
+	const void *pEncryptedDataAndTag, size_t cbEncryptedDataAndTag,
+	const void *pIV,
+	void *pPlaintextData, uint32 *pcbPlaintextData,
+	const void *pAdditionalAuthenticationData, size_t cbAuthenticationData
+) {
+	return EVPAEADDecrypt( (EVP_CIPHER_CTX*)m_ctx, m_cbTag, pEncryptedDataAndTag, cbEncryptedDataAndTag, pIV, pPlaintextData, pcbPlaintextData, pAdditionalAuthenticationData, cbAuthenticationData );
+}
 
 //
 // !KLUDGE! This is not specific to OpenSSL, and I'd like to put it in crypto.cpp.
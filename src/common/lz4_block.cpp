@@ -0,0 +1,247 @@
+//========= Copyright Valve LLC, All rights reserved. ========================
+//
+// Purpose: Small, self-contained compressor for the LZ4 block format
+//
+// Each sequence is a token byte (literal length in the high nibble, match
+// length-4 in the low nibble, 15 meaning "more length bytes follow"), the
+// literals, a 16-bit little endian match offset, and any extra match length
+// bytes.  The last sequence has literals only.  Matches may reach back past
+// the start of the input into the dictionary.
+//
+//=============================================================================
+
+#include "lz4_block.h"
+#include <tier0/dbg.h>
+#include <string.h>
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+const int k_nMinMatch = 4;
+const int k_nLastLiterals = 5; // The last 5 bytes are always literals
+const int k_nMFLimit = 12; // A match cannot start within the last 12 bytes
+const int k_nMaxOffset = 65535;
+
+static inline uint32 Read32( const uint8 *p )
+{
+	uint32 x;
+	memcpy( &x, p, sizeof(x) );
+	return x;
+}
+
+static inline uint32 HashSeq( uint32 nSeq )
+{
+	return ( nSeq * 2654435761u ) >> ( 32 - CLZ4Dictionary::k_nHashLog );
+}
+
+void CLZ4Dictionary::Init( const void *pData, int cbData )
+{
+	const uint8 *p = (const uint8 *)pData;
+	if ( cbData > k_cbMaxLZ4Dictionary )
+	{
+		p += cbData - k_cbMaxLZ4Dictionary;
+		cbData = k_cbMaxLZ4Dictionary;
+	}
+	m_data.assign( p, p + cbData );
+
+	// Later positions overwrite earlier ones.  They are closer to
+	// the data we will compress, so they are better matches.
+	memset( m_hashTable, 0, sizeof(m_hashTable) );
+	for ( int i = 0 ; i + k_nMinMatch <= cbData ; ++i )
+		m_hashTable[ HashSeq( Read32( p + i ) ) ] = uint32( i + 1 );
+}
+
+static inline uint8 *EncodeLength( uint8 *op, int nLen )
+{
+	while ( nLen >= 255 )
+	{
+		*(op++) = 255;
+		nLen -= 255;
+	}
+	*(op++) = (uint8)nLen;
+	return op;
+}
+
+static uint8 *EncodeSequence( uint8 *op, uint8 *opEnd, const uint8 *pLiterals, int nLiterals, int nOffset, int nMatchLen )
+{
+	// Make sure we have room for the worst case
+	int cbNeeded = 1 + nLiterals/255 + 1 + nLiterals;
+	if ( nMatchLen > 0 )
+		cbNeeded += 2 + ( nMatchLen - k_nMinMatch )/255 + 1;
+	if ( opEnd - op < cbNeeded )
+		return nullptr;
+
+	uint8 *pToken = op++;
+	if ( nLiterals >= 15 )
+	{
+		*pToken = 15 << 4;
+		op = EncodeLength( op, nLiterals - 15 );
+	}
+	else
+	{
+		*pToken = uint8( nLiterals << 4 );
+	}
+	memcpy( op, pLiterals, nLiterals );
+	op += nLiterals;
+
+	// Last sequence?
+	if ( nMatchLen == 0 )
+		return op;
+
+	Assert( nOffset > 0 && nOffset <= k_nMaxOffset );
+	*(op++) = uint8( nOffset );
+	*(op++) = uint8( nOffset >> 8 );
+	int nMatchCode = nMatchLen - k_nMinMatch;
+	if ( nMatchCode >= 15 )
+	{
+		*pToken |= 15;
+		op = EncodeLength( op, nMatchCode - 15 );
+	}
+	else
+	{
+		*pToken |= uint8( nMatchCode );
+	}
+	return op;
+}
+
+int LZ4Block_Compress( const CLZ4Dictionary *pDict, const void *pInput, int cbInput, void *pOutput, int cbOutputMax )
+{
+	const uint8 *in = (const uint8 *)pInput;
+	uint8 *const pOutBegin = (uint8 *)pOutput;
+	uint8 *op = pOutBegin;
+	uint8 *const opEnd = op + cbOutputMax;
+
+	// Positions in the hash table are "virtual".  The dictionary comes first,
+	// followed immediately by the input.
+	const uint8 *dict = pDict ? pDict->Data() : nullptr;
+	const int cbDict = pDict ? pDict->Size() : 0;
+	uint32 hashTable[ CLZ4Dictionary::k_nHashSize ];
+	if ( pDict )
+		memcpy( hashTable, pDict->m_hashTable, sizeof(hashTable) );
+	else
+		memset( hashTable, 0, sizeof(hashTable) );
+	auto VirtualByte = [=]( int v ) -> uint8 { return v < cbDict ? dict[v] : in[ v - cbDict ]; };
+
+	int ip = 0;
+	int anchor = 0;
+	const int ipLimit = cbInput - k_nMFLimit;
+	const int matchLimit = cbInput - k_nLastLiterals;
+	while ( ip <= ipLimit )
+	{
+		const uint32 h = HashSeq( Read32( in + ip ) );
+		const int vCandidate = int( hashTable[h] ) - 1;
+		const int vIP = cbDict + ip;
+		hashTable[h] = uint32( vIP + 1 );
+		if ( vCandidate < 0 || vIP - vCandidate > k_nMaxOffset )
+		{
+			++ip;
+			continue;
+		}
+
+		// See how long the match is.  (Might be a hash collision.)  The
+		// source can run from the dictionary into the input, or overlap
+		// the data being matched, that's OK.
+		int nMatchLen = 0;
+		while ( ip + nMatchLen < matchLimit && VirtualByte( vCandidate + nMatchLen ) == in[ ip + nMatchLen ] )
+			++nMatchLen;
+		if ( nMatchLen < k_nMinMatch )
+		{
+			++ip;
+			continue;
+		}
+
+		op = EncodeSequence( op, opEnd, in + anchor, ip - anchor, vIP - vCandidate, nMatchLen );
+		if ( !op )
+			return 0;
+		ip += nMatchLen;
+		anchor = ip;
+	}
+
+	op = EncodeSequence( op, opEnd, in + anchor, cbInput - anchor, 0, 0 );
+	if ( !op )
+		return 0;
+	return int( op - pOutBegin );
+}
+
+int LZ4Block_Decompress( const CLZ4Dictionary *pDict, const void *pInput, int cbInput, void *pOutput, int cbOutputMax )
+{
+	const uint8 *ip = (const uint8 *)pInput;
+	const uint8 *const ipEnd = ip + cbInput;
+	uint8 *const pOutBegin = (uint8 *)pOutput;
+	uint8 *op = pOutBegin;
+	uint8 *const opEnd = op + cbOutputMax;
+	const uint8 *dictEnd = pDict ? pDict->Data() + pDict->Size() : nullptr;
+	const size_t cbDict = pDict ? (size_t)pDict->Size() : 0;
+
+	// Read a length that uses the "15, and then 255's" encoding.
+	auto DecodeLength = [&]( size_t &nLen ) -> bool
+	{
+		for (;;)
+		{
+			if ( ip >= ipEnd )
+				return false;
+			uint8 b = *(ip++);
+			nLen += b;
+			if ( b != 255 )
+				return true;
+			if ( nLen > (size_t)cbOutputMax )
+				return false;
+		}
+	};
+
+	for (;;)
+	{
+		if ( ip >= ipEnd )
+			return -1;
+		const uint8 nToken = *(ip++);
+
+		// Literals
+		size_t nLiterals = nToken >> 4;
+		if ( nLiterals == 15 && !DecodeLength( nLiterals ) )
+			return -1;
+		if ( nLiterals > (size_t)( ipEnd - ip ) || nLiterals > (size_t)( opEnd - op ) )
+			return -1;
+		memcpy( op, ip, nLiterals );
+		op += nLiterals;
+		ip += nLiterals;
+
+		// The last sequence has no match
+		if ( ip == ipEnd )
+			break;
+
+		// Match
+		if ( ipEnd - ip < 2 )
+			return -1;
+		const size_t nOffset = ip[0] | ( size_t( ip[1] ) << 8 );
+		ip += 2;
+		size_t nMatchLen = nToken & 15;
+		if ( nMatchLen == 15 && !DecodeLength( nMatchLen ) )
+			return -1;
+		nMatchLen += k_nMinMatch;
+		const size_t nOut = size_t( op - pOutBegin );
+		if ( nOffset == 0 || nOffset > nOut + cbDict || nMatchLen > (size_t)( opEnd - op ) )
+			return -1;
+
+		// Copy a byte at a time, since the source may overlap
+		// the output, or start in the dictionary
+		if ( nOffset > nOut )
+		{
+			const uint8 *pSrc = dictEnd - ( nOffset - nOut );
+			while ( pSrc < dictEnd && nMatchLen > 0 )
+			{
+				*(op++) = *(pSrc++);
+				--nMatchLen;
+			}
+		}
+		if ( nMatchLen > 0 )
+		{
+			const uint8 *pSrc = op - nOffset;
+			do
+			{
+				*(op++) = *(pSrc++);
+			} while ( --nMatchLen > 0 );
+		}
+	}
+
+	return int( op - pOutBegin );
+}
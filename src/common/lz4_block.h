@@ -0,0 +1,56 @@
+//========= Copyright Valve LLC, All rights reserved. ========================
+//
+// Purpose: Small, self-contained compressor for the LZ4 block format, with
+// support for a pre-shared dictionary.  This is used to compress messages,
+// which are usually small, so it's tuned for low setup cost rather than
+// for throughput on large buffers.
+//
+//=============================================================================
+
+#ifndef LZ4_BLOCK_H
+#define LZ4_BLOCK_H
+#pragma once
+
+#include <tier0/platform.h>
+#include <vector>
+
+/// Largest dictionary we can use.  Match offsets are 16 bits, so anything
+/// further back than this could never be referenced anyway.
+const int k_cbMaxLZ4Dictionary = 65535;
+
+/// Max size of the compressed output, for an input of the given size
+inline int LZ4Block_CompressBound( int cbInput ) { return cbInput + cbInput/255 + 16; }
+
+/// A dictionary, with the hash table for it precomputed, so that we don't
+/// need to scan it each time we compress something.
+class CLZ4Dictionary
+{
+public:
+	enum { k_nHashLog = 12 };
+	enum { k_nHashSize = 1 << k_nHashLog };
+
+	/// Set the dictionary contents.  Only the last k_cbMaxLZ4Dictionary bytes are kept
+	void Init( const void *pData, int cbData );
+
+	const uint8 *Data() const { return m_data.data(); }
+	int Size() const { return (int)m_data.size(); }
+
+private:
+	friend int LZ4Block_Compress( const CLZ4Dictionary *, const void *, int, void *, int );
+	std::vector<uint8> m_data;
+
+	/// Position+1 of the most recent occurrence of each hash in the
+	/// dictionary, or 0 if none
+	uint32 m_hashTable[ k_nHashSize ];
+};
+
+/// Compress a buffer.  Matches may refer back into the dictionary (which may be NULL).
+/// Returns the size of the compressed data, or 0 if it would not fit in cbOutputMax.
+extern int LZ4Block_Compress( const CLZ4Dictionary *pDict, const void *pInput, int cbInput, void *pOutput, int cbOutputMax );
+
+/// Decompress a buffer that was compressed using the same dictionary.
+/// Input is not trusted.  Returns the size of the decompressed data, or -1
+/// if the input is malformed or would decompress to more than cbOutputMax.
+extern int LZ4Block_Decompress( const CLZ4Dictionary *pDict, const void *pInput, int cbInput, void *pOutput, int cbOutputMax );
+
+#endif // LZ4_BLOCK_H
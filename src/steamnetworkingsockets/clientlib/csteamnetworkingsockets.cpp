@@ -51,6 +51,10 @@ DEFINE_GLOBAL_CONFIGVAL( float, FakePacketDup_Send, 0.0f, 0.0f, 100.0f );
 DEFINE_GLOBAL_CONFIGVAL( float, FakePacketDup_Recv, 0.0f, 0.0f, 100.0f );
 DEFINE_GLOBAL_CONFIGVAL( int32, FakePacketDup_TimeMax, 10, 0, 5000 );
 DEFINE_GLOBAL_CONFIGVAL( int32, PacketTraceMaxBytes, -1, -1, 99999 );
+DEFINE_GLOBAL_CONFIGVAL( int32, SpewAsyncQueueSize, 0, 0, 65536 );
+DEFINE_GLOBAL_CONFIGVAL( int32, PerfMetrics, 0, 0, 1 );
+DEFINE_GLOBAL_CONFIGVAL( int32, HandshakeWorkerThreads, 0, 0, 64 );
+DEFINE_GLOBAL_CONFIGVAL( int32, KeyExchangeKeyPoolSize, 8, 0, 1024 );
 DEFINE_GLOBAL_CONFIGVAL( int32, FakeRateLimit_Send_Rate, 0, 0, 1024*1024*1024 );
 DEFINE_GLOBAL_CONFIGVAL( int32, FakeRateLimit_Send_Burst, 16*1024, 0, 1024*1024 );
 DEFINE_GLOBAL_CONFIGVAL( int32, FakeRateLimit_Recv_Rate, 0, 0, 1024*1024*1024 );
@@ -84,6 +88,10 @@ DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int64, ConnectionUserData, -1 ); // no limit
 DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, SendRateMin, 256*1024, 1024, 0x10000000 );
 DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, SendRateMax, 256*1024, 1024, 0x10000000 );
 DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, NagleTime, 5000, 0, 20000 );
+DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, UnreliableFECLanes, 0, INT32_MIN, INT32_MAX ); // Bitmask
+DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, CompressionLanes, 0, INT32_MIN, INT32_MAX ); // Bitmask
+DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, CompressionDictionary, 0, 0, INT32_MAX );
+DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, CompactEncoding, 0, 0, 1 );
 DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, MTU_PacketSize, 1300, k_cbSteamNetworkingSocketsMinMTUPacketSize, k_cbSteamNetworkingSocketsMaxUDPMsgLen );
 #ifdef STEAMNETWORKINGSOCKETS_OPENSOURCE
 	// We don't have a trusted third party, so allow this by default,
@@ -94,7 +102,11 @@ DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, MTU_PacketSize, 1300, k_cbSteamNetwor
 	DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, IP_AllowWithoutAuth, 0, 0, 2 );
 	DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, IPLocalHost_AllowWithoutAuth, 0, 0, 2 );
 #endif
+DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, IP_SessionResumption, 0, 0, 24*3600 );
+DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, IP_HandshakeRatePerPrefix, 0, 0, 100000 );
+DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, IP_HandshakeCPUBudget, 250000, 0, k_nMillion );
 DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, Unencrypted, 0, 0, 3 );
+DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, CipherPreference, 0, 0, 2 );
 DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, SymmetricConnect, 0, 0, 1 );
 DEFINE_CONNECTON_DEFAULT_CONFIGVAL( int32, LocalVirtualPort, -1, -1, INT32_MAX );
 #ifdef STEAMNETWORKINGSOCKETS_ENABLE_DUALWIFI
@@ -256,6 +268,8 @@ TableLock g_tables_lock;
 // by the global lock.
 CUtlHashMap<int, CSteamNetworkListenSocketBase *, std::equal_to<int>, Identity<int> > g_mapListenSockets;
 
+std::vector< std::shared_ptr<const CompressionDictionary_t> > g_vecCompressionDictionaries;
+
 static bool BConnectionStateExistsToAPI( ESteamNetworkingConnectionState eState )
 {
 	switch ( eState )
@@ -469,6 +483,7 @@ CSteamNetworkingSockets::~CSteamNetworkingSockets()
 {
 	SteamNetworkingGlobalLock::AssertHeldByCurrentThread();
 	Assert( !m_bHaveLowLevelRef ); // Called destructor directly?  Use Destroy()!
+	delete m_pWakePendingCallbacks;
 }
 
 #ifdef STEAMNETWORKINGSOCKETS_OPENSOURCE
@@ -1261,6 +1276,18 @@ EResult CSteamNetworkingSockets::ConfigureConnectionLanes( HSteamNetConnection h
 	return pConn->SNP_ConfigureLanes( nNumLanes, pLanePriorities, pLaneWeights );
 }
 
+EResult CSteamNetworkingSockets::ConfigureConnectionLaneDeadlines( HSteamNetConnection hConn, int nNumLanes, const int *pLaneLatencyTargetsMS )
+{
+	//SteamNetworkingGlobalLock scopeLock( "ConfigureConnectionLaneDeadlines" ); // NO, not necessary!
+	ConnectionScopeLock connectionLock;
+	CSteamNetworkConnectionBase *pConn = GetConnectionByHandleForAPI( hConn, connectionLock, "ConfigureConnectionLaneDeadlines" );
+	if ( !pConn )
+		return k_EResultNoConnection;
+	if ( !pConn->BStateIsActive() )
+		return k_EResultInvalidState;
+	return pConn->SNP_ConfigureLaneDeadlines( nNumLanes, pLaneLatencyTargetsMS, SteamNetworkingSockets_GetLocalTimestamp() );
+}
+
 EResult CSteamNetworkingSockets::SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber )
 {
 	//SteamNetworkingGlobalLock scopeLock( "SendMessageToConnection" ); // NO, not necessary!
@@ -1404,6 +1431,22 @@ void CSteamNetworkingSockets::SendMessages( int nMessages, SteamNetworkingMessag
 		pConn->CheckConnectionStateOrScheduleWakeUp( usecNow );
 }
 
+void CSteamNetworkingSockets::SendMessagesWithOptions( int nMessages, SteamNetworkingMessage_t **pMessages, const SteamNetworkingMicroseconds *pUsecExpiry, const int64 *pCoalesceKeys, int64 *pOutMessageNumberOrResult, bool bDeleteFailedMessages )
+{
+	// The messages still belong to the caller, so we can just stash the
+	// options in them.  Messages sent with plain SendMessages have them
+	// cleared by AllocateMessage.
+	for ( int i = 0 ; i < nMessages ; ++i )
+	{
+		CSteamNetworkingMessage *pMsg = static_cast<CSteamNetworkingMessage*>( pMessages[i] );
+		if ( !pMsg )
+			continue;
+		pMsg->m_usecExpiry = pUsecExpiry ? pUsecExpiry[i] : 0;
+		pMsg->m_nCoalesceKey = pCoalesceKeys ? pCoalesceKeys[i] : 0;
+	}
+	SendMessages( nMessages, pMessages, pOutMessageNumberOrResult, bDeleteFailedMessages );
+}
+
 EResult CSteamNetworkingSockets::FlushMessagesOnConnection( HSteamNetConnection hConn )
 {
 	//SteamNetworkingGlobalLock scopeLock( "FlushMessagesOnConnection" ); // NO, not necessary!
@@ -1538,6 +1581,89 @@ EResult CSteamNetworkingSockets::GetConnectionRealTimeStatus(
 	return pConn->APIGetRealTimeStatus( pStatus, nLanes, pLanes );
 }
 
+SteamNetworkingWakeHandle CSteamNetworkingSockets::GetPollGroupWakeHandle( HSteamNetPollGroup hPollGroup )
+{
+	//SteamNetworkingGlobalLock scopeLock( "GetPollGroupWakeHandle" ); // NO, not necessary!
+	PollGroupScopeLock pollGroupLock;
+	CSteamNetworkPollGroup *pPollGroup = GetPollGroupByHandle( hPollGroup, pollGroupLock, "GetPollGroupWakeHandle" );
+	if ( !pPollGroup )
+		return k_SteamNetworkingWakeHandle_Invalid;
+	ShortDurationScopeLock lockMessageQueues( g_lockAllRecvMessageQueues );
+	return pPollGroup->m_queueRecvMessages.GetWakeHandle();
+}
+
+SteamNetworkingWakeHandle CSteamNetworkingSockets::GetConnectionWakeHandle( HSteamNetConnection hConn )
+{
+	//SteamNetworkingGlobalLock scopeLock( "GetConnectionWakeHandle" ); // NO, not necessary!
+	ConnectionScopeLock connectionLock;
+	CSteamNetworkConnectionBase *pConn = GetConnectionByHandleForAPI( hConn, connectionLock, "GetConnectionWakeHandle" );
+	if ( !pConn )
+		return k_SteamNetworkingWakeHandle_Invalid;
+	ShortDurationScopeLock lockMessageQueues( g_lockAllRecvMessageQueues );
+	return pConn->m_queueRecvMessages.GetWakeHandle();
+}
+
+SteamNetworkingWakeHandle CSteamNetworkingSockets::GetCallbacksWakeHandle()
+{
+	ShortDurationScopeLock lock( m_mutexPendingCallbacks );
+	if ( !m_pWakePendingCallbacks )
+	{
+		SteamNetworkingErrMsg errMsg;
+		m_pWakePendingCallbacks = CAppWakeHandle::Create( errMsg );
+		if ( !m_pWakePendingCallbacks )
+		{
+			SpewWarning( "Failed to create wake handle.  %s\n", errMsg );
+			return k_SteamNetworkingWakeHandle_Invalid;
+		}
+		if ( !m_vecPendingCallbacks.empty() )
+			m_pWakePendingCallbacks->Signal();
+	}
+	return m_pWakePendingCallbacks->GetHandle();
+}
+
+int CSteamNetworkingSockets::GetConnectionSNPStatus( const HSteamNetConnection *pConnections, int nConnections, SteamNetConnectionSNPStatus_t *pOutStatus )
+{
+	// NOTE: No global lock.  We only hold one connection lock at a time,
+	// so a large batch doesn't stall the service thread.
+	if ( nConnections <= 0 )
+		return 0;
+	if ( !pConnections || !pOutStatus )
+	{
+		SpewBug( "GetConnectionSNPStatus: NULL array\n" );
+		return 0;
+	}
+
+	int nResult = 0;
+	for ( int i = 0 ; i < nConnections ; ++i )
+	{
+		SteamNetConnectionSNPStatus_t &status = pOutStatus[i];
+		memset( &status, 0, sizeof(status) );
+		status.m_hConn = pConnections[i];
+
+		ConnectionScopeLock connectionLock;
+		CSteamNetworkConnectionBase *pConn = GetConnectionByHandleForAPI( pConnections[i], connectionLock, "GetConnectionSNPStatus" );
+		if ( !pConn )
+		{
+			status.m_eResult = k_EResultNoConnection;
+			continue;
+		}
+		pConn->APIGetSNPStatus( status );
+		status.m_eResult = k_EResultOK;
+		++nResult;
+	}
+	return nResult;
+}
+
+int CSteamNetworkingSockets::ReceiveDeliveryReceiptsOnConnection( HSteamNetConnection hConn, SteamNetworkingDeliveryReceipt_t *pOutReceipts, int nMaxReceipts )
+{
+	//SteamNetworkingGlobalLock scopeLock( "ReceiveDeliveryReceiptsOnConnection" ); // NO, not necessary!
+	ConnectionScopeLock connectionLock;
+	CSteamNetworkConnectionBase *pConn = GetConnectionByHandleForAPI( hConn, connectionLock, "ReceiveDeliveryReceiptsOnConnection" );
+	if ( !pConn )
+		return -1;
+	return pConn->APIReceiveDeliveryReceipts( pOutReceipts, nMaxReceipts );
+}
+
 int CSteamNetworkingSockets::GetDetailedConnectionStatus( HSteamNetConnection hConn, char *pszBuf, int cbBuf )
 {
 	SteamNetworkingDetailedConnectionStatus stats;
@@ -1771,10 +1897,15 @@ void CSteamNetworkingSockets::InternalQueueCallback( int nCallback, int cbCallba
 	}
 	m_mutexPendingCallbacks.lock();
 	AssertMsg( len( m_vecPendingCallbacks ) < 100, "Callbacks backing up and not being checked.  Need to check them more frequently!" );
+	const bool bWasEmpty = m_vecPendingCallbacks.empty();
 	QueuedCallback &q = *push_back_get_ptr( m_vecPendingCallbacks );
 	q.nCallback = nCallback;
 	q.fnCallback = fnRegisteredFunctionPtr;
 	memcpy( q.data, pvCallback, cbCallback );
+
+	// Only wake the app on the first one.  RunCallbacks dispatches them all
+	if ( bWasEmpty && m_pWakePendingCallbacks )
+		m_pWakePendingCallbacks->Signal();
 	m_mutexPendingCallbacks.unlock();
 }
 
@@ -2386,6 +2517,50 @@ bool CSteamNetworkingUtils::SteamNetworkingIdentity_ParseString( SteamNetworking
 	return ::SteamNetworkingIdentity_ParseString( pIdentity, sizeof(SteamNetworkingIdentity), pszStr );
 }
 
+bool CSteamNetworkingUtils::GetPerfMetrics( SteamNetworkingPerfMetrics_t *pMetrics )
+{
+	// NOTE: No global lock here.  The metrics have their own locking, and
+	// we don't want the act of measuring to show up in the lock histograms.
+	PerfMetrics_GetSnapshot( pMetrics );
+	return BPerfMetricsEnabled();
+}
+
+bool CSteamNetworkingUtils::SetCompressionDictionary( int nDictionaryID, const void *pData, int cbData )
+{
+	if ( nDictionaryID <= 0 || cbData < 0 )
+		return false;
+
+	SteamNetworkingGlobalLock scopeLock( "SetCompressionDictionary" );
+
+	// Locate the slot.  Connections have their own reference to the
+	// old dictionary, so we can just drop ours.
+	auto it = std::lower_bound( g_vecCompressionDictionaries.begin(), g_vecCompressionDictionaries.end(), nDictionaryID,
+		[]( const std::shared_ptr<const CompressionDictionary_t> &p, int nID ) { return p->m_nID < nID; } );
+	const bool bExists = it != g_vecCompressionDictionaries.end() && (*it)->m_nID == nDictionaryID;
+	if ( !pData )
+	{
+		if ( bExists )
+			g_vecCompressionDictionaries.erase( it );
+		return true;
+	}
+
+	std::shared_ptr<CompressionDictionary_t> pDict = std::make_shared<CompressionDictionary_t>();
+	pDict->m_nID = nDictionaryID;
+	pDict->m_dict.Init( pData, cbData );
+
+	// Hash what we will actually use, so that two dictionaries that
+	// differ only in the part we discard are compatible
+	SHA256Digest_t digest;
+	CCrypto::GenerateSHA256Digest( pDict->m_dict.Data(), pDict->m_dict.Size(), &digest );
+	pDict->m_nHash = LittleQWord( *(uint64*)&digest );
+
+	if ( bExists )
+		*it = std::move( pDict );
+	else
+		g_vecCompressionDictionaries.insert( it, std::move( pDict ) );
+	return true;
+}
+
 ESteamNetworkingFakeIPType CSteamNetworkingUtils::GetIPv4FakeIPType( uint32 nIPv4 )
 {
 	return SteamNetworkingSocketsLib::GetIPv4FakeIPType( nIPv4 );
@@ -2531,7 +2706,7 @@ STEAMNETWORKINGSOCKETS_INTERFACE void GameNetworkingSockets_Kill()
 	}
 }
 
-STEAMNETWORKINGSOCKETS_INTERFACE ISteamNetworkingSockets *SteamNetworkingSockets_LibV12()
+STEAMNETWORKINGSOCKETS_INTERFACE ISteamNetworkingSockets *SteamNetworkingSockets_LibV13()
 {
 	return s_pSteamNetworkingSockets;
 }
@@ -97,10 +97,17 @@ public:
 	virtual int ReceiveMessagesOnConnection( HSteamNetConnection hConn, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages ) override;
 	virtual bool GetConnectionInfo( HSteamNetConnection hConn, SteamNetConnectionInfo_t *pInfo ) override;
 	virtual EResult GetConnectionRealTimeStatus( HSteamNetConnection hConn, SteamNetConnectionRealTimeStatus_t *pStatus, int nLanes, SteamNetConnectionRealTimeLaneStatus_t *pLanes ) override;
+	virtual int GetConnectionSNPStatus( const HSteamNetConnection *pConnections, int nConnections, SteamNetConnectionSNPStatus_t *pOutStatus ) override;
+	virtual int ReceiveDeliveryReceiptsOnConnection( HSteamNetConnection hConn, SteamNetworkingDeliveryReceipt_t *pOutReceipts, int nMaxReceipts ) override;
 	virtual int GetDetailedConnectionStatus( HSteamNetConnection hConn, char *pszBuf, int cbBuf ) override;
 	virtual bool GetListenSocketAddress( HSteamListenSocket hSocket, SteamNetworkingIPAddr *pAddress ) override;
 	virtual bool CreateSocketPair( HSteamNetConnection *pOutConnection1, HSteamNetConnection *pOutConnection2, bool bUseNetworkLoopback, const SteamNetworkingIdentity *pPeerIdentity1, const SteamNetworkingIdentity *pPeerIdentity2 ) override;
 	virtual EResult ConfigureConnectionLanes( HSteamNetConnection hConn, int nNumLanes, const int *pLanePriorities, const uint16 *pLaneWeights ) override;
+	virtual EResult ConfigureConnectionLaneDeadlines( HSteamNetConnection hConn, int nNumLanes, const int *pLaneLatencyTargetsMS ) override;
+	virtual SteamNetworkingWakeHandle GetPollGroupWakeHandle( HSteamNetPollGroup hPollGroup ) override;
+	virtual SteamNetworkingWakeHandle GetConnectionWakeHandle( HSteamNetConnection hConn ) override;
+	virtual SteamNetworkingWakeHandle GetCallbacksWakeHandle() override;
+	virtual void SendMessagesWithOptions( int nMessages, SteamNetworkingMessage_t **pMessages, const SteamNetworkingMicroseconds *pUsecExpiry, const int64 *pCoalesceKeys, int64 *pOutMessageNumberOrResult, bool bDeleteFailedMessages ) override;
 	virtual bool GetIdentity( SteamNetworkingIdentity *pIdentity ) override;
 
 	virtual HSteamNetPollGroup CreatePollGroup() override;
@@ -270,6 +277,7 @@ protected:
 	};
 	std_vector<QueuedCallback> m_vecPendingCallbacks;
 	ShortDurationLock m_mutexPendingCallbacks;
+	CAppWakeHandle *m_pWakePendingCallbacks = nullptr; // Protected by m_mutexPendingCallbacks.  Created on demand
 	virtual void InternalQueueCallback( int nCallback, int cbCallback, const void *pvCallback, void *fnRegisteredFunctionPtr );
 
 	bool m_bHaveLowLevelRef;
@@ -320,6 +328,9 @@ public:
 	virtual void SteamNetworkingIdentity_ToString( const SteamNetworkingIdentity &identity, char *buf, size_t cbBuf ) override;
 	virtual bool SteamNetworkingIdentity_ParseString( SteamNetworkingIdentity *pIdentity, const char *pszStr ) override;
 
+	virtual bool GetPerfMetrics( SteamNetworkingPerfMetrics_t *pMetrics ) override;
+	virtual bool SetCompressionDictionary( int nDictionaryID, const void *pData, int cbData ) override;
+
 	virtual AppId_t GetAppID();
 
 	void SetAppID( AppId_t nAppID )
@@ -151,6 +151,8 @@ CSteamNetworkingMessage *CSteamNetworkingMessage::New( uint32 cbSize )
 	pMsg->m_nChannel = -1;
 	pMsg->m_nFlags = 0;
 	pMsg->m_idxLane = 0;
+	pMsg->m_usecExpiry = 0;
+	pMsg->m_nCoalesceKey = 0;
 	pMsg->m_links.Clear();
 	pMsg->m_linksSecondaryQueue.Clear();
 
@@ -172,6 +174,38 @@ void SteamNetworkingMessageQueue::AssertLockHeld() const
 		m_pRequiredLock->AssertHeldByCurrentThread();
 }
 
+SteamNetworkingWakeHandle SteamNetworkingMessageQueue::GetWakeHandle()
+{
+	AssertLockHeld();
+	if ( !m_pWake )
+	{
+		SteamNetworkingErrMsg errMsg;
+		m_pWake = CAppWakeHandle::Create( errMsg );
+		if ( !m_pWake )
+		{
+			SpewWarning( "Failed to create wake handle.  %s\n", errMsg );
+			return k_SteamNetworkingWakeHandle_Invalid;
+		}
+
+		// Don't make the app wait for the next message, if it already has some
+		if ( !empty() )
+			m_pWake->Signal();
+	}
+	return m_pWake->GetHandle();
+}
+
+void SteamNetworkingMessageQueue::SignalWake()
+{
+	AssertLockHeld();
+	m_pWake->Signal();
+}
+
+void SteamNetworkingMessageQueue::FreeWake()
+{
+	delete m_pWake;
+	m_pWake = nullptr;
+}
+
 void SteamNetworkingMessageQueue::PurgeMessages()
 {
 	AssertLockHeld();
@@ -260,6 +294,8 @@ CSteamNetworkPollGroup::~CSteamNetworkPollGroup()
 			// Make sure it worked.
 			Assert( pMsg != m_queueRecvMessages.m_pFirst );
 		}
+
+		m_queueRecvMessages.FreeWake();
 	}
 
 	// Remove us from global table, if we're in it
@@ -572,13 +608,17 @@ CSteamNetworkConnectionBase::CSteamNetworkConnectionBase( CSteamNetworkingSocket
 	m_hSelfInParentListenSocketMap = -1;
 	m_bCertHasIdentity = false;
 	m_bCryptKeysValid = false;
+	m_bHasResumptionSecretNext = false;
 	m_eNegotiatedCipher = k_ESteamNetworkingSocketsCipher_INVALID;
 	m_cbEncryptionOverhead = k_cbAESGCMTagSize;
+	m_nCompressLanesSend = 0;
+	m_nCompressLanesRecv = 0;
 	memset( m_szAppName, 0, sizeof( m_szAppName ) );
 	memset( m_szDescription, 0, sizeof( m_szDescription ) );
 	m_bConnectionInitiatedRemotely = false;
 	m_pTransport = nullptr;
 	m_nSupressStateChangeCallbacks = 0;
+	m_nPendingCryptoJobID = 0;
 
 	// Initialize configuration using parent interface for now.
 	m_connectionConfig.Init( &m_pSteamNetworkingSocketsInterface->m_connectionConfig );
@@ -599,6 +639,11 @@ CSteamNetworkConnectionBase::~CSteamNetworkConnectionBase()
 	SteamNetworkingGlobalLock::AssertHeldByCurrentThread();
 	g_tables_lock.AssertHeldByCurrentThread();
 
+	{
+		ShortDurationScopeLock lockMessageQueues( g_lockAllRecvMessageQueues );
+		m_queueRecvMessages.FreeWake();
+	}
+
 	// Remove from global connection list
 	if ( m_hConnectionSelf != k_HSteamNetConnection_Invalid )
 	{
@@ -1049,6 +1094,9 @@ void CSteamNetworkConnectionBase::ClearCrypto()
 	m_bCertHasIdentity = false;
 	m_bRemoteCertHasTrustedCASignature = false;
 	m_keyPrivate.Wipe();
+	m_pResumedSecret.reset();
+	m_resumptionSecretNext.Wipe();
+	m_bHasResumptionSecretNext = false;
 	ClearLocalCrypto();
 }
 
@@ -1057,7 +1105,12 @@ void CSteamNetworkConnectionBase::ClearLocalCrypto()
 	AssertLocksHeldByCurrentThread();
 	m_eNegotiatedCipher = k_ESteamNetworkingSocketsCipher_INVALID;
 	m_cbEncryptionOverhead = k_cbAESGCMTagSize;
-	m_keyExchangePrivateKeyLocal.Wipe();
+	m_nCompressLanesSend = 0;
+	m_nCompressLanesRecv = 0;
+	m_pCompressDictSend.reset();
+	m_pCompressDictRecv.reset();
+	m_vecCompressDictsOffered.clear();
+	m_pKeyExchangePrivateKeyLocal.reset();
 	m_msgCryptLocal.Clear();
 	m_msgSignedCryptLocal.Clear();
 	m_bCryptKeysValid = false;
@@ -1217,6 +1270,7 @@ void CSteamNetworkConnectionBase::SetLocalCert( const CMsgSteamDatagramCertifica
 	if ( !m_bConnectionInitiatedRemotely )
 	{
 		SetCryptoCipherList();
+		SetCryptoCompressionInfo();
 		FinalizeLocalCrypto();
 	}
 }
@@ -1226,6 +1280,25 @@ void CSteamNetworkConnectionBase::SetCryptoCipherList()
 	AssertLocksHeldByCurrentThread();
 	Assert( m_msgCryptLocal.ciphers_size() == 0 ); // Should only do this once
 
+	// Which of the encrypted ciphers do we prefer?  AES-GCM is
+	// much faster with hardware support, but slow without it.
+	m_connectionConfig.CipherPreference.Lock();
+	bool bPreferChaCha;
+	switch ( m_connectionConfig.CipherPreference.Get() )
+	{
+		default:
+			AssertMsg( false, "Unexpected value for 'CipherPreference' config value" );
+			// FALLTHROUGH
+			// |
+			// |
+			// V
+		case 0: bPreferChaCha = !CCrypto::HasHardwareAES(); break;
+		case 1: bPreferChaCha = false; break;
+		case 2: bPreferChaCha = true; break;
+	}
+	const ESteamNetworkingSocketsCipher eCipherEncrypted1 = bPreferChaCha ? k_ESteamNetworkingSocketsCipher_CHACHA20_POLY1305 : k_ESteamNetworkingSocketsCipher_AES_256_GCM;
+	const ESteamNetworkingSocketsCipher eCipherEncrypted2 = bPreferChaCha ? k_ESteamNetworkingSocketsCipher_AES_256_GCM : k_ESteamNetworkingSocketsCipher_CHACHA20_POLY1305;
+
 	// Select the ciphers we want to use, in preference order.
 	// Also, lock it, we cannot change it any more
 	m_connectionConfig.Unencrypted.Lock();
@@ -1240,19 +1313,25 @@ void CSteamNetworkConnectionBase::SetCryptoCipherList()
 			// V
 		case 0:
 			// Not allowed
-			m_msgCryptLocal.add_ciphers( k_ESteamNetworkingSocketsCipher_AES_256_GCM );
+			m_msgCryptLocal.add_ciphers( eCipherEncrypted1 );
+			if ( BCanNegotiateCipher() )
+				m_msgCryptLocal.add_ciphers( eCipherEncrypted2 );
 			break;
 
 		case 1:
 			// Allowed, but prefer encrypted
-			m_msgCryptLocal.add_ciphers( k_ESteamNetworkingSocketsCipher_AES_256_GCM );
+			m_msgCryptLocal.add_ciphers( eCipherEncrypted1 );
+			if ( BCanNegotiateCipher() )
+				m_msgCryptLocal.add_ciphers( eCipherEncrypted2 );
 			m_msgCryptLocal.add_ciphers( k_ESteamNetworkingSocketsCipher_NULL );
 			break;
 
 		case 2:
 			// Allowed, preferred
 			m_msgCryptLocal.add_ciphers( k_ESteamNetworkingSocketsCipher_NULL );
-			m_msgCryptLocal.add_ciphers( k_ESteamNetworkingSocketsCipher_AES_256_GCM );
+			m_msgCryptLocal.add_ciphers( eCipherEncrypted1 );
+			if ( BCanNegotiateCipher() )
+				m_msgCryptLocal.add_ciphers( eCipherEncrypted2 );
 			break;
 
 		case 3:
@@ -1262,6 +1341,282 @@ void CSteamNetworkConnectionBase::SetCryptoCipherList()
 	}
 }
 
+void CSteamNetworkConnectionBase::SetCryptoCompressionInfo()
+{
+	AssertLocksHeldByCurrentThread();
+
+	// Lock in the options.  The peer needs to know them to
+	// decide whether it can decompress what we send.
+	m_connectionConfig.CompressionLanes.Lock();
+	m_connectionConfig.CompressionDictionary.Lock();
+
+	// Tell the peer all of the dictionaries we have, so that it can
+	// use one to compress what it sends us.  Hold a reference to them,
+	// in case the app replaces them before the handshake is complete
+	m_msgCryptLocal.clear_compression_dictionaries();
+	m_vecCompressDictsOffered = g_vecCompressionDictionaries;
+	for ( const std::shared_ptr<const CompressionDictionary_t> &pDict: m_vecCompressDictsOffered )
+	{
+		CMsgSteamDatagramSessionCryptInfo_CompressionDictionary *pMsgDict = m_msgCryptLocal.add_compression_dictionaries();
+		pMsgDict->set_id( pDict->m_nID );
+		pMsgDict->set_hash( pDict->m_nHash );
+	}
+
+	// What will we compress, and with what?
+	m_pCompressDictSend.reset();
+	m_msgCryptLocal.clear_compression_dictionary();
+	uint32 nLanes = (uint32)m_connectionConfig.CompressionLanes.Get();
+	int nDictID = m_connectionConfig.CompressionDictionary.Get();
+	if ( nLanes && nDictID > 0 )
+	{
+		for ( const std::shared_ptr<const CompressionDictionary_t> &pDict: m_vecCompressDictsOffered )
+		{
+			if ( pDict->m_nID == nDictID )
+			{
+				m_pCompressDictSend = pDict;
+				break;
+			}
+		}
+		if ( !m_pCompressDictSend )
+		{
+			SpewWarning( "[%s] Compression dictionary %d has not been registered.  Messages will not be compressed\n", GetDescription(), nDictID );
+			nLanes = 0;
+		}
+		else
+		{
+			m_msgCryptLocal.mutable_compression_dictionary()->set_id( m_pCompressDictSend->m_nID );
+			m_msgCryptLocal.mutable_compression_dictionary()->set_hash( m_pCompressDictSend->m_nHash );
+		}
+	}
+	if ( nLanes )
+		m_msgCryptLocal.set_compression_lanes( nLanes );
+	else
+		m_msgCryptLocal.clear_compression_lanes();
+}
+
+void CSteamNetworkConnectionBase::NegotiateCompression()
+{
+	m_nCompressLanesSend = 0;
+	m_nCompressLanesRecv = 0;
+	m_pCompressDictRecv.reset();
+
+	// Older peers don't know about any of this.  They won't
+	// send anything compressed, and can't read it either
+	if ( m_msgCryptRemote.protocol_version() < 15 )
+	{
+		m_pCompressDictSend.reset();
+		m_vecCompressDictsOffered.clear();
+		return;
+	}
+
+	// Does the peer have the dictionary we want to use?  If not, we
+	// don't compress at all, since without it, compression will
+	// probably be a waste of time.
+	if ( m_msgCryptLocal.compression_lanes() )
+	{
+		if ( !m_pCompressDictSend )
+		{
+			m_nCompressLanesSend = m_msgCryptLocal.compression_lanes();
+		}
+		else
+		{
+			for ( const CMsgSteamDatagramSessionCryptInfo_CompressionDictionary &msgDict: m_msgCryptRemote.compression_dictionaries() )
+			{
+				if ( (int)msgDict.id() == m_pCompressDictSend->m_nID && msgDict.hash() == m_pCompressDictSend->m_nHash )
+				{
+					m_nCompressLanesSend = m_msgCryptLocal.compression_lanes();
+					break;
+				}
+			}
+			if ( !m_nCompressLanesSend )
+			{
+				SpewMsg( "[%s] Peer does not have compression dictionary %d (or it doesn't match ours).  Messages will not be compressed\n", GetDescription(), m_pCompressDictSend->m_nID );
+				m_pCompressDictSend.reset();
+			}
+		}
+	}
+
+	// Will the peer be compressing, and do we have what we need to
+	// decompress?  It should not compress unless we told it that we
+	// have the dictionary, but if it does, we'll reject the messages
+	if ( m_msgCryptRemote.compression_lanes() )
+	{
+		if ( !m_msgCryptRemote.has_compression_dictionary() )
+		{
+			m_nCompressLanesRecv = m_msgCryptRemote.compression_lanes();
+		}
+		else
+		{
+			const CMsgSteamDatagramSessionCryptInfo_CompressionDictionary &msgDict = m_msgCryptRemote.compression_dictionary();
+			for ( const std::shared_ptr<const CompressionDictionary_t> &pDict: m_vecCompressDictsOffered )
+			{
+				if ( (int)msgDict.id() == pDict->m_nID && msgDict.hash() == pDict->m_nHash )
+				{
+					m_pCompressDictRecv = pDict;
+					m_nCompressLanesRecv = m_msgCryptRemote.compression_lanes();
+					break;
+				}
+			}
+		}
+	}
+
+	// We don't need the others anymore
+	m_vecCompressDictsOffered.clear();
+
+	// Anything the app already queued needs to be compressed, too
+	if ( m_nCompressLanesSend )
+		SNP_CompressQueuedMessages();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// Pool of pre-generated key exchange keys
+//
+/////////////////////////////////////////////////////////////////////////////
+
+// Ephemeral keys for key exchange, generated ahead of time in the background,
+// so that accepting a connection doesn't have to wait for it.
+// Each key is handed out exactly once.  We hold them by pointer because
+// copying a private key recomputes the public key, which is the expensive part.
+// The pool isn't used until PrimeKeyExchangeKeyPool is called (when a listen
+// socket is created), so a client that only makes a few outbound connections
+// doesn't generate a bunch of keys it will never use.
+static std::vector< std::unique_ptr<CECKeyExchangePrivateKey> > s_vecKeyExchangeKeyPool;
+static bool s_bKeyExchangeKeyPoolPrimed;
+static bool s_bKeyExchangeKeyPoolRefillQueued;
+static ShortDurationLock s_lockKeyExchangeKeyPool( "key_exchange_key_pool", LockDebugInfo::k_nOrder_Max ); // Never take another lock while holding this
+
+// NOTE: If this is deleted without running (at shutdown), it is deleted while
+// the task queue is locked, so it must not touch s_lockKeyExchangeKeyPool.
+// FreeKeyExchangeKeyPool clears s_bKeyExchangeKeyPoolRefillQueued instead.
+class CKeyExchangeKeyPoolRefillTask : public CQueuedTask
+{
+private:
+	virtual void Run() override
+	{
+		// Generate keys one at a time, without holding the lock
+		for (;;)
+		{
+			s_lockKeyExchangeKeyPool.lock();
+			bool bFull = len( s_vecKeyExchangeKeyPool ) >= GlobalConfig::KeyExchangeKeyPoolSize.Get();
+			if ( bFull )
+				s_bKeyExchangeKeyPoolRefillQueued = false;
+			s_lockKeyExchangeKeyPool.unlock();
+			if ( bFull )
+				break;
+
+			std::unique_ptr<CECKeyExchangePrivateKey> pKey( new CECKeyExchangePrivateKey );
+			CCrypto::GenerateKeyExchangeKeyPair( nullptr, pKey.get() );
+
+			s_lockKeyExchangeKeyPool.lock();
+			s_vecKeyExchangeKeyPool.push_back( std::move( pKey ) );
+			s_lockKeyExchangeKeyPool.unlock();
+		}
+	}
+};
+
+/// Queue a task to top up the pool, if it needs it and there isn't one queued already
+static void CheckRefillKeyExchangeKeyPool()
+{
+	int nPoolSize = GlobalConfig::KeyExchangeKeyPoolSize.Get();
+	if ( nPoolSize <= 0 )
+		return;
+
+	s_lockKeyExchangeKeyPool.lock();
+	bool bQueueRefill = !s_bKeyExchangeKeyPoolRefillQueued && len( s_vecKeyExchangeKeyPool ) < nPoolSize;
+	if ( bQueueRefill )
+		s_bKeyExchangeKeyPoolRefillQueued = true;
+	s_lockKeyExchangeKeyPool.unlock();
+
+	if ( bQueueRefill )
+	{
+		CKeyExchangeKeyPoolRefillTask *pTask = new CKeyExchangeKeyPoolRefillTask;
+		pTask->QueueToRunInBackground();
+	}
+}
+
+void PrimeKeyExchangeKeyPool()
+{
+	s_lockKeyExchangeKeyPool.lock();
+	s_bKeyExchangeKeyPoolPrimed = true;
+	s_lockKeyExchangeKeyPool.unlock();
+
+	CheckRefillKeyExchangeKeyPool();
+}
+
+void FreeKeyExchangeKeyPool()
+{
+	std::vector< std::unique_ptr<CECKeyExchangePrivateKey> > vecKeys;
+	s_lockKeyExchangeKeyPool.lock();
+	vecKeys.swap( s_vecKeyExchangeKeyPool );
+	s_bKeyExchangeKeyPoolPrimed = false;
+	s_bKeyExchangeKeyPoolRefillQueued = false;
+	s_lockKeyExchangeKeyPool.unlock();
+
+	// These were never used, but they are still private keys.  Don't leave
+	// them lying around in memory
+	for ( std::unique_ptr<CECKeyExchangePrivateKey> &pKey: vecKeys )
+		pKey->Wipe();
+}
+
+/// Get a new keypair for key exchange.  This is safe to call from any thread
+static std::unique_ptr<CECKeyExchangePrivateKey> TakeKeyExchangeKey()
+{
+	std::unique_ptr<CECKeyExchangePrivateKey> pKey;
+	if ( GlobalConfig::KeyExchangeKeyPoolSize.Get() > 0 )
+	{
+		s_lockKeyExchangeKeyPool.lock();
+		bool bPrimed = s_bKeyExchangeKeyPoolPrimed;
+		if ( bPrimed && !s_vecKeyExchangeKeyPool.empty() )
+		{
+			pKey = std::move( s_vecKeyExchangeKeyPool.back() );
+			s_vecKeyExchangeKeyPool.pop_back();
+		}
+		s_lockKeyExchangeKeyPool.unlock();
+
+		// Only top the pool back up if somebody has asked for it
+		if ( bPrimed )
+		{
+			CheckRefillKeyExchangeKeyPool();
+			if ( unlikely( BPerfMetricsEnabled() ) )
+				PerfCounterAdd( pKey ? k_EPerfCounter_KeyExchangeKeyPoolHits : k_EPerfCounter_KeyExchangeKeyPoolMisses, 1 );
+		}
+	}
+
+	// Pool empty or disabled?  Generate one now
+	if ( !pKey )
+	{
+		pKey.reset( new CECKeyExchangePrivateKey );
+		CCrypto::GenerateKeyExchangeKeyPair( nullptr, pKey.get() );
+	}
+	return pKey;
+}
+
+/// Get a keypair for key exchange, and then serialize our crypt info and sign
+/// it with the private key that matches our cert.  This doesn't touch the connection,
+/// so it can be done on a worker thread.
+static void GenerateSignedCryptInfo( const CECSigningPrivateKey &keyPrivate, CMsgSteamDatagramSessionCryptInfo &msgCryptLocal,
+	std::unique_ptr<CECKeyExchangePrivateKey> &outKeyExchangePrivateKeyLocal, CMsgSteamDatagramSessionCryptInfoSigned &outMsgSignedCryptLocal )
+{
+	// Get a keypair for key exchange
+	outKeyExchangePrivateKeyLocal = TakeKeyExchangeKey();
+	CECKeyExchangePublicKey publicKeyLocal;
+	outKeyExchangePrivateKeyLocal->GetPublicKey( &publicKeyLocal );
+	msgCryptLocal.set_key_type( CMsgSteamDatagramSessionCryptInfo_EKeyType_CURVE25519 );
+	publicKeyLocal.GetRawDataAsStdString( msgCryptLocal.mutable_key_data() );
+
+	// Generate some more randomness for the secret key
+	uint64 crypt_nonce;
+	CCrypto::GenerateRandomBlock( &crypt_nonce, sizeof(crypt_nonce) );
+	msgCryptLocal.set_nonce( crypt_nonce );
+
+	// Serialize and sign the crypt key with the private key that matches this cert
+	outMsgSignedCryptLocal.set_info( msgCryptLocal.SerializeAsString() );
+	CryptoSignature_t sig;
+	keyPrivate.GenerateSignature( outMsgSignedCryptLocal.info().c_str(), outMsgSignedCryptLocal.info().length(), &sig );
+	outMsgSignedCryptLocal.set_signature( &sig, sizeof(sig) );
+}
+
 void CSteamNetworkConnectionBase::FinalizeLocalCrypto()
 {
 	AssertLocksHeldByCurrentThread( "FinalizeLocalCrypto" );
@@ -1276,22 +1631,8 @@ void CSteamNetworkConnectionBase::FinalizeLocalCrypto()
 	// Set protocol version
 	m_msgCryptLocal.set_protocol_version( k_nCurrentProtocolVersion );
 
-	// Generate a keypair for key exchange
-	CECKeyExchangePublicKey publicKeyLocal;
-	CCrypto::GenerateKeyExchangeKeyPair( &publicKeyLocal, &m_keyExchangePrivateKeyLocal );
-	m_msgCryptLocal.set_key_type( CMsgSteamDatagramSessionCryptInfo_EKeyType_CURVE25519 );
-	publicKeyLocal.GetRawDataAsStdString( m_msgCryptLocal.mutable_key_data() );
-
-	// Generate some more randomness for the secret key
-	uint64 crypt_nonce;
-	CCrypto::GenerateRandomBlock( &crypt_nonce, sizeof(crypt_nonce) );
-	m_msgCryptLocal.set_nonce( crypt_nonce );
-
-	// Serialize and sign the crypt key with the private key that matches this cert
-	m_msgSignedCryptLocal.set_info( m_msgCryptLocal.SerializeAsString() );
-	CryptoSignature_t sig;
-	m_keyPrivate.GenerateSignature( m_msgSignedCryptLocal.info().c_str(), m_msgSignedCryptLocal.info().length(), &sig );
-	m_msgSignedCryptLocal.set_signature( &sig, sizeof(sig) );
+	// Generate key exchange key, serialize, and sign
+	GenerateSignedCryptInfo( m_keyPrivate, m_msgCryptLocal, m_pKeyExchangePrivateKeyLocal, m_msgSignedCryptLocal );
 
 	// Note: In certain circumstances, we may need to do this again, so don't wipte the key just yet
 	//m_keyPrivate.Wipe();
@@ -1373,7 +1714,8 @@ ESteamNetConnectionEnd CSteamNetworkConnectionBase::RecvCryptoHandshake(
 	const CMsgSteamDatagramCertificateSigned &msgCert,
 	const CMsgSteamDatagramSessionCryptInfoSigned &msgSessionInfo,
 	bool bServer,
-	SteamNetworkingErrMsg &errMsg )
+	SteamNetworkingErrMsg &errMsg,
+	const CryptoHandshakeSignatureChecks_t *pPrecheckedSignatures )
 {
 	AssertLocksHeldByCurrentThread( "BRecvCryptoHandshake" );
 	SteamNetworkingErrMsg tmpErrMsg;
@@ -1404,9 +1746,20 @@ ESteamNetConnectionEnd CSteamNetworkConnectionBase::RecvCryptoHandshake(
 	if ( msgCert.has_ca_signature() )
 	{
 
-		// Check the signature and chain of trust, and expiry, and deserialize the signed cert
+		// Check the signature and chain of trust, and expiry, and deserialize the signed cert.
+		// If the signature was already checked, we just need to check the chain of trust.
 		time_t timeNow = m_pSteamNetworkingSocketsInterface->m_pSteamNetworkingUtils->GetTimeSecure();
-		pCACertAuthScope = CertStore_CheckCert( msgCert, m_msgCertRemote, timeNow, tmpErrMsg );
+		if ( pPrecheckedSignatures && pPrecheckedSignatures->m_bCASignatureChecked && !pPrecheckedSignatures->m_bCASignatureValid )
+		{
+			V_strcpy_safe( tmpErrMsg, "Signature verification failed" );
+		}
+		else
+		{
+			const CECSigningPublicKey *pKeySignatureVerified = nullptr;
+			if ( pPrecheckedSignatures && pPrecheckedSignatures->m_bCASignatureChecked )
+				pKeySignatureVerified = &pPrecheckedSignatures->m_keyCA;
+			pCACertAuthScope = CertStore_CheckCert( msgCert, m_msgCertRemote, timeNow, tmpErrMsg, pKeySignatureVerified );
+		}
 		if ( !pCACertAuthScope )
 		{
 
@@ -1495,7 +1848,15 @@ ESteamNetConnectionEnd CSteamNetworkConnectionBase::RecvCryptoHandshake(
 		return eRemoteCertFailure;
 
 	// Check the signature of the crypt info
-	if ( !BCheckSignature( m_sCryptRemote, m_msgCertRemote.key_type(), m_msgCertRemote.key_data(), msgSessionInfo.signature(), errMsg ) )
+	if ( pPrecheckedSignatures )
+	{
+		if ( !pPrecheckedSignatures->m_bSessionSignatureValid )
+		{
+			V_strcpy_safe( errMsg, pPrecheckedSignatures->m_errSessionSignature );
+			return k_ESteamNetConnectionEnd_Remote_BadCrypt;
+		}
+	}
+	else if ( !BCheckSignature( m_sCryptRemote, m_msgCertRemote.key_type(), m_msgCertRemote.key_data(), msgSessionInfo.signature(), errMsg ) )
 	{
 		return k_ESteamNetConnectionEnd_Remote_BadCrypt;
 	}
@@ -1503,6 +1864,105 @@ ESteamNetConnectionEnd CSteamNetworkConnectionBase::RecvCryptoHandshake(
 	// Remember if we they were authenticated
 	m_bRemoteCertHasTrustedCASignature = ( pCACertAuthScope != nullptr );
 
+	return RecvCryptInfoRemote( bServer, errMsg );
+}
+
+void CSteamNetworkConnectionBase::SetResumedSessionSecret( const AutoWipeFixedSizeBuffer<32> &secret )
+{
+	AssertLocksHeldByCurrentThread();
+	Assert( !m_bCryptKeysValid );
+	m_pResumedSecret.reset( new AutoWipeFixedSizeBuffer<32> );
+	V_memcpy( m_pResumedSecret->m_buf, secret.m_buf, secret.k_nSize );
+}
+
+void CSteamNetworkConnectionBase::ClearResumedSessionSecret()
+{
+	AssertLocksHeldByCurrentThread();
+	Assert( !m_bCryptKeysValid );
+	m_pResumedSecret.reset();
+}
+
+static void GenerateResumptionMAC( const AutoWipeFixedSizeBuffer<32> &secret, const std::string &sInfo, SHA256Digest_t &outMAC )
+{
+	CCrypto::GenerateHMAC256( (const uint8 *)sInfo.c_str(), (uint32)sInfo.length(), secret.m_buf, secret.k_nSize, &outMAC );
+}
+
+std::string CSteamNetworkConnectionBase::GetResumptionMACLocal() const
+{
+	Assert( m_pResumedSecret );
+	Assert( m_msgSignedCryptLocal.has_info() );
+	SHA256Digest_t mac;
+	GenerateResumptionMAC( *m_pResumedSecret, m_msgSignedCryptLocal.info(), mac );
+	return std::string( (const char *)mac, sizeof(mac) );
+}
+
+ESteamNetConnectionEnd CSteamNetworkConnectionBase::RecvResumedCryptoHandshake(
+	const CMsgSteamDatagramSessionCryptInfoSigned &msgSessionInfo,
+	const std::string &sMAC,
+	bool bRemoteTrusted,
+	bool bServer,
+	SteamNetworkingErrMsg &errMsg )
+{
+	AssertLocksHeldByCurrentThread( "RecvResumedCryptoHandshake" );
+
+	// Have we already done key exchange?
+	if ( m_bCryptKeysValid )
+	{
+		Assert( m_eNegotiatedCipher != k_ESteamNetworkingSocketsCipher_INVALID );
+		return k_ESteamNetConnectionEnd_Invalid;
+	}
+	Assert( m_eNegotiatedCipher == k_ESteamNetworkingSocketsCipher_INVALID );
+
+	if ( !m_pResumedSecret )
+	{
+		V_strcpy_safe( errMsg, "Not resuming a session" );
+		return k_ESteamNetConnectionEnd_Remote_BadCrypt;
+	}
+	if ( !msgSessionInfo.has_info() )
+	{
+		V_strcpy_safe( errMsg, "Crypto handshake missing session data" );
+		return k_ESteamNetConnectionEnd_Remote_BadCrypt;
+	}
+
+	// Check the MAC.  This proves that they know the secret, and that
+	// nobody has tampered with the crypt info.  (E.g. to downgrade the cipher.)
+	SHA256Digest_t mac;
+	GenerateResumptionMAC( *m_pResumedSecret, msgSessionInfo.info(), mac );
+	uint8 diff = ( sMAC.length() == sizeof(mac) ) ? 0 : 1;
+	for ( int i = 0 ; i < (int)sizeof(mac) && i < (int)sMAC.length() ; ++i )
+		diff |= mac[i] ^ (uint8)sMAC[i];
+	if ( diff != 0 )
+	{
+		V_strcpy_safe( errMsg, "Session resumption MAC mismatch" );
+		return k_ESteamNetConnectionEnd_Remote_BadCrypt;
+	}
+
+	// If they didn't have a trusted cert when the session was established, make
+	// sure that's still OK with us.  (Certs and identity were checked at that time.)
+	if ( !bRemoteTrusted )
+	{
+		EUnsignedCert eAllow = AllowRemoteUnsignedCert();
+		if ( eAllow == k_EUnsignedCert_AllowWarn )
+		{
+			SpewMsg( "[%s] Resuming session with peer that has no trusted cert.  Connection is not secure.\n", GetDescription() );
+		}
+		else if ( eAllow != k_EUnsignedCert_Allow )
+		{
+			V_strcpy_safe( errMsg, "Resumed session was not authenticated" );
+			return k_ESteamNetConnectionEnd_Remote_BadCert;
+		}
+	}
+	m_bRemoteCertHasTrustedCASignature = bRemoteTrusted;
+
+	// There's no cert.  The crypt info is used for key generation material
+	m_sCertRemote.clear();
+	m_sCryptRemote = msgSessionInfo.info();
+
+	return RecvCryptInfoRemote( bServer, errMsg );
+}
+
+ESteamNetConnectionEnd CSteamNetworkConnectionBase::RecvCryptInfoRemote( bool bServer, SteamNetworkingErrMsg &errMsg )
+{
 	// Deserialize crypt info
 	if ( !m_msgCryptRemote.ParseFromString( m_sCryptRemote ) )
 	{
@@ -1587,30 +2047,196 @@ ESteamNetConnectionEnd CSteamNetworkConnectionBase::RecvCryptoHandshake(
 	return k_ESteamNetConnectionEnd_Invalid;
 }
 
-ESteamNetConnectionEnd CSteamNetworkConnectionBase::FinishCryptoHandshake( bool bServer, SteamNetworkingErrMsg &errMsg )
+/// HMAC key derivation function.  Take a shared secret, either from key exchange or
+/// from an earlier session that we are resuming, and produce the symmetric keys and IVs.
+/// Optionally also produce a secret that can be used to resume this session later.
+/// This doesn't touch the connection, so it can be done on a worker thread.
+static void ExpandSessionKeys(
+	const AutoWipeFixedSizeBuffer<sizeof(SHA256Digest_t)> &premasterSecret,
+	uint64 nNonceRemote, uint64 nNonceLocal,
+	const std::string &sCertRemote, const std::string &sCertLocal,
+	const std::string &sCryptRemote, const std::string &sCryptLocal,
+	uint32 unConnectionIDLocal, uint32 unConnectionIDRemote,
+	bool bServer,
+	AutoWipeFixedSizeBuffer<32> &cryptKeySend, AutoWipeFixedSizeBuffer<32> &cryptKeyRecv,
+	AutoWipeFixedSizeBuffer<12> &cryptIVSend, AutoWipeFixedSizeBuffer<12> &cryptIVRecv,
+	AutoWipeFixedSizeBuffer<32> *pResumptionSecret )
 {
-	AssertLocksHeldByCurrentThread( "BFinishCryptoHandshake" );
+	//
+	// HMAC Key derivation function.
+	//
+	// https://tools.ietf.org/html/rfc5869
+	// https://docs.google.com/document/d/1g5nIXAIkN_Y-7XJW5K45IblHd_L2f5LTaDUDwvZ5L6g/edit - Google QUIC as of 4/26/2017
+	//
+
+	//
+	// 1. Extract: take premaster secret from key exchange and mix it so that it's evenly distributed, producing Pseudorandom key ("PRK")
+	//
+	uint64 salt[2] = { LittleQWord( nNonceRemote ), LittleQWord( nNonceLocal ) };
+	if ( bServer )
+		std::swap( salt[0], salt[1] );
+	AutoWipeFixedSizeBuffer<sizeof(SHA256Digest_t)> prk;
+	CCrypto::GenerateHMAC256( (const uint8 *)salt, sizeof(salt), premasterSecret.m_buf, premasterSecret.k_nSize, &prk.m_buf );
+
+	//
+	// 2. Expand: Use PRK as seed to generate all the different keys we need, mixing with connection-specific context
+	//
+
+	COMPILE_TIME_ASSERT( sizeof( cryptKeyRecv ) == sizeof(SHA256Digest_t) );
+	COMPILE_TIME_ASSERT( sizeof( cryptKeySend ) == sizeof(SHA256Digest_t) );
+	COMPILE_TIME_ASSERT( sizeof( cryptIVRecv ) <= sizeof(SHA256Digest_t) );
+	COMPILE_TIME_ASSERT( sizeof( cryptIVSend ) <= sizeof(SHA256Digest_t) );
+
+	uint8 *expandOrder[4] = { cryptKeySend.m_buf, cryptKeyRecv.m_buf, cryptIVSend.m_buf, cryptIVRecv.m_buf };
+	int expandSize[4] = { cryptKeySend.k_nSize, cryptKeyRecv.k_nSize, cryptIVSend.k_nSize, cryptIVRecv.k_nSize };
+	const std::string *context[4] = { &sCertRemote, &sCertLocal, &sCryptRemote, &sCryptLocal };
+	uint32 unConnectionIDContext[2] = { LittleDWord( unConnectionIDLocal ), LittleDWord( unConnectionIDRemote ) };
+
+	// Make sure that both peers do things the same, so swap "local" and "remote" on one side arbitrarily.
+	if ( bServer )
+	{
+		std::swap( expandOrder[0], expandOrder[1] );
+		std::swap( expandOrder[2], expandOrder[3] );
+		std::swap( expandSize[0], expandSize[1] ); // Actually NOP, but makes me feel better
+		std::swap( expandSize[2], expandSize[3] );
+		std::swap( context[0], context[1] );
+		std::swap( context[2], context[3] );
+		std::swap( unConnectionIDContext[0], unConnectionIDContext[1] );
+	}
+	//SpewMsg( "%s unConnectionIDContext = [ %u, %u ]\n", bServer ? "Server" : "Client", unConnectionIDContext[0], unConnectionIDContext[1] );
+
+	// Generate connection "context" buffer
+	CUtlBuffer bufContext( 0, (int)( sizeof(SHA256Digest_t) + sizeof(unConnectionIDContext) + 64 + context[0]->length() + context[1]->length() + context[2]->length() + context[3]->length() ), 0 );
+	bufContext.SeekPut( CUtlBuffer::SEEK_HEAD, sizeof(SHA256Digest_t) );
+	uint8 *pStart = (uint8 *)bufContext.PeekPut();
+
+	// Write connection ID(s) into context buffer
+	bufContext.Put( unConnectionIDContext, sizeof(unConnectionIDContext) );
+
+	bufContext.Put( "Steam datagram", 14 );
+	for ( const std::string *c: context )
+		bufContext.Put( c->c_str(), (int)c->length() );
+
+	// Now extract the keys according to the method in the RFC.  The secret
+	// for session resumption is a 5th output, which does not change the
+	// first four, so peers that don't know about resumption derive the
+	// same keys.  It's the same on both sides, so no need to swap anything.
+	uint8 *pLastByte = (uint8 *)bufContext.PeekPut();
+	SHA256Digest_t expandTemp;
+	const int nExpand = pResumptionSecret ? 5 : 4;
+	for ( int idxExpand = 0 ; idxExpand < nExpand ; ++idxExpand )
+	{
+		*pLastByte = idxExpand+1;
+		CCrypto::GenerateHMAC256( pStart, pLastByte - pStart + 1, prk.m_buf, prk.k_nSize, &expandTemp );
+		if ( idxExpand < 4 )
+		{
+			V_memcpy( expandOrder[ idxExpand ], &expandTemp, expandSize[ idxExpand ] );
+		}
+		else
+		{
+			COMPILE_TIME_ASSERT( sizeof( *pResumptionSecret ) == sizeof(SHA256Digest_t) );
+			V_memcpy( pResumptionSecret->m_buf, &expandTemp, sizeof(SHA256Digest_t) );
+		}
+
+		//SpewMsg( "%s key %d: %02x%02x%02x%02x\n", bServer ? "Server" : "Client", idxExpand, expandTemp[0], expandTemp[1], expandTemp[2], expandTemp[3] );
+
+		// Copy previous digest to use in generating the next one
+		pStart = (uint8 *)bufContext.Base();
+		V_memcpy( pStart, &expandTemp, sizeof(SHA256Digest_t) );
+	}
 
+	//
+	// Tidy up key droppings
+	//
+	SecureZeroMemory( bufContext.Base(), bufContext.SizeAllocated() );
+	SecureZeroMemory( expandTemp, sizeof(expandTemp) );
+}
+
+/// Diffie-Hellman key exchange, followed by the HMAC key derivation function,
+/// to produce the symmetric keys and IVs.  This doesn't touch the connection,
+/// so it can be done on a worker thread.
+static ESteamNetConnectionEnd DeriveSessionKeys(
+	const CECKeyExchangePrivateKey &keyExchangePrivateKeyLocal,
+	const CMsgSteamDatagramSessionCryptInfo &msgCryptRemote,
+	uint64 nNonceLocal,
+	const std::string &sCertRemote, const std::string &sCertLocal,
+	const std::string &sCryptRemote, const std::string &sCryptLocal,
+	uint32 unConnectionIDLocal, uint32 unConnectionIDRemote,
+	bool bServer,
+	AutoWipeFixedSizeBuffer<32> &cryptKeySend, AutoWipeFixedSizeBuffer<32> &cryptKeyRecv,
+	AutoWipeFixedSizeBuffer<12> &cryptIVSend, AutoWipeFixedSizeBuffer<12> &cryptIVRecv,
+	AutoWipeFixedSizeBuffer<32> *pResumptionSecret,
+	SteamNetworkingErrMsg &errMsg )
+{
+	// Key exchange public key
+	CECKeyExchangePublicKey keyExchangePublicKeyRemote;
+	if ( msgCryptRemote.key_type() != CMsgSteamDatagramSessionCryptInfo_EKeyType_CURVE25519 )
+	{
+		V_sprintf_safe( errMsg, "Unsupported DH key type %d", (int)msgCryptRemote.key_type() );
+		return k_ESteamNetConnectionEnd_Remote_BadCrypt;
+	}
+	if ( !keyExchangePublicKeyRemote.SetRawDataWithoutWipingInput( msgCryptRemote.key_data().c_str(), msgCryptRemote.key_data().length() ) )
+	{
+		V_strcpy_safe( errMsg, "Invalid DH key" );
+		return k_ESteamNetConnectionEnd_Remote_BadCrypt;
+	}
+
+	// Diffie-Hellman key exchange to get "premaster secret"
+	AutoWipeFixedSizeBuffer<sizeof(SHA256Digest_t)> premasterSecret;
+	if ( !CCrypto::PerformKeyExchange( keyExchangePrivateKeyLocal, keyExchangePublicKeyRemote, &premasterSecret.m_buf ) )
+	{
+		V_strcpy_safe( errMsg, "Key exchange failed" );
+		return k_ESteamNetConnectionEnd_Remote_BadCrypt;
+	}
+	//SpewMsg( "%s premaster: %02x%02x%02x%02x\n", bServer ? "Server" : "Client", premasterSecret.m_buf[0], premasterSecret.m_buf[1], premasterSecret.m_buf[2], premasterSecret.m_buf[3] );
+
+	ExpandSessionKeys( premasterSecret, msgCryptRemote.nonce(), nNonceLocal,
+		sCertRemote, sCertLocal, sCryptRemote, sCryptLocal,
+		unConnectionIDLocal, unConnectionIDRemote, bServer,
+		cryptKeySend, cryptKeyRecv, cryptIVSend, cryptIVRecv, pResumptionSecret );
+
+	return k_ESteamNetConnectionEnd_Invalid;
+}
+
+ESteamNetConnectionEnd CSteamNetworkConnectionBase::NegotiateCipher( SteamNetworkingErrMsg &errMsg )
+{
 	// On the server, we have been waiting to decide what ciphers we are willing to use.
 	// (Because we want to give the app to set any connection options).
 	if ( m_bConnectionInitiatedRemotely )
 	{
 		Assert( m_msgCryptLocal.ciphers_size() == 0 );
 		SetCryptoCipherList();
+		SetCryptoCompressionInfo();
 	}
 	Assert( m_msgCryptLocal.ciphers_size() > 0 );
 
 	// Find a mutually-acceptable cipher
 	Assert( m_eNegotiatedCipher == k_ESteamNetworkingSocketsCipher_INVALID );
 	m_eNegotiatedCipher = k_ESteamNetworkingSocketsCipher_INVALID;
+	auto FindCipher = []( const google::protobuf::RepeatedField<int> &ciphers, ESteamNetworkingSocketsCipher eCipher ) -> int
+	{
+		auto it = std::find( ciphers.begin(), ciphers.end(), (int)eCipher );
+		return it == ciphers.end() ? -1 : int( it - ciphers.begin() );
+	};
 	for ( int eCipher : m_msgCryptLocal.ciphers() )
 	{
-		if ( std::find( m_msgCryptRemote.ciphers().begin(), m_msgCryptRemote.ciphers().end(), eCipher ) != m_msgCryptRemote.ciphers().end() )
+		if ( FindCipher( m_msgCryptRemote.ciphers(), ESteamNetworkingSocketsCipher(eCipher) ) >= 0 )
 		{
 			m_eNegotiatedCipher = ESteamNetworkingSocketsCipher(eCipher);
 			break;
 		}
 	}
+
+	// If we would pick AES, but the peer ranked ChaCha20-Poly1305 ahead of
+	// it, that means they don't have AES hardware.  ChaCha20 is reasonably
+	// cheap for us either way, so defer to them.
+	if ( m_eNegotiatedCipher == k_ESteamNetworkingSocketsCipher_AES_256_GCM && FindCipher( m_msgCryptLocal.ciphers(), k_ESteamNetworkingSocketsCipher_CHACHA20_POLY1305 ) >= 0 )
+	{
+		int idxRemoteChaCha = FindCipher( m_msgCryptRemote.ciphers(), k_ESteamNetworkingSocketsCipher_CHACHA20_POLY1305 );
+		if ( idxRemoteChaCha >= 0 && idxRemoteChaCha < FindCipher( m_msgCryptRemote.ciphers(), k_ESteamNetworkingSocketsCipher_AES_256_GCM ) )
+			m_eNegotiatedCipher = k_ESteamNetworkingSocketsCipher_CHACHA20_POLY1305;
+	}
+
 	switch (m_eNegotiatedCipher )
 	{
 		default:
@@ -1625,126 +2251,104 @@ ESteamNetConnectionEnd CSteamNetworkConnectionBase::FinishCryptoHandshake( bool
 		case k_ESteamNetworkingSocketsCipher_AES_256_GCM:
 			m_cbEncryptionOverhead = k_cbAESGCMTagSize;
 			break;
-	}
-
-	// Recalculate MTU
-	UpdateMTUFromConfig( true );
 
-	// If we're the server, then lock in that single cipher as the only
-	// acceptable cipher, and then we are ready to seal up our crypt info
-	// and send it back to them in accept message(s)
-	if ( m_bConnectionInitiatedRemotely )
-	{
-		Assert( !m_msgSignedCryptLocal.has_info() );
-		m_msgCryptLocal.clear_ciphers();
-		m_msgCryptLocal.add_ciphers( m_eNegotiatedCipher );
-		FinalizeLocalCrypto();
-	}
-	Assert( m_msgSignedCryptLocal.has_info() );
-
-	// At this point, we know that we will never the private key again.  So let's
-	// wipe it now, to minimize the number of copies of this hanging around in memory.
-	m_keyPrivate.Wipe();
-
-	// Key exchange public key
-	CECKeyExchangePublicKey keyExchangePublicKeyRemote;
-	if ( m_msgCryptRemote.key_type() != CMsgSteamDatagramSessionCryptInfo_EKeyType_CURVE25519 )
-	{
-		V_sprintf_safe( errMsg, "Unsupported DH key type %d", (int)m_msgCryptRemote.key_type() );
-		return k_ESteamNetConnectionEnd_Remote_BadCrypt;
-	}
-	if ( !keyExchangePublicKeyRemote.SetRawDataWithoutWipingInput( m_msgCryptRemote.key_data().c_str(), m_msgCryptRemote.key_data().length() ) )
-	{
-		V_strcpy_safe( errMsg, "Invalid DH key" );
-		return k_ESteamNetConnectionEnd_Remote_BadCrypt;
-	}
-
-	// Diffie-Hellman key exchange to get "premaster secret"
-	AutoWipeFixedSizeBuffer<sizeof(SHA256Digest_t)> premasterSecret;
-	if ( !CCrypto::PerformKeyExchange( m_keyExchangePrivateKeyLocal, keyExchangePublicKeyRemote, &premasterSecret.m_buf ) )
-	{
-		V_strcpy_safe( errMsg, "Key exchange failed" );
-		return k_ESteamNetConnectionEnd_Remote_BadCrypt;
+		case k_ESteamNetworkingSocketsCipher_CHACHA20_POLY1305:
+			m_cbEncryptionOverhead = k_cbChaCha20Poly1305TagSize;
+			break;
 	}
-	//SpewMsg( "%s premaster: %02x%02x%02x%02x\n", bServer ? "Server" : "Client", premasterSecret.m_buf[0], premasterSecret.m_buf[1], premasterSecret.m_buf[2], premasterSecret.m_buf[3] );
-
-	// We won't need this again, so go ahead and discard it now.
-	m_keyExchangePrivateKeyLocal.Wipe();
-
-	//
-	// HMAC Key derivation function.
-	//
-	// https://tools.ietf.org/html/rfc5869
-	// https://docs.google.com/document/d/1g5nIXAIkN_Y-7XJW5K45IblHd_L2f5LTaDUDwvZ5L6g/edit - Google QUIC as of 4/26/2017
-	//
-
-	//
-	// 1. Extract: take premaster secret from key exchange and mix it so that it's evenly distributed, producing Pseudorandom key ("PRK")
-	//
-	uint64 salt[2] = { LittleQWord( m_msgCryptRemote.nonce() ), LittleQWord( m_msgCryptLocal.nonce() ) };
-	if ( bServer )
-		std::swap( salt[0], salt[1] );
-	AutoWipeFixedSizeBuffer<sizeof(SHA256Digest_t)> prk;
-	CCrypto::GenerateHMAC256( (const uint8 *)salt, sizeof(salt), premasterSecret.m_buf, premasterSecret.k_nSize, &prk.m_buf );
-	premasterSecret.Wipe();
-
-	//
-	// 2. Expand: Use PRK as seed to generate all the different keys we need, mixing with connection-specific context
-	//
 
-	AutoWipeFixedSizeBuffer<32> cryptKeySend;
-	AutoWipeFixedSizeBuffer<32> cryptKeyRecv;
-	COMPILE_TIME_ASSERT( sizeof( cryptKeyRecv ) == sizeof(SHA256Digest_t) );
-	COMPILE_TIME_ASSERT( sizeof( cryptKeySend ) == sizeof(SHA256Digest_t) );
-	COMPILE_TIME_ASSERT( sizeof( m_cryptIVRecv ) <= sizeof(SHA256Digest_t) );
-	COMPILE_TIME_ASSERT( sizeof( m_cryptIVSend ) <= sizeof(SHA256Digest_t) );
+	// Recalculate MTU
+	UpdateMTUFromConfig( true );
 
-	uint8 *expandOrder[4] = { cryptKeySend.m_buf, cryptKeyRecv.m_buf, m_cryptIVSend.m_buf, m_cryptIVRecv.m_buf };
-	int expandSize[4] = { cryptKeySend.k_nSize, cryptKeyRecv.k_nSize, m_cryptIVSend.k_nSize, m_cryptIVRecv.k_nSize };
-	const std::string *context[4] = { &m_sCertRemote, &m_msgSignedCertLocal.cert(), &m_sCryptRemote, &m_msgSignedCryptLocal.info() };
-	uint32 unConnectionIDContext[2] = { LittleDWord( m_unConnectionIDLocal ), LittleDWord( m_unConnectionIDRemote ) };
+	// Now that we know what the peer can do, decide what we will compress
+	NegotiateCompression();
 
-	// Make sure that both peers do things the same, so swap "local" and "remote" on one side arbitrarily.
-	if ( bServer )
+	// If we're the server, then lock in that single cipher as the only
+	// acceptable cipher.  Then we are ready to seal up our crypt info
+	// and send it back to them in accept message(s)
+	if ( m_bConnectionInitiatedRemotely )
 	{
-		std::swap( expandOrder[0], expandOrder[1] );
-		std::swap( expandOrder[2], expandOrder[3] );
-		std::swap( expandSize[0], expandSize[1] ); // Actually NOP, but makes me feel better
-		std::swap( expandSize[2], expandSize[3] );
-		std::swap( context[0], context[1] );
-		std::swap( context[2], context[3] );
-		std::swap( unConnectionIDContext[0], unConnectionIDContext[1] );
+		Assert( !m_msgSignedCryptLocal.has_info() );
+		m_msgCryptLocal.clear_ciphers();
+		m_msgCryptLocal.add_ciphers( m_eNegotiatedCipher );
 	}
-	//SpewMsg( "%s unConnectionIDContext = [ %u, %u ]\n", bServer ? "Server" : "Client", unConnectionIDContext[0], unConnectionIDContext[1] );
 
-	// Generate connection "context" buffer
-	CUtlBuffer bufContext( 0, (int)( sizeof(SHA256Digest_t) + sizeof(unConnectionIDContext) + 64 + context[0]->length() + context[1]->length() + context[2]->length() + context[3]->length() ), 0 );
-	bufContext.SeekPut( CUtlBuffer::SEEK_HEAD, sizeof(SHA256Digest_t) );
-	uint8 *pStart = (uint8 *)bufContext.PeekPut();
+	return k_ESteamNetConnectionEnd_Invalid;
+}
 
-	// Write connection ID(s) into context buffer
-	bufContext.Put( unConnectionIDContext, sizeof(unConnectionIDContext) );
+ESteamNetConnectionEnd CSteamNetworkConnectionBase::FinishCryptoHandshake( bool bServer, SteamNetworkingErrMsg &errMsg )
+{
+	AssertLocksHeldByCurrentThread( "BFinishCryptoHandshake" );
 
-	bufContext.Put( "Steam datagram", 14 );
-	for ( const std::string *c: context )
-		bufContext.Put( c->c_str(), (int)c->length() );
+	ESteamNetConnectionEnd eResult = NegotiateCipher( errMsg );
+	if ( eResult != k_ESteamNetConnectionEnd_Invalid )
+		return eResult;
 
-	// Now extract the keys according to the method in the RFC
-	uint8 *pLastByte = (uint8 *)bufContext.PeekPut();
-	SHA256Digest_t expandTemp;
-	for ( int idxExpand = 0 ; idxExpand < 4 ; ++idxExpand )
+	// Resuming an earlier session?  Then we don't need key exchange or signatures,
+	// the keys come from the secret of the earlier session and the fresh nonces.
+	if ( m_pResumedSecret )
 	{
-		*pLastByte = idxExpand+1;
-		CCrypto::GenerateHMAC256( pStart, pLastByte - pStart + 1, prk.m_buf, prk.k_nSize, &expandTemp );
-		V_memcpy( expandOrder[ idxExpand ], &expandTemp, expandSize[ idxExpand ] );
+		if ( m_bConnectionInitiatedRemotely )
+		{
+			Assert( !m_msgSignedCryptLocal.has_info() );
+			m_msgCryptLocal.set_protocol_version( k_nCurrentProtocolVersion );
+			uint64 crypt_nonce;
+			CCrypto::GenerateRandomBlock( &crypt_nonce, sizeof(crypt_nonce) );
+			m_msgCryptLocal.set_nonce( crypt_nonce );
+			m_msgSignedCryptLocal.set_info( m_msgCryptLocal.SerializeAsString() );
+			CheckScheduleDiagnosticsUpdateASAP();
+		}
+		Assert( m_msgSignedCryptLocal.has_info() );
+		m_keyPrivate.Wipe();
+		m_pKeyExchangePrivateKeyLocal.reset();
 
-		//SpewMsg( "%s key %d: %02x%02x%02x%02x\n", bServer ? "Server" : "Client", idxExpand, expandTemp[0], expandTemp[1], expandTemp[2], expandTemp[3] );
+		AutoWipeFixedSizeBuffer<32> cryptKeySend;
+		AutoWipeFixedSizeBuffer<32> cryptKeyRecv;
+		ExpandSessionKeys( *m_pResumedSecret, m_msgCryptRemote.nonce(), m_msgCryptLocal.nonce(),
+			std::string(), std::string(), m_sCryptRemote, m_msgSignedCryptLocal.info(),
+			m_unConnectionIDLocal, m_unConnectionIDRemote, bServer,
+			cryptKeySend, cryptKeyRecv, m_cryptIVSend, m_cryptIVRecv, &m_resumptionSecretNext );
+		m_bHasResumptionSecretNext = true;
+		if ( unlikely( BPerfMetricsEnabled() ) )
+			PerfCounterAdd( k_EPerfCounter_SessionsResumed, 1 );
 
-		// Copy previous digest to use in generating the next one
-		pStart = (uint8 *)bufContext.Base();
-		V_memcpy( pStart, &expandTemp, sizeof(SHA256Digest_t) );
+		return InstallCryptKeys( cryptKeySend, cryptKeyRecv, errMsg );
+	}
+
+	// If we're the server, seal up our crypt info now that the cipher is locked in
+	if ( m_bConnectionInitiatedRemotely )
+		FinalizeLocalCrypto();
+	Assert( m_msgSignedCryptLocal.has_info() );
+
+	// At this point, we know that we will never the private key again.  So let's
+	// wipe it now, to minimize the number of copies of this hanging around in memory.
+	m_keyPrivate.Wipe();
+
+	// Key exchange and key derivation
+	if ( !m_pKeyExchangePrivateKeyLocal )
+	{
+		AssertMsg( false, "No local key exchange key" );
+		V_strcpy_safe( errMsg, "No local key exchange key" );
+		return k_ESteamNetConnectionEnd_Misc_InternalError;
 	}
+	AutoWipeFixedSizeBuffer<32> cryptKeySend;
+	AutoWipeFixedSizeBuffer<32> cryptKeyRecv;
+	eResult = DeriveSessionKeys( *m_pKeyExchangePrivateKeyLocal, m_msgCryptRemote, m_msgCryptLocal.nonce(),
+		m_sCertRemote, m_msgSignedCertLocal.cert(), m_sCryptRemote, m_msgSignedCryptLocal.info(),
+		m_unConnectionIDLocal, m_unConnectionIDRemote, bServer,
+		cryptKeySend, cryptKeyRecv, m_cryptIVSend, m_cryptIVRecv, &m_resumptionSecretNext, errMsg );
+	if ( eResult != k_ESteamNetConnectionEnd_Invalid )
+		return eResult;
+	m_bHasResumptionSecretNext = true;
+
+	// We won't need this again, so go ahead and discard it now.
+	m_pKeyExchangePrivateKeyLocal.reset();
+
+	return InstallCryptKeys( cryptKeySend, cryptKeyRecv, errMsg );
+}
 
+ESteamNetConnectionEnd CSteamNetworkConnectionBase::InstallCryptKeys( const AutoWipeFixedSizeBuffer<32> &cryptKeySend, const AutoWipeFixedSizeBuffer<32> &cryptKeyRecv, SteamNetworkingErrMsg &errMsg )
+{
 	// Set encryption keys into the contexts, and set parameters
 	switch ( m_eNegotiatedCipher )
 	{
@@ -1772,13 +2376,23 @@ ESteamNetConnectionEnd CSteamNetworkConnectionBase::FinishCryptoHandshake( bool
 			}
 		} break;
 
-	}
+		case k_ESteamNetworkingSocketsCipher_CHACHA20_POLY1305:
+		{
+			auto *pSend = new ChaCha20_Poly1305_EncryptContext;
+			auto *pRecv = new ChaCha20_Poly1305_DecryptContext;
+			m_pCryptContextSend.reset( pSend );
+			m_pCryptContextRecv.reset( pRecv );
 
-	//
-	// Tidy up key droppings
-	//
-	SecureZeroMemory( bufContext.Base(), bufContext.SizeAllocated() );
-	SecureZeroMemory( expandTemp, sizeof(expandTemp) );
+			if (
+				!pSend->Init( cryptKeySend.m_buf, cryptKeySend.k_nSize, m_cryptIVSend.k_nSize, k_cbChaCha20Poly1305TagSize )
+				|| !pRecv->Init( cryptKeyRecv.m_buf, cryptKeyRecv.k_nSize, m_cryptIVRecv.k_nSize, k_cbChaCha20Poly1305TagSize ) )
+			{
+				V_strcpy_safe( errMsg, "Error initializing crypto" );
+				return k_ESteamNetConnectionEnd_Remote_BadCrypt;
+			}
+		} break;
+
+	}
 
 	// This isn't sensitive info, but we don't need it any more, so go ahead and free up memory
 	m_sCertRemote.clear();
@@ -1793,6 +2407,402 @@ ESteamNetConnectionEnd CSteamNetworkConnectionBase::FinishCryptoHandshake( bool
 	return k_ESteamNetConnectionEnd_Invalid;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+//
+// Handshake crypto on worker threads
+//
+/////////////////////////////////////////////////////////////////////////////
+
+/// Expensive handshake crypto for a connection, done on a worker thread.
+/// The job works on its own copies of everything it needs, and DoWork()
+/// never touches the connection.  When the work is done, the job is handed
+/// back to the connection while holding the global lock, provided that the
+/// connection still exists and is still waiting on this job.
+class CConnectionCryptoJob
+{
+public:
+	virtual ~CConnectionCryptoJob() {}
+
+	/// Called on a worker thread, with no locks held
+	virtual void DoWork() = 0;
+
+	/// Called with the global lock and the connection lock held
+	virtual void Finish( CSteamNetworkConnectionBase *pConn ) = 0;
+
+	/// Called with the global lock held to arrange for DoWork() to be called
+	/// on a worker thread, and then FinishWithGlobalLock().
+	virtual void QueueWork();
+
+	/// Locate the connection, and if it's still waiting on us, call Finish()
+	void FinishWithGlobalLock()
+	{
+		ConnectionScopeLock connectionLock;
+		CSteamNetworkConnectionBase *pConn = GetConnectionByHandle( m_hConn, connectionLock );
+		if ( !pConn || pConn->m_nPendingCryptoJobID != m_nJobID )
+			return;
+		pConn->m_nPendingCryptoJobID = 0;
+		Finish( pConn );
+	}
+
+	HSteamNetConnection m_hConn = k_HSteamNetConnection_Invalid;
+	uint32 m_nJobID = 0;
+};
+
+class CCryptoJobFinishTask : public CQueuedTask
+{
+public:
+	explicit CCryptoJobFinishTask( CConnectionCryptoJob *pJob ) : m_pJob( pJob ) {}
+private:
+	std::unique_ptr<CConnectionCryptoJob> m_pJob;
+	virtual void Run() override { m_pJob->FinishWithGlobalLock(); }
+};
+
+class CCryptoJobWorkTask : public CQueuedTask
+{
+public:
+	explicit CCryptoJobWorkTask( CConnectionCryptoJob *pJob ) : m_pJob( pJob ) {}
+private:
+	std::unique_ptr<CConnectionCryptoJob> m_pJob;
+	virtual void Run() override
+	{
+		m_pJob->DoWork();
+		CCryptoJobFinishTask *pTask = new CCryptoJobFinishTask( m_pJob.release() );
+		pTask->QueueToRunWithGlobalLock( "CryptoJobFinish" );
+	}
+};
+
+void CConnectionCryptoJob::QueueWork()
+{
+	CCryptoJobWorkTask *pTask = new CCryptoJobWorkTask( this );
+	pTask->QueueToRunOnWorkerThread();
+}
+
+/// Check the signatures in a handshake received from a client.  Once that is
+/// done, the rest of RecvCryptoHandshake is cheap, and we let the app know about
+/// the connection.  See BConnectionState_ConnectingAndCheckCryptoHandshake
+class CCryptoJob_CheckHandshakeSignatures : public CConnectionCryptoJob
+{
+public:
+	CMsgSteamDatagramCertificateSigned m_msgCert;
+	CMsgSteamDatagramSessionCryptInfoSigned m_msgSessionInfo;
+	bool m_bHaveCAKey = false; // m_checks.m_keyCA was populated from the cert store
+	CryptoHandshakeSignatureChecks_t m_checks;
+
+	/// Max number of signatures we will ask to be checked.  See GatherSignatures
+	static constexpr int k_nMaxSignatures = 2;
+
+	/// Get ready to check the signatures, without doing any of the expensive
+	/// crypto.  Writes up to k_nMaxSignatures entries, and returns the number
+	/// written.  Once they have been checked, call ApplyResults()
+	int GatherSignatures( SignatureToVerify_t *pOut )
+	{
+		int n = 0;
+
+		// CA signature on the cert.  If something looks wrong, leave it unchecked,
+		// and the cert store will give a proper error message.
+		if ( m_bHaveCAKey && m_msgCert.ca_signature().length() == sizeof(CryptoSignature_t) && !m_msgCert.cert().empty() )
+		{
+			m_checks.m_bCASignatureChecked = true;
+			m_idxCASignature = n;
+			pOut[n].m_pData = m_msgCert.cert().c_str();
+			pOut[n].m_cbData = m_msgCert.cert().length();
+			pOut[n].m_pPublicKey = &m_checks.m_keyCA;
+			pOut[n].m_pSignature = (const CryptoSignature_t *)m_msgCert.ca_signature().c_str();
+			++n;
+		}
+
+		// Signature on the crypt info, using the key in the cert
+		CMsgSteamDatagramCertificate msgCert;
+		if ( !msgCert.ParseFromString( m_msgCert.cert() ) )
+		{
+			V_strcpy_safe( m_checks.m_errSessionSignature, "Cert failed protobuf decode" );
+			return n;
+		}
+		if ( !BPrepareSignatureCheck( msgCert.key_type(), msgCert.key_data(), m_msgSessionInfo.signature(), m_keyCert, m_checks.m_errSessionSignature ) )
+			return n;
+		m_idxSessionSignature = n;
+		pOut[n].m_pData = m_msgSessionInfo.info().c_str();
+		pOut[n].m_cbData = m_msgSessionInfo.info().length();
+		pOut[n].m_pPublicKey = &m_keyCert;
+		pOut[n].m_pSignature = (const CryptoSignature_t *)m_msgSessionInfo.signature().c_str();
+		++n;
+
+		return n;
+	}
+
+	/// Save off the results of checking the signatures from GatherSignatures()
+	void ApplyResults( const SignatureToVerify_t *pSignatures )
+	{
+		if ( m_idxCASignature >= 0 )
+			m_checks.m_bCASignatureValid = pSignatures[ m_idxCASignature ].m_bValid;
+		if ( m_idxSessionSignature >= 0 )
+		{
+			m_checks.m_bSessionSignatureValid = pSignatures[ m_idxSessionSignature ].m_bValid;
+			if ( !m_checks.m_bSessionSignatureValid )
+				V_strcpy_safe( m_checks.m_errSessionSignature, "Invalid signature" );
+		}
+	}
+
+	virtual void DoWork() override
+	{
+		SignatureToVerify_t sigs[ k_nMaxSignatures ];
+		int n = GatherSignatures( sigs );
+		CCrypto::VerifySignatureBatch( sigs, n );
+		ApplyResults( sigs );
+	}
+
+	virtual void QueueWork() override;
+
+	virtual void Finish( CSteamNetworkConnectionBase *pConn ) override
+	{
+		Assert( pConn->m_nSupressStateChangeCallbacks == 1 );
+
+		// Make sure nothing happened to the connection while we were working.
+		// E.g. timed out or peer gave up
+		SteamNetworkingErrMsg errMsg;
+		bool bOK = false;
+		if ( pConn->GetState() == k_ESteamNetworkingConnectionState_Connecting )
+		{
+			bOK = pConn->RecvCryptoHandshake( m_msgCert, m_msgSessionInfo, true, errMsg, &m_checks ) == k_ESteamNetConnectionEnd_Invalid;
+		}
+		else
+		{
+			V_sprintf_safe( errMsg, "Connection closed while checking crypto handshake.  %s", pConn->m_szEndDebug );
+		}
+
+		// OK?  Then we can let the app know about it
+		if ( bOK )
+		{
+			pConn->m_nSupressStateChangeCallbacks = 0;
+			pConn->PostConnectionStateChangedCallback( k_ESteamNetworkingConnectionState_None, k_ESteamNetworkingConnectionState_Connecting );
+			return;
+		}
+
+		// The app never knew about this connection, so we can just destroy it
+		SpewWarning( "[%s] Failed to accept connection.  %s\n", pConn->GetDescription(), errMsg );
+		pConn->ConnectionQueueDestroy();
+		pConn->m_nSupressStateChangeCallbacks = 0;
+	}
+
+private:
+	CECSigningPublicKey m_keyCert;
+	int m_idxCASignature = -1;
+	int m_idxSessionSignature = -1;
+};
+
+/// Check the signatures for a bunch of handshakes at once.  With a crypto
+/// backend that supports it, this is considerably cheaper than checking them
+/// individually.  See CCrypto::VerifySignatureBatch
+class CCryptoJobCheckSignaturesBatchTask : public CQueuedTask
+{
+public:
+	/// Max number of handshakes to process in one task.  Larger bursts are
+	/// spread over multiple tasks, so that they can use multiple workers
+	static constexpr int k_nMaxJobs = 32;
+
+	std::vector< std::unique_ptr<CCryptoJob_CheckHandshakeSignatures> > m_vecJobs;
+private:
+	virtual void Run() override
+	{
+		SignatureToVerify_t sigs[ k_nMaxJobs * CCryptoJob_CheckHandshakeSignatures::k_nMaxSignatures ];
+		int nSignatures = 0;
+		int idxFirstSignature[ k_nMaxJobs ];
+		Assert( len( m_vecJobs ) <= k_nMaxJobs );
+		for ( int i = 0 ; i < len( m_vecJobs ) ; ++i )
+		{
+			idxFirstSignature[i] = nSignatures;
+			nSignatures += m_vecJobs[i]->GatherSignatures( sigs + nSignatures );
+		}
+
+		CCrypto::VerifySignatureBatch( sigs, nSignatures );
+
+		for ( int i = 0 ; i < len( m_vecJobs ) ; ++i )
+		{
+			m_vecJobs[i]->ApplyResults( sigs + idxFirstSignature[i] );
+			CCryptoJobFinishTask *pTask = new CCryptoJobFinishTask( m_vecJobs[i].release() );
+			pTask->QueueToRunWithGlobalLock( "CryptoJobFinish" );
+		}
+	}
+};
+
+/// Collects up signature checks as connect requests arrive.  We don't hand
+/// them to the worker threads until the service thread gets around to running
+/// this task, which is after it has finished draining the sockets.  So a
+/// burst of connect requests will get checked together.  If there are no
+/// worker threads, the batches are checked right here on the service thread.
+class CCryptoJobCheckSignaturesCollectTask : public CQueuedTask
+{
+public:
+	static CCryptoJobCheckSignaturesCollectTask *s_pPending;
+
+	std::vector< std::unique_ptr<CCryptoJob_CheckHandshakeSignatures> > m_vecJobs;
+
+	virtual ~CCryptoJobCheckSignaturesCollectTask()
+	{
+		if ( s_pPending == this )
+			s_pPending = nullptr;
+	}
+private:
+	virtual void Run() override
+	{
+		Assert( s_pPending == this );
+		s_pPending = nullptr;
+
+		CCryptoJobCheckSignaturesBatchTask *pBatch = nullptr;
+		for ( std::unique_ptr<CCryptoJob_CheckHandshakeSignatures> &pJob: m_vecJobs )
+		{
+			if ( !pBatch )
+				pBatch = new CCryptoJobCheckSignaturesBatchTask;
+			pBatch->m_vecJobs.push_back( std::move( pJob ) );
+			if ( len( pBatch->m_vecJobs ) >= CCryptoJobCheckSignaturesBatchTask::k_nMaxJobs )
+			{
+				pBatch->QueueToRunOnWorkerThread();
+				pBatch = nullptr;
+			}
+		}
+		if ( pBatch )
+			pBatch->QueueToRunOnWorkerThread();
+		m_vecJobs.clear();
+	}
+};
+CCryptoJobCheckSignaturesCollectTask *CCryptoJobCheckSignaturesCollectTask::s_pPending;
+
+void CCryptoJob_CheckHandshakeSignatures::QueueWork()
+{
+	SteamNetworkingGlobalLock::AssertHeldByCurrentThread();
+	CCryptoJobCheckSignaturesCollectTask *pCollect = CCryptoJobCheckSignaturesCollectTask::s_pPending;
+	if ( !pCollect )
+	{
+		pCollect = new CCryptoJobCheckSignaturesCollectTask;
+		CCryptoJobCheckSignaturesCollectTask::s_pPending = pCollect;
+		pCollect->QueueToRunWithGlobalLock( "CryptoJobCollectSignatureChecks" );
+	}
+	pCollect->m_vecJobs.emplace_back( this );
+}
+
+/// Generate and sign our key exchange key, and derive the session keys.
+/// See APIAcceptConnection
+class CCryptoJob_AcceptConnection : public CConnectionCryptoJob
+{
+public:
+
+	// Inputs
+	CECSigningPrivateKey m_keyPrivate;
+	CMsgSteamDatagramSessionCryptInfo m_msgCryptLocal;
+	CMsgSteamDatagramSessionCryptInfo m_msgCryptRemote;
+	std::string m_sCertRemote;
+	std::string m_sCertLocal;
+	std::string m_sCryptRemote;
+	uint32 m_unConnectionIDLocal = 0;
+	uint32 m_unConnectionIDRemote = 0;
+
+	// Outputs
+	CMsgSteamDatagramSessionCryptInfoSigned m_msgSignedCryptLocal;
+	AutoWipeFixedSizeBuffer<32> m_cryptKeySend;
+	AutoWipeFixedSizeBuffer<32> m_cryptKeyRecv;
+	AutoWipeFixedSizeBuffer<12> m_cryptIVSend;
+	AutoWipeFixedSizeBuffer<12> m_cryptIVRecv;
+	AutoWipeFixedSizeBuffer<32> m_resumptionSecretNext;
+	ESteamNetConnectionEnd m_eResult = k_ESteamNetConnectionEnd_Invalid;
+	SteamNetworkingErrMsg m_errMsg;
+
+	virtual void DoWork() override
+	{
+		std::unique_ptr<CECKeyExchangePrivateKey> pKeyExchangePrivateKeyLocal;
+		GenerateSignedCryptInfo( m_keyPrivate, m_msgCryptLocal, pKeyExchangePrivateKeyLocal, m_msgSignedCryptLocal );
+		m_keyPrivate.Wipe();
+
+		m_eResult = DeriveSessionKeys( *pKeyExchangePrivateKeyLocal, m_msgCryptRemote, m_msgCryptLocal.nonce(),
+			m_sCertRemote, m_sCertLocal, m_sCryptRemote, m_msgSignedCryptLocal.info(),
+			m_unConnectionIDLocal, m_unConnectionIDRemote, true,
+			m_cryptKeySend, m_cryptKeyRecv, m_cryptIVSend, m_cryptIVRecv, &m_resumptionSecretNext, m_errMsg );
+	}
+
+	virtual void Finish( CSteamNetworkConnectionBase *pConn ) override
+	{
+		// App might have closed the connection while we were working
+		if ( pConn->GetState() != k_ESteamNetworkingConnectionState_Connecting )
+			return;
+
+		if ( m_eResult == k_ESteamNetConnectionEnd_Invalid )
+		{
+			pConn->m_msgCryptLocal = m_msgCryptLocal;
+			pConn->m_msgSignedCryptLocal = m_msgSignedCryptLocal;
+			V_memcpy( pConn->m_cryptIVSend.m_buf, m_cryptIVSend.m_buf, m_cryptIVSend.k_nSize );
+			V_memcpy( pConn->m_cryptIVRecv.m_buf, m_cryptIVRecv.m_buf, m_cryptIVRecv.k_nSize );
+			V_memcpy( pConn->m_resumptionSecretNext.m_buf, m_resumptionSecretNext.m_buf, m_resumptionSecretNext.k_nSize );
+			pConn->m_bHasResumptionSecretNext = true;
+			pConn->CheckScheduleDiagnosticsUpdateASAP();
+			m_eResult = pConn->InstallCryptKeys( m_cryptKeySend, m_cryptKeyRecv, m_errMsg );
+		}
+		if ( m_eResult != k_ESteamNetConnectionEnd_Invalid )
+		{
+			pConn->ConnectionState_ProblemDetectedLocally( m_eResult, "%s", m_errMsg );
+			return;
+		}
+
+		pConn->FinishAcceptConnection();
+	}
+};
+
+void CSteamNetworkConnectionBase::StartCryptoJob( CConnectionCryptoJob *pJob )
+{
+	SteamNetworkingGlobalLock::AssertHeldByCurrentThread();
+	Assert( m_nPendingCryptoJobID == 0 );
+
+	static uint32 s_nLastCryptoJobID;
+	do {
+		++s_nLastCryptoJobID;
+	} while ( s_nLastCryptoJobID == 0 );
+	m_nPendingCryptoJobID = s_nLastCryptoJobID;
+
+	pJob->m_hConn = m_hConnectionSelf;
+	pJob->m_nJobID = m_nPendingCryptoJobID;
+	pJob->QueueWork();
+}
+
+bool CSteamNetworkConnectionBase::BSupportsAsyncHandshakeCrypto() const
+{
+	return false;
+}
+
+bool CSteamNetworkConnectionBase::BConnectionState_ConnectingAndCheckCryptoHandshake(
+	const CMsgSteamDatagramCertificateSigned &msgCert,
+	const CMsgSteamDatagramSessionCryptInfoSigned &msgSessionInfo,
+	SteamNetworkingMicroseconds usecNow,
+	SteamNetworkingErrMsg &errMsg )
+{
+	Assert( m_bConnectionInitiatedRemotely );
+	Assert( BCanBatchHandshakeSignatureChecks() );
+	Assert( m_nSupressStateChangeCallbacks == 0 );
+
+	// Don't bother queuing obvious garbage
+	if ( !msgCert.has_cert() || !msgSessionInfo.has_info() )
+	{
+		V_strcpy_safe( errMsg, "Crypto handshake missing cert or session data" );
+		return false;
+	}
+
+	// The app doesn't get to hear about this connection until we have
+	// processed the handshake.
+	m_nSupressStateChangeCallbacks = 1;
+	if ( !BConnectionState_Connecting( usecNow, errMsg ) )
+	{
+		m_nSupressStateChangeCallbacks = 0;
+		return false;
+	}
+
+	// Queue the signatures to be checked.  The cert store can only be used
+	// while holding the global lock, so grab a copy of the CA key now.
+	CCryptoJob_CheckHandshakeSignatures *pJob = new CCryptoJob_CheckHandshakeSignatures;
+	pJob->m_msgCert = msgCert;
+	pJob->m_msgSessionInfo = msgSessionInfo;
+	if ( msgCert.has_ca_signature() )
+		pJob->m_bHaveCAKey = CertStore_GetCAPublicKey( msgCert.ca_key_id(), pJob->m_checks.m_keyCA );
+	StartCryptoJob( pJob );
+	return true;
+}
+
 EUnsignedCert CSteamNetworkConnectionBase::AllowLocalUnsignedCert()
 {
 	// Base class - we will not attempt connections without a local cert,
@@ -1976,6 +2986,33 @@ EResult CSteamNetworkConnectionBase::APIGetRealTimeStatus( SteamNetConnectionRea
 	return k_EResultOK;
 }
 
+void CSteamNetworkConnectionBase::APIGetSNPStatus( SteamNetConnectionSNPStatus_t &status )
+{
+	m_pLock->AssertHeldByCurrentThread();
+	SteamNetworkingMicroseconds usecNow = SteamNetworkingSockets_GetLocalTimestamp();
+
+	status.m_eState = CollapseConnectionStateToAPIState( m_eConnectionState );
+	status.m_nSmoothedPingMS = m_statsEndToEnd.m_ping.m_nSmoothedPing;
+	status.m_nPingMeanDevMS = m_statsEndToEnd.m_ping.m_nValidPings > 0 ? (int)( m_statsEndToEnd.m_ping.m_flPingMeanDevMS + .5f ) : -1;
+	SNP_PopulateSNPStatus( status, usecNow );
+}
+
+int CSteamNetworkConnectionBase::APIReceiveDeliveryReceipts( SteamNetworkingDeliveryReceipt_t *pOutReceipts, int nMaxReceipts )
+{
+	m_pLock->AssertHeldByCurrentThread();
+	if ( nMaxReceipts <= 0 || !pOutReceipts )
+		return 0;
+
+	std_vector<SteamNetworkingDeliveryReceipt_t> &vecReceipts = m_senderState.m_vecDeliveryReceipts;
+	int nResult = std::min( nMaxReceipts, len( vecReceipts ) );
+	if ( nResult > 0 )
+	{
+		memcpy( pOutReceipts, vecReceipts.data(), nResult * sizeof(SteamNetworkingDeliveryReceipt_t) );
+		vecReceipts.erase( vecReceipts.begin(), vecReceipts.begin() + nResult );
+	}
+	return nResult;
+}
+
 void CSteamNetworkConnectionBase::APIGetDetailedConnectionStatus( SteamNetworkingDetailedConnectionStatus &stats, SteamNetworkingMicroseconds usecNow )
 {
 	// Connection must be locked, but we don't require the global lock here!
@@ -1984,6 +3021,25 @@ void CSteamNetworkConnectionBase::APIGetDetailedConnectionStatus( SteamNetworkin
 	stats.Clear();
 	ConnectionPopulateInfo( stats.m_info );
 
+	switch ( m_eNegotiatedCipher )
+	{
+		default:
+		case k_ESteamNetworkingSocketsCipher_INVALID:
+			break;
+
+		case k_ESteamNetworkingSocketsCipher_NULL:
+			V_strcpy_safe( stats.m_szCipher, "NULL" );
+			break;
+
+		case k_ESteamNetworkingSocketsCipher_AES_256_GCM:
+			V_strcpy_safe( stats.m_szCipher, "AES-256-GCM" );
+			break;
+
+		case k_ESteamNetworkingSocketsCipher_CHACHA20_POLY1305:
+			V_strcpy_safe( stats.m_szCipher, "ChaCha20-Poly1305" );
+			break;
+	}
+
 	// Copy end-to-end stats
 	m_statsEndToEnd.GetLinkStats( stats.m_statsEndToEnd, usecNow );
 
@@ -2158,7 +3214,7 @@ int CSteamNetworkConnectionBase::APIReceiveMessages( SteamNetworkingMessage_t **
 	return result;
 }
 
-bool CSteamNetworkConnectionBase::DecryptDataChunk( uint16 nWireSeqNum, int cbPacketSize, const void *pChunk, int cbChunk, RecvPacketContext_t &ctx )
+bool CSteamNetworkConnectionBase::DecryptDataChunk( uint16 nWireSeqNum, int cbPacketSize, void *pChunk, int cbChunk, RecvPacketContext_t &ctx )
 {
 	AssertLocksHeldByCurrentThread();
 
@@ -2174,6 +3230,8 @@ bool CSteamNetworkConnectionBase::DecryptDataChunk( uint16 nWireSeqNum, int cbPa
 	// fixed now
 	AssertMsg1( m_statsEndToEnd.m_nMaxRecvPktNum > 0 || m_statsEndToEnd.m_nPeerProtocolVersion < 10, "[%s] packet number not properly initialized!", GetDescription() );
 
+	ctx.m_cbPacketSize = cbPacketSize;
+
 	// Get the full end-to-end packet number, check if we should process it
 	ctx.m_nPktNum = m_statsEndToEnd.ExpandWirePacketNumberAndCheck( nWireSeqNum, ctx.m_idxMultiPath );
 	if ( ctx.m_nPktNum <= 0 )
@@ -2207,14 +3265,22 @@ bool CSteamNetworkConnectionBase::DecryptDataChunk( uint16 nWireSeqNum, int cbPa
 		//	*((byte*)pChunk + 0), *((byte*)pChunk + 1), *((byte*)pChunk + 2), *((byte*)pChunk + 3)
 		//);
 
-		// Decrypt the chunk and check the auth tag
-		uint32 cbDecrypted = sizeof(ctx.m_decrypted);
+		// Decrypt the chunk in place and check the auth tag
+		uint32 cbDecrypted = (uint32)cbChunk;
+		const bool bPerfMetrics = BPerfMetricsEnabled();
+		SteamNetworkingMicroseconds usecDecryptStart = unlikely( bPerfMetrics ) ? SteamNetworkingSockets_GetLocalTimestamp() : 0;
 		bool bDecryptOK = m_pCryptContextRecv->Decrypt(
 			pChunk, cbChunk, // encrypted
 			m_cryptIVRecv.m_buf, // IV
-			ctx.m_decrypted, &cbDecrypted, // output
+			pChunk, &cbDecrypted, // output
 			nullptr, 0 // no AAD
 		);
+		if ( unlikely( bPerfMetrics ) )
+		{
+			PerfHistogramRecord( k_EPerfHistogram_DecryptUsec, SteamNetworkingSockets_GetLocalTimestamp() - usecDecryptStart );
+			if ( !bDecryptOK )
+				PerfCounterAdd( k_EPerfCounter_DecryptFailures, 1 );
+		}
 
 		// Restore the IV to the base value
 		*(uint64 *)&m_cryptIVRecv.m_buf -= LittleQWord( ctx.m_nPktNum );
@@ -2235,7 +3301,7 @@ bool CSteamNetworkConnectionBase::DecryptDataChunk( uint16 nWireSeqNum, int cbPa
 		}
 
 		ctx.m_cbPlainText = (int)cbDecrypted;
-		ctx.m_pPlainText = ctx.m_decrypted;
+		ctx.m_pPlainText = pChunk;
 
 		//SpewVerbose( "Connection %u recv seqnum %lld (gap=%d) sz=%d %02x %02x %02x %02x\n", m_unConnectionID, unFullSequenceNumber, nGap, cbDecrypted, arDecryptedChunk[0], arDecryptedChunk[1], arDecryptedChunk[2], arDecryptedChunk[3] );
 	}
@@ -2300,16 +3366,61 @@ EResult CSteamNetworkConnectionBase::APIAcceptConnection()
 		return k_EResultInvalidParam;
 	}
 
+	// Already accepted, and we're waiting on the crypto?
+	if ( m_nPendingCryptoJobID )
+	{
+		SpewWarning( "[%s] Cannot accept connection; already accepted, and finishing crypto handshake.", GetDescription() );
+		return k_EResultInvalidState;
+	}
+
 	// Select the cipher.  We needed to wait until now to do it, because the app
 	// might have set connection options on a new connection.
 	Assert( m_eNegotiatedCipher == k_ESteamNetworkingSocketsCipher_INVALID );
-	ESteamNetConnectionEnd eCryptoHandshakeErr = FinishCryptoHandshake( true, errMsg );
+	ESteamNetConnectionEnd eCryptoHandshakeErr;
+	if ( BCanOffloadHandshakeCrypto() )
+	{
+		// Pick the cipher now, since it depends on connection options.  Then do the
+		// expensive part on a worker thread, and finish accepting the connection
+		// when that's done.  We'll stay in the connecting state until then.
+		eCryptoHandshakeErr = NegotiateCipher( errMsg );
+		if ( eCryptoHandshakeErr == k_ESteamNetConnectionEnd_Invalid )
+		{
+			Assert( !m_msgSignedCryptLocal.has_info() );
+			Assert( m_keyPrivate.IsValid() );
+			m_msgCryptLocal.set_protocol_version( k_nCurrentProtocolVersion );
+
+			CCryptoJob_AcceptConnection *pJob = new CCryptoJob_AcceptConnection;
+			pJob->m_keyPrivate.CopyFrom( m_keyPrivate );
+			pJob->m_msgCryptLocal = m_msgCryptLocal;
+			pJob->m_msgCryptRemote = m_msgCryptRemote;
+			pJob->m_sCertRemote = m_sCertRemote;
+			pJob->m_sCertLocal = m_msgSignedCertLocal.cert();
+			pJob->m_sCryptRemote = m_sCryptRemote;
+			pJob->m_unConnectionIDLocal = m_unConnectionIDLocal;
+			pJob->m_unConnectionIDRemote = m_unConnectionIDRemote;
+
+			// We won't need our copy of the private key again
+			m_keyPrivate.Wipe();
+
+			StartCryptoJob( pJob );
+			return k_EResultOK;
+		}
+	}
+	else
+	{
+		eCryptoHandshakeErr = FinishCryptoHandshake( true, errMsg );
+	}
 	if ( eCryptoHandshakeErr )
 	{
 		ConnectionState_ProblemDetectedLocally( eCryptoHandshakeErr, "%s", errMsg );
 		return k_EResultHandshakeFailed;
 	}
 
+	return FinishAcceptConnection();
+}
+
+EResult CSteamNetworkConnectionBase::FinishAcceptConnection()
+{
 	SteamNetworkingMicroseconds usecNow = SteamNetworkingSockets_GetLocalTimestamp();
 
 	// Derived class knows what to do next
@@ -2529,6 +3640,9 @@ void CSteamNetworkConnectionBase::SetState( ESteamNetworkingConnectionState eNew
 		m_connectionConfig.IP_AllowWithoutAuth.Lock();
 		m_connectionConfig.IPLocalHost_AllowWithoutAuth.Lock();
 		m_connectionConfig.Unencrypted.Lock();
+		m_connectionConfig.CipherPreference.Lock();
+		m_connectionConfig.CompressionLanes.Lock();
+		m_connectionConfig.CompressionDictionary.Lock();
 		m_connectionConfig.SymmetricConnect.Lock();
 		#ifdef STEAMNETWORKINGSOCKETS_ENABLE_SDR
 			m_connectionConfig.SDRClient_DevTicket.Lock();
@@ -3394,8 +4508,10 @@ void CSteamNetworkConnectionBase::Think( SteamNetworkingMicroseconds usecNow )
 
 	// Safety check against leaving callbacks suppressed.  If this fires, there's a good chance
 	// we have already suppressed a callback that we should have posted, which is very bad
-	AssertMsg( m_nSupressStateChangeCallbacks == 0, "[%s] m_nSupressStateChangeCallbacks left on!", GetDescription() );
-	m_nSupressStateChangeCallbacks = 0;
+	// (Unless we're waiting on a crypto job that will turn them back on.)
+	AssertMsg( m_nSupressStateChangeCallbacks == 0 || m_nPendingCryptoJobID != 0, "[%s] m_nSupressStateChangeCallbacks left on!", GetDescription() );
+	if ( m_nPendingCryptoJobID == 0 )
+		m_nSupressStateChangeCallbacks = 0;
 
 	// Assume a default think interval just to make sure we check in periodically
 	SteamNetworkingMicroseconds usecMinNextThinkTime = usecNow + k_nMillion;
@@ -72,6 +72,25 @@ public:
 	inline ~AutoWipeFixedSizeBuffer() { Wipe(); }
 };
 
+/// Results of checking the signatures in the peer's crypto handshake ahead
+/// of time, without the global lock held.  (E.g. on a worker thread.)  The
+/// chain of trust still needs to be checked while holding the lock, but the
+/// crypto doesn't need to be done again.
+struct CryptoHandshakeSignatureChecks_t
+{
+	/// CA signature on the cert.  If it was checked and is valid, this is
+	/// the key we used.  See CertStore_GetCAPublicKey
+	bool m_bCASignatureChecked = false;
+	bool m_bCASignatureValid = false;
+	CECSigningPublicKey m_keyCA;
+
+	/// Signature on the session crypt info, made with the key in the cert
+	bool m_bSessionSignatureValid = false;
+	SteamNetworkingErrMsg m_errSessionSignature;
+};
+
+class CConnectionCryptoJob;
+
 /// In various places, we need a key in a map of remote connections.
 struct RemoteConnectionKey_t
 {
@@ -127,16 +146,16 @@ struct RecvPacketContext_t
 	/// Expanded packet number
 	int64 m_nPktNum;
 
-	/// Pointer to decrypted data.  Will either point to to the caller's original packet,
-	/// if the packet was not encrypted, or m_decrypted, if it was encrypted and we
-	/// decrypted it
+	/// Size of the whole packet as it arrived on the wire, including
+	/// transport headers and the encryption auth tag
+	int m_cbPacketSize;
+
+	/// Pointer to decrypted data.  This always points into the caller's original
+	/// packet.  If the packet was encrypted, it was decrypted in place.
 	const void *m_pPlainText;
 
 	/// Size of plaintext
 	int m_cbPlainText;
-
-	// Temporary buffer to hold decrypted data, if we were actually encrypted
-	uint8 m_decrypted[ k_cbSteamNetworkingSocketsMaxPlaintextPayloadRecv ];
 };
 
 template<typename TStatsMsg>
@@ -382,11 +401,18 @@ public:
 	/// to the client, and calling ConnectionState_Connected on the connection
 	/// to transition it to the connected state.
 	EResult APIAcceptConnection();
+	EResult FinishAcceptConnection();
 	virtual EResult AcceptConnection( SteamNetworkingMicroseconds usecNow );
 
 	/// Fill in realtime connection stats
 	EResult APIGetRealTimeStatus( SteamNetConnectionRealTimeStatus_t *pStatus, int nLanes, SteamNetConnectionRealTimeLaneStatus_t *pLanes );
 
+	/// Fill in SNP internals.  Caller fills in the handle and result
+	void APIGetSNPStatus( SteamNetConnectionSNPStatus_t &status );
+
+	/// Dequeue delivery receipts for unreliable messages
+	int APIReceiveDeliveryReceipts( SteamNetworkingDeliveryReceipt_t *pOutReceipts, int nMaxReceipts );
+
 	/// Fill in detailed connection stats
 	virtual void APIGetDetailedConnectionStatus( SteamNetworkingDetailedConnectionStatus &stats, SteamNetworkingMicroseconds usecNow );
 
@@ -563,7 +589,7 @@ public:
 	/// Expand the packet number, and decrypt the data chunk.
 	/// Returns true if everything is OK and we should continue
 	/// processing the packet
-	bool DecryptDataChunk( uint16 nWireSeqNum, int cbPacketSize, const void *pChunk, int cbChunk, RecvPacketContext_t &ctx );
+	bool DecryptDataChunk( uint16 nWireSeqNum, int cbPacketSize, void *pChunk, int cbChunk, RecvPacketContext_t &ctx );
 
 	/// Decode the plaintext.  Returns false if the packet seems corrupt or bogus, or should abort further
 	/// processing.
@@ -637,6 +663,28 @@ public:
 	inline const CMsgSteamDatagramCertificateSigned &GetSignedCertLocal() { return m_msgSignedCertLocal; }
 	inline bool BCertHasIdentity() const { return m_bCertHasIdentity; }
 	inline bool BCryptKeysValid() const { return m_bCryptKeysValid; }
+	inline bool BRemoteCertHasTrustedCASignature() const { return m_bRemoteCertHasTrustedCASignature; }
+
+	/// Session resumption.  If we are resuming an earlier session, the secret
+	/// from that session takes the place of the certs and key exchange.  Call
+	/// this before the crypto handshake.  (On the client, it's OK to clear it
+	/// again if the server wants to do the full handshake.)
+	void SetResumedSessionSecret( const AutoWipeFixedSizeBuffer<32> &secret );
+	void ClearResumedSessionSecret();
+	inline bool BResumedSession() const { return m_pResumedSecret != nullptr; }
+
+	/// HMAC of our crypt info, keyed with the secret of the session we are
+	/// resuming.  This takes the place of the signature by our cert.
+	std::string GetResumptionMACLocal() const;
+
+	/// Process the peer's crypt info in a resumed session.  The MAC must match.
+	/// bRemoteTrusted is whether their cert had a trusted CA signature in the
+	/// original session.  On the client, this finishes the handshake.
+	ESteamNetConnectionEnd RecvResumedCryptoHandshake( const CMsgSteamDatagramSessionCryptInfoSigned &msgSessionInfo, const std::string &sMAC, bool bRemoteTrusted, bool bServer, SteamNetworkingErrMsg &errMsg );
+
+	/// Secret derived from this session's keys, that can be used to resume it
+	/// later.  NULL if the handshake isn't finished.
+	inline const AutoWipeFixedSizeBuffer<32> *GetResumptionSecretNext() const { return m_bHasResumptionSecretNext ? &m_resumptionSecretNext : nullptr; }
 
 	/// Called when we send an end-to-end connect request
 	void SentEndToEndConnectRequest( SteamNetworkingMicroseconds usecNow )
@@ -654,9 +702,33 @@ public:
 	virtual bool BSupportsSymmetricMode();
 
 	// Check the certs, save keys, etc
-	ESteamNetConnectionEnd RecvCryptoHandshake( const CMsgSteamDatagramCertificateSigned &msgCert, const CMsgSteamDatagramSessionCryptInfoSigned &msgSessionInfo, bool bServer, SteamNetworkingErrMsg &errMsg );
+	ESteamNetConnectionEnd RecvCryptoHandshake( const CMsgSteamDatagramCertificateSigned &msgCert, const CMsgSteamDatagramSessionCryptInfoSigned &msgSessionInfo, bool bServer, SteamNetworkingErrMsg &errMsg, const CryptoHandshakeSignatureChecks_t *pPrecheckedSignatures = nullptr );
 	ESteamNetConnectionEnd FinishCryptoHandshake( bool bServer, SteamNetworkingErrMsg &errMsg );
 
+	/// Enter the connecting state for a connection received on a listen socket,
+	/// while the signatures in the peer's crypto handshake are checked.  The
+	/// checks are batched with any other handshakes received in the same burst,
+	/// and done on a worker thread if we have any.  The app is not told about the
+	/// connection until the handshake has been processed.  If it fails, the
+	/// connection is quietly destroyed.  Use this instead of
+	/// RecvCryptoHandshake+BConnectionState_Connecting, only when
+	/// BCanBatchHandshakeSignatureChecks() returns true.
+	bool BConnectionState_ConnectingAndCheckCryptoHandshake( const CMsgSteamDatagramCertificateSigned &msgCert, const CMsgSteamDatagramSessionCryptInfoSigned &msgSessionInfo, SteamNetworkingMicroseconds usecNow, SteamNetworkingErrMsg &errMsg );
+
+	/// Return true if expensive handshake crypto for this connection should be
+	/// done on a worker thread.  Derived classes opt in by overriding
+	/// BSupportsAsyncHandshakeCrypto.  (A resumed session has no expensive crypto.)
+	bool BCanOffloadHandshakeCrypto() const { return BSupportsAsyncHandshakeCrypto() && BWorkerThreadsEnabled() && !BResumedSession(); }
+
+	/// Return true if the signature checks for an incoming handshake should be
+	/// deferred and batched.  See BConnectionState_ConnectingAndCheckCryptoHandshake.
+	/// This is only worth it if we have a real batch check, or worker threads to
+	/// do the checks on.  Otherwise it just delays the connection.
+	bool BCanBatchHandshakeSignatureChecks() const
+	{
+		return BSupportsAsyncHandshakeCrypto() && ( CCrypto::k_bHasFastSignatureBatchVerify || BWorkerThreadsEnabled() ) && !BResumedSession();
+	}
+
 	// Process crypto handshake, and terminate the connection if it fails
 	bool BRecvCryptoHandshake( const CMsgSteamDatagramCertificateSigned &msgCert, const CMsgSteamDatagramSessionCryptInfoSigned &msgSessionInfo, bool bServer );
 
@@ -724,6 +796,7 @@ public:
 
 	/// Setup lanes
 	EResult SNP_ConfigureLanes( int nLanes, const int *pLanePriorities, const uint16 *pLaneWeights );
+	EResult SNP_ConfigureLaneDeadlines( int nLanes, const int *pLaneLatencyTargetsMS, SteamNetworkingMicroseconds usecNow );
 
 protected:
 	CSteamNetworkConnectionBase( CSteamNetworkingSockets *pSteamNetworkingSocketsInterface, ConnectionScopeLock &scopeLock );
@@ -791,6 +864,23 @@ protected:
 	void ClearLocalCrypto();
 	void FinalizeLocalCrypto();
 	void SetCryptoCipherList();
+	void SetCryptoCompressionInfo();
+	ESteamNetConnectionEnd NegotiateCipher( SteamNetworkingErrMsg &errMsg );
+	void NegotiateCompression();
+	ESteamNetConnectionEnd RecvCryptInfoRemote( bool bServer, SteamNetworkingErrMsg &errMsg );
+	ESteamNetConnectionEnd InstallCryptKeys( const AutoWipeFixedSizeBuffer<32> &cryptKeySend, const AutoWipeFixedSizeBuffer<32> &cryptKeyRecv, SteamNetworkingErrMsg &errMsg );
+
+	/// Return true if the connection type is prepared for handshake crypto
+	/// to finish asynchronously.  (See CConnectionCryptoJob.)  Default is false
+	virtual bool BSupportsAsyncHandshakeCrypto() const;
+
+	/// Handshake crypto in progress on a worker thread.  Nonzero while a job
+	/// is outstanding.  The job checks that this matches before touching us.
+	friend class CConnectionCryptoJob;
+	friend class CCryptoJob_AcceptConnection;
+	friend class CCryptoJob_CheckHandshakeSignatures;
+	uint32 m_nPendingCryptoJobID;
+	void StartCryptoJob( CConnectionCryptoJob *pJob );
 
 	// Remote cert and crypt info.  We need to hand on to the original serialized version briefly
 	std::string m_sCertRemote;
@@ -799,15 +889,32 @@ protected:
 	CMsgSteamDatagramSessionCryptInfo m_msgCryptRemote;
 	bool m_bRemoteCertHasTrustedCASignature; // Could expand this to an enum of different states
 
+	// Session resumption.  If this session resumes an earlier one, this is the
+	// secret from that session.  Also, the secret that can be used to resume
+	// this session later, once we have derived the keys.
+	std::unique_ptr< AutoWipeFixedSizeBuffer<32> > m_pResumedSecret;
+	AutoWipeFixedSizeBuffer<32> m_resumptionSecretNext;
+	bool m_bHasResumptionSecretNext;
+
 	// Local crypto info for this connection
 	CECSigningPrivateKey m_keyPrivate; // Private key corresponding to our cert.  We'll wipe this in FinalizeLocalCrypto, as soon as we've locked in the crypto properties we're going to use
-	CECKeyExchangePrivateKey m_keyExchangePrivateKeyLocal;
+	std::unique_ptr<CECKeyExchangePrivateKey> m_pKeyExchangePrivateKeyLocal; // Usually from the pool, see TakeKeyExchangeKey
 	CMsgSteamDatagramSessionCryptInfo m_msgCryptLocal;
 	CMsgSteamDatagramSessionCryptInfoSigned m_msgSignedCryptLocal;
 	CMsgSteamDatagramCertificateSigned m_msgSignedCertLocal;
 	bool m_bCertHasIdentity; // Does the cert contain the identity we will use for this connection?
 	ESteamNetworkingSocketsCipher m_eNegotiatedCipher;
 
+	// Message compression, agreed during the handshake.  Bitmasks of
+	// lanes that are compressed in each direction, and the dictionary used
+	// for each direction (NULL if none).  Until then, the dictionaries we
+	// told the peer we have.
+	uint32 m_nCompressLanesSend;
+	uint32 m_nCompressLanesRecv;
+	std::shared_ptr<const CompressionDictionary_t> m_pCompressDictSend;
+	std::shared_ptr<const CompressionDictionary_t> m_pCompressDictRecv;
+	std::vector< std::shared_ptr<const CompressionDictionary_t> > m_vecCompressDictsOffered;
+
 	// Encryption/decryption contexts.  This has the negotiated key
 	bool m_bCryptKeysValid;
 	std::unique_ptr<ISymmetricEncryptContext> m_pCryptContextSend;
@@ -834,6 +941,11 @@ protected:
 	/// Called to decide if we want to try to proceed without a signed cert for ourselves
 	virtual EUnsignedCert AllowLocalUnsignedCert();
 
+	/// Return false if neither side will act as the server and pick a cipher from the
+	/// other's list.  (E.g. both ends of a loopback pair just exchange their crypt info.)
+	/// In that case we offer only a single encrypted cipher.
+	virtual bool BCanNegotiateCipher() const { return true; }
+
 	//
 	// "SNP" - Steam Networking Protocol.  (Sort of audacious to stake out this acronym, don't you think...?)
 	//         The layer that does end-to-end reliability and bandwidth estimation
@@ -848,17 +960,32 @@ protected:
 	void SNP_PrepareFeedback( SteamNetworkingMicroseconds usecNow );
 	bool SNP_ReceiveUnreliableSegment( int64 nMsgNum, int nOffset, const void *pSegmentData, int cbSegmentSize, bool bLastSegmentInMessage, int idxLane, SteamNetworkingMicroseconds usecNow );
 	bool SNP_ReceiveReliableSegment( int64 nPktNum, int64 nSegBegin, const uint8 *pSegmentData, int cbSegmentSize, int idxLane, SteamNetworkingMicroseconds usecNow );
+	void SNP_ReceiveFECParity( int idxLane, int nMessages, const int64 *arMsgNum, const int *arMsgSize, const uint8 *pParity, int cbParity, SteamNetworkingMicroseconds usecNow );
+
+	/// Compress a message we are about to queue, if it's on a lane where
+	/// we have agreed to do that.  Returns the new size
+	int SNP_CompressMessage( CSteamNetworkingMessage *pSendMessage, SSNPSenderState::Lane &lane );
+	void SNP_CompressQueuedMessages();
+
+	/// Deliver a message we received, decompressing it if necessary.
+	/// Returns false if the connection should be dropped.
+	bool SNP_ReceivedMessageData( const void *pData, int cbData, int idxLane, int64 nMsgNum, int nFlags, SteamNetworkingMicroseconds usecNow );
 	int SNP_ClampSendRate();
 	void SNP_PopulateDetailedStats( SteamDatagramLinkStats &info );
 	void SNP_PopulateRealTimeStatus( SteamNetConnectionRealTimeStatus_t *pStatus, int nLanes, SteamNetConnectionRealTimeLaneStatus_t *pLanes, SteamNetworkingMicroseconds usecNow );
+	void SNP_PopulateSNPStatus( SteamNetConnectionSNPStatus_t &status, SteamNetworkingMicroseconds usecNow );
+
+	/// Charge the time since the last call to whether we were app limited or
+	/// rate limited, and then figure out which state we are in now.
+	void SNP_UpdateSendLimitState( SteamNetworkingMicroseconds usecNow );
 	void SNP_RecordReceivedPktNum( int64 nPktNum, SteamNetworkingMicroseconds usecNow, bool bScheduleAck );
 	EResult SNP_FlushMessage( SteamNetworkingMicroseconds usecNow );
 
 	/// Accumulate "tokens" into our bucket base on the current calculated send rate
 	void SNP_TokenBucket_Accumulate( SteamNetworkingMicroseconds usecNow );
 
-	/// Mark a packet as dropped
-	void SNP_SenderProcessPacketNack( int64 nPktNum, SNPInFlightPacket_t &pkt, const char *pszDebug );
+	/// Mark a packet as dropped.  Returns false if it was already marked
+	bool SNP_SenderProcessPacketNack( int64 nPktNum, SNPInFlightPacket_t &pkt, const char *pszDebug );
 
 	/// Check in flight packets.  Expire any that need to be, and return the time when the
 	/// next one that is not yet expired will be expired.
@@ -889,10 +1016,20 @@ private:
 	template<bool k_bUnreliableOnly>
 	uint8 *SNP_SerializeSegmentArray( uint8 *pPayloadPtr, SNPPacketSerializeHelper &helper, SNPEncodedSegment *pSegBegin, SNPEncodedSegment *pSegEnd, bool bLastLane );
 
-	uint8 *SNP_SerializeAckBlocks( const SNPPacketSerializeHelper &helper, uint8 *pOut, const uint8 *pOutEnd );
+	uint8 *SNP_SerializeAckBlocks( SNPPacketSerializeHelper &helper, uint8 *pOut, const uint8 *pOutEnd );
 	uint8 *SNP_SerializeStopWaitingFrame( SNPPacketSerializeHelper &helper, uint8 *pOut );
+	uint8 *SNP_SerializeAckFrequencyFrame( SNPPacketSerializeHelper &helper, uint8 *pOut );
+	uint8 *SNP_SerializeFECParityFrames( uint8 *pOut, int &cbRemaining );
+	void SNP_FECAddMessage( int idxLane, const CSteamNetworkingMessage *pMsg );
 	void SNP_QueueReliableSegmentsForRetry( SNPInFlightPacket_t &pkt, int64 nPktNumForDebug, const char *pszDebug );
 
+	#ifdef STEAMNETWORKINGSOCKETS_ENABLE_SNPTRACE
+		/// Write a record to the binary packet trace.  Only call this if g_pSNPTraceHeader is set
+		void SNP_TracePacket( ESNPTraceDirection eDirection, int64 nPktNum, int cbWire, int cbPlainText,
+			int nReliableSegments, int nUnreliableSegments, int nAckBlocks, int64 nAckLatestPktNum, uint8 nFlags,
+			SteamNetworkingMicroseconds usecNow );
+	#endif
+
 	void SetState( ESteamNetworkingConnectionState eNewState, SteamNetworkingMicroseconds usecNow );
 	ESteamNetworkingConnectionState m_eConnectionState;
 
@@ -1142,7 +1279,19 @@ extern TableLock g_tables_lock;
 // This table is protected by the global lock
 extern CUtlHashMap<int, CSteamNetworkListenSocketBase *, std::equal_to<int>, Identity<int> > g_mapListenSockets;
 
+// Compression dictionaries registered by the app, sorted by ID.  Protected by the global lock
+extern std::vector< std::shared_ptr<const CompressionDictionary_t> > g_vecCompressionDictionaries;
+
 extern bool BCheckGlobalSpamReplyRateLimit( SteamNetworkingMicroseconds usecNow );
+
+/// Start using the pool of pre-generated key exchange keys, and make sure it is
+/// being filled.  Until this is called, keys are generated when they are needed.
+/// See k_ESteamNetworkingConfig_KeyExchangeKeyPoolSize
+extern void PrimeKeyExchangeKeyPool();
+
+/// Wipe and discard any keys in the pool.  Called at shutdown, once the
+/// task that fills the pool can no longer run.
+extern void FreeKeyExchangeKeyPool();
 extern CSteamNetworkConnectionBase *GetConnectionByHandle( HSteamNetConnection sock, ConnectionScopeLock &scopeLock );
 extern CSteamNetworkPollGroup *GetPollGroupByHandle( HSteamNetPollGroup hPollGroup, PollGroupScopeLock &scopeLock, const char *pszLockTag );
 
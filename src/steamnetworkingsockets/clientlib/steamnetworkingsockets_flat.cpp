@@ -89,6 +89,14 @@ STEAMNETWORKINGSOCKETS_INTERFACE int SteamAPI_ISteamNetworkingSockets_GetDetaile
 {
 	return self->GetDetailedConnectionStatus( hConn,pszBuf,cbBuf );
 }
+STEAMNETWORKINGSOCKETS_INTERFACE int SteamAPI_ISteamNetworkingSockets_GetConnectionSNPStatus( ISteamNetworkingSockets* self, const HSteamNetConnection * pConnections, int nConnections, SteamNetConnectionSNPStatus_t * pOutStatus )
+{
+	return self->GetConnectionSNPStatus( pConnections,nConnections,pOutStatus );
+}
+STEAMNETWORKINGSOCKETS_INTERFACE int SteamAPI_ISteamNetworkingSockets_ReceiveDeliveryReceiptsOnConnection( ISteamNetworkingSockets* self, HSteamNetConnection hConn, SteamNetworkingDeliveryReceipt_t * pOutReceipts, int nMaxReceipts )
+{
+	return self->ReceiveDeliveryReceiptsOnConnection( hConn,pOutReceipts,nMaxReceipts );
+}
 STEAMNETWORKINGSOCKETS_INTERFACE bool SteamAPI_ISteamNetworkingSockets_GetListenSocketAddress( ISteamNetworkingSockets* self, HSteamListenSocket hSocket, SteamNetworkingIPAddr * address )
 {
 	return self->GetListenSocketAddress( hSocket,address );
@@ -101,6 +109,10 @@ STEAMNETWORKINGSOCKETS_INTERFACE EResult SteamAPI_ISteamNetworkingSockets_Config
 {
 	return self->ConfigureConnectionLanes( hConn,nNumLanes,pLanePriorities,pLaneWeights );
 }
+STEAMNETWORKINGSOCKETS_INTERFACE EResult SteamAPI_ISteamNetworkingSockets_ConfigureConnectionLaneDeadlines( ISteamNetworkingSockets* self, HSteamNetConnection hConn, int nNumLanes, const int * pLaneLatencyTargetsMS )
+{
+	return self->ConfigureConnectionLaneDeadlines( hConn,nNumLanes,pLaneLatencyTargetsMS );
+}
 STEAMNETWORKINGSOCKETS_INTERFACE bool SteamAPI_ISteamNetworkingSockets_GetIdentity( ISteamNetworkingSockets* self, SteamNetworkingIdentity * pIdentity )
 {
 	return self->GetIdentity( pIdentity );
@@ -129,6 +141,22 @@ STEAMNETWORKINGSOCKETS_INTERFACE int SteamAPI_ISteamNetworkingSockets_ReceiveMes
 {
 	return self->ReceiveMessagesOnPollGroup( hPollGroup,ppOutMessages,nMaxMessages );
 }
+STEAMNETWORKINGSOCKETS_INTERFACE SteamNetworkingWakeHandle SteamAPI_ISteamNetworkingSockets_GetPollGroupWakeHandle( ISteamNetworkingSockets* self, HSteamNetPollGroup hPollGroup )
+{
+	return self->GetPollGroupWakeHandle( hPollGroup );
+}
+STEAMNETWORKINGSOCKETS_INTERFACE SteamNetworkingWakeHandle SteamAPI_ISteamNetworkingSockets_GetConnectionWakeHandle( ISteamNetworkingSockets* self, HSteamNetConnection hConn )
+{
+	return self->GetConnectionWakeHandle( hConn );
+}
+STEAMNETWORKINGSOCKETS_INTERFACE SteamNetworkingWakeHandle SteamAPI_ISteamNetworkingSockets_GetCallbacksWakeHandle( ISteamNetworkingSockets* self )
+{
+	return self->GetCallbacksWakeHandle(  );
+}
+STEAMNETWORKINGSOCKETS_INTERFACE void SteamAPI_ISteamNetworkingSockets_SendMessagesWithOptions( ISteamNetworkingSockets* self, int nMessages, SteamNetworkingMessage_t ** pMessages, const SteamNetworkingMicroseconds * pUsecExpiry, const int64 * pCoalesceKeys, int64 * pOutMessageNumberOrResult, bool bDeleteFailedMessages )
+{
+	self->SendMessagesWithOptions( nMessages,pMessages,pUsecExpiry,pCoalesceKeys,pOutMessageNumberOrResult,bDeleteFailedMessages );
+}
 #ifdef STEAMNETWORKINGSOCKETS_ENABLE_SDR
 STEAMNETWORKINGSOCKETS_INTERFACE bool SteamAPI_ISteamNetworkingSockets_ReceivedRelayAuthTicket( ISteamNetworkingSockets* self, const void * pvTicket, int cbTicket, SteamDatagramRelayAuthTicket * pOutParsedTicket )
 {
@@ -314,6 +342,14 @@ STEAMNETWORKINGSOCKETS_INTERFACE ESteamNetworkingConfigValue SteamAPI_ISteamNetw
 {
 	return self->IterateGenericEditableConfigValues( eCurrent,bEnumerateDevVars );
 }
+STEAMNETWORKINGSOCKETS_INTERFACE bool SteamAPI_ISteamNetworkingUtils_GetPerfMetrics( ISteamNetworkingUtils* self, SteamNetworkingPerfMetrics_t * pMetrics )
+{
+	return self->GetPerfMetrics( pMetrics );
+}
+STEAMNETWORKINGSOCKETS_INTERFACE bool SteamAPI_ISteamNetworkingUtils_SetCompressionDictionary( ISteamNetworkingUtils* self, int nDictionaryID, const void * pData, int cbData )
+{
+	return self->SetCompressionDictionary( nDictionaryID,pData,cbData );
+}
 
 //--- ISteamNetworkingMessages-------------------------
 
@@ -1174,11 +1174,17 @@ bool ICESessionInterface::SendPacketGather( int nChunks, const iovec *pChunks, i
 // CSteamNetworkingICESession
 //
 /////////////////////////////////////////////////////////////////////////////
+
+// If we can't bind to a local address, how long to wait before trying again
+constexpr SteamNetworkingMicroseconds k_usecRetryFailedInterfaceBind = 5*k_nMillion;
+
 CSteamNetworkingICESession::CSteamNetworkingICESession( EICERole role, CSteamNetworkingICESessionCallbacks *pCallbacks, int nEncoding )
 {
     m_nEncoding = nEncoding;
     m_pCallbacks = pCallbacks;
     m_bInterfaceListStale = true;
+    m_nInterfaceListVersion = 0;
+    m_usecRetryFailedBinds = 0;
     m_nextKeepalive = 0;
     m_role = role;
     m_pSelectedCandidatePair = nullptr;
@@ -1191,6 +1197,8 @@ CSteamNetworkingICESession::CSteamNetworkingICESession( const ICESessionConfig&
 	m_nEncoding = kSTUNPacketEncodingFlags_MessageIntegrity;
 	m_pCallbacks = pCallbacks;
 	m_bInterfaceListStale = true;
+	m_nInterfaceListVersion = 0;
+	m_usecRetryFailedBinds = 0;
     m_nextKeepalive = 0;
     m_role = cfg.m_eRole;
     m_pSelectedCandidatePair = nullptr;
@@ -1396,7 +1404,15 @@ EICECandidateType CSteamNetworkingICESession::AddPeerCandidate( const RFC5245Can
 
 void CSteamNetworkingICESession::InvalidateInterfaceList()
 {
+    // If the OS isn't keeping the shared table up to date for us,
+    // make sure we really do enumerate again
+    InvalidateLocalAddresses();
     m_bInterfaceListStale = true;
+
+    // And make sure we actually do a pass, even if the table hasn't changed
+    // (it might be maintained by OS notifications), so that we retry any
+    // addresses we failed to bind
+    m_nInterfaceListVersion = 0;
 }
 
 void CSteamNetworkingICESession::SetSelectedCandidatePair( ICECandidatePair *pPair )
@@ -1474,10 +1490,15 @@ void CSteamNetworkingICESession::GatherInterfaces()
 	SteamNetworkingGlobalLock::AssertHeldByCurrentThread( "CSteamNetworkingICESession::GatherInterfaces" );
 
     CUtlVector<LocalAddress_t> vecAddrs;
-    if ( !GetLocalAddresses( &vecAddrs ) )
+    uint32 nVersion;
+    if ( !GetLocalAddresses( &vecAddrs, &nVersion ) )
         return;
 
     m_bInterfaceListStale = false;
+    if ( nVersion == m_nInterfaceListVersion && m_usecRetryFailedBinds == 0 )
+        return;
+    m_nInterfaceListVersion = nVersion;
+    m_usecRetryFailedBinds = 0;
 
     // First pass: scan existing interfaces against the new address list.
     // Remove any that are no longer present; consume matched addresses from
@@ -1550,7 +1571,8 @@ void CSteamNetworkingICESession::GatherInterfaces()
         pIntf->m_pSocket = OpenRawUDPSocket( CRecvPacketCallback( CSteamNetworkingICESession::StaticPacketReceived, pIntf.get() ), errMsg, &bindAddr, nullptr );
         if ( pIntf->m_pSocket == nullptr )
         {
-            SpewWarning( "ICE: Could not bind to %s, skipping interface.  %s\n", SteamNetworkingIPAddrRender( addr.m_addr ).c_str(), errMsg );
+            SpewWarning( "ICE: Could not bind to %s, skipping interface for now.  %s\n", SteamNetworkingIPAddrRender( addr.m_addr ).c_str(), errMsg );
+            m_usecRetryFailedBinds = SteamNetworkingSockets_GetLocalTimestamp() + k_usecRetryFailedInterfaceBind;
             continue;
         }
         SteamNetworkingIPAddrToNetAdr( pIntf->m_boundAddr, pIntf->m_pSocket->m_boundAddr );
@@ -1642,8 +1664,9 @@ not_stun:
             return;
 
         // Re-enter with the inner payload, as if it arrived directly from the peer.
+        // The payload is inside our receive buffer, which the handler may modify.
         RecvPktInfo_t innerInfo;
-        innerInfo.m_pPkt    = reinterpret_cast<const uint8 *>( pDataAttr->m_pData );
+        innerInfo.m_pPkt    = info.m_pPkt + ( reinterpret_cast<const uint8 *>( pDataAttr->m_pData ) - info.m_pPkt );
         innerInfo.m_cbPkt   = (int)pDataAttr->m_nLength;
         innerInfo.m_usecNow = info.m_usecNow;
         innerInfo.m_pSock   = info.m_pSock;
@@ -1924,6 +1947,14 @@ void CSteamNetworkingICESession::Think( SteamNetworkingMicroseconds usecNow )
 
     SetNextThinkTime( usecNow + SteamNetworkingMicroseconds( 50000 ) ); // 50ms think rate
 
+    // Check if the local address table has changed.  This is cheap
+    if ( GetLocalAddressesVersion() != m_nInterfaceListVersion )
+        m_bInterfaceListStale = true;
+
+    // Time to retry addresses we couldn't bind?
+    if ( m_usecRetryFailedBinds != 0 && usecNow >= m_usecRetryFailedBinds )
+        m_bInterfaceListStale = true;
+
     if ( m_bInterfaceListStale )
     {
         GatherInterfaces();
@@ -2911,7 +2942,7 @@ void CConnectionTransportP2PICE_Valve::OnConnectionSelected( const ICELocalCandi
 void CConnectionTransportP2PICE_Valve::OnPacketReceived( const RecvPktInfo_t &info )
 {
     ConnectionScopeLock lock( Connection(), "CConnectionTransportP2PICE_Valve::OnPacketReceived");
-    ProcessPacket( (const uint8_t*)info.m_pPkt, info.m_cbPkt, info.m_usecNow );
+    ProcessPacket( info.m_pPkt, info.m_cbPkt, info.m_usecNow );
 }
 
 } // namespace SteamNetworkingSocketsLib
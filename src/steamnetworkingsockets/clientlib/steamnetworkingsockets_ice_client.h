@@ -377,6 +377,16 @@ namespace SteamNetworkingSocketsLib {
         // will re-enumerate interfaces and rebuild candidates, then clear this flag.
         bool m_bInterfaceListStale;
 
+        // Version of the process-wide local address table (see GetLocalAddresses)
+        // that m_vecInterfaces was built from.  When the table changes, we mark
+        // the interface list stale.  If nothing changed, we don't re-gather.
+        uint32 m_nInterfaceListVersion;
+
+        // If we failed to bind to some local addresses, when should we try
+        // again?  0 if every address is bound.  The address table won't
+        // change just because a bind failed, so we need our own timer.
+        SteamNetworkingMicroseconds m_usecRetryFailedBinds;
+
         // Bitmask of kSTUNPacketEncodingFlags_* controlling STUN wire format quirks:
         // whether to include a fingerprint, whether to use legacy MappedAddress vs
         // XOR-MappedAddress, and whether to sign with HMAC-SHA1 (MessageIntegrity)
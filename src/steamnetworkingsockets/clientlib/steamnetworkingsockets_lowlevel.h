@@ -49,7 +49,7 @@ extern int ClassifyIP( const CIPAddress &ip );
 /// Info about an incoming packet passed to the CRecvPacketCallback
 struct RecvPktInfo_t
 {
-	const void *m_pPkt;
+	uint8 *m_pPkt; // Not const: the handler may decrypt in place
 	int m_cbPkt;
 	SteamNetworkingMicroseconds m_usecNow; // Current time
 	// FIXME - coming soon!
@@ -342,6 +342,30 @@ extern bool IsServiceThreadRunning();
 /// but is safe to call from the service thread as well.
 extern void WakeServiceThread();
 
+/// A handle the app can wait on in its own event loop, to find out when
+/// it has something to do.  See SteamNetworkingWakeHandle.
+class CAppWakeHandle
+{
+public:
+	STEAMNETWORKINGSOCKETS_DECLARE_CLASS_OPERATOR_NEW
+
+	/// Returns NULL if the platform doesn't support it or the OS call failed
+	static CAppWakeHandle *Create( SteamNetworkingErrMsg &errMsg );
+	~CAppWakeHandle();
+
+	/// The handle we give the app to wait on
+	SteamNetworkingWakeHandle GetHandle() const { return m_hRead; }
+
+	/// Signal the handle.  Safe to call from any thread.  Signaling it
+	/// again before the app resets it is harmless.
+	void Signal();
+
+private:
+	CAppWakeHandle() {}
+	SteamNetworkingWakeHandle m_hRead = k_SteamNetworkingWakeHandle_Invalid;
+	SteamNetworkingWakeHandle m_hWrite = k_SteamNetworkingWakeHandle_Invalid; // Only for pipes
+};
+
 /// Return true if it looks like the address is a local address
 extern bool IsRouteToAddressProbablyLocal( netadr_t addr );
 
@@ -351,8 +375,38 @@ struct LocalAddress_t
 {
 	SteamNetworkingIPAddr m_addr;
 	int m_nPrefixLen; // Subnet prefix length, e.g. 24 for a /24.  0 if unavailable or bogus.
+
+	inline bool operator==( const LocalAddress_t &x ) const { return m_addr == x.m_addr && m_nPrefixLen == x.m_nPrefixLen; }
+	inline bool operator!=( const LocalAddress_t &x ) const { return !( *this == x ); }
 };
-extern bool GetLocalAddresses( CUtlVector<LocalAddress_t> *pAddrs );
+
+/// Fetch the list of local interface addresses.  This is served from a process-wide
+/// table that is built the first time it is needed.  Where the OS can notify us of
+/// address changes (Linux netlink), the table is updated incrementally on the service
+/// thread.  Elsewhere, it is re-enumerated if it is older than a few seconds.
+/// If pnVersion is not NULL, it receives the version of the table that was returned.
+/// You must hold the global lock.
+extern bool GetLocalAddresses( CUtlVector<LocalAddress_t> *pAddrs, uint32 *pnVersion = nullptr );
+
+/// Return the current version of the local address table.  This is bumped any time
+/// the set of addresses actually changes, so you can compare it against the value
+/// returned by GetLocalAddresses to tell if you need to re-fetch the list.  This does
+/// not enumerate anything.  You must hold the global lock.
+extern uint32 GetLocalAddressesVersion();
+
+/// Discard the cached address table, unless it is being kept up-to-date by change
+/// notifications from the OS.  The next call to GetLocalAddresses will enumerate
+/// interfaces from scratch.  You must hold the global lock.
+extern void InvalidateLocalAddresses();
+
+/// Test hooks for the local address table.  These take the global lock, and
+/// only use public types, so the tests don't need our internal headers.
+/// TEST_ApplyLocalAddressChange simulates an address change notification from
+/// the OS.  TEST_GetLocalAddressesVersion fetches the table (optionally
+/// discarding it first) and returns its version, and whether it has the address.
+/// It returns 0 if the table can't be fetched.  (Versions start at 1.)
+extern void TEST_ApplyLocalAddressChange( const SteamNetworkingIPAddr &addr, int nPrefixLen, bool bAdded );
+extern uint32 TEST_GetLocalAddressesVersion( bool bInvalidate, const SteamNetworkingIPAddr *pAddr, int nPrefixLen, bool *pbFound );
 
 /////////////////////////////////////////////////////////////////////////////
 //
@@ -744,6 +798,13 @@ public:
 	/// on no particular thread and with no locks held
 	void QueueToRunInBackground();
 
+	/// Queue the item to run on a worker thread, with no locks held.  This is
+	/// for CPU-heavy work that we don't want to do while holding the global
+	/// lock.  The task must not have a target.  If there are no worker threads
+	/// (see BWorkerThreadsEnabled), the task is run immediately on the
+	/// calling thread.
+	void QueueToRunOnWorkerThread();
+
 	/// Function call used to try to take the lock
 	typedef bool (*FTryLockFunc)( void *lock, int msTimeOut, const char *pszTag );
 
@@ -792,6 +853,7 @@ protected:
 private:
 	friend class CTaskList;
 	friend class CTaskTarget;
+	friend class CWorkerThreadPool;
 	CQueuedTask *m_pNextTaskInQueue = nullptr;
 	CQueuedTask *m_pPrevTaskForTarget = nullptr;
 	CQueuedTask *m_pNextTaskForTarget = nullptr;
@@ -848,6 +910,69 @@ extern CTaskList g_taskListRunWithGlobalLock;
 /// we do NOT hold the global lock.
 extern CTaskList g_taskListRunInBackground;
 
+/// Return true if we should hand CPU-heavy work to worker threads.
+/// See k_ESteamNetworkingConfig_HandshakeWorkerThreads
+inline bool BWorkerThreadsEnabled() { return GlobalConfig::HandshakeWorkerThreads.Get() > 0; }
+
+/// Stop all worker threads.  Tasks that have not started are deleted
+/// without being run.
+extern void ShutdownWorkerThreads();
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// Performance metrics
+//
+// Each thread accumulates into its own block, so recording a sample
+// never touches a cache line shared with another thread.  Callers are
+// expected to check BPerfMetricsEnabled() first, so that we don't even
+// read the timer when metrics are off.
+//
+/////////////////////////////////////////////////////////////////////////////
+
+enum EPerfCounter
+{
+	k_EPerfCounter_RecvPackets,
+	k_EPerfCounter_RecvBytes,
+	k_EPerfCounter_SentBytes,
+	k_EPerfCounter_SendFailures,
+	k_EPerfCounter_DecryptFailures,
+	k_EPerfCounter_AllocCalls,
+	k_EPerfCounter_ReallocCalls,
+	k_EPerfCounter_FreeCalls,
+	k_EPerfCounter_AllocBytes,
+	k_EPerfCounter_KeyExchangeKeyPoolHits,
+	k_EPerfCounter_KeyExchangeKeyPoolMisses,
+	k_EPerfCounter_SessionsResumed,
+	k_EPerfCounter_SessionResumptionsRejected,
+	k_EPerfCounter_CertCacheHits,
+	k_EPerfCounter_CertCacheMisses,
+	k_EPerfCounter_HandshakeFiltered,
+	k_EPerfCounter_HandshakeRateLimited,
+	k_EPerfCounter_ConnectRequestsDeferred,
+	k_EPerfCounter_ConnectRequestsDropped,
+
+	k_EPerfCounter__Count
+};
+
+enum EPerfHistogram
+{
+	k_EPerfHistogram_RecvFromUsec,
+	k_EPerfHistogram_SendToUsec,
+	k_EPerfHistogram_GlobalLockWaitUsec,
+	k_EPerfHistogram_GlobalLockHoldUsec,
+	k_EPerfHistogram_ThinkerLatenessUsec,
+	k_EPerfHistogram_PacketsPerPollWakeup,
+	k_EPerfHistogram_EncryptUsec,
+	k_EPerfHistogram_DecryptUsec,
+
+	k_EPerfHistogram__Count
+};
+
+inline bool BPerfMetricsEnabled() { return GlobalConfig::PerfMetrics.Get() != 0; }
+extern void PerfCounterAdd( EPerfCounter eCounter, int64 nAmount );
+extern void PerfHistogramRecord( EPerfHistogram eHistogram, int64 nValue );
+extern void PerfMetrics_GetSnapshot( SteamNetworkingPerfMetrics_t *pMetrics );
+
 /////////////////////////////////////////////////////////////////////////////
 //
 // Misc
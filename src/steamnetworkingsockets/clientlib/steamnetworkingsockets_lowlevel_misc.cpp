@@ -4,6 +4,7 @@
 //
 // - Global lock (mutex) and lock debugging
 // - Local timestamp clock
+// - Performance metrics
 // - Memory allocator override
 //
 #include "steamnetworkingsockets_lowlevel.h"
@@ -430,18 +431,50 @@ void AssertGlobalLockHeldExactlyOnce()
 
 #endif // #if STEAMNETWORKINGSOCKETS_LOCK_DEBUG_LEVEL > 0
 
+// Global lock recursion depth for the current thread, and when the
+// outermost lock was acquired.  (Used for performance metrics.)
+static thread_local int tls_nGlobalLockDepth;
+static thread_local SteamNetworkingMicroseconds tls_usecGlobalLockAcquired;
+
+static void OnGlobalLockAcquired( SteamNetworkingMicroseconds usecStartedWaiting )
+{
+	if ( tls_nGlobalLockDepth++ > 0 || usecStartedWaiting == 0 )
+		return;
+	SteamNetworkingMicroseconds usecNow = SteamNetworkingSockets_GetLocalTimestamp();
+	PerfHistogramRecord( k_EPerfHistogram_GlobalLockWaitUsec, usecNow - usecStartedWaiting );
+	tls_usecGlobalLockAcquired = usecNow;
+}
+
 void SteamNetworkingGlobalLock::Lock( const char *pszTag )
 {
+	SteamNetworkingMicroseconds usecStartedWaiting = 0;
+	if ( unlikely( BPerfMetricsEnabled() ) && tls_nGlobalLockDepth == 0 )
+		usecStartedWaiting = SteamNetworkingSockets_GetLocalTimestamp();
 	s_mutexGlobalLock.lock( pszTag );
+	OnGlobalLockAcquired( usecStartedWaiting );
 }
 
 bool SteamNetworkingGlobalLock::TryLock( const char *pszTag, int msTimeout )
 {
-	return s_mutexGlobalLock.try_lock_for( msTimeout, pszTag );
+	SteamNetworkingMicroseconds usecStartedWaiting = 0;
+	if ( unlikely( BPerfMetricsEnabled() ) && tls_nGlobalLockDepth == 0 )
+		usecStartedWaiting = SteamNetworkingSockets_GetLocalTimestamp();
+	if ( !s_mutexGlobalLock.try_lock_for( msTimeout, pszTag ) )
+		return false;
+	OnGlobalLockAcquired( usecStartedWaiting );
+	return true;
 }
 
 void SteamNetworkingGlobalLock::Unlock()
 {
+	Assert( tls_nGlobalLockDepth > 0 );
+	if ( --tls_nGlobalLockDepth == 0 && tls_usecGlobalLockAcquired != 0 )
+	{
+		// Metrics might have been turned off while we held the lock
+		if ( BPerfMetricsEnabled() )
+			PerfHistogramRecord( k_EPerfHistogram_GlobalLockHoldUsec, SteamNetworkingSockets_GetLocalTimestamp() - tls_usecGlobalLockAcquired );
+		tls_usecGlobalLockAcquired = 0;
+	}
 	s_mutexGlobalLock.unlock();
 }
 
@@ -555,6 +588,206 @@ SteamNetworkingMicroseconds SteamNetworkingSockets_GetLocalTimestamp()
 	return usecResult;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+//
+// Performance metrics
+//
+/////////////////////////////////////////////////////////////////////////////
+
+namespace SteamNetworkingSocketsLib {
+
+struct PerfHistogramBlock_t
+{
+	std::atomic<int64> m_nCount;
+	std::atomic<int64> m_nSum;
+	std::atomic<int64> m_nMax;
+	std::atomic<int64> m_arBuckets[ SteamNetworkingHistogram_t::k_nBuckets ];
+};
+
+/// Metrics accumulated by a single thread.  Only the owning thread writes
+/// to the values, so we don't need atomic read-modify-write operations,
+/// just atomic loads and stores so that the snapshot can read them while
+/// they are being updated.  Blocks are never freed.  When a thread exits,
+/// its block is made available to be claimed by the next new thread, so
+/// the totals are not lost and the number of blocks is bounded by the max
+/// number of threads that were ever alive at once.
+struct PerfThreadBlock_t
+{
+	PerfThreadBlock_t *m_pNext;
+	bool m_bInUse; // Protected by s_mutexPerfThreadBlocks
+	std::atomic<int64> m_arCounters[ k_EPerfCounter__Count ];
+	PerfHistogramBlock_t m_arHistograms[ k_EPerfHistogram__Count ];
+};
+
+static std::mutex s_mutexPerfThreadBlocks;
+static PerfThreadBlock_t *s_pFirstPerfThreadBlock;
+static int s_nPerfThreadBlocks;
+
+static thread_local PerfThreadBlock_t *tls_pPerfThreadBlock;
+static thread_local bool tls_bPerfThreadExited;
+
+/// Returns this thread's block to the free list when the thread exits
+struct PerfThreadBlockReleaser
+{
+	~PerfThreadBlockReleaser()
+	{
+		tls_bPerfThreadExited = true;
+		if ( tls_pPerfThreadBlock )
+		{
+			std::lock_guard<std::mutex> lock( s_mutexPerfThreadBlocks );
+			tls_pPerfThreadBlock->m_bInUse = false;
+			tls_pPerfThreadBlock = nullptr;
+		}
+	}
+};
+
+static PerfThreadBlock_t *GetPerfThreadBlock()
+{
+	PerfThreadBlock_t *pBlock = tls_pPerfThreadBlock;
+	if ( likely( pBlock ) )
+		return pBlock;
+
+	// Thread is being torn down?  (E.g. memory freed by another
+	// thread_local destructor.)  Just drop the sample.
+	if ( tls_bPerfThreadExited )
+		return nullptr;
+
+	// Make sure we give the block back when this thread exits
+	thread_local PerfThreadBlockReleaser tls_releaser;
+	(void)tls_releaser;
+
+	std::lock_guard<std::mutex> lock( s_mutexPerfThreadBlocks );
+
+	// Recycle a block from a thread that has exited, if we can
+	for ( pBlock = s_pFirstPerfThreadBlock ; pBlock ; pBlock = pBlock->m_pNext )
+	{
+		if ( !pBlock->m_bInUse )
+			break;
+	}
+
+	if ( !pBlock )
+	{
+		// NOTE: Not using malloc here, since the allocator override
+		// itself records metrics
+		pBlock = new PerfThreadBlock_t();
+		pBlock->m_pNext = s_pFirstPerfThreadBlock;
+		s_pFirstPerfThreadBlock = pBlock;
+		++s_nPerfThreadBlocks;
+	}
+
+	pBlock->m_bInUse = true;
+	tls_pPerfThreadBlock = pBlock;
+	return pBlock;
+}
+
+/// Add to a value that is only written by the current thread
+static inline void PerfAccumulate( std::atomic<int64> &x, int64 nAmount )
+{
+	x.store( x.load( std::memory_order_relaxed ) + nAmount, std::memory_order_relaxed );
+}
+
+/// Fast version of SteamNetworkingHistogram_t::BucketForValue
+static inline int PerfHistogramBucket( int64 nValue )
+{
+	if ( nValue < SteamNetworkingHistogram_t::k_nSubBuckets )
+		return (int)nValue;
+	if ( nValue > (int64)0xffffffffu )
+		return SteamNetworkingHistogram_t::k_nBuckets-1;
+	int nShift = FindMostSignificantBit( (uint32)nValue ) - SteamNetworkingHistogram_t::k_nSubBucketBits;
+	return ( nShift + 1 ) * SteamNetworkingHistogram_t::k_nSubBuckets + (int)( ( nValue >> nShift ) & ( SteamNetworkingHistogram_t::k_nSubBuckets-1 ) );
+}
+
+void PerfCounterAdd( EPerfCounter eCounter, int64 nAmount )
+{
+	Assert( (unsigned)eCounter < k_EPerfCounter__Count );
+	PerfThreadBlock_t *pBlock = GetPerfThreadBlock();
+	if ( pBlock )
+		PerfAccumulate( pBlock->m_arCounters[ eCounter ], nAmount );
+}
+
+void PerfHistogramRecord( EPerfHistogram eHistogram, int64 nValue )
+{
+	Assert( (unsigned)eHistogram < k_EPerfHistogram__Count );
+	PerfThreadBlock_t *pBlock = GetPerfThreadBlock();
+	if ( !pBlock )
+		return;
+
+	// Clock weirdness can cause tiny negative intervals
+	if ( nValue < 0 )
+		nValue = 0;
+
+	PerfHistogramBlock_t &h = pBlock->m_arHistograms[ eHistogram ];
+	PerfAccumulate( h.m_nCount, 1 );
+	PerfAccumulate( h.m_nSum, nValue );
+	if ( nValue > h.m_nMax.load( std::memory_order_relaxed ) )
+		h.m_nMax.store( nValue, std::memory_order_relaxed );
+	PerfAccumulate( h.m_arBuckets[ PerfHistogramBucket( nValue ) ], 1 );
+}
+
+void PerfMetrics_GetSnapshot( SteamNetworkingPerfMetrics_t *pMetrics )
+{
+	static int64 SteamNetworkingPerfMetrics_t::* const s_arCounterFields[] =
+	{
+		&SteamNetworkingPerfMetrics_t::m_nRecvPackets, // k_EPerfCounter_RecvPackets
+		&SteamNetworkingPerfMetrics_t::m_cbRecv, // k_EPerfCounter_RecvBytes
+		&SteamNetworkingPerfMetrics_t::m_cbSent, // k_EPerfCounter_SentBytes
+		&SteamNetworkingPerfMetrics_t::m_nSendFailures, // k_EPerfCounter_SendFailures
+		&SteamNetworkingPerfMetrics_t::m_nDecryptFailures, // k_EPerfCounter_DecryptFailures
+		&SteamNetworkingPerfMetrics_t::m_nAllocCalls, // k_EPerfCounter_AllocCalls
+		&SteamNetworkingPerfMetrics_t::m_nReallocCalls, // k_EPerfCounter_ReallocCalls
+		&SteamNetworkingPerfMetrics_t::m_nFreeCalls, // k_EPerfCounter_FreeCalls
+		&SteamNetworkingPerfMetrics_t::m_cbAllocated, // k_EPerfCounter_AllocBytes
+		&SteamNetworkingPerfMetrics_t::m_nKeyExchangeKeyPoolHits, // k_EPerfCounter_KeyExchangeKeyPoolHits
+		&SteamNetworkingPerfMetrics_t::m_nKeyExchangeKeyPoolMisses, // k_EPerfCounter_KeyExchangeKeyPoolMisses
+		&SteamNetworkingPerfMetrics_t::m_nSessionsResumed, // k_EPerfCounter_SessionsResumed
+		&SteamNetworkingPerfMetrics_t::m_nSessionResumptionsRejected, // k_EPerfCounter_SessionResumptionsRejected
+		&SteamNetworkingPerfMetrics_t::m_nCertCacheHits, // k_EPerfCounter_CertCacheHits
+		&SteamNetworkingPerfMetrics_t::m_nCertCacheMisses, // k_EPerfCounter_CertCacheMisses
+		&SteamNetworkingPerfMetrics_t::m_nHandshakeFiltered, // k_EPerfCounter_HandshakeFiltered
+		&SteamNetworkingPerfMetrics_t::m_nHandshakeRateLimited, // k_EPerfCounter_HandshakeRateLimited
+		&SteamNetworkingPerfMetrics_t::m_nConnectRequestsDeferred, // k_EPerfCounter_ConnectRequestsDeferred
+		&SteamNetworkingPerfMetrics_t::m_nConnectRequestsDropped, // k_EPerfCounter_ConnectRequestsDropped
+	};
+	COMPILE_TIME_ASSERT( V_ARRAYSIZE( s_arCounterFields ) == k_EPerfCounter__Count );
+
+	static SteamNetworkingHistogram_t SteamNetworkingPerfMetrics_t::* const s_arHistogramFields[] =
+	{
+		&SteamNetworkingPerfMetrics_t::m_histRecvFromUsec, // k_EPerfHistogram_RecvFromUsec
+		&SteamNetworkingPerfMetrics_t::m_histSendToUsec, // k_EPerfHistogram_SendToUsec
+		&SteamNetworkingPerfMetrics_t::m_histGlobalLockWaitUsec, // k_EPerfHistogram_GlobalLockWaitUsec
+		&SteamNetworkingPerfMetrics_t::m_histGlobalLockHoldUsec, // k_EPerfHistogram_GlobalLockHoldUsec
+		&SteamNetworkingPerfMetrics_t::m_histThinkerLatenessUsec, // k_EPerfHistogram_ThinkerLatenessUsec
+		&SteamNetworkingPerfMetrics_t::m_histPacketsPerPollWakeup, // k_EPerfHistogram_PacketsPerPollWakeup
+		&SteamNetworkingPerfMetrics_t::m_histEncryptUsec, // k_EPerfHistogram_EncryptUsec
+		&SteamNetworkingPerfMetrics_t::m_histDecryptUsec, // k_EPerfHistogram_DecryptUsec
+	};
+	COMPILE_TIME_ASSERT( V_ARRAYSIZE( s_arHistogramFields ) == k_EPerfHistogram__Count );
+
+	memset( pMetrics, 0, sizeof(*pMetrics) );
+	pMetrics->m_usecTimestamp = SteamNetworkingSockets_GetLocalTimestamp();
+
+	std::lock_guard<std::mutex> lock( s_mutexPerfThreadBlocks );
+	pMetrics->m_nThreads = s_nPerfThreadBlocks;
+	for ( const PerfThreadBlock_t *pBlock = s_pFirstPerfThreadBlock ; pBlock ; pBlock = pBlock->m_pNext )
+	{
+		for ( int i = 0 ; i < k_EPerfCounter__Count ; ++i )
+			pMetrics->*s_arCounterFields[i] += pBlock->m_arCounters[i].load( std::memory_order_relaxed );
+
+		for ( int i = 0 ; i < k_EPerfHistogram__Count ; ++i )
+		{
+			const PerfHistogramBlock_t &src = pBlock->m_arHistograms[i];
+			SteamNetworkingHistogram_t &dest = pMetrics->*s_arHistogramFields[i];
+			dest.m_nCount += src.m_nCount.load( std::memory_order_relaxed );
+			dest.m_nSum += src.m_nSum.load( std::memory_order_relaxed );
+			dest.m_nMax = std::max( dest.m_nMax, src.m_nMax.load( std::memory_order_relaxed ) );
+			for ( int b = 0 ; b < SteamNetworkingHistogram_t::k_nBuckets ; ++b )
+				dest.m_arBuckets[b] += src.m_arBuckets[b].load( std::memory_order_relaxed );
+		}
+	}
+}
+
+} // namespace SteamNetworkingSocketsLib
+
 /////////////////////////////////////////////////////////////////////////////
 //
 // memory override
@@ -576,17 +809,29 @@ static void* (*s_pfn_realloc)( void *p, size_t s ) = realloc;
 void *SteamNetworkingSockets_Malloc( size_t s )
 {
 	s_bHasAllocatedMemory = true;
+	if ( unlikely( BPerfMetricsEnabled() ) )
+	{
+		PerfCounterAdd( k_EPerfCounter_AllocCalls, 1 );
+		PerfCounterAdd( k_EPerfCounter_AllocBytes, (int64)s );
+	}
 	return (*s_pfn_malloc)( s );
 }
 
 void *SteamNetworkingSockets_Realloc( void *p, size_t s )
 {
 	s_bHasAllocatedMemory = true;
+	if ( unlikely( BPerfMetricsEnabled() ) )
+	{
+		PerfCounterAdd( k_EPerfCounter_ReallocCalls, 1 );
+		PerfCounterAdd( k_EPerfCounter_AllocBytes, (int64)s );
+	}
 	return (*s_pfn_realloc)( p, s );
 }
 
 void SteamNetworkingSockets_Free( void *p )
 {
+	if ( unlikely( BPerfMetricsEnabled() ) && p )
+		PerfCounterAdd( k_EPerfCounter_FreeCalls, 1 );
 	(*s_pfn_free)( p );
 }
 
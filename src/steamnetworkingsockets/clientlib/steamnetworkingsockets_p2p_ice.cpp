@@ -742,7 +742,7 @@ void CConnectionTransportP2PICE::P2PTransportUpdateRouteMetrics( SteamNetworking
 		} \
 	}
 
-void CConnectionTransportP2PICE::ProcessPacket( const uint8_t *pPkt, int cbPkt, SteamNetworkingMicroseconds usecNow )
+void CConnectionTransportP2PICE::ProcessPacket( uint8_t *pPkt, int cbPkt, SteamNetworkingMicroseconds usecNow )
 {
 	// Check for bad packet.  I think the minimum required size is
 	// actually larger.  But each of the paths below will handle it
@@ -785,16 +785,16 @@ void CConnectionTransportP2PICE::TrackSentStats( UDPSendPacketContext_t &ctx )
 	CConnectionTransportUDPBase::TrackSentStats( ctx );
 
 	// Does this count as a ping request?
-	if ( ctx.msg.has_stats() || ( ctx.msg.flags() & ctx.msg.ACK_REQUEST_E2E ) )
+	if ( ctx.m_stats.HasStats() || ( ctx.m_stats.m_nFlags & CMsgSteamSockets_UDP_Stats::ACK_REQUEST_E2E ) )
 	{
-		bool bAllowDelayedReply = ( ctx.msg.flags() & ctx.msg.ACK_REQUEST_IMMEDIATE ) == 0;
+		bool bAllowDelayedReply = ( ctx.m_stats.m_nFlags & CMsgSteamSockets_UDP_Stats::ACK_REQUEST_IMMEDIATE ) == 0;
 		P2PTransportTrackSentEndToEndPingRequest( ctx.m_usecNow, bAllowDelayedReply );
 	}
 }
 
 void CConnectionTransportP2PICE::RecvValidUDPDataPacket( UDPRecvPacketContext_t &ctx )
 {
-	if ( !ctx.m_pStatsIn || !( ctx.m_pStatsIn->flags() & ctx.m_pStatsIn->NOT_PRIMARY_TRANSPORT_E2E ) )
+	if ( !ctx.m_pStatsIn || !( ctx.m_pStatsIn->m_nFlags & CMsgSteamSockets_UDP_Stats::NOT_PRIMARY_TRANSPORT_E2E ) )
 		Connection().SetPeerSelectedTransport( this );
 	P2PTransportTrackRecvEndToEndPacket( ctx.m_usecNow );
 	if ( m_bNeedToConfirmEndToEndConnectivity && BCanSendEndToEndData() )
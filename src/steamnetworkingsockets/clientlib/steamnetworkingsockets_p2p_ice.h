@@ -53,7 +53,9 @@ public:
 protected:
 	CConnectionTransportP2PICE( CSteamNetworkConnectionP2P &connection );
 
-	void ProcessPacket( const uint8_t *pData, int cbPkt, SteamNetworkingMicroseconds usecNow );
+	/// Process a packet received on the ICE route.  Data packets are decrypted
+	/// in place, see Received_Data
+	void ProcessPacket( uint8_t *pData, int cbPkt, SteamNetworkingMicroseconds usecNow );
 
 	// Implements CConnectionTransportUDPBase
 	virtual bool SendPacket( const void *pkt, int cbPkt ) override = 0;
@@ -448,7 +448,7 @@ void CConnectionTransportP2PICE_WebRTC::OnData( const void *pPkt, size_t nSize )
 	SteamNetworkingMicroseconds usecNow = SteamNetworkingSockets_GetLocalTimestamp();
 	const int cbPkt = int(nSize);
 
-	if ( nSize < 1 )
+	if ( nSize < 1 || nSize > (size_t)k_cbSteamNetworkingSocketsMaxUDPMsgLen )
 	{
 		ReportBadUDPPacketFromConnectionPeer( "packet", "Bad packet size: %d", cbPkt );
 		return;
@@ -473,8 +473,11 @@ void CConnectionTransportP2PICE_WebRTC::OnData( const void *pPkt, size_t nSize )
 			Assert( m_bufPacketQueue.TellPut() == 0 );
 		}
 
-		// And now process this packet
-		ProcessPacket( (const uint8_t*)pPkt, cbPkt, usecNow );
+		// And now process this packet.  The buffer belongs to WebRTC, and we
+		// decrypt in place, so we need our own copy.
+		uint8 pktCopy[ k_cbSteamNetworkingSocketsMaxUDPMsgLen ];
+		memcpy( pktCopy, pPkt, cbPkt );
+		ProcessPacket( pktCopy, cbPkt, usecNow );
 		SteamNetworkingGlobalLock::Unlock();
 		return;
 	}
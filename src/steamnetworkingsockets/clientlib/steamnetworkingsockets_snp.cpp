@@ -29,12 +29,18 @@ struct SNPAckSerializerHelper
 		// Total size of ack data up to this point:
 		// header, all previous blocks, and this block
 		int16 m_cbTotalEncodedSize;
+
+		// If we use this as the highest numbered block, should
+		// we use the packed ack frame?  (Compact encoding only,
+		// and only when it's not larger.)
+		bool m_bPacked;
 	};
 
 	enum { k_cbHeaderSize = 5 };
 	enum { k_nMaxBlocks = 64 };
 	int m_nBlocks;
 	int m_nBlocksNeedToAck; // Number of blocks we really need to send now.
+	int m_cbEncodedSizeNoBlocks; // Size of the ack frame if we don't send any blocks
 	Block m_arBlocks[ k_nMaxBlocks ];
 
 	static uint16 EncodeTimeSince( SteamNetworkingMicroseconds usecNow, SteamNetworkingMicroseconds usecWhenSentLast )
@@ -49,6 +55,105 @@ struct SNPAckSerializerHelper
 		return uint16( usecElapsedSinceLast >> k_nAckDelayPrecisionShift );
 	}
 
+	// Pack the 16-bit delay into 8 bits, for the packed ack frame.  The
+	// format is eeemmmmm: e=0 is the value m, otherwise (32+m)<<(e-1).
+	// Returns false if the delay is too large, and needs to be sent
+	// using 16 bits.  0xff is reserved to mean "no timing info".
+	static bool PackTimeSince( uint16 nEncodedTimeSince, uint8 &nPacked )
+	{
+		if ( nEncodedTimeSince == 0xffff )
+		{
+			nPacked = 0xff;
+			return true;
+		}
+		if ( nEncodedTimeSince < 32 )
+		{
+			nPacked = uint8( nEncodedTimeSince );
+			return true;
+		}
+		for ( int e = 1 ; e < 8 ; ++e )
+		{
+			// Round to nearest
+			unsigned nShift = e-1;
+			unsigned m = ( nEncodedTimeSince + ( ( 1u << nShift ) >> 1 ) ) >> nShift;
+			if ( m < 64 )
+			{
+				Assert( m >= 32 );
+				nPacked = uint8( ( e << 5 ) | ( m - 32 ) );
+				return nPacked != 0xff;
+			}
+		}
+		return false;
+	}
+
+	static uint16 UnpackTimeSince( uint8 nPacked )
+	{
+		if ( nPacked == 0xff )
+			return 0xffff;
+		unsigned e = nPacked >> 5;
+		unsigned m = nPacked & 0x1f;
+		if ( e == 0 )
+			return uint16( m );
+		return uint16( ( 32 + m ) << ( e-1 ) );
+	}
+
+	// Size of the ack frame header
+	static int HeaderSize( bool bPacked, int nBlocks, uint16 nEncodedTimeSince )
+	{
+		if ( !bPacked )
+			return k_cbHeaderSize + ( nBlocks > 6 ? 1 : 0 );
+		uint8 nPackedTime;
+		return 3 + ( PackTimeSince( nEncodedTimeSince, nPackedTime ) ? 1 : 2 ) + ( nBlocks > 2 ? 1 : 0 );
+	}
+
+	// Write the ack frame header.  We always use a 16-bit packet number.
+	static uint8 *SerializeHeader( uint8 *pOut, bool bPacked, int nBlocks, uint32 nLatestPktNum, uint16 nEncodedTimeSince )
+	{
+		Assert( nBlocks == uint8( nBlocks ) );
+		uint8 *pHeaderByte = pOut++;
+		*(uint16 *)pOut = LittleWord( uint16( nLatestPktNum ) ); pOut += 2;
+		if ( bPacked )
+		{
+			// 1011wdnn
+			*pHeaderByte = 0xb8;
+			uint8 nPackedTime;
+			if ( PackTimeSince( nEncodedTimeSince, nPackedTime ) )
+			{
+				*(pOut++) = nPackedTime;
+			}
+			else
+			{
+				*pHeaderByte |= 0x04;
+				*(uint16 *)pOut = LittleWord( nEncodedTimeSince ); pOut += 2;
+			}
+			if ( nBlocks > 2 )
+			{
+				*pHeaderByte |= 3;
+				*(pOut++) = uint8( nBlocks );
+			}
+			else
+			{
+				*pHeaderByte |= uint8( nBlocks );
+			}
+		}
+		else
+		{
+			// 1001wnnn
+			*pHeaderByte = 0x98;
+			*(uint16 *)pOut = LittleWord( nEncodedTimeSince ); pOut += 2;
+			if ( nBlocks > 6 )
+			{
+				*pHeaderByte |= 7;
+				*(pOut++) = uint8( nBlocks );
+			}
+			else
+			{
+				*pHeaderByte |= uint8( nBlocks );
+			}
+		}
+		return pOut;
+	}
+
 };
 
 // Fetch ping, and handle two edge cases:
@@ -78,6 +183,78 @@ void SSNPSenderState::Shutdown()
 	m_cbSentUnackedReliable = 0;
 }
 
+void SSNPSenderState::RemoveQueuedUnreliableMessage( CSteamNetworkingMessage *pMsg )
+{
+	Lane &lane = m_vecLanes[ pMsg->m_idxLane ];
+	Assert( !pMsg->SNPSend_IsReliable() );
+	Assert( pMsg->m_linksSecondaryQueue.m_pQueue == &lane.m_messagesQueued );
+	Assert( pMsg != lane.m_messagesQueued.m_pFirst || lane.m_cbCurrentSendMessageSent == 0 );
+
+	Assert( lane.m_cbPendingUnreliable >= pMsg->m_cbSize );
+	lane.m_cbPendingUnreliable -= pMsg->m_cbSize;
+	Assert( m_cbPendingUnreliable >= pMsg->m_cbSize );
+	m_cbPendingUnreliable -= pMsg->m_cbSize;
+
+	if ( pMsg->m_nFlags & k_nSteamNetworkingSend_DeliveryReceipt )
+		QueueDeliveryReceipt( pMsg->m_idxLane, pMsg->m_nMessageNumber, false );
+
+	pMsg->Unlink();
+	pMsg->Release();
+}
+
+void SSNPSenderState::QueueDeliveryReceipt( int idxLane, int64 nMsgNum, bool bDelivered )
+{
+	if ( len( m_vecDeliveryReceipts ) >= k_nMaxQueuedDeliveryReceipts )
+	{
+		// App isn't keeping up.  Discard the oldest half in one go,
+		// so we aren't shifting the whole array for each new receipt
+		m_vecDeliveryReceipts.erase( m_vecDeliveryReceipts.begin(), m_vecDeliveryReceipts.begin() + k_nMaxQueuedDeliveryReceipts/2 );
+	}
+	m_vecDeliveryReceipts.resize( m_vecDeliveryReceipts.size()+1 );
+	SteamNetworkingDeliveryReceipt_t &receipt = m_vecDeliveryReceipts.back();
+	receipt.m_nMessageNumber = nMsgNum;
+	receipt.m_idxLane = idxLane;
+	receipt.m_bDelivered = bDelivered;
+}
+
+void SSNPSenderState::TrackDeliveryReceipt( SNPInFlightPacket_t &pkt, int idxLane, int64 nMsgNum, bool bLastSegment )
+{
+	Lane::PendingDeliveryReceipt &pending = m_vecLanes[ idxLane ].m_mapPendingDeliveryReceipts[ nMsgNum ];
+	++pending.m_nPacketsInFlight;
+	if ( bLastSegment )
+		pending.m_bAllSegmentsSent = true;
+	pkt.m_vecDeliveryReceipts.push_back( SNPInFlightPacket_t::DeliveryReceiptRef{ nMsgNum, idxLane } );
+}
+
+void SSNPSenderState::ResolveDeliveryReceipts( SNPInFlightPacket_t &pkt, bool bDelivered )
+{
+	for ( const SNPInFlightPacket_t::DeliveryReceiptRef &ref: pkt.m_vecDeliveryReceipts )
+	{
+		std_map<int64,Lane::PendingDeliveryReceipt> &mapPending = m_vecLanes[ ref.m_idxLane ].m_mapPendingDeliveryReceipts;
+		auto it = mapPending.find( ref.m_nMsgNum );
+		if ( it == mapPending.end() )
+		{
+			AssertMsg( false, "Delivery receipt for msg %lld not pending", (long long)ref.m_nMsgNum );
+			continue;
+		}
+		Lane::PendingDeliveryReceipt &pending = it->second;
+		Assert( pending.m_nPacketsInFlight > 0 );
+		--pending.m_nPacketsInFlight;
+
+		// One lost segment is enough to know the message was lost.  But
+		// we only know it was delivered once all of them have been acked.
+		if ( !pending.m_bReported && ( !bDelivered || ( pending.m_bAllSegmentsSent && pending.m_nPacketsInFlight == 0 ) ) )
+		{
+			QueueDeliveryReceipt( ref.m_idxLane, ref.m_nMsgNum, bDelivered );
+			pending.m_bReported = true;
+		}
+
+		if ( pending.m_bAllSegmentsSent && pending.m_nPacketsInFlight == 0 )
+			mapPending.erase( it );
+	}
+	pkt.m_vecDeliveryReceipts.clear();
+}
+
 //-----------------------------------------------------------------------------
 SSNPSenderState::SSNPSenderState()
 {
@@ -261,10 +438,119 @@ void SSNPReceiverState::InitPacketGapMap( int64 nMaxRecvPktNum, SteamNetworkingM
 //-----------------------------------------------------------------------------
 void SSNPReceiverState::Shutdown()
 {
+	for ( Lane &l: m_vecLanes )
+		l.UnreliableDiscardAll();
 	m_vecLanes.clear();
 	m_mapPacketGaps.clear();
 }
 
+//-----------------------------------------------------------------------------
+const SSNPReceiverState::Lane::FECRecentMsg *SSNPReceiverState::Lane::FECFindMessage( int64 nMsgNum ) const
+{
+	for ( const FECRecentMsg &m: m_vecFECRecent )
+	{
+		if ( m.m_nMsgNum == nMsgNum )
+			return &m;
+	}
+	return nullptr;
+}
+
+bool SSNPReceiverState::Lane::FECRememberMessage( int64 nMsgNum, const void *pData, int cbSize, bool bRecovered )
+{
+	Assert( m_nFECMinMsgNum > 0 && nMsgNum >= m_nFECMinMsgNum );
+	Assert( cbSize <= k_cbMaxFECMessageSize );
+	if ( FECFindMessage( nMsgNum ) )
+		return false;
+
+	// Replace the oldest entry.  Once we forget about it, we
+	// can't tell if we received it, or anything older.
+	FECRecentMsg &m = m_vecFECRecent[ m_idxFECRecentNext ];
+	if ( m.m_nMsgNum >= m_nFECMinMsgNum )
+		m_nFECMinMsgNum = m.m_nMsgNum+1;
+	m_idxFECRecentNext = ( m_idxFECRecentNext + 1 ) % len( m_vecFECRecent );
+
+	m.m_nMsgNum = nMsgNum;
+	m.m_cbSize = cbSize;
+	m.m_bRecovered = bRecovered;
+	memcpy( m.m_data, pData, cbSize );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+CSteamNetworkingMessage *SSNPReceiverState::Lane::UnreliableFindMsgBuffer( int64 nMsgNum ) const
+{
+	for ( const SSNPRecvUnreliableMsgBuffer &b: m_vecUnreliableMsgBuffers )
+	{
+		if ( b.m_nMsgNum == nMsgNum )
+			return b.m_pMsg;
+	}
+	return nullptr;
+}
+
+void SSNPReceiverState::Lane::UnreliableDiscardMessage( int64 nMsgNum )
+{
+	bool bUsedArena = false;
+	m_vecUnreliableFragments.erase(
+		std::remove_if( m_vecUnreliableFragments.begin(), m_vecUnreliableFragments.end(),
+			[nMsgNum, &bUsedArena]( const SSNPRecvUnreliableFragment &f ) {
+				if ( f.m_nMsgNum != nMsgNum )
+					return false;
+				bUsedArena = bUsedArena || f.m_nArenaOffset >= 0;
+				return true;
+			} ),
+		m_vecUnreliableFragments.end() );
+
+	for ( int i = 0 ; i < len( m_vecUnreliableMsgBuffers ) ; ++i )
+	{
+		if ( m_vecUnreliableMsgBuffers[i].m_nMsgNum == nMsgNum )
+		{
+			m_vecUnreliableMsgBuffers[i].m_pMsg->Release();
+			erase_at( m_vecUnreliableMsgBuffers, i );
+			break;
+		}
+	}
+
+	if ( bUsedArena )
+		UnreliableCompactArena();
+}
+
+void SSNPReceiverState::Lane::UnreliableDiscardAll()
+{
+	for ( SSNPRecvUnreliableMsgBuffer &b: m_vecUnreliableMsgBuffers )
+		b.m_pMsg->Release();
+	m_vecUnreliableMsgBuffers.clear();
+	m_vecUnreliableFragments.clear();
+	m_bufUnreliableArena.clear();
+}
+
+void SSNPReceiverState::Lane::UnreliableCompactArena()
+{
+	// Gather up the fragments that are still in the arena.  We must move
+	// them in the order they appear in the arena, so that we never overwrite
+	// anything that hasn't moved yet.
+	vstd::small_vector<SSNPRecvUnreliableFragment *, k_nMaxBufferedUnreliableSegments+1> vecInArena;
+	for ( SSNPRecvUnreliableFragment &f: m_vecUnreliableFragments )
+	{
+		if ( f.m_nArenaOffset >= 0 )
+			vecInArena.push_back( &f );
+	}
+	std::sort( vecInArena.begin(), vecInArena.end(),
+		[]( const SSNPRecvUnreliableFragment *a, const SSNPRecvUnreliableFragment *b ) { return a->m_nArenaOffset < b->m_nArenaOffset; } );
+
+	int cbUsed = 0;
+	for ( SSNPRecvUnreliableFragment *f: vecInArena )
+	{
+		Assert( f->m_nArenaOffset >= cbUsed );
+		if ( f->m_nArenaOffset != cbUsed )
+		{
+			memmove( m_bufUnreliableArena.data() + cbUsed, m_bufUnreliableArena.data() + f->m_nArenaOffset, f->m_cbSize );
+			f->m_nArenaOffset = cbUsed;
+		}
+		cbUsed += f->m_cbSize;
+	}
+	m_bufUnreliableArena.resize( cbUsed );
+}
+
 //-----------------------------------------------------------------------------
 void CSteamNetworkConnectionBase::SNP_InitializeConnection( SteamNetworkingMicroseconds usecNow )
 {
@@ -297,6 +583,193 @@ void CSteamNetworkConnectionBase::SNP_ShutdownConnection()
 }
 
 //-----------------------------------------------------------------------------
+static void GenerateReliableMessageHeader( CSteamNetworkingMessage::ReliableSendInfo_t &reliableInfo, int64 nMsgNumGap, int cbData )
+{
+	byte *hdr = reliableInfo.m_hdr;
+	hdr[0] = 0;
+	byte *hdrEnd = hdr+1;
+	Assert( nMsgNumGap >= 1 );
+	if ( nMsgNumGap > 1 )
+	{
+		hdrEnd = SerializeVarInt( hdrEnd, (uint64)nMsgNumGap );
+		hdr[0] |= 0x40;
+	}
+	if ( cbData < 0x20 )
+	{
+		hdr[0] |= (byte)cbData;
+	}
+	else
+	{
+		hdr[0] |= (byte)( 0x20 | ( cbData & 0x1f ) );
+		hdrEnd = SerializeVarInt( hdrEnd, cbData>>5U );
+	}
+	reliableInfo.m_cbHdr = hdrEnd - hdr;
+}
+
+void CSteamNetworkConnectionBase::SNP_CompressQueuedMessages()
+{
+	// The app may have sent messages while we were connecting, before we knew
+	// whether we could compress them.  None of them can have been sent yet, so
+	// we just rewrite them in place.  The reliable headers and stream positions
+	// need to be redone, since the sizes changed.
+	for ( int idxLane = 0 ; idxLane < len( m_senderState.m_vecLanes ) && idxLane < 32 ; ++idxLane )
+	{
+		if ( !( m_nCompressLanesSend & ( 1u << idxLane ) ) )
+			continue;
+		SSNPSenderState::Lane &lane = m_senderState.m_vecLanes[ idxLane ];
+		if ( !lane.m_messagesQueued.m_pFirst )
+			continue;
+		Assert( lane.m_cbCurrentSendMessageSent == 0 );
+
+		int64 nLastReliableMsgNum = -1;
+		int64 nReliableStreamPos = 0;
+		for ( CSteamNetworkingMessage *pMsg = lane.m_messagesQueued.m_pFirst ; pMsg ; pMsg = pMsg->m_linksSecondaryQueue.m_pNext )
+		{
+			const int cbOld = pMsg->m_cbSize;
+			if ( pMsg->SNPSend_IsReliable() )
+			{
+				CSteamNetworkingMessage::ReliableSendInfo_t &reliableInfo = pMsg->ReliableSendInfo();
+
+				// First one?  Recover where things stood before it was queued
+				if ( nLastReliableMsgNum < 0 )
+				{
+					uint64 nMsgNumGap = 1;
+					if ( reliableInfo.m_hdr[0] & 0x40 )
+						DeserializeVarInt( reliableInfo.m_hdr+1, reliableInfo.m_hdr+reliableInfo.m_cbHdr, nMsgNumGap );
+					nLastReliableMsgNum = pMsg->m_nMessageNumber - (int64)nMsgNumGap;
+					nReliableStreamPos = pMsg->SNPSend_ReliableStreamPos();
+				}
+
+				pMsg->m_cbSize -= reliableInfo.m_cbHdr;
+				const int cbData = SNP_CompressMessage( pMsg, lane );
+				GenerateReliableMessageHeader( reliableInfo, pMsg->m_nMessageNumber - nLastReliableMsgNum, cbData );
+				pMsg->m_cbSize += reliableInfo.m_cbHdr;
+				pMsg->SNPSend_SetReliableStreamPos( nReliableStreamPos );
+				nReliableStreamPos += pMsg->m_cbSize;
+				nLastReliableMsgNum = pMsg->m_nMessageNumber;
+
+				m_senderState.m_cbPendingReliable += pMsg->m_cbSize - cbOld;
+				lane.m_cbPendingReliable += pMsg->m_cbSize - cbOld;
+			}
+			else
+			{
+				SNP_CompressMessage( pMsg, lane );
+				m_senderState.m_cbPendingUnreliable += pMsg->m_cbSize - cbOld;
+				lane.m_cbPendingUnreliable += pMsg->m_cbSize - cbOld;
+			}
+
+			// The queues keep track of the total size
+			m_senderState.m_messagesQueued.m_nMessageSize += pMsg->m_cbSize - cbOld;
+			lane.m_messagesQueued.m_nMessageSize += pMsg->m_cbSize - cbOld;
+		}
+		if ( nLastReliableMsgNum >= 0 )
+		{
+			Assert( nLastReliableMsgNum == lane.m_nLastSendMsgNumReliable );
+			lane.m_nReliableStreamNextSendPos = nReliableStreamPos;
+		}
+	}
+}
+
+int CSteamNetworkConnectionBase::SNP_CompressMessage( CSteamNetworkingMessage *pSendMessage, SSNPSenderState::Lane &lane )
+{
+	const int cbRaw = pSendMessage->m_cbSize;
+	const uint8 *pRaw = (const uint8 *)pSendMessage->m_pData;
+	SteamNetworkingMicroseconds usecStart = SteamNetworkingSockets_GetLocalTimestamp();
+
+	// The compressed version must be smaller than the raw
+	// version, or we just send it raw with the header byte.
+	uint8 *pOut = (uint8 *)malloc( 1 + cbRaw );
+	if ( !pOut )
+		return cbRaw; // Just send it raw.  Something else will probably fail soon
+	int cbOut = 0;
+	if ( cbRaw > 0 )
+	{
+		uint8 *p = SerializeVarInt( pOut+1, (uint32)cbRaw );
+		const int cbHdr = int( p - pOut );
+		if ( cbHdr < cbRaw )
+		{
+			int cbCompressed = LZ4Block_Compress( m_pCompressDictSend ? &m_pCompressDictSend->m_dict : nullptr, pRaw, cbRaw, p, cbRaw - cbHdr );
+			if ( cbCompressed > 0 )
+			{
+				pOut[0] = k_nCompressedMsgHeader_LZ4;
+				cbOut = cbHdr + cbCompressed;
+			}
+		}
+	}
+	if ( cbOut == 0 )
+	{
+		pOut[0] = k_nCompressedMsgHeader_Raw;
+		memcpy( pOut+1, pRaw, cbRaw );
+		cbOut = 1 + cbRaw;
+	}
+
+	// Swap in the new buffer.  We own it, the app doesn't
+	if ( pSendMessage->m_pfnFreeData )
+		(*pSendMessage->m_pfnFreeData)( pSendMessage );
+	pSendMessage->m_pData = pOut;
+	pSendMessage->m_cbSize = cbOut;
+	pSendMessage->m_pfnFreeData = CSteamNetworkingMessage::DefaultFreeData;
+
+	lane.m_cbCompressedIn += cbRaw;
+	lane.m_cbCompressedOut += cbOut;
+	lane.m_usecCompressTime += SteamNetworkingSockets_GetLocalTimestamp() - usecStart;
+	return cbOut;
+}
+
+bool CSteamNetworkConnectionBase::SNP_ReceivedMessageData( const void *pData, int cbData, int idxLane, int64 nMsgNum, int nFlags, SteamNetworkingMicroseconds usecNow )
+{
+	// Not compressed?
+	if ( idxLane >= 32 || !( m_nCompressLanesRecv & ( 1u << idxLane ) ) )
+		return ReceivedMessageData( pData, cbData, idxLane, nMsgNum, nFlags, usecNow );
+
+	const uint8 *p = (const uint8 *)pData;
+	const uint8 *pEnd = p + cbData;
+	if ( cbData < 1 )
+	{
+		ConnectionState_ProblemDetectedLocally( k_ESteamNetConnectionEnd_Misc_InternalError, "Compressed msg %lld on lane %d is empty", (long long)nMsgNum, idxLane );
+		return false;
+	}
+	switch ( *(p++) )
+	{
+		case k_nCompressedMsgHeader_Raw:
+			return ReceivedMessageData( p, int( pEnd - p ), idxLane, nMsgNum, nFlags, usecNow );
+
+		case k_nCompressedMsgHeader_LZ4:
+			break;
+
+		default:
+			ConnectionState_ProblemDetectedLocally( k_ESteamNetConnectionEnd_Misc_InternalError, "Msg %lld on lane %d has invalid compression header 0x%02x", (long long)nMsgNum, idxLane, *(const uint8 *)pData );
+			return false;
+	}
+
+	uint32 cbRaw;
+	p = DeserializeVarInt( p, pEnd, cbRaw );
+	if ( !p )
+	{
+		ConnectionState_ProblemDetectedLocally( k_ESteamNetConnectionEnd_Misc_InternalError, "Compressed msg %lld on lane %d has bad header", (long long)nMsgNum, idxLane );
+		return false;
+	}
+
+	// This checks the size against the limit
+	CSteamNetworkingMessage *pMsg = AllocateNewRecvMessage( cbRaw, nFlags, usecNow );
+	if ( !pMsg )
+		return false;
+	pMsg->m_idxLane = idxLane;
+	pMsg->m_nMessageNumber = nMsgNum;
+
+	SteamNetworkingMicroseconds usecStart = SteamNetworkingSockets_GetLocalTimestamp();
+	int cbDecompressed = LZ4Block_Decompress( m_pCompressDictRecv ? &m_pCompressDictRecv->m_dict : nullptr, p, int( pEnd - p ), pMsg->m_pData, (int)cbRaw );
+	m_receiverState.m_vecLanes[ idxLane ].m_usecDecompressTime += SteamNetworkingSockets_GetLocalTimestamp() - usecStart;
+	if ( cbDecompressed != (int)cbRaw )
+	{
+		pMsg->Release();
+		ConnectionState_ProblemDetectedLocally( k_ESteamNetConnectionEnd_Misc_InternalError, "Compressed msg %lld on lane %d is corrupt", (long long)nMsgNum, idxLane );
+		return false;
+	}
+
+	return ReceivedMessage( pMsg );
+}
+
 int64 CSteamNetworkConnectionBase::SNP_SendMessage( CSteamNetworkingMessage *pSendMessage, SteamNetworkingMicroseconds usecNow, bool *pbThinkImmediately )
 {
 	// Connection must be locked, but we don't require the global lock here!
@@ -316,6 +789,11 @@ int64 CSteamNetworkConnectionBase::SNP_SendMessage( CSteamNetworkingMessage *pSe
 	}
 	SSNPSenderState::Lane &lane = m_senderState.m_vecLanes[ pSendMessage->m_idxLane ];
 
+	// Compress it?  Do this first, since all of the limits below
+	// apply to what we will actually send
+	if ( pSendMessage->m_idxLane < 32 && ( m_nCompressLanesSend & ( 1u << pSendMessage->m_idxLane ) ) )
+		cbData = SNP_CompressMessage( pSendMessage, lane );
+
 	// Check if we're full
 	if ( m_senderState.PendingBytesTotal() + cbData > m_connectionConfig.SendBufferSize.Get() )
 	{
@@ -363,26 +841,7 @@ int64 CSteamNetworkConnectionBase::SNP_SendMessage( CSteamNetworkingMessage *pSe
 
 		// Generate the header
 		CSteamNetworkingMessage::ReliableSendInfo_t &reliableInfo = pSendMessage->ReliableSendInfo();
-		byte *hdr = reliableInfo.m_hdr;
-		hdr[0] = 0;
-		byte *hdrEnd = hdr+1;
-		int64 nMsgNumGap = pSendMessage->m_nMessageNumber - lane.m_nLastSendMsgNumReliable;
-		Assert( nMsgNumGap >= 1 );
-		if ( nMsgNumGap > 1 )
-		{
-			hdrEnd = SerializeVarInt( hdrEnd, (uint64)nMsgNumGap );
-			hdr[0] |= 0x40;
-		}
-		if ( cbData < 0x20 )
-		{
-			hdr[0] |= (byte)cbData;
-		}
-		else
-		{
-			hdr[0] |= (byte)( 0x20 | ( cbData & 0x1f ) );
-			hdrEnd = SerializeVarInt( hdrEnd, cbData>>5U );
-		}
-		reliableInfo.m_cbHdr = hdrEnd - hdr;
+		GenerateReliableMessageHeader( reliableInfo, pSendMessage->m_nMessageNumber - lane.m_nLastSendMsgNumReliable, cbData );
 		reliableInfo.m_nSentReliableSegRefCount = 1; // Initialize reference count to 1.
 
 		// Grow the total size of the message by the header
@@ -405,6 +864,25 @@ int64 CSteamNetworkConnectionBase::SNP_SendMessage( CSteamNetworkingMessage *pSe
 	}
 	else
 	{
+		// Replace the older message with the same key, unless we've
+		// already started sending it.  There can only be one, since
+		// we check each time a message is queued.
+		if ( pSendMessage->m_nCoalesceKey != 0 )
+		{
+			for ( CSteamNetworkingMessage *pMsg = lane.m_messagesQueued.m_pLast ; pMsg ; pMsg = pMsg->m_linksSecondaryQueue.m_pPrev )
+			{
+				if ( pMsg->m_nCoalesceKey != pSendMessage->m_nCoalesceKey || pMsg->SNPSend_IsReliable() )
+					continue;
+				if ( pMsg == lane.m_messagesQueued.m_pFirst && lane.m_cbCurrentSendMessageSent > 0 )
+					break;
+				SpewVerboseGroup( m_connectionConfig.LogLevel_Message.Get(), "[%s] Unreliable MsgNum=%lld replaced by newer message with same coalesce key\n",
+					GetDescription(), (long long)pMsg->m_nMessageNumber );
+				m_senderState.RemoveQueuedUnreliableMessage( pMsg );
+				++lane.m_nUnreliableCoalesced;
+				break;
+			}
+		}
+
 		++m_senderState.m_nMessagesSentUnreliable;
 		Assert( m_senderState.m_cbPendingUnreliable >= lane.m_cbPendingUnreliable );
 		m_senderState.m_cbPendingUnreliable += pSendMessage->m_cbSize;
@@ -413,10 +891,10 @@ int64 CSteamNetworkConnectionBase::SNP_SendMessage( CSteamNetworkingMessage *pSe
 		Assert( !pSendMessage->SNPSend_IsReliable() );
 	}
 
-	// Use Nagle?
+	// Use Nagle?  Not if the lane has a deadline.
 	// NOTE: If the configuration value is changing, the assumption that Nagle times are
 	// increasing might be violated.  Probably not worth fixing.
-	if ( pSendMessage->m_nFlags & k_nSteamNetworkingSend_NoNagle )
+	if ( ( pSendMessage->m_nFlags & k_nSteamNetworkingSend_NoNagle ) || lane.m_usecLatencyTarget > 0 )
 	{
 		m_senderState.ClearNagleTimers();
 		pSendMessage->SNPSend_SetUsecNagle( 0 );
@@ -438,20 +916,30 @@ int64 CSteamNetworkConnectionBase::SNP_SendMessage( CSteamNetworkingMessage *pSe
 	// Was lane previously idle?
 	CSteamNetworkingMessage *pLastMsg = lane.m_messagesQueued.m_pLast;
 	pSendMessage->LinkToQueueTail(&CSteamNetworkingMessage::m_linksSecondaryQueue, &lane.m_messagesQueued );
-	VirtualSendTime virtTimeMsg = (VirtualSendTime)( (float)pSendMessage->m_cbSize * lane.m_flBytesToVirtualTime );
-	if ( pLastMsg )
+	if ( lane.m_usecLatencyTarget > 0 )
 	{
-		virtTimeMsg += pLastMsg->SNPSend_VirtualFinishTime();
+		pSendMessage->SNPSend_SetUsecDeadline( usecNow + lane.m_usecLatencyTarget );
 	}
 	else
 	{
-		virtTimeMsg += m_senderState.m_vecPriorityClasses[ lane.m_idxPriorityClass ].m_virtTimeCurrent;
+		VirtualSendTime virtTimeMsg = (VirtualSendTime)( (float)pSendMessage->m_cbSize * lane.m_flBytesToVirtualTime );
+		if ( pLastMsg )
+		{
+			virtTimeMsg += pLastMsg->SNPSend_VirtualFinishTime();
+		}
+		else
+		{
+			virtTimeMsg += m_senderState.m_vecPriorityClasses[ lane.m_idxPriorityClass ].m_virtTimeCurrent;
+		}
+		pSendMessage->SNPSend_SetVirtualFinishTime( virtTimeMsg );
 	}
-	pSendMessage->SNPSend_SetVirtualFinishTime( virtTimeMsg );
 
 	if ( pSendMessage->m_nFlags & k_nSteamNetworkingSend_Reliable )
 		m_senderState.MaybeCheckReliable();
 
+	// If we were idle, we aren't anymore
+	SNP_UpdateSendLimitState( usecNow );
+
 	// Save the message number.  The code below might end up deleting the message we just queued
 	int64 result = pSendMessage->m_nMessageNumber;
 
@@ -626,10 +1114,13 @@ EResult CSteamNetworkConnectionBase::SNP_ConfigureLanes( int nLanes, const int *
 		if ( pMsg )
 		{
 
-			// (Re)calculate virtual finish time
+			// (Re)calculate virtual finish time.  (Unless the lane has a
+			// latency target, then we're storing the deadline there.)
+			const bool bWFQ = l.m_usecLatencyTarget == 0;
 			const int cbRemaininInThisMessage = pMsg->GetSize() - l.m_cbCurrentSendMessageSent;
 			virtTime += (VirtualSendTime)( l.m_flBytesToVirtualTime * cbRemaininInThisMessage );
-			pMsg->SNPSend_SetVirtualFinishTime( virtTime );
+			if ( bWFQ )
+				pMsg->SNPSend_SetVirtualFinishTime( virtTime );
 
 			// Iterate queued messages and fixup
 			void *const pCheckQueue = pMsg->m_linksSecondaryQueue.m_pQueue;
@@ -649,7 +1140,8 @@ EResult CSteamNetworkConnectionBase::SNP_ConfigureLanes( int nLanes, const int *
 
 				// Advance estimated virtual finish time
 				virtTime += (VirtualSendTime)( l.m_flBytesToVirtualTime * pMsg->m_cbSize );
-				pMsg->SNPSend_SetVirtualFinishTime( virtTime );
+				if ( bWFQ )
+					pMsg->SNPSend_SetVirtualFinishTime( virtTime );
 			}
 		}
 
@@ -657,6 +1149,59 @@ EResult CSteamNetworkConnectionBase::SNP_ConfigureLanes( int nLanes, const int *
 	return k_EResultOK;
 }
 
+EResult CSteamNetworkConnectionBase::SNP_ConfigureLaneDeadlines( int nLanes, const int *pLaneLatencyTargetsMS, SteamNetworkingMicroseconds usecNow )
+{
+	// Connection must be locked, but we don't require the global lock here
+	m_pLock->AssertHeldByCurrentThread();
+
+	// Must be one value for each configured lane
+	if ( nLanes != len( m_senderState.m_vecLanes ) || !pLaneLatencyTargetsMS )
+		return k_EResultInvalidParam;
+	for ( int idxLane = 0 ; idxLane < nLanes ; ++idxLane )
+	{
+		if ( pLaneLatencyTargetsMS[idxLane] < 0 || pLaneLatencyTargetsMS[idxLane] > k_nMaxLaneLatencyTargetMS )
+			return k_EResultInvalidParam;
+	}
+
+	m_senderState.m_bAnyLaneDeadlines = false;
+	for ( int idxLane = 0 ; idxLane < nLanes ; ++idxLane )
+	{
+		SSNPSenderState::Lane &l = m_senderState.m_vecLanes[idxLane];
+		const SteamNetworkingMicroseconds usecTarget = pLaneLatencyTargetsMS[idxLane] * 1000;
+		if ( usecTarget > 0 )
+			m_senderState.m_bAnyLaneDeadlines = true;
+		if ( usecTarget == l.m_usecLatencyTarget )
+			continue;
+		l.m_usecLatencyTarget = usecTarget;
+
+		// Reschedule anything already queued
+		CSteamNetworkingMessage *pMsg = l.m_messagesQueued.m_pFirst;
+		if ( !pMsg )
+			continue;
+		if ( usecTarget > 0 )
+		{
+			// We don't know when they were queued, so just
+			// act like it was right now.
+			for ( ; pMsg ; pMsg = pMsg->m_linksSecondaryQueue.m_pNext )
+				pMsg->SNPSend_SetUsecDeadline( usecNow + usecTarget );
+		}
+		else
+		{
+			// Back to fair queuing.  Same as SNP_ConfigureLanes
+			VirtualSendTime virtTime = m_senderState.m_vecPriorityClasses[ l.m_idxPriorityClass ].m_virtTimeCurrent;
+			int cbRemaining = pMsg->GetSize() - l.m_cbCurrentSendMessageSent;
+			for ( ; pMsg ; pMsg = pMsg->m_linksSecondaryQueue.m_pNext )
+			{
+				virtTime += (VirtualSendTime)( l.m_flBytesToVirtualTime * cbRemaining );
+				pMsg->SNPSend_SetVirtualFinishTime( virtTime );
+				if ( pMsg->m_linksSecondaryQueue.m_pNext )
+					cbRemaining = pMsg->m_linksSecondaryQueue.m_pNext->m_cbSize;
+			}
+		}
+	}
+	return k_EResultOK;
+}
+
 EResult CSteamNetworkConnectionBase::SNP_FlushMessage( SteamNetworkingMicroseconds usecNow )
 {
 	// Connection must be locked, but we don't require the global lock here!
@@ -777,6 +1322,12 @@ bool CSteamNetworkConnectionBase::ProcessPlainTextDataChunk( int usecTimeSinceLa
 	const int nLogLevelPacketDecode = m_connectionConfig.LogLevel_PacketDecode.Get();
 	SpewVerboseGroup( nLogLevelPacketDecode, "[%s] decode pkt %lld\n", GetDescription(), (long long)nPktNum );
 
+	// Summary of what we decoded, for the packet trace
+	int nUnreliableSegments = 0;
+	int nReliableSegments = 0;
+	int nAckBlocks = -1;
+	int64 nAckLatestPktNum = 0;
+
 	// Decode frames until we get to the end of the payload
 	const byte *pDecode = (const byte *)ctx.m_pPlainText;
 	const byte *pEnd = pDecode + ctx.m_cbPlainText;
@@ -869,6 +1420,7 @@ bool CSteamNetworkConnectionBase::ProcessPlainTextDataChunk( int usecTimeSinceLa
 			}
 			else
 			{
+				++nUnreliableSegments;
 
 				// Receive the segment
 				bool bLastSegmentInMessage = ( nFrameType & 0x20 ) != 0;
@@ -953,6 +1505,7 @@ bool CSteamNetworkConnectionBase::ProcessPlainTextDataChunk( int usecTimeSinceLa
 			READ_SEGMENT_DATA_SIZE( reliable )
 
 			// Ingest the segment.
+			++nReliableSegments;
 			if ( !SNP_ReceiveReliableSegment( nPktNum, nDecodeReliablePos, pSegmentData, cbSegmentSize, idxCurrentLane, usecNow ) )
 			{
 				if ( !BStateIsActive() )
@@ -1099,12 +1652,13 @@ bool CSteamNetworkConnectionBase::ProcessPlainTextDataChunk( int usecTimeSinceLa
 
 			SNP_DebugCheckPacketGapMap();
 		}
-		else if ( ( nFrameType & 0xf0 ) == 0x90 )
+		else if ( ( nFrameType & 0xf0 ) == 0x90 || ( nFrameType & 0xf0 ) == 0xb0 )
 		{
 
 			//
-			// Ack
+			// Ack, regular (1001wnnn) or packed (1011wdnn)
 			//
+			const bool bPacked = ( nFrameType & 0x20 ) != 0;
 
 			#if STEAMNETWORKINGSOCKETS_SNP_PARANOIA > 0
 				#if STEAMNETWORKINGSOCKETS_SNP_PARANOIA == 1
@@ -1186,7 +1740,16 @@ bool CSteamNetworkConnectionBase::ProcessPlainTextDataChunk( int usecTimeSinceLa
 			// Parse out delay, and process the ping
 			{
 				uint16 nPackedDelay;
-				READ_16BITU( nPackedDelay, "ack delay" );
+				if ( bPacked && !( nFrameType & 0x04 ) )
+				{
+					uint8 nPackedDelay8;
+					READ_8BITU( nPackedDelay8, "ack delay" );
+					nPackedDelay = SNPAckSerializerHelper::UnpackTimeSince( nPackedDelay8 );
+				}
+				else
+				{
+					READ_16BITU( nPackedDelay, "ack delay" );
+				}
 				if ( nPackedDelay != 0xffff && inFlightPkt->first == nLatestRecvSeqNum && inFlightPkt->second.m_pTransport == ctx.m_pTransport )
 				{
 					SteamNetworkingMicroseconds usecDelay = SteamNetworkingMicroseconds( nPackedDelay ) << k_nAckDelayPrecisionShift;
@@ -1223,6 +1786,9 @@ bool CSteamNetworkConnectionBase::ProcessPlainTextDataChunk( int usecTimeSinceLa
 							msPing = 0;
 						ProcessSNPPing( msPing, ctx );
 
+						m_senderState.m_usecPeerAckDelayLast = usecDelay;
+						m_senderState.m_usecPeerAckDelayMax = std::max( m_senderState.m_usecPeerAckDelayMax, usecDelay );
+
 						// Spew
 						SpewVerboseGroup( m_connectionConfig.LogLevel_AckRTT.Get(), "[%s] decode pkt %lld latest recv %lld delay %.1fms elapsed %.1fms ping %dms\n",
 							GetDescription(),
@@ -1236,9 +1802,11 @@ bool CSteamNetworkConnectionBase::ProcessPlainTextDataChunk( int usecTimeSinceLa
 			}
 
 			// Parse number of blocks
-			int nBlocks = nFrameType&7;
-			if ( nBlocks == 7 )
+			int nBlocks = bPacked ? ( nFrameType&3 ) : ( nFrameType&7 );
+			if ( nBlocks == ( bPacked ? 3 : 7 ) )
 				READ_8BITU( nBlocks, "ack num blocks" );
+			nAckBlocks = nBlocks;
+			nAckLatestPktNum = nLatestRecvSeqNum;
 
 			// If they actually sent us any blocks, that means they are fragmented.
 			// We should make sure and tell them to stop sending us these nacks
@@ -1283,30 +1851,57 @@ bool CSteamNetworkConnectionBase::ProcessPlainTextDataChunk( int usecTimeSinceLa
 					uint8 nBlockHeader;
 					READ_8BITU( nBlockHeader, "ack block header" );
 
-					// Ack count?
-					int64 numAcks = ( nBlockHeader>> 4 ) & 7;
-					if ( nBlockHeader & 0x80 )
+					int64 numAcks, numNacks;
+					if ( bPacked )
+					{
+						// aaaaaann.  All ones means more follows, var-int encoded.
+						numAcks = nBlockHeader >> 2;
+						if ( numAcks == 63 )
+						{
+							uint64 nExtra;
+							READ_VARINT( nExtra, "ack count extra" );
+							if ( nExtra > 800000 )
+								DECODE_ERROR( "Ack count of 63+%llu is crazy", (unsigned long long)nExtra );
+							numAcks += nExtra;
+						}
+						numNacks = nBlockHeader & 3;
+						if ( numNacks == 3 )
+						{
+							uint64 nExtra;
+							READ_VARINT( nExtra, "nack count extra" );
+							if ( nExtra > 800000 )
+								DECODE_ERROR( "Nack count of 3+%llu is crazy", (unsigned long long)nExtra );
+							numNacks += nExtra;
+						}
+					}
+					else
 					{
-						uint64 nUpperBits;
-						READ_VARINT( nUpperBits, "ack count upper bits" );
-						if ( nUpperBits > 100000 )
-							DECODE_ERROR( "Ack count of %llu<<3 is crazy", (unsigned long long)nUpperBits );
-						numAcks |= nUpperBits<<3;
+						// Ack count?
+						numAcks = ( nBlockHeader>> 4 ) & 7;
+						if ( nBlockHeader & 0x80 )
+						{
+							uint64 nUpperBits;
+							READ_VARINT( nUpperBits, "ack count upper bits" );
+							if ( nUpperBits > 100000 )
+								DECODE_ERROR( "Ack count of %llu<<3 is crazy", (unsigned long long)nUpperBits );
+							numAcks |= nUpperBits<<3;
+						}
+
+						// Extended nack count?
+						numNacks = nBlockHeader & 7;
+						if ( nBlockHeader & 0x08)
+						{
+							uint64 nUpperBits;
+							READ_VARINT( nUpperBits, "nack count upper bits" );
+							if ( nUpperBits > 100000 )
+								DECODE_ERROR( "Nack count of %llu<<3 is crazy", nUpperBits );
+							numNacks |= nUpperBits<<3;
+						}
 					}
 					nPktNumAckBegin = nPktNumAckEnd - numAcks;
 					if ( nPktNumAckBegin < 0 )
 						DECODE_ERROR( "Ack range underflow, end=%lld, num=%lld", (long long)nPktNumAckEnd, (long long)numAcks );
 
-					// Extended nack count?
-					int64 numNacks = nBlockHeader & 7;
-					if ( nBlockHeader & 0x08)
-					{
-						uint64 nUpperBits;
-						READ_VARINT( nUpperBits, "nack count upper bits" );
-						if ( nUpperBits > 100000 )
-							DECODE_ERROR( "Nack count of %llu<<3 is crazy", nUpperBits );
-						numNacks |= nUpperBits<<3;
-					}
 					nPktNumNackBegin = nPktNumAckBegin - numNacks;
 					if ( nPktNumNackBegin < 0 )
 						DECODE_ERROR( "Nack range underflow, end=%lld, num=%lld", (long long)nPktNumAckBegin, (long long)numAcks );
@@ -1363,6 +1958,33 @@ bool CSteamNetworkConnectionBase::ProcessPlainTextDataChunk( int usecTimeSinceLa
 						m_senderState.RemoveRefCountReliableSegment( hSeg );
 					}
 
+					// Remember the most recently sent packet that was delivered,
+					// for time-based loss detection
+					if ( inFlightPkt->second.m_usecWhenSent >= m_senderState.m_usecRACKSent )
+					{
+						m_senderState.m_usecRACKSent = inFlightPkt->second.m_usecWhenSent;
+						m_senderState.m_usecRACKRTT = usecNow - inFlightPkt->second.m_usecWhenSent;
+					}
+					m_senderState.m_bTailLossProbePending = false;
+
+					// Peer has our latest ack frequency request?
+					if ( inFlightPkt->first == m_senderState.m_nAckFrequencyPktNum )
+						m_senderState.m_nAckFrequencyPktNum = 0;
+
+					// Unreliable messages in this packet that wanted a receipt
+					if ( !inFlightPkt->second.m_vecDeliveryReceipts.empty() )
+						m_senderState.ResolveDeliveryReceipts( inFlightPkt->second, true );
+
+					// Peer has seen these unreliable message numbers
+					for ( const SNPInFlightPacket_t::DeliveryReceiptRef &ref: inFlightPkt->second.m_vecCompactMsgNums )
+					{
+						if ( ref.m_idxLane < len( m_senderState.m_vecLanes ) )
+						{
+							int64 &nLowerBound = m_senderState.m_vecLanes[ ref.m_idxLane ].m_nPeerHighestSeenMsgNumLowerBound;
+							nLowerBound = std::max( nLowerBound, ref.m_nMsgNum );
+						}
+					}
+
 					// Check if this was the next packet we were going to timeout, then advance
 					// pointer.  This guy didn't timeout.
 					if ( inFlightPkt == m_senderState.m_itNextInFlightPacketToTimeout )
@@ -1384,7 +2006,8 @@ bool CSteamNetworkConnectionBase::ProcessPlainTextDataChunk( int usecTimeSinceLa
 				while ( inFlightPkt->first >= nPktNumNackBegin )
 				{
 					Assert( inFlightPkt->first < nPktNumAckEnd );
-					SNP_SenderProcessPacketNack( inFlightPkt->first, inFlightPkt->second, "NACK" );
+					if ( SNP_SenderProcessPacketNack( inFlightPkt->first, inFlightPkt->second, "NACK" ) )
+						++m_senderState.m_nPacketsLostNack;
 
 					// We'll keep the record on hand, though, in case an ACK comes in
 					--inFlightPkt;
@@ -1458,6 +2081,213 @@ bool CSteamNetworkConnectionBase::ProcessPlainTextDataChunk( int usecTimeSinceLa
 			nCurMsgNumForUnreliable = 0;
 			nDecodeReliablePos = 0;
 		}
+		else if ( nFrameType == 0xa0 )
+		{
+
+			//
+			// Unreliable FEC parity.  This names its own lane, and
+			// doesn't change the context for segment decode
+			//
+
+			unsigned nLane;
+			READ_VARINT( nLane, "FEC lane" );
+			if ( nLane > STEAMNETWORKINGSOCKETS_MAX_LANES )
+			{
+				DECODE_ERROR( "Sender sent FEC for invalid lane %d; max is %d", nLane, STEAMNETWORKINGSOCKETS_MAX_LANES );
+			}
+			if ( nLane >= m_receiverState.m_vecLanes.size() )
+				m_receiverState.m_vecLanes.resize( nLane+1 );
+			pCurrentLane = &m_receiverState.m_vecLanes[idxCurrentLane]; // In case the resize moved it
+
+			int64 arMsgNum[ k_nMaxFECGroupSize ];
+			int arMsgSize[ k_nMaxFECGroupSize ];
+			int nMessages;
+			uint32 nMsgNumLowerBits;
+			READ_32BITU( nMsgNumLowerBits, "FEC msgnum" );
+			READ_8BITU( nMessages, "FEC message count" );
+			if ( nMessages < 1 || nMessages > k_nMaxFECGroupSize )
+			{
+				DECODE_ERROR( "Invalid FEC message count %d", nMessages );
+			}
+			int64 nMsgNum = NearestWithSameLowerBits( (int32)nMsgNumLowerBits, m_receiverState.m_vecLanes[nLane].m_nHighestSeenMsgNum );
+			int cbParity = 0;
+			for ( int i = 0 ; i < nMessages ; ++i )
+			{
+				if ( i > 0 )
+				{
+					uint64 nMsgNumOffset;
+					READ_VARINT( nMsgNumOffset, "FEC msgnum offset" );
+					if ( nMsgNumOffset < 1 || nMsgNumOffset > 0x10000 )
+					{
+						DECODE_ERROR( "Invalid FEC msgnum offset %llu", (unsigned long long)nMsgNumOffset );
+					}
+					nMsgNum += nMsgNumOffset;
+				}
+				uint32 cbMsg;
+				READ_VARINT( cbMsg, "FEC message size" );
+				if ( cbMsg > (uint32)k_cbMaxFECMessageSize )
+				{
+					DECODE_ERROR( "Invalid FEC message size %u", cbMsg );
+				}
+				arMsgNum[i] = nMsgNum;
+				arMsgSize[i] = (int)cbMsg;
+				cbParity = std::max( cbParity, (int)cbMsg );
+			}
+			EXPECT_BYTES( cbParity, "FEC parity" );
+			const uint8 *pParity = pDecode;
+			pDecode += cbParity;
+
+			SNP_ReceiveFECParity( nLane, nMessages, arMsgNum, arMsgSize, pParity, cbParity, usecNow );
+		}
+		else if ( nFrameType == 0xa1 )
+		{
+
+			//
+			// Ack frequency.  Peer is telling us how long we may hold
+			// on to acks for reliable data.
+			//
+
+			uint64 nSeq;
+			uint32 nThreshold, usecMaxAckDelay;
+			READ_VARINT( nSeq, "ack freq seq" );
+			READ_VARINT( nThreshold, "ack freq threshold" );
+			READ_VARINT( usecMaxAckDelay, "ack freq max delay" );
+			if ( nThreshold > 0x10000 )
+			{
+				DECODE_ERROR( "Invalid ack frequency threshold %u", nThreshold );
+			}
+			if ( usecMaxAckDelay < 1000 || usecMaxAckDelay > (uint32)k_usecMaxAckFrequencyDelay )
+			{
+				DECODE_ERROR( "Invalid ack frequency max delay %uusec", usecMaxAckDelay );
+			}
+
+			// Ignore stale requests that were reordered
+			if ( nSeq > m_receiverState.m_nAckFrequencySeq )
+			{
+				SpewVerboseGroup( nLogLevelPacketDecode, "[%s]   decode pkt %lld ack freq #%llu threshold %u max delay %uusec\n",
+					GetDescription(), (long long)nPktNum, (unsigned long long)nSeq, nThreshold, usecMaxAckDelay );
+				m_receiverState.m_nAckFrequencySeq = nSeq;
+				m_receiverState.m_nAckThreshold = (int)nThreshold;
+				m_receiverState.m_usecMaxAckDelay = usecMaxAckDelay;
+			}
+		}
+		else if ( ( nFrameType & 0xc0 ) == 0xc0 )
+		{
+
+			//
+			// Compact unreliable message.  (Always an entire message)
+			//
+
+			// Implicit lane select?
+			unsigned nLaneSelect = ( nFrameType >> 2 ) & 0xf;
+			if ( nLaneSelect > 0 )
+			{
+				unsigned nLane = nLaneSelect-1;
+				if ( nLane >= STEAMNETWORKINGSOCKETS_MAX_LANES )
+				{
+					DECODE_ERROR( "Sender tried to send on invalid lane %d; max is %d", nLane, STEAMNETWORKINGSOCKETS_MAX_LANES );
+				}
+				if ( nLane >= m_receiverState.m_vecLanes.size() )
+					m_receiverState.m_vecLanes.resize( nLane+1 );
+
+				// Select the lane, and reset context, just like a select lane frame
+				idxCurrentLane = nLane;
+				pCurrentLane = &m_receiverState.m_vecLanes[idxCurrentLane];
+				nCurMsgNumForUnreliable = 0;
+				nDecodeReliablePos = 0;
+			}
+
+			// Decode message number
+			if ( nCurMsgNumForUnreliable == 0 )
+			{
+				// First unreliable frame.  Only bottom N bits are sent
+				static const char szCompactMsgNum[] = "compact unreliable msgnum";
+				int64 nLowerBits, nMask;
+				if ( nFrameType & 0x02 )
+				{
+					READ_16BITU( nLowerBits, szCompactMsgNum );
+					nMask = 0xffff;
+					nCurMsgNumForUnreliable = NearestWithSameLowerBits( (int16)nLowerBits, pCurrentLane->m_nHighestSeenMsgNum );
+				}
+				else
+				{
+					READ_8BITU( nLowerBits, szCompactMsgNum );
+					nMask = 0xff;
+					nCurMsgNumForUnreliable = NearestWithSameLowerBits( (int8)nLowerBits, pCurrentLane->m_nHighestSeenMsgNum );
+				}
+				Assert( ( nCurMsgNumForUnreliable & nMask ) == nLowerBits );
+
+				if ( nCurMsgNumForUnreliable <= 0 )
+				{
+					DECODE_ERROR( "SNP decode compact unreliable msgnum underflow.  %llx mod %llx, highest seen %llx",
+						(unsigned long long)nLowerBits, (unsigned long long)( nMask+1 ), (unsigned long long)pCurrentLane->m_nHighestSeenMsgNum );
+				}
+				if ( std::abs( nCurMsgNumForUnreliable - pCurrentLane->m_nHighestSeenMsgNum ) > (nMask>>2) )
+				{
+					SpewWarningRateLimited( usecNow, "Sender sent compact unreliable message number using %llx mod %llx, highest seen %llx\n",
+						(unsigned long long)nLowerBits, (unsigned long long)( nMask+1 ), (unsigned long long)pCurrentLane->m_nHighestSeenMsgNum );
+				}
+			}
+			else
+			{
+				if ( nFrameType & 0x02 )
+				{
+					uint64 nMsgNumOffset;
+					READ_VARINT( nMsgNumOffset, "compact unreliable msgnum offset" );
+					nCurMsgNumForUnreliable += nMsgNumOffset;
+				}
+				else
+				{
+					++nCurMsgNumForUnreliable;
+				}
+			}
+			if ( nCurMsgNumForUnreliable > pCurrentLane->m_nHighestSeenMsgNum )
+				pCurrentLane->m_nHighestSeenMsgNum = nCurMsgNumForUnreliable;
+
+			// Check per-packet segment limit
+			if ( unlikely( nSegmentLimitRemaining <= 0 ) )
+			{
+				SpewWarningRateLimited( ctx.m_usecNow, "[%s] too many segments, aborting packert decode\n", GetDescription() );
+				bInhibitMarkReceived = true;
+				break;
+			}
+			--nSegmentLimitRemaining;
+
+			// Explicit size, or extends to the end of the packet?
+			int cbSegmentSize;
+			if ( nFrameType & 0x01 )
+			{
+				READ_8BITU( cbSegmentSize, "compact unreliable size" );
+				if ( pDecode + cbSegmentSize > pEnd )
+				{
+					DECODE_ERROR( "SNP decode overrun %d bytes for compact unreliable segment data.", cbSegmentSize );
+				}
+			}
+			else
+			{
+				cbSegmentSize = pEnd - pDecode;
+			}
+			const uint8 *pSegmentData = pDecode;
+			pDecode += cbSegmentSize;
+
+			if ( cbSegmentSize > k_cbMaxUnreliableSegmentSizeRecv )
+			{
+				SpewWarningRateLimited( usecNow, "[%s] Ignoring compact unreliable segment with invalid size %d\n",
+					GetDescription(), cbSegmentSize );
+			}
+			else
+			{
+				++nUnreliableSegments;
+				if ( !SNP_ReceiveUnreliableSegment( nCurMsgNumForUnreliable, 0, pSegmentData, cbSegmentSize, true, idxCurrentLane, usecNow ) )
+				{
+					if ( !BStateIsActive() )
+						return false; // we decided to nuke the connection - abort packet processing
+
+					// Same as a regular unreliable segment, see above
+					bInhibitMarkReceived = true;
+				}
+			}
+		}
 		else
 		{
 			DECODE_ERROR( "Invalid SNP frame lead byte 0x%02x", nFrameType );
@@ -1504,6 +2334,26 @@ bool CSteamNetworkConnectionBase::ProcessPlainTextDataChunk( int usecTimeSinceLa
 		SNP_RecordReceivedPktNum( nPktNum, usecNow, bScheduleAck );
 	}
 
+	#ifdef STEAMNETWORKINGSOCKETS_ENABLE_SNPTRACE
+		if ( unlikely( g_pSNPTraceHeader ) )
+		{
+			uint8 nFlags = 0;
+			if ( m_eNegotiatedCipher != k_ESteamNetworkingSocketsCipher_NULL )
+				nFlags |= k_nSNPTraceFlag_Encrypted;
+			if ( nAckBlocks >= 0 )
+				nFlags |= k_nSNPTraceFlag_Ack;
+			if ( bInhibitMarkReceived )
+				nFlags |= k_nSNPTraceFlag_RecvInhibitAck;
+			SNP_TracePacket( k_ESNPTraceDirection_Recv, nPktNum, ctx.m_cbPacketSize, ctx.m_cbPlainText,
+				nReliableSegments, nUnreliableSegments, std::max( 0, nAckBlocks ), nAckLatestPktNum, nFlags, usecNow );
+		}
+	#endif
+
+	// If the peer acked anything, we might have reliable data to retransmit, or our
+	// loss detection timers might have changed.  Make sure we wake up when needed.
+	if ( nAckBlocks >= 0 && BStateIsConnectedForWirePurposes() )
+		EnsureMinThinkTime( SNP_GetNextThinkTime( usecNow ) );
+
 	// Packet can be processed further
 	return true;
 
@@ -1519,12 +2369,38 @@ bool CSteamNetworkConnectionBase::ProcessPlainTextDataChunk( int usecTimeSinceLa
 	#undef READ_SEGMENT_DATA_SIZE
 }
 
-void CSteamNetworkConnectionBase::SNP_SenderProcessPacketNack( int64 nPktNum, SNPInFlightPacket_t &pkt, const char *pszDebug )
+#ifdef STEAMNETWORKINGSOCKETS_ENABLE_SNPTRACE
+void CSteamNetworkConnectionBase::SNP_TracePacket( ESNPTraceDirection eDirection, int64 nPktNum, int cbWire, int cbPlainText,
+	int nReliableSegments, int nUnreliableSegments, int nAckBlocks, int64 nAckLatestPktNum, uint8 nFlags,
+	SteamNetworkingMicroseconds usecNow )
+{
+	SNPTraceRecord_t *pRec = SNPTrace_AllocRecord();
+	pRec->m_usecTime = usecNow;
+	pRec->m_nPktNum = nPktNum;
+	pRec->m_nAckLatestPktNum = nAckLatestPktNum;
+	pRec->m_unConnectionID = m_unConnectionIDLocal;
+	pRec->m_cbWire = (uint16)std::min( cbWire, 0xffff );
+	pRec->m_cbPlainText = (uint16)std::min( cbPlainText, 0xffff );
+	pRec->m_nFlags = nFlags;
+	pRec->m_nReliableSegments = (uint8)std::min( nReliableSegments, 0xff );
+	pRec->m_nUnreliableSegments = (uint8)std::min( nUnreliableSegments, 0xff );
+	pRec->m_nAckBlocks = (uint8)std::min( nAckBlocks, 0xff );
+	pRec->m_flTokenBucket = m_sendRateData.m_flTokenBucket;
+	pRec->m_nSendRate = (int32)m_sendRateData.m_flCurrentSendRateUsed;
+	pRec->m_cbPendingReliable = m_senderState.m_cbPendingReliable;
+	pRec->m_cbPendingUnreliable = m_senderState.m_cbPendingUnreliable;
+	pRec->m_cbSentUnackedReliable = m_senderState.m_cbSentUnackedReliable;
+	pRec->m_nPingMS = m_statsEndToEnd.m_ping.m_nSmoothedPing;
+	pRec->m_eDirection = (uint8)eDirection;
+}
+#endif
+
+bool CSteamNetworkConnectionBase::SNP_SenderProcessPacketNack( int64 nPktNum, SNPInFlightPacket_t &pkt, const char *pszDebug )
 {
 
 	// Did we already treat the packet as dropped (implicitly or explicitly)?
 	if ( pkt.m_bNack )
-		return;
+		return false;
 
 	// Mark as dropped
 	pkt.m_bNack = true;
@@ -1533,13 +2409,19 @@ void CSteamNetworkConnectionBase::SNP_SenderProcessPacketNack( int64 nPktNum, SN
 	if ( m_statsEndToEnd.m_pktNumInFlight == nPktNum )
 		m_statsEndToEnd.InFlightPktTimeout();
 
+	// Report unreliable messages that wanted a receipt as lost.  If an
+	// ack arrives later, it's too late, we've already told the app.
+	if ( !pkt.m_vecDeliveryReceipts.empty() )
+		m_senderState.ResolveDeliveryReceipts( pkt, false );
+
 	if ( pkt.m_vecReliableSegments.empty() )
-		return;
+		return true;
 
 	m_senderState.MaybeCheckReliable();
 
 	// Schedule any reliable segments for retry
 	SNP_QueueReliableSegmentsForRetry( pkt, nPktNum, pszDebug );
+	return true;
 }
 
 void CSteamNetworkConnectionBase::SNP_QueueReliableSegmentsForRetry( SNPInFlightPacket_t &pkt, int64 nPktNumForDebug, const char *pszDebug )
@@ -1616,17 +2498,32 @@ SteamNetworkingMicroseconds CSteamNetworkConnectionBase::SNP_SenderCheckInFlight
 	// Process retry timeout.  Here we use a shorter timeout to trigger retry
 	// than we do to totally forgot about the packet, in case an ack comes in late,
 	// we can take advantage of it.
-	SteamNetworkingMicroseconds usecRTO = m_statsEndToEnd.CalcSenderRetryTimeout();
+	//
+	// If a packet sent after this one has already been acked, then we
+	// don't need to wait for the full RTO.  This one should have been acked
+	// by now too, so just allow a bit of extra time in case of reordering.
+	// Packets are in the map in the order we sent them, so both deadlines
+	// only increase as we walk the list.
+	SteamNetworkingMicroseconds usecRTO = m_statsEndToEnd.CalcSenderRetryTimeout( m_senderState.PeerMaxAckDelay() );
+	SteamNetworkingMicroseconds usecRACKTimeout = m_senderState.m_usecRACKRTT
+		+ std::max( (SteamNetworkingMicroseconds)m_statsEndToEnd.m_ping.m_nSmoothedPing*250, k_usecNackFlush );
 	while ( m_senderState.m_itNextInFlightPacketToTimeout != m_senderState.m_mapInFlightPacketsByPktNum.end() )
 	{
 		Assert( m_senderState.m_itNextInFlightPacketToTimeout->first > 0 );
+		SNPInFlightPacket_t &pkt = m_senderState.m_itNextInFlightPacketToTimeout->second;
 
 		// If already nacked, then no use waiting on it, just skip it
-		if ( !m_senderState.m_itNextInFlightPacketToTimeout->second.m_bNack )
+		if ( !pkt.m_bNack )
 		{
 
 			// Not yet time to give up?
-			SteamNetworkingMicroseconds usecRetryPkt = m_senderState.m_itNextInFlightPacketToTimeout->second.m_usecWhenSent + usecRTO;
+			SteamNetworkingMicroseconds usecRetryPkt = pkt.m_usecWhenSent + usecRTO;
+			bool bRACK = false;
+			if ( pkt.m_usecWhenSent <= m_senderState.m_usecRACKSent && pkt.m_usecWhenSent + usecRACKTimeout < usecRetryPkt )
+			{
+				usecRetryPkt = pkt.m_usecWhenSent + usecRACKTimeout;
+				bRACK = true;
+			}
 			if ( usecRetryPkt > usecNow )
 			{
 				usecNextRetry = usecRetryPkt;
@@ -1635,13 +2532,66 @@ SteamNetworkingMicroseconds CSteamNetworkConnectionBase::SNP_SenderCheckInFlight
 
 			// Mark as dropped, and move any reliable contents into the
 			// retry list.
-			SNP_SenderProcessPacketNack( m_senderState.m_itNextInFlightPacketToTimeout->first, m_senderState.m_itNextInFlightPacketToTimeout->second, "AckTimeout" );
+			SNP_SenderProcessPacketNack( m_senderState.m_itNextInFlightPacketToTimeout->first, pkt, bRACK ? "RACK" : "AckTimeout" );
+			if ( bRACK )
+				++m_senderState.m_nPacketsLostRACK;
+			else
+				++m_senderState.m_nPacketsLostTimeout;
 		}
 
 		// Advance to next packet waiting to timeout
 		++m_senderState.m_itNextInFlightPacketToTimeout;
 	}
 
+	// Tail loss probe.  If the last packets of a burst are lost, nothing sent
+	// later will be acked to trigger the detection above, and we would wait for
+	// the full RTO.  Instead, after about 2xRTT (plus the time the peer might
+	// hold on to the ack), treat the newest packet with reliable data as lost,
+	// which will retransmit its segments.  The ack of the probe (or its loss)
+	// takes care of the rest.
+	if (
+		m_senderState.m_cbSentUnackedReliable > 0
+		&& m_senderState.m_cbPendingReliable == 0
+		&& !m_senderState.m_bTailLossProbePending
+		&& m_statsEndToEnd.m_ping.m_nSmoothedPing >= 0
+		&& m_senderState.m_itNextInFlightPacketToTimeout != m_senderState.m_mapInFlightPacketsByPktNum.end()
+	) {
+		auto itProbe = std::prev( m_senderState.m_mapInFlightPacketsByPktNum.end() );
+		SteamNetworkingMicroseconds usecProbe = itProbe->second.m_usecWhenSent
+			+ std::max( (SteamNetworkingMicroseconds)m_statsEndToEnd.m_ping.m_nSmoothedPing*2000, k_usecTailLossProbeMin )
+			+ m_senderState.PeerMaxAckDelay();
+
+		// Only bother if it would be sooner than the retry timeout
+		if ( usecProbe < usecNextRetry )
+		{
+			if ( usecProbe > usecNow )
+			{
+				usecNextRetry = usecProbe;
+			}
+			else
+			{
+				// Locate the newest packet with reliable data that we are still waiting on.
+				// Since we have unacked reliable data, there must be one.
+				for (;;)
+				{
+					if ( !itProbe->second.m_bNack && !itProbe->second.m_vecReliableSegments.empty() )
+					{
+						SNP_SenderProcessPacketNack( itProbe->first, itProbe->second, "TailLossProbe" );
+						++m_senderState.m_nTailLossProbes;
+						m_senderState.m_bTailLossProbePending = true;
+						break;
+					}
+					if ( itProbe == m_senderState.m_itNextInFlightPacketToTimeout )
+					{
+						AssertMsg( false, "Unacked reliable data, but no in-flight packet carrying it?" );
+						break;
+					}
+					--itProbe;
+				}
+			}
+		}
+	}
+
 	// Skip the sentinel
 	auto inFlightPkt = m_senderState.m_mapInFlightPacketsByPktNum.begin();
 	Assert( inFlightPkt->first < 0 );
@@ -1709,6 +2659,7 @@ struct SNPEncodedSegment
 	uint8 m_cbHdr; // Doesn't include any size byte
 	uint8 m_hdr[ k_cbMaxHdr ];
 	uint16 m_hRetryReliableSeg;
+	bool m_bCompact; // Compact unreliable message frame (11llllms)
 
 	inline void SetupReliable( CSteamNetworkingMessage *pMsg, int64 nBegin, int64 nEnd, int64 nLastReliableStreamPosEnd )
 	{
@@ -1718,6 +2669,7 @@ struct SNPEncodedSegment
 
 		// Start filling out the header
 		uint8 *pHdr = m_hdr;
+		m_bCompact = false;
 
 		// First reliable segment in the message?
 		if ( nLastReliableStreamPosEnd == 0 )
@@ -1776,6 +2728,7 @@ struct SNPEncodedSegment
 		// identifying this as an unreliable segment
 		uint8 *pHdr = m_hdr;
 		*(pHdr++) = 0x00;
+		m_bCompact = false;
 
 		// Encode message number.  First unreliable message?
 		if ( nLastMsgNumForUnreliable == 0 )
@@ -1788,38 +2741,97 @@ struct SNPEncodedSegment
 		}
 		else
 		{
-			// Subsequent unreliable message
+			// Subsequent unreliable message
+			Assert( pMsg->m_nMessageNumber > nLastMsgNumForUnreliable );
+			uint64 nDelta = pMsg->m_nMessageNumber - nLastMsgNumForUnreliable;
+			if ( nDelta == 1 )
+			{
+				// Common case of sequential messages.  Don't encode any offset
+			}
+			else
+			{
+				pHdr = SerializeVarInt( pHdr, nDelta, m_hdr+k_cbMaxHdr );
+				Assert( pHdr ); // Overflow shouldn't be possible
+				m_hdr[0] |= 0x10;
+			}
+		}
+
+		// Encode segment offset within message, except in the special common case of the first segment
+		if ( nOffset > 0 )
+		{
+			pHdr = SerializeVarInt( pHdr, (uint32)( nOffset ), m_hdr+k_cbMaxHdr );
+			Assert( pHdr ); // Overflow shouldn't be possible
+			m_hdr[0] |= 0x08;
+		}
+
+		m_cbHdr = pHdr-m_hdr;
+
+		// Size of the segment.  We assume that the whole things fits for now, event hough it might ned to get truncated
+		int cbSegData = pMsg->m_cbSize - nOffset;
+		Assert( cbSegData > 0 || ( cbSegData == 0 && pMsg->m_cbSize == 0 ) ); // We should only send zero-byte segments if the message itself is zero bytes.  (Which is legitimate!)
+
+		m_pMsg = pMsg;
+		m_cbSegSize = cbSegData;
+		m_nOffset = nOffset;
+	}
+
+	// Try to set up a compact frame for an entire, small, unreliable message.
+	// Returns false if we can't, and the caller should use SetupUnreliable.
+	inline bool SetupUnreliableCompact( CSteamNetworkingMessage *pMsg, int64 nLastMsgNumForUnreliable, int64 nPeerMsgNumLowerBound, int cbRemaining )
+	{
+		if ( pMsg->m_cbSize > 0xff )
+			return false;
+
+		// Top two bits = 11, lane bits are filled in later, if we use them
+		uint8 *pHdr = m_hdr;
+		*(pHdr++) = 0xc0;
+
+		// Encode message number.  First unreliable message?
+		if ( nLastMsgNumForUnreliable == 0 )
+		{
+			// The peer decodes the bottom bits relative to the highest message
+			// number it has seen.  That's at least nPeerMsgNumLowerBound, and
+			// less than this message number.  Leave some margin, so that we stay
+			// well clear of the limit where the receiver would complain.
+			int64 nDelta = pMsg->m_nMessageNumber - nPeerMsgNumLowerBound;
+			Assert( nDelta > 0 );
+			if ( nDelta <= 0x3f )
+			{
+				*(pHdr++) = uint8( pMsg->m_nMessageNumber );
+			}
+			else if ( nDelta <= 0x3fff )
+			{
+				*(uint16*)pHdr = LittleWord( (uint16)pMsg->m_nMessageNumber ); pHdr += 2;
+				m_hdr[0] |= 0x02;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else
+		{
+			// Subsequent unreliable message, same as the regular frame
 			Assert( pMsg->m_nMessageNumber > nLastMsgNumForUnreliable );
 			uint64 nDelta = pMsg->m_nMessageNumber - nLastMsgNumForUnreliable;
-			if ( nDelta == 1 )
-			{
-				// Common case of sequential messages.  Don't encode any offset
-			}
-			else
+			if ( nDelta > 1 )
 			{
 				pHdr = SerializeVarInt( pHdr, nDelta, m_hdr+k_cbMaxHdr );
 				Assert( pHdr ); // Overflow shouldn't be possible
-				m_hdr[0] |= 0x10;
+				m_hdr[0] |= 0x02;
 			}
 		}
 
-		// Encode segment offset within message, except in the special common case of the first segment
-		if ( nOffset > 0 )
-		{
-			pHdr = SerializeVarInt( pHdr, (uint32)( nOffset ), m_hdr+k_cbMaxHdr );
-			Assert( pHdr ); // Overflow shouldn't be possible
-			m_hdr[0] |= 0x08;
-		}
-
+		// The whole message must fit, we can't send a partial message this way
 		m_cbHdr = pHdr-m_hdr;
-
-		// Size of the segment.  We assume that the whole things fits for now, event hough it might ned to get truncated
-		int cbSegData = pMsg->m_cbSize - nOffset;
-		Assert( cbSegData > 0 || ( cbSegData == 0 && pMsg->m_cbSize == 0 ) ); // We should only send zero-byte segments if the message itself is zero bytes.  (Which is legitimate!)
+		if ( m_cbHdr + pMsg->m_cbSize > cbRemaining )
+			return false;
 
 		m_pMsg = pMsg;
-		m_cbSegSize = cbSegData;
-		m_nOffset = nOffset;
+		m_cbSegSize = pMsg->m_cbSize;
+		m_nOffset = 0;
+		m_bCompact = true;
+		return true;
 	}
 
 };
@@ -1829,6 +2841,7 @@ struct SNPPacketSerializeHelper
 	uint8 *m_pPayloadEnd;
 	int m_nLogLevelPacketDecode;
 	int m_cbMaxPlaintextPayload;
+	bool m_bCompactEncoding;
 
 	std::pair<int64,SNPInFlightPacket_t> m_insertInflightPkt;
 	inline SNPInFlightPacket_t &InFlightPkt() { return m_insertInflightPkt.second; }
@@ -1836,6 +2849,13 @@ struct SNPPacketSerializeHelper
 
 	SNPAckSerializerHelper m_acks;
 
+	// Summary of what we actually put in the packet, for the packet trace
+	int m_nUnreliableSegments = 0;
+	int m_nAckBlocksSent = -1; // -1 if we didn't send an ack frame
+	int64 m_nAckLatestPktNum = 0;
+
+	// Plaintext is serialized here, and then encrypted in place.  So
+	// there must be room for the tag.
 	uint8 payload[ k_cbSteamNetworkingSocketsMaxEncryptedPayloadSend ];
 };
 
@@ -1863,6 +2883,7 @@ bool CSteamNetworkConnectionBase::SNP_SendPacket( CConnectionTransport *pTranspo
 	helper.m_insertInflightPkt.second.m_pTransport = pTransport;
 
 	helper.m_nLogLevelPacketDecode = m_connectionConfig.LogLevel_PacketDecode.Get();
+	helper.m_bCompactEncoding = m_connectionConfig.CompactEncoding.Get() != 0 && m_statsEndToEnd.m_nPeerProtocolVersion >= 17;
 	SpewVerboseGroup( helper.m_nLogLevelPacketDecode, "[%s] encode pkt %lld",
 		GetDescription(),
 		(long long)m_statsEndToEnd.m_nNextSendSequenceNumber );
@@ -1929,37 +2950,41 @@ bool CSteamNetworkConnectionBase::SNP_SendPacket( CConnectionTransport *pTranspo
 		// Adjust the IV by the packet number
 		*(uint64 *)&m_cryptIVSend.m_buf += LittleQWord( m_statsEndToEnd.m_nNextSendSequenceNumber );
 
-		// Encrypt the chunk
-		uint8 arEncryptedChunk[ k_cbSteamNetworkingSocketsMaxEncryptedPayloadSend + 64 ]; // Should not need pad
-		uint32 cbEncrypted = sizeof(arEncryptedChunk);
+		// Encrypt the chunk in place.  The serializer left room for the tag
+		uint32 cbEncrypted = sizeof(helper.payload);
+		const bool bPerfMetrics = BPerfMetricsEnabled();
+		SteamNetworkingMicroseconds usecEncryptStart = unlikely( bPerfMetrics ) ? SteamNetworkingSockets_GetLocalTimestamp() : 0;
 		DbgVerify( m_pCryptContextSend->Encrypt(
 			helper.payload, cbPlainText, // plaintext
 			m_cryptIVSend.m_buf, // IV
-			arEncryptedChunk, &cbEncrypted, // output
+			helper.payload, &cbEncrypted, // output
 			nullptr, 0 // no AAD
 		) );
+		if ( unlikely( bPerfMetrics ) )
+			PerfHistogramRecord( k_EPerfHistogram_EncryptUsec, SteamNetworkingSockets_GetLocalTimestamp() - usecEncryptStart );
 
 		//SpewMsg( "Send encrypt IV %llu + %02x%02x%02x%02x  encrypted %d %02x%02x%02x%02x\n",
 		//	*(uint64 *)&m_cryptIVSend.m_buf,
 		//	m_cryptIVSend.m_buf[8], m_cryptIVSend.m_buf[9], m_cryptIVSend.m_buf[10], m_cryptIVSend.m_buf[11],
 		//	cbEncrypted,
-		//	arEncryptedChunk[0], arEncryptedChunk[1], arEncryptedChunk[2],arEncryptedChunk[3]
+		//	helper.payload[0], helper.payload[1], helper.payload[2],helper.payload[3]
 		//);
 
 		// Restore the IV to the base value
 		*(uint64 *)&m_cryptIVSend.m_buf -= LittleQWord( m_statsEndToEnd.m_nNextSendSequenceNumber );
 
 		Assert( (int)cbEncrypted >= cbPlainText );
-		Assert( (int)cbEncrypted <= k_cbSteamNetworkingSocketsMaxEncryptedPayloadSend ); // confirm that pad above was not necessary and we never exceed k_nMaxSteamDatagramTransportPayload, even after encrypting
+		Assert( (int)cbEncrypted <= k_cbSteamNetworkingSocketsMaxEncryptedPayloadSend ); // we never exceed k_nMaxSteamDatagramTransportPayload, even after encrypting
 
 		// Ask current transport to deliver it
-		nBytesSent = helper.InFlightPkt().m_pTransport->SendEncryptedDataChunk( arEncryptedChunk, cbEncrypted, ctx );
+		nBytesSent = helper.InFlightPkt().m_pTransport->SendEncryptedDataChunk( helper.payload, cbEncrypted, ctx );
 	}
 	if ( nBytesSent <= 0 )
 	{
 		// We have potentially transfered ownership of some reliable messages
 		// to the segments in helper.m_insertInflightPkt.  We must not leak those!
 		SNP_QueueReliableSegmentsForRetry( helper.m_insertInflightPkt.second, 0, "Send fail" );
+		m_senderState.ResolveDeliveryReceipts( helper.m_insertInflightPkt.second, false );
 		return false;
 	}
 
@@ -1973,6 +2998,12 @@ bool CSteamNetworkConnectionBase::SNP_SendPacket( CConnectionTransport *pTranspo
 		m_statsEndToEnd.TrackSentMessageExpectingSeqNumAck( helper.UsecNow(), true );
 		// FIXME - should let transport know
 	}
+	else if ( helper.m_nUnreliableSegments == 0 && helper.m_nAckBlocksSent >= 0 )
+	{
+		++m_senderState.m_nAckOnlyPacketsSent;
+	}
+	++m_senderState.m_nDataPacketsSent;
+	m_senderState.m_cbDataPayloadSent += cbPlainText;
 
 	// If we aren't already tracking anything to timeout, then this is the next one.
 	if ( m_senderState.m_itNextInFlightPacketToTimeout == m_senderState.m_mapInFlightPacketsByPktNum.end() )
@@ -1987,6 +3018,21 @@ bool CSteamNetworkConnectionBase::SNP_SendPacket( CConnectionTransport *pTranspo
 
 	// We spent some tokens
 	m_sendRateData.m_flTokenBucket -= (float)nBytesSent;
+
+	#ifdef STEAMNETWORKINGSOCKETS_ENABLE_SNPTRACE
+		if ( unlikely( g_pSNPTraceHeader ) )
+		{
+			uint8 nFlags = 0;
+			if ( m_eNegotiatedCipher != k_ESteamNetworkingSocketsCipher_NULL )
+				nFlags |= k_nSNPTraceFlag_Encrypted;
+			if ( helper.m_nAckBlocksSent >= 0 )
+				nFlags |= k_nSNPTraceFlag_Ack;
+			SNP_TracePacket( k_ESNPTraceDirection_Send, helper.m_insertInflightPkt.first, nBytesSent, cbPlainText,
+				len( helper.InFlightPkt().m_vecReliableSegments ), helper.m_nUnreliableSegments,
+				std::max( 0, helper.m_nAckBlocksSent ), helper.m_nAckLatestPktNum, nFlags, ctx.m_usecNow );
+		}
+	#endif
+
 	return true;
 }
 
@@ -1996,10 +3042,12 @@ struct SNPSegmentCollectorLaneBase
 
 	vstd::small_vector<SNPEncodedSegment,16> m_vecSegments;
 
-	SNPEncodedSegment *AddUnreliable( CSteamNetworkingMessage *pMsg, int nOffset )
+	// nPeerMsgNumLowerBound is negative if we aren't using the compact encoding
+	SNPEncodedSegment *AddUnreliable( CSteamNetworkingMessage *pMsg, int nOffset, int64 nPeerMsgNumLowerBound, int cbRemaining )
 	{
 		SNPEncodedSegment *pSeg = push_back_get_ptr( m_vecSegments );
-		pSeg->SetupUnreliable( pMsg, nOffset, m_nLastMsgNumForUnreliable );
+		if ( nPeerMsgNumLowerBound < 0 || nOffset > 0 || !pSeg->SetupUnreliableCompact( pMsg, m_nLastMsgNumForUnreliable, nPeerMsgNumLowerBound, cbRemaining ) )
+			pSeg->SetupUnreliable( pMsg, nOffset, m_nLastMsgNumForUnreliable );
 		m_nLastMsgNumForUnreliable = pMsg->m_nMessageNumber;
 		return pSeg;
 	}
@@ -2172,6 +3220,14 @@ inline uint8 *CSteamNetworkConnectionBase::SNP_SerializeSegmentArray( uint8 *pPa
 	const int idxLane = pSeg->m_pMsg->m_idxLane;
 	SSNPSenderState::Lane &sendLane = m_senderState.m_vecLanes[ idxLane ];
 
+	// Forward error correction for unreliable messages on this lane?
+	const bool bFEC = idxLane < 32
+		&& ( m_connectionConfig.UnreliableFECLanes.Get() & ( 1u << idxLane ) ) != 0
+		&& m_statsEndToEnd.m_nPeerProtocolVersion >= 14;
+
+	// Highest unreliable message number in this lane, for the compact encoding
+	int64 nHighestUnreliableMsgNum = 0;
+
 	// OK, now go through and actually serialize the segments
 	do
 	{
@@ -2179,7 +3235,18 @@ inline uint8 *CSteamNetworkConnectionBase::SNP_SerializeSegmentArray( uint8 *pPa
 		DbgAssert( pSeg->m_pMsg->m_idxLane == idxLane );
 
 		// Finish the segment size byte
-		if ( !bLastLane || pSeg+1 < pSegEnd )
+		if ( pSeg->m_bCompact )
+		{
+			// Compact frame has a flag for an explicit 8-bit size,
+			// otherwise it extends to the end of the packet
+			if ( !bLastLane || pSeg+1 < pSegEnd )
+			{
+				Assert( pSeg->m_cbSegSize <= 0xff );
+				pSeg->m_hdr[0] |= 0x01;
+				pSeg->m_hdr[ pSeg->m_cbHdr++ ] = uint8( pSeg->m_cbSegSize );
+			}
+		}
+		else if ( !bLastLane || pSeg+1 < pSegEnd )
 		{
 			// Stash upper 3 bits into the header
 			int nUpper3Bits = ( pSeg->m_cbSegSize>>8 );
@@ -2252,6 +3319,7 @@ inline uint8 *CSteamNetworkConnectionBase::SNP_SerializeSegmentArray( uint8 *pPa
 				pInFlightSeg->m_hStatusOrRetry = SNPSendReliableSegment_t::k_nStatus_InFlight;
 
 				++msgRelInfo.m_nSentReliableSegRefCount;
+				++m_senderState.m_nReliableSegmentsSent;
 			}
 			else
 			{
@@ -2266,6 +3334,9 @@ inline uint8 *CSteamNetworkConnectionBase::SNP_SerializeSegmentArray( uint8 *pPa
 
 				// We're going to add a reference
 				++pInFlightSeg->m_nRefCount;
+
+				++m_senderState.m_nReliableSegmentsRetransmitted;
+				m_senderState.m_cbReliableRetransmitted += pSeg->m_cbSegSize;
 			}
 
 			// Spew
@@ -2291,6 +3362,7 @@ inline uint8 *CSteamNetworkConnectionBase::SNP_SerializeSegmentArray( uint8 *pPa
 		{
 			// We should only encode an empty segment if the message itself is empty
 			Assert( pSeg->m_cbSegSize > 0 || ( pSeg->m_cbSegSize == 0 && pSeg->m_pMsg->m_cbSize == 0 ) );
+			++helper.m_nUnreliableSegments;
 
 			// Check if this message is still sitting in the lane send queue
 			bool bStillInQueue = ( pSeg->m_pMsg->m_linksSecondaryQueue.m_pQueue != nullptr );
@@ -2298,7 +3370,7 @@ inline uint8 *CSteamNetworkConnectionBase::SNP_SerializeSegmentArray( uint8 *pPa
 			// Check some stuff
 			Assert( bStillInQueue == ( pSeg->m_pMsg->m_links.m_pQueue != nullptr ) ); // Still in the global connection queue
 			Assert( bStillInQueue == ( pSeg->m_nOffset + pSeg->m_cbSegSize < pSeg->m_pMsg->m_cbSize ) ); // If we ended the message, we should have removed it from the queue
-			Assert( bStillInQueue == ( ( pSeg->m_hdr[0] & 0x20 ) == 0 ) );
+			Assert( pSeg->m_bCompact ? !bStillInQueue : bStillInQueue == ( ( pSeg->m_hdr[0] & 0x20 ) == 0 ) );
 			Assert( bStillInQueue || pSeg->m_pMsg->m_links.m_pNext == nullptr ); // If not in the queue, we should be detached
 			Assert( bStillInQueue || pSeg->m_pMsg->m_linksSecondaryQueue.m_pNext == nullptr ); // If not in the queue, we should be detached
 			Assert( pSeg->m_pMsg->m_linksSecondaryQueue.m_pPrev == nullptr ); // We should either be at the head of the queue, or detached
@@ -2312,6 +3384,15 @@ inline uint8 *CSteamNetworkConnectionBase::SNP_SerializeSegmentArray( uint8 *pPa
 				GetDescription(), (long long)m_statsEndToEnd.m_nNextSendSequenceNumber, (long long)pSeg->m_pMsg->m_nMessageNumber,
 				pSeg->m_nOffset, pSeg->m_cbSegSize, pSeg->m_nOffset+pSeg->m_cbSegSize );
 
+			// Small message that fit entirely in this packet?  Protect it with FEC
+			if ( bFEC && pSeg->m_nOffset == 0 && pSeg->m_cbSegSize == pSeg->m_pMsg->m_cbSize && pSeg->m_cbSegSize <= k_cbMaxFECMessageSize )
+				SNP_FECAddMessage( idxLane, pSeg->m_pMsg );
+
+			// Remember which packet(s) the message was in, if the app wants to know whether it got there
+			if ( pSeg->m_pMsg->m_nFlags & k_nSteamNetworkingSend_DeliveryReceipt )
+				m_senderState.TrackDeliveryReceipt( helper.InFlightPkt(), idxLane, pSeg->m_pMsg->m_nMessageNumber, !bStillInQueue );
+			nHighestUnreliableMsgNum = pSeg->m_pMsg->m_nMessageNumber;
+
 			// Less unreliable data pending
 			Assert( m_senderState.m_cbPendingUnreliable >= sendLane.m_cbPendingUnreliable );
 			sendLane.m_cbPendingUnreliable -= pSeg->m_cbSegSize;
@@ -2325,6 +3406,10 @@ inline uint8 *CSteamNetworkConnectionBase::SNP_SerializeSegmentArray( uint8 *pPa
 		++pSeg;
 	} while ( pSeg < pSegEnd );
 
+	// When the packet is acked, we'll know the peer has seen this message number
+	if ( helper.m_bCompactEncoding && nHighestUnreliableMsgNum > 0 )
+		helper.InFlightPkt().m_vecCompactMsgNums.push_back( SNPInFlightPacket_t::DeliveryReceiptRef{ nHighestUnreliableMsgNum, idxLane } );
+
 	if ( !k_bUnreliableOnly && bLastLane )
 		m_senderState.MaybeCheckReliable();
 
@@ -2360,8 +3445,18 @@ uint8 *CSteamNetworkConnectionBase::SNP_SerializeSegments_MultiLane( uint8 *pPay
 		}
 		else
 		{
-			memcpy( pPayloadPtr, lane.m_hdr, lane.m_cbHdr );
-			pPayloadPtr += lane.m_cbHdr;
+			// If the first segment is a compact frame, it can select the
+			// lane itself, and we don't need the lane select frame
+			SNPEncodedSegment &firstSeg = lane.m_vecSegments[0];
+			if ( firstSeg.m_bCompact && lane.m_nLaneID < 15 )
+			{
+				firstSeg.m_hdr[0] |= uint8( ( lane.m_nLaneID+1 ) << 2 );
+			}
+			else
+			{
+				memcpy( pPayloadPtr, lane.m_hdr, lane.m_cbHdr );
+				pPayloadPtr += lane.m_cbHdr;
+			}
 			pPayloadPtr = SNP_SerializeSegmentArray<k_bUnreliableOnly>( pPayloadPtr, helper, lane.m_vecSegments.begin(), lane.m_vecSegments.end(), idxLane == idxLastLane );
 			if ( !pPayloadPtr )
 				break;
@@ -2407,6 +3502,9 @@ int CSteamNetworkConnectionBase::SNP_SerializePacketInternal( SNPPacketSerialize
 	if ( pPayloadPtr == nullptr )
 		return 0;
 
+	// Ack frequency frame, if we need to change what we've asked the peer to do
+	pPayloadPtr = SNP_SerializeAckFrequencyFrame( helper, pPayloadPtr );
+
 	// Get list of ack blocks we might want to serialize, and which
 	// of those acks we really want to flush out right now.
 	SNP_GatherAckBlocks( helper );
@@ -2432,9 +3530,9 @@ int CSteamNetworkConnectionBase::SNP_SerializePacketInternal( SNPPacketSerialize
 	if ( m_statsEndToEnd.m_nMaxRecvPktNum > 0 )
 	{
 		int cbPayloadRemainingForAcks = helper.m_pPayloadEnd - pPayloadPtr;
-		if ( cbPayloadRemainingForAcks >= SNPAckSerializerHelper::k_cbHeaderSize )
+		if ( cbPayloadRemainingForAcks >= helper.m_acks.m_cbEncodedSizeNoBlocks )
 		{
-			cbReserveForAcks = SNPAckSerializerHelper::k_cbHeaderSize;
+			cbReserveForAcks = helper.m_acks.m_cbEncodedSizeNoBlocks;
 			int n = 3; // Assume we want to send a handful
 			n = std::max( n, helper.m_acks.m_nBlocksNeedToAck ); // But if we have blocks that need to be flushed now, try to fit all of them
 			n = std::min( n, helper.m_acks.m_nBlocks ); // Cannot send more than we actually have
@@ -2572,33 +3670,53 @@ int CSteamNetworkConnectionBase::SNP_SerializePacketInternal( SNPPacketSerialize
 		else
 		{
 
-			// Check priority classes in order
-			// NOTE: We could avoid these loops by putting the lanes into
-			// a priority queue
-			for ( SSNPSenderState::PriorityClass &pc: m_senderState.m_vecPriorityClasses )
+			// Lanes with a latency target go first, earliest deadline first
+			if ( m_senderState.m_bAnyLaneDeadlines )
 			{
-
-				// Check the lanes in this class for the one
-				// with a queued message and the earliest virtual finish time.
-				VirtualSendTime virtTimeMinEstFinish = k_virtSendTime_Infinite;
-				for ( int idxLane: pc.m_vecLaneIdx )
+				SteamNetworkingMicroseconds usecMinDeadline = INT64_MAX;
+				for ( SSNPSenderState::Lane &l: m_senderState.m_vecLanes )
 				{
-					SSNPSenderState::Lane &l = m_senderState.m_vecLanes[ idxLane ];
 					CSteamNetworkingMessage *pNextMsg = l.m_messagesQueued.m_pFirst;
-					if ( pNextMsg )
+					if ( l.m_usecLatencyTarget > 0 && pNextMsg && pNextMsg->SNPSend_UsecDeadline() < usecMinDeadline )
 					{
 						Assert( l.m_cbCurrentSendMessageSent < pNextMsg->m_cbSize );
-						if ( pNextMsg->SNPSend_VirtualFinishTime() < virtTimeMinEstFinish )
+						pSendMsg = pNextMsg;
+						usecMinDeadline = pNextMsg->SNPSend_UsecDeadline();
+					}
+				}
+			}
+
+			// Check priority classes in order.  (If we get here, none of the
+			// lanes with a latency target have anything queued.)
+			// NOTE: We could avoid these loops by putting the lanes into
+			// a priority queue
+			if ( !pSendMsg )
+			{
+				for ( SSNPSenderState::PriorityClass &pc: m_senderState.m_vecPriorityClasses )
+				{
+
+					// Check the lanes in this class for the one
+					// with a queued message and the earliest virtual finish time.
+					VirtualSendTime virtTimeMinEstFinish = k_virtSendTime_Infinite;
+					for ( int idxLane: pc.m_vecLaneIdx )
+					{
+						SSNPSenderState::Lane &l = m_senderState.m_vecLanes[ idxLane ];
+						CSteamNetworkingMessage *pNextMsg = l.m_messagesQueued.m_pFirst;
+						if ( pNextMsg )
 						{
-							pSendMsg = pNextMsg;
-							virtTimeMinEstFinish = pNextMsg->SNPSend_VirtualFinishTime();
+							Assert( l.m_cbCurrentSendMessageSent < pNextMsg->m_cbSize );
+							if ( pNextMsg->SNPSend_VirtualFinishTime() < virtTimeMinEstFinish )
+							{
+								pSendMsg = pNextMsg;
+								virtTimeMinEstFinish = pNextMsg->SNPSend_VirtualFinishTime();
+							}
 						}
 					}
-				}
 
-				// Once we find a message to send, we can stop checking higher numbered priority classes
-				if ( pSendMsg )
-					break;
+					// Once we find a message to send, we can stop checking higher numbered priority classes
+					if ( pSendMsg )
+						break;
+				}
 			}
 		}
 		if ( !pSendMsg )
@@ -2609,6 +3727,21 @@ int CSteamNetworkConnectionBase::SNP_SerializePacketInternal( SNPPacketSerialize
 		const int idxLane = k_bSingleLane ? 0 : pSendMsg->m_idxLane;
 		SSNPSenderState::Lane &sendLane = m_senderState.m_vecLanes[ idxLane ];
 
+		// Unreliable message that has gone stale while waiting in the queue?
+		// Once we've sent part of it, we finish the job.
+		if (
+			pSendMsg->m_usecExpiry != 0
+			&& pSendMsg->m_usecExpiry < helper.UsecNow()
+			&& sendLane.m_cbCurrentSendMessageSent == 0
+			&& !pSendMsg->SNPSend_IsReliable()
+		) {
+			SpewVerboseGroup( m_connectionConfig.LogLevel_Message.Get(), "[%s] Unreliable MsgNum=%lld expired %.1fms ago, discarding\n",
+				GetDescription(), (long long)pSendMsg->m_nMessageNumber, ( helper.UsecNow() - pSendMsg->m_usecExpiry )*1e-3 );
+			m_senderState.RemoveQueuedUnreliableMessage( pSendMsg );
+			++sendLane.m_nUnreliableExpired;
+			continue;
+		}
+
 		// Start a new segment
 		SNPEncodedSegment *pSeg;
 
@@ -2648,7 +3781,9 @@ int CSteamNetworkConnectionBase::SNP_SerializePacketInternal( SNPPacketSerialize
 		}
 		else
 		{
-			pSeg = pCollectorLane->AddUnreliable( pSendMsg, sendLane.m_cbCurrentSendMessageSent );
+			pSeg = pCollectorLane->AddUnreliable( pSendMsg, sendLane.m_cbCurrentSendMessageSent,
+				helper.m_bCompactEncoding ? sendLane.m_nPeerHighestSeenMsgNumLowerBound : -1,
+				segmentCollector.m_cbRemainingForSegments );
 		}
 
 		// Can't fit the whole thing?
@@ -2680,7 +3815,7 @@ int CSteamNetworkConnectionBase::SNP_SerializePacketInternal( SNPPacketSerialize
 			segmentCollector.m_cbRemainingForSegments -= pSeg->m_cbHdr + pSeg->m_cbSegSize;
 
 			// Advance fair queuing virtual time
-			if ( !k_bSingleLane )
+			if ( !k_bSingleLane && sendLane.m_usecLatencyTarget == 0 )
 			{
 				SSNPSenderState::PriorityClass &priClass = m_senderState.m_vecPriorityClasses[ sendLane.m_idxPriorityClass ];
 				priClass.m_virtTimeCurrent += (VirtualSendTime)( (float)pSeg->m_cbSegSize * sendLane.m_flBytesToVirtualTime );
@@ -2701,8 +3836,16 @@ int CSteamNetworkConnectionBase::SNP_SerializePacketInternal( SNPPacketSerialize
 		Assert( sendLane.m_cbCurrentSendMessageSent + pSeg->m_cbSegSize == pSendMsg->m_cbSize );
 		sendLane.m_cbCurrentSendMessageSent = 0;
 
+		// Did it make its deadline?
+		if ( sendLane.m_usecLatencyTarget > 0 )
+		{
+			++sendLane.m_nDeadlineMessages;
+			if ( helper.UsecNow() > pSendMsg->SNPSend_UsecDeadline() )
+				++sendLane.m_nDeadlineMisses;
+		}
+
 		// Advance fair queuing virtual time
-		if ( !k_bSingleLane )
+		if ( !k_bSingleLane && sendLane.m_usecLatencyTarget == 0 )
 		{
 			// Advance fair queuing virtual time
 			SSNPSenderState::PriorityClass &priClass = m_senderState.m_vecPriorityClasses[ sendLane.m_idxPriorityClass ];
@@ -2769,7 +3912,7 @@ int CSteamNetworkConnectionBase::SNP_SerializePacketInternal( SNPPacketSerialize
 			// Go ahead and add us to the end of the list of unacked messages
 			pSeg->m_pMsg->LinkToQueueTail( &CSteamNetworkingMessage::m_links, &m_senderState.m_unackedReliableMessages );
 		}
-		else
+		else if ( !pSeg->m_bCompact ) // Compact frames are always the whole message
 		{
 
 			// Unreliable.  Set the "This is the last segment in this message" header bit
@@ -2779,6 +3922,11 @@ int CSteamNetworkConnectionBase::SNP_SerializePacketInternal( SNPPacketSerialize
 
 done_with_all_segments:
 
+	// FEC parity for any groups that are ready.  This goes before the
+	// segments, so that the last segment can extend to the end of the packet.
+	if ( segmentCollector.m_cbRemainingForSegments > 0 && m_connectionConfig.UnreliableFECLanes.Get() != 0 )
+		pPayloadPtr = SNP_SerializeFECParityFrames( pPayloadPtr, segmentCollector.m_cbRemainingForSegments );
+
 	// Now we know how much space we need for the segments.  If we asked to reserve
 	// space for acks, we should have at least that much.  But we might have more.
 	// Serialize acks, as much as will fit.  If we are badly fragmented and we have
@@ -2816,7 +3964,8 @@ done_with_all_segments:
 			}
 			else
 			{
-				Assert( cbAckBytesWritten == cbReserveForAcks ); // The code above reserves space very carefuly.  So if we reserve it, we should fill it!
+				// The code above reserves space very carefuly.  So if we reserve it, we should fill it!
+				Assert( cbAckBytesWritten == cbReserveForAcks );
 			}
 
 			pPayloadPtr = pAfterAcks;
@@ -2865,6 +4014,12 @@ void CSteamNetworkConnectionBase::SNP_GatherAckBlocks( SNPPacketSerializeHelper
 	helper.m_acks.m_nBlocks = 0;
 	helper.m_acks.m_nBlocksNeedToAck = 0;
 
+	// If we don't send any blocks, SNP_SerializeAckBlocks just writes the
+	// header, with the packet before the oldest gap.  (Or the latest packet, if
+	// there aren't any gaps.)  The packed header might be smaller.
+	helper.m_acks.m_cbEncodedSizeNoBlocks = SNPAckSerializerHelper::HeaderSize( helper.m_bCompactEncoding, 0,
+		SNPAckSerializerHelper::EncodeTimeSince( helper.UsecNow(), m_receiverState.m_mapPacketGaps.begin()->second.m_usecWhenReceivedPktBefore ) );
+
 	// Fast case for no packet loss we need to ack, which will (hopefully!) be a common case
 	int n = len( m_receiverState.m_mapPacketGaps ) - 1;
 	if ( n <= 0 )
@@ -2887,6 +4042,7 @@ void CSteamNetworkConnectionBase::SNP_GatherAckBlocks( SNPPacketSerializeHelper
 	auto itNext = m_receiverState.m_mapPacketGaps.begin();
 
 	int cbEncodedSize = helper.m_acks.k_cbHeaderSize;
+	int cbPackedBlocks = 0;
 	while ( n > 0 )
 	{
 		--n;
@@ -2937,6 +4093,23 @@ void CSteamNetworkConnectionBase::SNP_GatherAckBlocks( SNPPacketSerializeHelper
 		if ( block.m_nNack > 7 )
 			cbEncodedSize += VarIntSerializedSize( block.m_nNack>>3 );
 		block.m_cbTotalEncodedSize = cbEncodedSize;
+		block.m_bPacked = false;
+
+		// Would the packed ack frame be smaller?
+		if ( helper.m_bCompactEncoding )
+		{
+			++cbPackedBlocks;
+			if ( block.m_nAck > 62 )
+				cbPackedBlocks += VarIntSerializedSize( block.m_nAck-63 );
+			if ( block.m_nNack > 2 )
+				cbPackedBlocks += VarIntSerializedSize( block.m_nNack-3 );
+			int cbPackedTotal = SNPAckSerializerHelper::HeaderSize( true, helper.m_acks.m_nBlocks+1, block.m_nEncodedTimeSinceLatestPktNum ) + cbPackedBlocks;
+			if ( cbPackedTotal <= cbEncodedSize )
+			{
+				block.m_cbTotalEncodedSize = cbPackedTotal;
+				block.m_bPacked = true;
+			}
+		}
 
 		// FIXME Here if the caller knows they are working with limited space,
 		// they could tell us how much space they have and we could bail
@@ -2950,28 +4123,21 @@ void CSteamNetworkConnectionBase::SNP_GatherAckBlocks( SNPPacketSerializeHelper
 	}
 }
 
-uint8 *CSteamNetworkConnectionBase::SNP_SerializeAckBlocks( const SNPPacketSerializeHelper &helper, uint8 *pOut, const uint8 *pOutEnd )
+uint8 *CSteamNetworkConnectionBase::SNP_SerializeAckBlocks( SNPPacketSerializeHelper &helper, uint8 *pOut, const uint8 *pOutEnd )
 {
 
 	// We shouldn't be called if we never received anything
 	Assert( m_statsEndToEnd.m_nMaxRecvPktNum > 0 );
 
 	// No room even for the header?
-	if ( pOut + SNPAckSerializerHelper::k_cbHeaderSize > pOutEnd )
+	if ( pOut + helper.m_acks.m_cbEncodedSizeNoBlocks > pOutEnd )
 		return pOut;
 
 	// !KLUDGE! For now limit number of blocks, and always use 16-bit ID.
 	//          Later we might want to make this code smarter.
+	//          (The packed header is never larger than this.)
 	COMPILE_TIME_ASSERT( SNPAckSerializerHelper::k_cbHeaderSize == 5 );
 	uint8 *pAckHeaderByte = pOut;
-	++pOut;
-	uint16 *pLatestPktNum = (uint16 *)pOut;
-	pOut += 2;
-	uint16 *pTimeSinceLatestPktNum = (uint16 *)pOut;
-	pOut += 2;
-
-	// 10011000 - ack frame designator, with 16-bit last-received sequence number, and no ack blocks
-	*pAckHeaderByte = 0x98;
 
 	int nLogLevelPacketDecode = m_connectionConfig.LogLevel_PacketDecode.Get();
 
@@ -2990,14 +4156,17 @@ uint8 *CSteamNetworkConnectionBase::SNP_SerializeAckBlocks( const SNPPacketSeria
 	// Fast case for no packet loss we need to ack, which will (hopefully!) be a common case
 	if ( m_receiverState.m_mapPacketGaps.size() == 1 )
 	{
-		*pLatestPktNum = LittleWord( (uint16)nLastPktToAck );
-		*pTimeSinceLatestPktNum = LittleWord( (uint16)SNPAckSerializerHelper::EncodeTimeSince( helper.UsecNow(), usecWhenRecvLastPktToAck ) );
+		pOut = SNPAckSerializerHelper::SerializeHeader( pOut, helper.m_bCompactEncoding, 0, uint32( nLastPktToAck ),
+			SNPAckSerializerHelper::EncodeTimeSince( helper.UsecNow(), usecWhenRecvLastPktToAck ) );
 
 		SpewDebugGroup( nLogLevelPacketDecode, "[%s]   encode pkt %lld last recv %lld (no loss)\n",
 			GetDescription(),
 			(long long)m_statsEndToEnd.m_nNextSendSequenceNumber, (long long)nLastPktToAck
 		);
 		m_receiverState.m_mapPacketGaps.rbegin()->second.m_usecWhenAckPrior = INT64_MAX; // Clear timer, we wrote everything we needed to
+		m_receiverState.m_nAckElicitingSinceFlush = 0;
+		helper.m_nAckBlocksSent = 0;
+		helper.m_nAckLatestPktNum = nLastPktToAck;
 
 		#ifdef SNP_ENABLE_PACKETSENDLOG
 			pLog->m_nAckBlocksSent = 0;
@@ -3021,8 +4190,8 @@ uint8 *CSteamNetworkConnectionBase::SNP_SerializeAckBlocks( const SNPPacketSeria
 		{
 			auto itOldestGap = m_receiverState.m_mapPacketGaps.begin();
 			int64 nLastRecvPktNum = itOldestGap->first-1;
-			*pLatestPktNum = LittleWord( uint16( nLastRecvPktNum ) );
-			*pTimeSinceLatestPktNum = LittleWord( (uint16)SNPAckSerializerHelper::EncodeTimeSince( helper.UsecNow(), itOldestGap->second.m_usecWhenReceivedPktBefore ) );
+			pOut = SNPAckSerializerHelper::SerializeHeader( pOut, helper.m_bCompactEncoding, 0, uint32( nLastRecvPktNum ),
+				SNPAckSerializerHelper::EncodeTimeSince( helper.UsecNow(), itOldestGap->second.m_usecWhenReceivedPktBefore ) );
 
 			SpewDebugGroup( nLogLevelPacketDecode, "[%s]   encode pkt %lld last recv %lld (no blocks, actual last to ack=%lld)\n",
 				GetDescription(),
@@ -3033,6 +4202,8 @@ uint8 *CSteamNetworkConnectionBase::SNP_SerializeAckBlocks( const SNPPacketSeria
 				pLog->m_nAckBlocksSent = 0;
 				pLog->m_nAckEnd = nLastRecvPktNum;
 			#endif
+			helper.m_nAckBlocksSent = 0;
+			helper.m_nAckLatestPktNum = nLastRecvPktNum;
 
 			// Acked packets before this gap.  Were we waiting to flush them?
 			if ( itOldestGap == m_receiverState.m_itPendingAck )
@@ -3059,25 +4230,14 @@ uint8 *CSteamNetworkConnectionBase::SNP_SerializeAckBlocks( const SNPPacketSeria
 		--nBlocks;
 	}
 
-	// OK, we know how many blocks we are going to write.  Finish the header byte
-	Assert( nBlocks == uint8(nBlocks) );
-	if ( nBlocks > 6 )
-	{
-		*pAckHeaderByte |= 7;
-		*(pOut++) = uint8( nBlocks );
-	}
-	else
-	{
-		*pAckHeaderByte |= uint8( nBlocks );
-	}
-
 	// Locate the first one we will serialize.
 	// (It's the newest one, which is the last one in the list).
 	const SNPAckSerializerHelper::Block *pBlock = &helper.m_acks.m_arBlocks[nBlocks-1];
+	const bool bPacked = pBlock->m_bPacked;
 
-	// Latest packet number and time
-	*pLatestPktNum = LittleWord( uint16( pBlock->m_nLatestPktNum ) );
-	*pTimeSinceLatestPktNum = LittleWord( pBlock->m_nEncodedTimeSinceLatestPktNum );
+	// OK, we know how many blocks we are going to write.  Write the header,
+	// with the latest packet number and time
+	pOut = SNPAckSerializerHelper::SerializeHeader( pOut, bPacked, nBlocks, pBlock->m_nLatestPktNum, pBlock->m_nEncodedTimeSinceLatestPktNum );
 
 	// Last packet number, for spew
 	int64 nAckEnd = NearestWithSameLowerBits( (int32)pBlock->m_nLatestPktNum, nLastPktToAck );
@@ -3088,6 +4248,8 @@ uint8 *CSteamNetworkConnectionBase::SNP_SerializeAckBlocks( const SNPPacketSeria
 		pLog->m_nAckBlocksSent = nBlocks;
 		pLog->m_nAckEnd = nAckEnd;
 	#endif
+	helper.m_nAckBlocksSent = nBlocks;
+	helper.m_nAckLatestPktNum = nAckEnd-1;
 
 	SpewDebugGroup( nLogLevelPacketDecode, "[%s]   encode pkt %lld last recv %lld (%d blocks, actual last to ack=%lld)\n",
 		GetDescription(),
@@ -3106,6 +4268,7 @@ uint8 *CSteamNetworkConnectionBase::SNP_SerializeAckBlocks( const SNPPacketSeria
 			++m_receiverState.m_itPendingAck;
 		}
 		m_receiverState.m_itPendingNack = m_receiverState.m_itPendingAck;
+		m_receiverState.m_nAckElicitingSinceFlush = 0;
 		SNP_DebugCheckPacketGapMap();
 	}
 	else
@@ -3141,47 +4304,67 @@ uint8 *CSteamNetworkConnectionBase::SNP_SerializeAckBlocks( const SNPPacketSeria
 		uint8 *pAckBlockHeaderByte = pOut;
 		++pOut;
 
-		// Encode ACK (number of packets successfully received)
+		// Packed block: aaaaaann.  Long runs of acks with a few packets
+		// lost here and there fit in a single byte.
+		if ( bPacked )
 		{
-			if ( pBlock->m_nAck < 8 )
+			uint8 nAckBits = uint8( std::min( pBlock->m_nAck, 63u ) );
+			uint8 nNackBits = uint8( std::min( pBlock->m_nNack, 3u ) );
+			*pAckBlockHeaderByte = uint8( ( nAckBits << 2 ) | nNackBits );
+			if ( nAckBits == 63 )
+				pOut = SerializeVarInt( pOut, pBlock->m_nAck-63, pOutEnd );
+			if ( pOut && nNackBits == 3 )
+				pOut = SerializeVarInt( pOut, pBlock->m_nNack-3, pOutEnd );
+			if ( pOut == nullptr )
 			{
-				// Small block of packets.  Encode directly in the header.
-				*pAckBlockHeaderByte = uint8(pBlock->m_nAck << 4);
+				AssertMsg( false, "Overflow serializing packed ack block" );
+				return nullptr;
 			}
-			else
+		}
+		else
+		{
+			// Encode ACK (number of packets successfully received)
 			{
-				// Larger block of received packets.  Put lowest bits in the header,
-				// and overflow using varint.  This is probably going to be pretty
-				// common.
-				*pAckBlockHeaderByte = 0x80 | ( uint8(pBlock->m_nAck & 7) << 4 );
-				pOut = SerializeVarInt( pOut, pBlock->m_nAck>>3, pOutEnd );
-				if ( pOut == nullptr )
+				if ( pBlock->m_nAck < 8 )
+				{
+					// Small block of packets.  Encode directly in the header.
+					*pAckBlockHeaderByte = uint8(pBlock->m_nAck << 4);
+				}
+				else
 				{
-					AssertMsg( false, "Overflow serializing packet ack varint count" );
-					return nullptr;
+					// Larger block of received packets.  Put lowest bits in the header,
+					// and overflow using varint.  This is probably going to be pretty
+					// common.
+					*pAckBlockHeaderByte = 0x80 | ( uint8(pBlock->m_nAck & 7) << 4 );
+					pOut = SerializeVarInt( pOut, pBlock->m_nAck>>3, pOutEnd );
+					if ( pOut == nullptr )
+					{
+						AssertMsg( false, "Overflow serializing packet ack varint count" );
+						return nullptr;
+					}
 				}
 			}
-		}
 
-		// Encode NACK (number of packets dropped)
-		{
-			if ( pBlock->m_nNack < 8 )
+			// Encode NACK (number of packets dropped)
 			{
-				// Small block of packets.  Encode directly in the header.
-				*pAckBlockHeaderByte |= uint8(pBlock->m_nNack);
-			}
-			else
-			{
-				// Larger block of dropped packets.  Put lowest bits in the header,
-				// and overflow using varint.  This is probably going to be less common than
-				// large ACK runs, but not totally uncommon.  Losing one or two packets is
-				// really common, but loss events often involve a lost of many packets in a run.
-				*pAckBlockHeaderByte |= 0x08 | uint8(pBlock->m_nNack & 7);
-				pOut = SerializeVarInt( pOut, pBlock->m_nNack >> 3, pOutEnd );
-				if ( pOut == nullptr )
+				if ( pBlock->m_nNack < 8 )
+				{
+					// Small block of packets.  Encode directly in the header.
+					*pAckBlockHeaderByte |= uint8(pBlock->m_nNack);
+				}
+				else
 				{
-					AssertMsg( false, "Overflow serializing packet nack varint count" );
-					return nullptr;
+					// Larger block of dropped packets.  Put lowest bits in the header,
+					// and overflow using varint.  This is probably going to be less common than
+					// large ACK runs, but not totally uncommon.  Losing one or two packets is
+					// really common, but loss events often involve a lost of many packets in a run.
+					*pAckBlockHeaderByte |= 0x08 | uint8(pBlock->m_nNack & 7);
+					pOut = SerializeVarInt( pOut, pBlock->m_nNack >> 3, pOutEnd );
+					if ( pOut == nullptr )
+					{
+						AssertMsg( false, "Overflow serializing packet nack varint count" );
+						return nullptr;
+					}
 				}
 			}
 		}
@@ -3208,6 +4391,152 @@ uint8 *CSteamNetworkConnectionBase::SNP_SerializeAckBlocks( const SNPPacketSeria
 	return pOut;
 }
 
+void CSteamNetworkConnectionBase::SNP_FECAddMessage( int idxLane, const CSteamNetworkingMessage *pMsg )
+{
+	SSNPSenderState::Lane::FECGroup &fec = m_senderState.m_vecLanes[ idxLane ].m_fec;
+
+	// Still waiting to send parity for the previous group?
+	if ( fec.m_bReady )
+		return;
+
+	// Start a new group?
+	if ( fec.m_nMessages == 0 )
+	{
+
+		// XOR parity can only repair one loss per group.  Size the group
+		// so that we expect a loss in about one out of every five groups,
+		// using the packet loss the peer reported.
+		float flLoss = m_statsEndToEnd.m_latestRemote.m_flPacketsDroppedPct;
+		if ( flLoss < 0.0f )
+			fec.m_nTargetSize = k_nMaxFECGroupSize/2; // No measurement yet
+		else if ( flLoss*k_nMaxFECGroupSize < 0.2f )
+			fec.m_nTargetSize = k_nMaxFECGroupSize;
+		else
+			fec.m_nTargetSize = std::max( k_nMinFECGroupSize, int( 0.2f / flLoss ) );
+
+		fec.m_parity.resize( k_cbMaxFECMessageSize );
+		memset( fec.m_parity.data(), 0, k_cbMaxFECMessageSize );
+		fec.m_cbParity = 0;
+	}
+
+	Assert( pMsg->m_cbSize <= k_cbMaxFECMessageSize );
+	const uint8 *pData = (const uint8 *)pMsg->m_pData;
+	for ( int i = 0 ; i < pMsg->m_cbSize ; ++i )
+		fec.m_parity[i] ^= pData[i];
+	fec.m_cbParity = std::max( fec.m_cbParity, pMsg->m_cbSize );
+
+	Assert( fec.m_nMessages == 0 || pMsg->m_nMessageNumber > fec.m_arMsgNum[ fec.m_nMessages-1 ] );
+	fec.m_arMsgNum[ fec.m_nMessages ] = pMsg->m_nMessageNumber;
+	fec.m_arMsgSize[ fec.m_nMessages ] = pMsg->m_cbSize;
+	++fec.m_nMessages;
+	if ( fec.m_nMessages >= fec.m_nTargetSize )
+		fec.m_bReady = true;
+}
+
+uint8 *CSteamNetworkConnectionBase::SNP_SerializeFECParityFrames( uint8 *pOut, int &cbRemaining )
+{
+	for ( int idxLane = 0 ; idxLane < len( m_senderState.m_vecLanes ) ; ++idxLane )
+	{
+		SSNPSenderState::Lane::FECGroup &fec = m_senderState.m_vecLanes[ idxLane ].m_fec;
+		if ( !fec.m_bReady )
+			continue;
+
+		// Will it fit?
+		int cbFrame = 1 + VarIntSerializedSize( (uint32)idxLane ) + 4 + 1 + fec.m_cbParity;
+		for ( int i = 0 ; i < fec.m_nMessages ; ++i )
+		{
+			if ( i > 0 )
+				cbFrame += VarIntSerializedSize( uint64( fec.m_arMsgNum[i] - fec.m_arMsgNum[i-1] ) );
+			cbFrame += VarIntSerializedSize( (uint32)fec.m_arMsgSize[i] );
+		}
+		if ( cbFrame > cbRemaining )
+			continue;
+
+		SpewVerboseGroup( m_connectionConfig.LogLevel_PacketDecode.Get(), "[%s]   encode pkt %lld FEC lane %d msgs %lld-%lld parity %d\n",
+			GetDescription(), (long long)m_statsEndToEnd.m_nNextSendSequenceNumber, idxLane,
+			(long long)fec.m_arMsgNum[0], (long long)fec.m_arMsgNum[ fec.m_nMessages-1 ], fec.m_cbParity );
+
+		uint8 *pFrameEnd = pOut + cbFrame;
+		*(pOut++) = 0xa0;
+		pOut = SerializeVarInt( pOut, (uint32)idxLane );
+		*(uint32*)pOut = LittleDWord( (uint32)fec.m_arMsgNum[0] ); pOut += 4;
+		*(pOut++) = (uint8)fec.m_nMessages;
+		for ( int i = 0 ; i < fec.m_nMessages ; ++i )
+		{
+			if ( i > 0 )
+				pOut = SerializeVarInt( pOut, uint64( fec.m_arMsgNum[i] - fec.m_arMsgNum[i-1] ) );
+			pOut = SerializeVarInt( pOut, (uint32)fec.m_arMsgSize[i] );
+		}
+		memcpy( pOut, fec.m_parity.data(), fec.m_cbParity ); pOut += fec.m_cbParity;
+		Assert( pOut == pFrameEnd );
+		cbRemaining -= cbFrame;
+
+		fec.m_bReady = false;
+		fec.m_nMessages = 0;
+		++m_senderState.m_nFECParityFramesSent;
+	}
+	return pOut;
+}
+
+uint8 *CSteamNetworkConnectionBase::SNP_SerializeAckFrequencyFrame( SNPPacketSerializeHelper &helper, uint8 *pOut )
+{
+	// Peer doesn't understand it, or we don't know the RTT yet?
+	if ( m_statsEndToEnd.m_nPeerProtocolVersion < 16 || m_statsEndToEnd.m_ping.m_nSmoothedPing < 0 )
+		return pOut;
+	const SteamNetworkingMicroseconds usecNow = helper.UsecNow();
+
+	// Ask for acks about 4 times per RTT.  Never ask for a shorter delay
+	// than the default.  That's plenty for a short RTT, anything less would
+	// just mean more ack-only packets.
+	SteamNetworkingMicroseconds usecMaxDelay = (SteamNetworkingMicroseconds)m_statsEndToEnd.m_ping.m_nSmoothedPing * 250;
+	usecMaxDelay = std::max( k_usecMaxDataAckDelay, std::min( k_usecMaxAckFrequencyDelay, usecMaxDelay ) );
+
+	// Ask them to ack right away once they have received about twice as
+	// many full packets as we expect to send in that time.  When we send
+	// at a steady rate, the timer will go off first.  This just limits how
+	// much a single ack covers when we send a burst.
+	const float flPktsPerSec = m_sendRateData.m_flCurrentSendRateUsed / (float)m_cbMTUPacketSize;
+	int nThreshold = std::max( k_nMinAckFrequencyThreshold, (int)( flPktsPerSec * (float)usecMaxDelay * 2e-6f ) );
+	nThreshold = std::min( nThreshold, 0x10000 );
+
+	// Only send a new request if something changed by more than 25%,
+	// or our last request seems to have been lost
+	auto BChanged = []( int64 a, int64 b ) { return a*4 < b*3 || b*4 < a*3; };
+	if (
+		m_senderState.m_nAckFrequencySeq > 0
+		&& !BChanged( usecMaxDelay, m_senderState.m_usecAckFrequencyMaxDelay )
+		&& !BChanged( nThreshold, m_senderState.m_nAckFrequencyThreshold )
+	) {
+		if ( m_senderState.m_nAckFrequencyPktNum == 0 )
+			return pOut;
+		if ( usecNow < m_senderState.m_usecAckFrequencySent + m_statsEndToEnd.CalcSenderRetryTimeout( m_senderState.PeerMaxAckDelay() ) )
+			return pOut;
+	}
+
+	// Will it fit?
+	const uint64 nSeq = m_senderState.m_nAckFrequencySeq + 1;
+	int cbFrame = 1 + VarIntSerializedSize( nSeq ) + VarIntSerializedSize( (uint32)nThreshold ) + VarIntSerializedSize( (uint32)usecMaxDelay );
+	if ( pOut + cbFrame > helper.m_pPayloadEnd )
+		return pOut;
+
+	SpewVerboseGroup( helper.m_nLogLevelPacketDecode, "[%s]   encode pkt %lld ack freq #%llu threshold %d max delay %lldusec\n",
+		GetDescription(), (long long)helper.m_insertInflightPkt.first, (unsigned long long)nSeq, nThreshold, (long long)usecMaxDelay );
+
+	*(pOut++) = 0xa1;
+	pOut = SerializeVarInt( pOut, nSeq );
+	pOut = SerializeVarInt( pOut, (uint32)nThreshold );
+	pOut = SerializeVarInt( pOut, (uint32)usecMaxDelay );
+
+	// Until they ack this packet, they might still be using the old delay
+	m_senderState.m_usecAckFrequencyMaxDelayPrev = m_senderState.PeerMaxAckDelay();
+	m_senderState.m_usecAckFrequencyMaxDelay = usecMaxDelay;
+	m_senderState.m_nAckFrequencyThreshold = nThreshold;
+	m_senderState.m_nAckFrequencySeq = nSeq;
+	m_senderState.m_nAckFrequencyPktNum = helper.m_insertInflightPkt.first;
+	m_senderState.m_usecAckFrequencySent = usecNow;
+	return pOut;
+}
+
 inline uint8 *CSteamNetworkConnectionBase::SNP_SerializeStopWaitingFrame( SNPPacketSerializeHelper &helper, uint8 *pOut )
 {
 	// For now, we will always write this.  We should optimize this and try to be
@@ -3271,6 +4600,77 @@ inline uint8 *CSteamNetworkConnectionBase::SNP_SerializeStopWaitingFrame( SNPPac
 	return pOut;
 }
 
+void CSteamNetworkConnectionBase::SNP_ReceiveFECParity( int idxLane, int nMessages, const int64 *arMsgNum, const int *arMsgSize, const uint8 *pParity, int cbParity, SteamNetworkingMicroseconds usecNow )
+{
+	SSNPReceiverState::Lane &lane = m_receiverState.m_vecLanes[ idxLane ];
+
+	// First parity on this lane?  Start remembering messages, so
+	// that we can use the next one.
+	if ( lane.m_nFECMinMsgNum == 0 )
+	{
+		lane.m_vecFECRecent.resize( k_nFECRecvHistory );
+		lane.m_nFECMinMsgNum = std::max( lane.m_nHighestSeenMsgNum, arMsgNum[ nMessages-1 ] ) + 1;
+		return;
+	}
+
+	// Ignore data when we are not going to process it (e.g. linger)
+	if ( GetState() != k_ESteamNetworkingConnectionState_Connected )
+		return;
+
+	// We can rebuild a message only if it's the only one from the group we don't have
+	const SSNPReceiverState::Lane::FECRecentMsg *arHave[ k_nMaxFECGroupSize ];
+	int idxMissing = -1;
+	for ( int i = 0 ; i < nMessages ; ++i )
+	{
+		// Too old, we don't know if we received it or not?
+		if ( arMsgNum[i] < lane.m_nFECMinMsgNum )
+			return;
+
+		arHave[i] = lane.FECFindMessage( arMsgNum[i] );
+		if ( arHave[i] )
+		{
+			if ( arHave[i]->m_cbSize != arMsgSize[i] )
+			{
+				SpewWarningRateLimited( usecNow, "[%s] FEC parity says msg %lld is %d bytes, but we received %d\n",
+					GetDescription(), (long long)arMsgNum[i], arMsgSize[i], arHave[i]->m_cbSize );
+				return;
+			}
+		}
+		else
+		{
+			if ( idxMissing >= 0 )
+				return;
+			idxMissing = i;
+		}
+	}
+	if ( idxMissing < 0 )
+		return;
+
+	// XOR the parity with all of the other messages
+	const int cbMsg = arMsgSize[ idxMissing ];
+	Assert( cbMsg <= cbParity );
+	uint8 msg[ k_cbMaxFECMessageSize ];
+	memcpy( msg, pParity, cbMsg );
+	for ( int i = 0 ; i < nMessages ; ++i )
+	{
+		if ( i == idxMissing )
+			continue;
+		const int cbXOR = std::min( cbMsg, arHave[i]->m_cbSize );
+		for ( int j = 0 ; j < cbXOR ; ++j )
+			msg[j] ^= arHave[i]->m_data[j];
+	}
+
+	const int64 nMsgNum = arMsgNum[ idxMissing ];
+	SpewVerboseGroup( m_connectionConfig.LogLevel_PacketDecode.Get(), "[%s] FEC recovered msg %lld (%d bytes) on lane %d\n",
+		GetDescription(), (long long)nMsgNum, cbMsg, idxLane );
+	lane.FECRememberMessage( nMsgNum, msg, cbMsg, true );
+	if ( nMsgNum > lane.m_nHighestSeenMsgNum )
+		lane.m_nHighestSeenMsgNum = nMsgNum;
+	++m_receiverState.m_nFECMessagesRecovered;
+
+	SNP_ReceivedMessageData( msg, cbMsg, idxLane, nMsgNum, k_nSteamNetworkingSend_Unreliable, usecNow );
+}
+
 bool CSteamNetworkConnectionBase::SNP_ReceiveUnreliableSegment(
 	int64 nMsgNum,
 	int nOffset,
@@ -3292,28 +4692,37 @@ bool CSteamNetworkConnectionBase::SNP_ReceiveUnreliableSegment(
 		return false;
 	}
 
+	SSNPReceiverState::Lane &lane = m_receiverState.m_vecLanes[ idxLane ];
+
 	// Check for a common special case: non-fragmented message.
 	if ( nOffset == 0 && bLastSegmentInMessage )
 	{
 
+		// If the peer is sending FEC on this lane, remember the message.
+		// If we already rebuilt it from parity, this is a duplicate.
+		if ( lane.m_nFECMinMsgNum > 0 && nMsgNum >= lane.m_nFECMinMsgNum && cbSegmentSize <= k_cbMaxFECMessageSize )
+		{
+			if ( !lane.FECRememberMessage( nMsgNum, pSegmentData, cbSegmentSize, false ) )
+			{
+				SpewDebugGroup( m_connectionConfig.LogLevel_PacketDecode.Get(), "[%s] discarding msg %lld, already have it\n", GetDescription(), nMsgNum );
+				return true;
+			}
+		}
+
 		// Deliver it immediately, don't go through the fragmentation assembly process below.
 		// (Although that would work.)
-		return ReceivedMessageData( pSegmentData, cbSegmentSize, idxLane, nMsgNum, k_nSteamNetworkingSend_Unreliable, usecNow );
+		return SNP_ReceivedMessageData( pSegmentData, cbSegmentSize, idxLane, nMsgNum, k_nSteamNetworkingSend_Unreliable, usecNow );
 	}
-	SSNPReceiverState::Lane &lane = m_receiverState.m_vecLanes[ idxLane ];
 
 	// Limit number of unreliable segments we store.  We just use a fixed
 	// limit, rather than trying to be smart by expiring based on time or whatever.
-	if ( len( lane.m_mapUnreliableSegments ) > k_nMaxBufferedUnreliableSegments )
+	if ( len( lane.m_vecUnreliableFragments ) > k_nMaxBufferedUnreliableSegments )
 	{
-		auto itDelete = lane.m_mapUnreliableSegments.begin();
 
 		// If we're going to delete some, go ahead and delete all of them for this
-		// message.
-		int64 nDeleteMsgNum = itDelete->first.m_nMsgNum;
-		do {
-			itDelete = lane.m_mapUnreliableSegments.erase( itDelete );
-		} while ( itDelete != lane.m_mapUnreliableSegments.end() && itDelete->first.m_nMsgNum == nDeleteMsgNum );
+		// message.  The list is sorted, so the first one is the oldest message.
+		int64 nDeleteMsgNum = lane.m_vecUnreliableFragments[0].m_nMsgNum;
+		lane.UnreliableDiscardMessage( nDeleteMsgNum );
 
 		// Warn if the message we are receiving is older (or the same) than the one
 		// we are deleting.  If sender is legit, then it probably means that we have
@@ -3326,19 +4735,26 @@ bool CSteamNetworkConnectionBase::SNP_ReceiveUnreliableSegment(
 		}
 	}
 
-	// Message fragment.  Find/insert the entry in our reassembly queue
-	// I really hate this syntax and interface.
-	SSNPRecvUnreliableSegmentKey key;
-	key.m_nMsgNum = nMsgNum;
-	key.m_nOffset = nOffset;
-	SSNPRecvUnreliableSegmentData &data = lane.m_mapUnreliableSegments[ key ];
-	if ( data.m_cbSegSize >= 0 )
+	// Message fragment.  Locate the fragments we already have for this message,
+	// and where this one goes in the list
+	SSNPRecvUnreliableFragment frag;
+	frag.m_nMsgNum = nMsgNum;
+	frag.m_nOffset = 0;
+	const int idxMsgStart = int( std::lower_bound( lane.m_vecUnreliableFragments.begin(), lane.m_vecUnreliableFragments.end(), frag ) - lane.m_vecUnreliableFragments.begin() );
+	frag.m_nOffset = nOffset;
+	frag.m_cbSize = cbSegmentSize;
+	frag.m_nArenaOffset = -1;
+	frag.m_bLast = bLastSegmentInMessage;
+	const int idxInsert = int( std::lower_bound( lane.m_vecUnreliableFragments.begin() + idxMsgStart, lane.m_vecUnreliableFragments.end(), frag ) - lane.m_vecUnreliableFragments.begin() );
+	if ( idxInsert < len( lane.m_vecUnreliableFragments ) && lane.m_vecUnreliableFragments[ idxInsert ].m_nMsgNum == nMsgNum && lane.m_vecUnreliableFragments[ idxInsert ].m_nOffset == nOffset )
 	{
+		const SSNPRecvUnreliableFragment &dup = lane.m_vecUnreliableFragments[ idxInsert ];
+
 		// We got another segment starting at the same offset.  This is weird, since they shouldn't
 		// be doing.  But remember that we're working on top of UDP, which could deliver packets
 		// multiple times.  We'll spew about it, just in case it indicates a bug in this code or the sender.
 		SpewWarningRateLimited( usecNow, "[%s] Received unreliable msg %lld segment offset %d twice.  Sizes %d,%d, last=%d,%d\n",
-			GetDescription(), nMsgNum, nOffset, data.m_cbSegSize, cbSegmentSize, (int)data.m_bLast, (int)bLastSegmentInMessage );
+			GetDescription(), nMsgNum, nOffset, dup.m_cbSize, cbSegmentSize, (int)dup.m_bLast, (int)bLastSegmentInMessage );
 
 		// Just drop the segment.  Note that the sender might have sent a longer segment from the previous
 		// one, in which case this segment contains new data, and is not therefore redundant.  That seems
@@ -3350,75 +4766,112 @@ bool CSteamNetworkConnectionBase::SNP_ReceiveUnreliableSegment(
 		return true;
 	}
 
-	// Segment in the map either just got inserted, or is a subset of the segment
-	// we just received.  Replace it.
-	data.m_cbSegSize = cbSegmentSize;
-	Assert( !data.m_bLast );
-	data.m_bLast = bLastSegmentInMessage;
-	memcpy( data.m_buf, pSegmentData, cbSegmentSize );
-
-	// Now check if that completed the message
-	key.m_nOffset = 0;
-	auto itMsgStart = lane.m_mapUnreliableSegments.lower_bound( key );
-	auto end = lane.m_mapUnreliableSegments.end();
-	Assert( itMsgStart != end );
-	auto itMsgLast = itMsgStart;
-	int cbMessageSize = 0;
-	for (;;)
+	// Do we know how big the message is?
+	CSteamNetworkingMessage *pMsg = lane.UnreliableFindMsgBuffer( nMsgNum );
+	if ( pMsg )
 	{
-		// Is this the thing we expected?
-		if ( itMsgLast->first.m_nMsgNum != nMsgNum || itMsgLast->first.m_nOffset > cbMessageSize )
+		// We already have the last segment.  This one must fit before it.
+		if ( bLastSegmentInMessage || nOffset + cbSegmentSize > (int)pMsg->m_cbSize )
 		{
-			// We've got a gap.  We'll need to wait to fill it.  For now, we're done.
+			SpewWarningRateLimited( usecNow, "[%s] Ignoring unreliable msg %lld segment [%d,%d) last=%d, msg size is %d\n",
+				GetDescription(), nMsgNum, nOffset, nOffset+cbSegmentSize, (int)bLastSegmentInMessage, (int)pMsg->m_cbSize );
 			return true;
 		}
+		memcpy( (uint8 *)pMsg->m_pData + nOffset, pSegmentData, cbSegmentSize );
+	}
+	else if ( bLastSegmentInMessage )
+	{
+
+		// Now we know the size.  Make sure the segments we already have agree
+		const int cbMessageSize = nOffset + cbSegmentSize;
+		for ( int i = idxMsgStart ; i < len( lane.m_vecUnreliableFragments ) && lane.m_vecUnreliableFragments[i].m_nMsgNum == nMsgNum ; ++i )
+		{
+			const SSNPRecvUnreliableFragment &f = lane.m_vecUnreliableFragments[i];
+			if ( f.m_nOffset + f.m_cbSize > cbMessageSize )
+			{
+				SpewWarningRateLimited( usecNow, "[%s] Ignoring unreliable msg %lld last segment [%d,%d), we already have [%d,%d)\n",
+					GetDescription(), nMsgNum, nOffset, cbMessageSize, f.m_nOffset, f.m_nOffset+f.m_cbSize );
+				return true;
+			}
+		}
 
-		// Update.  This code looks more complicated than strictly necessary, but it works
-		// if we have overlapping segments.
-		cbMessageSize = std::max( cbMessageSize, itMsgLast->first.m_nOffset + itMsgLast->second.m_cbSegSize );
+		pMsg = AllocateNewRecvMessage( cbMessageSize, k_nSteamNetworkingSend_Unreliable, usecNow );
+		if ( !pMsg )
+			return false;
 
-		// Is that the end?
-		if ( itMsgLast->second.m_bLast )
-			break;
+		// Record the message number
+		pMsg->m_nMessageNumber = nMsgNum;
+		pMsg->m_idxLane = idxLane;
 
-		// Still looking for the end
-		++itMsgLast;
-		if ( itMsgLast == end )
+		// Move the segments we already have out of the arena,
+		// and put this one directly into the message
+		bool bUsedArena = false;
+		for ( int i = idxMsgStart ; i < len( lane.m_vecUnreliableFragments ) && lane.m_vecUnreliableFragments[i].m_nMsgNum == nMsgNum ; ++i )
 		{
-
-			// We expect more segments in this message to follow.  For now, we're done.
-			return true;
+			SSNPRecvUnreliableFragment &f = lane.m_vecUnreliableFragments[i];
+			Assert( f.m_nArenaOffset >= 0 );
+			memcpy( (uint8 *)pMsg->m_pData + f.m_nOffset, lane.m_bufUnreliableArena.data() + f.m_nArenaOffset, f.m_cbSize );
+			f.m_nArenaOffset = -1;
+			bUsedArena = true;
 		}
+		memcpy( (uint8 *)pMsg->m_pData + nOffset, pSegmentData, cbSegmentSize );
+		lane.m_vecUnreliableMsgBuffers.push_back( SSNPRecvUnreliableMsgBuffer{ nMsgNum, pMsg } );
+		if ( bUsedArena )
+			lane.UnreliableCompactArena();
+	}
+	else
+	{
+		// We don't know how big the message is yet.  Stash the data in the arena.
+		frag.m_nArenaOffset = len( lane.m_bufUnreliableArena );
+		lane.m_bufUnreliableArena.insert( lane.m_bufUnreliableArena.end(), (const uint8 *)pSegmentData, (const uint8 *)pSegmentData + cbSegmentSize );
 	}
+	lane.m_vecUnreliableFragments.insert( lane.m_vecUnreliableFragments.begin() + idxInsert, frag );
 
-	CSteamNetworkingMessage *pMsg = AllocateNewRecvMessage( cbMessageSize, k_nSteamNetworkingSend_Unreliable, usecNow );
+	// We can't be done until we have the last segment
 	if ( !pMsg )
-		return false;
-
-	// Record the message number
-	pMsg->m_nMessageNumber = nMsgNum;
-	pMsg->m_idxLane = idxLane;
+		return true;
 
-	// OK, we have the complete message!  Gather the
-	// segments into a contiguous buffer
-	for (;;)
+	// Now check if that completed the message.  Remember that the
+	// last segment ends exactly at the end of the message.
+	int cbCovered = 0;
+	int idxMsgEnd = idxMsgStart;
+	for ( ; idxMsgEnd < len( lane.m_vecUnreliableFragments ) && lane.m_vecUnreliableFragments[ idxMsgEnd ].m_nMsgNum == nMsgNum ; ++idxMsgEnd )
 	{
-		Assert( itMsgStart->first.m_nMsgNum == nMsgNum );
-		memcpy( (char *)pMsg->m_pData + itMsgStart->first.m_nOffset, itMsgStart->second.m_buf, itMsgStart->second.m_cbSegSize );
+		const SSNPRecvUnreliableFragment &f = lane.m_vecUnreliableFragments[ idxMsgEnd ];
+		if ( f.m_nOffset > cbCovered )
+		{
+			// We've got a gap.  We'll need to wait to fill it.  For now, we're done.
+			return true;
+		}
 
-		// Done?
-		if ( itMsgStart->second.m_bLast )
-			break;
+		// This works if we have overlapping segments
+		cbCovered = std::max( cbCovered, f.m_nOffset + f.m_cbSize );
+	}
+	Assert( cbCovered == (int)pMsg->m_cbSize );
 
-		// Remove entry from list, and move onto the next entry
-		itMsgStart = lane.m_mapUnreliableSegments.erase( itMsgStart );
+	// OK, we have the complete message!  It's already assembled in the
+	// buffer, we just need to forget about the pieces.  None of them
+	// are using the arena.
+	lane.m_vecUnreliableFragments.erase( lane.m_vecUnreliableFragments.begin() + idxMsgStart, lane.m_vecUnreliableFragments.begin() + idxMsgEnd );
+	for ( int i = 0 ; i < len( lane.m_vecUnreliableMsgBuffers ) ; ++i )
+	{
+		if ( lane.m_vecUnreliableMsgBuffers[i].m_pMsg == pMsg )
+		{
+			erase_at( lane.m_vecUnreliableMsgBuffers, i );
+			break;
+		}
 	}
+	pMsg->m_usecTimeReceived = usecNow;
 
-	// Erase the last segment, and anything else we might have hanging around
-	// for this message (???)
-	do {
-		itMsgStart = lane.m_mapUnreliableSegments.erase( itMsgStart );
-	} while ( itMsgStart != end && itMsgStart->first.m_nMsgNum == nMsgNum );
+	// If it's compressed, we need to expand it into a new message.
+	// (The size limit was checked against the compressed size, but
+	// it will be checked again.)
+	if ( idxLane < 32 && ( m_nCompressLanesRecv & ( 1u << idxLane ) ) )
+	{
+		bool bResult = SNP_ReceivedMessageData( pMsg->m_pData, pMsg->m_cbSize, idxLane, nMsgNum, k_nSteamNetworkingSend_Unreliable, usecNow );
+		pMsg->Release();
+		return bResult;
+	}
 
 	// Deliver the message.
 	return ReceivedMessage( pMsg );
@@ -3835,7 +5288,7 @@ bool CSteamNetworkConnectionBase::SNP_ReceiveReliableSegment( int64 nPktNum, int
 		}
 
 		// We have a full message!  Queue it
-		if ( !ReceivedMessageData( pReliableDecode, cbMsgSize, idxLane, nMsgNum, k_nSteamNetworkingSend_Reliable, usecNow ) )
+		if ( !SNP_ReceivedMessageData( pReliableDecode, cbMsgSize, idxLane, nMsgNum, k_nSteamNetworkingSend_Reliable, usecNow ) )
 		{
 			// Don't ack this packet!
 			return false;
@@ -3883,7 +5336,7 @@ void CSteamNetworkConnectionBase::SNP_RecordReceivedPktNum( int64 nPktNum, Steam
 		{
 			// Schedule ack of this packet (since we are the highest numbered
 			// packet, that means reporting on everything)
-			QueueFlushAllAcks( usecNow + k_usecMaxDataAckDelay );
+			QueueFlushAllAcks( m_receiverState.TimeWhenAckReliablePkt( usecNow ) );
 		}
 		return;
 	}
@@ -3893,7 +5346,7 @@ void CSteamNetworkConnectionBase::SNP_RecordReceivedPktNum( int64 nPktNum, Steam
 
 	// Latest time that this packet should be acked.
 	// (We might already be scheduled to send and ack that would include this packet.)
-	SteamNetworkingMicroseconds usecScheduleAck = bScheduleAck ? usecNow + k_usecMaxDataAckDelay : INT64_MAX;
+	SteamNetworkingMicroseconds usecScheduleAck = bScheduleAck ? m_receiverState.TimeWhenAckReliablePkt( usecNow ) : INT64_MAX;
 
 	// Check if this introduced a gap since the last sequence packet we have received
 	if ( nPktNum > nExpectedNextPktNum )
@@ -4312,6 +5765,7 @@ SteamNetworkingMicroseconds CSteamNetworkConnectionBase::SNP_ThinkSendState( Ste
 	// Calculate next time we want to take action.  If it isn't right now, then we're either idle or throttled.
 	// Importantly, this will also check for retry timeout
 	SteamNetworkingMicroseconds usecNextThink = SNP_GetNextThinkTime( usecNow );
+	SNP_UpdateSendLimitState( usecNow );
 	if ( usecNextThink > usecNow )
 		return usecNextThink;
 
@@ -4343,6 +5797,7 @@ SteamNetworkingMicroseconds CSteamNetworkConnectionBase::SNP_ThinkSendState( Ste
 			// Problem sending packet.  Nuke token bucket, but request
 			// a wakeup relatively quick to check on our state again
 			m_sendRateData.m_flTokenBucket = m_sendRateData.m_flCurrentSendRateUsed * -0.001f;
+			SNP_UpdateSendLimitState( usecNow );
 			return usecNow + 2000;
 		}
 
@@ -4358,6 +5813,7 @@ SteamNetworkingMicroseconds CSteamNetworkConnectionBase::SNP_ThinkSendState( Ste
 			// We don't want the outer code to complain that we are requesting
 			// a wakeup call in the past
 			m_sendRateData.m_flTokenBucket = m_sendRateData.m_flCurrentSendRateUsed * -0.0005f;
+			SNP_UpdateSendLimitState( usecNow );
 			return usecNow + 1000;
 		}
 	}
@@ -4365,6 +5821,7 @@ SteamNetworkingMicroseconds CSteamNetworkConnectionBase::SNP_ThinkSendState( Ste
 	// Return time when we need to check in again.
 	SteamNetworkingMicroseconds usecNextAction = SNP_GetNextThinkTime( usecNow );
 	Assert( usecNextAction > usecNow );
+	SNP_UpdateSendLimitState( usecNow );
 	return usecNextAction;
 }
 
@@ -4393,6 +5850,14 @@ void CSteamNetworkConnectionBase::SNP_TokenBucket_Accumulate( SteamNetworkingMic
 	}
 }
 
+SteamNetworkingMicroseconds SSNPReceiverState::TimeWhenAckReliablePkt( SteamNetworkingMicroseconds usecNow )
+{
+	++m_nAckElicitingSinceFlush;
+	if ( m_nAckThreshold > 0 && m_nAckElicitingSinceFlush >= m_nAckThreshold )
+		return k_nThinkTime_ASAP;
+	return usecNow + m_usecMaxAckDelay;
+}
+
 void SSNPReceiverState::QueueFlushAllAcks( SteamNetworkingMicroseconds usecWhen )
 {
 	DebugCheckPacketGapMap();
@@ -4632,6 +6097,8 @@ void CSteamNetworkConnectionBase::SNP_PopulateRealTimeStatus( SteamNetConnection
 		d.m_cbPendingUnreliable = s.m_cbPendingUnreliable;
 		d.m_cbPendingReliable = s.m_cbPendingReliable;
 		d.m_cbSentUnackedReliable = s.m_cbSentUnackedReliable;
+		d.m_nUnreliableExpired = s.m_nUnreliableExpired;
+		d.m_nUnreliableCoalesced = s.m_nUnreliableCoalesced;
 		d.m_usecQueueTime = INT64_MAX; // Assume for now
 	}
 
@@ -4695,6 +6162,24 @@ void CSteamNetworkConnectionBase::SNP_PopulateRealTimeStatus( SteamNetConnection
 	// of the same priority class.
 	LaneSort_t *pLaneSort = (LaneSort_t *)alloca( m_senderState.m_vecLanes.size() * sizeof(LaneSort_t) );
 
+	// Lanes with a latency target are serviced ahead of everything else.
+	// Treat them as a single batch that must all drain first.
+	if ( m_senderState.m_bAnyLaneDeadlines )
+	{
+		int cbPendingDeadlineLanes = 0;
+		for ( const SSNPSenderState::Lane &l: m_senderState.m_vecLanes )
+		{
+			if ( l.m_usecLatencyTarget > 0 )
+				cbPendingDeadlineLanes += l.m_cbPendingReliable + l.m_cbPendingUnreliable;
+		}
+		usecQueueTime += (SteamNetworkingMicroseconds)( cbPendingDeadlineLanes * flBytesToMicroseconds );
+		for ( int idxLane = 0 ; idxLane < nLanes ; ++idxLane )
+		{
+			if ( m_senderState.m_vecLanes[ idxLane ].m_usecLatencyTarget > 0 )
+				pLanes[ idxLane ].m_usecQueueTime = usecQueueTime;
+		}
+	}
+
 	// Process priority classes, in order
 	for ( const SSNPSenderState::PriorityClass &pc: m_senderState.m_vecPriorityClasses )
 	{
@@ -4710,6 +6195,8 @@ void CSteamNetworkConnectionBase::SNP_PopulateRealTimeStatus( SteamNetConnection
 		for ( int idxLane: pc.m_vecLaneIdx )
 		{
 			SSNPSenderState::Lane &l = m_senderState.m_vecLanes[ idxLane ];
+			if ( l.m_usecLatencyTarget > 0 )
+				continue; // Already handled above
 			p->m_idxLane = idxLane;
 			p->m_nWeight = l.m_nWeight;
 			nTotalWeightActiveLanes += p->m_nWeight;
@@ -4787,6 +6274,93 @@ void CSteamNetworkConnectionBase::SNP_PopulateRealTimeStatus( SteamNetConnection
 #endif
 }
 
+void CSteamNetworkConnectionBase::SNP_UpdateSendLimitState( SteamNetworkingMicroseconds usecNow )
+{
+	// Charge elapsed time to the state we were in.  (Callers don't always
+	// agree exactly on the current time, so don't go backwards.)
+	SteamNetworkingMicroseconds usecElapsed = usecNow - m_senderState.m_usecSendLimitStateChanged;
+	if ( usecElapsed < 0 )
+		return;
+	switch ( m_senderState.m_eSendLimitState )
+	{
+		case SSNPSenderState::k_ESendLimitState_None:
+			break;
+		case SSNPSenderState::k_ESendLimitState_App:
+			m_senderState.m_usecAppLimited += usecElapsed;
+			break;
+		case SSNPSenderState::k_ESendLimitState_Rate:
+			m_senderState.m_usecRateLimited += usecElapsed;
+			break;
+	}
+	m_senderState.m_usecSendLimitStateChanged = usecNow;
+
+	// Which state are we in now?
+	if ( !BStateIsConnectedForWirePurposes() )
+		m_senderState.m_eSendLimitState = SSNPSenderState::k_ESendLimitState_None;
+	else if ( m_senderState.PendingBytesTotal() == 0 && m_senderState.m_listReadyRetryReliableRange.IsEmpty() )
+		m_senderState.m_eSendLimitState = SSNPSenderState::k_ESendLimitState_App;
+	else if ( m_sendRateData.m_flTokenBucket < 0.0f )
+		m_senderState.m_eSendLimitState = SSNPSenderState::k_ESendLimitState_Rate;
+	else
+		m_senderState.m_eSendLimitState = SSNPSenderState::k_ESendLimitState_None;
+}
+
+void CSteamNetworkConnectionBase::SNP_PopulateSNPStatus( SteamNetConnectionSNPStatus_t &status, SteamNetworkingMicroseconds usecNow )
+{
+	// Same limits used by SNP_ClampSendRate
+	status.m_nSendRateBytesPerSecond = SNP_ClampSendRate();
+	status.m_nSendRateMin = Clamp( m_connectionConfig.SendRateMin.Get(), 1024, 100*1024*1024 );
+	status.m_nSendRateMax = Clamp( m_connectionConfig.SendRateMax.Get(), status.m_nSendRateMin, 100*1024*1024 );
+
+	// Bring token bucket and time accounting up to date
+	SNP_TokenBucket_Accumulate( usecNow );
+	SNP_UpdateSendLimitState( usecNow );
+	status.m_flTokenBucket = m_sendRateData.m_flTokenBucket;
+	status.m_usecTimeUntilNextSend = m_sendRateData.CalcTimeUntilNextSend();
+
+	// Don't count the sentinel
+	status.m_nPacketsInFlight = std::max( 0, (int)m_senderState.m_mapInFlightPacketsByPktNum.size() - 1 );
+	status.m_cbPendingUnreliable = m_senderState.m_cbPendingUnreliable;
+	status.m_cbPendingReliable = m_senderState.m_cbPendingReliable;
+	status.m_cbSentUnackedReliable = m_senderState.m_cbSentUnackedReliable;
+
+	status.m_nReliableSegmentsSent = m_senderState.m_nReliableSegmentsSent;
+	status.m_nReliableSegmentsRetransmitted = m_senderState.m_nReliableSegmentsRetransmitted;
+	status.m_cbReliableRetransmitted = m_senderState.m_cbReliableRetransmitted;
+	status.m_nPacketsLostNack = m_senderState.m_nPacketsLostNack;
+	status.m_nPacketsLostRACK = m_senderState.m_nPacketsLostRACK;
+	status.m_nPacketsLostTimeout = m_senderState.m_nPacketsLostTimeout;
+	status.m_nTailLossProbes = m_senderState.m_nTailLossProbes;
+	status.m_nFECParityFramesSent = m_senderState.m_nFECParityFramesSent;
+	status.m_nFECMessagesRecovered = m_receiverState.m_nFECMessagesRecovered;
+	status.m_usecAppLimited = m_senderState.m_usecAppLimited;
+	status.m_usecRateLimited = m_senderState.m_usecRateLimited;
+	status.m_usecPeerAckDelayLast = m_senderState.m_usecPeerAckDelayLast;
+	status.m_usecPeerAckDelayMax = m_senderState.m_usecPeerAckDelayMax;
+	status.m_usecAckMaxDelay = m_receiverState.m_usecMaxAckDelay;
+	status.m_nAckThreshold = m_receiverState.m_nAckThreshold;
+	status.m_nAckOnlyPacketsSent = m_senderState.m_nAckOnlyPacketsSent;
+	status.m_nDataPacketsSent = m_senderState.m_nDataPacketsSent;
+	status.m_cbDataPayloadSent = m_senderState.m_cbDataPayloadSent;
+
+	// Per-lane queue time, compression, and deadline stats
+	status.m_nLanes = len( m_senderState.m_vecLanes );
+	const int nLanes = std::min( status.m_nLanes, (int)SteamNetConnectionSNPStatus_t::k_nMaxLanes );
+	SteamNetConnectionRealTimeLaneStatus_t arLanes[ SteamNetConnectionSNPStatus_t::k_nMaxLanes ];
+	SNP_PopulateRealTimeStatus( nullptr, nLanes, arLanes, usecNow );
+	for ( int i = 0 ; i < nLanes ; ++i )
+	{
+		const SSNPSenderState::Lane &s = m_senderState.m_vecLanes[i];
+		status.m_usecLaneQueueTime[i] = arLanes[i].m_usecQueueTime;
+		status.m_cbLaneCompressedIn[i] = s.m_cbCompressedIn;
+		status.m_cbLaneCompressedOut[i] = s.m_cbCompressedOut;
+		status.m_usecLaneCompressTime[i] = s.m_usecCompressTime;
+		status.m_usecLaneDecompressTime[i] = i < len( m_receiverState.m_vecLanes ) ? m_receiverState.m_vecLanes[i].m_usecDecompressTime : 0;
+		status.m_nLaneDeadlineMessages[i] = s.m_nDeadlineMessages;
+		status.m_nLaneDeadlineMisses[i] = s.m_nDeadlineMisses;
+	}
+}
+
 bool CSteamNetworkConnectionBase::SNP_BHasAnyBufferedRecvData() const
 {
 	// !KLUDGE! Linear scan of all lanes!
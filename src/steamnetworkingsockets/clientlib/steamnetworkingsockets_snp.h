@@ -7,6 +7,11 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <memory>
+#include "lz4_block.h"
+#ifdef STEAMNETWORKINGSOCKETS_ENABLE_SNPTRACE
+	#include "steamnetworkingsockets_snptrace_format.h"
+#endif
 
 struct P2PSessionState_t;
 
@@ -14,6 +19,22 @@ namespace SteamNetworkingSocketsLib {
 
 struct LockDebugInfo;
 
+#ifdef STEAMNETWORKINGSOCKETS_ENABLE_SNPTRACE
+	/// Binary per-packet trace.  See steamnetworkingsockets_snptrace.cpp.
+	/// This is non-null while we are recording.  Check it before doing any
+	/// work to fill out a record.
+	extern SNPTraceFileHeader_t *g_pSNPTraceHeader;
+
+	/// Start recording, if the environment asks for it.  Requires the global lock.
+	extern void SNPTrace_Init();
+
+	/// Finish writing the trace and close the file.  Requires the global lock.
+	extern void SNPTrace_Shutdown();
+
+	/// Reserve the next record slot.  Fill it in, setting m_eDirection last.
+	extern SNPTraceRecord_t *SNPTrace_AllocRecord();
+#endif
+
 // Acks may be delayed.  This controls the precision used on the wire to encode the delay time.
 constexpr int k_nAckDelayPrecisionShift = 5;
 constexpr SteamNetworkingMicroseconds k_usecAckDelayPrecision = (1 << k_nAckDelayPrecisionShift );
@@ -33,6 +54,43 @@ constexpr SteamNetworkingMicroseconds k_usecAckDelayPrecision = (1 << k_nAckDela
 // balance between false positive and false negative rates.
 constexpr SteamNetworkingMicroseconds k_usecNackFlush = 3*1000;
 
+// Minimum for the 2xRTT part of the tail loss probe timeout, so
+// we don't fire spuriously on very low latency links.  (The peer's
+// max ack delay is added on top of this.)
+constexpr SteamNetworkingMicroseconds k_usecTailLossProbeMin = 10*1000;
+
+// Forward error correction for unreliable messages.  Only small messages that
+// are sent in a single segment are protected.  After each group of them we send
+// a parity frame which is the XOR of their payloads, which the receiver can use
+// to rebuild any one message from the group.  See k_ESteamNetworkingConfig_UnreliableFECLanes
+constexpr int k_cbMaxFECMessageSize = 512;
+constexpr int k_nMinFECGroupSize = 2;
+constexpr int k_nMaxFECGroupSize = 16;
+constexpr int k_nFECRecvHistory = 64; // How many recent messages the receiver remembers
+
+// Max latency target for a lane.  See ISteamNetworkingSockets::ConfigureConnectionLaneDeadlines
+constexpr int k_nMaxLaneLatencyTargetMS = 10*1000;
+
+// Message compression.  On lanes where it's enabled, each message starts
+// with a header byte: 0 = raw data follows, 1 = varint uncompressed size, then
+// an LZ4 block.  See k_ESteamNetworkingConfig_CompressionLanes
+constexpr uint8 k_nCompressedMsgHeader_Raw = 0;
+constexpr uint8 k_nCompressedMsgHeader_LZ4 = 1;
+
+/// A dictionary registered with ISteamNetworkingUtils::SetCompressionDictionary.
+/// Connections hold a reference to the one they are using, so the app can
+/// replace it without affecting them.
+struct CompressionDictionary_t
+{
+	int m_nID;
+	uint64 m_nHash; // First 8 bytes of the SHA-256 of the contents
+	CLZ4Dictionary m_dict;
+};
+
+// Max number of delivery receipts we will hold for the app.  If they
+// don't fetch them, we discard the oldest ones.
+constexpr int k_nMaxQueuedDeliveryReceipts = 4096;
+
 constexpr int k_nMaxReliableStreamGaps_Extend = 30; // Discard reliable data past the end of the stream, if it would cause us to get too many gaps
 constexpr int k_nMaxReliableStreamGaps_Fragment = 20; // Discard reliable data that is filling in the middle of a hole, if it would cause the number of gaps to exceed this number
 constexpr int k_nMaxPacketGaps = 62; // Don't bother tracking more than N gaps.  Instead, we will end up NACKing some packets that we actually did receive.  This should not break the protocol, but it protects us from malicious sender
@@ -64,6 +122,7 @@ COMPILE_TIME_ASSERT( k_cbMaxUnreliableMsgSizeRecv > k_cbMaxUnreliableMsgSizeSend
 class CSteamNetworkConnectionBase;
 class CConnectionTransport;
 struct SteamNetworkingMessageQueue;
+class CAppWakeHandle;
 
 /// We implement priority groups using Weighted Fair Queueing.
 /// https://en.wikipedia.org/wiki/Weighted_fair_queueing
@@ -100,6 +159,11 @@ public:
 	inline VirtualSendTime SNPSend_VirtualFinishTime() const { return m_nConnUserData; }
 	inline void SNPSend_SetVirtualFinishTime( VirtualSendTime x ) { m_nConnUserData = x; }
 
+	/// Messages on a lane with a latency target don't use the virtual
+	/// finish time.  Their deadline is stored there instead.
+	inline SteamNetworkingMicroseconds SNPSend_UsecDeadline() const { return m_nConnUserData; }
+	inline void SNPSend_SetUsecDeadline( SteamNetworkingMicroseconds x ) { m_nConnUserData = x; }
+
 	/// Offset in reliable stream of the header byte.  0 if we're not reliable.
 	inline int SNPSend_ReliableStreamSize() const
 	{
@@ -149,6 +213,12 @@ public:
 	/// Remove it from queues
 	void Unlink();
 
+	/// Options for outbound unreliable messages, set by SendMessagesWithOptions.
+	/// These are not in SteamNetworkingMessage_t, so that the public struct
+	/// doesn't grow.  0 means not used.
+	SteamNetworkingMicroseconds m_usecExpiry;
+	int64 m_nCoalesceKey;
+
 	struct Links
 	{
 		SteamNetworkingMessageQueue *m_pQueue;
@@ -184,7 +254,7 @@ struct SteamNetworkingMessageQueue
 	LockDebugInfo *m_pRequiredLock = nullptr; // Is there a lock that is required to be held while we access this queue?
 	int m_nMessageCount = 0;
 	int m_nMessageSize = 0;
-
+	CAppWakeHandle *m_pWake = nullptr; // Signaled when a message is added to the empty queue.  Created on demand, the owner must call FreeWake
 
 	inline bool empty() const
 	{
@@ -208,6 +278,16 @@ struct SteamNetworkingMessageQueue
 
 	/// Check the lock is held, if appropriate
 	void AssertLockHeld() const;
+
+	/// Get the handle the app can wait on, creating it if needed.  If the
+	/// queue already has messages, it is signaled right away.
+	SteamNetworkingWakeHandle GetWakeHandle();
+
+	/// Signal m_pWake.  Called when a message is added to the empty queue
+	void SignalWake();
+
+	/// Close the wake handle, if we created one
+	void FreeWake();
 };
 
 /// Max number of tokens we are allowed to store up in reserve, for a burst.
@@ -273,6 +353,21 @@ struct SNPInFlightPacket_t
 	/// these either due to multiple lanes or retransmission.
 	/// Each entry is a handle into m_listSentReliableSegments
 	vstd::small_vector<uint16,2> m_vecReliableSegments;
+
+	/// Unreliable messages sent with k_nSteamNetworkingSend_DeliveryReceipt
+	/// that had a segment in this packet.  Cleared once we have decided
+	/// whether the packet was delivered.
+	struct DeliveryReceiptRef
+	{
+		int64 m_nMsgNum;
+		int m_idxLane;
+	};
+	vstd::small_vector<DeliveryReceiptRef,1> m_vecDeliveryReceipts;
+
+	/// When using the compact encoding, the highest unreliable message number
+	/// we sent in this packet, for each lane.  (Reuses the same struct.)  Once
+	/// the packet is acked, we know the peer has seen at least that message.
+	vstd::small_vector<DeliveryReceiptRef,1> m_vecCompactMsgNums;
 };
 
 /// Info used by a sender to estimate the available bandwidth
@@ -345,6 +440,9 @@ struct SSNPSenderState
 	};
 	vstd::small_vector<PriorityClass,4<STEAMNETWORKINGSOCKETS_MAX_LANES ? 4 : STEAMNETWORKINGSOCKETS_MAX_LANES> m_vecPriorityClasses;
 
+	/// True if any lane has a latency target
+	bool m_bAnyLaneDeadlines = false;
+
 	/// Info we track for each lane
 	struct Lane
 	{
@@ -371,12 +469,55 @@ struct SSNPSenderState
 		/// How many bytes into the first message in the queue have we put on the wire?
 		int m_cbCurrentSendMessageSent = 0;
 
+		/// Highest unreliable message number that we know the peer has seen,
+		/// because it was in a packet that was acked.  The peer decodes an
+		/// abbreviated message number relative to the highest one it has seen,
+		/// so this tells us how many bits we need to send.  Only tracked when
+		/// we are using the compact encoding.
+		int64 m_nPeerHighestSeenMsgNumLowerBound = 0;
+
 		// Amount of buffered data in this lane
 		int m_cbPendingUnreliable = 0;
 		int m_cbPendingReliable = 0;
 		int m_cbSentUnackedReliable = 0;
 		inline int PendingBytesTotal() const { return m_cbPendingUnreliable + m_cbPendingReliable; }
 
+		// Unreliable messages discarded before we sent them
+		int64 m_nUnreliableExpired = 0;
+		int64 m_nUnreliableCoalesced = 0;
+
+		// Compression stats
+		int64 m_cbCompressedIn = 0;
+		int64 m_cbCompressedOut = 0;
+		SteamNetworkingMicroseconds m_usecCompressTime = 0;
+
+		/// Group of unreliable messages we are protecting with forward error
+		/// correction.  Once the group is full, we send the parity frame in the
+		/// next packet that has room for it.  Until then, we can't start a new group.
+		struct FECGroup
+		{
+			int m_nMessages = 0;
+			int m_nTargetSize = 0;
+			bool m_bReady = false;
+			int m_cbParity = 0;
+			int64 m_arMsgNum[ k_nMaxFECGroupSize ];
+			int m_arMsgSize[ k_nMaxFECGroupSize ];
+			std_vector<uint8> m_parity;
+		};
+		FECGroup m_fec;
+
+		/// Unreliable messages that want a delivery receipt, and have been at
+		/// least partially put on the wire, but we don't know the outcome yet.
+		/// Most messages fit in a single packet, but if they are fragmented,
+		/// we have to wait for all of the packets.
+		struct PendingDeliveryReceipt
+		{
+			int m_nPacketsInFlight = 0;
+			bool m_bAllSegmentsSent = false;
+			bool m_bReported = false; // We already reported it lost, waiting for other packets to be resolved
+		};
+		std_map<int64,PendingDeliveryReceipt> m_mapPendingDeliveryReceipts;
+
 		/// Multiplier used to calculate virtual finish time.
 		float m_flBytesToVirtualTime = 0.0f;
 
@@ -387,6 +528,15 @@ struct SSNPSenderState
 		/// Weight value they used.  This is only meaningful
 		/// relative to the other lanes with the same priority class
 		uint16 m_nWeight = 0;
+
+		/// Latency target, or 0 if none.  Lanes with a latency target are
+		/// sent earliest deadline first, ahead of all other lanes.
+		SteamNetworkingMicroseconds m_usecLatencyTarget = 0;
+
+		/// Messages we finished putting on the wire while we had
+		/// a latency target, and how many of them were late
+		int64 m_nDeadlineMessages = 0;
+		int64 m_nDeadlineMisses = 0;
 	};
 	#if STEAMNETWORKINGSOCKETS_MAX_LANES > 4
 		std_vector<Lane> m_vecLanes;
@@ -394,6 +544,22 @@ struct SSNPSenderState
 		vstd::small_vector<Lane,STEAMNETWORKINGSOCKETS_MAX_LANES> m_vecLanes;
 	#endif
 
+	/// Discard a queued unreliable message that we have not
+	/// started putting on the wire
+	void RemoveQueuedUnreliableMessage( CSteamNetworkingMessage *pMsg );
+
+	/// Delivery receipts waiting for the app to fetch them.
+	/// See k_nSteamNetworkingSend_DeliveryReceipt
+	std_vector<SteamNetworkingDeliveryReceipt_t> m_vecDeliveryReceipts;
+	void QueueDeliveryReceipt( int idxLane, int64 nMsgNum, bool bDelivered );
+
+	/// Note that a segment of a message that wants a receipt is in a packet
+	void TrackDeliveryReceipt( SNPInFlightPacket_t &pkt, int idxLane, int64 nMsgNum, bool bLastSegment );
+
+	/// We've decided whether a packet was delivered.  Update the
+	/// messages that were in it, and queue any receipts we can
+	void ResolveDeliveryReceipts( SNPInFlightPacket_t &pkt, bool bDelivered );
+
 	/// Nagle timer on all pending messages
 	void ClearNagleTimers()
 	{
@@ -424,6 +590,69 @@ struct SSNPSenderState
 	// Stats.  FIXME - move to LinkStatsEndToEnd and track rate counters
 	int64 m_nMessagesSentReliable = 0;
 	int64 m_nMessagesSentUnreliable = 0;
+	int64 m_nReliableSegmentsSent = 0;
+	int64 m_nReliableSegmentsRetransmitted = 0;
+	int64 m_cbReliableRetransmitted = 0;
+	int64 m_nPacketsLostNack = 0;
+	int64 m_nPacketsLostRACK = 0;
+	int64 m_nPacketsLostTimeout = 0;
+	int64 m_nTailLossProbes = 0;
+	int64 m_nFECParityFramesSent = 0;
+
+	/// Time-based loss detection, similar to RACK (RFC 8985).  The send time
+	/// of the most recently sent packet that has been acked, and the RTT
+	/// measured when it was acked.  Any packet sent before that one
+	/// that is still unacked after that RTT plus a reordering window is lost.
+	SteamNetworkingMicroseconds m_usecRACKSent = 0;
+	SteamNetworkingMicroseconds m_usecRACKRTT = 0;
+
+	/// True if we sent a tail loss probe, and haven't received an ack since.
+	/// We only send one probe, after that we wait for the RTO.
+	bool m_bTailLossProbePending = false;
+
+	/// Most recent and max ack delay reported by the peer, on acks
+	/// that we used to measure ping.  -1 if none yet
+	SteamNetworkingMicroseconds m_usecPeerAckDelayLast = -1;
+	SteamNetworkingMicroseconds m_usecPeerAckDelayMax = -1;
+
+	/// Packets we sent that carried acks, but no message data
+	int64 m_nAckOnlyPacketsSent = 0;
+
+	/// Data packets we sent, and total size of the SNP payload (plaintext)
+	int64 m_nDataPacketsSent = 0;
+	int64 m_cbDataPayloadSent = 0;
+
+	/// Ack frequency we have asked the peer to use.  (See
+	/// SNP_SerializeAckFrequencyFrame.)  m_nAckFrequencyPktNum is the packet
+	/// that carried our most recent request, or 0 once it has been acked.
+	/// Until then, the peer might still be using the previous max delay.
+	SteamNetworkingMicroseconds m_usecAckFrequencyMaxDelay = k_usecMaxDataAckDelay;
+	SteamNetworkingMicroseconds m_usecAckFrequencyMaxDelayPrev = k_usecMaxDataAckDelay;
+	int m_nAckFrequencyThreshold = 0;
+	uint64 m_nAckFrequencySeq = 0;
+	int64 m_nAckFrequencyPktNum = 0;
+	SteamNetworkingMicroseconds m_usecAckFrequencySent = 0;
+
+	/// Max time the peer might hold on to an ack for a packet we sent
+	inline SteamNetworkingMicroseconds PeerMaxAckDelay() const
+	{
+		if ( m_nAckFrequencyPktNum == 0 )
+			return m_usecAckFrequencyMaxDelay;
+		return std::max( m_usecAckFrequencyMaxDelay, m_usecAckFrequencyMaxDelayPrev );
+	}
+
+	/// Accounting for time spent app limited vs rate limited.
+	/// See SNP_UpdateSendLimitState
+	enum ESendLimitState
+	{
+		k_ESendLimitState_None, // Not connected, sending, or waiting on Nagle
+		k_ESendLimitState_App, // Nothing queued
+		k_ESendLimitState_Rate, // Data queued, waiting on the token bucket
+	};
+	ESendLimitState m_eSendLimitState = k_ESendLimitState_None;
+	SteamNetworkingMicroseconds m_usecSendLimitStateChanged = 0;
+	SteamNetworkingMicroseconds m_usecAppLimited = 0;
+	SteamNetworkingMicroseconds m_usecRateLimited = 0;
 
 	/// List of packets that we have sent but don't know whether they were received or not.
 	/// We keep a dummy sentinel at the head of the list, with a negative packet number.
@@ -477,12 +706,19 @@ struct SSNPSenderState
 	#endif
 };
 
-struct SSNPRecvUnreliableSegmentKey
+/// A piece of a fragmented unreliable message that we are reassembling.
+/// Until we receive the last fragment and know how big the message is, the
+/// data lives in the lane's reassembly arena.  After that, it goes straight
+/// into the message buffer.
+struct SSNPRecvUnreliableFragment
 {
 	int64 m_nMsgNum;
 	int m_nOffset;
+	int m_cbSize;
+	int m_nArenaOffset; // Offset in the arena, or -1 if it's in the message buffer
+	bool m_bLast;
 
-	inline bool operator<(const SSNPRecvUnreliableSegmentKey &x) const
+	inline bool operator<(const SSNPRecvUnreliableFragment &x) const
 	{
 		if ( m_nMsgNum < x.m_nMsgNum ) return true;
 		if ( m_nMsgNum > x.m_nMsgNum ) return false;
@@ -490,11 +726,11 @@ struct SSNPRecvUnreliableSegmentKey
 	}
 };
 
-struct SSNPRecvUnreliableSegmentData
+/// Buffer for a fragmented unreliable message, once we know its size
+struct SSNPRecvUnreliableMsgBuffer
 {
-	int m_cbSegSize = -1;
-	bool m_bLast = false;
-	char m_buf[ k_cbMaxUnreliableSegmentSizeRecv ];
+	int64 m_nMsgNum;
+	CSteamNetworkingMessage *m_pMsg;
 };
 
 struct SSNPPacketGap
@@ -517,11 +753,30 @@ struct SSNPReceiverState
 	struct Lane
 	{
 
-		/// Unreliable message segments that we have received.  When an unreliable message
-		/// needs to be fragmented, we store the pieces here.  NOTE: it might be more efficient
-		/// to use a simpler container, with worse O(), since this should ordinarily be
-		/// a pretty small list.
-		std_map<SSNPRecvUnreliableSegmentKey,SSNPRecvUnreliableSegmentData> m_mapUnreliableSegments;
+		/// Fragments of unreliable messages that we have received.  Sorted by
+		/// message number and offset.  This is ordinarily a very short list, so
+		/// a sorted vector is cheaper than a tree.
+		std_vector<SSNPRecvUnreliableFragment> m_vecUnreliableFragments;
+
+		/// Fragment data, for messages where we have not yet received the last
+		/// fragment.  Fragments are packed, so a small fragment costs only its size.
+		std_vector<uint8> m_bufUnreliableArena;
+
+		/// Message buffers for messages where we have received the last fragment.
+		/// These are owned by us until the message is complete.
+		std_vector<SSNPRecvUnreliableMsgBuffer> m_vecUnreliableMsgBuffers;
+
+		/// Forget about all the fragments for the message, and free the space.
+		void UnreliableDiscardMessage( int64 nMsgNum );
+
+		/// Free everything
+		void UnreliableDiscardAll();
+
+		/// Squeeze out arena space that is no longer used
+		void UnreliableCompactArena();
+
+		/// Find message buffer, if we've allocated one
+		CSteamNetworkingMessage *UnreliableFindMsgBuffer( int64 nMsgNum ) const;
 
 		/// The highest message number we have seen so far.
 		int64 m_nHighestSeenMsgNum = 0;
@@ -546,6 +801,31 @@ struct SSNPReceiverState
 		/// since in most cases the list will be small, and the cost of dynamic memory
 		/// allocation will be way worse than O(n) insertion/removal.
 		std_map<int64,int64> m_mapReliableStreamGaps;
+
+		/// Small unreliable messages we received recently, so that we can rebuild
+		/// one that was lost using a forward error correction parity frame.  We
+		/// only start doing this when the peer sends parity on this lane.  Ring buffer.
+		struct FECRecentMsg
+		{
+			int64 m_nMsgNum = 0;
+			int m_cbSize = 0;
+			bool m_bRecovered = false;
+			uint8 m_data[ k_cbMaxFECMessageSize ];
+		};
+		std_vector<FECRecentMsg> m_vecFECRecent;
+		int m_idxFECRecentNext = 0;
+
+		/// We don't remember whether we received messages older than this.
+		/// 0 if we are not remembering messages for FEC.
+		int64 m_nFECMinMsgNum = 0;
+
+		const FECRecentMsg *FECFindMessage( int64 nMsgNum ) const;
+
+		/// Remember a message, returns false if we already have it
+		bool FECRememberMessage( int64 nMsgNum, const void *pData, int cbSize, bool bRecovered );
+
+		/// Time spent decompressing messages
+		SteamNetworkingMicroseconds m_usecDecompressTime = 0;
 	};
 	#if STEAMNETWORKINGSOCKETS_MAX_LANES > 4
 		std_vector<Lane> m_vecLanes;
@@ -583,6 +863,23 @@ struct SSNPReceiverState
 	/// Packet number when we received the value of m_nMinPktNumToSendAcks
 	int64 m_nPktNumUpdatedMinPktNumToSendAcks = 0;
 
+	/// Ack frequency requested by the sender.  How long we may hold an ack
+	/// for a packet with reliable data, and how many of those packets we
+	/// can receive before we ack everything right away.  (0 = no limit.)
+	/// m_nAckFrequencySeq is the sequence number of the request, so that
+	/// we can ignore a stale one that arrives out of order.
+	SteamNetworkingMicroseconds m_usecMaxAckDelay = k_usecMaxDataAckDelay;
+	int m_nAckThreshold = 0;
+	uint64 m_nAckFrequencySeq = 0;
+
+	/// Number of packets with reliable data received since we last
+	/// acked everything
+	int m_nAckElicitingSinceFlush = 0;
+
+	/// We received a packet with reliable data.  Return the time by
+	/// which we need to ack it.
+	SteamNetworkingMicroseconds TimeWhenAckReliablePkt( SteamNetworkingMicroseconds usecNow );
+
 	/// The next ack that needs to be sent.  The invariant
 	/// for the times are:
 	///
@@ -662,6 +959,7 @@ struct SSNPReceiverState
 	// Stats.  FIXME - move to LinkStatsEndToEnd and track rate counters
 	int64 m_nMessagesRecvReliable = 0;
 	int64 m_nMessagesRecvUnreliable = 0;
+	int64 m_nFECMessagesRecovered = 0;
 };
 
 inline void CSteamNetworkingMessage::LinkBefore( CSteamNetworkingMessage *pSuccessor, CSteamNetworkingMessage::Links CSteamNetworkingMessage::*pMbrLinks, SteamNetworkingMessageQueue *pQueue )
@@ -735,6 +1033,11 @@ inline void CSteamNetworkingMessage::LinkToQueueTail( CSteamNetworkingMessage::L
 		Assert( !pQueue->m_pFirst );
 		Assert( pQueue->m_nMessageCount == 0 );
 		pQueue->m_pFirst = this;
+
+		// Wake up the app, if it is waiting on this queue.  (LinkBefore never
+		// adds to an empty queue, so this is the only place we need to check.)
+		if ( pQueue->m_pWake )
+			pQueue->SignalWake();
 	}
 
 	// Link back to the previous guy, if any
@@ -0,0 +1,173 @@
+//====== Copyright Valve Corporation, All rights reserved. ====================
+//
+// Binary per-packet trace recorder for SNP.
+//
+// Text spew at LogLevel_PacketDecode is expensive enough that it distorts the
+// timing we are usually trying to investigate.  This records a fixed-size
+// binary record for each SNP packet sent or received into a memory-mapped
+// file, so the cost on the hot path is a few stores.  Use
+// tests/snp_trace_reader to convert the file to CSV, JSON, or qlog.
+//
+// Recording is controlled by environment variables, similar to the system
+// log file:
+//
+// STEAMNETWORKINGSOCKETS_SNP_TRACE_FILE - Path of the trace file.  If not
+//     set, no trace is recorded.
+// STEAMNETWORKINGSOCKETS_SNP_TRACE_MAX_RECORDS - Number of record slots.
+//     Once they are used up, the oldest records are overwritten.
+//     (Default 1M records, which is 64MB.)
+//
+#include "steamnetworkingsockets_snp.h"
+#include "steamnetworkingsockets_lowlevel.h"
+
+#ifdef STEAMNETWORKINGSOCKETS_ENABLE_SNPTRACE
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+namespace SteamNetworkingSocketsLib {
+
+SNPTraceFileHeader_t *g_pSNPTraceHeader = nullptr;
+static SNPTraceRecord_t *s_pSNPTraceRecords;
+static std::atomic<uint64> s_nSNPTraceNextRecord;
+static size_t s_cbSNPTraceMapping;
+#ifdef _WIN32
+	static HANDLE s_hSNPTraceFile = INVALID_HANDLE_VALUE;
+	static HANDLE s_hSNPTraceMapping = nullptr;
+#endif
+
+constexpr uint32 k_nSNPTraceDefaultMaxRecords = 1024*1024;
+
+/// How often we update the record count in the header while recording.
+/// (It's always made exact when the trace is closed.)
+constexpr uint64 k_nSNPTraceHeaderUpdateInterval = 256;
+
+void SNPTrace_Init()
+{
+	SteamNetworkingGlobalLock::AssertHeldByCurrentThread();
+	if ( g_pSNPTraceHeader )
+		return;
+
+	const char *pszFilename = getenv( "STEAMNETWORKINGSOCKETS_SNP_TRACE_FILE" );
+	if ( V_isempty( pszFilename ) )
+		return;
+
+	uint32 nMaxRecords = k_nSNPTraceDefaultMaxRecords;
+	const char *pszMaxRecords = getenv( "STEAMNETWORKINGSOCKETS_SNP_TRACE_MAX_RECORDS" );
+	if ( !V_isempty( pszMaxRecords ) )
+	{
+		long long n = atoll( pszMaxRecords );
+		nMaxRecords = (uint32)std::max( 1024ll, std::min( n, 64ll*1024*1024 ) );
+	}
+
+	const size_t cbMapping = sizeof(SNPTraceFileHeader_t) + (size_t)nMaxRecords * sizeof(SNPTraceRecord_t);
+	void *pMapping = nullptr;
+
+	#ifdef _WIN32
+		s_hSNPTraceFile = ::CreateFileA( pszFilename, GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr );
+		if ( s_hSNPTraceFile == INVALID_HANDLE_VALUE )
+		{
+			SpewWarning( "Failed to create SNP trace file '%s'.  Error %u\n", pszFilename, (unsigned)::GetLastError() );
+			return;
+		}
+		s_hSNPTraceMapping = ::CreateFileMappingA( s_hSNPTraceFile, nullptr, PAGE_READWRITE, (DWORD)( (uint64)cbMapping >> 32 ), (DWORD)cbMapping, nullptr );
+		if ( s_hSNPTraceMapping )
+			pMapping = ::MapViewOfFile( s_hSNPTraceMapping, FILE_MAP_WRITE, 0, 0, cbMapping );
+		if ( !pMapping )
+		{
+			SpewWarning( "Failed to map SNP trace file '%s'.  Error %u\n", pszFilename, (unsigned)::GetLastError() );
+			if ( s_hSNPTraceMapping )
+				::CloseHandle( s_hSNPTraceMapping );
+			::CloseHandle( s_hSNPTraceFile );
+			s_hSNPTraceMapping = nullptr;
+			s_hSNPTraceFile = INVALID_HANDLE_VALUE;
+			return;
+		}
+	#else
+		int fd = open( pszFilename, O_RDWR|O_CREAT|O_TRUNC, 0644 );
+		if ( fd < 0 )
+		{
+			SpewWarning( "Failed to create SNP trace file '%s'.  errno=%d\n", pszFilename, errno );
+			return;
+		}
+		if ( ftruncate( fd, (off_t)cbMapping ) != 0 )
+		{
+			SpewWarning( "Failed to size SNP trace file '%s' to %llu bytes.  errno=%d\n", pszFilename, (unsigned long long)cbMapping, errno );
+			close( fd );
+			return;
+		}
+		pMapping = mmap( nullptr, cbMapping, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0 );
+		close( fd ); // The mapping keeps the file open
+		if ( pMapping == MAP_FAILED )
+		{
+			SpewWarning( "Failed to map SNP trace file '%s'.  errno=%d\n", pszFilename, errno );
+			return;
+		}
+	#endif
+
+	// The file was just created with zeros, so every record slot is
+	// already marked as unused.  Fill in the header
+	SNPTraceFileHeader_t *pHeader = (SNPTraceFileHeader_t *)pMapping;
+	memcpy( pHeader->m_szMagic, SNPTRACE_FILE_MAGIC, sizeof(pHeader->m_szMagic) );
+	pHeader->m_nVersion = k_nSNPTraceFileVersion;
+	pHeader->m_cbHeader = sizeof(SNPTraceFileHeader_t);
+	pHeader->m_cbRecord = sizeof(SNPTraceRecord_t);
+	pHeader->m_nMaxRecords = nMaxRecords;
+	pHeader->m_usecLocalTimeOpened = SteamNetworkingSockets_GetLocalTimestamp();
+	pHeader->m_nUnixTimeOpened = (int64)time( nullptr );
+	pHeader->m_nRecordsWritten = 0;
+
+	s_pSNPTraceRecords = (SNPTraceRecord_t *)( pHeader + 1 );
+	s_nSNPTraceNextRecord.store( 0, std::memory_order_relaxed );
+	s_cbSNPTraceMapping = cbMapping;
+	g_pSNPTraceHeader = pHeader;
+
+	SpewMsg( "Recording SNP packet trace to '%s', %u records max\n", pszFilename, nMaxRecords );
+}
+
+void SNPTrace_Shutdown()
+{
+	SteamNetworkingGlobalLock::AssertHeldByCurrentThread();
+	SNPTraceFileHeader_t *pHeader = g_pSNPTraceHeader;
+	if ( !pHeader )
+		return;
+	g_pSNPTraceHeader = nullptr;
+
+	pHeader->m_nRecordsWritten = s_nSNPTraceNextRecord.load( std::memory_order_relaxed );
+	s_pSNPTraceRecords = nullptr;
+
+	#ifdef _WIN32
+		::FlushViewOfFile( pHeader, 0 );
+		::UnmapViewOfFile( pHeader );
+		::CloseHandle( s_hSNPTraceMapping );
+		::CloseHandle( s_hSNPTraceFile );
+		s_hSNPTraceMapping = nullptr;
+		s_hSNPTraceFile = INVALID_HANDLE_VALUE;
+	#else
+		munmap( pHeader, s_cbSNPTraceMapping );
+	#endif
+	s_cbSNPTraceMapping = 0;
+}
+
+SNPTraceRecord_t *SNPTrace_AllocRecord()
+{
+	SNPTraceFileHeader_t *pHeader = g_pSNPTraceHeader;
+	Assert( pHeader );
+	uint64 n = s_nSNPTraceNextRecord.fetch_add( 1, std::memory_order_relaxed );
+	if ( ( n % k_nSNPTraceHeaderUpdateInterval ) == 0 )
+		pHeader->m_nRecordsWritten = n;
+	return &s_pSNPTraceRecords[ n % pHeader->m_nMaxRecords ];
+}
+
+} // namespace SteamNetworkingSocketsLib
+
+#endif // #ifdef STEAMNETWORKINGSOCKETS_ENABLE_SNPTRACE
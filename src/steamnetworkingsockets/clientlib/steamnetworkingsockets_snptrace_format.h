@@ -0,0 +1,97 @@
+//====== Copyright Valve Corporation, All rights reserved. ====================
+//
+// On-disk format of the binary SNP packet trace.
+//
+// This header is intentionally self-contained, so that tools can read trace
+// files without pulling in the rest of the library.  All values are stored
+// in the byte order of the machine that wrote the trace, which is always
+// little endian on the platforms we support.
+//
+// The file consists of a SNPTraceFileHeader_t, followed by a fixed number of
+// SNPTraceRecord_t.  The recorder writes the records as a ring: once the file
+// is full, the oldest records are overwritten.  The total number of records
+// ever written is stored in the header, so a reader can locate the oldest
+// record.  A record whose m_eDirection is zero has never been written.
+//
+//=============================================================================
+
+#pragma once
+
+#include <stdint.h>
+
+#define SNPTRACE_FILE_MAGIC "SNPTRACE"
+const uint32_t k_nSNPTraceFileVersion = 1;
+
+enum ESNPTraceDirection
+{
+	k_ESNPTraceDirection_Invalid = 0, // Slot never written
+	k_ESNPTraceDirection_Send = 1,
+	k_ESNPTraceDirection_Recv = 2,
+};
+
+enum ESNPTraceFlags
+{
+	/// Packet had encrypted payload (as opposed to the NULL cipher)
+	k_nSNPTraceFlag_Encrypted = 0x01,
+
+	/// Packet contained an ack frame.  m_nAckLatestPktNum and m_nAckBlocks are valid
+	k_nSNPTraceFlag_Ack = 0x02,
+
+	/// (Recv) The receiver decided not to ack this packet, e.g. because it
+	/// could not accept a segment.
+	k_nSNPTraceFlag_RecvInhibitAck = 0x04,
+};
+
+#pragma pack( push, 8 )
+
+struct SNPTraceFileHeader_t
+{
+	char m_szMagic[8]; // SNPTRACE_FILE_MAGIC, not NUL terminated
+	uint32_t m_nVersion; // k_nSNPTraceFileVersion
+	uint32_t m_cbHeader; // sizeof(SNPTraceFileHeader_t)
+	uint32_t m_cbRecord; // sizeof(SNPTraceRecord_t)
+	uint32_t m_nMaxRecords; // Number of record slots in the file
+
+	/// Library local timestamp (SteamNetworkingSockets_GetLocalTimestamp) when
+	/// the trace was opened, and the wall clock time (Unix epoch, seconds)
+	/// at that same moment.  All record timestamps use the same time base.
+	int64_t m_usecLocalTimeOpened;
+	int64_t m_nUnixTimeOpened;
+
+	/// Total number of records written.  If this exceeds m_nMaxRecords, the
+	/// ring has wrapped and the oldest record is at index
+	/// m_nRecordsWritten % m_nMaxRecords.  This is updated periodically while
+	/// the trace is being recorded, and is exact once the trace is closed.
+	uint64_t m_nRecordsWritten;
+
+	uint8_t m_reserved[24];
+};
+
+struct SNPTraceRecord_t
+{
+	int64_t m_usecTime; // Local timestamp
+	int64_t m_nPktNum; // SNP packet number (expanded to 64 bits)
+	int64_t m_nAckLatestPktNum; // If k_nSNPTraceFlag_Ack, the latest packet number acked
+	uint32_t m_unConnectionID; // Local connection ID
+	uint16_t m_cbWire; // Bytes handed to the transport (send) or received from it (recv), including headers
+	uint16_t m_cbPlainText; // Size of the decrypted SNP payload
+	uint8_t m_eDirection; // ESNPTraceDirection
+	uint8_t m_nFlags; // ESNPTraceFlags
+	uint8_t m_nReliableSegments;
+	uint8_t m_nUnreliableSegments;
+	uint8_t m_nAckBlocks;
+	uint8_t m_reserved0[3];
+
+	// Sender state, after the packet was sent or processed.
+	float m_flTokenBucket; // Bytes
+	int32_t m_nSendRate; // Bytes per second, rate currently in use
+	int32_t m_cbPendingReliable;
+	int32_t m_cbPendingUnreliable;
+	int32_t m_cbSentUnackedReliable;
+	int32_t m_nPingMS; // Smoothed ping, or -1 if unknown
+};
+
+#pragma pack( pop )
+
+static_assert( sizeof(SNPTraceFileHeader_t) == 72, "SNPTraceFileHeader_t layout changed" );
+static_assert( sizeof(SNPTraceRecord_t) == 64, "SNPTraceRecord_t layout changed" );
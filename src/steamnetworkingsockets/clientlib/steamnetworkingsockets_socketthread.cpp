@@ -34,6 +34,22 @@
 	#ifdef STEAMNETWORKINGSOCKETS_ENABLE_RESOLVEHOSTNAME
 		#include <netdb.h>
 	#endif
+	#if IsLinux() || IsAndroid()
+		#include <sys/eventfd.h>
+	#endif
+	#if !IsConsole()
+		#include <unistd.h>
+		#include <fcntl.h>
+	#endif
+#endif
+
+// On Linux, keep the table of local addresses current by listening for
+// address change notifications from the kernel, rather than enumerating
+// all the interfaces from scratch each time somebody asks.
+#if IsLinux() && defined( USE_EPOLL )
+	#define STEAMNETWORKINGSOCKETS_LOCALADDR_NETLINK
+	#include <linux/netlink.h>
+	#include <linux/rtnetlink.h>
 #endif
 
 #include <tier0/memdbgoff.h>
@@ -480,8 +496,11 @@ public:
 			TracePkt( true, adrTo, nChunks, pChunks );
 		}
 
+		const bool bPerfMetrics = BPerfMetricsEnabled();
 		#ifdef STEAMNETWORKINGSOCKETS_LOWLEVEL_TIME_SOCKET_CALLS
 			SteamNetworkingMicroseconds usecSendStart = SteamNetworkingSockets_GetLocalTimestamp();
+		#else
+			SteamNetworkingMicroseconds usecSendStart = unlikely( bPerfMetrics ) ? SteamNetworkingSockets_GetLocalTimestamp() : 0;
 		#endif
 
 		#ifdef _WIN32
@@ -577,6 +596,22 @@ public:
 			}
 		#endif
 
+		if ( unlikely( bPerfMetrics ) )
+		{
+			PerfHistogramRecord( k_EPerfHistogram_SendToUsec, SteamNetworkingSockets_GetLocalTimestamp() - usecSendStart );
+			if ( bResult )
+			{
+				int64 cbSent = 0;
+				for ( int i = 0 ; i < nChunks ; ++i )
+					cbSent += pChunks[i].iov_len;
+				PerfCounterAdd( k_EPerfCounter_SentBytes, cbSent );
+			}
+			else
+			{
+				PerfCounterAdd( k_EPerfCounter_SendFailures, 1 );
+			}
+		}
+
 		#ifdef STEAMNETWORKINGSOCKETS_LOWLEVEL_TIME_SOCKET_CALLS
 			SteamNetworkingMicroseconds usecSendEnd = SteamNetworkingSockets_GetLocalTimestamp();
 			if ( usecSendEnd > s_usecIgnoreLongLockWaitTimeUntil )
@@ -686,7 +721,7 @@ struct CLaggedPacket final : public CPossibleOutOfOrderPacket
 	int m_nWireSeqNum;
 
 	// Packet payload data
-	char m_pkt[ k_cbSteamNetworkingSocketsMaxUDPMsgLen ];
+	uint8 m_pkt[ k_cbSteamNetworkingSocketsMaxUDPMsgLen ];
 
 	// Constructor used when lagging a packet to simulate latency
 	CLaggedPacket( CRawUDPSocketImpl *pSockOwner, const netadr_t &adrRemote, SteamNetworkingMicroseconds usecFlush, int cbPkt, uint8 tos )
@@ -758,7 +793,7 @@ public:
 		CLaggedPacket *pkt = new CLaggedPacket( pSock, adr, usecTime, cbPkt, tos );
 
 		// Gather the payload data data into the buffer
-		char *d = pkt->m_pkt;
+		uint8 *d = pkt->m_pkt;
 		for ( int i = 0 ; i < nChunks ; ++i )
 		{
 			int cbChunk = pChunks[i].iov_len;
@@ -1137,12 +1172,12 @@ static bool s_bRecreatePollList = true;
 #ifdef USE_EPOLL
 static EPollHandle s_epollfd = INVALID_EPOLL_HANDLE;
 
-static bool AddFDToEPoll( int fd, CRawUDPSocketImpl *pSock, SteamNetworkingErrMsg &errMsg )
+static bool AddFDToEPoll( int fd, void *pContext, SteamNetworkingErrMsg &errMsg )
 {
 	struct epoll_event ev = {};
 
 	ev.events = EPOLLIN; // We only care about sockets with data ready read
-	ev.data.ptr = pSock; // epoll can give us back some userdata.
+	ev.data.ptr = pContext; // epoll can give us back some userdata.
 
 	if ( epoll_ctl( s_epollfd, EPOLL_CTL_ADD, fd, &ev) != 0 )
 	{
@@ -1153,6 +1188,13 @@ static bool AddFDToEPoll( int fd, CRawUDPSocketImpl *pSock, SteamNetworkingErrMs
 }
 #endif
 
+#ifdef STEAMNETWORKINGSOCKETS_LOCALADDR_NETLINK
+/// Netlink socket used to listen for local address changes.  We put the
+/// address of this variable into the epoll userdata to identify it.
+static SOCKET s_hSockNetlink = INVALID_SOCKET;
+static void DrainNetlinkSocket();
+#endif
+
 static std::thread *s_pServiceThread = nullptr;
 static void (*s_fnServiceThreadInitCallback)() = nullptr;
 
@@ -1179,6 +1221,90 @@ void WakeServiceThread()
 	#endif
 }
 
+/////////////////////////////////////////////////////////////////////////////
+//
+// CAppWakeHandle
+//
+/////////////////////////////////////////////////////////////////////////////
+
+CAppWakeHandle *CAppWakeHandle::Create( SteamNetworkingErrMsg &errMsg )
+{
+	#if defined( _WIN32 )
+
+		// Auto-reset, so that waiting on it resets it
+		HANDLE hEvent = CreateEvent( nullptr, false, false, nullptr );
+		if ( hEvent == NULL || hEvent == INVALID_HANDLE_VALUE )
+		{
+			V_sprintf_safe( errMsg, "CreateEvent() call failed.  Error code 0x%08x.", GetLastError() );
+			return nullptr;
+		}
+		CAppWakeHandle *pResult = new CAppWakeHandle;
+		pResult->m_hRead = (SteamNetworkingWakeHandle)hEvent;
+
+	#elif IsLinux() || IsAndroid()
+
+		int fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+		if ( fd < 0 )
+		{
+			V_sprintf_safe( errMsg, "eventfd() call failed.  Error code 0x%08x.", errno );
+			return nullptr;
+		}
+		CAppWakeHandle *pResult = new CAppWakeHandle;
+		pResult->m_hRead = fd;
+
+	#elif IsPosix() && !IsConsole()
+
+		int fds[2];
+		if ( pipe( fds ) != 0 )
+		{
+			V_sprintf_safe( errMsg, "pipe() call failed.  Error code 0x%08x.", errno );
+			return nullptr;
+		}
+		for ( int fd: fds )
+		{
+			fcntl( fd, F_SETFL, fcntl( fd, F_GETFL, 0 ) | O_NONBLOCK );
+			fcntl( fd, F_SETFD, FD_CLOEXEC );
+		}
+		CAppWakeHandle *pResult = new CAppWakeHandle;
+		pResult->m_hRead = fds[0];
+		pResult->m_hWrite = fds[1];
+
+	#else
+		V_strcpy_safe( errMsg, "Wake handles not supported on this platform" );
+		return nullptr;
+	#endif
+
+	return pResult;
+}
+
+CAppWakeHandle::~CAppWakeHandle()
+{
+	#if defined( _WIN32 )
+		if ( m_hRead != k_SteamNetworkingWakeHandle_Invalid )
+			CloseHandle( (HANDLE)m_hRead );
+	#elif IsPosix() && !IsConsole()
+		if ( m_hRead != k_SteamNetworkingWakeHandle_Invalid )
+			close( (int)m_hRead );
+		if ( m_hWrite != k_SteamNetworkingWakeHandle_Invalid )
+			close( (int)m_hWrite );
+	#endif
+}
+
+void CAppWakeHandle::Signal()
+{
+	// NOTE: Both fds are non-blocking.  If the write fails because the
+	// counter or pipe is full, the app already has a wakeup pending.
+	#if defined( _WIN32 )
+		SetEvent( (HANDLE)m_hRead );
+	#elif IsLinux() || IsAndroid()
+		uint64_t one = 1;
+		(void)!write( (int)m_hRead, &one, sizeof(one) );
+	#elif IsPosix() && !IsConsole()
+		char one = 1;
+		(void)!write( (int)m_hWrite, &one, sizeof(one) );
+	#endif
+}
+
 inline SteamNetworkingMicroseconds RandomJitter( const GlobalConfigValue<float> &ValAvg, const GlobalConfigValue<float> &ValMax, const GlobalConfigValue<float> &ValPct )
 {
 	// The defaults disable jitter by setting the *average* to 0, so check that first.
@@ -2286,10 +2412,15 @@ IRawUDPSocket *OpenRawUDPSocket( CRecvPacketCallback callback, SteamNetworkingEr
 	return OpenRawUDPSocketInternal( callback, errMsg, pAddrLocal, pnAddressFamilies );
 }
 
+/// Number of packets received since the service thread last woke up.
+/// (Only tracked when performance metrics are enabled.)
+static int s_nPerfPacketsThisWakeup;
+
 /// Draw one specific UDP socket.  Returns false if we detect a
 /// global shutdown attempt and abort
 static bool DrainSocket( CRawUDPSocketImpl *pSock )
 {
+	const bool bPerfMetrics = BPerfMetricsEnabled();
 
 	// If the callback gets cleared, that indicates that the socket is pending
 	// destruction and is logically closed, even if the underlying UDP socket
@@ -2301,6 +2432,8 @@ static bool DrainSocket( CRawUDPSocketImpl *pSock )
 
 		#ifdef STEAMNETWORKINGSOCKETS_LOWLEVEL_TIME_SOCKET_CALLS
 			SteamNetworkingMicroseconds usecRecvFromStart = SteamNetworkingSockets_GetLocalTimestamp();
+		#else
+			SteamNetworkingMicroseconds usecRecvFromStart = unlikely( bPerfMetrics ) ? SteamNetworkingSockets_GetLocalTimestamp() : 0;
 		#endif
 
 		char buf[ k_cbSteamNetworkingSocketsMaxUDPMsgLen + 1024 ];
@@ -2367,6 +2500,17 @@ static bool DrainSocket( CRawUDPSocketImpl *pSock )
 
 		SteamNetworkingMicroseconds usecRecvFromEnd = SteamNetworkingSockets_GetLocalTimestamp();
 
+		if ( unlikely( bPerfMetrics ) )
+		{
+			PerfHistogramRecord( k_EPerfHistogram_RecvFromUsec, usecRecvFromEnd - usecRecvFromStart );
+			if ( ret >= 0 )
+			{
+				++s_nPerfPacketsThisWakeup;
+				PerfCounterAdd( k_EPerfCounter_RecvPackets, 1 );
+				PerfCounterAdd( k_EPerfCounter_RecvBytes, (int64)iov_buf.iov_len );
+			}
+		}
+
 		#ifdef STEAMNETWORKINGSOCKETS_LOWLEVEL_TIME_SOCKET_CALLS
 			if ( usecRecvFromEnd > s_usecIgnoreLongLockWaitTimeUntil )
 			{
@@ -2567,7 +2711,7 @@ static bool DrainSocket( CRawUDPSocketImpl *pSock )
 		}
 
 		// Process the packet now
-		info.m_pPkt = buf;
+		info.m_pPkt = (uint8 *)buf;
 		info.m_cbPkt = (int)iov_buf.iov_len;
 		info.m_usecNow = usecRecvFromEnd;
 		info.m_pSock = pSock;
@@ -2698,6 +2842,7 @@ static bool PollRawUDPSockets( int nMaxTimeoutMS, bool bManualPoll )
 	#endif
 
 	// Now check on sockets.  When using epoll, we can do this more efficiently
+	s_nPerfPacketsThisWakeup = 0;
 	#ifdef USE_EPOLL
 
 		int tries = 0;
@@ -2718,6 +2863,15 @@ static bool PollRawUDPSockets( int nMaxTimeoutMS, bool bManualPoll )
 				// to the socket there.
 				auto pSock = (CRawUDPSocketImpl *)epoll_events[ i ].data.ptr;
 
+				// Local address change notification?
+				#ifdef STEAMNETWORKINGSOCKETS_LOCALADDR_NETLINK
+					if ( epoll_events[ i ].data.ptr == &s_hSockNetlink )
+					{
+						DrainNetlinkSocket();
+						continue;
+					}
+				#endif
+
 				// Is it for a real socket, or just a wakuip call?
 				if ( pSock )
 				{
@@ -2813,6 +2967,9 @@ static bool PollRawUDPSockets( int nMaxTimeoutMS, bool bManualPoll )
 	#endif // USE_EPOLL, else
 
 exit_polling:
+	if ( unlikely( BPerfMetricsEnabled() ) )
+		PerfHistogramRecord( k_EPerfHistogram_PacketsPerPollWakeup, s_nPerfPacketsThisWakeup );
+
 	// We retained the lock
 	return true;
 }
@@ -3683,6 +3840,10 @@ bool BSteamNetworkingSocketsLowLevelAddRef( SteamNetworkingErrMsg &errMsg )
 	{
 		InitSpew();
 
+		#ifdef STEAMNETWORKINGSOCKETS_ENABLE_SNPTRACE
+			SNPTrace_Init();
+		#endif
+
 		CCrypto::Init();
 
 		// Initialize event tracing
@@ -3807,6 +3968,39 @@ bool BSteamNetworkingSocketsLowLevelAddRef( SteamNetworkingErrMsg &errMsg )
 			#else
 				#error "How will we cancel this epoll?"
 			#endif
+
+			// Subscribe to local address changes.  This is an optimization,
+			// so failure isn't fatal.  We'll just re-enumerate periodically
+			#ifdef STEAMNETWORKINGSOCKETS_LOCALADDR_NETLINK
+			{
+				Assert( s_hSockNetlink == INVALID_SOCKET );
+				s_hSockNetlink = socket( AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE );
+				if ( s_hSockNetlink == INVALID_SOCKET )
+				{
+					SpewWarning( "Failed to create netlink socket, errno=%d.  Local address changes will not be detected promptly\n", errno );
+				}
+				else
+				{
+					sockaddr_nl addrNL;
+					V_memset( &addrNL, 0, sizeof(addrNL) );
+					addrNL.nl_family = AF_NETLINK;
+					addrNL.nl_groups = RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+					SteamNetworkingErrMsg tmpErrMsg;
+					if ( bind( s_hSockNetlink, (sockaddr *)&addrNL, sizeof(addrNL) ) != 0 )
+					{
+						SpewWarning( "Failed to bind netlink socket, errno=%d.  Local address changes will not be detected promptly\n", errno );
+						closesocket( s_hSockNetlink );
+						s_hSockNetlink = INVALID_SOCKET;
+					}
+					else if ( !AddFDToEPoll( s_hSockNetlink, &s_hSockNetlink, tmpErrMsg ) )
+					{
+						SpewWarning( "Failed to add netlink socket to epoll.  %s\n", tmpErrMsg );
+						closesocket( s_hSockNetlink );
+						s_hSockNetlink = INVALID_SOCKET;
+					}
+				}
+			}
+			#endif
 		}
 		#endif
 
@@ -3865,6 +4059,11 @@ void SteamNetworkingSocketsLowLevelDecRef()
 	// might need to do stuff when we close a bunch of sockets (and WSACleanup)
 	SteamNetworkingGlobalLock::SetLongLockWarningThresholdMS( "SteamNetworkingSocketsLowLevelDecRef", 500 );
 
+	// Stop worker threads.  They never take the global lock, so it's
+	// safe to wait on them here.  Any completion tasks they queue will be
+	// run below, and will find that their connections are gone.
+	ShutdownWorkerThreads();
+
 	// Stop the service thread, if we have one
 	if ( s_pServiceThread )
 		StopServiceThread();
@@ -3897,6 +4096,14 @@ void SteamNetworkingSocketsLowLevelDecRef()
 		}
 	#endif
 
+	#ifdef STEAMNETWORKINGSOCKETS_LOCALADDR_NETLINK
+		if ( s_hSockNetlink != INVALID_SOCKET )
+		{
+			closesocket( s_hSockNetlink );
+			s_hSockNetlink = INVALID_SOCKET;
+		}
+	#endif
+
 	#ifdef USE_EPOLL
 		if ( s_epollfd != INVALID_EPOLL_HANDLE )
 		{
@@ -3905,6 +4112,9 @@ void SteamNetworkingSocketsLowLevelDecRef()
 		}
 	#endif
 
+	// Forget cached local addresses.  Nobody will be keeping them up to date
+	InvalidateLocalAddresses();
+
 	// Check for any leftover tasks that were queued to be run while we hold the lock
 	ProcessDeferredOperations();
 
@@ -3943,6 +4153,9 @@ void SteamNetworkingSocketsLowLevelDecRef()
 	// potential deadlock issues if they are run while holding the lock.
 	g_taskListRunInBackground.DeleteTasks();
 
+	// Now that nothing can be refilling it, discard the key exchange key pool
+	FreeKeyExchangeKeyPool();
+
 	// Nuke sockets and COM
 	#ifdef _WIN32
 		#if !IsXbox()
@@ -3954,6 +4167,10 @@ void SteamNetworkingSocketsLowLevelDecRef()
 		::CoUninitialize();
 	#endif
 
+	#ifdef STEAMNETWORKINGSOCKETS_ENABLE_SNPTRACE
+		SNPTrace_Shutdown();
+	#endif
+
 	KillSpew();
 }
 
@@ -4114,7 +4331,9 @@ static int IPv6MaskToPrefixLen( const uint8 *pMask )
 	return n; // 0 means all-zero mask, which is bogus
 }
 
-bool GetLocalAddresses( CUtlVector<LocalAddress_t> *pAddrs )
+// Ask the OS for the list of local addresses.  Use GetLocalAddresses,
+// which serves the request from the cached table
+static bool EnumerateLocalAddresses( CUtlVector<LocalAddress_t> *pAddrs )
 {
 
 	#if STEAMNETWORKINGSOCKETS_ENABLE_MOCK
@@ -4279,6 +4498,235 @@ bool GetLocalAddresses( CUtlVector<LocalAddress_t> *pAddrs )
 #endif
 }
 
+/////////////////////////////////////////////////////////////////////////////
+//
+// Local address table
+//
+/////////////////////////////////////////////////////////////////////////////
+
+// How long can we use the cached table, if the OS won't tell us when
+// something changes?  This is long enough so that a connection storm
+// only enumerates interfaces a handful of times.
+constexpr SteamNetworkingMicroseconds k_usecLocalAddressesMaxAge = 5*k_nMillion;
+
+// Process-wide table of local addresses.  Protected by the global lock
+static CUtlVector<LocalAddress_t> s_vecLocalAddresses;
+static bool s_bLocalAddressesValid = false;
+static SteamNetworkingMicroseconds s_usecLocalAddressesEnumerated;
+static uint32 s_nLocalAddressesVersion = 1;
+
+// Return true if the table will be updated when something changes
+static inline bool BLocalAddressesMaintainedByOS()
+{
+	#ifdef STEAMNETWORKINGSOCKETS_LOCALADDR_NETLINK
+		return s_hSockNetlink != INVALID_SOCKET;
+	#else
+		return false;
+	#endif
+}
+
+uint32 GetLocalAddressesVersion()
+{
+	SteamNetworkingGlobalLock::AssertHeldByCurrentThread();
+	return s_nLocalAddressesVersion;
+}
+
+void InvalidateLocalAddresses()
+{
+	SteamNetworkingGlobalLock::AssertHeldByCurrentThread();
+	if ( !BLocalAddressesMaintainedByOS() )
+		s_bLocalAddressesValid = false;
+}
+
+bool GetLocalAddresses( CUtlVector<LocalAddress_t> *pAddrs, uint32 *pnVersion )
+{
+	SteamNetworkingGlobalLock::AssertHeldByCurrentThread( "GetLocalAddresses" );
+
+	SteamNetworkingMicroseconds usecNow = SteamNetworkingSockets_GetLocalTimestamp();
+	if ( s_bLocalAddressesValid && !BLocalAddressesMaintainedByOS() && usecNow > s_usecLocalAddressesEnumerated + k_usecLocalAddressesMaxAge )
+		s_bLocalAddressesValid = false;
+
+	if ( !s_bLocalAddressesValid )
+	{
+		CUtlVector<LocalAddress_t> vecAddrs;
+		if ( !EnumerateLocalAddresses( &vecAddrs ) )
+			return false;
+
+		// Only bump the version if something actually changed.  We don't
+		// care about the order.
+		bool bChanged = ( vecAddrs.Count() != s_vecLocalAddresses.Count() );
+		for ( int i = 0 ; !bChanged && i < vecAddrs.Count() ; ++i )
+		{
+			if ( !s_vecLocalAddresses.HasElement( vecAddrs[i] ) )
+				bChanged = true;
+		}
+		if ( bChanged )
+		{
+			s_vecLocalAddresses.Swap( vecAddrs );
+			++s_nLocalAddressesVersion;
+		}
+		s_bLocalAddressesValid = true;
+		s_usecLocalAddressesEnumerated = usecNow;
+	}
+
+	pAddrs->CopyArray( s_vecLocalAddresses.Base(), s_vecLocalAddresses.Count() );
+	if ( pnVersion )
+		*pnVersion = s_nLocalAddressesVersion;
+	return true;
+}
+
+// Add or remove a single address from the table, and bump the version
+// if that changed anything
+static void ApplyLocalAddressChange( const LocalAddress_t &entry, bool bAdded )
+{
+	// Locate existing entry for this address
+	int idx = s_vecLocalAddresses.Count()-1;
+	while ( idx >= 0 && !( s_vecLocalAddresses[idx].m_addr == entry.m_addr ) )
+		--idx;
+
+	if ( bAdded )
+	{
+		if ( idx >= 0 )
+		{
+			if ( s_vecLocalAddresses[idx] == entry )
+				return;
+			s_vecLocalAddresses[idx] = entry;
+		}
+		else
+		{
+			s_vecLocalAddresses.AddToTail( entry );
+		}
+		SpewVerbose( "Local address %s/%d added\n", SteamNetworkingIPAddrRender( entry.m_addr, false ).c_str(), entry.m_nPrefixLen );
+	}
+	else
+	{
+		if ( idx < 0 )
+			return;
+		s_vecLocalAddresses.Remove( idx );
+		SpewVerbose( "Local address %s removed\n", SteamNetworkingIPAddrRender( entry.m_addr, false ).c_str() );
+	}
+	++s_nLocalAddressesVersion;
+}
+
+void TEST_ApplyLocalAddressChange( const SteamNetworkingIPAddr &addr, int nPrefixLen, bool bAdded )
+{
+	SteamNetworkingGlobalLock scopeLock( "TEST_ApplyLocalAddressChange" );
+	LocalAddress_t entry;
+	entry.m_addr = addr;
+	entry.m_nPrefixLen = nPrefixLen;
+	ApplyLocalAddressChange( entry, bAdded );
+}
+
+uint32 TEST_GetLocalAddressesVersion( bool bInvalidate, const SteamNetworkingIPAddr *pAddr, int nPrefixLen, bool *pbFound )
+{
+	SteamNetworkingGlobalLock scopeLock( "TEST_GetLocalAddressesVersion" );
+	if ( bInvalidate )
+		InvalidateLocalAddresses();
+	CUtlVector<LocalAddress_t> vecAddrs;
+	uint32 nVersion = 0;
+	if ( !GetLocalAddresses( &vecAddrs, &nVersion ) )
+		return 0;
+	Assert( nVersion == GetLocalAddressesVersion() );
+	if ( pbFound )
+	{
+		LocalAddress_t entry;
+		entry.m_addr = *pAddr;
+		entry.m_nPrefixLen = nPrefixLen;
+		*pbFound = vecAddrs.HasElement( entry );
+	}
+	return nVersion;
+}
+
+#ifdef STEAMNETWORKINGSOCKETS_LOCALADDR_NETLINK
+
+// Apply a single RTM_NEWADDR / RTM_DELADDR to the table
+static void ApplyNetlinkAddrMsg( const nlmsghdr *nh )
+{
+	if ( nh->nlmsg_len < NLMSG_LENGTH( sizeof(ifaddrmsg) ) )
+		return;
+	ifaddrmsg *ifa = (ifaddrmsg *)NLMSG_DATA( nh );
+
+	// Loopback addresses are host scope.  EnumerateLocalAddresses skips
+	// loopback interfaces, so we do the same.
+	if ( ifa->ifa_scope == RT_SCOPE_HOST )
+		return;
+
+	// For IPv4, IFA_LOCAL is our address.  (IFA_ADDRESS is the remote
+	// end on a point-to-point link.)  For IPv6, only IFA_ADDRESS is used.
+	const void *pAddrBytes = nullptr;
+	int cbAttr = (int)IFA_PAYLOAD( nh );
+	for ( rtattr *rta = IFA_RTA( ifa ); RTA_OK( rta, cbAttr ); rta = RTA_NEXT( rta, cbAttr ) )
+	{
+		if ( rta->rta_type == IFA_LOCAL || ( rta->rta_type == IFA_ADDRESS && !pAddrBytes ) )
+			pAddrBytes = RTA_DATA( rta );
+	}
+	if ( !pAddrBytes )
+		return;
+
+	LocalAddress_t entry;
+	if ( ifa->ifa_family == AF_INET )
+	{
+		uint32 ip;
+		V_memcpy( &ip, pAddrBytes, sizeof(ip) );
+		entry.m_addr.SetIPv4( BigDWord( ip ), 0 );
+	}
+	else if ( ifa->ifa_family == AF_INET6 )
+	{
+		entry.m_addr.SetIPv6( (const uint8 *)pAddrBytes, 0 );
+	}
+	else
+	{
+		return;
+	}
+	if ( GetLocalAddresses_IsReserved( entry.m_addr ) )
+		return;
+	entry.m_nPrefixLen = ifa->ifa_prefixlen;
+
+	ApplyLocalAddressChange( entry, nh->nlmsg_type == RTM_NEWADDR );
+}
+
+static void DrainNetlinkSocket()
+{
+	SteamNetworkingGlobalLock::AssertHeldByCurrentThread( "DrainNetlinkSocket" );
+
+	alignas( nlmsghdr ) char buf[ 8192 ];
+	for (;;)
+	{
+		int r = (int)::recv( s_hSockNetlink, buf, sizeof(buf), 0 );
+		if ( r < 0 )
+		{
+			// ENOBUFS means the kernel dropped some notifications,
+			// so we no longer know what the table should contain.
+			// Re-enumerate from scratch next time we need it
+			if ( errno == ENOBUFS )
+				s_bLocalAddressesValid = false;
+			else
+				break;
+			continue;
+		}
+		if ( r == 0 )
+			break;
+
+		// If we don't have a table yet, there's nothing to update.  We'll
+		// enumerate everything when somebody asks.  Also, when the network
+		// is mocked, the real interfaces are irrelevant
+		if ( !s_bLocalAddressesValid )
+			continue;
+		#if STEAMNETWORKINGSOCKETS_ENABLE_MOCK
+			if ( TEST_mocknetwork_active )
+				continue;
+		#endif
+
+		for ( nlmsghdr *nh = (nlmsghdr *)buf ; NLMSG_OK( nh, r ) ; nh = NLMSG_NEXT( nh, r ) )
+		{
+			if ( nh->nlmsg_type == RTM_NEWADDR || nh->nlmsg_type == RTM_DELADDR )
+				ApplyNetlinkAddrMsg( nh );
+		}
+	}
+}
+
+#endif // #ifdef STEAMNETWORKINGSOCKETS_LOCALADDR_NETLINK
+
 
 } // namespace SteamNetworkingSocketsLib
 
@@ -4355,6 +4803,12 @@ void TEST_mocknetwork_init( const TEST_mocknetwork_config_t &config )
 	s_mockNetworkConfig = config;
 	TEST_mocknetwork_active = true;
 
+	// Make sure we don't return any real addresses we had already cached
+	{
+		SteamNetworkingGlobalLock scopeLock( "TEST_mocknetwork_init" );
+		s_bLocalAddressesValid = false;
+	}
+
 	SpewMsg( "Mock network active.\n" );
 	for ( int i = 0; i < (int)config.m_vecGateways.size(); ++i )
 	{
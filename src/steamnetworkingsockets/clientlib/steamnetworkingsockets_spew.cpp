@@ -5,6 +5,10 @@
 #include "steamnetworkingsockets_lowlevel.h"
 #include "../steamnetworkingsockets_internal.h"
 #include <tier0/valve_tracelogging.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <tier0/memdbgoff.h>
 
 TRACELOGGING_DECLARE_PROVIDER( HTraceLogging_SteamNetworkingSockets );
@@ -29,8 +33,327 @@ static ESteamNetworkingSocketsDebugOutputType g_eSystemSpewLevel = k_ESteamNetwo
 constexpr ESteamNetworkingSocketsDebugOutputType g_eSystemSpewLevel = k_ESteamNetworkingSocketsDebugOutputType_None; // Option selected by the "system" (environment variable, etc)
 #endif
 
+/////////////////////////////////////////////////////////////////////////////
+//
+// Asynchronous spew
+//
+// When k_ESteamNetworkingConfig_SpewAsyncQueueSize is nonzero, the thread
+// generating the spew just formats the message and places it into a bounded,
+// lock-free multi-producer / single-consumer ring.  A dedicated writer
+// thread drains the ring in batches, writing to the log file and invoking
+// the app's debug output callback.  This keeps disk I/O and whatever the
+// app does in its callback off of the service thread and out of the global
+// lock.  If the ring is full, we drop the message and count it, rather than
+// block.
+//
+/////////////////////////////////////////////////////////////////////////////
+
+struct SpewRecord_t
+{
+	std::atomic<uint32> m_nSeq; // Sequence number used to coordinate producers and the consumer
+	ESteamNetworkingSocketsDebugOutputType m_eType;
+	SteamNetworkingMicroseconds m_usecTime;
+	char m_szMsg[ 2048 ];
+};
+
+class CSpewAsyncQueue
+{
+public:
+
+	// NOTE: No destructor.  The records are freed by SpewAsyncShutdown.  If the
+	// app exits without shutting us down, the writer thread might still be
+	// running during static destruction, so we leak them on purpose.
+
+	/// Allocate the ring.  Called while holding s_spewAsyncWriterLock.
+	void Init( int nSize )
+	{
+		uint32 nCapacity = 16;
+		while ( nCapacity < (uint32)nSize )
+			nCapacity <<= 1;
+		m_pRecords = new SpewRecord_t[ nCapacity ];
+		for ( uint32 i = 0 ; i < nCapacity ; ++i )
+			m_pRecords[i].m_nSeq.store( i, std::memory_order_relaxed );
+		m_nMask = nCapacity-1;
+		m_nEnqueuePos.store( 0, std::memory_order_relaxed );
+		m_nDequeuePos = 0;
+	}
+
+	/// Called by any thread.  Returns false if the queue is full.
+	bool Push( ESteamNetworkingSocketsDebugOutputType eType, SteamNetworkingMicroseconds usecTime, const char *pszMsg )
+	{
+		SpewRecord_t *pRec;
+		uint32 nPos = m_nEnqueuePos.load( std::memory_order_relaxed );
+		for (;;)
+		{
+			pRec = &m_pRecords[ nPos & m_nMask ];
+			uint32 nSeq = pRec->m_nSeq.load( std::memory_order_acquire );
+			int32 nDiff = (int32)( nSeq - nPos );
+			if ( nDiff == 0 )
+			{
+				if ( m_nEnqueuePos.compare_exchange_weak( nPos, nPos+1, std::memory_order_relaxed ) )
+					break;
+			}
+			else if ( nDiff < 0 )
+			{
+				// Slot still owned by the consumer.  We're full.
+				return false;
+			}
+			else
+			{
+				nPos = m_nEnqueuePos.load( std::memory_order_relaxed );
+			}
+		}
+
+		pRec->m_eType = eType;
+		pRec->m_usecTime = usecTime;
+		V_strncpy( pRec->m_szMsg, pszMsg, sizeof(pRec->m_szMsg) );
+		pRec->m_nSeq.store( nPos+1, std::memory_order_release );
+		return true;
+	}
+
+	/// Called only by the writer thread.  Returns the next record that has
+	/// been published, or nullptr if there isn't one.  You must call
+	/// PopFinish when you are done with it.
+	SpewRecord_t *PopPeek()
+	{
+		SpewRecord_t *pRec = &m_pRecords[ m_nDequeuePos & m_nMask ];
+		uint32 nSeq = pRec->m_nSeq.load( std::memory_order_acquire );
+		if ( nSeq != m_nDequeuePos+1 )
+			return nullptr;
+		return pRec;
+	}
+	void PopFinish( SpewRecord_t *pRec )
+	{
+		pRec->m_nSeq.store( m_nDequeuePos + m_nMask + 1, std::memory_order_release );
+		++m_nDequeuePos;
+	}
+
+	bool IsInitted() const { return m_pRecords != nullptr; }
+
+	/// Free the ring.  Nobody else can be using it
+	void Free()
+	{
+		delete[] m_pRecords;
+		m_pRecords = nullptr;
+		m_nMask = 0;
+	}
+
+private:
+	SpewRecord_t *m_pRecords = nullptr;
+	uint32 m_nMask = 0;
+	std::atomic<uint32> m_nEnqueuePos;
+	uint32 m_nDequeuePos = 0; // Only touched by the consumer
+};
+
+static CSpewAsyncQueue s_spewAsyncQueue;
+static std::atomic<CSpewAsyncQueue *> s_pSpewAsyncQueue( nullptr ); // Set once the queue is ready to use.  Cleared by SpewAsyncShutdown
+static std::atomic<int> s_nSpewAsyncProducers( 0 ); // Number of threads that might be using s_pSpewAsyncQueue
+static bool s_bSpewAsyncAllowed = false; // Set by InitSpew, cleared by KillSpew.  Protected by s_spewAsyncWriterLock
+static std::atomic<uint32> s_nSpewAsyncDropped( 0 ); // Dropped since we last reported it
+static std::atomic<bool> s_bSpewAsyncPending( false ); // Set by producers when they want the writer to wake up
+static std::atomic<bool> s_bSpewAsyncWriterExit( false );
+static std::thread *s_pSpewAsyncWriterThread = nullptr; // Protected by s_spewAsyncWriterLock
+static std::atomic<bool> s_bSpewAsyncWriterRunning( false ); // Lockless hint that s_pSpewAsyncWriterThread is set
+static std::mutex s_spewAsyncWriterLock; // Protects thread start/stop.  Never held by the writer thread itself
+static std::mutex s_spewAsyncConsumerLock; // Held while draining, since the queue only supports one consumer at a time
+static std::mutex s_spewAsyncWakeMutex;
+static std::condition_variable s_spewAsyncWake;
+
+/// How long the writer thread will sleep, max, when it has not been explicitly
+/// woken.  This is just a safety net against a lost wakeup, since producers
+/// signal without holding the mutex.
+constexpr int k_msecSpewAsyncWriterMaxSleep = 100;
+
+/// How long the writer waits after being woken before draining the queue,
+/// so that we write in batches.
+constexpr int k_msecSpewAsyncWriterBatchDelay = 5;
+
+static void SpewAsyncWake()
+{
+	if ( !s_bSpewAsyncPending.exchange( true, std::memory_order_acq_rel ) )
+		s_spewAsyncWake.notify_one();
+}
+
+/// Deliver a single message, from the writer thread
+static void SpewAsyncDeliver( ESteamNetworkingSocketsDebugOutputType eType, SteamNetworkingMicroseconds usecTime, const char *pszMsg )
+{
+	#ifdef STEAMNETWORKINGSOCKETS_ENABLE_SYSTEMSPEW
+		if ( eType <= g_eSystemSpewLevel && g_pFileSystemSpew )
+		{
+			ShortDurationScopeLock scopeLock( s_systemSpewLock );
+			if ( eType <= g_eSystemSpewLevel && g_pFileSystemSpew )
+			{
+				SteamNetworkingMicroseconds usecLogTime = usecTime - g_usecSystemLogFileOpened;
+				fprintf( g_pFileSystemSpew, "%8.3f %s\n", usecLogTime*1e-6, pszMsg );
+				s_bNeedToFlushSystemSpew = true;
+			}
+		}
+	#endif
+
+	FSteamNetworkingSocketsDebugOutput pfnDebugOutput = g_pfnDebugOutput;
+	if ( pfnDebugOutput )
+		pfnDebugOutput( eType, pszMsg );
+}
+
+/// Drain everything currently in the queue.  Only called from the writer thread
+/// (or after it has been stopped, by the thread that stopped it.)
+static void SpewAsyncDrain( CSpewAsyncQueue *pQueue )
+{
+	std::lock_guard<std::mutex> lock( s_spewAsyncConsumerLock );
+	while ( SpewRecord_t *pRec = pQueue->PopPeek() )
+	{
+		SpewAsyncDeliver( pRec->m_eType, pRec->m_usecTime, pRec->m_szMsg );
+		pQueue->PopFinish( pRec );
+	}
+
+	// Report drops after the messages that made it, so the report
+	// appears roughly where the gap is
+	uint32 nDropped = s_nSpewAsyncDropped.exchange( 0, std::memory_order_relaxed );
+	if ( nDropped > 0 )
+	{
+		char msg[ 128 ];
+		V_sprintf_safe( msg, "[%u spew message(s) dropped; async spew queue was full.  Consider increasing SpewAsyncQueueSize]", nDropped );
+		SpewAsyncDeliver( k_ESteamNetworkingSocketsDebugOutputType_Warning, SteamNetworkingSockets_GetLocalTimestamp(), msg );
+	}
+
+	// We're a background thread, we can afford to hit the disk
+	#ifdef STEAMNETWORKINGSOCKETS_ENABLE_SYSTEMSPEW
+		if ( s_bNeedToFlushSystemSpew )
+		{
+			ShortDurationScopeLock scopeLock( s_systemSpewLock );
+			if ( g_pFileSystemSpew )
+				fflush( g_pFileSystemSpew );
+			s_bNeedToFlushSystemSpew = false;
+		}
+	#endif
+}
+
+static void SpewAsyncWriterThreadProc()
+{
+	while ( !s_bSpewAsyncWriterExit.load( std::memory_order_acquire ) )
+	{
+		{
+			std::unique_lock<std::mutex> lock( s_spewAsyncWakeMutex );
+			s_spewAsyncWake.wait_for( lock, std::chrono::milliseconds( k_msecSpewAsyncWriterMaxSleep ), []{
+				return s_bSpewAsyncPending.load( std::memory_order_acquire ) || s_bSpewAsyncWriterExit.load( std::memory_order_acquire );
+			} );
+		}
+		if ( !s_bSpewAsyncPending.load( std::memory_order_acquire ) )
+			continue;
+
+		// Give other messages a chance to accumulate, so we can write them in a batch.
+		// If someone is shutting us down, don't bother
+		if ( !s_bSpewAsyncWriterExit.load( std::memory_order_acquire ) )
+			std::this_thread::sleep_for( std::chrono::milliseconds( k_msecSpewAsyncWriterBatchDelay ) );
+
+		// Clear the flag before draining, so that anything pushed after this
+		// point will wake us again
+		s_bSpewAsyncPending.store( false, std::memory_order_release );
+		SpewAsyncDrain( &s_spewAsyncQueue );
+	}
+}
+
+/// Make sure the queue is allocated and the writer thread is running.
+/// Returns the queue, or nullptr if async spew is not enabled.
+static CSpewAsyncQueue *SpewAsyncGetQueue()
+{
+	CSpewAsyncQueue *pQueue = s_pSpewAsyncQueue.load( std::memory_order_acquire );
+	if ( pQueue && s_bSpewAsyncWriterRunning.load( std::memory_order_acquire ) )
+		return pQueue;
+
+	int nSize = GlobalConfig::SpewAsyncQueueSize.Get();
+	if ( nSize <= 0 && !pQueue )
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock( s_spewAsyncWriterLock );
+
+	// Don't start back up after we've been shut down.  (E.g. something
+	// spewing after KillSpew.)
+	if ( !s_bSpewAsyncAllowed )
+		return nullptr;
+
+	if ( !s_spewAsyncQueue.IsInitted() )
+	{
+		s_spewAsyncQueue.Init( nSize );
+		s_pSpewAsyncQueue.store( &s_spewAsyncQueue, std::memory_order_release );
+	}
+	if ( !s_pSpewAsyncWriterThread )
+	{
+		s_bSpewAsyncWriterExit.store( false, std::memory_order_release );
+		s_pSpewAsyncWriterThread = new std::thread( SpewAsyncWriterThreadProc );
+		s_bSpewAsyncWriterRunning.store( true, std::memory_order_release );
+	}
+	return &s_spewAsyncQueue;
+}
+
+/// Grab the queue so that we can push to it.  If this returns non-NULL,
+/// you must call SpewAsyncEndPush when you are done with it.
+static CSpewAsyncQueue *SpewAsyncBeginPush()
+{
+	// Announce ourselves before we look at the pointer.  SpewAsyncShutdown
+	// clears the pointer and then waits for the count to reach zero, so
+	// either we will see NULL, or it will wait for us.
+	s_nSpewAsyncProducers.fetch_add( 1, std::memory_order_seq_cst );
+	CSpewAsyncQueue *pQueue = SpewAsyncGetQueue();
+	if ( !pQueue )
+		s_nSpewAsyncProducers.fetch_sub( 1, std::memory_order_release );
+	return pQueue;
+}
+
+static void SpewAsyncEndPush()
+{
+	s_nSpewAsyncProducers.fetch_sub( 1, std::memory_order_release );
+}
+
+/// Stop the writer thread (if any), deliver anything left in the queue,
+/// and free it.  Nothing will be queued again until InitSpew is called.
+static void SpewAsyncShutdown()
+{
+	CSpewAsyncQueue *pQueue;
+	{
+		std::lock_guard<std::mutex> lock( s_spewAsyncWriterLock );
+		s_bSpewAsyncAllowed = false;
+		if ( s_pSpewAsyncWriterThread )
+		{
+			s_bSpewAsyncWriterExit.store( true, std::memory_order_release );
+			s_spewAsyncWake.notify_one();
+			s_pSpewAsyncWriterThread->join();
+			delete s_pSpewAsyncWriterThread;
+			s_pSpewAsyncWriterThread = nullptr;
+		}
+
+		// Clear these only after the thread has exited.  If the callback spews
+		// while we are waiting, the message just goes into the queue, rather
+		// than trying to restart the thread and deadlocking
+		s_bSpewAsyncWriterRunning.store( false, std::memory_order_release );
+		pQueue = s_pSpewAsyncQueue.exchange( nullptr, std::memory_order_seq_cst );
+	}
+	if ( !pQueue )
+		return;
+
+	// Wait for anybody who grabbed the pointer before we cleared it.  We
+	// must not hold the lock here, since they might be waiting on it.
+	while ( s_nSpewAsyncProducers.load( std::memory_order_seq_cst ) > 0 )
+		std::this_thread::yield();
+
+	// Deliver anything that was queued after the writer thread did its final
+	// pass.  Don't hold the lock, in case the callback spews.
+	SpewAsyncDrain( pQueue );
+
+	// Free it, so that the next time we start up, we will use the
+	// current queue size
+	pQueue->Free();
+}
+
 void InitSpew()
 {
+	// Async spew can start up again, if it's enabled.  (Don't take this
+	// lock while holding s_systemSpewLock; the writer thread needs that one.)
+	{
+		std::lock_guard<std::mutex> lock( s_spewAsyncWriterLock );
+		s_bSpewAsyncAllowed = true;
+	}
+
 	ShortDurationScopeLock scopeLock( s_systemSpewLock );
 
 	// First time, check environment variables and set system spew level
@@ -95,6 +418,9 @@ void InitSpew()
 
 void KillSpew()
 {
+	// Deliver anything still queued while we still have somewhere to put it
+	SpewAsyncShutdown();
+
 	ShortDurationScopeLock scopeLock( s_systemSpewLock );
 	g_eDefaultGroupSpewLevel = g_eAppSpewLevel = k_ESteamNetworkingSocketsDebugOutputType_None;
 	g_pfnDebugOutput = nullptr;
@@ -251,6 +577,18 @@ STEAMNETWORKINGSOCKETS_INTERFACE void SteamNetworkingSockets_DefaultPreFormatDeb
 		}
 	}
 
+	// Hand off to the writer thread?
+	if ( CSpewAsyncQueue *pQueue = SpewAsyncBeginPush() )
+	{
+		if ( !pQueue->Push( eType, SteamNetworkingSockets_GetLocalTimestamp(), buf ) )
+			s_nSpewAsyncDropped.fetch_add( 1, std::memory_order_relaxed );
+		SpewAsyncEndPush();
+
+		// Only the first message of a batch actually signals the writer
+		SpewAsyncWake();
+		return;
+	}
+
 	// Spew to log file?
 	#ifdef STEAMNETWORKINGSOCKETS_ENABLE_SYSTEMSPEW
 		if ( eType <= g_eSystemSpewLevel && g_pFileSystemSpew )
@@ -3,6 +3,8 @@
 // Task queue implementation for SteamNetworkingSockets.
 //
 #include "steamnetworkingsockets_lowlevel.h"
+#include <condition_variable>
+#include <deque>
 #include <tier0/memdbgoff.h>
 
 namespace SteamNetworkingSocketsLib {
@@ -347,4 +349,120 @@ void CQueuedTask::QueueToRunInBackground()
 	WakeServiceThread();
 }
 
+/////////////////////////////////////////////////////////////////////////////
+//
+// Worker threads
+//
+/////////////////////////////////////////////////////////////////////////////
+
+class CWorkerThreadPool
+{
+public:
+
+	void QueueTask( CQueuedTask *pTask )
+	{
+		Assert( pTask->m_eTaskState == CQueuedTask::k_ETaskState_Init );
+		Assert( !pTask->m_pTarget );
+
+		int nDesiredThreads = GlobalConfig::HandshakeWorkerThreads.Get();
+		std::unique_lock<std::mutex> lock( m_lock );
+
+		// Spin up more threads if they have raised the limit.  If they
+		// turned it off, but we already have threads, use them.
+		while ( (int)m_vecThreads.size() < nDesiredThreads )
+			m_vecThreads.push_back( new std::thread( [this]() { WorkerThreadProc(); } ) );
+		if ( m_vecThreads.empty() )
+		{
+			lock.unlock();
+			RunTask( pTask );
+			return;
+		}
+
+		pTask->m_eTaskState = CQueuedTask::k_ETaskState_Queued;
+		m_queueTasks.push_back( pTask );
+		lock.unlock();
+		m_condWake.notify_one();
+	}
+
+	void Shutdown()
+	{
+		std::unique_lock<std::mutex> lock( m_lock );
+		if ( m_vecThreads.empty() )
+		{
+			Assert( m_queueTasks.empty() );
+			return;
+		}
+
+		// Discard anything that hasn't started
+		while ( !m_queueTasks.empty() )
+		{
+			CQueuedTask *pTask = m_queueTasks.front();
+			m_queueTasks.pop_front();
+			pTask->m_eTaskState = CQueuedTask::k_ETaskState_ReadyToDelete;
+			delete pTask;
+		}
+
+		// Tell threads to exit, and wait for any tasks in progress to finish
+		m_bExit = true;
+		std::vector<std::thread *> vecThreads;
+		vecThreads.swap( m_vecThreads );
+		lock.unlock();
+		m_condWake.notify_all();
+		for ( std::thread *pThread: vecThreads )
+		{
+			pThread->join();
+			delete pThread;
+		}
+
+		// Ready to start up again, if they re-init
+		lock.lock();
+		m_bExit = false;
+	}
+
+private:
+	std::mutex m_lock;
+	std::condition_variable m_condWake;
+	std::deque<CQueuedTask *> m_queueTasks;
+	std::vector<std::thread *> m_vecThreads;
+	bool m_bExit = false;
+
+	static void RunTask( CQueuedTask *pTask )
+	{
+		pTask->m_eTaskState = CQueuedTask::k_ETaskState_Running;
+		pTask->Run();
+		pTask->m_eTaskState = CQueuedTask::k_ETaskState_ReadyToDelete;
+		delete pTask;
+	}
+
+	void WorkerThreadProc()
+	{
+		std::unique_lock<std::mutex> lock( m_lock );
+		for (;;)
+		{
+			m_condWake.wait( lock, [this]() { return m_bExit || !m_queueTasks.empty(); } );
+			if ( m_bExit )
+				return;
+			CQueuedTask *pTask = m_queueTasks.front();
+			m_queueTasks.pop_front();
+			lock.unlock();
+			RunTask( pTask );
+			lock.lock();
+		}
+	}
+};
+
+static CWorkerThreadPool s_workerThreadPool;
+
+void CQueuedTask::QueueToRunOnWorkerThread()
+{
+	s_workerThreadPool.QueueTask( this );
+
+	// NOTE: At this point we are subject to being run or deleted at any time!
+}
+
+void ShutdownWorkerThreads()
+{
+	s_workerThreadPool.Shutdown();
+}
+
 } // namespace SteamNetworkingSocketsLib
@@ -91,6 +91,130 @@ static int GetIPAllowWithoutAuth( const ConnectionConfig &cfg, bool bIsLocalHost
 	return result;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+//
+// Session resumption
+//
+/////////////////////////////////////////////////////////////////////////////
+
+// Tickets are encrypted with AES-GCM, with a random IV at the front
+const int k_cbResumptionTicketIV = 12;
+const int k_cbMaxResumptionTicket = 512;
+
+// Don't let the client-side ticket cache grow without bound
+const int k_nMaxResumptionTicketsCached = 64;
+
+// How many times do we try to resume, before we fall back to the full handshake?
+const int k_nMaxResumeConnectRequests = 2;
+
+// Handshake admission control.  See CSteamNetworkListenSocketDirectUDP::BAdmitHandshakePacket
+const int k_nHandshakeBurstSeconds = 2; // Token bucket can hold this many seconds worth
+const int k_nMaxHandshakeBuckets = 4096;
+const int k_nMaxDeferredConnectRequests = 256;
+const SteamNetworkingMicroseconds k_usecDeferredConnectRequestRetry = 1000;
+const SteamNetworkingMicroseconds k_usecDeferredConnectRequestTimeout = 2*k_nMillion;
+const int k_cbMinConnectRequest = 32;
+
+/// Key used to encrypt the tickets we issue.  It's random, and only lives as
+/// long as this process, so tickets are only useful with the server that issued them.
+static const AutoWipeFixedSizeBuffer<32> &GetResumptionTicketKey()
+{
+	struct Key_t
+	{
+		Key_t() { CCrypto::GenerateRandomBlock( m_key.m_buf, m_key.k_nSize ); }
+		AutoWipeFixedSizeBuffer<32> m_key;
+	};
+	static Key_t s_key;
+	return s_key.m_key;
+}
+
+static bool BEncryptResumptionTicket( const CMsgSteamSockets_UDP_ResumptionTicket &msgTicket, std::string &outTicket )
+{
+	const AutoWipeFixedSizeBuffer<32> &key = GetResumptionTicketKey();
+	AES_GCM_EncryptContext ctx;
+	if ( !ctx.Init( key.m_buf, key.k_nSize, k_cbResumptionTicketIV, k_cbAESGCMTagSize ) )
+		return false;
+
+	std::string sPlaintext = msgTicket.SerializeAsString();
+	outTicket.resize( k_cbResumptionTicketIV + sPlaintext.length() + k_cbAESGCMTagSize );
+	uint8 *pIV = (uint8 *)&outTicket[0];
+	CCrypto::GenerateRandomBlock( pIV, k_cbResumptionTicketIV );
+	uint32 cbEncrypted = uint32( outTicket.length() - k_cbResumptionTicketIV );
+	bool bOK = ctx.Encrypt( sPlaintext.c_str(), sPlaintext.length(), pIV, pIV + k_cbResumptionTicketIV, &cbEncrypted, nullptr, 0 );
+	SecureZeroMemory( &sPlaintext[0], sPlaintext.length() );
+	if ( !bOK )
+		return false;
+	outTicket.resize( k_cbResumptionTicketIV + cbEncrypted );
+	return (int)outTicket.length() <= k_cbMaxResumptionTicket;
+}
+
+static bool BDecryptResumptionTicket( const std::string &sTicket, CMsgSteamSockets_UDP_ResumptionTicket &outMsgTicket )
+{
+	if ( (int)sTicket.length() <= k_cbResumptionTicketIV + k_cbAESGCMTagSize || (int)sTicket.length() > k_cbMaxResumptionTicket )
+		return false;
+
+	const AutoWipeFixedSizeBuffer<32> &key = GetResumptionTicketKey();
+	AES_GCM_DecryptContext ctx;
+	if ( !ctx.Init( key.m_buf, key.k_nSize, k_cbResumptionTicketIV, k_cbAESGCMTagSize ) )
+		return false;
+
+	uint8 plaintext[ k_cbMaxResumptionTicket ];
+	uint32 cbPlaintext = sizeof(plaintext);
+	const uint8 *pIV = (const uint8 *)sTicket.c_str();
+	bool bOK = ctx.Decrypt( pIV + k_cbResumptionTicketIV, sTicket.length() - k_cbResumptionTicketIV, pIV, plaintext, &cbPlaintext, nullptr, 0 )
+		&& outMsgTicket.ParseFromArray( plaintext, cbPlaintext );
+	SecureZeroMemory( plaintext, sizeof(plaintext) );
+	return bOK && outMsgTicket.secret().length() == AutoWipeFixedSizeBuffer<32>::k_nSize;
+}
+
+/// Tickets that servers have given us, so that we can resume sessions with
+/// them later.  Protected by the global lock.
+static std::vector< std::unique_ptr<UDPSessionResumptionTicket_t> > s_vecResumptionTicketCache;
+
+static std::unique_ptr<UDPSessionResumptionTicket_t> TakeResumptionTicket( const netadr_t &adrServer, const SteamNetworkingIdentity &identityLocal, SteamNetworkingMicroseconds usecNow )
+{
+	SteamNetworkingGlobalLock::AssertHeldByCurrentThread();
+	std::unique_ptr<UDPSessionResumptionTicket_t> result;
+	for ( int i = len( s_vecResumptionTicketCache )-1 ; i >= 0 ; --i )
+	{
+		UDPSessionResumptionTicket_t *p = s_vecResumptionTicketCache[i].get();
+		bool bExpired = p->m_usecExpiry <= usecNow;
+		if ( !bExpired && ( result || !( p->m_adrServer == adrServer ) || !( p->m_identityLocal == identityLocal ) ) )
+			continue;
+		if ( !bExpired )
+			result = std::move( s_vecResumptionTicketCache[i] );
+		erase_at( s_vecResumptionTicketCache, i );
+	}
+	return result;
+}
+
+static void CacheResumptionTicket( std::unique_ptr<UDPSessionResumptionTicket_t> &&pTicket )
+{
+	SteamNetworkingGlobalLock::AssertHeldByCurrentThread();
+
+	// Only one ticket per server and local identity.  Replace any old one
+	for ( int i = len( s_vecResumptionTicketCache )-1 ; i >= 0 ; --i )
+	{
+		UDPSessionResumptionTicket_t *p = s_vecResumptionTicketCache[i].get();
+		if ( p->m_adrServer == pTicket->m_adrServer && p->m_identityLocal == pTicket->m_identityLocal )
+			erase_at( s_vecResumptionTicketCache, i );
+	}
+
+	// Full?  Discard the one that expires soonest
+	if ( len( s_vecResumptionTicketCache ) >= k_nMaxResumptionTicketsCached )
+	{
+		int iOldest = 0;
+		for ( int i = 1 ; i < len( s_vecResumptionTicketCache ) ; ++i )
+		{
+			if ( s_vecResumptionTicketCache[i]->m_usecExpiry < s_vecResumptionTicketCache[iOldest]->m_usecExpiry )
+				iOldest = i;
+		}
+		erase_at( s_vecResumptionTicketCache, iOldest );
+	}
+
+	s_vecResumptionTicketCache.emplace_back( std::move( pTicket ) );
+}
+
 /////////////////////////////////////////////////////////////////////////////
 //
 // CSteamNetworkListenSocketDirectUDP
@@ -99,8 +223,14 @@ static int GetIPAllowWithoutAuth( const ConnectionConfig &cfg, bool bIsLocalHost
 
 CSteamNetworkListenSocketDirectUDP::CSteamNetworkListenSocketDirectUDP( CSteamNetworkingSockets *pSteamNetworkingSocketsInterface )
 : CSteamNetworkListenSocketBase( pSteamNetworkingSocketsInterface )
+, m_scheduleDeferredConnectRequests( this, &CSteamNetworkListenSocketDirectUDP::ThinkDeferredConnectRequests )
 {
 	m_pSock = nullptr;
+	m_handshakeBucketOverflow.m_flTokens = 0.0f;
+	m_handshakeBucketOverflow.m_usecLastRefill = 0;
+	m_usecLastPruneHandshakeBuckets = 0;
+	m_flHandshakeCPUBudgetUsec = 0.0f;
+	m_usecHandshakeCPUBudgetLastRefill = 0;
 }
 
 CSteamNetworkListenSocketDirectUDP::~CSteamNetworkListenSocketDirectUDP()
@@ -153,6 +283,13 @@ bool CSteamNetworkListenSocketDirectUDP::BInit( const SteamNetworkingIPAddr &loc
 
 	CCrypto::GenerateRandomBlock( m_argbChallengeSecret, sizeof(m_argbChallengeSecret) );
 
+	// Start with a full CPU budget for handshakes
+	m_flHandshakeCPUBudgetUsec = (float)m_connectionConfig.IP_HandshakeCPUBudget.Get();
+	m_usecHandshakeCPUBudgetLastRefill = SteamNetworkingSockets_GetLocalTimestamp();
+
+	// Get some key exchange keys ready for the connections we're about to receive
+	PrimeKeyExchangeKeyPool();
+
 	return true;
 }
 
@@ -180,7 +317,7 @@ bool CSteamNetworkListenSocketDirectUDP::APIGetAddress( SteamNetworkingIPAddr *p
 
 void CSteamNetworkListenSocketDirectUDP::ReceivedFromUnknownHost( const RecvPktInfo_t &info, CSteamNetworkListenSocketDirectUDP *pSock )
 {
-	const uint8 *pPkt = static_cast<const uint8 *>( info.m_pPkt );
+	const uint8 *pPkt = info.m_pPkt;
 	int cbPkt = info.m_cbPkt;
 	const netadr_t &adrFrom = info.m_adrFrom;
 
@@ -213,13 +350,39 @@ void CSteamNetworkListenSocketDirectUDP::ReceivedFromUnknownHost( const RecvPktI
 	}
 	else if ( *pPkt == k_ESteamNetworkingUDPMsg_ChallengeRequest )
 	{
+		// Cheap checks before we spend any more time on it
+		float flPriority;
+		if ( cbPkt < k_cbSteamNetworkingMinPaddedPacketSize )
+		{
+			if ( unlikely( BPerfMetricsEnabled() ) )
+				PerfCounterAdd( k_EPerfCounter_HandshakeFiltered, 1 );
+			ReportBadPacket( "ChallengeRequest", "Packet is %d bytes, must be padded to at least %d bytes.", cbPkt, k_cbSteamNetworkingMinPaddedPacketSize );
+			return;
+		}
+		if ( !pSock->BAdmitHandshakePacket( adrFrom, usecNow, flPriority ) )
+			return;
+
 		ParsePaddedPacket( pPkt, cbPkt, CMsgSteamSockets_UDP_ChallengeRequest, msg )
 		pSock->Received_ChallengeRequest( msg, adrFrom, usecNow );
 	}
 	else if ( *pPkt == k_ESteamNetworkingUDPMsg_ConnectRequest )
 	{
+		// Cheap check before we parse it.  A real request carries crypt
+		// info, so it can't be tiny.  Anything else that's malformed will
+		// fail to parse.
+		float flPriority;
+		if ( cbPkt < k_cbMinConnectRequest )
+		{
+			if ( unlikely( BPerfMetricsEnabled() ) )
+				PerfCounterAdd( k_EPerfCounter_HandshakeFiltered, 1 );
+			ReportBadPacket( "ConnectRequest", "%d byte packet doesn't look like a connect request", cbPkt );
+			return;
+		}
+		if ( !pSock->BAdmitHandshakePacket( adrFrom, usecNow, flPriority ) )
+			return;
+
 		ParseProtobufBody( pPkt+1, cbPkt-1, CMsgSteamSockets_UDP_ConnectRequest, msg )
-		pSock->Received_ConnectRequest( msg, adrFrom, cbPkt, usecNow );
+		pSock->Received_ConnectRequest( msg, adrFrom, cbPkt, flPriority, usecNow );
 	}
 	else if ( *pPkt == k_ESteamNetworkingUDPMsg_ConnectionClosed )
 	{
@@ -247,6 +410,202 @@ void CSteamNetworkListenSocketDirectUDP::ReceivedFromUnknownHost( const RecvPktI
 	}
 }
 
+bool CSteamNetworkListenSocketDirectUDP::BAdmitHandshakePacket( const netadr_t &adrFrom, SteamNetworkingMicroseconds usecNow, float &flPriority )
+{
+	flPriority = 1.0f;
+	const int nRate = m_connectionConfig.IP_HandshakeRatePerPrefix.Get();
+	if ( nRate <= 0 )
+		return true;
+	const float flBurst = float( nRate * k_nHandshakeBurstSeconds );
+
+	// Locate the bucket for their prefix.  Hash the prefix with
+	// our secret, so the table can't be attacked with collisions.
+	uint8 prefix[16];
+	adrFrom.GetIPV6( prefix );
+	if ( adrFrom.GetType() == k_EIPTypeV4 )
+		prefix[15] = 0; // IPv4 /24
+	else
+		memset( prefix+8, 0, 8 ); // IPv6 /64
+	const uint64 nPrefixKey = CCrypto::SipHash( prefix, sizeof(prefix), m_argbChallengeSecret );
+
+	HandshakeTokenBucket_t *pBucket;
+	int idx = m_mapHandshakeBuckets.Find( nPrefixKey );
+	if ( idx != m_mapHandshakeBuckets.InvalidIndex() )
+	{
+		pBucket = &m_mapHandshakeBuckets[ idx ];
+	}
+	else
+	{
+
+		// Table full?  Throw away buckets that have been idle long enough
+		// to be full again, since a fresh bucket would be the same.  Don't
+		// scan too often, if a flood is keeping the table full.
+		if ( m_mapHandshakeBuckets.Count() >= k_nMaxHandshakeBuckets && usecNow > m_usecLastPruneHandshakeBuckets + k_nMillion )
+		{
+			m_usecLastPruneHandshakeBuckets = usecNow;
+			const SteamNetworkingMicroseconds usecIdle = k_nHandshakeBurstSeconds*k_nMillion;
+			std_vector<uint64> vecIdle;
+			for ( auto item: m_mapHandshakeBuckets.IterItems() )
+			{
+				if ( item.Element().m_usecLastRefill + usecIdle < usecNow )
+					vecIdle.push_back( item.Key() );
+			}
+			for ( uint64 nKey: vecIdle )
+				m_mapHandshakeBuckets.Remove( nKey );
+		}
+
+		if ( m_mapHandshakeBuckets.Count() < k_nMaxHandshakeBuckets )
+		{
+			HandshakeTokenBucket_t bucket;
+			bucket.m_flTokens = flBurst;
+			bucket.m_usecLastRefill = usecNow;
+			idx = m_mapHandshakeBuckets.Insert( nPrefixKey, bucket );
+			pBucket = &m_mapHandshakeBuckets[ idx ];
+		}
+		else
+		{
+			pBucket = &m_handshakeBucketOverflow;
+		}
+	}
+
+	// Refill
+	if ( usecNow > pBucket->m_usecLastRefill )
+	{
+		pBucket->m_flTokens = std::min( flBurst, pBucket->m_flTokens + float( usecNow - pBucket->m_usecLastRefill ) * 1e-6f * float( nRate ) );
+		pBucket->m_usecLastRefill = usecNow;
+	}
+
+	// Spend a token
+	if ( pBucket->m_flTokens < 1.0f )
+	{
+		if ( unlikely( BPerfMetricsEnabled() ) )
+			PerfCounterAdd( k_EPerfCounter_HandshakeRateLimited, 1 );
+		return false;
+	}
+	flPriority = pBucket->m_flTokens / flBurst;
+	pBucket->m_flTokens -= 1.0f;
+	return true;
+}
+
+bool CSteamNetworkListenSocketDirectUDP::BHandshakeCPUBudgetAvailable( SteamNetworkingMicroseconds usecNow )
+{
+	const int nBudget = m_connectionConfig.IP_HandshakeCPUBudget.Get();
+	if ( nBudget <= 0 )
+		return true;
+
+	// Budget is per second.  Allow it to accumulate for one second
+	if ( usecNow > m_usecHandshakeCPUBudgetLastRefill )
+	{
+		m_flHandshakeCPUBudgetUsec = std::min( (float)nBudget, m_flHandshakeCPUBudgetUsec + float( usecNow - m_usecHandshakeCPUBudgetLastRefill ) * 1e-6f * float( nBudget ) );
+		m_usecHandshakeCPUBudgetLastRefill = usecNow;
+	}
+	return m_flHandshakeCPUBudgetUsec > 0.0f;
+}
+
+void CSteamNetworkListenSocketDirectUDP::ProcessConnectRequestWithinBudget( const CMsgSteamSockets_UDP_ConnectRequest &msg, const CMsgSteamSockets_UDP_ResumptionTicket *pTicket, const netadr_t &adrFrom, int cbPkt, SteamNetworkingMicroseconds usecNow )
+{
+	SteamNetworkingMicroseconds usecStart = SteamNetworkingSockets_GetLocalTimestamp();
+	Process_ConnectRequest( msg, pTicket, adrFrom, cbPkt, usecNow );
+	if ( m_connectionConfig.IP_HandshakeCPUBudget.Get() > 0 )
+		m_flHandshakeCPUBudgetUsec -= float( SteamNetworkingSockets_GetLocalTimestamp() - usecStart );
+}
+
+void CSteamNetworkListenSocketDirectUDP::DeferConnectRequest( const CMsgSteamSockets_UDP_ConnectRequest &msg, const CMsgSteamSockets_UDP_ResumptionTicket *pTicket, const netadr_t &adrFrom, int cbPkt, float flPriority, SteamNetworkingMicroseconds usecNow )
+{
+	// Already have one from this address?  (They are retrying.)  Just
+	// replace it, we don't want to process both.
+	DeferredConnectRequest_t *pEntry = nullptr;
+	for ( const std::unique_ptr<DeferredConnectRequest_t> &p: m_vecDeferredConnectRequests )
+	{
+		if ( p->m_adrFrom == adrFrom )
+		{
+			pEntry = p.get();
+			flPriority = std::max( flPriority, p->m_flPriority );
+			break;
+		}
+	}
+
+	if ( !pEntry )
+	{
+		if ( len( m_vecDeferredConnectRequests ) < k_nMaxDeferredConnectRequests )
+		{
+			m_vecDeferredConnectRequests.emplace_back( new DeferredConnectRequest_t );
+			pEntry = m_vecDeferredConnectRequests.back().get();
+		}
+		else
+		{
+
+			// Queue is full.  Bump the lowest priority request, if this one is more important
+			int iLowest = 0;
+			for ( int i = 1 ; i < len( m_vecDeferredConnectRequests ) ; ++i )
+			{
+				if ( m_vecDeferredConnectRequests[i]->m_flPriority < m_vecDeferredConnectRequests[iLowest]->m_flPriority )
+					iLowest = i;
+			}
+			if ( unlikely( BPerfMetricsEnabled() ) )
+				PerfCounterAdd( k_EPerfCounter_ConnectRequestsDropped, 1 );
+			if ( m_vecDeferredConnectRequests[iLowest]->m_flPriority >= flPriority )
+				return;
+			erase_at( m_vecDeferredConnectRequests, iLowest );
+			m_vecDeferredConnectRequests.emplace_back( new DeferredConnectRequest_t );
+			pEntry = m_vecDeferredConnectRequests.back().get();
+		}
+	}
+
+	if ( unlikely( BPerfMetricsEnabled() ) )
+		PerfCounterAdd( k_EPerfCounter_ConnectRequestsDeferred, 1 );
+
+	pEntry->m_msg = msg;
+	pEntry->m_bResume = pTicket != nullptr;
+	if ( pTicket )
+		pEntry->m_msgTicket = *pTicket;
+	else
+		pEntry->m_msgTicket.Clear();
+	pEntry->m_adrFrom = adrFrom;
+	pEntry->m_cbPkt = cbPkt;
+	pEntry->m_flPriority = flPriority;
+	pEntry->m_usecReceived = usecNow;
+
+	m_scheduleDeferredConnectRequests.EnsureMinScheduleTime( usecNow + k_usecDeferredConnectRequestRetry );
+}
+
+void CSteamNetworkListenSocketDirectUDP::ThinkDeferredConnectRequests( SteamNetworkingMicroseconds usecNow )
+{
+	while ( !m_vecDeferredConnectRequests.empty() )
+	{
+		if ( !BHandshakeCPUBudgetAvailable( usecNow ) )
+		{
+
+			// Check back when we expect to have some budget again
+			const int nBudget = m_connectionConfig.IP_HandshakeCPUBudget.Get();
+			SteamNetworkingMicroseconds usecWait = SteamNetworkingMicroseconds( -m_flHandshakeCPUBudgetUsec * float( k_nMillion ) / float( nBudget ) );
+			m_scheduleDeferredConnectRequests.Schedule( usecNow + std::max( usecWait, k_usecDeferredConnectRequestRetry ) );
+			return;
+		}
+
+		// Take the highest priority request.  Among equals, the oldest
+		int iBest = 0;
+		for ( int i = 1 ; i < len( m_vecDeferredConnectRequests ) ; ++i )
+		{
+			if ( m_vecDeferredConnectRequests[i]->m_flPriority > m_vecDeferredConnectRequests[iBest]->m_flPriority )
+				iBest = i;
+		}
+		std::unique_ptr<DeferredConnectRequest_t> pEntry = std::move( m_vecDeferredConnectRequests[iBest] );
+		erase_at( m_vecDeferredConnectRequests, iBest );
+
+		// If it's been waiting too long, the challenge is probably too old
+		// and they have probably given up or sent another one anyway.
+		if ( pEntry->m_usecReceived + k_usecDeferredConnectRequestTimeout < usecNow )
+		{
+			if ( unlikely( BPerfMetricsEnabled() ) )
+				PerfCounterAdd( k_EPerfCounter_ConnectRequestsDropped, 1 );
+			continue;
+		}
+
+		ProcessConnectRequestWithinBudget( pEntry->m_msg, pEntry->m_bResume ? &pEntry->m_msgTicket : nullptr, pEntry->m_adrFrom, pEntry->m_cbPkt, usecNow );
+	}
+}
+
 uint64 CSteamNetworkListenSocketDirectUDP::GenerateChallenge( uint16 nTime, const netadr_t &adr ) const
 {
 	#pragma pack(push,1)
@@ -283,51 +642,119 @@ void CSteamNetworkListenSocketDirectUDP::Received_ChallengeRequest( const CMsgSt
 	//	return;
 	//}
 
+	SendChallengeReply( msg.connection_id(), msg.my_timestamp(), adrFrom, usecNow );
+}
+
+void CSteamNetworkListenSocketDirectUDP::SendChallengeReply( uint32 unConnectionID, uint64 ulRemoteTimestamp, const netadr_t &adrTo, SteamNetworkingMicroseconds usecNow )
+{
 	// Get time value of challenge
 	uint16 nTime = GetChallengeTime( usecNow );
 
 	// Generate a challenge
-	uint64 nChallenge = GenerateChallenge( nTime, adrFrom );
+	uint64 nChallenge = GenerateChallenge( nTime, adrTo );
 
 	// Send them a reply
 	CMsgSteamSockets_UDP_ChallengeReply msgReply;
-	msgReply.set_connection_id( msg.connection_id() );
+	msgReply.set_connection_id( unConnectionID );
 	msgReply.set_challenge( nChallenge );
-	msgReply.set_your_timestamp( msg.my_timestamp() );
+	msgReply.set_your_timestamp( ulRemoteTimestamp );
 	msgReply.set_protocol_version( k_nCurrentProtocolVersion );
-	SendMsg( k_ESteamNetworkingUDPMsg_ChallengeReply, msgReply, adrFrom );
+	SendMsg( k_ESteamNetworkingUDPMsg_ChallengeReply, msgReply, adrTo );
 }
 
-void CSteamNetworkListenSocketDirectUDP::Received_ConnectRequest( const CMsgSteamSockets_UDP_ConnectRequest &msg, const netadr_t &adrFrom, int cbPkt, SteamNetworkingMicroseconds usecNow )
+void CSteamNetworkListenSocketDirectUDP::Received_ConnectRequest( const CMsgSteamSockets_UDP_ConnectRequest &msg, const netadr_t &adrFrom, int cbPkt, float flPriority, SteamNetworkingMicroseconds usecNow )
 {
-	SteamDatagramErrMsg errMsg;
-
-	// Make sure challenge was generated relatively recently
-	uint16 nTimeThen = uint32( msg.challenge() );
-	uint16 nElapsed = GetChallengeTime( usecNow ) - nTimeThen;
-	if ( nElapsed > GetChallengeTime( 4*k_nMillion ) )
+	uint32 unClientConnectionID = msg.client_connection_id();
+	if ( unClientConnectionID == 0 )
 	{
-		ReportBadPacket( "ConnectRequest", "Challenge too old." );
+		ReportBadPacket( "ConnectRequest", "Missing connection ID" );
 		return;
 	}
 
-	// Assuming we sent them this time value, re-create the challenge we would have sent them.
-	if ( GenerateChallenge( nTimeThen, adrFrom ) != msg.challenge() )
+	// Are they trying to resume an earlier session, instead of
+	// answering a challenge?
+	CMsgSteamSockets_UDP_ResumptionTicket msgTicket;
+	bool bResume = false;
+	if ( msg.has_resumption_ticket() && !msg.has_challenge() )
 	{
-		ReportBadPacket( "ConnectRequest", "Incorrect challenge.  Could be spoofed." );
-		return;
-	}
 
-	uint32 unClientConnectionID = msg.client_connection_id();
-	if ( unClientConnectionID == 0 )
+		// Check the ticket.  It's bound to the address it was issued to, so
+		// it doesn't need a challenge to prove they aren't spoofing.  (The port
+		// is allowed to change.)  If we can't use it, just ask them to do the
+		// full handshake.  This is normal if it expired or we restarted.
+		uint8 ipv6[16];
+		adrFrom.GetIPV6( ipv6 );
+		if (
+			m_connectionConfig.IP_SessionResumption.Get() <= 0
+			|| !BDecryptResumptionTicket( msg.resumption_ticket(), msgTicket )
+			|| (SteamNetworkingMicroseconds)msgTicket.expiry() <= usecNow
+			|| msgTicket.client_ip().length() != sizeof(ipv6)
+			|| V_memcmp( msgTicket.client_ip().c_str(), ipv6, sizeof(ipv6) ) != 0
+		) {
+			if ( unlikely( BPerfMetricsEnabled() ) )
+				PerfCounterAdd( k_EPerfCounter_SessionResumptionsRejected, 1 );
+			SendChallengeReply( unClientConnectionID, msg.my_timestamp(), adrFrom, usecNow );
+			return;
+		}
+		bResume = true;
+	}
+	else
 	{
-		ReportBadPacket( "ConnectRequest", "Missing connection ID" );
-		return;
+
+		// Make sure challenge was generated relatively recently
+		uint16 nTimeThen = uint32( msg.challenge() );
+		uint16 nElapsed = GetChallengeTime( usecNow ) - nTimeThen;
+		if ( nElapsed > GetChallengeTime( 4*k_nMillion ) )
+		{
+			ReportBadPacket( "ConnectRequest", "Challenge too old." );
+			return;
+		}
+
+		// Assuming we sent them this time value, re-create the challenge we would have sent them.
+		if ( GenerateChallenge( nTimeThen, adrFrom ) != msg.challenge() )
+		{
+			ReportBadPacket( "ConnectRequest", "Incorrect challenge.  Could be spoofed." );
+			return;
+		}
 	}
 
-	// Parse out identity from the cert
+	// They have proven they own the address.  The rest is the expensive part.
+	// Do it now if we can afford it, and nobody is waiting ahead of them.
+	const CMsgSteamSockets_UDP_ResumptionTicket *pTicket = bResume ? &msgTicket : nullptr;
+	if ( m_vecDeferredConnectRequests.empty() && BHandshakeCPUBudgetAvailable( usecNow ) )
+		ProcessConnectRequestWithinBudget( msg, pTicket, adrFrom, cbPkt, usecNow );
+	else
+		DeferConnectRequest( msg, pTicket, adrFrom, cbPkt, flPriority, usecNow );
+}
+
+void CSteamNetworkListenSocketDirectUDP::Process_ConnectRequest( const CMsgSteamSockets_UDP_ConnectRequest &msg, const CMsgSteamSockets_UDP_ResumptionTicket *pTicket, const netadr_t &adrFrom, int cbPkt, SteamNetworkingMicroseconds usecNow )
+{
+	SteamDatagramErrMsg errMsg;
+	const uint32 unClientConnectionID = msg.client_connection_id();
+	const bool bResume = pTicket != nullptr;
+
+	// Parse out identity from the cert.  (Or the ticket, if resuming)
 	SteamNetworkingIdentity identityRemote;
 	bool bIdentityInCert = true;
+	if ( bResume )
+	{
+		if ( !identityRemote.ParseString( pTicket->identity_string().c_str() ) )
+		{
+			ReportBadPacket( "ConnectRequest", "Bad identity in resumption ticket" );
+			return;
+		}
+
+		// If their identity was their address, it was assigned by us
+		// using the address they connected from, so update the port
+		if ( identityRemote.m_eType == k_ESteamNetworkingIdentityType_IPAddress )
+		{
+			uint8 ipv6[16];
+			adrFrom.GetIPV6( ipv6 );
+			if ( V_memcmp( identityRemote.m_ip.m_ipv6, ipv6, sizeof(ipv6) ) == 0 )
+				identityRemote.m_ip.m_port = adrFrom.GetPort();
+		}
+	}
+	else
 	{
 		// !SPEED! We are deserializing the cert here,
 		// and then we are going to do it again below.
@@ -358,7 +785,7 @@ void CSteamNetworkListenSocketDirectUDP::Received_ConnectRequest( const CMsgStea
 	Assert( !identityRemote.IsInvalid() );
 
 	// Check if they are using an IP address as an identity (possibly the anonymous "localhost" identity)
-	if ( identityRemote.m_eType == k_ESteamNetworkingIdentityType_IPAddress )
+	if ( identityRemote.m_eType == k_ESteamNetworkingIdentityType_IPAddress && !bResume )
 	{
 		SteamNetworkingIPAddr addr;
 		adrFrom.GetIPV6( addr.m_ipv6 );
@@ -428,7 +855,7 @@ void CSteamNetworkListenSocketDirectUDP::Received_ConnectRequest( const CMsgStea
 	CSteamNetworkConnectionUDP *pConn = new CSteamNetworkConnectionUDP( m_pSteamNetworkingSocketsInterface, connectionLock );
 
 	// OK, they have completed the handshake.  Accept the connection.
-	if ( !pConn->BBeginAccept( this, adrFrom, m_pSock, identityRemote, unClientConnectionID, msg.cert(), msg.crypt(), errMsg ) )
+	if ( !pConn->BBeginAccept( this, adrFrom, m_pSock, identityRemote, unClientConnectionID, msg.cert(), msg.crypt(), pTicket, msg.resumption_mac(), errMsg ) )
 	{
 		SpewWarning( "Failed to accept connection from %s.  %s\n", CUtlNetAdrRender( adrFrom ).String(), errMsg );
 		pConn->ConnectionQueueDestroy();
@@ -567,7 +994,7 @@ int CConnectionTransportUDPBase::SendEncryptedDataChunk( const void *pChunk, int
 		TrackSentStats( ctx );
 
 		// Mark header with the flag
-		out.hdr.m_unMsgFlags |= out.hdr.kFlag_ProtobufBlob;
+		out.hdr.m_unMsgFlags |= ctx.m_bFixedStats ? out.hdr.kFlag_FixedStats : out.hdr.kFlag_ProtobufBlob;
 	}
 
 	// Send packet spacing value, for jitter analysis?
@@ -599,33 +1026,316 @@ int CConnectionTransportUDPBase::SendEncryptedDataChunk( const void *pChunk, int
 	return 0;
 }
 
-std::string DescribeStatsContents( const CMsgSteamSockets_UDP_Stats &msg )
+/////////////////////////////////////////////////////////////////////////////
+//
+// UDPInlineStats_t
+//
+// Fixed layout.  All values are little endian.  Values that are unknown
+// (negative in the structs) are sent as all ones.
+//
+//   uint8  flags, see k_nFixedStats_xxx
+//   [if k_nFixedStats_Instantaneous]
+//     uint32 out_packets_per_sec_x10, out_bytes_per_sec, in_packets_per_sec_x10, in_bytes_per_sec
+//     uint16 ping_ms
+//     uint16 packets_dropped, packets_weird_sequence.  Fraction of packets, in units of 1/10000
+//     uint32 peak_jitter_usec
+//   [if k_nFixedStats_Lifetime]
+//     uint32 connected_seconds
+//     uint64 packets_sent, bytes_sent, packets_recv, bytes_recv, packets_recv_sequenced,
+//            packets_recv_dropped, packets_recv_out_of_order, packets_recv_out_of_order_corrected,
+//            packets_recv_duplicate, packets_recv_lurch
+//     uint32 quality histogram, 9 buckets, 100 ... dead
+//     uint8  quality ntiles, 2nd, 5th, 25th, 50th
+//     uint32 ping histogram, 9 buckets, 25 ... max
+//     uint16 ping ntiles, 5th, 50th, 75th, 95th, 98th
+//     uint32 jitter histogram, 6 buckets, negligible ... 20
+//     [if k_nFixedStats_MultiPathCounters]
+//       uint64 multipath packets_recv_sequenced[2], packets_recv_later[2]
+//
+/////////////////////////////////////////////////////////////////////////////
+
+const uint8 k_nFixedStats_AckRequestE2E = 0x01;
+const uint8 k_nFixedStats_AckRequestImmediate = 0x02;
+const uint8 k_nFixedStats_NotPrimaryTransport = 0x04;
+const uint8 k_nFixedStats_Instantaneous = 0x08;
+const uint8 k_nFixedStats_Lifetime = 0x10;
+const uint8 k_nFixedStats_MultiPathCounters = 0x20;
+const uint8 k_nFixedStats_MultiPathSendEnabled = 0x40;
+
+const int k_cbFixedStatsInstantaneous = 4*4 + 2 + 2*2 + 4;
+const int k_cbFixedStatsLifetime = 4 + 10*8 + QualityHistogram::k_cBuckets*4 + 4 + 9*4 + 5*2 + 6*4;
+const int k_cbFixedStatsMultiPath = 4*8;
+
+static inline bool BSendMultiPathCounters( const SteamDatagramLinkLifetimeStats &s )
+{
+	// Same rule as LinkStatsLifetimeStructToMsg
+	return s.m_bMultiPathSendEnabled || s.m_nMultiPathRecvSeq[1] > 0;
+}
+
+static inline uint8 *PutFixed16( uint8 *p, uint16 x ) { x = LittleWord( x ); memcpy( p, &x, sizeof(x) ); return p + sizeof(x); }
+static inline uint8 *PutFixed32( uint8 *p, uint32 x ) { x = LittleDWord( x ); memcpy( p, &x, sizeof(x) ); return p + sizeof(x); }
+static inline uint8 *PutFixed64( uint8 *p, uint64 x ) { x = LittleQWord( x ); memcpy( p, &x, sizeof(x) ); return p + sizeof(x); }
+static inline uint16 GetFixed16( const uint8 *&p ) { uint16 x; memcpy( &x, p, sizeof(x) ); p += sizeof(x); return LittleWord( x ); }
+static inline uint32 GetFixed32( const uint8 *&p ) { uint32 x; memcpy( &x, p, sizeof(x) ); p += sizeof(x); return LittleDWord( x ); }
+static inline uint64 GetFixed64( const uint8 *&p ) { uint64 x; memcpy( &x, p, sizeof(x) ); p += sizeof(x); return LittleQWord( x ); }
+
+static inline uint16 FractionToFixed( float fl )
+{
+	if ( fl < 0.0f )
+		return 0xffff;
+	return uint16( std::min( fl, 1.0f ) * 10000.0f + .5f );
+}
+
+static inline float FixedToFraction( uint16 x )
+{
+	if ( x == 0xffff )
+		return -1.0f;
+	return std::min( x * .0001f, 1.0f );
+}
+
+int UDPInlineStats_t::FixedSerializedSize() const
+{
+	if ( m_nFlags == 0 && !HasStats() )
+		return 0;
+	int cb = 1;
+	if ( m_bInstantaneous )
+		cb += k_cbFixedStatsInstantaneous;
+	if ( m_bLifetime )
+	{
+		cb += k_cbFixedStatsLifetime;
+		if ( BSendMultiPathCounters( m_lifetime ) )
+			cb += k_cbFixedStatsMultiPath;
+	}
+	return cb;
+}
+
+uint8 *UDPInlineStats_t::SerializeFixed( uint8 *p ) const
+{
+	uint8 *pFlags = p++;
+	uint8 nFlags = 0;
+	if ( m_nFlags & CMsgSteamSockets_UDP_Stats::ACK_REQUEST_E2E )
+		nFlags |= k_nFixedStats_AckRequestE2E;
+	if ( m_nFlags & CMsgSteamSockets_UDP_Stats::ACK_REQUEST_IMMEDIATE )
+		nFlags |= k_nFixedStats_AckRequestImmediate;
+	if ( m_nFlags & CMsgSteamSockets_UDP_Stats::NOT_PRIMARY_TRANSPORT_E2E )
+		nFlags |= k_nFixedStats_NotPrimaryTransport;
+
+	if ( m_bInstantaneous )
+	{
+		nFlags |= k_nFixedStats_Instantaneous;
+		const SteamDatagramLinkInstantaneousStats &s = m_instantaneous;
+		p = PutFixed32( p, uint32( s.m_flOutPacketsPerSec * 10.0f ) );
+		p = PutFixed32( p, uint32( s.m_flOutBytesPerSec ) );
+		p = PutFixed32( p, uint32( s.m_flInPacketsPerSec * 10.0f ) );
+		p = PutFixed32( p, uint32( s.m_flInBytesPerSec ) );
+		p = PutFixed16( p, s.m_nPingMS < 0 ? 0xffff : uint16( std::min( s.m_nPingMS, 0xfffe ) ) );
+		p = PutFixed16( p, FractionToFixed( s.m_flPacketsDroppedPct ) );
+		p = PutFixed16( p, FractionToFixed( s.m_flPacketsWeirdSequenceNumberPct ) );
+		p = PutFixed32( p, s.m_usecMaxJitter < 0 ? 0xffffffff : uint32( s.m_usecMaxJitter ) );
+	}
+
+	if ( m_bLifetime )
+	{
+		nFlags |= k_nFixedStats_Lifetime;
+		const SteamDatagramLinkLifetimeStats &s = m_lifetime;
+		p = PutFixed32( p, s.m_nConnectedSeconds < 0 ? 0xffffffff : uint32( s.m_nConnectedSeconds ) );
+		p = PutFixed64( p, s.m_nPacketsSent );
+		p = PutFixed64( p, s.m_nBytesSent );
+		p = PutFixed64( p, s.m_nPacketsRecv );
+		p = PutFixed64( p, s.m_nBytesRecv );
+		p = PutFixed64( p, s.m_nPktsRecvSequenced );
+		p = PutFixed64( p, s.m_nPktsRecvDropped );
+		p = PutFixed64( p, s.m_nPktsRecvOutOfOrder );
+		p = PutFixed64( p, s.m_nPktsRecvOutOfOrderCorrected );
+		p = PutFixed64( p, s.m_nPktsRecvDuplicate );
+		p = PutFixed64( p, s.m_nPktsRecvSequenceNumberLurch );
+
+		for ( int n: s.m_qualityHistogram.m_arBuckets )
+			p = PutFixed32( p, uint32( n ) );
+		for ( short n: { s.m_nQualityNtile2nd, s.m_nQualityNtile5th, s.m_nQualityNtile25th, s.m_nQualityNtile50th } )
+			*(p++) = ( n < 0 ) ? 0xff : uint8( std::min( (int)n, 100 ) );
+
+		const PingHistogram &ping = s.m_pingHistogram;
+		for ( int n: { ping.m_n25, ping.m_n50, ping.m_n75, ping.m_n100, ping.m_n125, ping.m_n150, ping.m_n200, ping.m_n300, ping.m_nMax } )
+			p = PutFixed32( p, uint32( n ) );
+		for ( short n: { s.m_nPingNtile5th, s.m_nPingNtile50th, s.m_nPingNtile75th, s.m_nPingNtile95th, s.m_nPingNtile98th } )
+			p = PutFixed16( p, uint16( n ) );
+
+		const JitterHistogram &jitter = s.m_jitterHistogram;
+		for ( int n: { jitter.m_nNegligible, jitter.m_n1, jitter.m_n2, jitter.m_n5, jitter.m_n10, jitter.m_n20 } )
+			p = PutFixed32( p, uint32( n ) );
+
+		if ( s.m_bMultiPathSendEnabled )
+			nFlags |= k_nFixedStats_MultiPathSendEnabled;
+		if ( BSendMultiPathCounters( s ) )
+		{
+			nFlags |= k_nFixedStats_MultiPathCounters;
+			p = PutFixed64( p, s.m_nMultiPathRecvSeq[0] );
+			p = PutFixed64( p, s.m_nMultiPathRecvSeq[1] );
+			p = PutFixed64( p, s.m_nMultiPathRecvLater[0] );
+			p = PutFixed64( p, s.m_nMultiPathRecvLater[1] );
+		}
+	}
+
+	*pFlags = nFlags;
+	return p;
+}
+
+const uint8 *UDPInlineStats_t::DeserializeFixed( const uint8 *p, const uint8 *pEnd )
+{
+	if ( p >= pEnd )
+		return nullptr;
+	const uint8 nFlags = *(p++);
+	if ( nFlags & 0x80 )
+		return nullptr;
+
+	// Check the size up front, so we don't need to check each field
+	int cbNeeded = 0;
+	if ( nFlags & k_nFixedStats_Instantaneous )
+		cbNeeded += k_cbFixedStatsInstantaneous;
+	if ( nFlags & k_nFixedStats_Lifetime )
+	{
+		cbNeeded += k_cbFixedStatsLifetime;
+		if ( nFlags & k_nFixedStats_MultiPathCounters )
+			cbNeeded += k_cbFixedStatsMultiPath;
+	}
+	else if ( nFlags & ( k_nFixedStats_MultiPathCounters|k_nFixedStats_MultiPathSendEnabled ) )
+	{
+		return nullptr;
+	}
+	if ( pEnd - p < cbNeeded )
+		return nullptr;
+
+	m_nFlags = 0;
+	if ( nFlags & k_nFixedStats_AckRequestE2E )
+		m_nFlags |= CMsgSteamSockets_UDP_Stats::ACK_REQUEST_E2E;
+	if ( nFlags & k_nFixedStats_AckRequestImmediate )
+		m_nFlags |= CMsgSteamSockets_UDP_Stats::ACK_REQUEST_IMMEDIATE;
+	if ( nFlags & k_nFixedStats_NotPrimaryTransport )
+		m_nFlags |= CMsgSteamSockets_UDP_Stats::NOT_PRIMARY_TRANSPORT_E2E;
+
+	m_bInstantaneous = ( nFlags & k_nFixedStats_Instantaneous ) != 0;
+	if ( m_bInstantaneous )
+	{
+		SteamDatagramLinkInstantaneousStats &s = m_instantaneous;
+		s.Clear();
+		s.m_flOutPacketsPerSec = GetFixed32( p ) * .1f;
+		s.m_flOutBytesPerSec = (float)GetFixed32( p );
+		s.m_flInPacketsPerSec = GetFixed32( p ) * .1f;
+		s.m_flInBytesPerSec = (float)GetFixed32( p );
+		uint16 nPing = GetFixed16( p );
+		s.m_nPingMS = ( nPing == 0xffff ) ? -1 : nPing;
+		s.m_flPacketsDroppedPct = FixedToFraction( GetFixed16( p ) );
+		s.m_flPacketsWeirdSequenceNumberPct = FixedToFraction( GetFixed16( p ) );
+		uint32 usecJitter = GetFixed32( p );
+		s.m_usecMaxJitter = ( usecJitter > INT_MAX ) ? -1 : int( usecJitter );
+	}
+
+	m_bLifetime = ( nFlags & k_nFixedStats_Lifetime ) != 0;
+	if ( m_bLifetime )
+	{
+		SteamDatagramLinkLifetimeStats &s = m_lifetime;
+		s.Clear();
+		uint32 nConnectedSeconds = GetFixed32( p );
+		s.m_nConnectedSeconds = ( nConnectedSeconds > INT_MAX ) ? -1 : int( nConnectedSeconds );
+		s.m_nPacketsSent = GetFixed64( p );
+		s.m_nBytesSent = GetFixed64( p );
+		s.m_nPacketsRecv = GetFixed64( p );
+		s.m_nBytesRecv = GetFixed64( p );
+		s.m_nPktsRecvSequenced = GetFixed64( p );
+		s.m_nPktsRecvDropped = GetFixed64( p );
+		s.m_nPktsRecvOutOfOrder = GetFixed64( p );
+		s.m_nPktsRecvOutOfOrderCorrected = GetFixed64( p );
+		s.m_nPktsRecvDuplicate = GetFixed64( p );
+		s.m_nPktsRecvSequenceNumberLurch = GetFixed64( p );
+
+		for ( int &n: s.m_qualityHistogram.m_arBuckets )
+			n = int( GetFixed32( p ) );
+		for ( short *pn: { &s.m_nQualityNtile2nd, &s.m_nQualityNtile5th, &s.m_nQualityNtile25th, &s.m_nQualityNtile50th } )
+		{
+			uint8 x = *(p++);
+			*pn = ( x == 0xff ) ? -1 : x;
+		}
+
+		PingHistogram &ping = s.m_pingHistogram;
+		for ( int *pn: { &ping.m_n25, &ping.m_n50, &ping.m_n75, &ping.m_n100, &ping.m_n125, &ping.m_n150, &ping.m_n200, &ping.m_n300, &ping.m_nMax } )
+			*pn = int( GetFixed32( p ) );
+		for ( short *pn: { &s.m_nPingNtile5th, &s.m_nPingNtile50th, &s.m_nPingNtile75th, &s.m_nPingNtile95th, &s.m_nPingNtile98th } )
+			*pn = short( GetFixed16( p ) );
+
+		JitterHistogram &jitter = s.m_jitterHistogram;
+		for ( int *pn: { &jitter.m_nNegligible, &jitter.m_n1, &jitter.m_n2, &jitter.m_n5, &jitter.m_n10, &jitter.m_n20 } )
+			*pn = int( GetFixed32( p ) );
+
+		s.m_bMultiPathSendEnabled = ( nFlags & k_nFixedStats_MultiPathSendEnabled ) != 0;
+		if ( nFlags & k_nFixedStats_MultiPathCounters )
+		{
+			s.m_nMultiPathRecvSeq[0] = GetFixed64( p );
+			s.m_nMultiPathRecvSeq[1] = GetFixed64( p );
+			s.m_nMultiPathRecvLater[0] = GetFixed64( p );
+			s.m_nMultiPathRecvLater[1] = GetFixed64( p );
+		}
+	}
+
+	return p;
+}
+
+void UDPInlineStats_t::ToMsg( CMsgSteamSockets_UDP_Stats &msg ) const
+{
+	if ( m_nFlags )
+		msg.set_flags( m_nFlags );
+	if ( m_bInstantaneous )
+		LinkStatsInstantaneousStructToMsg( m_instantaneous, *msg.mutable_stats()->mutable_instantaneous() );
+	if ( m_bLifetime )
+		LinkStatsLifetimeStructToMsg( m_lifetime, *msg.mutable_stats()->mutable_lifetime() );
+}
+
+void UDPInlineStats_t::FromMsg( const CMsgSteamSockets_UDP_Stats &msg )
+{
+	m_nFlags = msg.flags() | StatsMsgImpliedFlags( msg );
+	m_bInstantaneous = msg.stats().has_instantaneous();
+	if ( m_bInstantaneous )
+	{
+		m_instantaneous.Clear();
+		LinkStatsInstantaneousMsgToStruct( msg.stats().instantaneous(), m_instantaneous );
+	}
+	m_bLifetime = msg.stats().has_lifetime();
+	if ( m_bLifetime )
+	{
+		m_lifetime.Clear();
+		LinkStatsLifetimeMsgToStruct( msg.stats().lifetime(), m_lifetime );
+	}
+}
+
+std::string DescribeStatsContents( const UDPInlineStats_t &stats )
 {
 	std::string sWhat;
-	if ( msg.flags() & msg.ACK_REQUEST_E2E )
+	if ( stats.m_nFlags & CMsgSteamSockets_UDP_Stats::ACK_REQUEST_E2E )
 		sWhat += " request_ack";
-	if ( msg.flags() & msg.ACK_REQUEST_IMMEDIATE )
+	if ( stats.m_nFlags & CMsgSteamSockets_UDP_Stats::ACK_REQUEST_IMMEDIATE )
 		sWhat += " request_ack_immediate";
-	if ( msg.flags() & msg.NOT_PRIMARY_TRANSPORT_E2E )
+	if ( stats.m_nFlags & CMsgSteamSockets_UDP_Stats::NOT_PRIMARY_TRANSPORT_E2E )
 		sWhat += " backup_transport";
-	if ( msg.stats().has_lifetime() )
+	if ( stats.m_bLifetime )
 		sWhat += " stats.life";
-	if ( msg.stats().has_instantaneous() )
+	if ( stats.m_bInstantaneous )
 		sWhat += " stats.rate";
 	return sWhat;
 }
 
-void CConnectionTransportUDPBase::RecvStats( const CMsgSteamSockets_UDP_Stats &msgStatsIn, SteamNetworkingMicroseconds usecNow )
+void CConnectionTransportUDPBase::RecvStats( const UDPInlineStats_t &statsIn, SteamNetworkingMicroseconds usecNow )
 {
 
 	// Connection quality stats?
-	if ( msgStatsIn.has_stats() )
-		m_connection.m_statsEndToEnd.ProcessMessage( msgStatsIn.stats(), usecNow );
+	if ( statsIn.m_bInstantaneous )
+		m_connection.m_statsEndToEnd.RecvInstantaneousStats( statsIn.m_instantaneous, usecNow );
+	if ( statsIn.m_bLifetime )
+		m_connection.m_statsEndToEnd.RecvLifetimeStats( statsIn.m_lifetime, usecNow );
 
 	// Spew appropriately
 	SpewDebug( "[%s] Recv UDP stats:%s\n",
 		ConnectionDescription(),
-		DescribeStatsContents( msgStatsIn ).c_str()
+		DescribeStatsContents( statsIn ).c_str()
 	);
 
 	// Check if we need to reply, either now or later
@@ -633,9 +1343,9 @@ void CConnectionTransportUDPBase::RecvStats( const CMsgSteamSockets_UDP_Stats &m
 	{
 
 		// Check for queuing outgoing acks
-		if ( ( msgStatsIn.flags() & msgStatsIn.ACK_REQUEST_E2E ) || msgStatsIn.has_stats() )
+		if ( ( statsIn.m_nFlags & CMsgSteamSockets_UDP_Stats::ACK_REQUEST_E2E ) || statsIn.HasStats() )
 		{
-			bool bImmediate = ( msgStatsIn.flags() & msgStatsIn.ACK_REQUEST_IMMEDIATE ) != 0;
+			bool bImmediate = ( statsIn.m_nFlags & CMsgSteamSockets_UDP_Stats::ACK_REQUEST_IMMEDIATE ) != 0;
 			m_connection.QueueEndToEndAck( bImmediate, usecNow );
 
 			// Check if need to send an immediately reply, either because they
@@ -653,14 +1363,15 @@ void CConnectionTransportUDPBase::TrackSentStats( UDPSendPacketContext_t &ctx )
 {
 
 	// What effective flags will be received?
-	bool bAllowDelayedReply = ( ctx.msg.flags() & ctx.msg.ACK_REQUEST_IMMEDIATE ) == 0;
+	const UDPInlineStats_t &stats = ctx.m_stats;
+	bool bAllowDelayedReply = ( stats.m_nFlags & CMsgSteamSockets_UDP_Stats::ACK_REQUEST_IMMEDIATE ) == 0;
 
 	// Record that we sent stats and are waiting for peer to ack
-	if ( ctx.msg.has_stats() )
+	if ( stats.HasStats() )
 	{
-		m_connection.m_statsEndToEnd.TrackSentStats( ctx.msg.stats(), ctx.m_usecNow, bAllowDelayedReply );
+		m_connection.m_statsEndToEnd.TrackSentStats( stats.m_bInstantaneous, stats.m_bLifetime, ctx.m_usecNow, bAllowDelayedReply );
 	}
-	else if ( ctx.msg.flags() & ctx.msg.ACK_REQUEST_E2E )
+	else if ( stats.m_nFlags & CMsgSteamSockets_UDP_Stats::ACK_REQUEST_E2E )
 	{
 		m_connection.m_statsEndToEnd.TrackSentMessageExpectingSeqNumAck( ctx.m_usecNow, bAllowDelayedReply );
 	}
@@ -669,11 +1380,11 @@ void CConnectionTransportUDPBase::TrackSentStats( UDPSendPacketContext_t &ctx )
 	SpewDebug( "[%s] Sent UDP stats (%s):%s\n",
 		ConnectionDescription(),
 		ctx.m_pszReason,
-		DescribeStatsContents( ctx.msg ).c_str()
+		DescribeStatsContents( stats ).c_str()
 	);
 }
 
-void CConnectionTransportUDPBase::Received_Data( const uint8 *pPkt, int cbPkt, SteamNetworkingMicroseconds usecNow )
+void CConnectionTransportUDPBase::Received_Data( uint8 *pPkt, int cbPkt, SteamNetworkingMicroseconds usecNow )
 {
 
 	if ( cbPkt < sizeof(UDPDataMsgHdr) )
@@ -730,12 +1441,32 @@ void CConnectionTransportUDPBase::Received_Data( const uint8 *pPkt, int cbPkt, S
 	const uint8 *pIn = pPkt + sizeof(*hdr);
 	const uint8 *pPktEnd = pPkt + cbPkt;
 
-	// Inline stats?
-	static CMsgSteamSockets_UDP_Stats msgStats;
-	CMsgSteamSockets_UDP_Stats *pMsgStatsIn = nullptr;
+	// Inline stats?  Newer peers use a fixed layout, which we can parse
+	// without any allocation.  Older peers send a protobuf
+	UDPInlineStats_t statsIn;
+	const UDPInlineStats_t *pStatsIn = nullptr;
 	uint32 cbStatsMsgIn = 0;
-	if ( hdr->m_unMsgFlags & hdr->kFlag_ProtobufBlob )
+	if ( hdr->m_unMsgFlags & hdr->kFlag_FixedStats )
+	{
+		if ( hdr->m_unMsgFlags & hdr->kFlag_ProtobufBlob )
+		{
+			ReportBadUDPPacketFromConnectionPeer( "DataPacket", "Both fixed and protobuf inline stats are present" );
+			return;
+		}
+
+		const uint8 *pStatsEnd = statsIn.DeserializeFixed( pIn, pPktEnd );
+		if ( pStatsEnd == nullptr )
+		{
+			ReportBadUDPPacketFromConnectionPeer( "DataPacket", "Failed to parse fixed inline stats" );
+			return;
+		}
+		cbStatsMsgIn = uint32( pStatsEnd - pIn );
+		pStatsIn = &statsIn;
+		pIn = pStatsEnd;
+	}
+	else if ( hdr->m_unMsgFlags & hdr->kFlag_ProtobufBlob )
 	{
+		static CMsgSteamSockets_UDP_Stats msgStats;
 		//Msg_Verbose( "Received inline stats from %s", server.m_szName );
 
 		pIn = DeserializeVarInt( pIn, pPktEnd, cbStatsMsgIn );
@@ -757,7 +1488,8 @@ void CConnectionTransportUDPBase::Received_Data( const uint8 *pPkt, int cbPkt, S
 		}
 
 		// Shove sequence number so we know what acks to pend, etc
-		pMsgStatsIn = &msgStats;
+		statsIn.FromMsg( msgStats );
+		pStatsIn = &statsIn;
 
 		// Advance pointer
 		pIn += cbStatsMsgIn;
@@ -777,14 +1509,20 @@ void CConnectionTransportUDPBase::Received_Data( const uint8 *pPkt, int cbPkt, S
 		pIn += sizeof(unsigned short);
 	}
 
-	const void *pChunk = pIn;
+	// We decrypt in place, rather than copying out the plaintext.  The
+	// buffer must belong to us and be thrown away once we have processed
+	// the packet: the socket thread's receive buffer, the lag simulation
+	// queue, or the WebRTC packet queue.  If the packet is in somebody
+	// else's buffer, the transport must copy it first.  (See
+	// CConnectionTransportP2PICE_WebRTC::OnData)
+	void *pChunk = pPkt + ( pIn - pPkt );
 	int cbChunk = pPktEnd - pIn;
 
 	// Decrypt it, and check packet number
 	UDPRecvPacketContext_t ctx;
 	ctx.m_usecNow = usecNow;
 	ctx.m_pTransport = this;
-	ctx.m_pStatsIn = pMsgStatsIn;
+	ctx.m_pStatsIn = pStatsIn;
 	if ( !m_connection.DecryptDataChunk( nWirePktNumber, cbPkt, pChunk, cbChunk, ctx ) )
 		return;
 
@@ -796,8 +1534,8 @@ void CConnectionTransportUDPBase::Received_Data( const uint8 *pPkt, int cbPkt, S
 		return;
 
 	// Process the stats, if any
-	if ( pMsgStatsIn )
-		RecvStats( *pMsgStatsIn, usecNow );
+	if ( pStatsIn )
+		RecvStats( *pStatsIn, usecNow );
 }
 
 void CConnectionTransportUDPBase::RecvValidUDPDataPacket( UDPRecvPacketContext_t &ctx )
@@ -966,6 +1704,7 @@ void CConnectionTransportUDPBase::GetDetailedConnectionStatus( SteamNetworkingDe
 CSteamNetworkConnectionUDP::CSteamNetworkConnectionUDP( CSteamNetworkingSockets *pSteamNetworkingSocketsInterface, ConnectionScopeLock &scopeLock )
 : CSteamNetworkConnectionBase( pSteamNetworkingSocketsInterface, scopeLock )
 {
+	m_nResumeConnectRequestsSent = 0;
 }
 
 CSteamNetworkConnectionUDP::~CSteamNetworkConnectionUDP()
@@ -1025,6 +1764,10 @@ void UDPSendPacketContext_t::Populate( size_t cbHdrtReserve, EStatsReplyRequest
 	CSteamNetworkConnectionBase &connection = pTransport->m_connection;
 	LinkStatsTracker<LinkStatsTrackerEndToEnd> &statsEndToEnd = connection.m_statsEndToEnd;
 
+	// Does the peer understand the fixed layout?
+	m_bFixedStats = statsEndToEnd.m_nPeerProtocolVersion >= 18;
+	m_stats.Clear();
+
 	int nFlags = 0;
 	if ( connection.m_pTransport != pTransport )
 		nFlags |= msg.NOT_PRIMARY_TRANSPORT_E2E;
@@ -1042,28 +1785,53 @@ void UDPSendPacketContext_t::Populate( size_t cbHdrtReserve, EStatsReplyRequest
 			nFlags |= msg.ACK_REQUEST_E2E;
 	}
 
-	m_nFlags = nFlags;
+	m_stats.m_nFlags = nFlags;
+
+	auto PopulateStats = [&]( int nNeedFlags )
+	{
+		statsEndToEnd.PopulateStats( nNeedFlags, m_stats.m_instantaneous, m_stats.m_lifetime );
+		if ( nNeedFlags & k_nSendStats_Instantanous )
+			m_stats.m_bInstantaneous = true;
+		if ( nNeedFlags & k_nSendStats_Lifetime )
+			m_stats.m_bLifetime = true;
+	};
 
 	// Need to send any connection stats stats?
 	m_nStatsNeed = statsEndToEnd.GetStatsSendNeed( m_usecNow );
 	if ( m_nStatsNeed & k_nSendStats_Due )
 	{
-		statsEndToEnd.PopulateMessage( m_nStatsNeed, *msg.mutable_stats(), m_usecNow );
+		PopulateStats( m_nStatsNeed );
 
 		if ( nReadyToSendTracer > 0 )
-			m_nFlags |= msg.ACK_REQUEST_E2E;
+			m_stats.m_nFlags |= msg.ACK_REQUEST_E2E;
 	}
 
 	// Populate flags now, based on what is implied from what we HAVE to send
-	SlamFlagsAndCalcSize();
+	CalcSize();
 	CalcMaxEncryptedPayloadSize( cbHdrtReserve, &connection );
 
 	// Would we like to try to send some additional stats, if there is room?
 	if ( m_nStatsNeed & k_nSendStats_Ready )
 	{
 		if ( nReadyToSendTracer > 0 )
-			m_nFlags |= msg.ACK_REQUEST_E2E;
-		statsEndToEnd.PopulateMessage( m_nStatsNeed & k_nSendStats_Ready, *msg.mutable_stats(), m_usecNow );
+			m_stats.m_nFlags |= msg.ACK_REQUEST_E2E;
+		PopulateStats( m_nStatsNeed & k_nSendStats_Ready );
+		CalcSize();
+	}
+}
+
+void UDPSendPacketContext_t::CalcSize()
+{
+	if ( m_bFixedStats )
+	{
+		m_cbTotalSize = m_cbMsgSize = m_stats.FixedSerializedSize();
+	}
+	else
+	{
+		// Old peer.  Convert to protobuf
+		msg.Clear();
+		m_stats.ToMsg( msg );
+		m_nFlags = m_stats.m_nFlags;
 		SlamFlagsAndCalcSize();
 	}
 }
@@ -1072,7 +1840,7 @@ void UDPSendPacketContext_t::Trim( int cbHdrOutSpaceRemaining )
 {
 	while ( m_cbTotalSize > cbHdrOutSpaceRemaining )
 	{
-		if ( !msg.has_stats() )
+		if ( !m_stats.HasStats() )
 		{
 			// Nothing left to clear!?  We shouldn't get here!
 			AssertMsg( false, "Serialized stats message still won't fit, ever after clearing everything?" );
@@ -1082,12 +1850,12 @@ void UDPSendPacketContext_t::Trim( int cbHdrOutSpaceRemaining )
 
 		if ( m_nStatsNeed & k_nSendStats_Instantanous_Ready )
 		{
-			msg.mutable_stats()->clear_instantaneous();
+			m_stats.m_bInstantaneous = false;
 			m_nStatsNeed &= ~k_nSendStats_Instantanous_Ready;
 		}
 		else if ( m_nStatsNeed & k_nSendStats_Lifetime_Ready )
 		{
-			msg.mutable_stats()->clear_lifetime();
+			m_stats.m_bLifetime = false;
 			m_nStatsNeed &= ~k_nSendStats_Lifetime_Ready;
 		}
 		else
@@ -1095,7 +1863,7 @@ void UDPSendPacketContext_t::Trim( int cbHdrOutSpaceRemaining )
 			AssertMsg( false, "We didn't reserve enough space for stats!" );
 			if ( m_nStatsNeed & k_nSendStats_Instantanous_Due )
 			{
-				msg.mutable_stats()->clear_instantaneous();
+				m_stats.m_bInstantaneous = false;
 				m_nStatsNeed &= ~k_nSendStats_Instantanous_Due;
 			}
 			else
@@ -1105,12 +1873,29 @@ void UDPSendPacketContext_t::Trim( int cbHdrOutSpaceRemaining )
 		}
 
 		if ( m_nStatsNeed == 0 )
-			msg.clear_stats();
+			m_stats.m_bInstantaneous = m_stats.m_bLifetime = false;
 
-		SlamFlagsAndCalcSize();
+		CalcSize();
 	}
 }
 
+bool UDPSendPacketContext_t::Serialize( byte *&p )
+{
+	if ( !m_bFixedStats )
+		return SendPacketContext<CMsgSteamSockets_UDP_Stats>::Serialize( p );
+
+	if ( m_cbTotalSize <= 0 )
+		return false;
+	byte *pOut = m_stats.SerializeFixed( p );
+	if ( pOut != p + m_cbTotalSize )
+	{
+		AssertMsg( false, "Size mismatch after serializing inline stats" );
+		return false;
+	}
+	p = pOut;
+	return true;
+}
+
 bool CConnectionTransportUDP::BConnect( const netadr_t &netadrRemote, SteamDatagramErrMsg &errMsg )
 {
 
@@ -1225,10 +2010,27 @@ bool CSteamNetworkConnectionUDP::BInitConnect( const SteamNetworkingIPAddr &addr
 		return false;
 	}
 
+	// Do we have a ticket from an earlier session with this server?
+	if ( m_connectionConfig.IP_SessionResumption.Get() > 0 )
+	{
+		m_pResumptionTicket = TakeResumptionTicket( netadrRemote, m_identityLocal, usecNow );
+		if ( m_pResumptionTicket )
+			SetResumedSessionSecret( m_pResumptionTicket->m_secret );
+	}
+
 	// Start the connection state machine
 	return BConnectionState_Connecting( usecNow, errMsg );
 }
 
+void CSteamNetworkConnectionUDP::AbandonSessionResumption()
+{
+	if ( !m_pResumptionTicket )
+		return;
+	SpewVerbose( "[%s] Server did not resume session, doing full handshake\n", GetDescription() );
+	m_pResumptionTicket.reset();
+	ClearResumedSessionSecret();
+}
+
 bool CConnectionTransportUDP::BCanSendEndToEndConnectRequest() const
 {
 	return m_pSocket != nullptr;
@@ -1246,6 +2048,32 @@ void CConnectionTransportUDP::SendEndToEndConnectRequest( SteamNetworkingMicrose
 	Assert( ConnectionState() == k_ESteamNetworkingConnectionState_Connecting ); // Why else would we be doing this?
 	Assert( ConnectionIDLocal() );
 
+	// If we have a ticket to resume an earlier session, skip the challenge
+	// and send a connect request with the ticket right away.  If that doesn't
+	// work after a few tries, fall back to the challenge.  But hang on to the
+	// secret until they tell us they want the full handshake: the server might
+	// just be waiting on the app to accept the connection.
+	CSteamNetworkConnectionUDP &conn = ConnectionUDP();
+	if ( conn.m_pResumptionTicket && conn.m_nResumeConnectRequestsSent < k_nMaxResumeConnectRequests && m_connection.GetSignedCryptLocal().has_info() )
+	{
+		++conn.m_nResumeConnectRequestsSent;
+
+		CMsgSteamSockets_UDP_ConnectRequest msgConnectRequest;
+		msgConnectRequest.set_client_connection_id( ConnectionIDLocal() );
+		msgConnectRequest.set_my_timestamp( usecNow );
+		if ( m_connection.m_statsEndToEnd.m_ping.m_nSmoothedPing >= 0 )
+			msgConnectRequest.set_ping_est_ms( m_connection.m_statsEndToEnd.m_ping.m_nSmoothedPing );
+		msgConnectRequest.mutable_crypt()->set_info( m_connection.GetSignedCryptLocal().info() );
+		msgConnectRequest.set_resumption_ticket( conn.m_pResumptionTicket->m_sTicket );
+		msgConnectRequest.set_resumption_mac( m_connection.GetResumptionMACLocal() );
+		SendMsg( k_ESteamNetworkingUDPMsg_ConnectRequest, msgConnectRequest );
+
+		// They are supposed to reply with a timestamps, from which we can estimate the ping.
+		// So this counts as a ping request
+		m_connection.m_statsEndToEnd.TrackSentPingRequest( usecNow, false );
+		return;
+	}
+
 	CMsgSteamSockets_UDP_ChallengeRequest msg;
 	msg.set_connection_id( ConnectionIDLocal() );
 	//msg.set_client_steam_id( m_steamIDLocal.ConvertToUint64() );
@@ -1268,6 +2096,8 @@ bool CSteamNetworkConnectionUDP::BBeginAccept(
 	uint32 unConnectionIDRemote,
 	const CMsgSteamDatagramCertificateSigned &msgCert,
 	const CMsgSteamDatagramSessionCryptInfoSigned &msgCryptSessionInfo,
+	const CMsgSteamSockets_UDP_ResumptionTicket *pResumptionTicket,
+	const std::string &sResumptionMAC,
 	SteamDatagramErrMsg &errMsg
 )
 {
@@ -1304,6 +2134,35 @@ bool CSteamNetworkConnectionUDP::BBeginAccept(
 		return false;
 	}
 
+	// Resuming an earlier session?  Then there are no certs or signatures to check.
+	// (Caller has already decrypted and checked the ticket.)
+	if ( pResumptionTicket )
+	{
+		AutoWipeFixedSizeBuffer<32> secret;
+		Assert( pResumptionTicket->secret().length() == secret.k_nSize );
+		V_memcpy( secret.m_buf, pResumptionTicket->secret().c_str(), secret.k_nSize );
+		SetResumedSessionSecret( secret );
+		if ( RecvResumedCryptoHandshake( msgCryptSessionInfo, sResumptionMAC, pResumptionTicket->trusted_ca_signature(), true, errMsg ) != k_ESteamNetConnectionEnd_Invalid )
+		{
+			DestroyTransport();
+			return false;
+		}
+		return BConnectionState_Connecting( usecNow, errMsg );
+	}
+
+	// Checking the signatures is expensive.  Check them along with any other
+	// connect requests in this burst (on a worker thread, if we have them),
+	// and hold off on telling the app about the connection
+	if ( BCanBatchHandshakeSignatureChecks() )
+	{
+		if ( !BConnectionState_ConnectingAndCheckCryptoHandshake( msgCert, msgCryptSessionInfo, usecNow, errMsg ) )
+		{
+			DestroyTransport();
+			return false;
+		}
+		return true;
+	}
+
 	// Process crypto handshake now
 	if ( RecvCryptoHandshake( msgCert, msgCryptSessionInfo, true, errMsg ) != k_ESteamNetConnectionEnd_Invalid )
 	{
@@ -1315,6 +2174,11 @@ bool CSteamNetworkConnectionUDP::BBeginAccept(
 	return BConnectionState_Connecting( usecNow, errMsg );
 }
 
+bool CSteamNetworkConnectionUDP::BSupportsAsyncHandshakeCrypto() const
+{
+	return true;
+}
+
 EResult CSteamNetworkConnectionUDP::AcceptConnection( SteamNetworkingMicroseconds usecNow )
 {
 	if ( !Transport() )
@@ -1412,7 +2276,7 @@ void CConnectionTransportUDP::TransportPopulateConnectionInfo( SteamNetConnectio
 
 void CConnectionTransportUDP::PacketReceived( const RecvPktInfo_t &info, CConnectionTransportUDP *pSelf )
 {
-	const uint8 *pPkt = static_cast<const uint8 *>( info.m_pPkt );
+	uint8 *pPkt = info.m_pPkt;
 	int cbPkt = info.m_cbPkt;
 	const netadr_t &adrFrom = info.m_adrFrom;
 	SteamNetworkingMicroseconds usecNow = info.m_usecNow;
@@ -1498,6 +2362,10 @@ void CConnectionTransportUDP::Received_ChallengeReply( const CMsgSteamSockets_UD
 		return;
 	}
 
+	// If we were trying to resume an earlier session, the server
+	// doesn't want to.  Proceed with the full handshake
+	ConnectionUDP().AbandonSessionResumption();
+
 	// Update ping, if they replied with the timestamp
 	if ( msg.has_your_timestamp() )
 	{
@@ -1575,9 +2443,24 @@ void CConnectionTransportUDP::Received_ConnectOK( const CMsgSteamSockets_UDP_Con
 		return;
 	}
 
-	// Parse out identity from the cert
+	// Did they resume the session using the ticket we sent?
+	CSteamNetworkConnectionUDP &conn = ConnectionUDP();
+	const bool bResumed = msg.has_resumption_mac();
+	if ( bResumed && !conn.m_pResumptionTicket )
+	{
+		ReportBadUDPPacketFromConnectionPeer( "ConnectOK", "Resumed session, but we didn't present a ticket." );
+		return;
+	}
+
+	// Parse out identity from the cert.  If they resumed the session,
+	// there's no cert, they are who they were last time.
 	SteamNetworkingIdentity identityRemote;
 	bool bIdentityInCert = true;
+	if ( bResumed )
+	{
+		identityRemote = conn.m_pResumptionTicket->m_identityServer;
+	}
+	else
 	{
 		// !SPEED! We are deserializing the cert here,
 		// and then we are going to do it again below.
@@ -1608,7 +2491,7 @@ void CConnectionTransportUDP::Received_ConnectOK( const CMsgSteamSockets_UDP_Con
 	Assert( !identityRemote.IsInvalid() );
 
 	// Check if they are using an IP address as an identity (possibly the anonymous "localhost" identity)
-	if ( identityRemote.m_eType == k_ESteamNetworkingIdentityType_IPAddress )
+	if ( identityRemote.m_eType == k_ESteamNetworkingIdentityType_IPAddress && !bResumed )
 	{
 		SteamNetworkingIPAddr addr;
 		const netadr_t &adrFrom = m_pSocket->GetRemoteHostAddr();
@@ -1712,7 +2595,16 @@ void CConnectionTransportUDP::Received_ConnectOK( const CMsgSteamSockets_UDP_Con
 	m_connection.m_identityRemote = identityRemote;
 
 	// Check the certs, save keys, etc
-	ESteamNetConnectionEnd eCryptFailure = m_connection.RecvCryptoHandshake( msg.cert(), msg.crypt(), false, errMsg );
+	ESteamNetConnectionEnd eCryptFailure;
+	if ( bResumed )
+	{
+		eCryptFailure = m_connection.RecvResumedCryptoHandshake( msg.crypt(), msg.resumption_mac(), conn.m_pResumptionTicket->m_bServerCertTrusted, false, errMsg );
+	}
+	else
+	{
+		conn.AbandonSessionResumption();
+		eCryptFailure = m_connection.RecvCryptoHandshake( msg.cert(), msg.crypt(), false, errMsg );
+	}
 	if ( eCryptFailure )
 	{
 		m_connection.ConnectionState_ProblemDetectedLocally( eCryptFailure, "%s", errMsg );
@@ -1720,6 +2612,23 @@ void CConnectionTransportUDP::Received_ConnectOK( const CMsgSteamSockets_UDP_Con
 		return;
 	}
 
+	// Save ticket, so we can resume this session later.
+	conn.m_pResumptionTicket.reset();
+	const int nResumptionLifetime = m_connection.m_connectionConfig.IP_SessionResumption.Get();
+	const AutoWipeFixedSizeBuffer<32> *pResumptionSecret = m_connection.GetResumptionSecretNext();
+	if ( nResumptionLifetime > 0 && pResumptionSecret && msg.has_resumption_ticket() && (int)msg.resumption_ticket().length() <= k_cbMaxResumptionTicket )
+	{
+		std::unique_ptr<UDPSessionResumptionTicket_t> pTicket( new UDPSessionResumptionTicket_t );
+		pTicket->m_adrServer = m_pSocket->GetRemoteHostAddr();
+		pTicket->m_identityLocal = IdentityLocal();
+		pTicket->m_identityServer = m_connection.m_identityRemote;
+		pTicket->m_bServerCertTrusted = m_connection.BRemoteCertHasTrustedCASignature();
+		pTicket->m_usecExpiry = usecNow + nResumptionLifetime*k_nMillion;
+		pTicket->m_sTicket = msg.resumption_ticket();
+		V_memcpy( pTicket->m_secret.m_buf, pResumptionSecret->m_buf, pTicket->m_secret.k_nSize );
+		CacheResumptionTicket( std::move( pTicket ) );
+	}
+
 	// Generic connection code will take it from here.
 	m_connection.ConnectionState_Connected( usecNow );
 }
@@ -1784,11 +2693,38 @@ void CConnectionTransportUDP::SendConnectOK( SteamNetworkingMicroseconds usecNow
 	CMsgSteamSockets_UDP_ConnectOK msg;
 	msg.set_client_connection_id( ConnectionIDRemote() );
 	msg.set_server_connection_id( ConnectionIDLocal() );
-	*msg.mutable_cert() = m_connection.GetSignedCertLocal();
-	*msg.mutable_crypt() = m_connection.GetSignedCryptLocal();
+	if ( m_connection.BResumedSession() )
+	{
+		// No cert, and our crypt info is authenticated with the secret from the ticket
+		msg.mutable_crypt()->set_info( m_connection.GetSignedCryptLocal().info() );
+		msg.set_resumption_mac( m_connection.GetResumptionMACLocal() );
+	}
+	else
+	{
+		*msg.mutable_cert() = m_connection.GetSignedCertLocal();
+		*msg.mutable_crypt() = m_connection.GetSignedCryptLocal();
+	}
+
+	// Give them a ticket so they can resume this session later.  It's bound to their IP.
+	const int nResumptionLifetime = m_connection.m_connectionConfig.IP_SessionResumption.Get();
+	const AutoWipeFixedSizeBuffer<32> *pResumptionSecret = m_connection.GetResumptionSecretNext();
+	if ( nResumptionLifetime > 0 && pResumptionSecret )
+	{
+		CMsgSteamSockets_UDP_ResumptionTicket msgTicket;
+		msgTicket.set_secret( pResumptionSecret->m_buf, pResumptionSecret->k_nSize );
+		msgTicket.set_identity_string( SteamNetworkingIdentityRender( m_connection.m_identityRemote ).c_str() );
+		msgTicket.set_trusted_ca_signature( m_connection.BRemoteCertHasTrustedCASignature() );
+		msgTicket.set_expiry( usecNow + nResumptionLifetime*k_nMillion );
+		uint8 ipv6[16];
+		m_pSocket->GetRemoteHostAddr().GetIPV6( ipv6 );
+		msgTicket.set_client_ip( ipv6, sizeof(ipv6) );
+		if ( !BEncryptResumptionTicket( msgTicket, *msg.mutable_resumption_ticket() ) )
+			msg.clear_resumption_ticket();
+		SecureZeroMemory( &(*msgTicket.mutable_secret())[0], msgTicket.secret().length() );
+	}
 
 	// If the cert is generic, then we need to specify our identity
-	if ( !m_connection.BCertHasIdentity() )
+	if ( !m_connection.BResumedSession() && !m_connection.BCertHasIdentity() )
 	{
 		SteamNetworkingIdentityToProtobuf( IdentityLocal(), msg, identity_string, legacy_identity_binary, legacy_server_steam_id );
 	}
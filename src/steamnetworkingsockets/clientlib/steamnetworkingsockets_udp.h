@@ -31,6 +31,7 @@ struct UDPDataMsgHdr
 	{
 		kFlag_ProtobufBlob  = 0x01, // Protobuf-encoded message is inline (CMsgSteamSockets_UDP_Stats)
 		kFlag_TimeSincePrev = 0x02, // If set, measurement(s) of the time since the last sequenced packet is present, for packet delay variation estimation
+		kFlag_FixedStats    = 0x04, // Stats are inline, using the fixed binary layout.  (UDPInlineStats_t.)  Only sent to peers with protocol version 18+
 	};
 
 	uint8 m_unMsgFlags;
@@ -38,6 +39,7 @@ struct UDPDataMsgHdr
 	uint16 m_unSeqNum;
 
 	// [optional, if flags&kFlag_ProtobufBlob]  varint-encoded protobuf blob size, followed by blob
+	// [optional, if flags&kFlag_FixedStats]    stats in fixed binary layout.  See UDPInlineStats_t::SerializeFixed
 	// [optional, if flags&kFlag_TimeSincePrev] uint16 time between this packet and the previous one, on client.  See k_usecTimeSinceLastPacketSerializedPrecisionShift
 	// Data frame(s)
 	// End of packet
@@ -50,22 +52,64 @@ inline uint32 StatsMsgImpliedFlags<CMsgSteamSockets_UDP_Stats>( const CMsgSteamS
 	return msg.has_stats() ? msg.ACK_REQUEST_E2E : 0;
 }
 
+/// End-to-end stats and ack request flags that ride along on a data packet.
+/// Peers that understand it get this in a fixed binary layout, which we can
+/// serialize and parse without touching the heap.  Older peers get it as a
+/// CMsgSteamSockets_UDP_Stats.
+struct UDPInlineStats_t
+{
+	uint32 m_nFlags; // CMsgSteamSockets_UDP_Stats::Flags
+	bool m_bInstantaneous;
+	bool m_bLifetime;
+	SteamDatagramLinkInstantaneousStats m_instantaneous;
+	SteamDatagramLinkLifetimeStats m_lifetime;
+
+	inline void Clear() { m_nFlags = 0; m_bInstantaneous = m_bLifetime = false; }
+	inline bool HasStats() const { return m_bInstantaneous || m_bLifetime; }
+
+	/// Size of the fixed layout, with the current contents
+	int FixedSerializedSize() const;
+
+	/// Serialize in the fixed layout.  Returns pointer past the last byte written
+	uint8 *SerializeFixed( uint8 *p ) const;
+
+	/// Parse the fixed layout.  Returns pointer past the last byte consumed,
+	/// or NULL if the data is malformed
+	const uint8 *DeserializeFixed( const uint8 *p, const uint8 *pEnd );
+
+	/// Convert to/from the protobuf, for old peers
+	void ToMsg( CMsgSteamSockets_UDP_Stats &msg ) const;
+	void FromMsg( const CMsgSteamSockets_UDP_Stats &msg );
+};
+
 struct UDPSendPacketContext_t : SendPacketContext<CMsgSteamSockets_UDP_Stats>
 {
 	inline explicit UDPSendPacketContext_t( SteamNetworkingMicroseconds usecNow, const char *pszReason ) : SendPacketContext<CMsgSteamSockets_UDP_Stats>( usecNow, pszReason ) {}
 	int m_nStatsNeed;
 
+	/// What we are sending.  If the peer is old, this is converted to msg,
+	/// otherwise msg is not used.
+	UDPInlineStats_t m_stats;
+	bool m_bFixedStats;
+
 	void Populate( size_t cbHdrtReserve, EStatsReplyRequest eReplyRequested, CConnectionTransportUDPBase *pTransport );
 
 	void Trim( int cbHdrOutSpaceRemaining );
+
+	/// Serialize the stats, in whichever format the peer understands.
+	/// Returns false if there is nothing to send
+	bool Serialize( byte *&p );
+
+private:
+	void CalcSize();
 };
 
 struct UDPRecvPacketContext_t : RecvPacketContext_t
 {
-	CMsgSteamSockets_UDP_Stats *m_pStatsIn;
+	const UDPInlineStats_t *m_pStatsIn;
 };
 
-extern std::string DescribeStatsContents( const CMsgSteamSockets_UDP_Stats &msg );
+extern std::string DescribeStatsContents( const UDPInlineStats_t &stats );
 extern bool BCheckRateLimitReportBadPacket( SteamNetworkingMicroseconds usecNow );
 extern void ReallyReportBadUDPPacket( const char *pszFrom, const char *pszMsgType, const char *pszFmt, ... );
 
@@ -111,10 +155,65 @@ private:
 
 	// Process packets from a source address that does not already correspond to a session
 	void Received_ChallengeRequest( const CMsgSteamSockets_UDP_ChallengeRequest &msg, const netadr_t &adrFrom, SteamNetworkingMicroseconds usecNow );
-	void Received_ConnectRequest( const CMsgSteamSockets_UDP_ConnectRequest &msg, const netadr_t &adrFrom, int cbPkt, SteamNetworkingMicroseconds usecNow );
+	void Received_ConnectRequest( const CMsgSteamSockets_UDP_ConnectRequest &msg, const netadr_t &adrFrom, int cbPkt, float flPriority, SteamNetworkingMicroseconds usecNow );
+	void Process_ConnectRequest( const CMsgSteamSockets_UDP_ConnectRequest &msg, const CMsgSteamSockets_UDP_ResumptionTicket *pTicket, const netadr_t &adrFrom, int cbPkt, SteamNetworkingMicroseconds usecNow );
 	void Received_ConnectionClosed( const CMsgSteamSockets_UDP_ConnectionClosed &msg, const netadr_t &adrFrom, SteamNetworkingMicroseconds usecNow );
+	void SendChallengeReply( uint32 unConnectionID, uint64 ulRemoteTimestamp, const netadr_t &adrTo, SteamNetworkingMicroseconds usecNow );
 	void SendMsg( uint8 nMsgID, const google::protobuf::MessageLite &msg, const netadr_t &adrTo );
 	void SendPaddedMsg( uint8 nMsgID, const google::protobuf::MessageLite &msg, const netadr_t adrTo );
+
+	//
+	// Admission control for handshake packets from hosts we don't have a
+	// connection with, so that a flood of junk can't starve the service
+	// thread.  See k_ESteamNetworkingConfig_IP_HandshakeRatePerPrefix and
+	// k_ESteamNetworkingConfig_IP_HandshakeCPUBudget
+	//
+
+	/// Token bucket limiting the rate of handshake packets from one address prefix
+	struct HandshakeTokenBucket_t
+	{
+		float m_flTokens;
+		SteamNetworkingMicroseconds m_usecLastRefill;
+	};
+
+	/// Buckets, keyed by a hash of the address prefix.  If a flood from lots of
+	/// prefixes fills the table, new prefixes share the overflow bucket.
+	CUtlHashMap<uint64,HandshakeTokenBucket_t,std::equal_to<uint64>,std::hash<uint64> > m_mapHandshakeBuckets;
+	HandshakeTokenBucket_t m_handshakeBucketOverflow;
+	SteamNetworkingMicroseconds m_usecLastPruneHandshakeBuckets;
+
+	/// Spend a token from the bucket for the sender's address prefix.  Returns
+	/// false if the packet should be dropped.  Otherwise, flPriority is set to how
+	/// full the bucket was (0...1), so that prefixes that are not sending us
+	/// much get served first.
+	bool BAdmitHandshakePacket( const netadr_t &adrFrom, SteamNetworkingMicroseconds usecNow, float &flPriority );
+
+	/// A connect request that passed the cheap checks (including the challenge,
+	/// so the address is not spoofed), but that we did not have the CPU budget
+	/// to process right away.
+	struct DeferredConnectRequest_t
+	{
+		CMsgSteamSockets_UDP_ConnectRequest m_msg;
+		CMsgSteamSockets_UDP_ResumptionTicket m_msgTicket;
+		bool m_bResume;
+		netadr_t m_adrFrom;
+		int m_cbPkt;
+		float m_flPriority;
+		SteamNetworkingMicroseconds m_usecReceived;
+	};
+	std_vector< std::unique_ptr<DeferredConnectRequest_t> > m_vecDeferredConnectRequests;
+
+	/// Microseconds of processing time we can spend on connect requests
+	/// right now.  Can go negative, since we don't know how long a request
+	/// will take until we've done it.
+	float m_flHandshakeCPUBudgetUsec;
+	SteamNetworkingMicroseconds m_usecHandshakeCPUBudgetLastRefill;
+	bool BHandshakeCPUBudgetAvailable( SteamNetworkingMicroseconds usecNow );
+
+	void DeferConnectRequest( const CMsgSteamSockets_UDP_ConnectRequest &msg, const CMsgSteamSockets_UDP_ResumptionTicket *pTicket, const netadr_t &adrFrom, int cbPkt, float flPriority, SteamNetworkingMicroseconds usecNow );
+	void ProcessConnectRequestWithinBudget( const CMsgSteamSockets_UDP_ConnectRequest &msg, const CMsgSteamSockets_UDP_ResumptionTicket *pTicket, const netadr_t &adrFrom, int cbPkt, SteamNetworkingMicroseconds usecNow );
+	void ThinkDeferredConnectRequests( SteamNetworkingMicroseconds usecNow );
+	ScheduledMethodThinker<CSteamNetworkListenSocketDirectUDP> m_scheduleDeferredConnectRequests;
 };
 
 /////////////////////////////////////////////////////////////////////////////
@@ -125,6 +224,19 @@ private:
 
 class CSteamNetworkConnectionUDP;
 
+/// Ticket from a server, that a client can use to resume a session with
+/// that server later.  See k_ESteamNetworkingConfig_IP_SessionResumption
+struct UDPSessionResumptionTicket_t
+{
+	netadr_t m_adrServer;
+	SteamNetworkingIdentity m_identityLocal;
+	SteamNetworkingIdentity m_identityServer;
+	bool m_bServerCertTrusted;
+	SteamNetworkingMicroseconds m_usecExpiry;
+	std::string m_sTicket; // Opaque to us
+	AutoWipeFixedSizeBuffer<32> m_secret;
+};
+
 /// Base class for transports that (might) end up sending packets
 /// directly on the wire.
 class CConnectionTransportUDPBase : public CConnectionTransport
@@ -139,7 +251,9 @@ public:
 	virtual void GetDetailedConnectionStatus( SteamNetworkingDetailedConnectionStatus &stats, SteamNetworkingMicroseconds usecNow ) override;
 
 protected:
-	void Received_Data( const uint8 *pPkt, int cbPkt, SteamNetworkingMicroseconds usecNow );
+	/// Process a data packet.  NOTE: The payload is decrypted in place, so the
+	/// buffer must be ours to scribble on.
+	void Received_Data( uint8 *pPkt, int cbPkt, SteamNetworkingMicroseconds usecNow );
 	void Received_ConnectionClosed( const CMsgSteamSockets_UDP_ConnectionClosed &msg, SteamNetworkingMicroseconds usecNow );
 	void Received_NoConnection( const CMsgSteamSockets_UDP_NoConnection &msg, SteamNetworkingMicroseconds usecNow );
 
@@ -152,7 +266,7 @@ protected:
 	virtual bool SendPacketGather( int nChunks, const iovec *pChunks, int cbSendTotal ) = 0;
 
 	/// Process stats message, either inline or standalone
-	void RecvStats( const CMsgSteamSockets_UDP_Stats &msgStatsIn, SteamNetworkingMicroseconds usecNow );
+	void RecvStats( const UDPInlineStats_t &statsIn, SteamNetworkingMicroseconds usecNow );
 	virtual void TrackSentStats( UDPSendPacketContext_t &ctx );
 
 	virtual void RecvValidUDPDataPacket( UDPRecvPacketContext_t &ctx );
@@ -181,6 +295,9 @@ public:
 
 	void SendConnectOK( SteamNetworkingMicroseconds usecNow );
 
+	/// The connection we belong to
+	inline CSteamNetworkConnectionUDP &ConnectionUDP() const;
+
 	static bool CreateLoopbackPair( CConnectionTransportUDP *pTransport[2] );
 
 protected:
@@ -213,6 +330,7 @@ public:
 	virtual void GetConnectionTypeDescription( ConnectionTypeDescription_t &szDescription ) const override;
 	virtual EUnsignedCert AllowRemoteUnsignedCert() override;
 	virtual EUnsignedCert AllowLocalUnsignedCert() override;
+	virtual bool BSupportsAsyncHandshakeCrypto() const override;
 
 	/// Initiate a connection
 	bool BInitConnect( const SteamNetworkingIPAddr &addressRemote, int nOptions, const SteamNetworkingConfigValue_t *pOptions, SteamDatagramErrMsg &errMsg );
@@ -226,8 +344,18 @@ public:
 		uint32 unConnectionIDRemote,
 		const CMsgSteamDatagramCertificateSigned &msgCert,
 		const CMsgSteamDatagramSessionCryptInfoSigned &msgSessionInfo,
+		const CMsgSteamSockets_UDP_ResumptionTicket *pResumptionTicket,
+		const std::string &sResumptionMAC,
 		SteamDatagramErrMsg &errMsg
 	);
+
+	/// Ticket we are presenting to resume an earlier session, if any, and
+	/// how many times we have sent it.  Cleared if the server asks us to do
+	/// the full handshake.
+	std::unique_ptr<UDPSessionResumptionTicket_t> m_pResumptionTicket;
+	int m_nResumeConnectRequestsSent;
+	void AbandonSessionResumption();
+
 protected:
 	virtual ~CSteamNetworkConnectionUDP(); // hidden destructor, don't call directly.  Use ConnectionQueueDestroy()
 
@@ -235,6 +363,11 @@ private:
 	bool BSetLocalIdentityAndCheckForAuthOverride( bool bIsLocalHost, int nOptions, const SteamNetworkingConfigValue_t *pOptions, SteamDatagramErrMsg &errMsg );
 };
 
+inline CSteamNetworkConnectionUDP &CConnectionTransportUDP::ConnectionUDP() const
+{
+	return static_cast<CSteamNetworkConnectionUDP &>( m_connection );
+}
+
 /// A connection over loopback
 class CSteamNetworkConnectionlocalhostLoopback final : public CSteamNetworkConnectionUDP
 {
@@ -247,6 +380,7 @@ public:
 	/// Base class overrides
 	virtual EUnsignedCert AllowRemoteUnsignedCert() override;
 	virtual EUnsignedCert AllowLocalUnsignedCert() override;
+	virtual bool BCanNegotiateCipher() const override { return false; }
 };
 
 } // namespace SteamNetworkingSocketsLib
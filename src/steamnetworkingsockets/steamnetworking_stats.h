@@ -371,6 +371,9 @@ struct SteamNetworkingDetailedConnectionStatus
 	/// What kind of transport us being used?
 	ESteamNetTransportKind m_eTransportKind;
 
+	/// Name of the cipher used for end-to-end encryption, if it has been negotiated
+	char m_szCipher[32];
+
 	/// Do we have a valid network configuration?  We cannot do anything without this.
 	ESteamNetworkingAvailability m_eAvailNetworkConfig;
 
@@ -157,6 +157,10 @@ struct PingTracker
 	/// Smoothed ping value
 	int m_nSmoothedPing;
 
+	/// Mean deviation of raw ping samples from the smoothed value, similar
+	/// to RTTVAR in RFC 6298.  Only valid if m_nValidPings > 0
+	float m_flPingMeanDevMS;
+
 	/// Time when we last sent a message, for which we expect a reply (possibly delayed)
 	/// that we could use to measure latency.  (Possibly because the reply contains
 	/// a simple timestamp, or possibly because it will contain a sequence number, and
@@ -720,6 +724,10 @@ struct LinkStatsTrackerBase
 	/// to send doesn't fit.)
 	void PopulateMessage( int nNeedFlags, CMsgSteamDatagramConnectionQuality &msg, SteamNetworkingMicroseconds usecNow );
 	void PopulateLifetimeMessage( CMsgSteamDatagramLinkLifetimeStats &msg );
+
+	/// Same as PopulateMessage, but fill out the structures directly, for
+	/// transports that don't send the stats as protobuf
+	void PopulateStats( int nNeedFlags, SteamDatagramLinkInstantaneousStats &sInstant, SteamDatagramLinkLifetimeStats &sLifetime );
 	/// Called when we send any message for which we expect some sort of reply.  (But maybe not an ack.)
 	void TrackSentMessageExpectingReply( SteamNetworkingMicroseconds usecNow, bool bAllowDelayedReply );
 
@@ -815,6 +823,18 @@ struct LinkStatsTrackerBase
 		m_usecTimeRecvLifetimeRemote = usecNow;
 	}
 
+	inline void RecvInstantaneousStats( const SteamDatagramLinkInstantaneousStats &s, SteamNetworkingMicroseconds usecNow )
+	{
+		m_latestRemote = s;
+		m_usecTimeRecvLatestRemote = usecNow;
+	}
+
+	inline void RecvLifetimeStats( const SteamDatagramLinkLifetimeStats &s, SteamNetworkingMicroseconds usecNow )
+	{
+		m_lifetimeRemote = s;
+		m_usecTimeRecvLifetimeRemote = usecNow;
+	}
+
 	/// Get urgency level to send instantaneous/lifetime stats.
 	int GetStatsSendNeed( SteamNetworkingMicroseconds usecNow );
 
@@ -1057,15 +1077,16 @@ struct LinkStatsTrackerEndToEnd : public LinkStatsTrackerBase
 	// LinkStatsTrackerBase "overrides"
 	virtual void GetLifetimeStats( SteamDatagramLinkLifetimeStats &s ) const OVERRIDE;
 
-	/// Calculate retry timeout the sender will use
-	SteamNetworkingMicroseconds CalcSenderRetryTimeout() const
+	/// Calculate retry timeout the sender will use, given the max
+	/// time the receiver might hold on to an ack
+	SteamNetworkingMicroseconds CalcSenderRetryTimeout( SteamNetworkingMicroseconds usecMaxAckDelay ) const
 	{
 		if ( m_ping.m_nSmoothedPing < 0 )
 			return k_nMillion;
 		// 3 x RTT + max delay, plus some slop.
 		// If the receiver hands on to it for the max duration and
 		// our RTT is very low
-		return m_ping.m_nSmoothedPing*3000 + ( k_usecMaxDataAckDelay + 10000 );
+		return m_ping.m_nSmoothedPing*3000 + ( usecMaxAckDelay + 10000 );
 	}
 
 	/// Time when the connection entered the connection state
@@ -1223,12 +1244,16 @@ struct LinkStatsTracker final : public TLinkStatsTracker
 	/// Called after we actually send connection data.  Note that we must have consumed the outgoing sequence
 	/// for that packet (using GetNextSendSequenceNumber), but must *NOT* have consumed any more!
 	void TrackSentStats( const CMsgSteamDatagramConnectionQuality &msg, SteamNetworkingMicroseconds usecNow, bool bAllowDelayedReply )
+	{
+		TrackSentStats( msg.has_instantaneous(), msg.has_lifetime(), usecNow, bAllowDelayedReply );
+	}
+	void TrackSentStats( bool bInstantaneous, bool bLifetime, SteamNetworkingMicroseconds usecNow, bool bAllowDelayedReply )
 	{
 		Assert( TLinkStatsTracker::m_eActivityLevel != ELinkActivityLevel::Disconnected );
 
 		TLinkStatsTracker::m_pktNumInFlight = TLinkStatsTracker::m_nNextSendSequenceNumber-1;
-		TLinkStatsTracker::m_bInFlightInstantaneous = msg.has_instantaneous();
-		TLinkStatsTracker::m_bInFlightLifetime = msg.has_lifetime();
+		TLinkStatsTracker::m_bInFlightInstantaneous = bInstantaneous;
+		TLinkStatsTracker::m_bInFlightLifetime = bLifetime;
 
 		// They should ack.  Make a note of the sequence number that we used,
 		// so that we can measure latency when they reply, setup timeout bookkeeping, etc
@@ -255,8 +255,8 @@ bool BSteamNetworkingIdentityToProtobufInternal( const SteamNetworkingIdentity &
 	return true;
 }
 
-/// Check an arbitrary signature against a public key.
-bool BCheckSignature( const std::string &signed_data, CMsgSteamDatagramCertificate_EKeyType eKeyType, const std::string &public_key, const std::string &signature, SteamDatagramErrMsg &errMsg )
+/// Sanity check the inputs to a signature check and load up the public key.
+bool BPrepareSignatureCheck( CMsgSteamDatagramCertificate_EKeyType eKeyType, const std::string &public_key, const std::string &signature, CECSigningPublicKey &outKeyPublic, SteamDatagramErrMsg &errMsg )
 {
 
 	// Quick check for missing values
@@ -286,13 +286,22 @@ bool BCheckSignature( const std::string &signed_data, CMsgSteamDatagramCertifica
 	}
 
 	// Put the public key into our object
-	CECSigningPublicKey keyPublic;
-	if ( !keyPublic.SetRawDataWithoutWipingInput( public_key.c_str(), public_key.length() ) )
+	if ( !outKeyPublic.SetRawDataWithoutWipingInput( public_key.c_str(), public_key.length() ) )
 	{
 		V_strcpy_safe( errMsg, "Invalid public key" );
 		return false;
 	}
 
+	return true;
+}
+
+/// Check an arbitrary signature against a public key.
+bool BCheckSignature( const std::string &signed_data, CMsgSteamDatagramCertificate_EKeyType eKeyType, const std::string &public_key, const std::string &signature, SteamDatagramErrMsg &errMsg )
+{
+	CECSigningPublicKey keyPublic;
+	if ( !BPrepareSignatureCheck( eKeyType, public_key, signature, keyPublic, errMsg ) )
+		return false;
+
 	// Do the crypto work to check the signature
 	if ( !keyPublic.VerifySignature( signed_data.c_str(), signed_data.length(), *(const CryptoSignature_t *)signature.c_str() ) )
 	{
@@ -14,6 +14,12 @@
 #include "steamnetworkingsockets_certstore.h"
 #include <tier1/utlhashmap.h>
 
+#ifdef IS_STEAMDATAGRAMROUTER
+	#include "router/sdr.h"
+#else
+	#include "clientlib/steamnetworkingsockets_lowlevel.h"
+#endif
+
 #ifdef DBGFLAG_VALIDATE
 	#include <tier0/validator_std.h>
 #endif
@@ -249,13 +255,13 @@ struct PublicKey
 	}
 
 	#ifdef STEAMNETWORKINGSOCKETS_HARDCODED_ROOT_CA_KEY
-		void SlamHardcodedRootCA()
+		bool SlamHardcodedRootCA( const char *pszPublicKey )
 		{
-			bool bOK = m_keyPublic.SetFromOpenSSHAuthorizedKeys( STEAMNETWORKINGSOCKETS_HARDCODED_ROOT_CA_KEY, sizeof(STEAMNETWORKINGSOCKETS_HARDCODED_ROOT_CA_KEY) );
-			Assert( bOK );
-			(void)bOK; // Suppress warning if asserts aren't enabled
+			if ( !m_keyPublic.SetFromOpenSSHAuthorizedKeys( pszPublicKey, V_strlen( pszPublicKey )+1 ) )
+				return false;
 			m_eTrust = k_ETrust_Hardcoded;
 			m_effectiveAuthScope.SetAll();
+			return true;
 		}
 	#endif
 
@@ -280,13 +286,88 @@ static PublicKey *FindPublicKey( uint64 nKeyID )
 	return s_mapPublicKeys[ idx ].get();
 }
 
+// Certs that we have already parsed and whose CA signature we have already
+// checked.  The same peers present the same certs over and over, so this saves
+// us the signature check and protobuf parse.  Everything that depends on the
+// time or the state of the cert store (CA trust, expiry, revocation) is still
+// checked every time.  Entries are keyed by a hash of the signed data.
+struct VerifiedCertKey
+{
+	SHA256Digest_t m_digest;
+	bool operator==( const VerifiedCertKey &x ) const { return memcmp( m_digest, x.m_digest, sizeof(m_digest) ) == 0; }
+};
+struct VerifiedCertKeyHash
+{
+	size_t operator()( const VerifiedCertKey &x ) const
+	{
+		size_t h;
+		memcpy( &h, x.m_digest, sizeof(h) );
+		return h;
+	}
+};
+struct VerifiedCert
+{
+	uint64 m_nCAKeyID;
+	CryptoSignature_t m_signature;
+	uint64 m_nKeyID;
+	CMsgSteamDatagramCertificate m_msgCert;
+	int64 m_nLastUsed;
+};
+constexpr int k_nMaxVerifiedCertCacheEntries = 256;
+static CUtlHashMap<VerifiedCertKey,std::unique_ptr<VerifiedCert>,std::equal_to<VerifiedCertKey>,VerifiedCertKeyHash > s_mapVerifiedCerts;
+static int64 s_nVerifiedCertCacheUseCounter;
+static CertStoreVerifiedCertCacheStats s_verifiedCertCacheStats;
+
+static void FlushVerifiedCertCache()
+{
+	s_mapVerifiedCerts.RemoveAll();
+}
+
+static void AddVerifiedCertToCache( const VerifiedCertKey &key, uint64 nCAKeyID, const std::string &signature, uint64 nKeyID, const CMsgSteamDatagramCertificate &msgCert )
+{
+	Assert( signature.length() == sizeof(CryptoSignature_t) );
+
+	// Full?  Evict the least recently used entry.  The cache is small, and we
+	// only get here after doing a signature check, which costs far more than
+	// this scan.
+	if ( s_mapVerifiedCerts.Count() >= k_nMaxVerifiedCertCacheEntries )
+	{
+		const VerifiedCertKey *pOldest = nullptr;
+		int64 nOldest = INT64_MAX;
+		for ( auto item: s_mapVerifiedCerts.IterItems() )
+		{
+			if ( item.Element()->m_nLastUsed < nOldest )
+			{
+				nOldest = item.Element()->m_nLastUsed;
+				pOldest = &item.Key();
+			}
+		}
+		if ( pOldest )
+		{
+			VerifiedCertKey keyOldest = *pOldest;
+			s_mapVerifiedCerts.Remove( keyOldest );
+			++s_verifiedCertCacheStats.m_nEvictions;
+		}
+	}
+
+	VerifiedCert *pEntry = new VerifiedCert;
+	pEntry->m_nCAKeyID = nCAKeyID;
+	memcpy( pEntry->m_signature, signature.c_str(), sizeof(pEntry->m_signature) );
+	pEntry->m_nKeyID = nKeyID;
+	pEntry->m_msgCert = msgCert;
+	pEntry->m_nLastUsed = ++s_nVerifiedCertCacheUseCounter;
+	s_mapVerifiedCerts.Insert( key, std::unique_ptr<VerifiedCert>( pEntry ) );
+}
+
 static void CertStore_OneTimeInit()
 {
 	#ifdef STEAMNETWORKINGSOCKETS_HARDCODED_ROOT_CA_KEY
 		if ( s_mapPublicKeys.Count() == 0 )
 		{
 			PublicKey *pKey = new PublicKey;
-			pKey->SlamHardcodedRootCA();
+			bool bOK = pKey->SlamHardcodedRootCA( STEAMNETWORKINGSOCKETS_HARDCODED_ROOT_CA_KEY );
+			Assert( bOK );
+			(void)bOK; // Suppress warning if asserts aren't enabled
 			uint64 nKeyID = pKey->CalculateKeyID();
 
 			// Make sure calculated ID matches what we expect!
@@ -303,7 +384,26 @@ void CertStore_Reset()
 {
 	s_mapPublicKeys.RemoveAll();
 	s_bTrustValid = false;
+	FlushVerifiedCertCache();
+}
+
+#ifdef STEAMNETWORKINGSOCKETS_HARDCODED_ROOT_CA_KEY
+bool CertStore_TEST_SetHardcodedRootCAKey( const char *pszPublicKey )
+{
+	CertStore_Reset();
+
+	PublicKey *pKey = new PublicKey;
+	if ( !pKey->SlamHardcodedRootCA( pszPublicKey ) )
+	{
+		delete pKey;
+		return false;
+	}
+
+	// Since the store isn't empty, CertStore_OneTimeInit won't add the real one
+	s_mapPublicKeys.Insert( pKey->CalculateKeyID(), std::unique_ptr<PublicKey>( pKey ) );
+	return true;
 }
+#endif
 
 void CertStore_AddKeyRevocation( uint64 key_id )
 {
@@ -569,6 +669,9 @@ static void CertStore_EnsureTrustValid()
 	if ( s_bTrustValid )
 		return;
 
+	// Something changed.  Anything we verified before might no longer be trusted
+	FlushVerifiedCertCache();
+
 	// Mark everything not in a "terminal" state as unknown
 	for ( const std::unique_ptr<PublicKey> &pKey: s_mapPublicKeys.IterValues() )
 	{
@@ -586,7 +689,8 @@ static void CertStore_EnsureTrustValid()
 	s_bTrustValid = true;
 }
 
-const CertAuthScope *CertStore_CheckCASignature( const std::string &signed_data, uint64 nCAKeyID, const std::string &signature, time_t timeNow, SteamNetworkingErrMsg &errMsg )
+// Everything CertStore_CheckCASignature does, except the actual crypto
+static PublicKey *FindTrustedCAKey( const std::string &signed_data, uint64 nCAKeyID, const std::string &signature, time_t timeNow, SteamNetworkingErrMsg &errMsg )
 {
 	CertStore_EnsureTrustValid();
 
@@ -639,25 +743,88 @@ const CertAuthScope *CertStore_CheckCASignature( const std::string &signed_data,
 		return nullptr;
 	}
 
-	// Do the crypto work to check the signature
-	if ( !pKey->m_keyPublic.VerifySignature( signed_data.c_str(), signed_data.length(), *(const CryptoSignature_t *)signature.c_str() ) )
+	return pKey;
+}
+
+// Check the signature itself, against a key returned by FindTrustedCAKey
+static bool CheckCASignatureCrypto( const PublicKey *pKey, const std::string &signed_data, const std::string &signature, SteamNetworkingErrMsg &errMsg, const CECSigningPublicKey *pKeySignatureVerified )
+{
+	// Do the crypto work to check the signature, unless it was already
+	// done with this same key
+	if ( pKeySignatureVerified && *pKeySignatureVerified == pKey->m_keyPublic )
+	{
+		// Already verified
+	}
+	else if ( !pKey->m_keyPublic.VerifySignature( signed_data.c_str(), signed_data.length(), *(const CryptoSignature_t *)signature.c_str() ) )
 	{
 		V_strcpy_safe( errMsg, "Signature verification failed" );
-		return nullptr;
+		return false;
 	}
 
+	return true;
+}
+
+const CertAuthScope *CertStore_CheckCASignature( const std::string &signed_data, uint64 nCAKeyID, const std::string &signature, time_t timeNow, SteamNetworkingErrMsg &errMsg, const CECSigningPublicKey *pKeySignatureVerified )
+{
+	const PublicKey *pKey = FindTrustedCAKey( signed_data, nCAKeyID, signature, timeNow, errMsg );
+	if ( !pKey )
+		return nullptr;
+	if ( !CheckCASignatureCrypto( pKey, signed_data, signature, errMsg, pKeySignatureVerified ) )
+		return nullptr;
 	return &pKey->m_effectiveAuthScope;
 }
 
-const CertAuthScope *CertStore_CheckCert( const CMsgSteamDatagramCertificateSigned &msgCertSigned, CMsgSteamDatagramCertificate &outMsgCert, time_t timeNow, SteamNetworkingErrMsg &errMsg )
+const CertAuthScope *CertStore_CheckCert( const CMsgSteamDatagramCertificateSigned &msgCertSigned, CMsgSteamDatagramCertificate &outMsgCert, time_t timeNow, SteamNetworkingErrMsg &errMsg, const CECSigningPublicKey *pKeySignatureVerified )
 {
-	const CertAuthScope *pResult = CertStore_CheckCASignature( msgCertSigned.cert(), msgCertSigned.ca_key_id(), msgCertSigned.ca_signature(), timeNow, errMsg );
-	if ( !pResult )
+	const PublicKey *pCAKey = FindTrustedCAKey( msgCertSigned.cert(), msgCertSigned.ca_key_id(), msgCertSigned.ca_signature(), timeNow, errMsg );
+	if ( !pCAKey )
 		return nullptr;
-	if ( !outMsgCert.ParseFromString( msgCertSigned.cert() ) )
+
+	// Have we already checked this exact cert, with this exact signature?
+	VerifiedCertKey cacheKey;
+	CCrypto::GenerateSHA256Digest( msgCertSigned.cert().c_str(), msgCertSigned.cert().length(), &cacheKey.m_digest );
+	uint64 nKeyID;
+	int idxCache = s_mapVerifiedCerts.Find( cacheKey );
+	VerifiedCert *pCached = idxCache == s_mapVerifiedCerts.InvalidIndex() ? nullptr : s_mapVerifiedCerts[ idxCache ].get();
+	if ( pCached && pCached->m_nCAKeyID == msgCertSigned.ca_key_id() && memcmp( pCached->m_signature, msgCertSigned.ca_signature().c_str(), sizeof(pCached->m_signature) ) == 0 )
 	{
-		V_strcpy_safe( errMsg, "Cert failed protobuf parse" );
-		return nullptr;
+		++s_verifiedCertCacheStats.m_nHits;
+		#ifndef IS_STEAMDATAGRAMROUTER
+			if ( unlikely( BPerfMetricsEnabled() ) )
+				PerfCounterAdd( k_EPerfCounter_CertCacheHits, 1 );
+		#endif
+		pCached->m_nLastUsed = ++s_nVerifiedCertCacheUseCounter;
+		outMsgCert = pCached->m_msgCert;
+		nKeyID = pCached->m_nKeyID;
+	}
+	else
+	{
+		++s_verifiedCertCacheStats.m_nMisses;
+		#ifndef IS_STEAMDATAGRAMROUTER
+			if ( unlikely( BPerfMetricsEnabled() ) )
+				PerfCounterAdd( k_EPerfCounter_CertCacheMisses, 1 );
+		#endif
+		if ( !CheckCASignatureCrypto( pCAKey, msgCertSigned.cert(), msgCertSigned.ca_signature(), errMsg, pKeySignatureVerified ) )
+			return nullptr;
+		if ( !outMsgCert.ParseFromString( msgCertSigned.cert() ) )
+		{
+			V_strcpy_safe( errMsg, "Cert failed protobuf parse" );
+			return nullptr;
+		}
+		if ( outMsgCert.key_type() != CMsgSteamDatagramCertificate_EKeyType_ED25519 )
+		{
+			V_sprintf_safe( errMsg, "Cert has invalid key type %d", (int)outMsgCert.key_type() );
+			return nullptr;
+		}
+		nKeyID = CalculatePublicKeyID_Ed25519( outMsgCert.key_data().c_str(), outMsgCert.key_data().length() );
+		if ( nKeyID == 0)
+		{
+			V_sprintf_safe( errMsg, "Cert has invalid public key" );
+			return nullptr;
+		}
+
+		// Signature checks out and it parsed.  Remember that.
+		AddVerifiedCertToCache( cacheKey, msgCertSigned.ca_key_id(), msgCertSigned.ca_signature(), nKeyID, outMsgCert );
 	}
 
 	// Check expiry
@@ -669,17 +836,6 @@ const CertAuthScope *CertStore_CheckCert( const CMsgSteamDatagramCertificateSign
 	}
 
 	// Check if their key has specifically been revoked.
-	if ( outMsgCert.key_type() != CMsgSteamDatagramCertificate_EKeyType_ED25519 )
-	{
-		V_sprintf_safe( errMsg, "Cert has invalid key type %d", (int)outMsgCert.key_type() );
-		return nullptr;
-	}
-	uint64 nKeyID = CalculatePublicKeyID_Ed25519( outMsgCert.key_data().c_str(), outMsgCert.key_data().length() );
-	if ( nKeyID == 0)
-	{
-		V_sprintf_safe( errMsg, "Cert has invalid public key" );
-		return nullptr;
-	}
 	const PublicKey *pPubKey = FindPublicKey( nKeyID );
 	if ( pPubKey )
 	{
@@ -700,7 +856,27 @@ const CertAuthScope *CertStore_CheckCert( const CMsgSteamDatagramCertificateSign
 		}
 	}
 
-	return pResult;
+	return &pCAKey->m_effectiveAuthScope;
+}
+
+void CertStore_GetVerifiedCertCacheStats( CertStoreVerifiedCertCacheStats &outStats )
+{
+	outStats = s_verifiedCertCacheStats;
+	outStats.m_nEntries = s_mapVerifiedCerts.Count();
+}
+
+bool CertStore_GetCAPublicKey( uint64 nCAKeyID, CECSigningPublicKey &outKey )
+{
+	CertStore_EnsureTrustValid();
+
+	if ( nCAKeyID == 0 )
+		return false;
+	const PublicKey *pKey = FindPublicKey( nCAKeyID );
+	if ( pKey == nullptr || pKey->m_eTrust < k_ETrust_Trusted )
+		return false;
+
+	outKey.CopyFrom( pKey->m_keyPublic );
+	return true;
 }
 
 const CertAuthScope *CertStore_CheckPublicKey( uint64 nKeyID, time_t timeNow, SteamNetworkingErrMsg &errMsg )
@@ -841,6 +1017,11 @@ void CertStore_Print( std::ostream &out )
 			out << "  (No valid certs)" << std::endl;
 		}
 	}
+
+	out << "Verified cert cache: " << s_mapVerifiedCerts.Count() << " entries, "
+		<< (long long)s_verifiedCertCacheStats.m_nHits << " hits, "
+		<< (long long)s_verifiedCertCacheStats.m_nMisses << " misses, "
+		<< (long long)s_verifiedCertCacheStats.m_nEvictions << " evictions" << std::endl;
 }
 
 #ifdef DBGFLAG_VALIDATE
@@ -111,6 +111,13 @@ extern void CertStore_Reset();
 /// only if there was a parse error.  DOES NOT check for expiry or validate any signatures, etc.
 extern bool CertStore_AddCertFromBase64( const char *pszBase64, SteamNetworkingErrMsg &errMsg );
 
+#ifdef STEAMNETWORKINGSOCKETS_HARDCODED_ROOT_CA_KEY
+/// Test hook: reset the store, and trust the specified key (in OpenSSH
+/// authorized_keys format) in place of the hardcoded root, until the next
+/// CertStore_Reset.  This lets tests issue their own certs.
+extern bool CertStore_TEST_SetHardcodedRootCAKey( const char *pszPublicKey );
+#endif
+
 /// Adds a key revocation entry.
 extern void CertStore_AddKeyRevocation( uint64 key_id );
 
@@ -121,13 +128,36 @@ extern void CertStore_AddKeyRevocation( uint64 key_id );
 /// If the signed data should be trusted, the scope of the authorization granted
 /// to that public key is returned.  Otherwise, NULL is returned and errMsg is
 /// populated.
-extern const CertAuthScope *CertStore_CheckCASignature( const std::string &signed_data, uint64 nCAKeyID, const std::string &signature, time_t timeNow, SteamNetworkingErrMsg &errMsg );
+///
+/// If the signature has already been verified against a key obtained from
+/// CertStore_GetCAPublicKey, pass that key in pKeySignatureVerified to skip
+/// the crypto.  (It's ignored if it no longer matches the key in the store.)
+extern const CertAuthScope *CertStore_CheckCASignature( const std::string &signed_data, uint64 nCAKeyID, const std::string &signature, time_t timeNow, SteamNetworkingErrMsg &errMsg, const CECSigningPublicKey *pKeySignatureVerified = nullptr );
 
 /// Check a CA signature and chain of trust for a signed cert.
 /// Also deserializes the cert and make sure it is not expired.
 /// DOES NOT CHECK that the appid, pops, etc in the cert
 /// are granted by the CA chain.  You need to do that!
-extern const CertAuthScope *CertStore_CheckCert( const CMsgSteamDatagramCertificateSigned &msgCertSigned, CMsgSteamDatagramCertificate &outMsgCert, time_t timeNow, SteamNetworkingErrMsg &errMsg );
+extern const CertAuthScope *CertStore_CheckCert( const CMsgSteamDatagramCertificateSigned &msgCertSigned, CMsgSteamDatagramCertificate &outMsgCert, time_t timeNow, SteamNetworkingErrMsg &errMsg, const CECSigningPublicKey *pKeySignatureVerified = nullptr );
+
+/// CertStore_CheckCert remembers certs it has already parsed and checked the
+/// signature on, so a peer presenting the same cert again only pays for a hash
+/// and the checks that depend on time or trust.  The cache is flushed whenever
+/// the contents of the cert store change (e.g. a revocation is added).
+struct CertStoreVerifiedCertCacheStats
+{
+	int m_nEntries = 0;
+	int64 m_nHits = 0;
+	int64 m_nMisses = 0;
+	int64 m_nEvictions = 0;
+};
+extern void CertStore_GetVerifiedCertCacheStats( CertStoreVerifiedCertCacheStats &outStats );
+
+/// Locate a CA key and, if it is trusted, make a copy of the public key.
+/// The cert store may only be accessed while holding the global lock, so this
+/// is used to check a CA signature somewhere else (e.g. on a worker thread).
+/// Does not check expiry; CertStore_CheckCASignature will still do that.
+extern bool CertStore_GetCAPublicKey( uint64 nCAKeyID, CECSigningPublicKey &outKey );
 
 /// Check if a cert gives permission to access a certain app.
 extern bool CheckCertAppID( const CMsgSteamDatagramCertificate &msgCert, const CertAuthScope *pCertAuthScope, AppId_t nAppID, SteamNetworkingErrMsg &errMsg );
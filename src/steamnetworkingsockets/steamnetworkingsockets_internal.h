@@ -131,6 +131,11 @@
 	#define STEAMNETWORKINGSOCKETS_ENABLE_SYSTEMSPEW
 #endif
 
+// STEAMNETWORKINGSOCKETS_ENABLE_SNPTRACE: Enable the binary per-packet trace, controlled by environment variables
+#if !IsConsole()
+	#define STEAMNETWORKINGSOCKETS_ENABLE_SNPTRACE
+#endif
+
 enum EDualWifiEnable {
 	k_nDualWifiEnable_Disable = 0,
 	k_nDualWifiEnable_Enable = 1, //
@@ -276,6 +281,7 @@ const int k_cbSteamNetworkingSocketsNoFragmentHeaderReserve = 100;
 /// It would be nice to use a smaller tag, but BCrypt requires a 16-byte tag,
 /// which is what OpenSSL uses by default for TLS.
 const int k_cbAESGCMTagSize = 16;
+const int k_cbChaCha20Poly1305TagSize = 16;
 
 /// Max length of plaintext and encrypted payload we will send.  AES-GCM does
 /// not use padding (but it does have the security tag).  So this can be
@@ -322,6 +328,15 @@ const SteamNetworkingMicroseconds k_usecMaxAckStatsDelay = 250*1000;
 /// !KLUDGE! This really ought to be application- (or connection-) specific.
 const SteamNetworkingMicroseconds k_usecMaxDataAckDelay = 50*1000;
 
+/// When the RTT is long, a sender may ask the receiver to hold acks for
+/// longer than k_usecMaxDataAckDelay, up to about 1/4 of the RTT.  But
+/// never longer than this.
+const SteamNetworkingMicroseconds k_usecMaxAckFrequencyDelay = 200*1000;
+
+/// Smallest packet count threshold a sender will ask for in an ack
+/// frequency frame.
+const int k_nMinAckFrequencyThreshold = 16;
+
 /// Precision of the delay ack delay values we send.  A packed value of 1 represents 2^N microseconds
 const unsigned k_usecAckDelayPacketSerializedPrecisionShift = 6;
 COMPILE_TIME_ASSERT( ( (k_usecMaxAckStatsDelay*2) >> k_usecAckDelayPacketSerializedPrecisionShift ) < 0x4000 ); // Make sure we varint encode in 2 bytes, even if we overshoot a factor of 2x
@@ -377,7 +392,7 @@ constexpr int k_nRouteScoreHuge = INT_MAX/8;
 /// Protocol version of this code.  This is a blunt instrument, which is incremented when we
 /// wish to change the wire protocol in a way that doesn't have some other easy
 /// mechanism for dealing with compatibility (e.g. using protobuf's robust mechanisms).
-const uint32 k_nCurrentProtocolVersion = 13;
+const uint32 k_nCurrentProtocolVersion = 18;
 
 /// Minimum required version we will accept from a peer.  We increment this
 /// when we introduce wire breaking protocol changes and do not wish to be
@@ -582,6 +597,11 @@ extern uint64 CalculatePublicKeyID_Ed25519( const void *pPubKey, size_t cbPubKey
 /// already verified that this public key is from somebody you trust.)
 extern bool BCheckSignature( const std::string &signed_data, CMsgSteamDatagramCertificate_EKeyType eKeyType, const std::string &public_key, const std::string &signature, SteamDatagramErrMsg &errMsg );
 
+/// Do all of the checks that BCheckSignature does, except for the actual crypto.
+/// On success, the public key is loaded into outKeyPublic, and the caller is
+/// responsible for verifying the signature.  (E.g. as part of a batch.)
+extern bool BPrepareSignatureCheck( CMsgSteamDatagramCertificate_EKeyType eKeyType, const std::string &public_key, const std::string &signature, CECSigningPublicKey &outKeyPublic, SteamDatagramErrMsg &errMsg );
+
 /// Parse PEM-like blob to a cert
 extern bool ParseCertFromPEM( const void *pCert, size_t cbCert, CMsgSteamDatagramCertificateSigned &outMsgSignedCert, SteamNetworkingErrMsg &errMsg );
 extern bool ParseCertFromBase64( const char *pBase64Data, size_t cbBase64Data, CMsgSteamDatagramCertificateSigned &outMsgSignedCert, SteamNetworkingErrMsg &errMsg );
@@ -877,9 +897,17 @@ struct ConnectionConfig
 	ConfigValue<int32> SendRateMax;
 	ConfigValue<int32> MTU_PacketSize;
 	ConfigValue<int32> NagleTime;
+	ConfigValue<int32> UnreliableFECLanes;
+	ConfigValue<int32> CompressionLanes;
+	ConfigValue<int32> CompressionDictionary;
+	ConfigValue<int32> CompactEncoding;
 	ConfigValue<int32> IP_AllowWithoutAuth;
 	ConfigValue<int32> IPLocalHost_AllowWithoutAuth;
+	ConfigValue<int32> IP_SessionResumption;
+	ConfigValue<int32> IP_HandshakeRatePerPrefix;
+	ConfigValue<int32> IP_HandshakeCPUBudget;
 	ConfigValue<int32> Unencrypted;
+	ConfigValue<int32> CipherPreference;
 	ConfigValue<int32> SymmetricConnect;
 	ConfigValue<int32> LocalVirtualPort;
 	ConfigValue<int64> ConnectionUserData;
@@ -948,6 +976,10 @@ namespace GlobalConfig
 
 	extern GlobalConfigValue<int32> FakePacketDup_TimeMax;
 	extern GlobalConfigValue<int32> PacketTraceMaxBytes;
+	extern GlobalConfigValue<int32> SpewAsyncQueueSize;
+	extern GlobalConfigValue<int32> PerfMetrics;
+	extern GlobalConfigValue<int32> HandshakeWorkerThreads;
+	extern GlobalConfigValue<int32> KeyExchangeKeyPoolSize;
 	extern GlobalConfigValue<int32> FakeRateLimit_Send_Rate;
 	extern GlobalConfigValue<int32> FakeRateLimit_Send_Burst;
 	extern GlobalConfigValue<int32> FakeRateLimit_Recv_Rate;
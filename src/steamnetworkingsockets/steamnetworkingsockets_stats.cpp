@@ -76,6 +76,7 @@ void PingTracker::Reset()
 	memset( m_arPing, 0, sizeof(m_arPing) );
 	m_nValidPings = 0;
 	m_nSmoothedPing = -1;
+	m_flPingMeanDevMS = 0.0f;
 	m_usecTimeLastSentPingRequest = 0;
 	m_usecTimeAllowNewSample = 0;
 }
@@ -85,6 +86,14 @@ void PingTracker::ReceivedPing( int nPingMS, SteamNetworkingMicroseconds usecNow
 	Assert( nPingMS >= 0 );
 	COMPILE_TIME_ASSERT( V_ARRAYSIZE(m_arPing) == 3 );
 
+	// Track deviation against every raw sample, even ones that we are about
+	// to merge into an existing bucket below.  The smoothed value
+	// deliberately ignores noise, but the noise is what this is measuring.
+	if ( m_nValidPings == 0 )
+		m_flPingMeanDevMS = nPingMS * .5f;
+	else
+		m_flPingMeanDevMS += ( std::abs( (float)( nPingMS - m_nSmoothedPing ) ) - m_flPingMeanDevMS ) * .25f;
+
 	// A note about using the minimum here when combining samples.
 	// This is based on an idea from BBR that there is some underlying
 	// network ping which is relatively constant, and then there is
@@ -635,6 +644,15 @@ void LinkStatsTrackerBase::PopulateMessage( int nNeedFlags, CMsgSteamDatagramCon
 	}
 }
 
+void LinkStatsTrackerBase::PopulateStats( int nNeedFlags, SteamDatagramLinkInstantaneousStats &sInstant, SteamDatagramLinkLifetimeStats &sLifetime )
+{
+	Assert( m_pktNumInFlight == 0 && m_eActivityLevel == ELinkActivityLevel::Active );
+	if ( nNeedFlags & k_nSendStats_Instantanous )
+		GetInstantaneousStats( sInstant );
+	if ( nNeedFlags & k_nSendStats_Lifetime )
+		GetLifetimeStats( sLifetime );
+}
+
 void LinkStatsTrackerBase::PopulateLifetimeMessage( CMsgSteamDatagramLinkLifetimeStats &msg )
 {
 	// !KLUDGE! Go through public struct as intermediary to keep code simple.
@@ -1546,6 +1564,11 @@ int SteamNetworkingDetailedConnectionStatus::Print( char *pszBuf, int cbBuf )
 		buf.Printf( "    Remote host is in data center '%s'\n", SteamNetworkingPOPIDRender( m_info.m_idPOPRemote ).c_str() );
 	}
 
+	if ( m_szCipher[0] != '\0' )
+	{
+		buf.Printf( "    Cipher: %s\n", m_szCipher );
+	}
+
 	// If we ever tried to send a packet end-to-end, dump end-to-end stats.
 	if ( m_statsEndToEnd.m_lifetime.m_nPacketsSent > 0 )
 	{
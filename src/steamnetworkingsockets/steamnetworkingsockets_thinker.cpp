@@ -221,6 +221,13 @@ void IThinker::Thinker_ProcessThinkers()
 		if ( pNextThinker->TryLock() )
 		{
 
+			// How late are we?  (Thinkers that asked to be woken up
+			// ASAP didn't ask for any particular time.)
+			#ifndef IS_STEAMDATAGRAMROUTER
+				if ( unlikely( BPerfMetricsEnabled() ) && pNextThinker->GetNextThinkTime() > k_nThinkTime_ASAP )
+					PerfHistogramRecord( k_EPerfHistogram_ThinkerLatenessUsec, usecNow - pNextThinker->GetNextThinkTime() );
+			#endif
+
 			// Go ahead and clear his think time now and remove him
 			// from the heap.  He needs to schedule a new think time
 			// if heeds service again.  For thinkers that need frequent
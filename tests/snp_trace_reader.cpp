@@ -0,0 +1,239 @@
+//====== Copyright Valve Corporation, All rights reserved. ====================
+//
+// Convert a binary SNP packet trace to text.
+//
+// Record a trace by setting STEAMNETWORKINGSOCKETS_SNP_TRACE_FILE in the
+// environment of the process being investigated.  Then:
+//
+//   snp_trace_reader [--csv|--json|--qlog] [--conn <id>] <tracefile>
+//
+// --csv   One line per packet.  (Default)
+// --json  Array of objects, one per packet.
+// --qlog  A qlog-style timeline (one trace per connection), which can be
+//         loaded into qvis or similar tools.  Fields that are specific to
+//         SNP are placed in a "snp" object on each event.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+#include <map>
+
+#include <steamnetworkingsockets/clientlib/steamnetworkingsockets_snptrace_format.h>
+
+enum EOutputFormat
+{
+	k_EOutputFormat_CSV,
+	k_EOutputFormat_JSON,
+	k_EOutputFormat_QLog,
+};
+
+static void PrintUsage()
+{
+	fprintf( stderr, "Usage: snp_trace_reader [--csv|--json|--qlog] [--conn <id>] <tracefile>\n" );
+}
+
+static const char *DirectionName( uint8_t eDirection )
+{
+	switch ( eDirection )
+	{
+		case k_ESNPTraceDirection_Send: return "send";
+		case k_ESNPTraceDirection_Recv: return "recv";
+	}
+	return "???";
+}
+
+static void PrintCSVHeader()
+{
+	printf( "time_usec,conn,dir,pktnum,cb_wire,cb_plaintext,reliable_segs,unreliable_segs,ack,ack_latest_pktnum,ack_blocks,encrypted,inhibit_ack,token_bucket,send_rate,pending_reliable,pending_unreliable,sent_unacked_reliable,ping_ms\n" );
+}
+
+static void PrintCSV( const SNPTraceRecord_t &r, int64_t usecTime )
+{
+	printf( "%" PRId64 ",%u,%s,%" PRId64 ",%u,%u,%u,%u,%d,%" PRId64 ",%u,%d,%d,%.1f,%d,%d,%d,%d,%d\n",
+		usecTime, r.m_unConnectionID, DirectionName( r.m_eDirection ), r.m_nPktNum,
+		r.m_cbWire, r.m_cbPlainText, r.m_nReliableSegments, r.m_nUnreliableSegments,
+		( r.m_nFlags & k_nSNPTraceFlag_Ack ) ? 1 : 0, r.m_nAckLatestPktNum, r.m_nAckBlocks,
+		( r.m_nFlags & k_nSNPTraceFlag_Encrypted ) ? 1 : 0,
+		( r.m_nFlags & k_nSNPTraceFlag_RecvInhibitAck ) ? 1 : 0,
+		r.m_flTokenBucket, r.m_nSendRate, r.m_cbPendingReliable, r.m_cbPendingUnreliable,
+		r.m_cbSentUnackedReliable, r.m_nPingMS );
+}
+
+static void PrintSNPFields( const SNPTraceRecord_t &r )
+{
+	printf( "\"token_bucket\":%.1f,\"send_rate\":%d,\"pending_reliable\":%d,\"pending_unreliable\":%d,\"sent_unacked_reliable\":%d,\"ping_ms\":%d",
+		r.m_flTokenBucket, r.m_nSendRate, r.m_cbPendingReliable, r.m_cbPendingUnreliable,
+		r.m_cbSentUnackedReliable, r.m_nPingMS );
+}
+
+static void PrintJSON( const SNPTraceRecord_t &r, int64_t usecTime, bool bFirst )
+{
+	printf( "%s\n  {\"time_usec\":%" PRId64 ",\"conn\":%u,\"dir\":\"%s\",\"pktnum\":%" PRId64 ",\"cb_wire\":%u,\"cb_plaintext\":%u,\"reliable_segs\":%u,\"unreliable_segs\":%u,",
+		bFirst ? "" : ",", usecTime, r.m_unConnectionID, DirectionName( r.m_eDirection ), r.m_nPktNum,
+		r.m_cbWire, r.m_cbPlainText, r.m_nReliableSegments, r.m_nUnreliableSegments );
+	if ( r.m_nFlags & k_nSNPTraceFlag_Ack )
+		printf( "\"ack\":{\"latest_pktnum\":%" PRId64 ",\"blocks\":%u},", r.m_nAckLatestPktNum, r.m_nAckBlocks );
+	printf( "\"encrypted\":%s,\"inhibit_ack\":%s,",
+		( r.m_nFlags & k_nSNPTraceFlag_Encrypted ) ? "true" : "false",
+		( r.m_nFlags & k_nSNPTraceFlag_RecvInhibitAck ) ? "true" : "false" );
+	PrintSNPFields( r );
+	printf( "}" );
+}
+
+static void PrintQLogEvent( const SNPTraceRecord_t &r, int64_t usecTime, bool bFirst )
+{
+	printf( "%s\n        {\"time\":%.3f,\"name\":\"transport:%s\",\"data\":{\"header\":{\"packet_type\":\"1RTT\",\"packet_number\":%" PRId64 "},\"raw\":{\"length\":%u,\"payload_length\":%u},\"frames\":[",
+		bFirst ? "" : ",", usecTime * 1e-3,
+		r.m_eDirection == k_ESNPTraceDirection_Send ? "packet_sent" : "packet_received",
+		r.m_nPktNum, r.m_cbWire, r.m_cbPlainText );
+	bool bFirstFrame = true;
+	if ( r.m_nFlags & k_nSNPTraceFlag_Ack )
+	{
+		printf( "{\"frame_type\":\"ack\",\"largest_acknowledged\":%" PRId64 ",\"ack_blocks\":%u}", r.m_nAckLatestPktNum, r.m_nAckBlocks );
+		bFirstFrame = false;
+	}
+	if ( r.m_nReliableSegments )
+	{
+		printf( "%s{\"frame_type\":\"stream\",\"count\":%u}", bFirstFrame ? "" : ",", r.m_nReliableSegments );
+		bFirstFrame = false;
+	}
+	if ( r.m_nUnreliableSegments )
+	{
+		printf( "%s{\"frame_type\":\"datagram\",\"count\":%u}", bFirstFrame ? "" : ",", r.m_nUnreliableSegments );
+	}
+	printf( "],\"snp\":{" );
+	PrintSNPFields( r );
+	printf( "}}}" );
+}
+
+int main( int argc, char **argv )
+{
+	EOutputFormat eFormat = k_EOutputFormat_CSV;
+	const char *pszFilename = nullptr;
+	bool bFilterConn = false;
+	uint32_t unFilterConn = 0;
+	for ( int i = 1 ; i < argc ; ++i )
+	{
+		if ( !strcmp( argv[i], "--csv" ) )
+			eFormat = k_EOutputFormat_CSV;
+		else if ( !strcmp( argv[i], "--json" ) )
+			eFormat = k_EOutputFormat_JSON;
+		else if ( !strcmp( argv[i], "--qlog" ) )
+			eFormat = k_EOutputFormat_QLog;
+		else if ( !strcmp( argv[i], "--conn" ) && i+1 < argc )
+		{
+			bFilterConn = true;
+			unFilterConn = (uint32_t)strtoul( argv[++i], nullptr, 0 );
+		}
+		else if ( argv[i][0] == '-' || pszFilename )
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+			pszFilename = argv[i];
+	}
+	if ( !pszFilename )
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	FILE *f = fopen( pszFilename, "rb" );
+	if ( !f )
+	{
+		fprintf( stderr, "Can't open '%s'\n", pszFilename );
+		return 1;
+	}
+
+	SNPTraceFileHeader_t hdr;
+	if ( fread( &hdr, sizeof(hdr), 1, f ) != 1 || memcmp( hdr.m_szMagic, SNPTRACE_FILE_MAGIC, sizeof(hdr.m_szMagic) ) != 0 )
+	{
+		fprintf( stderr, "'%s' is not an SNP trace file\n", pszFilename );
+		fclose( f );
+		return 1;
+	}
+	if ( hdr.m_nVersion != k_nSNPTraceFileVersion || hdr.m_cbHeader != sizeof(SNPTraceFileHeader_t) || hdr.m_cbRecord != sizeof(SNPTraceRecord_t) )
+	{
+		fprintf( stderr, "'%s' has unsupported version %u (header %u bytes, record %u bytes)\n", pszFilename, hdr.m_nVersion, hdr.m_cbHeader, hdr.m_cbRecord );
+		fclose( f );
+		return 1;
+	}
+
+	std::vector<SNPTraceRecord_t> vecRecords( hdr.m_nMaxRecords );
+	size_t nRead = fread( vecRecords.data(), sizeof(SNPTraceRecord_t), vecRecords.size(), f );
+	fclose( f );
+	vecRecords.resize( nRead );
+
+	// Put the records in order.  If the ring wrapped, the oldest record is
+	// the one after the newest.  The count in the header might lag a bit if
+	// the process didn't shut down cleanly, but then all we lose is the
+	// ordering of a few records around the wrap point.
+	std::vector<const SNPTraceRecord_t *> vecOrdered;
+	vecOrdered.reserve( nRead );
+	size_t idxStart = 0;
+	if ( hdr.m_nRecordsWritten > hdr.m_nMaxRecords && nRead == hdr.m_nMaxRecords )
+		idxStart = (size_t)( hdr.m_nRecordsWritten % hdr.m_nMaxRecords );
+	for ( size_t i = 0 ; i < nRead ; ++i )
+	{
+		const SNPTraceRecord_t &r = vecRecords[ ( idxStart + i ) % nRead ];
+		if ( r.m_eDirection == k_ESNPTraceDirection_Invalid )
+			continue;
+		if ( bFilterConn && r.m_unConnectionID != unFilterConn )
+			continue;
+		vecOrdered.push_back( &r );
+	}
+
+	const int64_t usecBase = hdr.m_usecLocalTimeOpened;
+	switch ( eFormat )
+	{
+		case k_EOutputFormat_CSV:
+			PrintCSVHeader();
+			for ( const SNPTraceRecord_t *r: vecOrdered )
+				PrintCSV( *r, r->m_usecTime - usecBase );
+			break;
+
+		case k_EOutputFormat_JSON:
+		{
+			printf( "[" );
+			bool bFirst = true;
+			for ( const SNPTraceRecord_t *r: vecOrdered )
+			{
+				PrintJSON( *r, r->m_usecTime - usecBase, bFirst );
+				bFirst = false;
+			}
+			printf( "\n]\n" );
+			break;
+		}
+
+		case k_EOutputFormat_QLog:
+		{
+			// Group by connection
+			std::map< uint32_t, std::vector<const SNPTraceRecord_t *> > mapByConn;
+			for ( const SNPTraceRecord_t *r: vecOrdered )
+				mapByConn[ r->m_unConnectionID ].push_back( r );
+
+			printf( "{\"qlog_version\":\"0.3\",\"qlog_format\":\"JSON\",\"title\":\"SNP trace\",\"traces\":[" );
+			bool bFirstTrace = true;
+			for ( const auto &conn: mapByConn )
+			{
+				printf( "%s\n  {\"title\":\"connection %u\",\"vantage_point\":{\"type\":\"unknown\"},\n   \"common_fields\":{\"group_id\":\"%u\",\"time_format\":\"relative\",\"reference_time\":%.3f},\n   \"events\":[",
+					bFirstTrace ? "" : ",", conn.first, conn.first, hdr.m_nUnixTimeOpened * 1e3 );
+				bool bFirst = true;
+				for ( const SNPTraceRecord_t *r: conn.second )
+				{
+					PrintQLogEvent( *r, r->m_usecTime - usecBase, bFirst );
+					bFirst = false;
+				}
+				printf( "\n   ]}" );
+				bFirstTrace = false;
+			}
+			printf( "\n]}\n" );
+			break;
+		}
+	}
+
+	return 0;
+}
@@ -4,16 +4,29 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <time.h>
 #include <string>
 #include <random>
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include <algorithm>
+#include <map>
+#include <set>
 
 #include <steam/steamnetworkingsockets.h>
 #include <steam/isteamnetworkingutils.h>
+#ifndef _WIN32
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+	#include <unistd.h>
+	#include <poll.h>
+#endif
 #ifndef STEAMNETWORKINGSOCKETS_OPENSOURCE
 #include <steam/steam_api.h>
 #endif
+#include <steamnetworkingsockets/clientlib/steamnetworkingsockets_snptrace_format.h>
 
 // It's 2021 and the C language doesn't have a cross-platform way to
 // compare strings in a case-insensitive way
@@ -345,6 +358,13 @@ static void PrintStatus( const SFakePeer &p1, const SFakePeer &p2 )
 	TEST_Printf( "%11.1fK %11.1fK  Recv rate (app)\n", p1.m_flRecvRate/1024.0f, p2.m_flRecvRate/1024.0f );
 	TEST_Printf( "%11.1fK %11.1fK  Recv rate (wire)\n", info1.m_flInBytesPerSec/1024.0f, info2.m_flInBytesPerSec/1024.0f );
 	TEST_Printf( "%12.1f %12.1f  Recv pkts/sec (wire)\n", info1.m_flInPacketsPerSec, info2.m_flInPacketsPerSec );
+	const HSteamNetConnection arConn[2] = { p1.m_hSteamNetConnection, p2.m_hSteamNetConnection };
+	SteamNetConnectionSNPStatus_t arSNP[2];
+	if ( SteamNetworkingSockets()->GetConnectionSNPStatus( arConn, 2, arSNP ) == 2 )
+	{
+		TEST_Printf( "%12lld %12lld  Ack-only pkts sent\n", (long long)arSNP[0].m_nAckOnlyPacketsSent, (long long)arSNP[1].m_nAckOnlyPacketsSent );
+		TEST_Printf( "%10.1fms %10.1fms  Max ack delay (requested by peer)\n", arSNP[0].m_usecAckMaxDelay*1e-3, arSNP[1].m_usecAckMaxDelay*1e-3 );
+	}
 	TEST_Printf( "%10.1fms %10.1fms  Send buffer drain time, based on bandwidth\n", ( info1.m_cbPendingReliable+info1.m_cbPendingUnreliable )*1000.0f/info1.m_nSendRateBytesPerSecond, ( info2.m_cbPendingReliable+info2.m_cbPendingUnreliable )*1000.0f/info2.m_nSendRateBytesPerSecond );
 	TEST_Printf( "%10.1fms %10.1fms  App RTT (reliable)\n", p1.m_flReliableMsgDelay*1e3, p2.m_flReliableMsgDelay*1e3 );
 	TEST_Printf( "%10.1fms %10.1fms  App RTT (unreliable)\n", p1.m_flUnreliableMsgDelay*1e3, p2.m_flUnreliableMsgDelay*1e3 );
@@ -1558,6 +1578,1690 @@ void Test_send_buffer_full()
 	SteamNetworkingSockets()->CloseConnection( hRecver, 0, nullptr, false );
 }
 
+// Make sure the performance metrics are collected, and check the
+// histogram bucket helpers
+void Test_perf_metrics()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "Performance metrics\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	// Every value is in the bucket it maps to, and bucket boundaries are contiguous
+	for ( int b = 0 ; b < SteamNetworkingHistogram_t::k_nBuckets ; ++b )
+	{
+		int64 nLower = SteamNetworkingHistogram_t::BucketLowerBound( b );
+		assert( SteamNetworkingHistogram_t::BucketForValue( nLower ) == b );
+		if ( b > 0 )
+			assert( SteamNetworkingHistogram_t::BucketForValue( nLower-1 ) == b-1 );
+	}
+	assert( SteamNetworkingHistogram_t::BucketForValue( -5 ) == 0 );
+	assert( SteamNetworkingHistogram_t::BucketForValue( 0xffffffffll ) == SteamNetworkingHistogram_t::k_nBuckets-1 );
+	assert( SteamNetworkingHistogram_t::BucketForValue( 1ll << 40 ) == SteamNetworkingHistogram_t::k_nBuckets-1 );
+
+	// The key exchange key pool is only used once there is a listen socket
+	SteamNetworkingIPAddr bindAddr;
+	bindAddr.Clear(); bindAddr.m_port = k_nStartingServerPort + 20;
+	HSteamListenSocket hListenSocket = SteamNetworkingSockets()->CreateListenSocketIP( bindAddr, 0, nullptr );
+	assert( hListenSocket != k_HSteamListenSocket_Invalid );
+
+	SteamNetworkingPerfMetrics_t before;
+	assert( !SteamNetworkingUtils()->GetPerfMetrics( &before ) );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_PerfMetrics, 1 );
+	assert( SteamNetworkingUtils()->GetPerfMetrics( &before ) );
+
+	// Network loopback, so packets go through the sockets and get encrypted
+	HSteamNetConnection hServer, hClient;
+	assert( SteamNetworkingSockets()->CreateSocketPair( &hServer, &hClient, true, nullptr, nullptr ) );
+
+	static const char kData[ 500 ] = {};
+	int nReceived = 0;
+	SteamNetworkingMicroseconds usecDeadline = SteamNetworkingUtils()->GetLocalTimestamp() + 5*1000*1000;
+	for ( int i = 0 ; i < 20 ; ++i )
+		SteamNetworkingSockets()->SendMessageToConnection( hServer, kData, sizeof(kData), k_nSteamNetworkingSend_Reliable, nullptr );
+	while ( nReceived < 20 )
+	{
+		assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecDeadline );
+		TEST_PumpCallbacks();
+		SteamNetworkingMessage_t *pMsg[ 8 ];
+		int n = SteamNetworkingSockets()->ReceiveMessagesOnConnection( hClient, pMsg, 8 );
+		for ( int j = 0 ; j < n ; ++j )
+			pMsg[j]->Release();
+		nReceived += n;
+		std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+	}
+
+	SteamNetworkingPerfMetrics_t after;
+	assert( SteamNetworkingUtils()->GetPerfMetrics( &after ) );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_PerfMetrics, 0 );
+
+	TEST_Printf( "threads=%d recv=%lld pkts sent=%lld bytes  key pool hits=%lld misses=%lld\n", after.m_nThreads, (long long)after.m_nRecvPackets, (long long)after.m_cbSent,
+		(long long)after.m_nKeyExchangeKeyPoolHits, (long long)after.m_nKeyExchangeKeyPoolMisses );
+	TEST_Printf( "recvfrom p50=%lldus  sendto p50=%lldus  lock wait p99=%lldus  lock hold p99=%lldus  decrypt p50=%lldus\n",
+		(long long)after.m_histRecvFromUsec.Percentile( 50 ), (long long)after.m_histSendToUsec.Percentile( 50 ),
+		(long long)after.m_histGlobalLockWaitUsec.Percentile( 99 ), (long long)after.m_histGlobalLockHoldUsec.Percentile( 99 ),
+		(long long)after.m_histDecryptUsec.Percentile( 50 ) );
+
+	assert( after.m_usecTimestamp > before.m_usecTimestamp );
+	assert( after.m_nThreads >= 1 );
+	assert( after.m_nRecvPackets > before.m_nRecvPackets );
+	assert( after.m_cbSent > before.m_cbSent );
+	assert( after.m_histSendToUsec.m_nCount > before.m_histSendToUsec.m_nCount );
+	assert( after.m_histRecvFromUsec.m_nCount > after.m_nRecvPackets - before.m_nRecvPackets );
+	assert( after.m_histGlobalLockHoldUsec.m_nCount > before.m_histGlobalLockHoldUsec.m_nCount );
+	assert( after.m_histEncryptUsec.m_nCount > before.m_histEncryptUsec.m_nCount );
+	assert( after.m_histDecryptUsec.m_nCount > before.m_histDecryptUsec.m_nCount );
+	assert( after.m_histPacketsPerPollWakeup.m_nCount > before.m_histPacketsPerPollWakeup.m_nCount );
+
+	// Both ends needed a key exchange key, which they got from the pool if it
+	// had been filled yet, or else generated on the spot
+	assert( ( after.m_nKeyExchangeKeyPoolHits + after.m_nKeyExchangeKeyPoolMisses ) - ( before.m_nKeyExchangeKeyPoolHits + before.m_nKeyExchangeKeyPoolMisses ) >= 2 );
+
+	// Histogram totals are consistent
+	int64 nTotal = 0;
+	for ( int64 n: after.m_histGlobalLockWaitUsec.m_arBuckets )
+		nTotal += n;
+	assert( nTotal == after.m_histGlobalLockWaitUsec.m_nCount );
+
+	SteamNetworkingSockets()->CloseConnection( hServer, 0, nullptr, false );
+	SteamNetworkingSockets()->CloseConnection( hClient, 0, nullptr, false );
+
+	// Taking those keys queued a refill of the pool in the background.  Once
+	// that has run, both ends of a new connection must get their keys from
+	// the pool.  Keep trying until then.
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_PerfMetrics, 1 );
+	usecDeadline = SteamNetworkingUtils()->GetLocalTimestamp() + 5*1000*1000;
+	for (;;)
+	{
+		TEST_PumpCallbacks();
+		SteamNetworkingPerfMetrics_t metricsBefore, metricsAfter;
+		assert( SteamNetworkingUtils()->GetPerfMetrics( &metricsBefore ) );
+		assert( SteamNetworkingSockets()->CreateSocketPair( &hServer, &hClient, true, nullptr, nullptr ) );
+		assert( SteamNetworkingUtils()->GetPerfMetrics( &metricsAfter ) );
+		SteamNetworkingSockets()->CloseConnection( hServer, 0, nullptr, false );
+		SteamNetworkingSockets()->CloseConnection( hClient, 0, nullptr, false );
+		if ( metricsAfter.m_nKeyExchangeKeyPoolHits - metricsBefore.m_nKeyExchangeKeyPoolHits >= 2 )
+		{
+			assert( metricsAfter.m_nKeyExchangeKeyPoolMisses == metricsBefore.m_nKeyExchangeKeyPoolMisses );
+			break;
+		}
+		assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecDeadline );
+	}
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_PerfMetrics, 0 );
+	SteamNetworkingSockets()->CloseListenSocket( hListenSocket );
+}
+
+void Test_snp_status()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "SNP status\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	HSteamNetConnection hServer, hClient;
+	assert( SteamNetworkingSockets()->CreateSocketPair( &hServer, &hClient, true, nullptr, nullptr ) );
+
+	// Drop some packets, so that we have to retransmit
+	SteamNetworkingUtils()->SetGlobalConfigValueFloat( k_ESteamNetworkingConfig_FakePacketLoss_Send, 10 );
+
+	static const char kData[ 1000 ] = {};
+	const int nMessages = 200;
+	int nReceived = 0;
+	SteamNetworkingMicroseconds usecDeadline = SteamNetworkingUtils()->GetLocalTimestamp() + 10*1000*1000;
+	for ( int i = 0 ; i < nMessages ; ++i )
+		SteamNetworkingSockets()->SendMessageToConnection( hServer, kData, sizeof(kData), k_nSteamNetworkingSend_Reliable, nullptr );
+	while ( nReceived < nMessages )
+	{
+		assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecDeadline );
+		TEST_PumpCallbacks();
+		SteamNetworkingMessage_t *pMsg[ 16 ];
+		int n = SteamNetworkingSockets()->ReceiveMessagesOnConnection( hClient, pMsg, 16 );
+		for ( int j = 0 ; j < n ; ++j )
+			pMsg[j]->Release();
+		nReceived += n;
+		std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+	}
+	SteamNetworkingUtils()->SetGlobalConfigValueFloat( k_ESteamNetworkingConfig_FakePacketLoss_Send, 0 );
+
+	// Include an invalid handle in the batch
+	const HSteamNetConnection arConn[3] = { hServer, k_HSteamNetConnection_Invalid, hClient };
+	SteamNetConnectionSNPStatus_t arStatus[3];
+	assert( SteamNetworkingSockets()->GetConnectionSNPStatus( arConn, 3, arStatus ) == 2 );
+
+	const SteamNetConnectionSNPStatus_t &s = arStatus[0];
+	TEST_Printf( "rate=%d [%d,%d] ping=%d+/-%dms inflight=%d segs=%lld retrans=%lld (%lld bytes) app=%.1fms rate=%.1fms ackdelay=%lldus lane0 queue=%lldus\n",
+		s.m_nSendRateBytesPerSecond, s.m_nSendRateMin, s.m_nSendRateMax, s.m_nSmoothedPingMS, s.m_nPingMeanDevMS,
+		s.m_nPacketsInFlight, (long long)s.m_nReliableSegmentsSent, (long long)s.m_nReliableSegmentsRetransmitted, (long long)s.m_cbReliableRetransmitted,
+		s.m_usecAppLimited*1e-3, s.m_usecRateLimited*1e-3, (long long)s.m_usecPeerAckDelayMax, (long long)s.m_usecLaneQueueTime[0] );
+
+	assert( s.m_hConn == hServer );
+	assert( s.m_eResult == k_EResultOK );
+	assert( s.m_eState == k_ESteamNetworkingConnectionState_Connected );
+	assert( s.m_nSendRateMin <= s.m_nSendRateBytesPerSecond && s.m_nSendRateBytesPerSecond <= s.m_nSendRateMax );
+	assert( s.m_nSmoothedPingMS >= 0 );
+	assert( s.m_nPingMeanDevMS >= 0 );
+	assert( s.m_nPacketsInFlight >= 0 );
+	assert( s.m_nReliableSegmentsSent >= nMessages );
+	assert( s.m_nReliableSegmentsRetransmitted > 0 );
+	assert( s.m_cbReliableRetransmitted > 0 );
+	assert( s.m_usecAppLimited > 0 );
+	assert( s.m_usecPeerAckDelayMax >= s.m_usecPeerAckDelayLast && s.m_usecPeerAckDelayLast >= 0 );
+	assert( s.m_nLanes == 1 );
+	assert( s.m_usecLaneQueueTime[0] >= 0 );
+
+	assert( arStatus[1].m_hConn == k_HSteamNetConnection_Invalid );
+	assert( arStatus[1].m_eResult == k_EResultNoConnection );
+
+	// Receiver hasn't sent any reliable data
+	assert( arStatus[2].m_hConn == hClient );
+	assert( arStatus[2].m_eResult == k_EResultOK );
+	assert( arStatus[2].m_nReliableSegmentsSent == 0 );
+
+	SteamNetworkingSockets()->CloseConnection( hServer, 0, nullptr, false );
+	SteamNetworkingSockets()->CloseConnection( hClient, 0, nullptr, false );
+}
+
+// Record a binary SNP trace of a loopback connection, read it back, and
+// check that every packet the receiver logged matches what the sender logged.
+void Test_snp_trace()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "SNP packet trace\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	// The trace file is opened when the library is initialized, so we
+	// need to restart it
+	static const char szTraceFile[] = "snp_trace_test.bin";
+	TEST_Kill();
+	#ifdef _WIN32
+		_putenv_s( "STEAMNETWORKINGSOCKETS_SNP_TRACE_FILE", szTraceFile );
+		_putenv_s( "STEAMNETWORKINGSOCKETS_SNP_TRACE_MAX_RECORDS", "65536" );
+	#else
+		setenv( "STEAMNETWORKINGSOCKETS_SNP_TRACE_FILE", szTraceFile, 1 );
+		setenv( "STEAMNETWORKINGSOCKETS_SNP_TRACE_MAX_RECORDS", "65536", 1 );
+	#endif
+	TEST_Init( nullptr );
+
+	HSteamNetConnection hServer, hClient;
+	assert( SteamNetworkingSockets()->CreateSocketPair( &hServer, &hClient, true, nullptr, nullptr ) );
+
+	static const char kData[ 3000 ] = {};
+	const int nMessages = 50;
+	for ( int i = 0 ; i < nMessages ; ++i )
+		SteamNetworkingSockets()->SendMessageToConnection( hServer, kData, 100 + i*50, k_nSteamNetworkingSend_Reliable, nullptr );
+	int nReceived = 0;
+	SteamNetworkingMicroseconds usecDeadline = SteamNetworkingUtils()->GetLocalTimestamp() + 10*1000*1000;
+	while ( nReceived < nMessages )
+	{
+		assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecDeadline );
+		TEST_PumpCallbacks();
+		SteamNetworkingMessage_t *pMsg[ 16 ];
+		int n = SteamNetworkingSockets()->ReceiveMessagesOnConnection( hClient, pMsg, 16 );
+		for ( int j = 0 ; j < n ; ++j )
+			pMsg[j]->Release();
+		nReceived += n;
+	}
+
+	// Give the acks a moment to arrive, so both directions have traffic
+	for ( int i = 0 ; i < 50 ; ++i )
+		TEST_PumpCallbacks();
+
+	SteamNetworkingSockets()->CloseConnection( hServer, 0, nullptr, false );
+	SteamNetworkingSockets()->CloseConnection( hClient, 0, nullptr, false );
+
+	// Closing the library finalizes the trace
+	TEST_Kill();
+	#ifdef _WIN32
+		_putenv_s( "STEAMNETWORKINGSOCKETS_SNP_TRACE_FILE", "" );
+		_putenv_s( "STEAMNETWORKINGSOCKETS_SNP_TRACE_MAX_RECORDS", "" );
+	#else
+		unsetenv( "STEAMNETWORKINGSOCKETS_SNP_TRACE_FILE" );
+		unsetenv( "STEAMNETWORKINGSOCKETS_SNP_TRACE_MAX_RECORDS" );
+	#endif
+	TEST_Init( nullptr );
+
+	FILE *f = fopen( szTraceFile, "rb" );
+	assert( f );
+	SNPTraceFileHeader_t hdr;
+	assert( fread( &hdr, sizeof(hdr), 1, f ) == 1 );
+	assert( memcmp( hdr.m_szMagic, SNPTRACE_FILE_MAGIC, sizeof(hdr.m_szMagic) ) == 0 );
+	assert( hdr.m_nVersion == k_nSNPTraceFileVersion );
+	assert( hdr.m_cbHeader == sizeof(SNPTraceFileHeader_t) );
+	assert( hdr.m_cbRecord == sizeof(SNPTraceRecord_t) );
+	assert( hdr.m_nRecordsWritten > 0 );
+	assert( hdr.m_nRecordsWritten <= hdr.m_nMaxRecords ); // Test should not wrap the ring
+	std::vector<SNPTraceRecord_t> vecRecords( (size_t)hdr.m_nRecordsWritten );
+	assert( fread( vecRecords.data(), sizeof(SNPTraceRecord_t), vecRecords.size(), f ) == vecRecords.size() );
+	fclose( f );
+	remove( szTraceFile );
+
+	// Index the sends by connection and packet number
+	std::map< std::pair<uint32,int64>, const SNPTraceRecord_t * > mapSent;
+	std::set<uint32> setConnections;
+	for ( const SNPTraceRecord_t &r: vecRecords )
+	{
+		assert( r.m_eDirection == k_ESNPTraceDirection_Send || r.m_eDirection == k_ESNPTraceDirection_Recv );
+		assert( r.m_cbWire > r.m_cbPlainText );
+		setConnections.insert( r.m_unConnectionID );
+		if ( r.m_eDirection == k_ESNPTraceDirection_Send )
+			mapSent[ std::make_pair( r.m_unConnectionID, r.m_nPktNum ) ] = &r;
+	}
+	assert( setConnections.size() == 2 );
+
+	// Every packet received on one end must have been sent by the other
+	// end, with the same size on the wire and the same payload
+	int nRecv = 0, nReliableSegments = 0;
+	for ( const SNPTraceRecord_t &r: vecRecords )
+	{
+		if ( r.m_eDirection != k_ESNPTraceDirection_Recv )
+			continue;
+		uint32 unPeerConnectionID = *setConnections.begin() == r.m_unConnectionID ? *setConnections.rbegin() : *setConnections.begin();
+		auto it = mapSent.find( std::make_pair( unPeerConnectionID, r.m_nPktNum ) );
+		assert( it != mapSent.end() );
+		const SNPTraceRecord_t &s = *it->second;
+		assert( s.m_cbWire == r.m_cbWire );
+		assert( s.m_cbPlainText == r.m_cbPlainText );
+		assert( s.m_nReliableSegments == r.m_nReliableSegments );
+		assert( s.m_nFlags == ( r.m_nFlags & ~k_nSNPTraceFlag_RecvInhibitAck ) );
+		nReliableSegments += r.m_nReliableSegments;
+		++nRecv;
+	}
+	TEST_Printf( "%d records, %d packets received, %d reliable segments\n", (int)vecRecords.size(), nRecv, nReliableSegments );
+	assert( nRecv > 0 );
+	assert( nReliableSegments >= nMessages );
+}
+
+// Queue up more unreliable data than we can send, with a deadline, or a
+// coalescing key, and make sure the stale messages are discarded
+// instead of being sent late.
+void Test_unreliable_expiry()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "Unreliable message expiry and coalescing\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	HSteamNetConnection hServer, hClient;
+	assert( SteamNetworkingSockets()->CreateSocketPair( &hServer, &hClient, true, nullptr, nullptr ) );
+	SteamNetworkingUtils()->SetConnectionConfigValueInt32( hServer, k_ESteamNetworkingConfig_SendRateMin, 32*1024 );
+	SteamNetworkingUtils()->SetConnectionConfigValueInt32( hServer, k_ESteamNetworkingConfig_SendRateMax, 32*1024 );
+
+	const int nMessages = 100;
+	const int cbMsg = 1000;
+	auto SendAndReceive = [&]( bool bCoalesce ) -> int
+	{
+		SteamNetworkingMessage_t *pMessages[ nMessages ];
+		SteamNetworkingMicroseconds arUsecExpiry[ nMessages ];
+		int64 arCoalesceKeys[ nMessages ];
+		SteamNetworkingMicroseconds usecNow = SteamNetworkingUtils()->GetLocalTimestamp();
+		for ( int i = 0 ; i < nMessages ; ++i )
+		{
+			SteamNetworkingMessage_t *pMsg = SteamNetworkingUtils()->AllocateMessage( cbMsg );
+			pMsg->m_conn = hServer;
+			pMsg->m_nFlags = k_nSteamNetworkingSend_Unreliable;
+			pMessages[i] = pMsg;
+			arUsecExpiry[i] = usecNow + 100*1000;
+			arCoalesceKeys[i] = 1 + i%5;
+		}
+		SteamNetworkingSockets()->SendMessagesWithOptions( nMessages, pMessages,
+			bCoalesce ? nullptr : arUsecExpiry, bCoalesce ? arCoalesceKeys : nullptr, nullptr, true );
+
+		// Whatever wasn't discarded will have drained by then
+		int nReceived = 0;
+		SteamNetworkingMicroseconds usecEnd = SteamNetworkingUtils()->GetLocalTimestamp() + 2*1000*1000;
+		while ( SteamNetworkingUtils()->GetLocalTimestamp() < usecEnd )
+		{
+			TEST_PumpCallbacks();
+			SteamNetworkingMessage_t *pMsg[ 16 ];
+			int n = SteamNetworkingSockets()->ReceiveMessagesOnConnection( hClient, pMsg, 16 );
+			for ( int j = 0 ; j < n ; ++j )
+			{
+				assert( pMsg[j]->m_cbSize == cbMsg );
+				pMsg[j]->Release();
+			}
+			nReceived += n;
+			std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+		}
+		return nReceived;
+	};
+
+	SteamNetConnectionRealTimeStatus_t status;
+	SteamNetConnectionRealTimeLaneStatus_t lane;
+
+	int nReceived = SendAndReceive( false );
+	assert( SteamNetworkingSockets()->GetConnectionRealTimeStatus( hServer, &status, 1, &lane ) == k_EResultOK );
+	TEST_Printf( "Expiry: received %d, expired %lld\n", nReceived, (long long)lane.m_nUnreliableExpired );
+	assert( lane.m_nUnreliableExpired > nMessages/2 );
+	assert( lane.m_nUnreliableCoalesced == 0 );
+	assert( nReceived + lane.m_nUnreliableExpired == nMessages ); // Loopback, no packet loss
+	assert( lane.m_cbPendingUnreliable == 0 );
+
+	nReceived = SendAndReceive( true );
+	assert( SteamNetworkingSockets()->GetConnectionRealTimeStatus( hServer, &status, 1, &lane ) == k_EResultOK );
+	TEST_Printf( "Coalesce: received %d, coalesced %lld\n", nReceived, (long long)lane.m_nUnreliableCoalesced );
+
+	// Only the latest message for each of the 5 keys should have survived,
+	// plus perhaps a few that went out immediately
+	assert( lane.m_nUnreliableCoalesced > nMessages/2 );
+	assert( nReceived + lane.m_nUnreliableCoalesced == nMessages );
+	assert( nReceived >= 5 );
+	assert( lane.m_cbPendingUnreliable == 0 );
+
+	SteamNetworkingSockets()->CloseConnection( hServer, 0, nullptr, false );
+	SteamNetworkingSockets()->CloseConnection( hClient, 0, nullptr, false );
+}
+
+// Large unreliable messages on a lossy link with some reordering.  Every
+// message that gets through must be intact, and we report how much CPU
+// it took, as a rough benchmark of fragment reassembly.
+void Test_unreliable_reassembly()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "Unreliable reassembly\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	SteamNetworkingUtils()->SetGlobalConfigValueFloat( k_ESteamNetworkingConfig_FakePacketLoss_Send, 5.0f );
+	SteamNetworkingUtils()->SetGlobalConfigValueFloat( k_ESteamNetworkingConfig_FakePacketReorder_Send, 5.0f );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_FakePacketReorder_Time, 5 );
+
+	HSteamNetConnection hServer, hClient;
+	assert( SteamNetworkingSockets()->CreateSocketPair( &hServer, &hClient, true, nullptr, nullptr ) );
+	const int k_nSendRate = 8*1024*1024;
+	SteamNetworkingUtils()->SetConnectionConfigValueInt32( hServer, k_ESteamNetworkingConfig_SendRateMin, k_nSendRate );
+	SteamNetworkingUtils()->SetConnectionConfigValueInt32( hServer, k_ESteamNetworkingConfig_SendRateMax, k_nSendRate );
+
+	const int nMessages = 500;
+	const int cbMsg = 15*1000;
+	std::vector<uint8> msg( cbMsg );
+	std::vector<bool> vecReceived( nMessages, false );
+	int nDelivered = 0;
+	auto Receive = [&]()
+	{
+		SteamNetworkingMessage_t *pMsg[ 16 ];
+		int n = SteamNetworkingSockets()->ReceiveMessagesOnConnection( hClient, pMsg, 16 );
+		for ( int j = 0 ; j < n ; ++j )
+		{
+			const uint8 *p = (const uint8 *)pMsg[j]->m_pData;
+			int idx;
+			assert( pMsg[j]->m_cbSize == cbMsg );
+			memcpy( &idx, p, sizeof(idx) );
+			assert( idx >= 0 && idx < nMessages );
+			for ( int k = sizeof(idx) ; k < cbMsg ; ++k )
+				assert( p[k] == uint8( idx*7 + k/3 ) );
+			assert( !vecReceived[idx] );
+			vecReceived[idx] = true;
+			++nDelivered;
+			pMsg[j]->Release();
+		}
+	};
+
+	const clock_t clockStart = clock();
+	const SteamNetworkingMicroseconds usecStart = SteamNetworkingUtils()->GetLocalTimestamp();
+	for ( int i = 0 ; i < nMessages ; ++i )
+	{
+		memcpy( msg.data(), &i, sizeof(i) );
+		for ( int k = sizeof(i) ; k < cbMsg ; ++k )
+			msg[k] = uint8( i*7 + k/3 );
+		assert( SteamNetworkingSockets()->SendMessageToConnection( hServer, msg.data(), cbMsg, k_nSteamNetworkingSend_Unreliable, nullptr ) == k_EResultOK );
+		if ( i % 4 == 3 )
+		{
+			std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+			TEST_PumpCallbacks();
+			Receive();
+		}
+	}
+	SteamNetworkingMicroseconds usecEnd = SteamNetworkingUtils()->GetLocalTimestamp() + 500*1000;
+	while ( SteamNetworkingUtils()->GetLocalTimestamp() < usecEnd )
+	{
+		TEST_PumpCallbacks();
+		Receive();
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+	}
+	const float flCPUSecs = float( clock() - clockStart ) / CLOCKS_PER_SEC;
+	const float flWallSecs = ( SteamNetworkingUtils()->GetLocalTimestamp() - usecStart ) * 1e-6f;
+
+	SteamNetworkingUtils()->SetGlobalConfigValueFloat( k_ESteamNetworkingConfig_FakePacketLoss_Send, 0 );
+	SteamNetworkingUtils()->SetGlobalConfigValueFloat( k_ESteamNetworkingConfig_FakePacketReorder_Send, 0 );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_FakePacketReorder_Time, 0 );
+
+	TEST_Printf( "Delivered %d/%d %d-byte messages (%.1f%%).  CPU %.3fs, wall %.3fs\n",
+		nDelivered, nMessages, cbMsg, nDelivered*100.0f/nMessages, flCPUSecs, flWallSecs );
+
+	// Each message is 14 packets, so at 5% loss we expect about half of them
+	// to make it.
+	assert( nDelivered > nMessages/4 );
+	assert( nDelivered < nMessages );
+
+	SteamNetworkingSockets()->CloseConnection( hServer, 0, nullptr, false );
+	SteamNetworkingSockets()->CloseConnection( hClient, 0, nullptr, false );
+}
+
+// Send a steady stream of small unreliable messages on a lossy link, with and
+// without forward error correction, and compare how many get through.
+void Test_unreliable_fec()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "Unreliable forward error correction\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	const int nMessages = 500;
+	const float flLossPct = 10.0f;
+	SteamNetworkingUtils()->SetGlobalConfigValueFloat( k_ESteamNetworkingConfig_FakePacketLoss_Send, flLossPct );
+
+	int arDelivered[2];
+	for ( int bFEC = 0 ; bFEC < 2 ; ++bFEC )
+	{
+		HSteamNetConnection hServer, hClient;
+		SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_UnreliableFECLanes, bFEC ? 1 : 0 );
+		assert( SteamNetworkingSockets()->CreateSocketPair( &hServer, &hClient, true, nullptr, nullptr ) );
+
+		// Each message is a counter, and some filler that depends on it, so we
+		// can check that rebuilt messages are correct
+		std::vector<bool> vecReceived( nMessages, false );
+		int nDelivered = 0;
+		auto Receive = [&]()
+		{
+			SteamNetworkingMessage_t *pMsg[ 16 ];
+			int n = SteamNetworkingSockets()->ReceiveMessagesOnConnection( hClient, pMsg, 16 );
+			for ( int j = 0 ; j < n ; ++j )
+			{
+				const uint8 *p = (const uint8 *)pMsg[j]->m_pData;
+				int idx;
+				assert( pMsg[j]->m_cbSize >= (int)sizeof(idx) );
+				memcpy( &idx, p, sizeof(idx) );
+				assert( idx >= 0 && idx < nMessages );
+				assert( pMsg[j]->m_cbSize == 50 + idx%100 );
+				for ( int k = sizeof(idx) ; k < pMsg[j]->m_cbSize ; ++k )
+					assert( p[k] == uint8( idx + k ) );
+				assert( !vecReceived[idx] ); // No duplicates
+				vecReceived[idx] = true;
+				++nDelivered;
+				pMsg[j]->Release();
+			}
+		};
+
+		for ( int i = 0 ; i < nMessages ; ++i )
+		{
+			uint8 msg[ 150 ];
+			const int cbMsg = 50 + i%100;
+			memcpy( msg, &i, sizeof(i) );
+			for ( int k = sizeof(i) ; k < cbMsg ; ++k )
+				msg[k] = uint8( i + k );
+			SteamNetworkingSockets()->SendMessageToConnection( hServer, msg, cbMsg, k_nSteamNetworkingSend_UnreliableNoNagle, nullptr );
+			std::this_thread::sleep_for( std::chrono::milliseconds( 2 ) );
+			TEST_PumpCallbacks();
+			Receive();
+		}
+		SteamNetworkingMicroseconds usecEnd = SteamNetworkingUtils()->GetLocalTimestamp() + 500*1000;
+		while ( SteamNetworkingUtils()->GetLocalTimestamp() < usecEnd )
+		{
+			TEST_PumpCallbacks();
+			Receive();
+			std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+		}
+
+		SteamNetConnectionSNPStatus_t arStatus[2];
+		const HSteamNetConnection arConn[2] = { hServer, hClient };
+		assert( SteamNetworkingSockets()->GetConnectionSNPStatus( arConn, 2, arStatus ) == 2 );
+		TEST_Printf( "FEC %s: delivered %d/%d (%.1f%%), parity frames sent %lld, recovered %lld\n",
+			bFEC ? "on" : "off", nDelivered, nMessages, nDelivered*100.0f/nMessages,
+			(long long)arStatus[0].m_nFECParityFramesSent, (long long)arStatus[1].m_nFECMessagesRecovered );
+		if ( bFEC )
+		{
+			assert( arStatus[0].m_nFECParityFramesSent > 0 );
+			assert( arStatus[1].m_nFECMessagesRecovered > 0 );
+		}
+		else
+		{
+			assert( arStatus[0].m_nFECParityFramesSent == 0 );
+			assert( arStatus[1].m_nFECMessagesRecovered == 0 );
+		}
+		arDelivered[bFEC] = nDelivered;
+
+		SteamNetworkingSockets()->CloseConnection( hServer, 0, nullptr, false );
+		SteamNetworkingSockets()->CloseConnection( hClient, 0, nullptr, false );
+	}
+
+	SteamNetworkingUtils()->SetGlobalConfigValueFloat( k_ESteamNetworkingConfig_FakePacketLoss_Send, 0 );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_UnreliableFECLanes, 0 );
+
+	// Don't assert that FEC delivered more, it's random and the difference is only
+	// a few standard deviations.  Recovering anything at all (correctly, and without
+	// duplicates) is the real check.
+	TEST_Printf( "FEC delivered %d more messages\n", arDelivered[1] - arDelivered[0] );
+}
+
+// Send unreliable messages on a lossy link, some of them fragmented, and ask
+// for receipts on most of them.  Check that every message gets exactly one
+// receipt, and that anything reported as delivered actually was.
+void Test_unreliable_delivery_receipts()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "Unreliable delivery receipts\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	SteamNetworkingUtils()->SetGlobalConfigValueFloat( k_ESteamNetworkingConfig_FakePacketLoss_Send, 20.0f );
+
+	HSteamNetConnection hServer, hClient;
+	assert( SteamNetworkingSockets()->CreateSocketPair( &hServer, &hClient, true, nullptr, nullptr ) );
+
+	const int nMessages = 300;
+	std::vector<int64> vecMsgNum;
+	std::vector<bool> vecWantReceipt;
+	std::set<int64> setReceived;
+	std::map<int64,bool> mapReceipts;
+	auto Poll = [&]()
+	{
+		TEST_PumpCallbacks();
+		SteamNetworkingMessage_t *pMsg[ 16 ];
+		int n = SteamNetworkingSockets()->ReceiveMessagesOnConnection( hClient, pMsg, 16 );
+		for ( int j = 0 ; j < n ; ++j )
+		{
+			setReceived.insert( pMsg[j]->m_nMessageNumber );
+			pMsg[j]->Release();
+		}
+
+		SteamNetworkingDeliveryReceipt_t arReceipts[ 16 ];
+		n = SteamNetworkingSockets()->ReceiveDeliveryReceiptsOnConnection( hServer, arReceipts, 16 );
+		assert( n >= 0 );
+		for ( int j = 0 ; j < n ; ++j )
+		{
+			assert( arReceipts[j].m_idxLane == 0 );
+			assert( mapReceipts.count( arReceipts[j].m_nMessageNumber ) == 0 ); // Only one receipt per message
+			mapReceipts[ arReceipts[j].m_nMessageNumber ] = arReceipts[j].m_bDelivered;
+		}
+	};
+
+	static uint8 buf[ 3000 ];
+	for ( int i = 0 ; i < nMessages ; ++i )
+	{
+		// Every 10th message is fragmented, and every 4th doesn't want a receipt
+		const int cbMsg = ( i % 10 == 0 ) ? sizeof(buf) : 100;
+		const bool bWantReceipt = ( i % 4 ) != 0;
+		int64 nMsgNum = -1;
+		assert( SteamNetworkingSockets()->SendMessageToConnection( hServer, buf, cbMsg,
+			k_nSteamNetworkingSend_UnreliableNoNagle | ( bWantReceipt ? k_nSteamNetworkingSend_DeliveryReceipt : 0 ), &nMsgNum ) == k_EResultOK );
+		vecMsgNum.push_back( nMsgNum );
+		vecWantReceipt.push_back( bWantReceipt );
+		std::this_thread::sleep_for( std::chrono::milliseconds( 2 ) );
+		Poll();
+	}
+
+	// And one that has already expired, so it will be discarded without being sent
+	SteamNetworkingMessage_t *pExpired = SteamNetworkingUtils()->AllocateMessage( 100 );
+	pExpired->m_conn = hServer;
+	pExpired->m_nFlags = k_nSteamNetworkingSend_Unreliable | k_nSteamNetworkingSend_DeliveryReceipt;
+	const SteamNetworkingMicroseconds usecExpired = SteamNetworkingUtils()->GetLocalTimestamp() - 1000;
+	int64 nExpiredMsgNum = -1;
+	SteamNetworkingSockets()->SendMessagesWithOptions( 1, &pExpired, &usecExpired, nullptr, &nExpiredMsgNum, true );
+	assert( nExpiredMsgNum > 0 );
+
+	// Wait for the stragglers to be acked or timed out
+	SteamNetworkingMicroseconds usecEnd = SteamNetworkingUtils()->GetLocalTimestamp() + 3*1000*1000;
+	while ( SteamNetworkingUtils()->GetLocalTimestamp() < usecEnd )
+	{
+		Poll();
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+	}
+
+	int nDelivered = 0, nLost = 0, nLostButReceived = 0;
+	for ( int i = 0 ; i < nMessages ; ++i )
+	{
+		auto it = mapReceipts.find( vecMsgNum[i] );
+		if ( !vecWantReceipt[i] )
+		{
+			assert( it == mapReceipts.end() );
+			continue;
+		}
+		assert( it != mapReceipts.end() );
+		if ( it->second )
+		{
+			assert( setReceived.count( vecMsgNum[i] ) == 1 );
+			++nDelivered;
+		}
+		else
+		{
+			++nLost;
+			if ( setReceived.count( vecMsgNum[i] ) )
+				++nLostButReceived;
+		}
+	}
+	assert( mapReceipts.count( nExpiredMsgNum ) == 1 && !mapReceipts[ nExpiredMsgNum ] );
+	assert( (int)mapReceipts.size() == nDelivered + nLost + 1 );
+	TEST_Printf( "Receipts: %d delivered, %d lost (%d of those actually arrived), %d received total\n",
+		nDelivered, nLost, nLostButReceived, (int)setReceived.size() );
+	assert( nDelivered > 0 );
+	assert( nLost > 0 );
+
+	SteamNetworkingUtils()->SetGlobalConfigValueFloat( k_ESteamNetworkingConfig_FakePacketLoss_Send, 0 );
+	SteamNetworkingSockets()->CloseConnection( hServer, 0, nullptr, false );
+	SteamNetworkingSockets()->CloseConnection( hClient, 0, nullptr, false );
+}
+
+// Compress some lanes with a shared dictionary, and make sure everything
+// arrives intact, including messages queued before the handshake finished.
+void Test_lane_compression()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "Lane compression\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	// Messages look a lot like the dictionary, which is what you'd hope
+	// for from one trained on real traffic
+	std::string sDict;
+	for ( int i = 0 ; i < 50 ; ++i )
+		sDict += "{\"type\":\"player_update\",\"pos\":[0,0,0],\"health\":100}";
+	auto MakeMessage = []( int i, int cbTarget ) -> std::string
+	{
+		std::string s;
+		while ( (int)s.size() < cbTarget )
+			s += "{\"type\":\"player_update\",\"pos\":[" + std::to_string( i ) + "," + std::to_string( (int)s.size() ) + ",0],\"health\":100}";
+		return s;
+	};
+
+	assert( !SteamNetworkingUtils()->SetCompressionDictionary( 0, sDict.c_str(), (int)sDict.size() ) );
+	assert( SteamNetworkingUtils()->SetCompressionDictionary( 7, sDict.c_str(), (int)sDict.size() ) );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_CompressionLanes, 1 );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_CompressionDictionary, 7 );
+
+	HSteamNetConnection hServer, hClient;
+	assert( SteamNetworkingSockets()->CreateSocketPair( &hServer, &hClient, true, nullptr, nullptr ) );
+	const int priorities[2] = { 0, 0 };
+	const uint16 weights[2] = { 1, 1 };
+	assert( SteamNetworkingSockets()->ConfigureConnectionLanes( hServer, 2, priorities, weights ) == k_EResultOK );
+
+	// Small and large, reliable and unreliable, on both lanes.  Every
+	// 5th unreliable message is too big for one packet
+	std::map< std::pair<int,int64>, std::string > mapSent;
+	const int nMessages = 200;
+	for ( int i = 0 ; i < nMessages ; ++i )
+	{
+		const bool bReliable = ( i & 1 ) != 0;
+		const int cbMsg = ( i % 5 == 0 ) ? 4000 : 60;
+		std::string sMsg = MakeMessage( i, cbMsg );
+		for ( int idxLane = 0 ; idxLane < 2 ; ++idxLane )
+		{
+			SteamNetworkingMessage_t *pMsg = SteamNetworkingUtils()->AllocateMessage( (int)sMsg.size() );
+			memcpy( pMsg->m_pData, sMsg.c_str(), sMsg.size() );
+			pMsg->m_conn = hServer;
+			pMsg->m_idxLane = (uint16)idxLane;
+			pMsg->m_nFlags = bReliable ? k_nSteamNetworkingSend_Reliable : k_nSteamNetworkingSend_Unreliable;
+			int64 nMsgNum = -1;
+			SteamNetworkingSockets()->SendMessages( 1, &pMsg, &nMsgNum, true );
+			assert( nMsgNum > 0 );
+			mapSent[ std::make_pair( idxLane, nMsgNum ) ] = sMsg;
+		}
+	}
+
+	// Everything should arrive, there's no loss
+	int nReceived = 0;
+	SteamNetworkingMicroseconds usecEnd = SteamNetworkingUtils()->GetLocalTimestamp() + 5*1000*1000;
+	while ( nReceived < (int)mapSent.size() )
+	{
+		assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecEnd );
+		TEST_PumpCallbacks();
+		SteamNetworkingMessage_t *pMsg[ 16 ];
+		int n = SteamNetworkingSockets()->ReceiveMessagesOnConnection( hClient, pMsg, 16 );
+		for ( int j = 0 ; j < n ; ++j )
+		{
+			auto it = mapSent.find( std::make_pair( (int)pMsg[j]->m_idxLane, pMsg[j]->m_nMessageNumber ) );
+			assert( it != mapSent.end() );
+			assert( it->second.size() == (size_t)pMsg[j]->m_cbSize && memcmp( it->second.c_str(), pMsg[j]->m_pData, pMsg[j]->m_cbSize ) == 0 );
+			pMsg[j]->Release();
+			++nReceived;
+		}
+	}
+
+	// Only lane 0 was compressed, and it should have helped a lot
+	SteamNetConnectionSNPStatus_t snpStatus;
+	assert( SteamNetworkingSockets()->GetConnectionSNPStatus( &hServer, 1, &snpStatus ) == 1 );
+	TEST_Printf( "Lane 0 compressed %lld -> %lld bytes in %lldus\n", (long long)snpStatus.m_cbLaneCompressedIn[0], (long long)snpStatus.m_cbLaneCompressedOut[0], (long long)snpStatus.m_usecLaneCompressTime[0] );
+	assert( snpStatus.m_cbLaneCompressedIn[0] > 0 );
+	assert( snpStatus.m_cbLaneCompressedOut[0]*4 < snpStatus.m_cbLaneCompressedIn[0] );
+	assert( snpStatus.m_cbLaneCompressedIn[1] == 0 && snpStatus.m_cbLaneCompressedOut[1] == 0 );
+
+	SteamNetworkingSockets()->CloseConnection( hServer, 0, nullptr, false );
+	SteamNetworkingSockets()->CloseConnection( hClient, 0, nullptr, false );
+
+	// Now a real connection, where the client queues messages
+	// before it knows whether the server can decompress them
+	SteamNetworkingUtils()->SetGlobalCallback_SteamNetConnectionStatusChanged( OnSteamNetConnectionStatusChanged );
+	CloseConnections();
+	SteamNetworkingIPAddr bindAddr, connectAddr;
+	bindAddr.Clear(); bindAddr.m_port = k_nStartingServerPort + 14;
+	connectAddr.SetIPv4( 0x7f000001, bindAddr.m_port );
+	g_hSteamListenSocket = SteamNetworkingSockets()->CreateListenSocketIP( bindAddr, 0, nullptr );
+	assert( g_hSteamListenSocket != k_HSteamListenSocket_Invalid );
+	g_peerClient.m_hSteamNetConnection = SteamNetworkingSockets()->ConnectByIPAddress( connectAddr, 0, nullptr );
+	std::vector<std::string> vecQueued;
+	for ( int i = 0 ; i < 10 ; ++i )
+	{
+		vecQueued.push_back( MakeMessage( i, ( i == 3 ) ? 2000 : 80 ) );
+		assert( SteamNetworkingSockets()->SendMessageToConnection( g_peerClient.m_hSteamNetConnection, vecQueued.back().c_str(), (uint32)vecQueued.back().size(), k_nSteamNetworkingSend_Reliable, nullptr ) == k_EResultOK );
+	}
+
+	usecEnd = SteamNetworkingUtils()->GetLocalTimestamp() + 5*1000*1000;
+	for ( const std::string &sExpected: vecQueued )
+	{
+		SteamNetworkingMessage_t *pMsg = nullptr;
+		while ( !g_peerServer.m_bIsConnected || SteamNetworkingSockets()->ReceiveMessagesOnConnection( g_peerServer.m_hSteamNetConnection, &pMsg, 1 ) < 1 )
+		{
+			assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecEnd );
+			TEST_PumpCallbacks();
+		}
+		assert( sExpected.size() == (size_t)pMsg->m_cbSize && memcmp( sExpected.c_str(), pMsg->m_pData, pMsg->m_cbSize ) == 0 );
+		pMsg->Release();
+	}
+	assert( SteamNetworkingSockets()->GetConnectionSNPStatus( &g_peerClient.m_hSteamNetConnection, 1, &snpStatus ) == 1 );
+	assert( snpStatus.m_cbLaneCompressedOut[0] < snpStatus.m_cbLaneCompressedIn[0] );
+	CloseConnections();
+
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_CompressionLanes, 0 );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_CompressionDictionary, 0 );
+	assert( SteamNetworkingUtils()->SetCompressionDictionary( 7, nullptr, 0 ) );
+}
+
+// Ping-pong small reliable messages on a lossy link.  Every message is the
+// tail of a burst, so if it's lost nothing after it will be acked, and we
+// depend on the tail loss probe to retransmit it quickly.  We drop the first
+// transmission of a fixed set of messages, rather than using random loss, so
+// the number of tails that need to be recovered doesn't depend on the dice.
+void Test_reliable_tail_loss()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "Reliable tail loss\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	HSteamNetConnection hServer, hClient;
+	assert( SteamNetworkingSockets()->CreateSocketPair( &hServer, &hClient, true, nullptr, nullptr ) );
+
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_FakePacketLag_Send, 25 );
+
+	// Wait for the lag to show up in the ping estimate
+	std::this_thread::sleep_for( std::chrono::milliseconds( 500 ) );
+	TEST_PumpCallbacks();
+
+	static const char kData[ 64 ] = {};
+	const int nMessages = 100;
+	int nDropped = 0;
+	std::vector<SteamNetworkingMicroseconds> vecLatency;
+	SteamNetworkingMicroseconds usecDeadline = SteamNetworkingUtils()->GetLocalTimestamp() + 30*1000*1000;
+	for ( int i = 0 ; i < nMessages ; ++i )
+	{
+		SteamNetworkingMicroseconds usecStart = SteamNetworkingUtils()->GetLocalTimestamp();
+
+		// Drop every 10th message.  Fake loss is applied when the packet
+		// is handed to the socket, so once the message is no longer pending
+		// its first transmission is gone, and we can turn loss back off.
+		const bool bDrop = ( i % 10 ) == 5;
+		if ( bDrop )
+			SteamNetworkingUtils()->SetGlobalConfigValueFloat( k_ESteamNetworkingConfig_FakePacketLoss_Send, 100 );
+		SteamNetworkingSockets()->SendMessageToConnection( hServer, kData, sizeof(kData), k_nSteamNetworkingSend_Reliable, nullptr );
+		if ( bDrop )
+		{
+			for (;;)
+			{
+				SteamNetConnectionRealTimeStatus_t status;
+				assert( SteamNetworkingSockets()->GetConnectionRealTimeStatus( hServer, &status, 0, nullptr ) == k_EResultOK );
+				if ( status.m_cbPendingReliable == 0 )
+					break;
+				assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecDeadline );
+				std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+			}
+			SteamNetworkingUtils()->SetGlobalConfigValueFloat( k_ESteamNetworkingConfig_FakePacketLoss_Send, 0 );
+			++nDropped;
+		}
+
+		// Client echoes it back, server waits for the echo
+		bool bEchoed = false;
+		for (;;)
+		{
+			assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecDeadline );
+			TEST_PumpCallbacks();
+			SteamNetworkingMessage_t *pMsg = nullptr;
+			if ( !bEchoed && SteamNetworkingSockets()->ReceiveMessagesOnConnection( hClient, &pMsg, 1 ) == 1 )
+			{
+				SteamNetworkingSockets()->SendMessageToConnection( hClient, pMsg->m_pData, pMsg->m_cbSize, k_nSteamNetworkingSend_Reliable, nullptr );
+				pMsg->Release();
+				bEchoed = true;
+			}
+			if ( SteamNetworkingSockets()->ReceiveMessagesOnConnection( hServer, &pMsg, 1 ) == 1 )
+			{
+				assert( bEchoed );
+				pMsg->Release();
+				break;
+			}
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+		}
+		vecLatency.push_back( SteamNetworkingUtils()->GetLocalTimestamp() - usecStart );
+	}
+
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_FakePacketLag_Send, 0 );
+
+	std::sort( vecLatency.begin(), vecLatency.end() );
+	const HSteamNetConnection arConn[2] = { hServer, hClient };
+	SteamNetConnectionSNPStatus_t arStatus[2];
+	assert( SteamNetworkingSockets()->GetConnectionSNPStatus( arConn, 2, arStatus ) == 2 );
+	int64 nTailLossProbes = 0;
+	for ( const SteamNetConnectionSNPStatus_t &s: arStatus )
+	{
+		TEST_Printf( "ping=%dms lost: nack=%lld rack=%lld timeout=%lld  tail loss probes=%lld\n",
+			s.m_nSmoothedPingMS, (long long)s.m_nPacketsLostNack, (long long)s.m_nPacketsLostRACK,
+			(long long)s.m_nPacketsLostTimeout, (long long)s.m_nTailLossProbes );
+		nTailLossProbes += s.m_nTailLossProbes;
+	}
+	TEST_Printf( "dropped=%d  round trip p50=%.1fms p99=%.1fms max=%.1fms\n",
+		nDropped, vecLatency[ nMessages/2 ]*1e-3, vecLatency[ nMessages*99/100 ]*1e-3, vecLatency.back()*1e-3 );
+
+	// Each dropped message was the only thing the server had in flight,
+	// so nothing later could be acked to reveal the loss.  We must have
+	// probed, rather than waiting for the timeout every time.
+	assert( nDropped == nMessages/10 );
+	assert( nTailLossProbes > 0 );
+
+	SteamNetworkingSockets()->CloseConnection( hServer, 0, nullptr, false );
+	SteamNetworkingSockets()->CloseConnection( hClient, 0, nullptr, false );
+}
+
+void Test_ack_frequency()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "Ack frequency\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	// Long RTT, and a fixed rate so we know how much data we'll be sending
+	const int k_nSendRate = 2*1024*1024;
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_SendRateMin, k_nSendRate );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_SendRateMax, k_nSendRate );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_SendBufferSize, 8*1024*1024 );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_FakePacketLag_Send, 200 );
+
+	HSteamNetConnection hServer, hClient;
+	assert( SteamNetworkingSockets()->CreateSocketPair( &hServer, &hClient, true, nullptr, nullptr ) );
+
+	// Wait for the lag to show up in the ping estimate
+	std::this_thread::sleep_for( std::chrono::milliseconds( 1500 ) );
+	TEST_PumpCallbacks();
+
+	const HSteamNetConnection arConn[2] = { hServer, hClient };
+	SteamNetConnectionSNPStatus_t arBefore[2], arAfter[2];
+	assert( SteamNetworkingSockets()->GetConnectionSNPStatus( arConn, 2, arBefore ) == 2 );
+
+	// Bulk transfer in one direction
+	const SteamNetworkingMicroseconds usecStart = SteamNetworkingUtils()->GetLocalTimestamp();
+	const int cbMsg = 1100;
+	const int nMessages = 3000;
+	std::vector<uint8> msg( cbMsg );
+	for ( int i = 0 ; i < nMessages ; ++i )
+	{
+		memcpy( msg.data(), &i, sizeof(i) );
+		assert( SteamNetworkingSockets()->SendMessageToConnection( hServer, msg.data(), cbMsg, k_nSteamNetworkingSend_Reliable, nullptr ) == k_EResultOK );
+	}
+
+	int nReceived = 0;
+	SteamNetworkingMicroseconds usecDeadline = SteamNetworkingUtils()->GetLocalTimestamp() + 10*1000*1000;
+	while ( nReceived < nMessages )
+	{
+		assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecDeadline );
+		TEST_PumpCallbacks();
+		SteamNetworkingMessage_t *arMsg[ 64 ];
+		int n = SteamNetworkingSockets()->ReceiveMessagesOnConnection( hClient, arMsg, 64 );
+		for ( int i = 0 ; i < n ; ++i )
+		{
+			assert( arMsg[i]->m_cbSize == cbMsg );
+			assert( memcmp( arMsg[i]->m_pData, &nReceived, sizeof(nReceived) ) == 0 );
+			++nReceived;
+			arMsg[i]->Release();
+		}
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+	}
+	assert( SteamNetworkingSockets()->GetConnectionSNPStatus( arConn, 2, arAfter ) == 2 );
+	const float flElapsed = ( SteamNetworkingUtils()->GetLocalTimestamp() - usecStart ) * 1e-6f;
+
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_FakePacketLag_Send, 0 );
+	for ( ESteamNetworkingConfigValue eValue: { k_ESteamNetworkingConfig_SendRateMin, k_ESteamNetworkingConfig_SendRateMax, k_ESteamNetworkingConfig_SendBufferSize } )
+		SteamNetworkingUtils()->SetConfigValue( eValue, k_ESteamNetworkingConfig_Global, 0, k_ESteamNetworkingConfig_Int32, nullptr );
+
+	const int64 nDataSegments = arAfter[0].m_nReliableSegmentsSent - arBefore[0].m_nReliableSegmentsSent;
+	const int64 nAckOnly = arAfter[1].m_nAckOnlyPacketsSent - arBefore[1].m_nAckOnlyPacketsSent;
+	TEST_Printf( "ping=%dms  receiver max ack delay=%.1fms threshold=%d  data segments=%lld ack-only packets=%lld (%.1f/sec)\n",
+		arAfter[1].m_nSmoothedPingMS, arAfter[1].m_usecAckMaxDelay*1e-3, arAfter[1].m_nAckThreshold,
+		(long long)nDataSegments, (long long)nAckOnly, nAckOnly / flElapsed );
+
+	// The sender should have asked for about RTT/4, and a threshold high
+	// enough that it doesn't kick in at a steady rate.
+	assert( arAfter[1].m_usecAckMaxDelay >= 80*1000 );
+	assert( arAfter[1].m_nAckThreshold >= k_nSendRate/1200/10 );
+
+	// Every ack-only packet was either due to the delay timer, which can't
+	// fire more often than the max delay, or to reaching the threshold.
+	// This holds however long the transfer took.  Allow a few extra for
+	// stats, keepalives, and any gap the kernel might have introduced.
+	const SteamNetworkingMicroseconds usecAckMaxDelay = std::min( arBefore[1].m_usecAckMaxDelay, arAfter[1].m_usecAckMaxDelay );
+	const int64 nAckOnlyMax = (int64)( flElapsed*1e6f / usecAckMaxDelay ) + nDataSegments / arAfter[1].m_nAckThreshold + 10;
+	TEST_Printf( "ack-only limit=%lld\n", (long long)nAckOnlyMax );
+	assert( nAckOnly <= nAckOnlyMax );
+
+	SteamNetworkingSockets()->CloseConnection( hServer, 0, nullptr, false );
+	SteamNetworkingSockets()->CloseConnection( hClient, 0, nullptr, false );
+}
+
+// A lane with a latency target should cut in front of bulk data, even
+// if the bulk data is in a higher priority class
+void Test_lane_deadlines()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "Lane deadlines\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	HSteamNetConnection hServer, hClient;
+	assert( SteamNetworkingSockets()->CreateSocketPair( &hServer, &hClient, true, nullptr, nullptr ) );
+
+	const int k_nSendRate = 256*1024;
+	SteamNetworkingUtils()->SetConnectionConfigValueInt32( hServer, k_ESteamNetworkingConfig_SendRateMin, k_nSendRate );
+	SteamNetworkingUtils()->SetConnectionConfigValueInt32( hServer, k_ESteamNetworkingConfig_SendRateMax, k_nSendRate );
+	SteamNetworkingUtils()->SetConnectionConfigValueInt32( hServer, k_ESteamNetworkingConfig_SendBufferSize, 2*1024*1024 );
+
+	// Lane 0 is bulk data, and has strict priority over lane 1.
+	// But lane 1 has a latency target.
+	constexpr int k_nLanes = 2;
+	int priorities[k_nLanes] = { 0, 1 };
+	assert( SteamNetworkingSockets()->ConfigureConnectionLanes( hServer, k_nLanes, priorities, nullptr ) == k_EResultOK );
+	int badLaneCount[3] = { 0, 20, 0 };
+	assert( SteamNetworkingSockets()->ConfigureConnectionLaneDeadlines( hServer, 3, badLaneCount ) == k_EResultInvalidParam );
+	int badTarget[k_nLanes] = { 0, -1 };
+	assert( SteamNetworkingSockets()->ConfigureConnectionLaneDeadlines( hServer, k_nLanes, badTarget ) == k_EResultInvalidParam );
+	int targets[k_nLanes] = { 0, 20 };
+	assert( SteamNetworkingSockets()->ConfigureConnectionLaneDeadlines( hServer, k_nLanes, targets ) == k_EResultOK );
+
+	// Queue about 4 seconds worth of bulk data
+	const int cbBulkMsg = 16*1024;
+	const int nBulkMessages = 64;
+	std::vector<uint8> bulk( cbBulkMsg );
+	for ( int i = 0 ; i < nBulkMessages ; ++i )
+		assert( SteamNetworkingSockets()->SendMessageToConnection( hServer, bulk.data(), cbBulkMsg, k_nSteamNetworkingSend_Reliable, nullptr ) == k_EResultOK );
+
+	// Send a small, timestamped message on lane 1 every 10ms for a second
+	const SteamNetworkingMicroseconds usecStart = SteamNetworkingUtils()->GetLocalTimestamp();
+	SteamNetworkingMicroseconds usecNextSend = usecStart;
+	const int nUrgentMessages = 100;
+	int nUrgentSent = 0, nUrgentRecv = 0, nBulkRecv = 0;
+	SteamNetworkingMicroseconds usecMaxLatency = 0;
+	while ( nUrgentRecv < nUrgentMessages )
+	{
+		SteamNetworkingMicroseconds usecNow = SteamNetworkingUtils()->GetLocalTimestamp();
+		assert( usecNow < usecStart + 10*1000*1000 );
+		if ( nUrgentSent < nUrgentMessages && usecNow >= usecNextSend )
+		{
+			SteamNetworkingMessage_t *pMsg = SteamNetworkingUtils()->AllocateMessage( 200 );
+			pMsg->m_conn = hServer;
+			pMsg->m_nFlags = k_nSteamNetworkingSend_Reliable;
+			pMsg->m_idxLane = 1;
+			memcpy( pMsg->m_pData, &usecNow, sizeof(usecNow) );
+			int64 nMsgNumOrResult;
+			SteamNetworkingSockets()->SendMessages( 1, &pMsg, &nMsgNumOrResult, true );
+			assert( nMsgNumOrResult > 0 );
+			++nUrgentSent;
+			usecNextSend += 10*1000;
+		}
+
+		TEST_PumpCallbacks();
+		SteamNetworkingMessage_t *arMsg[ 16 ];
+		int n = SteamNetworkingSockets()->ReceiveMessagesOnConnection( hClient, arMsg, 16 );
+		for ( int i = 0 ; i < n ; ++i )
+		{
+			if ( arMsg[i]->m_idxLane == 1 )
+			{
+				SteamNetworkingMicroseconds usecSent;
+				memcpy( &usecSent, arMsg[i]->m_pData, sizeof(usecSent) );
+				usecMaxLatency = std::max( usecMaxLatency, SteamNetworkingUtils()->GetLocalTimestamp() - usecSent );
+				++nUrgentRecv;
+			}
+			else
+			{
+				++nBulkRecv;
+			}
+			arMsg[i]->Release();
+		}
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+	}
+
+	SteamNetConnectionSNPStatus_t snpStatus;
+	assert( SteamNetworkingSockets()->GetConnectionSNPStatus( &hServer, 1, &snpStatus ) == 1 );
+	TEST_Printf( "Urgent max latency %.1fms, %lld/%lld missed deadline.  Bulk messages received %d\n",
+		usecMaxLatency*1e-3, (long long)snpStatus.m_nLaneDeadlineMisses[1], (long long)snpStatus.m_nLaneDeadlineMessages[1], nBulkRecv );
+
+	// Strict priority would have made lane 1 wait for all the
+	// bulk data.  With the deadline, it should have cut in front.
+	assert( snpStatus.m_nLaneDeadlineMessages[1] == nUrgentMessages );
+	assert( snpStatus.m_nLaneDeadlineMisses[1]*10 <= nUrgentMessages );
+	assert( usecMaxLatency < 250*1000 );
+	assert( nBulkRecv < nBulkMessages );
+
+	SteamNetworkingSockets()->CloseConnection( hServer, 0, nullptr, false );
+	SteamNetworkingSockets()->CloseConnection( hClient, 0, nullptr, false );
+}
+
+// Small unreliable messages at a fixed tick rate, such as player input,
+// with and without the compact encoding.  Prints how much we save per packet.
+void Test_compact_encoding()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "Compact encoding\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	// A bit of loss, so that acks need some blocks
+	SteamNetworkingUtils()->SetGlobalConfigValueFloat( k_ESteamNetworkingConfig_FakePacketLoss_Send, 2.0f );
+
+	HSteamNetConnection hServer, hClient;
+	assert( SteamNetworkingSockets()->CreateSocketPair( &hServer, &hClient, true, nullptr, nullptr ) );
+
+	// Server sends on lane 1, so we exercise the implicit lane select
+	int priorities[2] = { 0, 0 };
+	assert( SteamNetworkingSockets()->ConfigureConnectionLanes( hServer, 2, priorities, nullptr ) == k_EResultOK );
+
+	const HSteamNetConnection arConn[2] = { hServer, hClient };
+	const int arLane[2] = { 1, 0 };
+	const int cbMsg = 80;
+	const int nTicks = 120;
+	int arNextSend[2] = { 0, 0 };
+
+	// Send at 60Hz in both directions, and return average SNP payload size per packet
+	auto RunTicks = [&]( float arBytesPerPacket[2] )
+	{
+		SteamNetConnectionSNPStatus_t arBefore[2], arAfter[2];
+		assert( SteamNetworkingSockets()->GetConnectionSNPStatus( arConn, 2, arBefore ) == 2 );
+
+		int arRecv[2] = { 0, 0 };
+		int arLastRecv[2] = { arNextSend[0]-1, arNextSend[1]-1 };
+		for ( int nTick = 0 ; nTick < nTicks ; ++nTick )
+		{
+			for ( int i = 0 ; i < 2 ; ++i )
+			{
+				SteamNetworkingMessage_t *pMsg = SteamNetworkingUtils()->AllocateMessage( cbMsg );
+				pMsg->m_conn = arConn[i];
+				pMsg->m_nFlags = k_nSteamNetworkingSend_UnreliableNoNagle;
+				pMsg->m_idxLane = arLane[i];
+				memset( pMsg->m_pData, nTick, cbMsg );
+				memcpy( pMsg->m_pData, &arNextSend[i], sizeof(int) );
+				int64 nMsgNumOrResult;
+				SteamNetworkingSockets()->SendMessages( 1, &pMsg, &nMsgNumOrResult, true );
+				assert( nMsgNumOrResult > 0 );
+				++arNextSend[i];
+			}
+
+			std::this_thread::sleep_for( std::chrono::microseconds( 16667 ) );
+			TEST_PumpCallbacks();
+
+			// Receive on the opposite connection, check that messages
+			// are intact and in order
+			for ( int i = 0 ; i < 2 ; ++i )
+			{
+				SteamNetworkingMessage_t *arMsg[ 16 ];
+				int n = SteamNetworkingSockets()->ReceiveMessagesOnConnection( arConn[1-i], arMsg, 16 );
+				for ( int j = 0 ; j < n ; ++j )
+				{
+					assert( arMsg[j]->m_cbSize == cbMsg );
+					assert( arMsg[j]->m_idxLane == arLane[i] );
+					int nSeq;
+					memcpy( &nSeq, arMsg[j]->m_pData, sizeof(nSeq) );
+					assert( nSeq > arLastRecv[i] );
+					arLastRecv[i] = nSeq;
+					++arRecv[i];
+					arMsg[j]->Release();
+				}
+			}
+		}
+
+		assert( SteamNetworkingSockets()->GetConnectionSNPStatus( arConn, 2, arAfter ) == 2 );
+		for ( int i = 0 ; i < 2 ; ++i )
+		{
+			// Allow for the fake loss, and a message or two still in flight
+			assert( arRecv[i] > nTicks*9/10 );
+			int64 nPackets = arAfter[i].m_nDataPacketsSent - arBefore[i].m_nDataPacketsSent;
+			int64 cbPayload = arAfter[i].m_cbDataPayloadSent - arBefore[i].m_cbDataPayloadSent;
+			assert( nPackets > 0 );
+			arBytesPerPacket[i] = (float)cbPayload / (float)nPackets;
+		}
+	};
+
+	// Let the connection settle, so ping and acks are in a steady state
+	std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+	TEST_PumpCallbacks();
+
+	float arRegular[2], arCompact[2];
+	RunTicks( arRegular );
+	for ( HSteamNetConnection hConn: arConn )
+		SteamNetworkingUtils()->SetConnectionConfigValueInt32( hConn, k_ESteamNetworkingConfig_CompactEncoding, 1 );
+	RunTicks( arCompact );
+
+	SteamNetworkingUtils()->SetGlobalConfigValueFloat( k_ESteamNetworkingConfig_FakePacketLoss_Send, 0.0f );
+
+	TEST_Printf( "Payload bytes per packet, %d byte messages at 60Hz:\n", cbMsg );
+	for ( int i = 0 ; i < 2 ; ++i )
+	{
+		TEST_Printf( "  %s (lane %d): regular %.2f  compact %.2f  saved %.2f\n",
+			i == 0 ? "server" : "client", arLane[i], arRegular[i], arCompact[i], arRegular[i] - arCompact[i] );
+
+		// A regular unreliable segment header with a 32-bit message number is 5 bytes
+		// (plus a lane select on lane 1), vs 2 bytes for the compact frame.
+		// Acks are a byte smaller, too.
+		assert( arRegular[i] - arCompact[i] >= 2.5f );
+	}
+
+	SteamNetworkingSockets()->CloseConnection( hServer, 0, nullptr, false );
+	SteamNetworkingSockets()->CloseConnection( hClient, 0, nullptr, false );
+}
+
+// Make sure the periodic connection quality stats make it across
+// inline with data packets
+void Test_inline_stats()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "Inline stats\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	HSteamNetConnection hServer, hClient;
+	assert( SteamNetworkingSockets()->CreateSocketPair( &hServer, &hClient, true, nullptr, nullptr ) );
+	const HSteamNetConnection arConn[2] = { hServer, hClient };
+
+	// Instantaneous stats are sent about every 20 seconds, when
+	// there's room in a data packet.  Keep some traffic flowing
+	// until both sides have heard from the other.
+	SteamNetworkingMicroseconds usecStart = SteamNetworkingUtils()->GetLocalTimestamp();
+	SteamNetConnectionRealTimeStatus_t arStatus[2];
+	for (;;)
+	{
+		for ( HSteamNetConnection hConn: arConn )
+		{
+			char buf[ 100 ] = {};
+			assert( SteamNetworkingSockets()->SendMessageToConnection( hConn, buf, sizeof(buf), k_nSteamNetworkingSend_Unreliable, nullptr ) == k_EResultOK );
+		}
+
+		std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+		TEST_PumpCallbacks();
+		for ( HSteamNetConnection hConn: arConn )
+		{
+			SteamNetworkingMessage_t *arMsg[ 16 ];
+			int n = SteamNetworkingSockets()->ReceiveMessagesOnConnection( hConn, arMsg, 16 );
+			for ( int i = 0 ; i < n ; ++i )
+				arMsg[i]->Release();
+		}
+
+		for ( int i = 0 ; i < 2 ; ++i )
+			assert( SteamNetworkingSockets()->GetConnectionRealTimeStatus( arConn[i], &arStatus[i], 0, nullptr ) == k_EResultOK );
+		if ( arStatus[0].m_flConnectionQualityRemote >= 0.0f && arStatus[1].m_flConnectionQualityRemote >= 0.0f )
+			break;
+
+		assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecStart + 40*1000000 );
+	}
+
+	TEST_Printf( "Remote quality received after %.1fs: server %.3f  client %.3f\n",
+		( SteamNetworkingUtils()->GetLocalTimestamp() - usecStart ) * 1e-6,
+		arStatus[0].m_flConnectionQualityRemote, arStatus[1].m_flConnectionQualityRemote );
+
+	// Loopback, no loss
+	for ( int i = 0 ; i < 2 ; ++i )
+		assert( arStatus[i].m_flConnectionQualityRemote > .95f );
+
+	SteamNetworkingSockets()->CloseConnection( hServer, 0, nullptr, false );
+	SteamNetworkingSockets()->CloseConnection( hClient, 0, nullptr, false );
+}
+
+#ifndef _WIN32
+// Wait for a wake handle to be signaled, and reset it.  Callers drain the
+// queue after this returns, never before, so a message that arrives while
+// we are draining will signal the handle again.
+static bool WaitForWakeHandle( SteamNetworkingWakeHandle h, int nTimeoutMS )
+{
+	pollfd pfd = {};
+	pfd.fd = (int)h;
+	pfd.events = POLLIN;
+	if ( poll( &pfd, 1, nTimeoutMS ) <= 0 )
+		return false;
+	char buf[ 64 ];
+	while ( read( (int)h, buf, sizeof(buf) ) > 0 ) {}
+	return true;
+}
+#endif
+
+void Test_wake_handles()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "Wake handles\n" );
+	TEST_Printf( "***************************************************\n" );
+
+#ifdef _WIN32
+	TEST_Printf( "Skipping, test uses poll()\n" );
+#else
+	SteamNetworkingUtils()->SetGlobalCallback_SteamNetConnectionStatusChanged( OnSteamNetConnectionStatusChanged );
+
+	HSteamNetConnection hServer, hClient;
+	assert( SteamNetworkingSockets()->CreateSocketPair( &hServer, &hClient, true, nullptr, nullptr ) );
+	HSteamNetPollGroup hPollGroup = SteamNetworkingSockets()->CreatePollGroup();
+	assert( SteamNetworkingSockets()->SetConnectionPollGroup( hServer, hPollGroup ) );
+	for ( int i = 0 ; i < 10 ; ++i )
+		TEST_PumpCallbacks();
+
+	SteamNetworkingWakeHandle hWakePollGroup = SteamNetworkingSockets()->GetPollGroupWakeHandle( hPollGroup );
+	SteamNetworkingWakeHandle hWakeConn = SteamNetworkingSockets()->GetConnectionWakeHandle( hServer );
+	SteamNetworkingWakeHandle hWakeCallbacks = SteamNetworkingSockets()->GetCallbacksWakeHandle();
+	assert( hWakePollGroup != k_SteamNetworkingWakeHandle_Invalid );
+	assert( hWakeConn != k_SteamNetworkingWakeHandle_Invalid );
+	assert( hWakeCallbacks != k_SteamNetworkingWakeHandle_Invalid );
+	assert( SteamNetworkingSockets()->GetPollGroupWakeHandle( hPollGroup ) == hWakePollGroup );
+	assert( SteamNetworkingSockets()->GetPollGroupWakeHandle( k_HSteamNetPollGroup_Invalid ) == k_SteamNetworkingWakeHandle_Invalid );
+
+	// Nothing queued yet
+	assert( !WaitForWakeHandle( hWakePollGroup, 0 ) );
+	assert( !WaitForWakeHandle( hWakeConn, 0 ) );
+
+	// Send a few messages.  We should wake up, but only once
+	const int k_nMessages = 5;
+	for ( int i = 0 ; i < k_nMessages ; ++i )
+		assert( SteamNetworkingSockets()->SendMessageToConnection( hClient, &i, sizeof(i), k_nSteamNetworkingSend_Reliable, nullptr ) == k_EResultOK );
+	SteamNetworkingMicroseconds usecStart = SteamNetworkingUtils()->GetLocalTimestamp();
+	assert( WaitForWakeHandle( hWakePollGroup, 5000 ) );
+	TEST_Printf( "Woke up after %lldusec\n", (long long)( SteamNetworkingUtils()->GetLocalTimestamp() - usecStart ) );
+	assert( WaitForWakeHandle( hWakeConn, 0 ) );
+
+	// Drain the queue
+	int nReceived = 0;
+	while ( nReceived < k_nMessages )
+	{
+		SteamNetworkingMessage_t *arMsg[ 16 ];
+		int n = SteamNetworkingSockets()->ReceiveMessagesOnPollGroup( hPollGroup, arMsg, 16 );
+		for ( int i = 0 ; i < n ; ++i )
+		{
+			assert( *(const int *)arMsg[i]->m_pData == nReceived );
+			++nReceived;
+			arMsg[i]->Release();
+		}
+		if ( n == 0 )
+		{
+			assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecStart + 5*1000000 );
+			std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+		}
+	}
+
+	// Everything arrived before we emptied the queue, so there should
+	// not be another wakeup pending
+	std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+	assert( !WaitForWakeHandle( hWakePollGroup, 0 ) );
+
+	// Make sure we wake up again once the queue is empty
+	int nMsg = k_nMessages;
+	assert( SteamNetworkingSockets()->SendMessageToConnection( hClient, &nMsg, sizeof(nMsg), k_nSteamNetworkingSend_Reliable, nullptr ) == k_EResultOK );
+	assert( WaitForWakeHandle( hWakePollGroup, 5000 ) );
+
+	// Closing the client should queue a status change callback on the server.
+	// Reset the handle before dispatching whatever is already pending.
+	WaitForWakeHandle( hWakeCallbacks, 0 );
+	TEST_PumpCallbacks();
+	SteamNetworkingSockets()->CloseConnection( hClient, 0, nullptr, false );
+	assert( WaitForWakeHandle( hWakeCallbacks, 5000 ) );
+	TEST_PumpCallbacks();
+
+	SteamNetworkingSockets()->DestroyPollGroup( hPollGroup );
+	SteamNetworkingSockets()->CloseConnection( hServer, 0, nullptr, false );
+#endif
+}
+
+// Same as the cursory connection test, but with the crypto handshake
+// on the incoming connection done on worker threads
+void Test_handshake_worker_threads()
+{
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_HandshakeWorkerThreads, 2 );
+
+	SteamNetworkingIPAddr bindAddr, connectAddr;
+	bindAddr.Clear(); bindAddr.m_port = k_nStartingServerPort + 10;
+	connectAddr.SetIPv4( 0x7f000001, bindAddr.m_port );
+	Test_Connection( ETestConnectionMode::Cursory, bindAddr, connectAddr );
+
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_HandshakeWorkerThreads, 0 );
+}
+
+// Connect to the same server twice.  The second time, the client presents the
+// ticket it got the first time, and the session is resumed without the full
+// handshake.  Make sure that both ends derived the same keys.
+void Test_session_resumption()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "Session resumption\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	SteamNetworkingUtils()->SetGlobalCallback_SteamNetConnectionStatusChanged( OnSteamNetConnectionStatusChanged );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_IP_SessionResumption, 60 );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_PerfMetrics, 1 );
+
+	CloseConnections();
+
+	SteamNetworkingIPAddr bindAddr, connectAddr;
+	bindAddr.Clear(); bindAddr.m_port = k_nStartingServerPort + 11;
+	connectAddr.SetIPv4( 0x7f000001, bindAddr.m_port );
+	g_hSteamListenSocket = SteamNetworkingSockets()->CreateListenSocketIP( bindAddr, 0, nullptr );
+	assert( g_hSteamListenSocket != k_HSteamListenSocket_Invalid );
+
+	SteamNetworkingPerfMetrics_t metrics;
+	assert( SteamNetworkingUtils()->GetPerfMetrics( &metrics ) );
+	int64 arSessionsResumed[3] = { metrics.m_nSessionsResumed };
+	for ( int i = 0 ; i < 2 ; ++i )
+	{
+		SteamNetworkingMicroseconds usecStart = SteamNetworkingUtils()->GetLocalTimestamp();
+		g_peerClient.m_hSteamNetConnection = SteamNetworkingSockets()->ConnectByIPAddress( connectAddr, 0, nullptr );
+		while ( !g_peerClient.m_bIsConnected || !g_peerServer.m_bIsConnected )
+		{
+			assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecStart + 5*1000*1000 );
+			TEST_PumpCallbacks();
+		}
+		TEST_Printf( "Connection %d established in %.1fms\n", i+1, ( SteamNetworkingUtils()->GetLocalTimestamp() - usecStart )*1e-3 );
+
+		// Send something both ways, so we know the keys match
+		for ( SFakePeer *p: { &g_peerClient, &g_peerServer } )
+		{
+			SFakePeer *pOther = ( p == &g_peerClient ) ? &g_peerServer : &g_peerClient;
+			assert( SteamNetworkingSockets()->SendMessageToConnection( p->m_hSteamNetConnection, "hello", 6, k_nSteamNetworkingSend_Reliable, nullptr ) == k_EResultOK );
+			SteamNetworkingMessage_t *pMsg = nullptr;
+			while ( SteamNetworkingSockets()->ReceiveMessagesOnConnection( pOther->m_hSteamNetConnection, &pMsg, 1 ) < 1 )
+			{
+				assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecStart + 5*1000*1000 );
+				TEST_PumpCallbacks();
+			}
+			assert( pMsg->GetSize() == 6 && strcmp( (const char *)pMsg->GetData(), "hello" ) == 0 );
+			pMsg->Release();
+		}
+
+		assert( SteamNetworkingUtils()->GetPerfMetrics( &metrics ) );
+		arSessionsResumed[i+1] = metrics.m_nSessionsResumed;
+
+		g_peerClient.Close();
+		g_peerServer.Close();
+	}
+
+	// First connection did the full handshake, the second was resumed on both ends
+	assert( arSessionsResumed[1] == arSessionsResumed[0] );
+	assert( arSessionsResumed[2] == arSessionsResumed[1] + 2 );
+
+	CloseConnections();
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_PerfMetrics, 0 );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_IP_SessionResumption, 0 );
+}
+
+// Make sure both encrypted ciphers work end-to-end, and that a peer that
+// prefers ChaCha20-Poly1305 gets it even if the other end prefers AES.
+void Test_cipher_chacha20()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "ChaCha20-Poly1305 cipher\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	SteamNetworkingUtils()->SetGlobalCallback_SteamNetConnectionStatusChanged( OnSteamNetConnectionStatusChanged );
+
+	CloseConnections();
+
+	struct CipherTestCase
+	{
+		int m_nPrefServer;
+		int m_nPrefClient;
+		const char *m_pszExpectedCipher;
+	};
+	const CipherTestCase k_arTestCases[] = {
+		{ 1, 1, "AES-256-GCM" },
+		{ 2, 2, "ChaCha20-Poly1305" },
+		{ 1, 2, "ChaCha20-Poly1305" },
+		{ 2, 1, "ChaCha20-Poly1305" },
+	};
+	uint16 nServerPort = k_nStartingServerPort + 13;
+	for ( const CipherTestCase &t: k_arTestCases )
+	{
+		SteamNetworkingIPAddr bindAddr, connectAddr;
+		bindAddr.Clear(); bindAddr.m_port = nServerPort++;
+		connectAddr.SetIPv4( 0x7f000001, bindAddr.m_port );
+
+		SteamNetworkingConfigValue_t optServer, optClient;
+		optServer.SetInt32( k_ESteamNetworkingConfig_CipherPreference, t.m_nPrefServer );
+		optClient.SetInt32( k_ESteamNetworkingConfig_CipherPreference, t.m_nPrefClient );
+		g_hSteamListenSocket = SteamNetworkingSockets()->CreateListenSocketIP( bindAddr, 1, &optServer );
+		assert( g_hSteamListenSocket != k_HSteamListenSocket_Invalid );
+
+		SteamNetworkingMicroseconds usecStart = SteamNetworkingUtils()->GetLocalTimestamp();
+		g_peerClient.m_hSteamNetConnection = SteamNetworkingSockets()->ConnectByIPAddress( connectAddr, 1, &optClient );
+		while ( !g_peerClient.m_bIsConnected || !g_peerServer.m_bIsConnected )
+		{
+			assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecStart + 5*1000*1000 );
+			TEST_PumpCallbacks();
+		}
+
+		for ( SFakePeer *p: { &g_peerClient, &g_peerServer } )
+		{
+			char szStatus[ 4096 ];
+			assert( SteamNetworkingSockets()->GetDetailedConnectionStatus( p->m_hSteamNetConnection, szStatus, sizeof(szStatus) ) >= 0 );
+			char szExpected[ 64 ];
+			snprintf( szExpected, sizeof(szExpected), "Cipher: %s\n", t.m_pszExpectedCipher );
+			assert( strstr( szStatus, szExpected ) != nullptr );
+
+			// Send something, so we know the keys match
+			SFakePeer *pOther = ( p == &g_peerClient ) ? &g_peerServer : &g_peerClient;
+			assert( SteamNetworkingSockets()->SendMessageToConnection( p->m_hSteamNetConnection, "hello", 6, k_nSteamNetworkingSend_Reliable, nullptr ) == k_EResultOK );
+			SteamNetworkingMessage_t *pMsg = nullptr;
+			while ( SteamNetworkingSockets()->ReceiveMessagesOnConnection( pOther->m_hSteamNetConnection, &pMsg, 1 ) < 1 )
+			{
+				assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecStart + 5*1000*1000 );
+				TEST_PumpCallbacks();
+			}
+			assert( pMsg->GetSize() == 6 && strcmp( (const char *)pMsg->GetData(), "hello" ) == 0 );
+			pMsg->Release();
+		}
+		TEST_Printf( "Server pref %d, client pref %d: %s OK\n", t.m_nPrefServer, t.m_nPrefClient, t.m_pszExpectedCipher );
+
+		CloseConnections();
+	}
+}
+
+// Test hooks for the local address table.  (We don't include the internal
+// headers.)
+namespace SteamNetworkingSocketsLib {
+	extern void TEST_ApplyLocalAddressChange( const SteamNetworkingIPAddr &addr, int nPrefixLen, bool bAdded );
+	extern uint32 TEST_GetLocalAddressesVersion( bool bInvalidate, const SteamNetworkingIPAddr *pAddr, int nPrefixLen, bool *pbFound );
+}
+
+// Make sure the local address table version only changes when the set of
+// addresses actually changes.  ICE sessions rely on this to decide when to
+// re-gather interfaces.
+void Test_local_address_table()
+{
+	using namespace SteamNetworkingSocketsLib;
+
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "Local address table\n" );
+	TEST_Printf( "***************************************************\n" );
+
+	uint32 nVersion1 = TEST_GetLocalAddressesVersion( false, nullptr, 0, nullptr );
+	assert( nVersion1 != 0 );
+	assert( TEST_GetLocalAddressesVersion( false, nullptr, 0, nullptr ) == nVersion1 );
+
+	// Enumerating again from scratch finds the same thing
+	assert( TEST_GetLocalAddressesVersion( true, nullptr, 0, nullptr ) == nVersion1 );
+
+	// New address.  (TEST-NET-1, so it can't be real)
+	SteamNetworkingIPAddr addr;
+	addr.SetIPv4( 0xc0000237, 0 );
+	bool bFound = false;
+	TEST_ApplyLocalAddressChange( addr, 24, true );
+	uint32 nVersion2 = TEST_GetLocalAddressesVersion( false, &addr, 24, &bFound );
+	assert( nVersion2 != nVersion1 );
+	assert( bFound );
+
+	// Notification for something we already have
+	nVersion1 = nVersion2;
+	TEST_ApplyLocalAddressChange( addr, 24, true );
+	assert( TEST_GetLocalAddressesVersion( false, nullptr, 0, nullptr ) == nVersion1 );
+
+	// Prefix length changed
+	TEST_ApplyLocalAddressChange( addr, 16, true );
+	nVersion2 = TEST_GetLocalAddressesVersion( false, &addr, 16, &bFound );
+	assert( nVersion2 != nVersion1 );
+	assert( bFound );
+
+	// Removed, and removing again doesn't do anything
+	nVersion1 = nVersion2;
+	TEST_ApplyLocalAddressChange( addr, 16, false );
+	nVersion2 = TEST_GetLocalAddressesVersion( false, &addr, 16, &bFound );
+	assert( nVersion2 != nVersion1 );
+	assert( !bFound );
+	nVersion1 = nVersion2;
+	TEST_ApplyLocalAddressChange( addr, 16, false );
+	assert( TEST_GetLocalAddressesVersion( false, nullptr, 0, nullptr ) == nVersion1 );
+}
+
+// Hammer a listen socket with junk handshake packets from several address
+// prefixes, while some legitimate clients try to connect.  The admission
+// control should throw away the junk cheaply, and the real clients should
+// get in.
+static std::vector<HSteamNetConnection> s_vecFloodTestServerConns;
+static void OnFloodTestConnectionStatusChanged( SteamNetConnectionStatusChangedCallback_t *pInfo )
+{
+	if ( pInfo->m_info.m_eState == k_ESteamNetworkingConnectionState_Connecting && pInfo->m_info.m_hListenSocket == g_hSteamListenSocket )
+	{
+		if ( SteamNetworkingSockets()->AcceptConnection( pInfo->m_hConn ) == k_EResultOK )
+			s_vecFloodTestServerConns.push_back( pInfo->m_hConn );
+	}
+}
+
+void Test_handshake_flood()
+{
+	TEST_Printf( "***************************************************\n" );
+	TEST_Printf( "Handshake flood\n" );
+	TEST_Printf( "***************************************************\n" );
+
+#ifdef _WIN32
+	TEST_Printf( "Skipping, flood simulation uses BSD sockets\n" );
+#else
+	SteamNetworkingUtils()->SetGlobalCallback_SteamNetConnectionStatusChanged( OnFloodTestConnectionStatusChanged );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_PerfMetrics, 1 );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_IP_HandshakeRatePerPrefix, 50 );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_IP_HandshakeCPUBudget, 2000 );
+
+	CloseConnections();
+	s_vecFloodTestServerConns.clear();
+
+	SteamNetworkingIPAddr bindAddr, connectAddr;
+	bindAddr.Clear(); bindAddr.m_port = k_nStartingServerPort + 12;
+	connectAddr.SetIPv4( 0x7f000001, bindAddr.m_port );
+	g_hSteamListenSocket = SteamNetworkingSockets()->CreateListenSocketIP( bindAddr, 0, nullptr );
+	assert( g_hSteamListenSocket != k_HSteamListenSocket_Invalid );
+
+	SteamNetworkingPerfMetrics_t metricsBefore, metrics;
+	assert( SteamNetworkingUtils()->GetPerfMetrics( &metricsBefore ) );
+
+	// Flooders, each in a different /24.  (All of 127/8 is loopback, at least on Linux.)
+	// Legit clients will come from 127.0.0.1
+	const int k_nFlooders = 8;
+	int arFloodSock[ k_nFlooders ];
+	for ( int i = 0 ; i < k_nFlooders ; ++i )
+	{
+		arFloodSock[i] = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+		assert( arFloodSock[i] >= 0 );
+		sockaddr_in adr;
+		memset( &adr, 0, sizeof(adr) );
+		adr.sin_family = AF_INET;
+		adr.sin_addr.s_addr = htonl( 0x7f000101 + ( i << 8 ) ); // 127.0.1.1, 127.0.2.1, ...
+		assert( bind( arFloodSock[i], (const sockaddr *)&adr, sizeof(adr) ) == 0 );
+	}
+
+	std::atomic<bool> bFlooding( true );
+	std::thread threadFlood( [&]()
+	{
+		sockaddr_in adrTo;
+		memset( &adrTo, 0, sizeof(adrTo) );
+		adrTo.sin_family = AF_INET;
+		adrTo.sin_addr.s_addr = htonl( 0x7f000001 );
+		adrTo.sin_port = htons( bindAddr.m_port );
+
+		uint8 pkt[ 512 ];
+		uint32 nSeq = 1;
+		while ( bFlooding )
+		{
+			for ( int i = 0 ; i < k_nFlooders ; ++i )
+			{
+				memset( pkt, 0, sizeof(pkt) );
+
+				// Connect request that is too small to be real
+				pkt[0] = 34; // k_ESteamNetworkingUDPMsg_ConnectRequest
+				pkt[1] = 0xff;
+				sendto( arFloodSock[i], pkt, 16, 0, (const sockaddr *)&adrTo, sizeof(adrTo) );
+
+				// A challenge request that parses.  Padded, as required
+				pkt[0] = 32; // k_ESteamNetworkingUDPMsg_ChallengeRequest
+				pkt[1] = 5; pkt[2] = 0; // Protobuf length
+				pkt[3] = 0x0d; memcpy( pkt+4, &nSeq, 4 ); // connection_id
+				sendto( arFloodSock[i], pkt, 512, 0, (const sockaddr *)&adrTo, sizeof(adrTo) );
+
+				// Connect request with a bogus challenge
+				pkt[0] = 34;
+				pkt[1] = 0x0d; memcpy( pkt+2, &nSeq, 4 ); // client_connection_id
+				pkt[6] = 0x11; memset( pkt+7, 0x5a, 8 ); // challenge
+				sendto( arFloodSock[i], pkt, 64, 0, (const sockaddr *)&adrTo, sizeof(adrTo) );
+
+				++nSeq;
+			}
+			std::this_thread::sleep_for( std::chrono::microseconds( 200 ) );
+		}
+	} );
+
+	// Meanwhile, some real clients try to connect
+	const int k_nClients = 16;
+	HSteamNetConnection arClient[ k_nClients ];
+	SteamNetworkingMicroseconds usecStart = SteamNetworkingUtils()->GetLocalTimestamp();
+	for ( int i = 0 ; i < k_nClients ; ++i )
+	{
+		arClient[i] = SteamNetworkingSockets()->ConnectByIPAddress( connectAddr, 0, nullptr );
+		assert( arClient[i] != k_HSteamNetConnection_Invalid );
+	}
+	for (;;)
+	{
+		int nConnected = 0;
+		for ( HSteamNetConnection hConn: arClient )
+		{
+			SteamNetConnectionInfo_t info;
+			assert( SteamNetworkingSockets()->GetConnectionInfo( hConn, &info ) );
+			assert( info.m_eState == k_ESteamNetworkingConnectionState_Connecting || info.m_eState == k_ESteamNetworkingConnectionState_FindingRoute || info.m_eState == k_ESteamNetworkingConnectionState_Connected );
+			if ( info.m_eState == k_ESteamNetworkingConnectionState_Connected )
+				++nConnected;
+		}
+		if ( nConnected == k_nClients )
+			break;
+		assert( SteamNetworkingUtils()->GetLocalTimestamp() < usecStart + 10*1000*1000 );
+		TEST_PumpCallbacks();
+	}
+	TEST_Printf( "%d clients connected during flood in %.1fms\n", k_nClients, ( SteamNetworkingUtils()->GetLocalTimestamp() - usecStart )*1e-3 );
+
+	bFlooding = false;
+	threadFlood.join();
+	for ( int s: arFloodSock )
+		close( s );
+
+	assert( SteamNetworkingUtils()->GetPerfMetrics( &metrics ) );
+	TEST_Printf( "Filtered %lld, rate limited %lld, deferred %lld, dropped %lld\n",
+		(long long)( metrics.m_nHandshakeFiltered - metricsBefore.m_nHandshakeFiltered ),
+		(long long)( metrics.m_nHandshakeRateLimited - metricsBefore.m_nHandshakeRateLimited ),
+		(long long)( metrics.m_nConnectRequestsDeferred - metricsBefore.m_nConnectRequestsDeferred ),
+		(long long)( metrics.m_nConnectRequestsDropped - metricsBefore.m_nConnectRequestsDropped ) );
+	assert( metrics.m_nHandshakeFiltered > metricsBefore.m_nHandshakeFiltered );
+	assert( metrics.m_nHandshakeRateLimited > metricsBefore.m_nHandshakeRateLimited );
+	assert( (int)s_vecFloodTestServerConns.size() == k_nClients );
+
+	for ( HSteamNetConnection hConn: arClient )
+		SteamNetworkingSockets()->CloseConnection( hConn, 0, nullptr, false );
+	for ( HSteamNetConnection hConn: s_vecFloodTestServerConns )
+		SteamNetworkingSockets()->CloseConnection( hConn, 0, nullptr, false );
+	s_vecFloodTestServerConns.clear();
+	CloseConnections();
+
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_IP_HandshakeCPUBudget, 250000 );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_IP_HandshakeRatePerPrefix, 0 );
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32( k_ESteamNetworkingConfig_PerfMetrics, 0 );
+	SteamNetworkingUtils()->SetGlobalCallback_SteamNetConnectionStatusChanged( OnSteamNetConnectionStatusChanged );
+#endif
+}
+
 int main( int argc, const char **argv  )
 {
 	typedef void (*FnTest)(void);
@@ -1577,7 +3281,26 @@ int main( int argc, const char **argv  )
 		TEST(lane_quick_priority_and_background),
 		TEST(pipe),
 		TEST(send_buffer_full),
-		TEST(recv_buf_full)
+		TEST(recv_buf_full),
+		TEST(perf_metrics),
+		TEST(snp_status),
+		TEST(snp_trace),
+		TEST(reliable_tail_loss),
+		TEST(unreliable_expiry),
+		TEST(unreliable_fec),
+		TEST(unreliable_reassembly),
+		TEST(unreliable_delivery_receipts),
+		TEST(lane_compression),
+		TEST(ack_frequency),
+		TEST(lane_deadlines),
+		TEST(compact_encoding),
+		TEST(inline_stats),
+		TEST(wake_handles),
+		TEST(handshake_worker_threads),
+		TEST(session_resumption),
+		TEST(handshake_flood),
+		TEST(cipher_chacha20),
+		TEST(local_address_table)
 	};
 
 	struct Suite_t {
@@ -1585,7 +3308,7 @@ int main( int argc, const char **argv  )
 		std::vector< Test_t > m_vecTests;
 	};
 	static const Suite_t test_suites[] = {
-		{ "suite-quick", { TEST(identity), TEST(quick), TEST(lane_quick_queueanddrain), TEST(lane_quick_priority_and_background), TEST(pipe), TEST(send_buffer_full), TEST(recv_buf_full) } }
+		{ "suite-quick", { TEST(identity), TEST(quick), TEST(lane_quick_queueanddrain), TEST(lane_quick_priority_and_background), TEST(pipe), TEST(send_buffer_full), TEST(recv_buf_full), TEST(perf_metrics), TEST(snp_status), TEST(snp_trace), TEST(reliable_tail_loss), TEST(unreliable_expiry), TEST(unreliable_fec), TEST(unreliable_reassembly), TEST(unreliable_delivery_receipts), TEST(lane_compression), TEST(ack_frequency), TEST(lane_deadlines), TEST(compact_encoding), TEST(inline_stats), TEST(wake_handles), TEST(handshake_worker_threads), TEST(session_resumption), TEST(handshake_flood), TEST(cipher_chacha20), TEST(local_address_table) } }
 	};
 
 	if ( argc < 2 )
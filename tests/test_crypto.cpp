@@ -1,14 +1,25 @@
 #include <assert.h>
 #include <string>
+#include <algorithm>
 
 #include <tier1/utlbuffer.h>
 #include <crypto.h>
 #include <crypto_25519.h>
+#include <crypto_chacha20poly1305.h>
+#include <lz4_block.h>
 
 #ifdef LINUX
 #include <unistd.h>
 #endif
 
+#if defined( _MSC_VER ) && ( defined( _M_IX86 ) || defined( _M_X64 ) )
+	#include <intrin.h>
+	#define HAVE_RDTSC
+#elif defined( __i386__ ) || defined( __x86_64__ )
+	#include <x86intrin.h>
+	#define HAVE_RDTSC
+#endif
+
 // I copied these tests from the Steam branch.
 // A little compatibility glue so I don't have to make any changes to them.
 #define CHECK(x) do { bool _check_result; Assert( (_check_result = (x)) != false ); g_failed |= !_check_result; } while(0)
@@ -310,11 +321,193 @@ void TestSymmetricAuthCryptoVectors()
 
 	// Check against known test vectors
 	TestSymmetricAuthCrypto_EncryptTestVectorFile( TEST_VECTOR_DIR "gcmEncryptExtIV256.rsp" );
+
+	// If there is a fast path, make sure the general purpose implementation
+	// also passes.  (The default is to use the fast path.)
+	if ( CCrypto::SetAESGCMFastPathEnabled( false ) )
+		TestSymmetricAuthCrypto_EncryptTestVectorFile( TEST_VECTOR_DIR "gcmEncryptExtIV256.rsp" );
+	CCrypto::SetAESGCMFastPathEnabled( true );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Compare the AES-GCM fast path against the general purpose
+//          implementation, for all the buffer sizes that hit the edge cases
+//-----------------------------------------------------------------------------
+void TestSymmetricAuthCryptoFastPath()
+{
+	if ( !CCrypto::SetAESGCMFastPathEnabled( true ) )
+	{
+		printf( "\tNo AES-GCM fast path available, skipping comparison test\n" );
+		return;
+	}
+
+	uint8 rgubData[ 1400 ];
+	uint8 rgubAAD[ 80 ];
+	uint8 rgubKey[ 32 ];
+	uint8 rgubIV[ 12 ];
+	CCrypto::GenerateRandomBlock( rgubData, sizeof(rgubData) );
+	CCrypto::GenerateRandomBlock( rgubAAD, sizeof(rgubAAD) );
+
+	const size_t k_rgcbKey[] = { 16, 32 };
+	const size_t k_rgcbTag[] = { 16, 12 };
+	for ( size_t cbKey: k_rgcbKey )
+	{
+		for ( size_t cbTag: k_rgcbTag )
+		{
+			CCrypto::GenerateRandomBlock( rgubKey, sizeof(rgubKey) );
+
+			AES_GCM_EncryptContext ctxEncFast, ctxEncSlow;
+			AES_GCM_DecryptContext ctxDecFast, ctxDecSlow;
+			CCrypto::SetAESGCMFastPathEnabled( true );
+			RETURNIFNOT( ctxEncFast.Init( rgubKey, cbKey, sizeof(rgubIV), cbTag ) );
+			RETURNIFNOT( ctxDecFast.Init( rgubKey, cbKey, sizeof(rgubIV), cbTag ) );
+			CCrypto::SetAESGCMFastPathEnabled( false );
+			RETURNIFNOT( ctxEncSlow.Init( rgubKey, cbKey, sizeof(rgubIV), cbTag ) );
+			RETURNIFNOT( ctxDecSlow.Init( rgubKey, cbKey, sizeof(rgubIV), cbTag ) );
+			CCrypto::SetAESGCMFastPathEnabled( true );
+
+			for ( size_t cbData = 0 ; cbData <= sizeof(rgubData) ; cbData += ( cbData < 260 ) ? 1 : 61 )
+			{
+				CCrypto::GenerateRandomBlock( rgubIV, sizeof(rgubIV) );
+				size_t cbAAD = cbData % ( sizeof(rgubAAD)+1 );
+				const void *pAAD = cbAAD ? rgubAAD : nullptr;
+
+				uint8 rgubFast[ sizeof(rgubData) + 16 ];
+				uint8 rgubSlow[ sizeof(rgubData) + 16 ];
+				uint32 cbFast = sizeof(rgubFast);
+				uint32 cbSlow = sizeof(rgubSlow);
+				CHECK( ctxEncFast.Encrypt( rgubData, cbData, rgubIV, rgubFast, &cbFast, pAAD, cbAAD ) );
+				CHECK( ctxEncSlow.Encrypt( rgubData, cbData, rgubIV, rgubSlow, &cbSlow, pAAD, cbAAD ) );
+				CHECK( cbFast == cbData + cbTag );
+				CHECK( cbFast == cbSlow );
+				CHECK( memcmp( rgubFast, rgubSlow, cbFast ) == 0 );
+
+				// Each one should be able to decrypt the other
+				uint8 rgubDecrypted[ sizeof(rgubData) ];
+				uint32 cbDecrypted = sizeof(rgubDecrypted);
+				CHECK( ctxDecFast.Decrypt( rgubSlow, cbSlow, rgubIV, rgubDecrypted, &cbDecrypted, pAAD, cbAAD ) );
+				CHECK( cbDecrypted == cbData && memcmp( rgubDecrypted, rgubData, cbData ) == 0 );
+				cbDecrypted = sizeof(rgubDecrypted);
+				CHECK( ctxDecSlow.Decrypt( rgubFast, cbFast, rgubIV, rgubDecrypted, &cbDecrypted, pAAD, cbAAD ) );
+				CHECK( cbDecrypted == cbData && memcmp( rgubDecrypted, rgubData, cbData ) == 0 );
+
+				// Tampering with the ciphertext, tag, or AAD must be detected
+				rgubFast[ rand() % cbFast ] ^= ( 1 << ( rand() & 7 ) );
+				cbDecrypted = sizeof(rgubDecrypted);
+				CHECK( !ctxDecFast.Decrypt( rgubFast, cbFast, rgubIV, rgubDecrypted, &cbDecrypted, pAAD, cbAAD ) );
+				CHECK( cbDecrypted == 0 );
+				if ( cbAAD > 0 )
+				{
+					rgubAAD[ rand() % cbAAD ] ^= 0x80;
+					cbDecrypted = sizeof(rgubDecrypted);
+					CHECK( !ctxDecFast.Decrypt( rgubSlow, cbSlow, rgubIV, rgubDecrypted, &cbDecrypted, pAAD, cbAAD ) );
+				}
+
+				// In-place encryption gives the same result
+				memcpy( rgubFast, rgubData, cbData );
+				cbFast = sizeof(rgubFast);
+				CHECK( ctxEncFast.Encrypt( rgubFast, cbData, rgubIV, rgubFast, &cbFast, pAAD, cbAAD ) );
+				cbSlow = sizeof(rgubSlow);
+				CHECK( ctxEncSlow.Encrypt( rgubData, cbData, rgubIV, rgubSlow, &cbSlow, pAAD, cbAAD ) );
+				CHECK( memcmp( rgubFast, rgubSlow, cbFast ) == 0 );
+
+				// And so does in-place decryption
+				cbDecrypted = cbFast;
+				CHECK( ctxDecFast.Decrypt( rgubFast, cbFast, rgubIV, rgubFast, &cbDecrypted, pAAD, cbAAD ) );
+				CHECK( cbDecrypted == cbData && memcmp( rgubFast, rgubData, cbData ) == 0 );
+				cbDecrypted = cbSlow;
+				CHECK( ctxDecSlow.Decrypt( rgubSlow, cbSlow, rgubIV, rgubSlow, &cbDecrypted, pAAD, cbAAD ) );
+				CHECK( cbDecrypted == cbData && memcmp( rgubSlow, rgubData, cbData ) == 0 );
+			}
+		}
+	}
 }
 
 //-----------------------------------------------------------------------------
 // Purpose: Test elliptic-curve primitives (ed25519 signing, curve25519 key exchange)
 //-----------------------------------------------------------------------------
+void TestChaCha20Poly1305()
+{
+	// RFC 8439 section 2.8.2
+	const char *pszKey = "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f";
+	const char *pszNonce = "070000004041424344454647";
+	const char *pszAAD = "50515253c0c1c2c3c4c5c6c7";
+	const char szPlaintext[] = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it.";
+	const char *pszCiphertext =
+		"d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+		"3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+		"92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+		"3ff4def08e4b7a9de576d26586cec64b6116";
+	const char *pszTag = "1ae10b594f09e26a7e902ecbd0600691";
+
+	uint8 rgubKey[32], rgubNonce[12], rgubAAD[12], rgubTag[16];
+	uint8 rgubExpected[ sizeof(szPlaintext)-1 ];
+	const uint32 cbPlaintext = sizeof(szPlaintext)-1;
+	V_hextobinary( pszKey, 64, rgubKey, sizeof(rgubKey) );
+	V_hextobinary( pszNonce, 24, rgubNonce, sizeof(rgubNonce) );
+	V_hextobinary( pszAAD, 24, rgubAAD, sizeof(rgubAAD) );
+	V_hextobinary( pszCiphertext, cbPlaintext*2, rgubExpected, sizeof(rgubExpected) );
+	V_hextobinary( pszTag, 32, rgubTag, sizeof(rgubTag) );
+
+	// Portable implementation
+	uint8 rgubEncrypted[ 1400 + 16 ];
+	ChaCha20Poly1305_Encrypt( rgubKey, rgubNonce, szPlaintext, cbPlaintext, rgubAAD, sizeof(rgubAAD), rgubEncrypted );
+	CHECK( memcmp( rgubEncrypted, rgubExpected, cbPlaintext ) == 0 );
+	CHECK( memcmp( rgubEncrypted + cbPlaintext, rgubTag, 16 ) == 0 );
+
+	// Crypto backend
+	ChaCha20_Poly1305_EncryptContext ctxEnc;
+	ChaCha20_Poly1305_DecryptContext ctxDec;
+	RETURNIFNOT( ctxEnc.Init( rgubKey, sizeof(rgubKey), sizeof(rgubNonce), 16 ) );
+	RETURNIFNOT( ctxDec.Init( rgubKey, sizeof(rgubKey), sizeof(rgubNonce), 16 ) );
+	uint32 cbEncrypted = sizeof(rgubEncrypted);
+	CHECK( ctxEnc.Encrypt( szPlaintext, cbPlaintext, rgubNonce, rgubEncrypted, &cbEncrypted, rgubAAD, sizeof(rgubAAD) ) );
+	CHECK( cbEncrypted == cbPlaintext + 16 );
+	CHECK( memcmp( rgubEncrypted, rgubExpected, cbPlaintext ) == 0 );
+	CHECK( memcmp( rgubEncrypted + cbPlaintext, rgubTag, 16 ) == 0 );
+
+	// Random sizes, both implementations should agree
+	uint8 rgubData[ 1400 ];
+	CCrypto::GenerateRandomBlock( rgubData, sizeof(rgubData) );
+	for ( uint32 cbData = 0 ; cbData <= sizeof(rgubData) ; cbData += ( cbData < 260 ) ? 1 : 61 )
+	{
+		CCrypto::GenerateRandomBlock( rgubKey, sizeof(rgubKey) );
+		CCrypto::GenerateRandomBlock( rgubNonce, sizeof(rgubNonce) );
+		RETURNIFNOT( ctxEnc.Init( rgubKey, sizeof(rgubKey), sizeof(rgubNonce), 16 ) );
+		RETURNIFNOT( ctxDec.Init( rgubKey, sizeof(rgubKey), sizeof(rgubNonce), 16 ) );
+		const uint32 cbAAD = cbData % ( sizeof(rgubAAD)+1 );
+		const void *pAAD = cbAAD ? rgubAAD : nullptr;
+
+		uint8 rgubPortable[ sizeof(rgubData) + 16 ];
+		ChaCha20Poly1305_Encrypt( rgubKey, rgubNonce, rgubData, cbData, pAAD, cbAAD, rgubPortable );
+		cbEncrypted = sizeof(rgubEncrypted);
+		CHECK( ctxEnc.Encrypt( rgubData, cbData, rgubNonce, rgubEncrypted, &cbEncrypted, pAAD, cbAAD ) );
+		CHECK( cbEncrypted == cbData + 16 );
+		CHECK( memcmp( rgubEncrypted, rgubPortable, cbEncrypted ) == 0 );
+
+		uint8 rgubDecrypted[ sizeof(rgubData) ];
+		uint32 cbDecrypted = sizeof(rgubDecrypted);
+		CHECK( ctxDec.Decrypt( rgubEncrypted, cbEncrypted, rgubNonce, rgubDecrypted, &cbDecrypted, pAAD, cbAAD ) );
+		CHECK( cbDecrypted == cbData && memcmp( rgubDecrypted, rgubData, cbData ) == 0 );
+		CHECK( ChaCha20Poly1305_Decrypt( rgubKey, rgubNonce, rgubEncrypted, cbData, rgubEncrypted + cbData, pAAD, cbAAD, rgubDecrypted ) );
+		CHECK( memcmp( rgubDecrypted, rgubData, cbData ) == 0 );
+
+		// In place
+		memcpy( rgubPortable, rgubData, cbData );
+		uint32 cbInPlace = sizeof(rgubPortable);
+		CHECK( ctxEnc.Encrypt( rgubPortable, cbData, rgubNonce, rgubPortable, &cbInPlace, pAAD, cbAAD ) );
+		CHECK( cbInPlace == cbEncrypted && memcmp( rgubPortable, rgubEncrypted, cbInPlace ) == 0 );
+		CHECK( ctxDec.Decrypt( rgubPortable, cbInPlace, rgubNonce, rgubPortable, &cbInPlace, pAAD, cbAAD ) );
+		CHECK( cbInPlace == cbData && memcmp( rgubPortable, rgubData, cbData ) == 0 );
+
+		// Tampering must be detected
+		rgubEncrypted[ rand() % cbEncrypted ] ^= ( 1 << ( rand() & 7 ) );
+		cbDecrypted = sizeof(rgubDecrypted);
+		CHECK( !ctxDec.Decrypt( rgubEncrypted, cbEncrypted, rgubNonce, rgubDecrypted, &cbDecrypted, pAAD, cbAAD ) );
+		CHECK( !ChaCha20Poly1305_Decrypt( rgubKey, rgubNonce, rgubEncrypted, cbData, rgubEncrypted + cbData, pAAD, cbAAD, rgubDecrypted ) );
+	}
+}
+
 void TestSHA256()
 {
 	// NIST FIPS 180-4 known-answer tests for SHA-256
@@ -602,6 +795,167 @@ AAAECpUfg4C0BkgsCO+GlFAbcTQZUeFFQcamXzDA1tx7aNWre903qWUTRvLh3toW6vScFd
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Test the LZ4 block codec: round trips, interop with the reference
+// implementation, and rejection of malformed input
+//-----------------------------------------------------------------------------
+static void CheckLZ4RoundTrip( const CLZ4Dictionary *pDict, const uint8 *pData, int cbData )
+{
+	std::vector<uint8> compressed( LZ4Block_CompressBound( cbData ) );
+	int cbCompressed = LZ4Block_Compress( pDict, pData, cbData, compressed.data(), (int)compressed.size() );
+	CHECK( cbCompressed > 0 );
+	if ( cbCompressed <= 0 )
+		return;
+
+	// Leave a guard byte past the end, to catch overruns
+	std::vector<uint8> decompressed( cbData + 1, 0xcd );
+	CHECK_EQUAL( LZ4Block_Decompress( pDict, compressed.data(), cbCompressed, decompressed.data(), cbData ), cbData );
+	CHECK( memcmp( decompressed.data(), pData, cbData ) == 0 );
+	CHECK_EQUAL( decompressed[cbData], 0xcd );
+
+	// One byte short on output space must fail cleanly
+	if ( cbData > 0 )
+	{
+		decompressed[cbData-1] = 0xcd;
+		CHECK_EQUAL( LZ4Block_Decompress( pDict, compressed.data(), cbCompressed, decompressed.data(), cbData-1 ), -1 );
+		CHECK_EQUAL( decompressed[cbData-1], 0xcd );
+	}
+
+	// Every truncation must either be rejected, or decode to a proper prefix.
+	// (A cut right after a run of literals is a well-formed, shorter stream.)
+	for ( int cbTruncated = 0 ; cbTruncated < cbCompressed ; ++cbTruncated )
+	{
+		int r = LZ4Block_Decompress( pDict, compressed.data(), cbTruncated, decompressed.data(), cbData );
+		CHECK( r == -1 || ( r >= 0 && r < cbData && memcmp( decompressed.data(), pData, r ) == 0 ) );
+		CHECK_EQUAL( decompressed[cbData], 0xcd );
+	}
+
+	// If the buffer is too small, compression reports it rather than overflowing
+	if ( cbCompressed > 1 )
+	{
+		compressed.assign( compressed.size(), 0xcd );
+		CHECK_EQUAL( LZ4Block_Compress( pDict, pData, cbData, compressed.data(), cbCompressed-1 ), 0 );
+		CHECK_EQUAL( compressed[cbCompressed-1], 0xcd );
+	}
+}
+
+void TestLZ4Block()
+{
+	uint8 rgubOut[ 2048 ];
+
+	// Vectors produced by the reference LZ4 library (LZ4_compress_default, and
+	// LZ4_loadDict + LZ4_compress_fast_continue for the dictionary case)
+	{
+		static const char szPlain[] = "Hello, hello, hello, hello, hello!  Hello, hello, hello, hello, hello!";
+		static const uint8 rgubRef[] = {
+			0x8f, 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x2c, 0x20, 0x68, 0x07, 0x00, 0x06, 0x3f, 0x21, 0x20, 0x20,
+			0x24, 0x00, 0x0a, 0x50, 0x65, 0x6c, 0x6c, 0x6f, 0x21
+		};
+		const int cbPlain = (int)sizeof(szPlain)-1;
+		CHECK_EQUAL( LZ4Block_Decompress( nullptr, rgubRef, sizeof(rgubRef), rgubOut, sizeof(rgubOut) ), cbPlain );
+		CHECK( memcmp( rgubOut, szPlain, cbPlain ) == 0 );
+		CheckLZ4RoundTrip( nullptr, (const uint8 *)szPlain, cbPlain );
+	}
+	{
+		// 300 x 'a', then 20 x "bcdefghijklmnop", then "0123456789".
+		// Exercises the 255-continuation encoding for match lengths.
+		std::string sPlain( 300, 'a' );
+		for ( int i = 0 ; i < 20 ; ++i )
+			sPlain += "bcdefghijklmnop";
+		sPlain += "0123456789";
+		static const uint8 rgubRef[] = {
+			0x1f, 0x61, 0x01, 0x00, 0xff, 0x19, 0xff, 0x00, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+			0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x0f, 0x00, 0xff, 0x0b, 0xa0, 0x30, 0x31, 0x32, 0x33,
+			0x34, 0x35, 0x36, 0x37, 0x38, 0x39
+		};
+		CHECK_EQUAL( LZ4Block_Decompress( nullptr, rgubRef, sizeof(rgubRef), rgubOut, sizeof(rgubOut) ), (int)sPlain.length() );
+		CHECK( memcmp( rgubOut, sPlain.c_str(), sPlain.length() ) == 0 );
+		CheckLZ4RoundTrip( nullptr, (const uint8 *)sPlain.c_str(), (int)sPlain.length() );
+	}
+	{
+		static const char szDict[] = "The quick brown fox jumps over the lazy dog. ";
+		static const char szPlain[] = "The lazy dog jumps over the quick brown fox. The quick brown fox!";
+		static const uint8 rgubRef[] = {
+			0x17, 0x54, 0x0e, 0x00, 0x0c, 0x26, 0x00, 0x0b, 0x45, 0x00, 0x2b, 0x2e, 0x20, 0x5a, 0x00, 0x50,
+			0x20, 0x66, 0x6f, 0x78, 0x21
+		};
+		const int cbPlain = (int)sizeof(szPlain)-1;
+		CLZ4Dictionary dict;
+		dict.Init( szDict, (int)sizeof(szDict)-1 );
+		CHECK_EQUAL( LZ4Block_Decompress( &dict, rgubRef, sizeof(rgubRef), rgubOut, sizeof(rgubOut) ), cbPlain );
+		CHECK( memcmp( rgubOut, szPlain, cbPlain ) == 0 );
+		CheckLZ4RoundTrip( &dict, (const uint8 *)szPlain, cbPlain );
+
+		// Without the dictionary, the first match points before the start of the output
+		CHECK_EQUAL( LZ4Block_Decompress( nullptr, rgubRef, sizeof(rgubRef), rgubOut, sizeof(rgubOut) ), -1 );
+	}
+
+	// Empty input encodes to a single token, same as the reference
+	{
+		uint8 rgubCompressed[ 16 ];
+		CHECK_EQUAL( LZ4Block_Compress( nullptr, "", 0, rgubCompressed, sizeof(rgubCompressed) ), 1 );
+		CHECK_EQUAL( rgubCompressed[0], 0x00 );
+		CHECK_EQUAL( LZ4Block_Decompress( nullptr, rgubCompressed, 1, rgubOut, sizeof(rgubOut) ), 0 );
+		CHECK_EQUAL( LZ4Block_Decompress( nullptr, rgubCompressed, 0, rgubOut, sizeof(rgubOut) ), -1 );
+	}
+
+	// Round trips of random, and partly compressible, data of various sizes,
+	// with and without a dictionary
+	{
+		uint8 rgubRandom[ 1500 ];
+		CCrypto::GenerateRandomBlock( rgubRandom, sizeof(rgubRandom) );
+		uint8 rgubText[ 1500 ];
+		for ( int i = 0 ; i < (int)sizeof(rgubText) ; ++i )
+			rgubText[i] = "abcdefgh"[ ( rgubRandom[i] & 7 ) * ( rgubRandom[i] >> 7 ) ];
+
+		CLZ4Dictionary dict;
+		dict.Init( rgubText + 700, 400 );
+
+		for ( int cbData = 1 ; cbData <= (int)sizeof(rgubRandom) ; cbData += ( cbData < 40 ) ? 1 : 97 )
+		{
+			CheckLZ4RoundTrip( nullptr, rgubRandom, cbData );
+			CheckLZ4RoundTrip( nullptr, rgubText, cbData );
+			CheckLZ4RoundTrip( &dict, rgubText, cbData );
+		}
+	}
+
+	// Hand-built malformed streams
+	{
+		struct { const char *pszDesc; const char *pData; int cbData; int cbOutputMax; } rgBad[] =
+		{
+			{ "offset zero",                       "\x10" "a" "\x00\x00" "\x00", 5, 64 },
+			{ "offset before start of output",     "\x10" "a" "\x02\x00" "\x00", 5, 64 },
+			{ "offset far before start of output", "\x10" "a" "\xff\xff" "\x00", 5, 64 },
+			{ "missing offset byte",               "\x10" "a" "\x01", 3, 64 },
+			{ "literals past end of input",        "\x50" "abc", 4, 64 },
+			{ "literal length runs off the end",   "\xf0\xff\xff", 3, 64 },
+			{ "literal length larger than output", "\xf0\xff\xff\xff\xff\x00" "aaaa", 10, 64 },
+			{ "match length runs off the end",     "\x1f" "a" "\x01\x00\xff", 5, 64 },
+			{ "match length larger than output",   "\x1f" "a" "\x01\x00\xff\xff\xff\x00" "\x00", 9, 64 },
+			{ "literals larger than output",       "\x50" "abcde", 6, 4 },
+			{ "match larger than output",          "\x14" "a" "\x01\x00" "\x00", 5, 8 },
+		};
+		for ( const auto &bad: rgBad )
+		{
+			memset( rgubOut, 0xcd, sizeof(rgubOut) );
+			int r = LZ4Block_Decompress( nullptr, bad.pData, bad.cbData, rgubOut, bad.cbOutputMax );
+			if ( r != -1 )
+				printf( "LZ4 malformed input '%s' was not rejected (returned %d)\n", bad.pszDesc, r );
+			CHECK_EQUAL( r, -1 );
+			CHECK_EQUAL( rgubOut[ bad.cbOutputMax ], 0xcd );
+		}
+
+		// The same streams become legal when the data is there to back them up
+		CHECK_EQUAL( LZ4Block_Decompress( nullptr, "\x14" "a" "\x01\x00" "\x00", 5, rgubOut, 9 ), 9 );
+		CHECK( memcmp( rgubOut, "aaaaaaaaa", 9 ) == 0 );
+		CLZ4Dictionary dict;
+		dict.Init( "xy", 2 );
+		CHECK_EQUAL( LZ4Block_Decompress( &dict, "\x10" "a" "\x03\x00" "\x00", 5, rgubOut, 64 ), 5 );
+		CHECK( memcmp( rgubOut, "axyax", 5 ) == 0 );
+		CHECK_EQUAL( LZ4Block_Decompress( &dict, "\x10" "a" "\x04\x00" "\x00", 5, rgubOut, 64 ), -1 );
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Tests elliptic crypto perf
 //-----------------------------------------------------------------------------
@@ -690,6 +1044,75 @@ void TestEllipticPerf()
 	printf( "\tVerify ed25519 signature (big):\t\t\t%f MB/sec (%d iterations)\n", dRateLargeMBPerSecCheck, k_cIterationsSignBig );
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Tests checking a batch of ed25519 signatures at once, and compares
+//			the speed with checking them one at a time
+//-----------------------------------------------------------------------------
+void TestEllipticBatchVerify()
+{
+	const int k_nSignatures = 64;
+	const int k_cubMsg = 256; // About the size of a cert or session crypt info
+	const int k_cIterations = 20;
+
+	static CECSigningPublicKey rgPub[ k_nSignatures ];
+	static uint8 rgMsg[ k_nSignatures ][ k_cubMsg ];
+	static CryptoSignature_t rgSignature[ k_nSignatures ];
+	SignatureToVerify_t rgBatch[ k_nSignatures ];
+	for ( int i = 0 ; i < k_nSignatures ; ++i )
+	{
+		CECSigningPrivateKey priv;
+		CCrypto::GenerateSigningKeyPair( &rgPub[i], &priv );
+		CCrypto::GenerateRandomBlock( rgMsg[i], k_cubMsg );
+		CCrypto::GenerateSignature( rgMsg[i], k_cubMsg, priv, &rgSignature[i] );
+
+		rgBatch[i].m_pData = rgMsg[i];
+		rgBatch[i].m_cbData = k_cubMsg;
+		rgBatch[i].m_pPublicKey = &rgPub[i];
+		rgBatch[i].m_pSignature = &rgSignature[i];
+		rgBatch[i].m_bValid = false;
+	}
+
+	// All good
+	CHECK( CCrypto::VerifySignatureBatch( rgBatch, k_nSignatures ) );
+	for ( int i = 0 ; i < k_nSignatures ; ++i )
+		CHECK( rgBatch[i].m_bValid );
+
+	// Spoil a couple of them.  We should identify exactly which ones are bad
+	rgMsg[3][10] ^= 1;
+	rgSignature[40][5] ^= 1;
+	CHECK( !CCrypto::VerifySignatureBatch( rgBatch, k_nSignatures ) );
+	for ( int i = 0 ; i < k_nSignatures ; ++i )
+		CHECK( rgBatch[i].m_bValid == ( i != 3 && i != 40 ) );
+	rgMsg[3][10] ^= 1;
+	rgSignature[40][5] ^= 1;
+
+	// Odd sizes, smaller than the batch
+	CHECK( CCrypto::VerifySignatureBatch( rgBatch, 1 ) );
+	CHECK( CCrypto::VerifySignatureBatch( rgBatch+7, 5 ) );
+	CHECK( CCrypto::VerifySignatureBatch( rgBatch, 0 ) );
+
+	// Perf, one at a time
+	int x = 0;
+	uint64 usecStart = Plat_USTime();
+	for ( int n = 0 ; n < k_cIterations ; ++n )
+	{
+		for ( int i = 0 ; i < k_nSignatures ; ++i )
+			x ^= (int)CCrypto::VerifySignature( rgMsg[i], k_cubMsg, rgPub[i], rgSignature[i] );
+	}
+	double dVerifiesPerSecIndividual = double( k_cIterations * k_nSignatures ) * 1e6 / double( Plat_USTime() - usecStart );
+
+	// Perf, batched
+	usecStart = Plat_USTime();
+	for ( int n = 0 ; n < k_cIterations ; ++n )
+	{
+		x ^= (int)CCrypto::VerifySignatureBatch( rgBatch, k_nSignatures );
+	}
+	double dVerifiesPerSecBatch = double( k_cIterations * k_nSignatures ) * 1e6 / double( Plat_USTime() - usecStart );
+
+	printf( "\tVerify ed25519 signature (individually):\t\t%f verifications/sec (%d iterations)\n", dVerifiesPerSecIndividual, k_cIterations * k_nSignatures );
+	printf( "\tVerify ed25519 signature (batch of %d):\t\t%f verifications/sec (%d iterations)\n", k_nSignatures, dVerifiesPerSecBatch, k_cIterations * k_nSignatures );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Performs specified # of symmetric encryptions
 //-----------------------------------------------------------------------------
@@ -843,6 +1266,85 @@ bool chdir_to_bindir()
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Measure AES-GCM throughput at typical packet sizes, comparing
+//          the fast path (if any) against the general purpose implementation
+//-----------------------------------------------------------------------------
+void TestSymmetricAuthCryptoPacketPerf()
+{
+	const int k_cIterations = 20000;
+	const int k_rgcbPacket[] = { 64, 256, 1200 };
+
+	uint8 rgubKey[ k_nSymmetricKeyLen ];
+	uint8 rgubIV[ k_nSymmetricIVSize ];
+	uint8 rgubAAD[ 8 ];
+	uint8 rgubData[ 1200 ];
+	uint8 rgubEncrypted[ 1200 + 16 ];
+	uint8 rgubDecrypted[ 1200 ];
+	CCrypto::GenerateRandomBlock( rgubKey, sizeof(rgubKey) );
+	CCrypto::GenerateRandomBlock( rgubIV, sizeof(rgubIV) );
+	CCrypto::GenerateRandomBlock( rgubAAD, sizeof(rgubAAD) );
+	CCrypto::GenerateRandomBlock( rgubData, sizeof(rgubData) );
+
+	bool bHaveFastPath = CCrypto::SetAESGCMFastPathEnabled( true );
+	for ( int iPass = 0 ; iPass < ( bHaveFastPath ? 2 : 1 ) ; ++iPass )
+	{
+		const bool bFast = bHaveFastPath && iPass == 0;
+		CCrypto::SetAESGCMFastPathEnabled( bFast );
+
+		AES_GCM_EncryptContext ctxEnc;
+		AES_GCM_DecryptContext ctxDec;
+		RETURNIFNOT( ctxEnc.Init( rgubKey, sizeof(rgubKey), sizeof(rgubIV), k_nSymmetricGCMTagSize ) );
+		RETURNIFNOT( ctxDec.Init( rgubKey, sizeof(rgubKey), sizeof(rgubIV), k_nSymmetricGCMTagSize ) );
+
+		for ( int cbPacket: k_rgcbPacket )
+		{
+			uint32 cbEncrypted = sizeof(rgubEncrypted);
+			RETURNIFNOT( ctxEnc.Encrypt( rgubData, cbPacket, rgubIV, rgubEncrypted, &cbEncrypted, rgubAAD, sizeof(rgubAAD) ) );
+
+			// Encrypt
+			uint64 usecStart = Plat_USTime();
+			#ifdef HAVE_RDTSC
+				uint64 nCyclesStart = __rdtsc();
+			#endif
+			for ( int i = 0 ; i < k_cIterations ; ++i )
+			{
+				uint32 cbOut = sizeof(rgubEncrypted);
+				ctxEnc.Encrypt( rgubData, cbPacket, rgubIV, rgubEncrypted, &cbOut, rgubAAD, sizeof(rgubAAD) );
+			}
+			#ifdef HAVE_RDTSC
+				double flEncryptBytesPerCycle = double( cbPacket ) * k_cIterations / double( __rdtsc() - nCyclesStart );
+			#endif
+			double flEncryptMBPerSec = double( cbPacket ) * k_cIterations / double( std::max<uint64>( 1, Plat_USTime() - usecStart ) );
+
+			// Decrypt
+			usecStart = Plat_USTime();
+			#ifdef HAVE_RDTSC
+				nCyclesStart = __rdtsc();
+			#endif
+			for ( int i = 0 ; i < k_cIterations ; ++i )
+			{
+				uint32 cbOut = sizeof(rgubDecrypted);
+				CHECK( ctxDec.Decrypt( rgubEncrypted, cbEncrypted, rgubIV, rgubDecrypted, &cbOut, rgubAAD, sizeof(rgubAAD) ) );
+			}
+			#ifdef HAVE_RDTSC
+				double flDecryptBytesPerCycle = double( cbPacket ) * k_cIterations / double( __rdtsc() - nCyclesStart );
+			#endif
+			double flDecryptMBPerSec = double( cbPacket ) * k_cIterations / double( std::max<uint64>( 1, Plat_USTime() - usecStart ) );
+
+			const char *pszImpl = bFast ? "fast path" : "general";
+			#ifdef HAVE_RDTSC
+				printf( "\tSymmetric GCM %s, %4d bytes:\tencrypt %.3f bytes/cycle (%.1f MB/sec), decrypt %.3f bytes/cycle (%.1f MB/sec)\n",
+					pszImpl, cbPacket, flEncryptBytesPerCycle, flEncryptMBPerSec, flDecryptBytesPerCycle, flDecryptMBPerSec );
+			#else
+				printf( "\tSymmetric GCM %s, %4d bytes:\tencrypt %.1f MB/sec, decrypt %.1f MB/sec\n",
+					pszImpl, cbPacket, flEncryptMBPerSec, flDecryptMBPerSec );
+			#endif
+		}
+	}
+	CCrypto::SetAESGCMFastPathEnabled( true );
+}
+
 int main()
 {
 	if (!chdir_to_bindir())
@@ -855,10 +1357,15 @@ int main()
 	TestMD5();
 	TestHMAC();
 	TestSymmetricAuthCryptoVectors();
+	TestSymmetricAuthCryptoFastPath();
+	TestChaCha20Poly1305();
 	TestEllipticCrypto();
 	TestOpenSSHEd25519();
+	TestLZ4Block();
 	TestEllipticPerf();
+	TestEllipticBatchVerify();
 	TestSymmetricAuthCryptoPerf();
+	TestSymmetricAuthCryptoPacketPerf();
 
 	return g_failed ? 1 : 0;
 }